@@ -0,0 +1,220 @@
+/**
+ * Media Assets Implementation
+ */
+
+#include "assets.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <string.h>
+
+static const char *TAG = "ASSETS";
+
+typedef enum {
+    ENTRY_UNCHECKED = 0,
+    ENTRY_OK,
+    ENTRY_CORRUPT,
+} entry_state_t;
+
+static const uint8_t *pack = NULL;      // Mapped partition, NULL without a valid pack
+static uint32_t pack_version = 0;
+static uint16_t entry_count = 0;
+// Checked copy of the table of contents, so an OTA rewriting the partition
+// can't point readers outside the mapping
+static uint8_t toc[ASSETS_MAX_ENTRIES * ASSETS_ENTRY_SIZE];
+static volatile uint8_t entry_state[ASSETS_MAX_ENTRIES];
+
+// Readers holding an asset, and whether an update is writing the partition
+static portMUX_TYPE readers_mux = portMUX_INITIALIZER_UNLOCKED;
+static uint16_t readers = 0;
+static bool updating = false;
+
+static uint16_t get_le16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get_le32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+bool assets_parse_header(const uint8_t *buf, size_t len, uint32_t *version, uint32_t *total_size)
+{
+    if (len < ASSETS_HEADER_SIZE || memcmp(buf, ASSETS_MAGIC, 4) != 0 ||
+        get_le16(buf + 4) != ASSETS_FORMAT || get_le16(buf + 6) > ASSETS_MAX_ENTRIES) {
+        return false;
+    }
+    uint32_t size = get_le32(buf + 12);
+    if (size < ASSETS_HEADER_SIZE + (uint32_t)get_le16(buf + 6) * ASSETS_ENTRY_SIZE) {
+        return false;
+    }
+    if (version) {
+        *version = get_le32(buf + 8);
+    }
+    if (total_size) {
+        *total_size = size;
+    }
+    return true;
+}
+
+esp_err_t assets_init(void)
+{
+    const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                                                ASSETS_PARTITION_LABEL);
+    if (!partition) {
+        ESP_LOGW(TAG, "No assets partition - flash the current partition table over USB for sounds and quotes");
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    uint8_t header[ASSETS_HEADER_SIZE];
+    uint32_t version = 0;
+    uint32_t total_size = 0;
+    esp_err_t err = esp_partition_read(partition, 0, header, sizeof(header));
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (!assets_parse_header(header, sizeof(header), &version, &total_size) || total_size > partition->size) {
+        ESP_LOGW(TAG, "Assets partition holds no valid pack");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    const void *mapped = NULL;
+    esp_partition_mmap_handle_t handle;
+    err = esp_partition_mmap(partition, 0, total_size, ESP_PARTITION_MMAP_DATA, &mapped, &handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to map assets: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    // The header and table of contents are checked up front; blobs on first use
+    const uint8_t *base = mapped;
+    uint16_t count = get_le16(base + 6);
+    uint32_t crc = esp_rom_crc32_le(0, base, 16);
+    crc = esp_rom_crc32_le(crc, base + ASSETS_HEADER_SIZE, (uint32_t)count * ASSETS_ENTRY_SIZE);
+    if (crc != get_le32(base + 16)) {
+        ESP_LOGE(TAG, "Assets table of contents is corrupt");
+        esp_partition_munmap(handle);
+        return ESP_ERR_INVALID_CRC;
+    }
+    // Blobs sit after the table of contents, each in its own range
+    uint32_t blobs_start = ASSETS_HEADER_SIZE + (uint32_t)count * ASSETS_ENTRY_SIZE;
+    for (uint16_t i = 0; i < count; i++) {
+        const uint8_t *entry = base + ASSETS_HEADER_SIZE + i * ASSETS_ENTRY_SIZE;
+        uint32_t offset = get_le32(entry + ASSETS_NAME_LEN);
+        uint32_t size = get_le32(entry + ASSETS_NAME_LEN + 4);
+        bool overlaps = false;
+        for (uint16_t j = 0; j < i && !overlaps; j++) {
+            const uint8_t *other = base + ASSETS_HEADER_SIZE + j * ASSETS_ENTRY_SIZE;
+            uint32_t other_offset = get_le32(other + ASSETS_NAME_LEN);
+            uint32_t other_size = get_le32(other + ASSETS_NAME_LEN + 4);
+            overlaps = offset < other_offset + other_size && other_offset < offset + size;
+        }
+        if (offset < blobs_start || offset > total_size || size > total_size - offset || overlaps) {
+            ESP_LOGE(TAG, "Asset %d lies outside the pack or overlaps another", i);
+            esp_partition_munmap(handle);
+            return ESP_ERR_INVALID_SIZE;
+        }
+        entry_state[i] = ENTRY_UNCHECKED;
+    }
+
+    memcpy(toc, base + ASSETS_HEADER_SIZE, (size_t)count * ASSETS_ENTRY_SIZE);
+    entry_count = count;
+    pack_version = version;
+    pack = base;  // Mapped for the life of the app
+    ESP_LOGI(TAG, "Assets pack v%lu: %d files, %lu bytes", version, count, total_size);
+    return ESP_OK;
+}
+
+bool assets_get(const char *name, const uint8_t **data, size_t *size)
+{
+    if (!pack) {
+        return false;
+    }
+
+    portENTER_CRITICAL(&readers_mux);
+    bool available = !updating;
+    if (available) {
+        readers++;
+    }
+    portEXIT_CRITICAL(&readers_mux);
+    if (!available) {
+        return false;
+    }
+
+    for (uint16_t i = 0; i < entry_count; i++) {
+        const uint8_t *entry = toc + i * ASSETS_ENTRY_SIZE;
+        if (strncmp((const char *)entry, name, ASSETS_NAME_LEN) != 0) {
+            continue;
+        }
+
+        const uint8_t *blob = pack + get_le32(entry + ASSETS_NAME_LEN);
+        uint32_t blob_size = get_le32(entry + ASSETS_NAME_LEN + 4);
+        if (entry_state[i] == ENTRY_UNCHECKED) {
+            bool intact = esp_rom_crc32_le(0, blob, blob_size) == get_le32(entry + ASSETS_NAME_LEN + 8);
+            entry_state[i] = intact ? ENTRY_OK : ENTRY_CORRUPT;
+            if (!intact) {
+                ESP_LOGE(TAG, "Asset %s is corrupt", name);
+            }
+        }
+        if (entry_state[i] != ENTRY_OK) {
+            assets_release();
+            return false;
+        }
+        *data = blob;
+        *size = blob_size;
+        return true;
+    }
+
+    assets_release();
+    ESP_LOGW(TAG, "Asset %s not in pack v%lu", name, pack_version);
+    return false;
+}
+
+void assets_release(void)
+{
+    portENTER_CRITICAL(&readers_mux);
+    if (readers > 0) {
+        readers--;
+    }
+    portEXIT_CRITICAL(&readers_mux);
+}
+
+esp_err_t assets_begin_update(uint32_t timeout_ms)
+{
+    portENTER_CRITICAL(&readers_mux);
+    updating = true;
+    portEXIT_CRITICAL(&readers_mux);
+
+    for (uint32_t waited_ms = 0; ; waited_ms += 50) {
+        portENTER_CRITICAL(&readers_mux);
+        uint16_t held = readers;
+        portEXIT_CRITICAL(&readers_mux);
+        if (held == 0) {
+            return ESP_OK;
+        }
+        if (waited_ms >= timeout_ms) {
+            ESP_LOGW(TAG, "%d asset reader(s) still busy, not updating", held);
+            assets_end_update();
+            return ESP_ERR_TIMEOUT;
+        }
+        vTaskDelay(pdMS_TO_TICKS(50));
+    }
+}
+
+void assets_end_update(void)
+{
+    for (uint16_t i = 0; i < entry_count; i++) {
+        entry_state[i] = ENTRY_UNCHECKED;
+    }
+    portENTER_CRITICAL(&readers_mux);
+    updating = false;
+    portEXIT_CRITICAL(&readers_mux);
+}
+
+uint32_t assets_get_version(void)
+{
+    return pack_version;
+}
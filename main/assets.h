@@ -0,0 +1,101 @@
+/**
+ * Media Assets
+ * Sounds, images and quotes stored in the "assets" flash partition
+ *
+ * Media lives outside the app image so a firmware update only ships code.
+ * The pack is built by main/build_assets.py, flashed with the app over
+ * USB and published with each release as "glucose-assets-v<N>.pack"; OTA
+ * installs it only when N is newer than the installed pack.
+ *
+ * Format (little-endian):
+ *   Header (ASSETS_HEADER_SIZE bytes):
+ *     "GMAS", format (u16), entry count (u16), pack version (u32),
+ *     total size (u32), CRC-32 of the header's first 16 bytes and the
+ *     table of contents (u32), 12 reserved bytes
+ *   Table of contents, one ASSETS_ENTRY_SIZE entry per asset:
+ *     name (32 bytes, NUL padded), offset (u32), size (u32), CRC-32 (u32),
+ *     4 reserved bytes
+ *   Blobs, each starting on an ASSETS_ALIGN boundary
+ *
+ * The partition is memory-mapped, so assets are read in place without
+ * copying them to RAM. Readers hold an asset from assets_get until
+ * assets_release; an OTA media update waits for them to finish
+ * (assets_begin_update) before it overwrites the partition.
+ */
+
+#ifndef ASSETS_H
+#define ASSETS_H
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define ASSETS_PARTITION_LABEL  "assets"
+#define ASSETS_MAGIC            "GMAS"
+#define ASSETS_FORMAT           1
+#define ASSETS_HEADER_SIZE      32
+#define ASSETS_ENTRY_SIZE       48
+#define ASSETS_NAME_LEN         32
+#define ASSETS_ALIGN            16
+#define ASSETS_MAX_ENTRIES      32
+
+/**
+ * Map the assets partition and check the pack header
+ * Without a partition or a valid pack the device runs without media
+ * (see assets_get); that is not an error for the caller.
+ * @return ESP_OK if a pack is available
+ */
+esp_err_t assets_init(void);
+
+/**
+ * Find an asset
+ * The blob's CRC is checked the first time it is requested. Returns
+ * false while a media update is being written.
+ * @param name File name (e.g. "ahs_hypo.wav")
+ * @param[out] data Mapped contents, valid until assets_release
+ * @param[out] size Size in bytes
+ * @return true if the asset exists and is intact; call assets_release
+ *         when done reading it
+ */
+bool assets_get(const char *name, const uint8_t **data, size_t *size);
+
+/**
+ * Done reading an asset returned by assets_get
+ */
+void assets_release(void);
+
+/**
+ * Stop handing out assets and wait for readers to release theirs
+ * Call before writing the assets partition.
+ * @param timeout_ms How long to wait for readers
+ * @return ESP_OK once no asset is held, ESP_ERR_TIMEOUT otherwise (assets
+ *         are handed out again)
+ */
+esp_err_t assets_begin_update(uint32_t timeout_ms);
+
+/**
+ * Hand out assets again after writing the partition
+ * The table of contents loaded at boot is kept, so every blob's CRC is
+ * checked again: blobs the update overwrote stay unavailable until the
+ * reboot loads the new pack.
+ */
+void assets_end_update(void);
+
+/**
+ * Version of the installed pack
+ * @return Pack version, or 0 if no valid pack is installed
+ */
+uint32_t assets_get_version(void);
+
+/**
+ * Check a pack header read from flash or a download
+ * @param buf First bytes of the pack
+ * @param len Bytes in buf
+ * @param[out] version Pack version (may be NULL)
+ * @param[out] total_size Pack size in bytes (may be NULL)
+ * @return true if buf starts with a pack header of this format
+ */
+bool assets_parse_header(const uint8_t *buf, size_t len, uint32_t *version, uint32_t *total_size);
+
+#endif // ASSETS_H
@@ -0,0 +1,61 @@
+/**
+ * Backlight Policy Implementation
+ */
+
+#include "backlight_policy.h"
+#include <stddef.h>
+
+bool backlight_policy_is_night(const backlight_policy_t *policy, int hour)
+{
+    if (!policy->night_enabled || hour < 0 || policy->night_start_hour == policy->night_end_hour) {
+        return false;
+    }
+    if (policy->night_start_hour < policy->night_end_hour) {
+        return hour >= policy->night_start_hour && hour < policy->night_end_hour;
+    }
+    return hour >= policy->night_start_hour || hour < policy->night_end_hour;
+}
+
+// Smallest non-zero timeout still ahead of idle_s, 0 if none
+static uint32_t next_timeout(uint32_t a, uint32_t b, uint32_t idle_s)
+{
+    uint32_t next = 0;
+    if (a > idle_s) {
+        next = a;
+    }
+    if (b > idle_s && (next == 0 || b < next)) {
+        next = b;
+    }
+    return next;
+}
+
+backlight_level_t backlight_policy_level(const backlight_policy_t *policy, uint32_t idle_s, int hour,
+                                         bool alarm, uint32_t *next_s)
+{
+    backlight_level_t level;
+    uint32_t next = 0;
+
+    if (alarm) {
+        level = BACKLIGHT_FULL;
+    } else if (backlight_policy_is_night(policy, hour)) {
+        bool off = (policy->dim_after_s && idle_s >= policy->dim_after_s) ||
+                   (policy->off_after_s && idle_s >= policy->off_after_s);
+        level = off ? BACKLIGHT_OFF : BACKLIGHT_DIM;
+        if (!off) {
+            next = next_timeout(policy->dim_after_s, policy->off_after_s, idle_s);
+        }
+    } else if (policy->off_after_s && idle_s >= policy->off_after_s) {
+        level = BACKLIGHT_OFF;
+    } else if (policy->dim_after_s && idle_s >= policy->dim_after_s) {
+        level = BACKLIGHT_DIM;
+        next = policy->off_after_s;
+    } else {
+        level = BACKLIGHT_FULL;
+        next = next_timeout(policy->dim_after_s, policy->off_after_s, idle_s);
+    }
+
+    if (next_s) {
+        *next_s = next;
+    }
+    return level;
+}
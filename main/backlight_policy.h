@@ -0,0 +1,65 @@
+/**
+ * Backlight Policy
+ * Picks the backlight level from idle time, time of day and alarm state
+ *
+ * By day the backlight is full while the screen is in use, dims after
+ * dim_after_s without a touch or button press and turns off after
+ * off_after_s (either may be 0 for never). During the night hours the
+ * woken level is already dim and the screen turns off at the first of
+ * the two timeouts. A sounding alarm always gets full brightness.
+ *
+ * Plain C with no ESP-IDF dependencies so it can be tested on a host.
+ * display_power.c applies the result.
+ */
+
+#ifndef BACKLIGHT_POLICY_H
+#define BACKLIGHT_POLICY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Backlight level
+ */
+typedef enum {
+    BACKLIGHT_FULL = 0,
+    BACKLIGHT_DIM,
+    BACKLIGHT_OFF,
+} backlight_level_t;
+
+/**
+ * Schedule (from the global settings)
+ */
+typedef struct {
+    uint32_t dim_after_s;       // Idle time before dimming, 0: never
+    uint32_t off_after_s;       // Idle time before turning off, 0: never
+    bool night_enabled;         // Apply the night hours
+    uint8_t night_start_hour;   // First night hour (0-23)
+    uint8_t night_end_hour;     // First day hour (0-23); equal to the start: no night
+} backlight_policy_t;
+
+/**
+ * Check whether an hour falls in the night
+ * The night may wrap past midnight (e.g. 22 to 7).
+ *
+ * @param policy Schedule
+ * @param hour Local hour (0-23), negative if the clock is not set yet
+ * @return true during the night hours
+ */
+bool backlight_policy_is_night(const backlight_policy_t *policy, int hour);
+
+/**
+ * Level for the current state
+ *
+ * @param policy Schedule
+ * @param idle_s Seconds since the last touch or button press
+ * @param hour Local hour (0-23), negative if the clock is not set yet
+ * @param alarm True while the glucose alarm is active
+ * @param[out] next_s Idle seconds at which the level next changes, 0 if
+ *                    it won't (until the hour or alarm changes); may be NULL
+ * @return Level to show
+ */
+backlight_level_t backlight_policy_level(const backlight_policy_t *policy, uint32_t idle_s, int hour,
+                                         bool alarm, uint32_t *next_s);
+
+#endif // BACKLIGHT_POLICY_H
@@ -0,0 +1,99 @@
+#!/usr/bin/env python3
+"""
+Build step for the media assets partition.
+
+Packs sounds, images and quotes into one image for the "assets" partition
+(see main/assets.h for the format). Run automatically by
+main/CMakeLists.txt; the release workflow publishes the output as
+glucose-assets-v<ASSETS_VERSION>.pack (a .pack, so it is never taken
+for a firmware image).
+
+The pack version is ASSETS_VERSION from config.h. Bump it whenever a file
+changes, or devices will not download the new pack.
+
+Usage: build_assets.py --config main/config.h --output assets.bin file...
+"""
+
+import argparse
+import os
+import re
+import struct
+import sys
+import zlib
+
+MAGIC = b'GMAS'
+FORMAT = 1
+HEADER_SIZE = 32
+ENTRY_SIZE = 48
+NAME_LEN = 32
+ALIGN = 16
+MAX_ENTRIES = 32
+
+
+def load_version(config_path):
+    with open(config_path, encoding='utf-8') as f:
+        for line in f:
+            m = re.match(r'\s*#define\s+ASSETS_VERSION\s+(\d+)', line)
+            if m:
+                return int(m.group(1))
+    sys.exit(f'{config_path}: ASSETS_VERSION not defined')
+
+
+def align(n):
+    return (n + ALIGN - 1) // ALIGN * ALIGN
+
+
+def build_pack(files, version):
+    if len(files) > MAX_ENTRIES:
+        sys.exit(f'too many assets ({len(files)}, max {MAX_ENTRIES})')
+
+    offset = align(HEADER_SIZE + len(files) * ENTRY_SIZE)
+    toc = bytearray()
+    blobs = bytearray()
+    for name, data in files:
+        encoded = name.encode('utf-8')
+        if len(encoded) >= NAME_LEN:
+            sys.exit(f'{name}: name longer than {NAME_LEN - 1} bytes')
+        toc += struct.pack('<32sIII4x', encoded, offset, len(data), zlib.crc32(data))
+        padding = align(len(data)) - len(data)
+        blobs += data + b'\xff' * padding  # 0xFF is erased flash
+        offset += len(data) + padding
+
+    total_size = align(HEADER_SIZE + len(toc)) + len(blobs)
+    head = MAGIC + struct.pack('<HHII', FORMAT, len(files), version, total_size)
+    crc = zlib.crc32(bytes(toc), zlib.crc32(head))
+    header = head + struct.pack('<I12x', crc)
+    gap = align(HEADER_SIZE + len(toc)) - HEADER_SIZE - len(toc)
+    return header + bytes(toc) + b'\xff' * gap + bytes(blobs)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('--config', required=True, help='config.h with ASSETS_VERSION')
+    parser.add_argument('--output', required=True, help='pack image to write')
+    parser.add_argument('assets', nargs='+')
+    args = parser.parse_args()
+
+    files = []
+    for path in sorted(args.assets, key=os.path.basename):
+        with open(path, 'rb') as f:
+            files.append((os.path.basename(path), f.read()))
+    names = [name for name, _ in files]
+    if len(set(names)) != len(names):
+        sys.exit('asset names must be unique')
+
+    version = load_version(args.config)
+    content = build_pack(files, version)
+
+    # Only touch the output when it changes to avoid needless reflashing
+    if os.path.exists(args.output):
+        with open(args.output, 'rb') as f:
+            if f.read() == content:
+                return
+    with open(args.output, 'wb') as f:
+        f.write(content)
+    print(f'assets pack v{version}: {len(files)} files, {len(content)} bytes')
+
+
+if __name__ == '__main__':
+    main()
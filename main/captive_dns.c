@@ -0,0 +1,129 @@
+/**
+ * Captive DNS Responder Implementation
+ */
+
+#include "captive_dns.h"
+#include "captive_dns_proto.h"
+#include "esp_event.h"
+#include "esp_log.h"
+#include "esp_netif.h"
+#include "esp_wifi.h"
+#include "lwip/sockets.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <errno.h>
+#include <stdbool.h>
+
+static const char *TAG = "CAPTIVE_DNS";
+
+#define DNS_TASK_STACK          3072
+#define DNS_TASK_PRIORITY       4
+#define DNS_RECV_TIMEOUT_MS     500     // How quickly the task notices the AP stopped
+#define DNS_RETRY_MS            1000
+
+static TaskHandle_t dns_task = NULL;
+static volatile bool ap_running = false;       // Between AP_START and AP_STOP
+
+/**
+ * Bind to port 53 on the AP address (not the station's, which may be
+ * on the home network in APSTA mode)
+ */
+static int open_socket(uint32_t *ip)
+{
+    esp_netif_t *ap_netif = esp_netif_get_handle_from_ifkey("WIFI_AP_DEF");
+    esp_netif_ip_info_t ip_info;
+    if (!ap_netif || esp_netif_get_ip_info(ap_netif, &ip_info) != ESP_OK || ip_info.ip.addr == 0) {
+        return -1;
+    }
+
+    int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+    if (sock < 0) {
+        ESP_LOGE(TAG, "socket failed: errno %d", errno);
+        return -1;
+    }
+
+    struct sockaddr_in bind_addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(CAPTIVE_DNS_PORT),
+        .sin_addr.s_addr = ip_info.ip.addr,
+    };
+    struct timeval timeout = {
+        .tv_sec = 0,
+        .tv_usec = DNS_RECV_TIMEOUT_MS * 1000,
+    };
+    if (bind(sock, (struct sockaddr *)&bind_addr, sizeof(bind_addr)) < 0 ||
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) < 0) {
+        ESP_LOGE(TAG, "Failed to bind port %d: errno %d", CAPTIVE_DNS_PORT, errno);
+        close(sock);
+        return -1;
+    }
+
+    *ip = ip_info.ip.addr;
+    ESP_LOGI(TAG, "Answering DNS on " IPSTR, IP2STR(&ip_info.ip));
+    return sock;
+}
+
+static void captive_dns_task(void *pvParameters)
+{
+    // Static: only one responder task runs at a time
+    static uint8_t rx_buf[CAPTIVE_DNS_PACKET_MAX];
+    static uint8_t tx_buf[CAPTIVE_DNS_PACKET_MAX + 16];
+    uint32_t answered = 0;
+
+    while (1) {
+        if (!ap_running) {
+            // Nothing open while the AP is down; AP_START wakes the task
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+
+        uint32_t ip = 0;
+        int sock = open_socket(&ip);
+        if (sock < 0) {
+            vTaskDelay(pdMS_TO_TICKS(DNS_RETRY_MS));
+            continue;
+        }
+
+        while (ap_running) {
+            struct sockaddr_in from;
+            socklen_t from_len = sizeof(from);
+            int len = recvfrom(sock, rx_buf, sizeof(rx_buf), 0, (struct sockaddr *)&from, &from_len);
+            if (len <= 0) {
+                continue;   // Timeout: check whether the AP is still up
+            }
+            size_t reply_len = captive_dns_reply(rx_buf, (size_t)len, ip, tx_buf, sizeof(tx_buf));
+            if (reply_len > 0) {
+                sendto(sock, tx_buf, reply_len, 0, (struct sockaddr *)&from, from_len);
+                answered++;
+            }
+        }
+        close(sock);
+        ESP_LOGI(TAG, "AP stopped, %lu replies so far", answered);
+    }
+}
+
+static void ap_event_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data)
+{
+    if (event_id == WIFI_EVENT_AP_START) {
+        ap_running = true;
+        // Created the first time the AP comes up; never in plain station mode
+        if (dns_task) {
+            xTaskNotifyGive(dns_task);
+        } else if (xTaskCreate(captive_dns_task, "captive_dns", DNS_TASK_STACK, NULL, DNS_TASK_PRIORITY,
+                               &dns_task) != pdPASS) {
+            ESP_LOGE(TAG, "Failed to create DNS task");
+            dns_task = NULL;
+        }
+    } else if (event_id == WIFI_EVENT_AP_STOP) {
+        ap_running = false;
+    }
+}
+
+esp_err_t captive_dns_init(void)
+{
+    esp_err_t err = esp_event_handler_register(WIFI_EVENT, WIFI_EVENT_AP_START, &ap_event_handler, NULL);
+    if (err == ESP_OK) {
+        err = esp_event_handler_register(WIFI_EVENT, WIFI_EVENT_AP_STOP, &ap_event_handler, NULL);
+    }
+    return err;
+}
@@ -0,0 +1,30 @@
+/**
+ * Captive DNS Responder
+ * Answers DNS on the provisioning AP so phones find the portal at once
+ *
+ * While the soft AP is up, a small task listens on UDP port 53 of the
+ * AP address and answers every A query with that address (see
+ * captive_dns_proto.h). Connectivity checks (connectivitycheck.gstatic.com,
+ * captive.apple.com, ...) then reach the portal's web server straight
+ * away, and the phone shows the sign-in page instead of waiting for its
+ * lookups to time out.
+ *
+ * The responder follows WIFI_EVENT_AP_START / WIFI_EVENT_AP_STOP: its
+ * task is created the first time the AP starts (never in plain station
+ * mode), and while the AP is down it closes the socket and blocks.
+ */
+
+#ifndef CAPTIVE_DNS_H
+#define CAPTIVE_DNS_H
+
+#include "esp_err.h"
+
+/**
+ * Start following the AP
+ * Call once after the default event loop has been created
+ *
+ * @return ESP_OK on success
+ */
+esp_err_t captive_dns_init(void);
+
+#endif // CAPTIVE_DNS_H
@@ -0,0 +1,103 @@
+/**
+ * Captive DNS Protocol Implementation
+ */
+
+#include "captive_dns_proto.h"
+#include <stdbool.h>
+#include <string.h>
+
+#define DNS_HEADER_LEN      12
+#define DNS_ANSWER_LEN      16      // Name pointer, type, class, TTL, length, IPv4 address
+
+#define DNS_FLAG_QR         0x8000
+#define DNS_FLAG_AA         0x0400
+#define DNS_FLAG_TC         0x0200
+#define DNS_FLAG_RD         0x0100
+#define DNS_OPCODE_MASK     0x7800
+
+#define DNS_TYPE_A          1
+#define DNS_CLASS_IN        1
+#define DNS_NAME_MAX        255
+
+static uint16_t get_u16(const uint8_t *p)
+{
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static void put_u16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)(v >> 8);
+    p[1] = (uint8_t)v;
+}
+
+/**
+ * Length of the question's name (labels up to the root), or 0 if it is
+ * malformed or compressed
+ */
+static size_t name_length(const uint8_t *data, size_t len)
+{
+    size_t pos = 0;
+    while (pos < len) {
+        uint8_t label = data[pos];
+        if (label == 0) {
+            return pos + 1 <= DNS_NAME_MAX ? pos + 1 : 0;
+        }
+        if (label > 63) {
+            return 0;       // Compression pointer or reserved label type
+        }
+        pos += 1 + label;
+    }
+    return 0;
+}
+
+size_t captive_dns_reply(const uint8_t *query, size_t len, uint32_t ip, uint8_t *reply, size_t reply_size)
+{
+    if (len < DNS_HEADER_LEN || len > CAPTIVE_DNS_PACKET_MAX) {
+        return 0;
+    }
+
+    uint16_t flags = get_u16(query + 2);
+    if ((flags & (DNS_FLAG_QR | DNS_OPCODE_MASK | DNS_FLAG_TC)) != 0 ||
+        get_u16(query + 4) != 1 || get_u16(query + 6) != 0 || get_u16(query + 8) != 0) {
+        return 0;
+    }
+
+    // Additional records (an EDNS OPT) are ignored and not echoed
+    size_t name_len = name_length(query + DNS_HEADER_LEN, len - DNS_HEADER_LEN);
+    size_t question_len = name_len + 4;
+    if (name_len == 0 || DNS_HEADER_LEN + question_len > len) {
+        return 0;
+    }
+    const uint8_t *question = query + DNS_HEADER_LEN;
+    uint16_t qtype = get_u16(question + name_len);
+    uint16_t qclass = get_u16(question + name_len + 2);
+    if (qclass != DNS_CLASS_IN) {
+        return 0;
+    }
+
+    bool answer = qtype == DNS_TYPE_A;
+    size_t reply_len = DNS_HEADER_LEN + question_len + (answer ? DNS_ANSWER_LEN : 0);
+    if (reply_len > reply_size) {
+        return 0;
+    }
+
+    memcpy(reply, query, 2);                                    // ID
+    put_u16(reply + 2, DNS_FLAG_QR | DNS_FLAG_AA | (flags & DNS_FLAG_RD));
+    put_u16(reply + 4, 1);                                      // Questions
+    put_u16(reply + 6, answer ? 1 : 0);                         // Answers
+    put_u16(reply + 8, 0);
+    put_u16(reply + 10, 0);
+    memcpy(reply + DNS_HEADER_LEN, question, question_len);
+
+    if (answer) {
+        uint8_t *rr = reply + DNS_HEADER_LEN + question_len;
+        put_u16(rr, 0xC000 | DNS_HEADER_LEN);                   // Pointer to the question's name
+        put_u16(rr + 2, DNS_TYPE_A);
+        put_u16(rr + 4, DNS_CLASS_IN);
+        put_u16(rr + 6, 0);
+        put_u16(rr + 8, CAPTIVE_DNS_TTL_S);
+        put_u16(rr + 10, 4);
+        memcpy(rr + 12, &ip, 4);                                // Already network byte order
+    }
+    return reply_len;
+}
@@ -0,0 +1,42 @@
+/**
+ * Captive DNS Protocol
+ * Builds the reply the captive portal's DNS responder sends to a query
+ *
+ * Every well-formed standard query with one IN question is answered:
+ *   A        one record pointing at the portal address
+ *   other    no records, NOERROR (so AAAA/HTTPS lookups end at once
+ *            instead of timing out and holding up the A answer)
+ * Anything else (responses, other opcodes, several questions, name
+ * compression in the question, truncated packets, non-IN classes) is
+ * dropped without a reply.
+ *
+ * Plain C with no ESP-IDF dependencies so it can be tested on a host.
+ */
+
+#ifndef CAPTIVE_DNS_PROTO_H
+#define CAPTIVE_DNS_PROTO_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CAPTIVE_DNS_PORT            53
+
+// Largest query handled (classic DNS over UDP)
+#define CAPTIVE_DNS_PACKET_MAX      512
+
+// Short, so devices stop using the portal address soon after provisioning
+#define CAPTIVE_DNS_TTL_S           10
+
+/**
+ * Build the reply to a query
+ *
+ * @param query Received packet
+ * @param len Its length
+ * @param ip Portal address, network byte order (as in esp_ip4_addr_t)
+ * @param reply Output buffer
+ * @param reply_size Size of the output buffer
+ * @return Length of the reply, or 0 if the packet is to be dropped
+ */
+size_t captive_dns_reply(const uint8_t *query, size_t len, uint32_t ip, uint8_t *reply, size_t reply_size);
+
+#endif // CAPTIVE_DNS_PROTO_H
@@ -10,6 +10,7 @@
 #define DEVICE_NAME "The Supreme's Glucose Monitor"
 #define DEVICE_NAME_SHORT "Supreme-GM"  // Used for WiFi AP SSID (no spaces)
 #define DEVICE_VERSION "1.0.15"
+#define ASSETS_VERSION 1  // Media pack version (see assets.h); bump when a sound, image or quote changes
 #define DEVICE_MANUFACTURER "Spalding (Derek Marr)"
 #define DEVICE_OWNER "The Supreme (Stephen Higgins)"
 
@@ -19,6 +20,10 @@
 // WiFi Configuration
 #define WIFI_AP_SSID DEVICE_NAME_SHORT
 #define WIFI_AP_PASSWORD "CatGotYourTongue"
+#define WIFI_FAST_CONNECT_STATIC_IP 0  // 1: reuse the last DHCP lease as a static IP on boot (only with a DHCP reservation on the router)
+
+// Power Configuration
+#define POWER_SAVE_ENABLED 1  // 1: DFS and WiFi modem sleep between polls (needs CONFIG_PM_ENABLE; see power.h)
 
 // Glucose Thresholds (mmol/L)
 #define GLUCOSE_LOW_THRESHOLD 3.9
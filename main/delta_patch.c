@@ -0,0 +1,117 @@
+/**
+ * Delta Patch Implementation
+ */
+
+#include "delta_patch.h"
+#include <string.h>
+
+#define DELTA_PATCH_MAGIC       "GMDP"
+#define DELTA_PATCH_VERSION     1
+#define DELTA_SOURCE_CHUNK      256
+
+static uint32_t get_le32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+bool delta_patch_parse_header(const uint8_t *buf, size_t len, delta_patch_header_t *header)
+{
+    if (len < DELTA_PATCH_HEADER_SIZE || memcmp(buf, DELTA_PATCH_MAGIC, 4) != 0 ||
+        buf[4] != DELTA_PATCH_VERSION) {
+        return false;
+    }
+    header->source_size = get_le32(buf + 8);
+    header->target_size = get_le32(buf + 12);
+    memcpy(header->source_sha256, buf + 16, 32);
+    memcpy(header->target_sha256, buf + 48, 32);
+    return true;
+}
+
+void delta_patch_init(delta_patch_t *patch, const delta_patch_header_t *header,
+                      delta_patch_read_cb_t read_source, delta_patch_write_cb_t write_target, void *ctx)
+{
+    memset(patch, 0, sizeof(*patch));
+    patch->read_source = read_source;
+    patch->write_target = write_target;
+    patch->ctx = ctx;
+    patch->source_size = header->source_size;
+    patch->target_size = header->target_size;
+}
+
+static void finish_record(delta_patch_t *patch)
+{
+    if (patch->diff_left == 0 && patch->extra_left == 0) {
+        patch->source_pos += patch->seek;
+        patch->seek = 0;
+    }
+}
+
+bool delta_patch_feed(delta_patch_t *patch, const uint8_t *data, size_t len)
+{
+    uint8_t source[DELTA_SOURCE_CHUNK];
+
+    while (len > 0 && !patch->failed) {
+        if (patch->diff_left == 0 && patch->extra_left == 0) {
+            size_t n = sizeof(patch->record) - patch->record_fill;
+            n = n < len ? n : len;
+            memcpy(patch->record + patch->record_fill, data, n);
+            patch->record_fill += n;
+            data += n;
+            len -= n;
+            if (patch->record_fill < sizeof(patch->record)) {
+                break;
+            }
+
+            patch->record_fill = 0;
+            patch->diff_left = get_le32(patch->record);
+            patch->extra_left = get_le32(patch->record + 4);
+            patch->seek = (int32_t)get_le32(patch->record + 8);
+            if ((uint64_t)patch->written + patch->diff_left + patch->extra_left > patch->target_size) {
+                patch->failed = true;
+                break;
+            }
+            finish_record(patch);
+        } else if (patch->diff_left > 0) {
+            size_t n = patch->diff_left;
+            n = n < len ? n : len;
+            n = n < sizeof(source) ? n : sizeof(source);
+            if (patch->source_pos < 0 || patch->source_pos + n > patch->source_size ||
+                !patch->read_source(patch->ctx, (uint32_t)patch->source_pos, source, n)) {
+                patch->failed = true;
+                break;
+            }
+            for (size_t i = 0; i < n; i++) {
+                source[i] += data[i];
+            }
+            if (!patch->write_target(patch->ctx, source, n)) {
+                patch->failed = true;
+                break;
+            }
+            patch->source_pos += n;
+            patch->written += n;
+            patch->diff_left -= n;
+            data += n;
+            len -= n;
+            finish_record(patch);
+        } else {
+            size_t n = patch->extra_left;
+            n = n < len ? n : len;
+            if (!patch->write_target(patch->ctx, data, n)) {
+                patch->failed = true;
+                break;
+            }
+            patch->written += n;
+            patch->extra_left -= n;
+            data += n;
+            len -= n;
+            finish_record(patch);
+        }
+    }
+    return !patch->failed;
+}
+
+bool delta_patch_complete(const delta_patch_t *patch)
+{
+    return !patch->failed && patch->written == patch->target_size &&
+           patch->diff_left == 0 && patch->extra_left == 0 && patch->record_fill == 0;
+}
@@ -0,0 +1,91 @@
+/**
+ * Delta Patch
+ * Rebuilds a firmware image from the running one and a binary patch
+ *
+ * Patches are made by make_delta_patch.py at release time and published
+ * as "glucose-monitor-v<new>-from-v<old>.patch" next to the full image.
+ *
+ * Format (little-endian):
+ *   Header, uncompressed (DELTA_PATCH_HEADER_SIZE bytes):
+ *     "GMDP", version, 3 reserved bytes, source size (u32), target size
+ *     (u32), source SHA-256, target SHA-256
+ *   Body, one zlib stream of records:
+ *     diff length (u32), extra length (u32), seek (i32), then
+ *     diff bytes   target = source byte at the source position + diff byte
+ *     extra bytes  copied to the target as they are
+ *     and the source position moves by seek
+ *
+ * This is the bsdiff record layout: code moved by a few bytes still
+ * lines up with the old image, so the diff bytes are mostly zero and
+ * compress well.
+ *
+ * Plain C with no ESP-IDF dependencies so it can be tested on a Linux
+ * host. The caller inflates the body and does all flash I/O.
+ */
+
+#ifndef DELTA_PATCH_H
+#define DELTA_PATCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define DELTA_PATCH_HEADER_SIZE     80
+
+typedef struct {
+    uint32_t source_size;
+    uint32_t target_size;
+    uint8_t source_sha256[32];      // Image the patch applies to
+    uint8_t target_sha256[32];      // Image it produces
+} delta_patch_header_t;
+
+/**
+ * Read source bytes; return false on error
+ */
+typedef bool (*delta_patch_read_cb_t)(void *ctx, uint32_t offset, uint8_t *buf, size_t len);
+
+/**
+ * Append target bytes; return false on error
+ */
+typedef bool (*delta_patch_write_cb_t)(void *ctx, const uint8_t *data, size_t len);
+
+typedef struct {
+    delta_patch_read_cb_t read_source;
+    delta_patch_write_cb_t write_target;
+    void *ctx;
+    uint32_t source_size;
+    uint32_t target_size;
+    int64_t source_pos;
+    uint32_t written;
+    uint32_t diff_left;
+    uint32_t extra_left;
+    int32_t seek;               // Applied once the record's diff and extra are done
+    uint8_t record[12];
+    uint8_t record_fill;
+    bool failed;
+} delta_patch_t;
+
+/**
+ * Parse the patch header
+ * @return true if buf holds a header of this format version
+ */
+bool delta_patch_parse_header(const uint8_t *buf, size_t len, delta_patch_header_t *header);
+
+/**
+ * Start applying a patch
+ */
+void delta_patch_init(delta_patch_t *patch, const delta_patch_header_t *header,
+                      delta_patch_read_cb_t read_source, delta_patch_write_cb_t write_target, void *ctx);
+
+/**
+ * Apply the next inflated body bytes
+ * @return false if the patch is malformed or a callback failed
+ */
+bool delta_patch_feed(delta_patch_t *patch, const uint8_t *data, size_t len);
+
+/**
+ * Whether the whole target has been written
+ */
+bool delta_patch_complete(const delta_patch_t *patch);
+
+#endif // DELTA_PATCH_H
@@ -4,6 +4,9 @@
 #include "wifi_manager.h"
 #include "ir_transmitter.h"
 #include "librelinkup.h"
+#include "assets.h"
+#include "power.h"
+#include "display_power.h"
 #include "esp_log.h"
 #include "esp_random.h"
 #include "freertos/FreeRTOS.h"
@@ -20,18 +23,6 @@
 // Speaker power amplifier GPIO (GPIO 46)
 #define SPEAKER_PWR_GPIO GPIO_NUM_46
 
-// Embedded PNG image
-extern const uint8_t supreme_glucose_splash_png_start[] asm("_binary_supreme_glucose_splash_png_start");
-extern const uint8_t supreme_glucose_splash_png_end[] asm("_binary_supreme_glucose_splash_png_end");
-
-// Embedded WAV audio file
-extern const uint8_t ahs_lala_wav_start[] asm("_binary_ahs_lala_wav_start");
-extern const uint8_t ahs_lala_wav_end[] asm("_binary_ahs_lala_wav_end");
-
-// Embedded JSON quotes file
-extern const uint8_t random_quotes_json_start[] asm("_binary_random_quotes_json_start");
-extern const uint8_t random_quotes_json_end[] asm("_binary_random_quotes_json_end");
-
 // Alarm state from main.c
 extern volatile bool alarm_active;
 
@@ -59,6 +50,16 @@ static bool last_is_high = false;
 static char last_timestamp[32] = "Unknown";
 static int last_measurement_color = 1;
 
+// Full clock while LVGL renders and flushes a frame
+static void render_event_cb(lv_event_t *e)
+{
+    if (lv_event_get_code(e) == LV_EVENT_RENDER_START) {
+        power_lock_acquire(POWER_LOCK_DISPLAY);
+    } else {
+        power_lock_release(POWER_LOCK_DISPLAY);
+    }
+}
+
 esp_err_t display_init(void)
 {
     ESP_LOGI(TAG, "Initializing display with BSP...");
@@ -75,28 +76,25 @@ esp_err_t display_init(void)
             .buff_dma = true,
         }
     };
-    bsp_display_start_with_config(&cfg);
+    lv_display_t *disp = bsp_display_start_with_config(&cfg);
+    if (disp) {
+        lv_display_add_event_cb(disp, render_event_cb, LV_EVENT_RENDER_START, NULL);
+        lv_display_add_event_cb(disp, render_event_cb, LV_EVENT_RENDER_READY, NULL);
+    }
     
     // Turn on backlight
     bsp_display_backlight_on();
     
     ESP_LOGI(TAG, "Display initialized successfully via BSP");
     
-    // Create display task
-    xTaskCreate(display_task, "display_task", 8192, NULL, 5, NULL);
+    // Backlight dimming and wake (LVGL runs in the BSP's port task)
+    if (display_power_init() != ESP_OK) {
+        ESP_LOGW(TAG, "Display power scheduler unavailable");
+    }
     
     return ESP_OK;
 }
 
-void display_task(void *pvParameters)
-{
-    ESP_LOGI(TAG, "Display task started");
-    
-    while (1) {
-        vTaskDelay(pdMS_TO_TICKS(10));
-    }
-}
-
 void display_lock(void)
 {
     bsp_display_lock(0);
@@ -198,17 +196,15 @@ static void display_show_surprise(void)
     vTaskDelay(pdMS_TO_TICKS(100));
     
     // Play surprise audio
-    if (spk_codec_dev != NULL) {
-        extern const uint8_t ahs_surprise_wav_start[] asm("_binary_ahs_surprise_wav_start");
-        extern const uint8_t ahs_surprise_wav_end[] asm("_binary_ahs_surprise_wav_end");
-        
-        size_t wav_size = ahs_surprise_wav_end - ahs_surprise_wav_start;
+    const uint8_t *ahs_surprise_wav = NULL;
+    size_t wav_size = 0;
+    if (spk_codec_dev != NULL && assets_get("ahs_surprise.wav", &ahs_surprise_wav, &wav_size)) {
         ESP_LOGI(TAG, "Playing surprise audio (%d bytes)", wav_size);
         
         // Parse WAV header: sample rate (offset 24-27), channels (offset 22-23)
         if (wav_size > 44) {
-            uint16_t channels = *((uint16_t*)(ahs_surprise_wav_start + 22));
-            uint32_t sample_rate = *((uint32_t*)(ahs_surprise_wav_start + 24));
+            uint16_t channels = *((uint16_t*)(ahs_surprise_wav + 22));
+            uint32_t sample_rate = *((uint32_t*)(ahs_surprise_wav + 24));
             ESP_LOGI(TAG, "WAV: %lu Hz, %d channel(s)", sample_rate, channels);
             
             esp_codec_dev_sample_info_t fs = {
@@ -221,12 +217,15 @@ static void display_show_surprise(void)
             esp_codec_dev_open(spk_codec_dev, &fs);
             esp_codec_dev_set_out_vol(spk_codec_dev, 75);
             
-            const uint8_t *pcm_data = ahs_surprise_wav_start + 44;
+            const uint8_t *pcm_data = ahs_surprise_wav + 44;
             size_t pcm_size = wav_size - 44;
             
+            power_lock_acquire(POWER_LOCK_AUDIO);
             int bytes_written = esp_codec_dev_write(spk_codec_dev, (void*)pcm_data, pcm_size);
+            power_lock_release(POWER_LOCK_AUDIO);
             ESP_LOGI(TAG, "Wrote %d bytes of PCM data", bytes_written);
         }
+        assets_release();
     }
 }
 
@@ -306,15 +305,16 @@ void display_show_splash(void)
     }
     
     // Play WAV audio if codec is ready
-    if (spk_codec_dev != NULL) {
+    const uint8_t *ahs_lala_wav = NULL;
+    size_t wav_size = 0;
+    if (spk_codec_dev != NULL && assets_get("ahs_lala.wav", &ahs_lala_wav, &wav_size)) {
         ESP_LOGI(TAG, "Playing splash audio (WAV)...");
-        size_t wav_size = ahs_lala_wav_end - ahs_lala_wav_start;
         ESP_LOGI(TAG, "WAV file size: %d bytes", wav_size);
         
         // Parse WAV header: sample rate (offset 24-27), channels (offset 22-23)
         if (wav_size > 44) {
-            uint16_t channels = *((uint16_t*)(ahs_lala_wav_start + 22));
-            uint32_t sample_rate = *((uint32_t*)(ahs_lala_wav_start + 24));
+            uint16_t channels = *((uint16_t*)(ahs_lala_wav + 22));
+            uint32_t sample_rate = *((uint32_t*)(ahs_lala_wav + 24));
             ESP_LOGI(TAG, "WAV: %lu Hz, %d channel(s)", sample_rate, channels);
             
             esp_codec_dev_sample_info_t fs = {
@@ -327,12 +327,15 @@ void display_show_splash(void)
             esp_codec_dev_open(spk_codec_dev, &fs);
             esp_codec_dev_set_out_vol(spk_codec_dev, 75);
             
-            const uint8_t *pcm_data = ahs_lala_wav_start + 44;
+            const uint8_t *pcm_data = ahs_lala_wav + 44;
             size_t pcm_size = wav_size - 44;
             
+            power_lock_acquire(POWER_LOCK_AUDIO);
             int bytes_written = esp_codec_dev_write(spk_codec_dev, (void*)pcm_data, pcm_size);
+            power_lock_release(POWER_LOCK_AUDIO);
             ESP_LOGI(TAG, "Wrote %d bytes of PCM data", bytes_written);
         }
+        assets_release();
     }
 }
 
@@ -567,11 +570,16 @@ typedef struct {
 
 // Get random quote from JSON file
 static bool get_random_quote(quote_data_t *quote_data) {
-    // Parse the embedded JSON file
-    const char* json_str = (const char*)random_quotes_json_start;
-    size_t json_len = random_quotes_json_end - random_quotes_json_start;
+    // Parse the JSON file from the assets partition
+    const uint8_t *quotes_json = NULL;
+    size_t json_len = 0;
+    if (!assets_get("random_quotes.json", &quotes_json, &json_len)) {
+        return false;
+    }
+    const char* json_str = (const char*)quotes_json;
     
     cJSON *json = cJSON_ParseWithLength(json_str, json_len);
+    assets_release();  // cJSON keeps its own copies
     if (json == NULL) {
         ESP_LOGE(TAG, "Failed to parse quotes JSON");
         return false;
@@ -873,7 +881,7 @@ void display_show_glucose(float glucose_mmol, const char *trend, bool is_low, bo
     
     display_unlock();
     
-    // Send IR command to Moon Lamp if enabled
+    // Queue Moon Lamp color (non-blocking, worker skips unchanged colors)
     ir_transmitter_set_moon_lamp_color(measurement_color);
     
     ESP_LOGI(TAG, "Glucose screen displayed: %.1f mmol/L %s (Low: %d, High: %d), Color: %d", 
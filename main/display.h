@@ -15,10 +15,15 @@
 esp_err_t display_init(void);
 
 /**
- * LVGL task handler - must be called periodically
- * Run this in a FreeRTOS task
+ * Take the LVGL lock (waits for the LVGL task to finish a frame)
+ * Needed for any LVGL call made outside the LVGL task
  */
-void display_task(void *pvParameters);
+void display_lock(void);
+
+/**
+ * Release the LVGL lock
+ */
+void display_unlock(void);
 
 /**
  * Show splash screen with title
@@ -0,0 +1,156 @@
+/**
+ * Display Power Scheduler Implementation
+ */
+
+#include "display_power.h"
+#include "backlight_policy.h"
+#include "display.h"
+#include "global_settings.h"
+#include "bsp/esp-bsp.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include <stdint.h>
+#include <time.h>
+
+static const char *TAG = "DISPLAY_POWER";
+
+static const char *const level_names[] = {
+    [BACKLIGHT_FULL] = "full",
+    [BACKLIGHT_DIM] = "dim",
+    [BACKLIGHT_OFF] = "off",
+};
+
+// All state below is used with the display lock held (LVGL task or display_lock)
+static lv_timer_t *schedule_timer = NULL;
+static int64_t last_activity_us = 0;
+static backlight_level_t level = BACKLIGHT_FULL;   // display_init() turns the backlight on
+static bool alarm = false;
+
+// Local hour, or -1 until SNTP has set the clock
+static int current_hour(void)
+{
+    time_t now = time(NULL);
+    struct tm timeinfo;
+    localtime_r(&now, &timeinfo);
+    return timeinfo.tm_year >= 120 ? timeinfo.tm_hour : -1;
+}
+
+static void load_policy(backlight_policy_t *policy)
+{
+    global_settings_t settings;
+    global_settings_load(&settings);
+
+    policy->dim_after_s = settings.screen_dim_minutes * 60;
+    policy->off_after_s = settings.screen_off_minutes * 60;
+    policy->night_enabled = settings.night_mode_enabled;
+    policy->night_start_hour = (uint8_t)settings.night_start_hour;
+    policy->night_end_hour = (uint8_t)settings.night_end_hour;
+}
+
+static void set_level(backlight_level_t new_level)
+{
+    if (new_level == level) {
+        return;
+    }
+
+    lv_display_t *disp = lv_display_get_default();
+    if (new_level == BACKLIGHT_OFF) {
+        bsp_display_backlight_off();
+        // Nothing is rendered in the dark (new readings, the hypo flash)
+        if (disp) {
+            lv_display_enable_invalidation(disp, false);
+        }
+    } else {
+        bsp_display_brightness_set(new_level == BACKLIGHT_FULL ? DISPLAY_POWER_FULL_PERCENT : DISPLAY_POWER_DIM_PERCENT);
+        if (level == BACKLIGHT_OFF && disp) {
+            // The panel shows its last frame at once; bring it up to date
+            lv_display_enable_invalidation(disp, true);
+            lv_obj_invalidate(lv_screen_active());
+        }
+    }
+
+    ESP_LOGI(TAG, "Backlight %s", level_names[new_level]);
+    level = new_level;
+}
+
+/**
+ * Apply the level for now and sleep until it next changes
+ */
+static void evaluate(void)
+{
+    backlight_policy_t policy;
+    load_policy(&policy);
+
+    int64_t idle_us = esp_timer_get_time() - last_activity_us;
+    uint32_t idle_ms = idle_us / 1000 < INT32_MAX ? (uint32_t)(idle_us / 1000) : INT32_MAX;
+    uint32_t next_s = 0;
+    set_level(backlight_policy_level(&policy, idle_ms / 1000, current_hour(), alarm, &next_s));
+
+    uint32_t period_ms = DISPLAY_POWER_RECHECK_MS;
+    if (next_s && next_s * 1000 - idle_ms < period_ms) {
+        period_ms = next_s * 1000 - idle_ms;
+    }
+    lv_timer_set_period(schedule_timer, period_ms);
+    lv_timer_reset(schedule_timer);
+}
+
+static void schedule_timer_cb(lv_timer_t *timer)
+{
+    evaluate();
+}
+
+// Runs in the LVGL task as the touch controller reports a press
+static void touch_event_cb(lv_event_t *e)
+{
+    if (level == BACKLIGHT_OFF) {
+        // Only wake: no click, gesture or triple tap from this touch
+        lv_indev_wait_release((lv_indev_t *)lv_event_get_user_data(e));
+    }
+    last_activity_us = esp_timer_get_time();
+    evaluate();
+}
+
+esp_err_t display_power_init(void)
+{
+    display_lock();
+    last_activity_us = esp_timer_get_time();
+    schedule_timer = lv_timer_create(schedule_timer_cb, DISPLAY_POWER_RECHECK_MS, NULL);
+    lv_indev_t *touch = bsp_display_get_input_dev();
+    if (touch) {
+        lv_indev_add_event_cb(touch, touch_event_cb, LV_EVENT_PRESSED, touch);
+    } else {
+        ESP_LOGW(TAG, "No touch input; only buttons wake the screen");
+    }
+    if (schedule_timer) {
+        evaluate();
+    }
+    display_unlock();
+
+    return schedule_timer ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+bool display_power_wake(void)
+{
+    display_lock();
+    bool was_off = level == BACKLIGHT_OFF;
+    last_activity_us = esp_timer_get_time();
+    if (schedule_timer) {
+        evaluate();
+    }
+    display_unlock();
+    return was_off;
+}
+
+void display_power_set_alarm(bool active)
+{
+    display_lock();
+    if (active != alarm) {
+        alarm = active;
+        // Once the alarm ends the screen stays up for a full idle period
+        last_activity_us = esp_timer_get_time();
+        if (schedule_timer) {
+            evaluate();
+        }
+    }
+    display_unlock();
+}
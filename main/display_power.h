@@ -0,0 +1,57 @@
+/**
+ * Display Power Scheduler
+ * Dims and turns off the backlight while nobody is looking at the screen
+ *
+ * The level comes from backlight_policy.h with the timeouts and night
+ * hours from the global settings. The schedule is an LVGL timer whose
+ * period is the time until the level next changes, so the LVGL task
+ * isn't woken just to check it (settings and the night hours are picked
+ * up within DISPLAY_POWER_RECHECK_MS).
+ *
+ * Waking is immediate: the touch controller's press event, a button
+ * press (display_power_wake) and the alarm (display_power_set_alarm)
+ * set the backlight before returning. The touch that wakes a dark
+ * screen is swallowed so it doesn't also press whatever is under it.
+ *
+ * While the backlight is off nothing is redrawn (the panel keeps the
+ * last frame); the screen is redrawn in full when it wakes.
+ */
+
+#ifndef DISPLAY_POWER_H
+#define DISPLAY_POWER_H
+
+#include "esp_err.h"
+#include <stdbool.h>
+
+// Backlight levels (percent)
+#define DISPLAY_POWER_FULL_PERCENT  100
+#define DISPLAY_POWER_DIM_PERCENT   15
+
+// Longest time between schedule checks
+#define DISPLAY_POWER_RECHECK_MS    60000
+
+/**
+ * Start the scheduler
+ * Called by display_init() once LVGL and the backlight are up
+ *
+ * @return ESP_OK on success
+ */
+esp_err_t display_power_init(void);
+
+/**
+ * Record user activity (button press) and light the screen
+ * Takes the display lock; don't call with it held.
+ *
+ * @return true if the backlight was off (the press only woke the screen)
+ */
+bool display_power_wake(void);
+
+/**
+ * Follow the glucose alarm: full brightness while it is active
+ * Takes the display lock; don't call with it held.
+ *
+ * @param active True while the alarm is active (sounding or snoozed)
+ */
+void display_power_set_alarm(bool active);
+
+#endif // DISPLAY_POWER_H
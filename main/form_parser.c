@@ -0,0 +1,221 @@
+/**
+ * Form Parser Implementation
+ */
+
+#include "form_parser.h"
+#include <stdlib.h>
+#include <string.h>
+
+static int hex_value(char c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+static form_status_t fail(form_parser_t *parser, form_status_t status)
+{
+    if (parser->status == FORM_OK) {
+        parser->status = status;
+    }
+    return parser->status;
+}
+
+static form_field_t* find_field(form_parser_t *parser, const char *key)
+{
+    for (size_t i = 0; i < parser->field_count; i++) {
+        if (strcmp(parser->fields[i].key, key) == 0) {
+            return &parser->fields[i];
+        }
+    }
+    return NULL;
+}
+
+// Key complete: pick where the value will be decoded to
+static void begin_value(form_parser_t *parser)
+{
+    parser->key[parser->key_len] = '\0';
+    parser->field = find_field(parser, parser->key);
+    parser->discard = false;
+    parser->sink_len = 0;
+
+    if (parser->field && parser->field->type == FORM_FIELD_STRING && parser->field->size > 0) {
+        // Decode in place into the caller's buffer
+        parser->sink = parser->field->target;
+        parser->sink_size = parser->field->size;
+    } else if ((parser->field && parser->field->type != FORM_FIELD_STRING) ||
+               (!parser->field && parser->on_value)) {
+        parser->sink = parser->scratch;
+        parser->sink_size = sizeof(parser->scratch);
+    } else {
+        parser->discard = true;
+        parser->sink = NULL;
+        parser->sink_size = 0;
+    }
+    parser->in_value = true;
+}
+
+static form_status_t store_typed(form_field_t *field, const char *value)
+{
+    switch (field->type) {
+        case FORM_FIELD_INT: {
+            char *end = NULL;
+            long parsed = strtol(value, &end, 10);
+            if (end == value || *end != '\0' || parsed < INT32_MIN || parsed > INT32_MAX) {
+                return FORM_ERR_BAD_VALUE;
+            }
+            *(int32_t *)field->target = (int32_t)parsed;
+            return FORM_OK;
+        }
+        case FORM_FIELD_BOOL:
+            *(bool *)field->target = strcmp(value, "1") == 0 || strcmp(value, "on") == 0 ||
+                                     strcmp(value, "true") == 0;
+            return FORM_OK;
+        case FORM_FIELD_STRING:
+            return FORM_OK;  // Already decoded into target
+    }
+    return FORM_ERR_BAD_VALUE;
+}
+
+// Value complete (at '&' or end of body): dispatch it
+static form_status_t end_pair(form_parser_t *parser)
+{
+    if (parser->escape) {
+        return fail(parser, FORM_ERR_BAD_ESCAPE);
+    }
+    if (!parser->in_value) {
+        if (parser->key_len == 0) {
+            return FORM_OK;  // Empty pair ("&&" or trailing '&')
+        }
+        begin_value(parser);  // Key without '=' has an empty value
+    }
+
+    form_status_t status = FORM_OK;
+    if (!parser->discard) {
+        parser->sink[parser->sink_len] = '\0';
+        if (parser->field) {
+            parser->field->seen = true;
+            status = store_typed(parser->field, parser->sink);
+        } else {
+            status = parser->on_value(parser->ctx, parser->key, parser->sink);
+            if (status != FORM_OK) {
+                status = FORM_ERR_REJECTED;
+            }
+        }
+    }
+
+    parser->in_value = false;
+    parser->key_len = 0;
+    parser->field = NULL;
+    return status == FORM_OK ? FORM_OK : fail(parser, status);
+}
+
+// Append one decoded byte to the current key or value
+static form_status_t put_byte(form_parser_t *parser, char c)
+{
+    if (c == '\0') {
+        return fail(parser, FORM_ERR_BAD_ESCAPE);
+    }
+    if (!parser->in_value) {
+        if (parser->key_len >= FORM_MAX_KEY_LEN) {
+            return fail(parser, FORM_ERR_KEY_TOO_LONG);
+        }
+        parser->key[parser->key_len++] = c;
+        return FORM_OK;
+    }
+    if (parser->discard) {
+        return FORM_OK;
+    }
+    // Keep room for the terminator
+    if (parser->sink_len + 1 >= parser->sink_size) {
+        return fail(parser, FORM_ERR_VALUE_TOO_LONG);
+    }
+    parser->sink[parser->sink_len++] = c;
+    return FORM_OK;
+}
+
+void form_parser_init(form_parser_t *parser, form_field_t *fields, size_t field_count,
+                      form_value_cb_t on_value, void *ctx)
+{
+    memset(parser, 0, sizeof(*parser));
+    parser->fields = fields;
+    parser->field_count = fields ? field_count : 0;
+    parser->on_value = on_value;
+    parser->ctx = ctx;
+    for (size_t i = 0; i < parser->field_count; i++) {
+        fields[i].seen = false;
+    }
+}
+
+form_status_t form_parser_feed(form_parser_t *parser, const char *data, size_t len)
+{
+    for (size_t i = 0; i < len && parser->status == FORM_OK; i++) {
+        char c = data[i];
+
+        if (parser->escape) {
+            int digit = hex_value(c);
+            if (digit < 0) {
+                return fail(parser, FORM_ERR_BAD_ESCAPE);
+            }
+            if (parser->escape == 1) {
+                parser->escape_high = digit;
+                parser->escape = 2;
+            } else {
+                parser->escape = 0;
+                put_byte(parser, (char)((parser->escape_high << 4) | digit));
+            }
+            continue;
+        }
+
+        switch (c) {
+            case '&':
+                end_pair(parser);
+                break;
+            case '=':
+                if (!parser->in_value) {
+                    begin_value(parser);
+                } else {
+                    put_byte(parser, c);  // Unencoded '=' inside a value
+                }
+                break;
+            case '%':
+                parser->escape = 1;
+                break;
+            case '+':
+                put_byte(parser, ' ');
+                break;
+            default:
+                put_byte(parser, c);
+                break;
+        }
+    }
+    return parser->status;
+}
+
+form_status_t form_parser_finish(form_parser_t *parser)
+{
+    if (parser->status == FORM_OK) {
+        end_pair(parser);
+    }
+    return parser->status;
+}
+
+const char* form_status_name(form_status_t status)
+{
+    switch (status) {
+        case FORM_OK:                   return "OK";
+        case FORM_ERR_KEY_TOO_LONG:     return "key too long";
+        case FORM_ERR_VALUE_TOO_LONG:   return "value too long";
+        case FORM_ERR_BAD_ESCAPE:       return "bad escape";
+        case FORM_ERR_BAD_VALUE:        return "bad value";
+        case FORM_ERR_REJECTED:         return "rejected";
+        default:                        return "unknown";
+    }
+}
@@ -0,0 +1,121 @@
+/**
+ * Form Parser
+ * Incremental application/x-www-form-urlencoded parser for POST bodies
+ *
+ * The body is fed in whatever chunks httpd_req_recv() returns and walked
+ * once. Keys are matched exactly (so "pass" never matches "password"),
+ * values are percent-decoded straight into the caller's buffers, and each
+ * field has its own size limit - an over-long value is an error, never
+ * silently truncated.
+ *
+ * Pure C with no ESP-IDF dependencies so it can be fuzzed on a host.
+ */
+
+#ifndef FORM_PARSER_H
+#define FORM_PARSER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Longest accepted key
+#define FORM_MAX_KEY_LEN        31
+
+// Longest value for FORM_FIELD_INT/BOOL fields and the generic callback
+#define FORM_MAX_VALUE_LEN      63
+
+/**
+ * Parse status
+ */
+typedef enum {
+    FORM_OK = 0,
+    FORM_ERR_KEY_TOO_LONG,
+    FORM_ERR_VALUE_TOO_LONG,
+    FORM_ERR_BAD_ESCAPE,        // Malformed %XX or encoded NUL
+    FORM_ERR_BAD_VALUE,         // Typed field didn't parse
+    FORM_ERR_REJECTED,          // Callback rejected a value
+} form_status_t;
+
+/**
+ * Field value types
+ */
+typedef enum {
+    FORM_FIELD_STRING,      // target: char[size], NUL terminated
+    FORM_FIELD_INT,         // target: int32_t
+    FORM_FIELD_BOOL,        // target: bool ("1", "on", "true" are true)
+} form_field_type_t;
+
+/**
+ * Known field
+ */
+typedef struct {
+    const char *key;
+    form_field_type_t type;
+    void *target;
+    size_t size;            // FORM_FIELD_STRING: buffer size including terminator
+    bool seen;              // Set by the parser when the field was present
+} form_field_t;
+
+/**
+ * Callback for keys not in the field table
+ * @return FORM_OK to continue, anything else aborts parsing
+ */
+typedef form_status_t (*form_value_cb_t)(void *ctx, const char *key, const char *value);
+
+/**
+ * Parser state (caller allocated, typically on the stack)
+ */
+typedef struct {
+    form_field_t *fields;
+    size_t field_count;
+    form_value_cb_t on_value;
+    void *ctx;
+
+    form_status_t status;
+    bool in_value;
+    uint8_t escape;             // 0 = none, 1 = after '%', 2 = after first hex digit
+    uint8_t escape_high;
+
+    char key[FORM_MAX_KEY_LEN + 1];
+    size_t key_len;
+
+    form_field_t *field;        // Field receiving the current value (NULL: scratch/ignored)
+    bool discard;               // Current value is not wanted
+    char *sink;                 // Where decoded value bytes go
+    size_t sink_size;
+    size_t sink_len;
+    char scratch[FORM_MAX_VALUE_LEN + 1];
+} form_parser_t;
+
+/**
+ * Initialize a parser
+ * Clears the seen flags of all fields. String targets are only written
+ * when the field is present.
+ *
+ * @param parser Parser
+ * @param fields Known fields (may be NULL)
+ * @param field_count Number of fields
+ * @param on_value Callback for other keys (NULL: ignore them)
+ * @param ctx Callback context
+ */
+void form_parser_init(form_parser_t *parser, form_field_t *fields, size_t field_count,
+                      form_value_cb_t on_value, void *ctx);
+
+/**
+ * Feed the next chunk of the body
+ * @return FORM_OK, or the first error (sticky - later chunks are ignored)
+ */
+form_status_t form_parser_feed(form_parser_t *parser, const char *data, size_t len);
+
+/**
+ * Complete parsing after the last chunk
+ * @return FORM_OK or the first error
+ */
+form_status_t form_parser_finish(form_parser_t *parser);
+
+/**
+ * Get status name
+ */
+const char* form_status_name(form_status_t status);
+
+#endif // FORM_PARSER_H
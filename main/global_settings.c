@@ -6,29 +6,338 @@
 #include "esp_log.h"
 #include "nvs_flash.h"
 #include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include <math.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 static const char *TAG = "GLOBAL_SETTINGS";
 
 #define SETTINGS_NAMESPACE "global_cfg"
 #define SETTINGS_KEY "settings"
 
-esp_err_t global_settings_save(const global_settings_t *settings)
+// Compact record blob: [magic][format][schema version][count] then per field [id][4-byte LE value]
+#define SETTINGS_BLOB_MAGIC     0xA5
+#define SETTINGS_BLOB_FORMAT    1
+#define SETTINGS_HEADER_SIZE    4
+#define SETTINGS_RECORD_SIZE    5
+
+#define FIELD(field) offsetof(global_settings_t, field)
+
+/**
+ * Settings schema
+ * New fields must be appended with a new id and since_version = GLOBAL_SETTINGS_VERSION.
+ * Order matters for legacy (raw struct) blobs, which were laid out in this order.
+ */
+static const global_setting_field_t settings_schema[] = {
+    { 1, "interval",           GLOBAL_SETTING_U32,   FIELD(librelink_interval_minutes), DEFAULT_LIBRELINK_INTERVAL_MINUTES, 1.0f, 60.0f, 1 },
+    { 2, "moon_lamp",          GLOBAL_SETTING_BOOL,  FIELD(moon_lamp_enabled),          DEFAULT_MOON_LAMP_ENABLED,          0.0f, 1.0f,  2 },
+    { 3, "glucose_low",        GLOBAL_SETTING_FLOAT, FIELD(glucose_low_threshold),      DEFAULT_GLUCOSE_LOW_THRESHOLD,      1.0f, 20.0f, 3 },
+    { 4, "glucose_high",       GLOBAL_SETTING_FLOAT, FIELD(glucose_high_threshold),     DEFAULT_GLUCOSE_HIGH_THRESHOLD,     5.0f, 30.0f, 3 },
+    { 5, "alarm_enabled",      GLOBAL_SETTING_BOOL,  FIELD(alarm_enabled),              DEFAULT_ALARM_ENABLED,              0.0f, 1.0f,  4 },
+    { 6, "alarm_snooze",       GLOBAL_SETTING_U32,   FIELD(alarm_snooze_minutes),       DEFAULT_ALARM_SNOOZE_MINUTES,       1.0f, 60.0f, 4 },
+    { 7, "alarm_low_enabled",  GLOBAL_SETTING_BOOL,  FIELD(alarm_low_enabled),          DEFAULT_ALARM_LOW_ENABLED,          0.0f, 1.0f,  5 },
+    { 8, "alarm_high_enabled", GLOBAL_SETTING_BOOL,  FIELD(alarm_high_enabled),         DEFAULT_ALARM_HIGH_ENABLED,         0.0f, 1.0f,  5 },
+    { 9, "lan_share",          GLOBAL_SETTING_BOOL,  FIELD(lan_share_enabled),          DEFAULT_LAN_SHARE_ENABLED,          0.0f, 1.0f,  7 },
+    { 10, "screen_dim",        GLOBAL_SETTING_U32,   FIELD(screen_dim_minutes),         DEFAULT_SCREEN_DIM_MINUTES,         0.0f, 120.0f, 8 },
+    { 11, "screen_off",        GLOBAL_SETTING_U32,   FIELD(screen_off_minutes),         DEFAULT_SCREEN_OFF_MINUTES,         0.0f, 720.0f, 8 },
+    { 12, "night_mode",        GLOBAL_SETTING_BOOL,  FIELD(night_mode_enabled),         DEFAULT_NIGHT_MODE_ENABLED,         0.0f, 1.0f,  8 },
+    { 13, "night_start",       GLOBAL_SETTING_U32,   FIELD(night_start_hour),           DEFAULT_NIGHT_START_HOUR,           0.0f, 23.0f, 8 },
+    { 14, "night_end",         GLOBAL_SETTING_U32,   FIELD(night_end_hour),             DEFAULT_NIGHT_END_HOUR,             0.0f, 23.0f, 8 },
+    { 15, "utc_offset",        GLOBAL_SETTING_I32,   FIELD(utc_offset_minutes),         DEFAULT_UTC_OFFSET_MINUTES,         -720.0f, 840.0f, 9 },
+};
+
+#define SETTINGS_FIELD_COUNT (sizeof(settings_schema) / sizeof(settings_schema[0]))
+#define SETTINGS_BLOB_MAX_SIZE (SETTINGS_HEADER_SIZE + SETTINGS_FIELD_COUNT * SETTINGS_RECORD_SIZE)
+
+// In-RAM copy of the stored settings (NVS is only read once per boot)
+static global_settings_t cached_settings;
+static bool cache_valid = false;
+static portMUX_TYPE cache_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * Field accessors - values travel through the codec as raw 32-bit words
+ */
+static uint32_t field_get_raw(const global_settings_t *settings, const global_setting_field_t *field)
 {
-    if (!settings) {
-        return ESP_ERR_INVALID_ARG;
+    const uint8_t *base = (const uint8_t *)settings + field->offset;
+    uint32_t raw = 0;
+
+    switch (field->type) {
+        case GLOBAL_SETTING_BOOL:
+            raw = *(const bool *)base ? 1 : 0;
+            break;
+        case GLOBAL_SETTING_U32:
+        case GLOBAL_SETTING_FLOAT:
+        case GLOBAL_SETTING_I32:
+            memcpy(&raw, base, sizeof(raw));
+            break;
     }
-    
-    // Create a copy and ensure version is set
-    global_settings_t settings_copy = *settings;
-    settings_copy.version = GLOBAL_SETTINGS_VERSION;
+    return raw;
+}
 
-    // Validate settings
-    if (settings_copy.librelink_interval_minutes < 1) {
-        ESP_LOGE(TAG, "Invalid interval: %lu (must be >= 1)", settings_copy.librelink_interval_minutes);
-        return ESP_ERR_INVALID_ARG;
+static bool field_in_range(const global_setting_field_t *field, uint32_t raw)
+{
+    switch (field->type) {
+        case GLOBAL_SETTING_BOOL:
+            return raw <= 1;
+        case GLOBAL_SETTING_U32:
+            return raw >= (uint32_t)field->min_value && raw <= (uint32_t)field->max_value;
+        case GLOBAL_SETTING_FLOAT: {
+            float value;
+            memcpy(&value, &raw, sizeof(value));
+            // NaN fails both comparisons
+            return value >= field->min_value && value <= field->max_value;
+        }
+        case GLOBAL_SETTING_I32:
+            return (int32_t)raw >= (int32_t)field->min_value && (int32_t)raw <= (int32_t)field->max_value;
     }
+    return false;
+}
+
+static void field_set_default(global_settings_t *settings, const global_setting_field_t *field)
+{
+    uint8_t *base = (uint8_t *)settings + field->offset;
+
+    switch (field->type) {
+        case GLOBAL_SETTING_BOOL:
+            *(bool *)base = field->default_value != 0.0f;
+            break;
+        case GLOBAL_SETTING_U32: {
+            uint32_t value = (uint32_t)field->default_value;
+            memcpy(base, &value, sizeof(value));
+            break;
+        }
+        case GLOBAL_SETTING_FLOAT:
+            memcpy(base, &field->default_value, sizeof(float));
+            break;
+        case GLOBAL_SETTING_I32: {
+            int32_t value = (int32_t)field->default_value;
+            memcpy(base, &value, sizeof(value));
+            break;
+        }
+    }
+}
+
+/**
+ * Set a field from a raw 32-bit value, falling back to the default if out of range
+ * @return true if the value was accepted
+ */
+static bool field_set_raw(global_settings_t *settings, const global_setting_field_t *field, uint32_t raw)
+{
+    if (!field_in_range(field, raw)) {
+        field_set_default(settings, field);
+        return false;
+    }
+
+    uint8_t *base = (uint8_t *)settings + field->offset;
+    if (field->type == GLOBAL_SETTING_BOOL) {
+        *(bool *)base = (raw != 0);
+    } else {
+        memcpy(base, &raw, sizeof(raw));
+    }
+    return true;
+}
+
+/**
+ * Set a field from a stored raw 32-bit value
+ * Stored values were accepted by the firmware that wrote them (older
+ * releases had wider or no limits), so out-of-range values are clamped
+ * to the nearest bound instead of being reset to the default.
+ * @return true if the stored value was changed
+ */
+static bool field_restore_raw(global_settings_t *settings, const global_setting_field_t *field, uint32_t raw)
+{
+    if (field_in_range(field, raw)) {
+        field_set_raw(settings, field, raw);
+        return false;
+    }
+
+    uint32_t clamped = raw;
+    switch (field->type) {
+        case GLOBAL_SETTING_BOOL:
+            clamped = 1;
+            break;
+        case GLOBAL_SETTING_U32:
+            clamped = raw < (uint32_t)field->min_value ? (uint32_t)field->min_value : (uint32_t)field->max_value;
+            break;
+        case GLOBAL_SETTING_FLOAT: {
+            float value;
+            memcpy(&value, &raw, sizeof(value));
+            if (isnan(value)) {
+                field_set_default(settings, field);
+                ESP_LOGW(TAG, "Stored %s is not a number, using default %.1f", field->key, field->default_value);
+                return true;
+            }
+            float bound = value < field->min_value ? field->min_value : field->max_value;
+            ESP_LOGW(TAG, "Stored %s %.1f out of range, clamped to %.1f", field->key, value, bound);
+            memcpy(&clamped, &bound, sizeof(clamped));
+            field_set_raw(settings, field, clamped);
+            return true;
+        }
+        case GLOBAL_SETTING_I32: {
+            int32_t bound = (int32_t)raw < (int32_t)field->min_value ? (int32_t)field->min_value
+                                                                   : (int32_t)field->max_value;
+            ESP_LOGW(TAG, "Stored %s %ld out of range, clamped to %ld", field->key, (int32_t)raw, bound);
+            field_set_raw(settings, field, (uint32_t)bound);
+            return true;
+        }
+    }
+
+    ESP_LOGW(TAG, "Stored %s %lu out of range, clamped to %lu", field->key, raw, clamped);
+    field_set_raw(settings, field, clamped);
+    return true;
+}
+
+static const global_setting_field_t* find_field_by_id(uint8_t id)
+{
+    for (size_t i = 0; i < SETTINGS_FIELD_COUNT; i++) {
+        if (settings_schema[i].id == id) {
+            return &settings_schema[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Encode settings into the compact record blob
+ * @return Encoded size in bytes
+ */
+static size_t settings_encode(const global_settings_t *settings, uint8_t *blob)
+{
+    blob[0] = SETTINGS_BLOB_MAGIC;
+    blob[1] = SETTINGS_BLOB_FORMAT;
+    blob[2] = GLOBAL_SETTINGS_VERSION;
+    blob[3] = SETTINGS_FIELD_COUNT;
+
+    uint8_t *p = blob + SETTINGS_HEADER_SIZE;
+    for (size_t i = 0; i < SETTINGS_FIELD_COUNT; i++) {
+        uint32_t raw = field_get_raw(settings, &settings_schema[i]);
+        p[0] = settings_schema[i].id;
+        p[1] = raw & 0xFF;
+        p[2] = (raw >> 8) & 0xFF;
+        p[3] = (raw >> 16) & 0xFF;
+        p[4] = (raw >> 24) & 0xFF;
+        p += SETTINGS_RECORD_SIZE;
+    }
+    return p - blob;
+}
+
+/**
+ * Decode a compact record blob on top of defaults
+ * Unknown record ids (written by newer firmware) are skipped
+ * @param[out] adjusted Set if a stored value had to be clamped
+ */
+static esp_err_t settings_decode(const uint8_t *blob, size_t len, global_settings_t *settings, bool *adjusted)
+{
+    if (len < SETTINGS_HEADER_SIZE || blob[0] != SETTINGS_BLOB_MAGIC || blob[1] != SETTINGS_BLOB_FORMAT) {
+        return ESP_ERR_INVALID_VERSION;
+    }
+
+    size_t count = blob[3];
+    if (len < SETTINGS_HEADER_SIZE + count * SETTINGS_RECORD_SIZE) {
+        ESP_LOGW(TAG, "Settings blob truncated (%d bytes, %d records)", len, count);
+        count = (len - SETTINGS_HEADER_SIZE) / SETTINGS_RECORD_SIZE;
+    }
+
+    const uint8_t *p = blob + SETTINGS_HEADER_SIZE;
+    for (size_t i = 0; i < count; i++, p += SETTINGS_RECORD_SIZE) {
+        const global_setting_field_t *field = find_field_by_id(p[0]);
+        if (!field) {
+            ESP_LOGD(TAG, "Skipping unknown settings record id %d", p[0]);
+            continue;
+        }
+        uint32_t raw = p[1] | (p[2] << 8) | (p[3] << 16) | ((uint32_t)p[4] << 24);
+        if (field_restore_raw(settings, field, raw)) {
+            *adjusted = true;
+        }
+    }
+
+    if (blob[2] != GLOBAL_SETTINGS_VERSION) {
+        ESP_LOGI(TAG, "Settings schema version %d migrated to %d", blob[2], GLOBAL_SETTINGS_VERSION);
+    }
+    return ESP_OK;
+}
+
+/**
+ * Decode a legacy blob (raw global_settings_t from firmware before the record format)
+ * The layout for a given version is rebuilt from the schema: fields with
+ * since_version <= stored version, in table order, with natural C alignment.
+ * Values are clamped like record blobs (see field_restore_raw).
+ */
+static esp_err_t settings_decode_legacy(const uint8_t *blob, size_t len, global_settings_t *settings)
+{
+    if (len < sizeof(uint32_t)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    uint32_t stored_version;
+    memcpy(&stored_version, blob, sizeof(stored_version));
+    if (stored_version == 0 || stored_version >= GLOBAL_SETTINGS_VERSION) {
+        return ESP_ERR_INVALID_VERSION;
+    }
+
+    // First pass: compute legacy offsets and check the blob size matches
+    size_t offsets[SETTINGS_FIELD_COUNT];
+    size_t offset = sizeof(uint32_t);
+    for (size_t i = 0; i < SETTINGS_FIELD_COUNT; i++) {
+        if (settings_schema[i].since_version > stored_version) {
+            offsets[i] = SIZE_MAX;
+            continue;
+        }
+        size_t field_size = (settings_schema[i].type == GLOBAL_SETTING_BOOL) ? sizeof(bool) : sizeof(uint32_t);
+        offset = (offset + field_size - 1) & ~(field_size - 1);
+        offsets[i] = offset;
+        offset += field_size;
+    }
+    size_t expected_len = (offset + sizeof(uint32_t) - 1) & ~(sizeof(uint32_t) - 1);
+    if (len != expected_len) {
+        ESP_LOGW(TAG, "Legacy settings v%lu has unexpected size %d (expected %d)",
+                 stored_version, len, expected_len);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    // Second pass: copy the fields that existed in that version
+    for (size_t i = 0; i < SETTINGS_FIELD_COUNT; i++) {
+        if (offsets[i] == SIZE_MAX) {
+            continue;
+        }
+        uint32_t raw = 0;
+        if (settings_schema[i].type == GLOBAL_SETTING_BOOL) {
+            raw = blob[offsets[i]] ? 1 : 0;
+        } else {
+            memcpy(&raw, blob + offsets[i], sizeof(raw));
+        }
+        field_restore_raw(settings, &settings_schema[i], raw);
+    }
+
+    ESP_LOGI(TAG, "Migrated legacy settings v%lu to v%d", stored_version, GLOBAL_SETTINGS_VERSION);
+    return ESP_OK;
+}
+
+static void cache_store(const global_settings_t *settings)
+{
+    taskENTER_CRITICAL(&cache_lock);
+    cached_settings = *settings;
+    cache_valid = true;
+    taskEXIT_CRITICAL(&cache_lock);
+}
 
+static void cache_invalidate(void)
+{
+    taskENTER_CRITICAL(&cache_lock);
+    cache_valid = false;
+    taskEXIT_CRITICAL(&cache_lock);
+}
+
+/**
+ * Write an encoded blob and commit, skipping the write if NVS already holds it
+ */
+static esp_err_t settings_write_blob(const uint8_t *blob, size_t len)
+{
     nvs_handle_t handle;
     esp_err_t err = nvs_open(SETTINGS_NAMESPACE, NVS_READWRITE, &handle);
     if (err != ESP_OK) {
@@ -36,88 +345,145 @@ esp_err_t global_settings_save(const global_settings_t *settings)
         return err;
     }
 
-    // Save settings as blob
-    err = nvs_set_blob(handle, SETTINGS_KEY, &settings_copy, sizeof(global_settings_t));
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to set settings: %s", esp_err_to_name(err));
+    uint8_t stored[SETTINGS_BLOB_MAX_SIZE];
+    size_t stored_len = sizeof(stored);
+    if (nvs_get_blob(handle, SETTINGS_KEY, stored, &stored_len) == ESP_OK &&
+        stored_len == len && memcmp(stored, blob, len) == 0) {
+        ESP_LOGD(TAG, "Settings unchanged, skipping NVS write");
         nvs_close(handle);
-        return err;
+        return ESP_OK;
     }
 
-    err = nvs_commit(handle);
+    err = nvs_set_blob(handle, SETTINGS_KEY, blob, len);
+    if (err == ESP_OK) {
+        err = nvs_commit(handle);
+    }
     if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to commit: %s", esp_err_to_name(err));
-    } else {
-        ESP_LOGI(TAG, "Settings saved: interval=%lu min, moon_lamp=%s, low=%.1f, high=%.1f, alarm=%s, snooze=%lu min, low_alarm=%s, high_alarm=%s", 
-                 settings->librelink_interval_minutes,
-                 settings->moon_lamp_enabled ? "enabled" : "disabled",
-                 settings->glucose_low_threshold,
-                 settings->glucose_high_threshold,
-                 settings->alarm_enabled ? "enabled" : "disabled",
-                 settings->alarm_snooze_minutes,
-                 settings->alarm_low_enabled ? "enabled" : "disabled",
-                 settings->alarm_high_enabled ? "enabled" : "disabled");
+        ESP_LOGE(TAG, "Failed to write settings: %s", esp_err_to_name(err));
     }
 
     nvs_close(handle);
     return err;
 }
 
+void global_settings_set_defaults(global_settings_t *settings)
+{
+    memset(settings, 0, sizeof(*settings));
+    settings->version = GLOBAL_SETTINGS_VERSION;
+    for (size_t i = 0; i < SETTINGS_FIELD_COUNT; i++) {
+        field_set_default(settings, &settings_schema[i]);
+    }
+}
+
+const global_setting_field_t* global_settings_get_schema(size_t *count)
+{
+    if (count) {
+        *count = SETTINGS_FIELD_COUNT;
+    }
+    return settings_schema;
+}
+
+esp_err_t global_settings_save(const global_settings_t *settings)
+{
+    if (!settings) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Validate settings against the schema
+    for (size_t i = 0; i < SETTINGS_FIELD_COUNT; i++) {
+        if (!field_in_range(&settings_schema[i], field_get_raw(settings, &settings_schema[i]))) {
+            ESP_LOGE(TAG, "Invalid %s (out of range %.1f-%.1f)", settings_schema[i].key,
+                     settings_schema[i].min_value, settings_schema[i].max_value);
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+
+    global_settings_t settings_copy = *settings;
+    settings_copy.version = GLOBAL_SETTINGS_VERSION;
+
+    uint8_t blob[SETTINGS_BLOB_MAX_SIZE];
+    size_t len = settings_encode(&settings_copy, blob);
+
+    esp_err_t err = settings_write_blob(blob, len);
+    if (err == ESP_OK) {
+        cache_store(&settings_copy);
+        ESP_LOGI(TAG, "Settings saved: interval=%lu min, moon_lamp=%s, low=%.1f, high=%.1f, alarm=%s, snooze=%lu min, low_alarm=%s, high_alarm=%s",
+                 settings_copy.librelink_interval_minutes,
+                 settings_copy.moon_lamp_enabled ? "enabled" : "disabled",
+                 settings_copy.glucose_low_threshold,
+                 settings_copy.glucose_high_threshold,
+                 settings_copy.alarm_enabled ? "enabled" : "disabled",
+                 settings_copy.alarm_snooze_minutes,
+                 settings_copy.alarm_low_enabled ? "enabled" : "disabled",
+                 settings_copy.alarm_high_enabled ? "enabled" : "disabled");
+    }
+
+    return err;
+}
+
 esp_err_t global_settings_load(global_settings_t *settings)
 {
     if (!settings) {
         return ESP_ERR_INVALID_ARG;
     }
 
+    // Serve from RAM after the first load
+    taskENTER_CRITICAL(&cache_lock);
+    bool hit = cache_valid;
+    if (hit) {
+        *settings = cached_settings;
+    }
+    taskEXIT_CRITICAL(&cache_lock);
+    if (hit) {
+        return ESP_OK;
+    }
+
     // Set defaults first
-    settings->version = GLOBAL_SETTINGS_VERSION;
-    settings->librelink_interval_minutes = DEFAULT_LIBRELINK_INTERVAL_MINUTES;
-    settings->moon_lamp_enabled = DEFAULT_MOON_LAMP_ENABLED;
-    settings->glucose_low_threshold = DEFAULT_GLUCOSE_LOW_THRESHOLD;
-    settings->glucose_high_threshold = DEFAULT_GLUCOSE_HIGH_THRESHOLD;
-    settings->alarm_enabled = DEFAULT_ALARM_ENABLED;
-    settings->alarm_snooze_minutes = DEFAULT_ALARM_SNOOZE_MINUTES;
-    settings->alarm_low_enabled = DEFAULT_ALARM_LOW_ENABLED;
-    settings->alarm_high_enabled = DEFAULT_ALARM_HIGH_ENABLED;
+    global_settings_set_defaults(settings);
 
     nvs_handle_t handle;
     esp_err_t err = nvs_open(SETTINGS_NAMESPACE, NVS_READONLY, &handle);
     if (err != ESP_OK) {
         if (err == ESP_ERR_NVS_NOT_FOUND) {
             ESP_LOGI(TAG, "No settings found, using defaults");
+            cache_store(settings);
             return ESP_OK;  // Return OK with defaults
         }
         ESP_LOGE(TAG, "Failed to open NVS: %s", esp_err_to_name(err));
         return err;
     }
 
-    size_t required_size = sizeof(global_settings_t);
-    err = nvs_get_blob(handle, SETTINGS_KEY, settings, &required_size);
+    // Large enough for both the record format and any legacy struct
+    uint8_t blob[SETTINGS_BLOB_MAX_SIZE + sizeof(global_settings_t)];
+    size_t len = sizeof(blob);
+    err = nvs_get_blob(handle, SETTINGS_KEY, blob, &len);
+    nvs_close(handle);
+
     if (err != ESP_OK) {
         if (err == ESP_ERR_NVS_NOT_FOUND) {
             ESP_LOGI(TAG, "No settings found, using defaults");
-            nvs_close(handle);
+            cache_store(settings);
             return ESP_OK;  // Return OK with defaults
         }
         ESP_LOGE(TAG, "Failed to get settings: %s", esp_err_to_name(err));
-        nvs_close(handle);
         return err;
     }
-    
-    // Check version - if mismatch, use defaults and save new version
-    if (settings->version != GLOBAL_SETTINGS_VERSION) {
-        ESP_LOGW(TAG, "Settings version mismatch (stored: %lu, current: %d), resetting to defaults",
-                 settings->version, GLOBAL_SETTINGS_VERSION);
-        // Keep defaults already set, just update version
-        nvs_close(handle);
-        // Save new defaults with correct version
-        return global_settings_save(settings);
+
+    bool migrated = false;
+    if (settings_decode(blob, len, settings, &migrated) == ESP_OK) {
+        migrated |= (blob[2] != GLOBAL_SETTINGS_VERSION);
+    } else if (settings_decode_legacy(blob, len, settings) == ESP_OK) {
+        migrated = true;
+    } else {
+        ESP_LOGW(TAG, "Unrecognised settings blob (%d bytes), using defaults", len);
+        global_settings_set_defaults(settings);
     }
 
-    // Validate loaded settings
-    if (settings->librelink_interval_minutes < 1) {
-        ESP_LOGW(TAG, "Invalid interval loaded, resetting to default");
-        settings->librelink_interval_minutes = DEFAULT_LIBRELINK_INTERVAL_MINUTES;
+    cache_store(settings);
+
+    // Rewrite once in the current format (with any clamped values) so migration only runs on the first boot
+    if (migrated) {
+        global_settings_save(settings);
     }
 
     ESP_LOGI(TAG, "Settings loaded: interval=%lu min, moon_lamp=%s, low=%.1f, high=%.1f",
@@ -126,7 +492,106 @@ esp_err_t global_settings_load(global_settings_t *settings)
              settings->glucose_low_threshold,
              settings->glucose_high_threshold);
 
-    nvs_close(handle);
+    return ESP_OK;
+}
+
+int global_settings_to_json(const global_settings_t *settings, char *buffer, size_t buffer_size)
+{
+    if (!settings || !buffer || buffer_size == 0) {
+        return -1;
+    }
+
+    size_t offset = 0;
+    buffer[0] = '\0';
+
+    for (size_t i = 0; i < SETTINGS_FIELD_COUNT; i++) {
+        const global_setting_field_t *field = &settings_schema[i];
+        const uint8_t *base = (const uint8_t *)settings + field->offset;
+        int written = 0;
+
+        switch (field->type) {
+            case GLOBAL_SETTING_BOOL:
+                written = snprintf(buffer + offset, buffer_size - offset, "%s\"%s\":%s",
+                                   i ? "," : "", field->key, *(const bool *)base ? "true" : "false");
+                break;
+            case GLOBAL_SETTING_U32:
+                written = snprintf(buffer + offset, buffer_size - offset, "%s\"%s\":%lu",
+                                   i ? "," : "", field->key, *(const uint32_t *)base);
+                break;
+            case GLOBAL_SETTING_FLOAT:
+                written = snprintf(buffer + offset, buffer_size - offset, "%s\"%s\":%.1f",
+                                   i ? "," : "", field->key, *(const float *)base);
+                break;
+            case GLOBAL_SETTING_I32:
+                written = snprintf(buffer + offset, buffer_size - offset, "%s\"%s\":%ld",
+                                   i ? "," : "", field->key, *(const int32_t *)base);
+                break;
+        }
+
+        if (written < 0 || (size_t)written >= buffer_size - offset) {
+            return -1;
+        }
+        offset += written;
+    }
+
+    return (int)offset;
+}
+
+void global_settings_form_begin(global_settings_t *settings)
+{
+    global_settings_set_defaults(settings);
+
+    // Checkboxes are only submitted when checked
+    for (size_t i = 0; i < SETTINGS_FIELD_COUNT; i++) {
+        if (settings_schema[i].type == GLOBAL_SETTING_BOOL) {
+            field_set_raw(settings, &settings_schema[i], 0);
+        }
+    }
+}
+
+esp_err_t global_settings_form_field(global_settings_t *settings, const char *key, const char *value)
+{
+    if (!settings || !key || !value) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    const global_setting_field_t *field = NULL;
+    for (size_t i = 0; i < SETTINGS_FIELD_COUNT; i++) {
+        if (strcmp(settings_schema[i].key, key) == 0) {
+            field = &settings_schema[i];
+            break;
+        }
+    }
+    if (!field) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    if (field->type == GLOBAL_SETTING_BOOL) {
+        field_set_raw(settings, field, strcmp(value, "1") == 0 ? 1 : 0);
+        return ESP_OK;
+    }
+
+    if (value[0] == '\0') {
+        return ESP_OK;  // Keep default
+    }
+
+    char *end = NULL;
+    uint32_t raw;
+    if (field->type == GLOBAL_SETTING_U32) {
+        long parsed = strtol(value, &end, 10);
+        raw = parsed < 0 ? UINT32_MAX : (uint32_t)parsed;
+    } else if (field->type == GLOBAL_SETTING_I32) {
+        long long parsed = strtoll(value, &end, 10);
+        // Anything past the int32 range is past the field's range too
+        raw = (uint32_t)(int32_t)(parsed < INT32_MIN ? INT32_MIN : parsed > INT32_MAX ? INT32_MAX : parsed);
+    } else {
+        float parsed = strtof(value, &end);
+        memcpy(&raw, &parsed, sizeof(raw));
+    }
+    if (end == value || *end != '\0' || !field_set_raw(settings, field, raw)) {
+        field_set_default(settings, field);
+        ESP_LOGW(TAG, "Invalid %s value '%s', using default", field->key, value);
+    }
     return ESP_OK;
 }
 
@@ -142,7 +607,7 @@ bool global_settings_exist(void)
     err = nvs_get_blob(handle, SETTINGS_KEY, NULL, &required_size);
     nvs_close(handle);
 
-    return (err == ESP_OK && required_size == sizeof(global_settings_t));
+    return (err == ESP_OK && required_size > 0);
 }
 
 esp_err_t global_settings_clear(void)
@@ -163,9 +628,25 @@ esp_err_t global_settings_clear(void)
     }
 
     nvs_close(handle);
+    cache_invalidate();
     return err;
 }
 
+void global_settings_apply_timezone(void)
+{
+    global_settings_t settings;
+    global_settings_load(&settings);
+
+    // POSIX TZ counts west of Greenwich as positive: UTC+5:30 is "UTC-5:30"
+    int32_t offset = settings.utc_offset_minutes;
+    int32_t minutes = offset < 0 ? -offset : offset;
+    char tz[16];
+    snprintf(tz, sizeof(tz), "UTC%c%ld:%02ld", offset > 0 ? '-' : '+', minutes / 60, minutes % 60);
+    setenv("TZ", tz, 1);
+    tzset();
+    ESP_LOGI(TAG, "Time zone %s (UTC offset %+ld min)", tz, offset);
+}
+
 uint32_t global_settings_get_interval_ms(void)
 {
     global_settings_t settings;
@@ -183,3 +664,12 @@ bool global_settings_is_moon_lamp_enabled(void)
     }
     return settings.moon_lamp_enabled;
 }
+
+bool global_settings_is_lan_share_enabled(void)
+{
+    global_settings_t settings;
+    if (global_settings_load(&settings) != ESP_OK) {
+        return DEFAULT_LAN_SHARE_ENABLED;
+    }
+    return settings.lan_share_enabled;
+}
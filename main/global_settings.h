@@ -19,9 +19,43 @@
 #define DEFAULT_ALARM_SNOOZE_MINUTES 5
 #define DEFAULT_ALARM_LOW_ENABLED true
 #define DEFAULT_ALARM_HIGH_ENABLED false
+#define DEFAULT_LAN_SHARE_ENABLED false
+#define DEFAULT_SCREEN_DIM_MINUTES 5
+#define DEFAULT_SCREEN_OFF_MINUTES 0
+#define DEFAULT_NIGHT_MODE_ENABLED false
+#define DEFAULT_NIGHT_START_HOUR 22
+#define DEFAULT_NIGHT_END_HOUR 7
+#define DEFAULT_UTC_OFFSET_MINUTES 0
 
-// Settings version - increment when structure changes
-#define GLOBAL_SETTINGS_VERSION 5
+// Settings version - increment when a field is added to the schema table
+// Older stored settings are migrated field by field, never reset
+#define GLOBAL_SETTINGS_VERSION 9
+
+/**
+ * Value types supported by the settings schema
+ */
+typedef enum {
+    GLOBAL_SETTING_U32 = 0,
+    GLOBAL_SETTING_BOOL,
+    GLOBAL_SETTING_FLOAT,
+    GLOBAL_SETTING_I32,
+} global_setting_type_t;
+
+/**
+ * Schema entry describing a single settings field
+ * The schema table drives the NVS codec, the /settings/load JSON
+ * and the /settings/save form fields
+ */
+typedef struct {
+    uint8_t id;                   // Stable record id in NVS (never reuse or renumber)
+    const char *key;              // JSON and form field name
+    global_setting_type_t type;   // Value type
+    size_t offset;                // Offset of the field in global_settings_t
+    float default_value;          // Value used when missing (stored values out of range are clamped)
+    float min_value;              // Inclusive lower bound
+    float max_value;              // Inclusive upper bound
+    uint32_t since_version;       // GLOBAL_SETTINGS_VERSION that introduced the field
+} global_setting_field_t;
 
 /**
  * Global settings structure
@@ -36,22 +70,74 @@ typedef struct {
     uint32_t alarm_snooze_minutes;        // Alarm snooze duration in minutes (1-60)
     bool alarm_low_enabled;               // Enable/disable LOW glucose alarm
     bool alarm_high_enabled;              // Enable/disable HIGH glucose alarm
+    bool lan_share_enabled;               // Share one LibreLinkUp poll between monitors on the LAN
+    uint32_t screen_dim_minutes;          // Idle time before the backlight dims (0 = never)
+    uint32_t screen_off_minutes;          // Idle time before the backlight turns off (0 = never)
+    bool night_mode_enabled;              // Dim by default and turn off sooner during the night hours
+    uint32_t night_start_hour;            // First night hour (0-23)
+    uint32_t night_end_hour;              // First day hour (0-23)
+    int32_t utc_offset_minutes;           // Local time minus UTC (-720 to 840)
 } global_settings_t;
 
 /**
  * Save global settings to NVS
+ * Writes a single compact record blob and skips the write when nothing changed
  * @param settings Settings structure to save
  * @return ESP_OK on success
  */
 esp_err_t global_settings_save(const global_settings_t *settings);
 
 /**
- * Load global settings from NVS
+ * Load global settings
+ * Reads NVS once and serves later calls from RAM. Settings stored by
+ * older firmware are migrated field by field.
  * @param settings Output buffer for settings
  * @return ESP_OK on success, uses defaults if not found
  */
 esp_err_t global_settings_load(global_settings_t *settings);
 
+/**
+ * Fill settings structure with schema defaults
+ * @param settings Output buffer for settings
+ */
+void global_settings_set_defaults(global_settings_t *settings);
+
+/**
+ * Get the settings schema table
+ * @param count Output for number of entries (can be NULL)
+ * @return Pointer to the schema table
+ */
+const global_setting_field_t* global_settings_get_schema(size_t *count);
+
+/**
+ * Write settings as JSON object members (no surrounding braces)
+ * e.g. "interval":5,"moon_lamp":true,...
+ * @param settings Settings to serialize
+ * @param buffer Output buffer
+ * @param buffer_size Size of output buffer
+ * @return Number of characters written, or -1 if the buffer is too small
+ */
+int global_settings_to_json(const global_settings_t *settings, char *buffer, size_t buffer_size);
+
+/**
+ * Start parsing a settings form
+ * Fills defaults and clears the checkbox fields, which browsers only
+ * submit when checked
+ * @param settings Output buffer for settings
+ */
+void global_settings_form_begin(global_settings_t *settings);
+
+/**
+ * Apply one decoded form field (see form_parser.h)
+ * Numeric values that are empty or out of range keep their defaults,
+ * checkbox fields are only true with value 1
+ * @param settings Settings being filled (after global_settings_form_begin)
+ * @param key Field name
+ * @param value Decoded value
+ * @return ESP_OK, ESP_ERR_NOT_FOUND for keys not in the schema
+ */
+esp_err_t global_settings_form_field(global_settings_t *settings, const char *key, const char *value);
+
 /**
  * Check if global settings are stored
  * @return true if settings exist in NVS
@@ -64,6 +150,13 @@ bool global_settings_exist(void);
  */
 esp_err_t global_settings_clear(void);
 
+/**
+ * Set the C library time zone (TZ) to the configured UTC offset
+ * localtime() then gives the user's local time, e.g. for the night hours.
+ * Call at boot and after saving the settings.
+ */
+void global_settings_apply_timezone(void);
+
 /**
  * Get current LibreLink update interval in milliseconds
  * Loads from NVS and converts to ms for use with vTaskDelay
@@ -77,4 +170,10 @@ uint32_t global_settings_get_interval_ms(void);
  */
 bool global_settings_is_moon_lamp_enabled(void);
 
+/**
+ * Check if LAN sharing is enabled
+ * @return true if readings are shared with other monitors (lan_share.h)
+ */
+bool global_settings_is_lan_share_enabled(void);
+
 #endif // GLOBAL_SETTINGS_H
@@ -0,0 +1,468 @@
+/**
+ * Glucose REST API Implementation
+ */
+
+#include "glucose_api.h"
+#include "global_settings.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <math.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "GLUCOSE_API";
+
+// Response chunk size (history is sent in pieces this big)
+#define API_CHUNK_SIZE          512
+
+#define API_CONTENT_JSON        "application/json"
+#define API_CONTENT_CBOR        "application/cbor"
+
+// CBOR major types (RFC 8949 section 3.1)
+#define CBOR_UINT               0
+#define CBOR_NEGINT             1
+#define CBOR_TEXT               3
+#define CBOR_ARRAY              4
+#define CBOR_MAP                5
+
+static SemaphoreHandle_t current_mutex = NULL;
+static libre_glucose_data_t current_reading;
+static bool current_is_low = false;
+static bool current_is_high = false;
+static bool have_current = false;
+
+/**
+ * Buffers small writes into chunks of API_CHUNK_SIZE
+ * The first error is kept and later writes are skipped.
+ */
+typedef struct {
+    httpd_req_t *req;
+    size_t len;
+    esp_err_t err;
+    uint8_t buf[API_CHUNK_SIZE];
+} chunk_writer_t;
+
+typedef struct {
+    time_t from;
+    time_t to;
+    bool ranged;                // from or to given: points without a time are left out
+    bool cbor;
+} api_query_t;
+
+static void writer_flush(chunk_writer_t *w)
+{
+    if (w->err == ESP_OK && w->len > 0) {
+        w->err = httpd_resp_send_chunk(w->req, (const char *)w->buf, w->len);
+    }
+    w->len = 0;
+}
+
+// Items are small (one point at most), so they always fit an empty buffer
+static void writer_put(chunk_writer_t *w, const void *data, size_t len)
+{
+    if (w->len + len > sizeof(w->buf)) {
+        writer_flush(w);
+    }
+    if (w->err != ESP_OK || len > sizeof(w->buf)) {
+        return;
+    }
+    memcpy(w->buf + w->len, data, len);
+    w->len += len;
+}
+
+static void writer_printf(chunk_writer_t *w, const char *fmt, ...)
+{
+    char item[128];
+    va_list args;
+    va_start(args, fmt);
+    int len = vsnprintf(item, sizeof(item), fmt, args);
+    va_end(args);
+    if (len > 0) {
+        writer_put(w, item, len < (int)sizeof(item) ? (size_t)len : sizeof(item) - 1);
+    }
+}
+
+static esp_err_t writer_finish(chunk_writer_t *w)
+{
+    writer_flush(w);
+    if (w->err == ESP_OK) {
+        w->err = httpd_resp_send_chunk(w->req, NULL, 0);
+    }
+    return w->err;
+}
+
+static void cbor_head(chunk_writer_t *w, uint8_t major, uint64_t value)
+{
+    uint8_t head[9];
+    size_t len;
+
+    if (value < 24) {
+        head[0] = (major << 5) | (uint8_t)value;
+        len = 1;
+    } else if (value <= 0xff) {
+        head[0] = (major << 5) | 24;
+        len = 2;
+    } else if (value <= 0xffff) {
+        head[0] = (major << 5) | 25;
+        len = 3;
+    } else if (value <= 0xffffffff) {
+        head[0] = (major << 5) | 26;
+        len = 5;
+    } else {
+        head[0] = (major << 5) | 27;
+        len = 9;
+    }
+    // Argument follows in network byte order
+    for (size_t i = 1; i < len; i++) {
+        head[i] = (uint8_t)(value >> (8 * (len - 1 - i)));
+    }
+    writer_put(w, head, len);
+}
+
+static void cbor_int(chunk_writer_t *w, int64_t value)
+{
+    if (value >= 0) {
+        cbor_head(w, CBOR_UINT, (uint64_t)value);
+    } else {
+        cbor_head(w, CBOR_NEGINT, (uint64_t)(-1 - value));
+    }
+}
+
+static void cbor_text(chunk_writer_t *w, const char *text)
+{
+    size_t len = strlen(text);
+    cbor_head(w, CBOR_TEXT, len);
+    writer_put(w, text, len);
+}
+
+static void cbor_float(chunk_writer_t *w, float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint8_t item[5] = {
+        0xfa,  // Major type 7, single-precision float
+        (uint8_t)(bits >> 24), (uint8_t)(bits >> 16), (uint8_t)(bits >> 8), (uint8_t)bits
+    };
+    writer_put(w, item, sizeof(item));
+}
+
+static esp_err_t send_json_error(httpd_req_t *req, const char *status, const char *message)
+{
+    char body[96];
+    snprintf(body, sizeof(body), "{\"error\":\"%s\"}", message);
+    httpd_resp_set_status(req, status);
+    httpd_resp_set_type(req, API_CONTENT_JSON);
+    return httpd_resp_sendstr(req, body);
+}
+
+static bool parse_time_param(const char *query, const char *key, time_t *out, bool *found)
+{
+    char value[24];
+    if (httpd_query_key_value(query, key, value, sizeof(value)) != ESP_OK) {
+        return true;  // Absent
+    }
+    char *end = NULL;
+    long long parsed = strtoll(value, &end, 10);
+    if (end == value || *end != '\0' || parsed < 0) {
+        return false;
+    }
+    *out = (time_t)parsed;
+    *found = true;
+    return true;
+}
+
+/**
+ * Read from/to/format from the query string and the Accept header
+ * @return false if a parameter is malformed
+ */
+static bool parse_query(httpd_req_t *req, api_query_t *query)
+{
+    query->from = 0;
+    query->to = (time_t)INT64_MAX;
+    query->ranged = false;
+    query->cbor = false;
+
+    char accept[64];
+    if (httpd_req_get_hdr_value_str(req, "Accept", accept, sizeof(accept)) == ESP_OK &&
+        strstr(accept, API_CONTENT_CBOR)) {
+        query->cbor = true;
+    }
+
+    size_t query_len = httpd_req_get_url_query_len(req);
+    if (query_len == 0) {
+        return true;
+    }
+
+    char query_str[96];
+    if (query_len >= sizeof(query_str) ||
+        httpd_req_get_url_query_str(req, query_str, sizeof(query_str)) != ESP_OK) {
+        return false;
+    }
+
+    if (!parse_time_param(query_str, "from", &query->from, &query->ranged) ||
+        !parse_time_param(query_str, "to", &query->to, &query->ranged)) {
+        return false;
+    }
+
+    char format[8];
+    if (httpd_query_key_value(query_str, "format", format, sizeof(format)) == ESP_OK) {
+        if (strcmp(format, "cbor") == 0) {
+            query->cbor = true;
+        } else if (strcmp(format, "json") == 0) {
+            query->cbor = false;
+        } else {
+            return false;
+        }
+    }
+    return query->from <= query->to;
+}
+
+static bool point_selected(const libre_graph_point_t *point, const api_query_t *query)
+{
+    if (point->unix_time == 0) {
+        return !query->ranged;
+    }
+    return point->unix_time >= query->from && point->unix_time <= query->to;
+}
+
+static esp_err_t api_current_handler(httpd_req_t *req)
+{
+    libre_glucose_data_t reading;
+    bool is_low;
+    bool is_high;
+
+    bool available = false;
+    if (current_mutex) {
+        xSemaphoreTake(current_mutex, portMAX_DELAY);
+        available = have_current;
+        reading = current_reading;
+        is_low = current_is_low;
+        is_high = current_is_high;
+        xSemaphoreGive(current_mutex);
+    }
+    if (!available) {
+        return send_json_error(req, HTTPD_404, "No reading yet");
+    }
+
+    // Age is only known once the clock is synced (after 2020)
+    time_t now = time(NULL);
+    long long age = -1;
+    if (reading.unix_time && now > 1577836800) {
+        age = (long long)(now - reading.unix_time);
+    }
+    bool stale = reading.unix_time == 0 || age > GLUCOSE_API_STALE_SECONDS;
+
+    char body[320];
+    snprintf(body, sizeof(body),
+             "{\"mgdl\":%d,\"mmol\":%.1f,\"trend\":%d,\"arrow\":\"%s\",\"low\":%s,\"high\":%s,"
+             "\"timestamp\":\"%s\",\"time\":%lld,\"age\":%lld,\"stale\":%s}",
+             reading.value_mgdl, reading.value_mmol, (int)reading.trend,
+             librelinkup_get_trend_string(reading.trend),
+             is_low ? "true" : "false", is_high ? "true" : "false",
+             reading.timestamp, (long long)reading.unix_time, age, stale ? "true" : "false");
+
+    httpd_resp_set_type(req, API_CONTENT_JSON);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    return httpd_resp_sendstr(req, body);
+}
+
+static esp_err_t api_history_handler(httpd_req_t *req)
+{
+    api_query_t query;
+    if (!parse_query(req, &query)) {
+        return send_json_error(req, HTTPD_400, "Bad from, to or format");
+    }
+
+    chunk_writer_t *w = calloc(1, sizeof(chunk_writer_t));
+    if (!w) {
+        return send_json_error(req, HTTPD_500, "Out of memory");
+    }
+    w->req = req;
+
+    httpd_resp_set_type(req, query.cbor ? API_CONTENT_CBOR : API_CONTENT_JSON);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+
+    // Points are encoded straight from the cache; an update waits for the
+    // response (at most the socket send timeout per chunk)
+    const libre_graph_data_t *graph = librelinkup_lock_graph_data();
+    size_t count = 0;
+    for (int i = 0; i < graph->count; i++) {
+        if (point_selected(&graph->points[i], &query)) {
+            count++;
+        }
+    }
+
+    if (query.cbor) {
+        cbor_head(w, CBOR_MAP, 2);
+        cbor_text(w, "count");
+        cbor_int(w, count);
+        cbor_text(w, "points");
+        cbor_head(w, CBOR_ARRAY, count);
+    } else {
+        writer_printf(w, "{\"count\":%u,\"points\":[", (unsigned)count);
+    }
+
+    bool first = true;
+    for (int i = 0; i < graph->count && w->err == ESP_OK; i++) {
+        const libre_graph_point_t *point = &graph->points[i];
+        if (!point_selected(point, &query)) {
+            continue;
+        }
+        if (query.cbor) {
+            cbor_head(w, CBOR_ARRAY, 4);
+            cbor_int(w, point->unix_time);
+            cbor_float(w, point->value_mmol);
+            cbor_int(w, point->value_mgdl);
+            cbor_int(w, point->measurement_color);
+        } else {
+            writer_printf(w, "%s{\"time\":%lld,\"mmol\":%.1f,\"mgdl\":%d,\"color\":%d}",
+                          first ? "" : ",", (long long)point->unix_time, point->value_mmol,
+                          point->value_mgdl, point->measurement_color);
+        }
+        first = false;
+    }
+
+    librelinkup_unlock_graph_data();
+
+    if (!query.cbor) {
+        writer_put(w, "]}", 2);
+    }
+    esp_err_t err = writer_finish(w);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "History response aborted: %s", esp_err_to_name(err));
+    }
+
+    free(w);
+    // Failing mid-response closes the connection; the chunked body can't be completed
+    return err;
+}
+
+static esp_err_t api_stats_handler(httpd_req_t *req)
+{
+    api_query_t query;
+    if (!parse_query(req, &query) || query.cbor) {
+        return send_json_error(req, HTTPD_400, "Bad from, to or format");
+    }
+
+    global_settings_t settings;
+    global_settings_load(&settings);
+
+    int count = 0;
+    int below = 0;
+    int above = 0;
+    double sum = 0;
+    double sum_sq = 0;
+    float min = 0;
+    float max = 0;
+    time_t first = 0;
+    time_t last = 0;
+
+    const libre_graph_data_t *graph = librelinkup_lock_graph_data();
+    for (int i = 0; i < graph->count; i++) {
+        const libre_graph_point_t *point = &graph->points[i];
+        if (!point_selected(point, &query)) {
+            continue;
+        }
+        float value = point->value_mmol;
+        if (count == 0 || value < min) {
+            min = value;
+        }
+        if (count == 0 || value > max) {
+            max = value;
+        }
+        if (point->unix_time && (first == 0 || point->unix_time < first)) {
+            first = point->unix_time;
+        }
+        if (point->unix_time > last) {
+            last = point->unix_time;
+        }
+        if (value < settings.glucose_low_threshold) {
+            below++;
+        } else if (value > settings.glucose_high_threshold) {
+            above++;
+        }
+        sum += value;
+        sum_sq += (double)value * value;
+        count++;
+    }
+    librelinkup_unlock_graph_data();
+
+    char body[384];
+    if (count == 0) {
+        snprintf(body, sizeof(body), "{\"count\":0}");
+    } else {
+        double mean = sum / count;
+        double variance = sum_sq / count - mean * mean;
+        double sd = variance > 0 ? sqrt(variance) : 0;
+        // Glucose management indicator (estimated HbA1c %) from mean mg/dL
+        double gmi = 3.31 + 0.02392 * (mean * 18.0);
+
+        snprintf(body, sizeof(body),
+                 "{\"count\":%d,\"from\":%lld,\"to\":%lld,\"mean\":%.2f,\"sd\":%.2f,\"cv\":%.1f,"
+                 "\"min\":%.1f,\"max\":%.1f,\"gmi\":%.1f,\"low_threshold\":%.1f,\"high_threshold\":%.1f,"
+                 "\"below\":%.1f,\"in_range\":%.1f,\"above\":%.1f}",
+                 count, (long long)first, (long long)last, mean, sd, mean > 0 ? 100.0 * sd / mean : 0.0,
+                 min, max, gmi, settings.glucose_low_threshold, settings.glucose_high_threshold,
+                 100.0 * below / count, 100.0 * (count - below - above) / count, 100.0 * above / count);
+    }
+
+    httpd_resp_set_type(req, API_CONTENT_JSON);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    return httpd_resp_sendstr(req, body);
+}
+
+esp_err_t glucose_api_register(httpd_handle_t server)
+{
+    if (!current_mutex) {
+        current_mutex = xSemaphoreCreateMutex();
+        if (!current_mutex) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    httpd_uri_t current = {
+        .uri = "/api/v1/current",
+        .method = HTTP_GET,
+        .handler = api_current_handler
+    };
+    httpd_uri_t history = {
+        .uri = "/api/v1/history",
+        .method = HTTP_GET,
+        .handler = api_history_handler
+    };
+    httpd_uri_t stats = {
+        .uri = "/api/v1/stats",
+        .method = HTTP_GET,
+        .handler = api_stats_handler
+    };
+
+    esp_err_t err = httpd_register_uri_handler(server, &current);
+    if (err == ESP_OK) {
+        err = httpd_register_uri_handler(server, &history);
+    }
+    if (err == ESP_OK) {
+        err = httpd_register_uri_handler(server, &stats);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to register API handlers: %s", esp_err_to_name(err));
+    }
+    return err;
+}
+
+void glucose_api_set_current(const libre_glucose_data_t *glucose, bool is_low, bool is_high)
+{
+    if (!current_mutex || !glucose) {
+        return;
+    }
+
+    xSemaphoreTake(current_mutex, portMAX_DELAY);
+    current_reading = *glucose;
+    current_is_low = is_low;
+    current_is_high = is_high;
+    have_current = true;
+    xSemaphoreGive(current_mutex);
+}
@@ -0,0 +1,49 @@
+/**
+ * Glucose REST API
+ * Versioned read-only JSON endpoints for LAN clients
+ *
+ *   GET /api/v1/current                 Latest reading
+ *   GET /api/v1/history?from=&to=       Readings from the graph cache
+ *   GET /api/v1/stats?from=&to=         Summary statistics over a range
+ *
+ * from/to are Unix times in seconds (inclusive, both optional). History
+ * is streamed in small chunks straight from a copy of the graph cache,
+ * never as a cJSON tree or one large buffer. Dashboards pulling large
+ * ranges can ask for CBOR (RFC 8949) with ?format=cbor or
+ * "Accept: application/cbor":
+ *
+ *   {"count": uint, "points": [[time, mmol (float32), mgdl, color], ...]}
+ *
+ * Points whose time could not be parsed have time 0 and are only
+ * returned when no range is given.
+ */
+
+#ifndef GLUCOSE_API_H
+#define GLUCOSE_API_H
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "librelinkup.h"
+#include <stdbool.h>
+
+// Readings older than this are reported as stale
+#define GLUCOSE_API_STALE_SECONDS   300
+
+/**
+ * Register the /api/v1 handlers on a running server
+ *
+ * @param server HTTP server handle
+ * @return ESP_OK on success
+ */
+esp_err_t glucose_api_register(httpd_handle_t server);
+
+/**
+ * Set the reading served by /api/v1/current
+ *
+ * @param glucose Latest reading
+ * @param is_low Below the configured low threshold
+ * @param is_high Above the configured high threshold
+ */
+void glucose_api_set_current(const libre_glucose_data_t *glucose, bool is_low, bool is_high);
+
+#endif // GLUCOSE_API_H
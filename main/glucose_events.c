@@ -0,0 +1,266 @@
+/**
+ * Glucose Event Stream Implementation
+ */
+
+#include "glucose_events.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "GLUCOSE_EVENTS";
+
+#define EVENTS_TASK_STACK       4096
+#define EVENTS_TASK_PRIORITY    3
+#define EVENTS_QUEUE_LEN        8
+
+// Largest "event: ...\ndata: ...\n\n" frame
+#define EVENT_FRAME_SIZE        384
+
+typedef enum {
+    EVENTS_MSG_CLIENT,          // New stream (async request copy)
+    EVENTS_MSG_READING,         // New reading (JSON in data)
+    EVENTS_MSG_ALARM,           // Alarm state
+} events_msg_type_t;
+
+typedef struct {
+    events_msg_type_t type;
+    httpd_req_t *req;
+    char *data;                 // Heap, owned by the receiver
+    bool stale;
+    bool alarm_active;
+    bool alarm_snoozed;
+} events_msg_t;
+
+static QueueHandle_t event_queue = NULL;
+
+// Only touched by the sender task
+static httpd_req_t *clients[GLUCOSE_EVENTS_MAX_CLIENTS];
+static char *last_reading = NULL;   // JSON, replayed to new clients
+static bool last_stale = false;
+static bool have_alarm = false;
+static bool last_alarm_active = false;
+static bool last_alarm_snoozed = false;
+
+static esp_err_t send_frame(httpd_req_t *req, const char *event, const char *data)
+{
+    char frame[EVENT_FRAME_SIZE];
+    int len = snprintf(frame, sizeof(frame), "event: %s\ndata: %s\n\n", event, data);
+    if (len < 0 || len >= (int)sizeof(frame)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    return httpd_resp_send_chunk(req, frame, len);
+}
+
+static void drop_client(size_t index)
+{
+    httpd_req_t *req = clients[index];
+    httpd_handle_t server = req->handle;
+    int sockfd = httpd_req_to_sockfd(req);
+
+    clients[index] = NULL;
+    httpd_req_async_handler_complete(req);
+    // The response never ends, so the connection can't be reused
+    httpd_sess_trigger_close(server, sockfd);
+    ESP_LOGI(TAG, "Stream closed (socket %d)", sockfd);
+}
+
+// Send one event to every stream, dropping streams that fail
+static void broadcast(const char *event, const char *data)
+{
+    for (size_t i = 0; i < GLUCOSE_EVENTS_MAX_CLIENTS; i++) {
+        if (!clients[i]) {
+            continue;
+        }
+        esp_err_t err = event ? send_frame(clients[i], event, data)
+                              : httpd_resp_send_chunk(clients[i], data, strlen(data));
+        if (err != ESP_OK) {
+            drop_client(i);
+        }
+    }
+}
+
+static void format_alarm(char *buf, size_t size)
+{
+    snprintf(buf, size, "{\"active\":%s,\"snoozed\":%s}",
+             last_alarm_active ? "true" : "false", last_alarm_snoozed ? "true" : "false");
+}
+
+static void add_client(httpd_req_t *req)
+{
+    size_t slot;
+    for (slot = 0; slot < GLUCOSE_EVENTS_MAX_CLIENTS; slot++) {
+        if (!clients[slot]) {
+            break;
+        }
+    }
+    if (slot == GLUCOSE_EVENTS_MAX_CLIENTS) {
+        ESP_LOGW(TAG, "All %d streams in use", GLUCOSE_EVENTS_MAX_CLIENTS);
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_set_hdr(req, "Retry-After", "30");
+        httpd_resp_sendstr(req, "Too many event streams");
+        httpd_req_async_handler_complete(req);
+        return;
+    }
+
+    httpd_resp_set_type(req, "text/event-stream");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    clients[slot] = req;
+
+    // Reconnect delay for EventSource, then the current state
+    esp_err_t err = httpd_resp_sendstr_chunk(req, "retry: 5000\n\n");
+    if (err == ESP_OK && last_reading) {
+        err = send_frame(req, "reading", last_reading);
+    }
+    if (err == ESP_OK && have_alarm) {
+        char alarm[48];
+        format_alarm(alarm, sizeof(alarm));
+        err = send_frame(req, "alarm", alarm);
+    }
+    if (err != ESP_OK) {
+        drop_client(slot);
+        return;
+    }
+    ESP_LOGI(TAG, "Stream opened (socket %d)", httpd_req_to_sockfd(req));
+}
+
+static void events_task(void *pvParameters)
+{
+    events_msg_t msg;
+
+    while (1) {
+        if (xQueueReceive(event_queue, &msg, pdMS_TO_TICKS(GLUCOSE_EVENTS_KEEPALIVE_MS)) != pdTRUE) {
+            broadcast(NULL, ": keepalive\n\n");
+            continue;
+        }
+
+        switch (msg.type) {
+            case EVENTS_MSG_CLIENT:
+                add_client(msg.req);
+                break;
+
+            case EVENTS_MSG_READING: {
+                bool stale_changed = last_reading && msg.stale != last_stale;
+                free(last_reading);
+                last_reading = msg.data;
+                last_stale = msg.stale;
+
+                broadcast("reading", last_reading);
+                if (stale_changed) {
+                    broadcast("stale", last_stale ? "{\"stale\":true}" : "{\"stale\":false}");
+                }
+                break;
+            }
+
+            case EVENTS_MSG_ALARM:
+                if (have_alarm && msg.alarm_active == last_alarm_active &&
+                    msg.alarm_snoozed == last_alarm_snoozed) {
+                    break;
+                }
+                have_alarm = true;
+                last_alarm_active = msg.alarm_active;
+                last_alarm_snoozed = msg.alarm_snoozed;
+
+                char alarm[48];
+                format_alarm(alarm, sizeof(alarm));
+                broadcast("alarm", alarm);
+                break;
+        }
+    }
+}
+
+static esp_err_t events_get_handler(httpd_req_t *req)
+{
+    // Detach the request from the httpd task; the sender task owns it from here
+    httpd_req_t *async_req = NULL;
+    esp_err_t err = httpd_req_async_handler_begin(req, &async_req);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to detach request: %s", esp_err_to_name(err));
+        httpd_resp_send_500(req);
+        return ESP_OK;
+    }
+
+    events_msg_t msg = {
+        .type = EVENTS_MSG_CLIENT,
+        .req = async_req,
+    };
+    if (xQueueSend(event_queue, &msg, 0) != pdTRUE) {
+        httpd_resp_set_status(async_req, "503 Service Unavailable");
+        httpd_resp_sendstr(async_req, "Event stream busy");
+        httpd_req_async_handler_complete(async_req);
+    }
+    return ESP_OK;
+}
+
+esp_err_t glucose_events_register(httpd_handle_t server)
+{
+    if (!event_queue) {
+        event_queue = xQueueCreate(EVENTS_QUEUE_LEN, sizeof(events_msg_t));
+        if (!event_queue) {
+            ESP_LOGE(TAG, "Failed to create event queue");
+            return ESP_ERR_NO_MEM;
+        }
+        if (xTaskCreate(events_task, "glucose_events", EVENTS_TASK_STACK, NULL,
+                        EVENTS_TASK_PRIORITY, NULL) != pdPASS) {
+            vQueueDelete(event_queue);
+            event_queue = NULL;
+            ESP_LOGE(TAG, "Failed to create event task");
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    httpd_uri_t events = {
+        .uri = "/events",
+        .method = HTTP_GET,
+        .handler = events_get_handler
+    };
+    return httpd_register_uri_handler(server, &events);
+}
+
+void glucose_events_publish_reading(const libre_glucose_data_t *glucose, bool is_low, bool is_high, bool stale)
+{
+    if (!event_queue || !glucose) {
+        return;
+    }
+
+    char json[256];
+    snprintf(json, sizeof(json),
+             "{\"mgdl\":%d,\"mmol\":%.1f,\"trend\":%d,\"arrow\":\"%s\",\"low\":%s,\"high\":%s,"
+             "\"timestamp\":\"%s\",\"stale\":%s}",
+             glucose->value_mgdl, glucose->value_mmol, (int)glucose->trend,
+             librelinkup_get_trend_string(glucose->trend),
+             is_low ? "true" : "false", is_high ? "true" : "false",
+             glucose->timestamp, stale ? "true" : "false");
+
+    events_msg_t msg = {
+        .type = EVENTS_MSG_READING,
+        .data = strdup(json),
+        .stale = stale,
+    };
+    if (!msg.data) {
+        return;
+    }
+    if (xQueueSend(event_queue, &msg, 0) != pdTRUE) {
+        ESP_LOGW(TAG, "Event queue full, reading dropped");
+        free(msg.data);
+    }
+}
+
+void glucose_events_publish_alarm(bool active, bool snoozed)
+{
+    if (!event_queue) {
+        return;
+    }
+
+    events_msg_t msg = {
+        .type = EVENTS_MSG_ALARM,
+        .alarm_active = active,
+        .alarm_snoozed = snoozed,
+    };
+    if (xQueueSend(event_queue, &msg, 0) != pdTRUE) {
+        ESP_LOGW(TAG, "Event queue full, alarm state dropped");
+    }
+}
@@ -0,0 +1,63 @@
+/**
+ * Glucose Event Stream
+ * Pushes readings and alarm state to LAN clients as Server-Sent Events
+ *
+ * GET /events answers with text/event-stream and keeps the connection
+ * open. The handler hands the request to httpd's async request API and
+ * returns at once, so an open stream doesn't hold the httpd task; a
+ * sender task writes the events to every stream. A new client first
+ * gets the current state, then these events:
+ *
+ *   event: reading  {"mgdl":..,"mmol":..,"trend":..,"arrow":"..","low":..,
+ *                    "high":..,"timestamp":"..","stale":..}
+ *   event: stale    {"stale":true|false}      (on transitions only)
+ *   event: alarm    {"active":..,"snoozed":..} (on changes only)
+ *
+ * A comment line is sent every GLUCOSE_EVENTS_KEEPALIVE_MS so dead
+ * clients are noticed and proxies keep the stream open.
+ */
+
+#ifndef GLUCOSE_EVENTS_H
+#define GLUCOSE_EVENTS_H
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "librelinkup.h"
+#include <stdbool.h>
+
+// Streams open at once (each holds one of the server's sockets)
+#define GLUCOSE_EVENTS_MAX_CLIENTS      3
+
+// Keepalive comment interval
+#define GLUCOSE_EVENTS_KEEPALIVE_MS     15000
+
+/**
+ * Register the /events handler on a running server
+ * Creates the sender task on first use.
+ *
+ * @param server HTTP server handle
+ * @return ESP_OK on success
+ */
+esp_err_t glucose_events_register(httpd_handle_t server);
+
+/**
+ * Publish a new reading
+ * Never blocks; does nothing until the stream has been registered.
+ *
+ * @param glucose Reading
+ * @param is_low Below the configured low threshold
+ * @param is_high Above the configured high threshold
+ * @param stale Reading is older than the staleness limit
+ */
+void glucose_events_publish_reading(const libre_glucose_data_t *glucose, bool is_low, bool is_high, bool stale);
+
+/**
+ * Publish the alarm state
+ * Only changes are sent to clients. Never blocks.
+ *
+ * @param active Alarm triggered
+ * @param snoozed Alarm snoozed
+ */
+void glucose_events_publish_alarm(bool active, bool snoozed);
+
+#endif // GLUCOSE_EVENTS_H
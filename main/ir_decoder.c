@@ -0,0 +1,179 @@
+/**
+ * IR Frame Decoder Implementation
+ */
+
+#include "ir_decoder.h"
+#include <string.h>
+
+#define RC5_MAX_HALVES  (RC5_FRAME_BITS * 2)
+
+static bool timing_matches(uint32_t measured, uint32_t expected)
+{
+    uint32_t margin = expected * IR_DECODE_TOLERANCE_PCT / 100;
+    return measured + margin >= expected && measured <= expected + margin;
+}
+
+static bool symbol_matches(const ir_symbol_t *symbol, uint32_t mark, uint32_t space)
+{
+    return timing_matches(symbol->duration0, mark) && timing_matches(symbol->duration1, space);
+}
+
+// 32 pulse-distance bits after the leader (NEC and Samsung)
+static bool decode_pulse_distance(const ir_symbol_t *symbols, size_t count, ir_protocol_t protocol, ir_code_t *code)
+{
+    // Leader + 32 bits + stop mark
+    if (count < 34) {
+        return false;
+    }
+
+    uint8_t bytes[4] = {0};
+    for (int i = 0; i < 32; i++) {
+        const ir_symbol_t *symbol = &symbols[1 + i];
+        if (!timing_matches(symbol->duration0, NEC_PAYLOAD_ZERO_HIGH)) {
+            return false;
+        }
+        if (timing_matches(symbol->duration1, NEC_PAYLOAD_ONE_LOW)) {
+            bytes[i / 8] |= 1 << (i % 8);
+        } else if (!timing_matches(symbol->duration1, NEC_PAYLOAD_ZERO_LOW)) {
+            return false;
+        }
+    }
+
+    if (!timing_matches(symbols[33].duration0, NEC_PAYLOAD_ZERO_HIGH)) {
+        return false;
+    }
+
+    // Command must be followed by its inverse
+    if ((uint8_t)(bytes[2] ^ bytes[3]) != 0xFF) {
+        return false;
+    }
+
+    code->raw = false;
+    code->protocol = protocol;
+    code->address = bytes[0] | (bytes[1] << 8);
+    code->command = bytes[2];
+    code->raw_count = 0;
+    return true;
+}
+
+// Number of RC5 half-bits in a duration (1 or 2), 0 if it doesn't fit
+static int rc5_halves(uint32_t duration)
+{
+    if (timing_matches(duration, RC5_HALF_BIT)) {
+        return 1;
+    }
+    if (timing_matches(duration, 2 * RC5_HALF_BIT)) {
+        return 2;
+    }
+    return 0;
+}
+
+static bool decode_rc5(const ir_symbol_t *symbols, size_t count, ir_code_t *code)
+{
+    uint8_t halves[RC5_MAX_HALVES];
+    int n = 0;
+
+    // S1 is a 1: its first half is the idle space before the first mark
+    halves[n++] = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        int marks = rc5_halves(symbols[i].duration0);
+        if (marks == 0 || n + marks > RC5_MAX_HALVES) {
+            return false;
+        }
+        while (marks--) {
+            halves[n++] = 1;
+        }
+
+        // A space longer than two half-bits (or none) ends the frame
+        int spaces = rc5_halves(symbols[i].duration1);
+        if (spaces == 0) {
+            break;
+        }
+        if (n + spaces > RC5_MAX_HALVES) {
+            return false;
+        }
+        while (spaces--) {
+            halves[n++] = 0;
+        }
+    }
+
+    // A trailing 0 bit's last half merges into the idle gap
+    if (n == RC5_MAX_HALVES - 1) {
+        halves[n++] = 0;
+    }
+    if (n != RC5_MAX_HALVES) {
+        return false;
+    }
+
+    uint16_t frame = 0;
+    for (int i = 0; i < RC5_FRAME_BITS; i++) {
+        uint8_t first = halves[i * 2];
+        uint8_t second = halves[i * 2 + 1];
+        if (first == second) {
+            return false;
+        }
+        frame = (frame << 1) | (second ? 1 : 0);
+    }
+
+    if (!(frame & (1 << 13))) {
+        return false;
+    }
+
+    code->raw = false;
+    code->protocol = IR_PROTOCOL_RC5;
+    code->address = (frame >> 6) & 0x1F;
+    code->command = (frame & 0x3F) | ((frame & (1 << 12)) ? 0 : 0x40);
+    code->raw_count = 0;
+    return true;
+}
+
+static bool capture_raw(const ir_symbol_t *symbols, size_t count, ir_code_t *code)
+{
+    if (count < IR_RAW_MIN_SYMBOLS || count > IR_RAW_MAX_SYMBOLS) {
+        return false;
+    }
+
+    memset(code, 0, sizeof(*code));
+    code->raw = true;
+    code->raw_count = count;
+    for (size_t i = 0; i < count; i++) {
+        if (symbols[i].duration0 == 0) {
+            return false;
+        }
+        code->raw_symbols[i].level0 = 1;
+        code->raw_symbols[i].duration0 = symbols[i].duration0;
+        code->raw_symbols[i].level1 = 0;
+        code->raw_symbols[i].duration1 = symbols[i].duration1;
+    }
+
+    // Receiver reports 0 for the final space - replay with a proper gap
+    code->raw_symbols[count - 1].duration1 = IR_ENDING_GAP;
+    return true;
+}
+
+ir_decode_result_t ir_decode(const ir_symbol_t *symbols, size_t count, ir_code_t *code)
+{
+    if (!symbols || !code || count == 0) {
+        return IR_DECODE_INVALID;
+    }
+
+    const ir_symbol_t *leader = &symbols[0];
+
+    if (symbol_matches(leader, NEC_REPEAT_CODE_HIGH, NEC_REPEAT_CODE_LOW) && count <= 2) {
+        return IR_DECODE_REPEAT;
+    }
+    if (symbol_matches(leader, NEC_LEADING_CODE_HIGH, NEC_LEADING_CODE_LOW) &&
+        decode_pulse_distance(symbols, count, IR_PROTOCOL_NEC, code)) {
+        return IR_DECODE_OK;
+    }
+    if (symbol_matches(leader, SAMSUNG_LEADING_CODE_HIGH, SAMSUNG_LEADING_CODE_LOW) &&
+        decode_pulse_distance(symbols, count, IR_PROTOCOL_SAMSUNG, code)) {
+        return IR_DECODE_OK;
+    }
+    if (decode_rc5(symbols, count, code)) {
+        return IR_DECODE_OK;
+    }
+
+    return capture_raw(symbols, count, code) ? IR_DECODE_RAW : IR_DECODE_INVALID;
+}
@@ -0,0 +1,60 @@
+/**
+ * IR Frame Decoder
+ * Decodes captured RMT symbol buffers into protocol codes
+ *
+ * Pure C with no ESP-IDF dependencies so recorded captures can be
+ * decoded on a host. Each captured symbol is read as one mark (duration0)
+ * followed by one space (duration1), independent of the receiver's output
+ * polarity. Timings are in microseconds (1MHz RMT resolution).
+ *
+ * Recognised protocols are those of ir_encoder.h. Anything else that looks
+ * like a plausible IR burst is kept as raw timings for replay.
+ */
+
+#ifndef IR_DECODER_H
+#define IR_DECODER_H
+
+#include "ir_encoder.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Allowed deviation from nominal protocol timings
+#define IR_DECODE_TOLERANCE_PCT     25
+
+// Raw fallback limits
+#define IR_RAW_MIN_SYMBOLS          4
+#define IR_RAW_MAX_SYMBOLS          64
+
+/**
+ * Decoded (or raw) IR code
+ */
+typedef struct {
+    bool raw;                   // true: replay raw_symbols, false: re-encode protocol frame
+    ir_protocol_t protocol;
+    uint16_t address;
+    uint8_t command;
+    uint8_t raw_count;
+    ir_symbol_t raw_symbols[IR_RAW_MAX_SYMBOLS];  // Normalized: level0 = mark, level1 = space
+} ir_code_t;
+
+/**
+ * Decode result
+ */
+typedef enum {
+    IR_DECODE_OK = 0,       // Known protocol, code filled in
+    IR_DECODE_REPEAT,       // NEC repeat code (button held), code untouched
+    IR_DECODE_RAW,          // Unknown protocol, raw timings filled in
+    IR_DECODE_INVALID,      // Noise or capture too short/long
+} ir_decode_result_t;
+
+/**
+ * Decode a captured symbol buffer
+ * @param symbols Captured symbols
+ * @param count Number of symbols
+ * @param code Output code
+ * @return Decode result
+ */
+ir_decode_result_t ir_decode(const ir_symbol_t *symbols, size_t count, ir_code_t *code);
+
+#endif // IR_DECODER_H
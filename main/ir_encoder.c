@@ -0,0 +1,140 @@
+/**
+ * IR Frame Encoder Implementation
+ */
+
+#include "ir_encoder.h"
+
+static ir_symbol_t make_symbol(uint16_t high_us, uint16_t low_us)
+{
+    ir_symbol_t symbol = {
+        .level0 = 1,
+        .duration0 = high_us,
+        .level1 = 0,
+        .duration1 = low_us,
+    };
+    return symbol;
+}
+
+// Leader + 4 bytes LSB first + stop bit (NEC and Samsung)
+static size_t encode_pulse_distance(uint16_t lead_high, uint16_t lead_low,
+                                    uint16_t address, uint8_t command,
+                                    ir_symbol_t *symbols, size_t max_symbols)
+{
+    if (max_symbols < IR_ENCODER_MAX_SYMBOLS) {
+        return 0;
+    }
+
+    const uint8_t bytes[4] = {
+        address & 0xFF,         // Address low byte
+        (address >> 8) & 0xFF,  // Address high byte
+        command,                // Command
+        (uint8_t)~command,      // Inverted command
+    };
+
+    size_t count = 0;
+    symbols[count++] = make_symbol(lead_high, lead_low);
+    for (int i = 0; i < 4; i++) {
+        for (int bit = 0; bit < 8; bit++) {
+            if (bytes[i] & (1 << bit)) {
+                symbols[count++] = make_symbol(NEC_PAYLOAD_ONE_HIGH, NEC_PAYLOAD_ONE_LOW);
+            } else {
+                symbols[count++] = make_symbol(NEC_PAYLOAD_ZERO_HIGH, NEC_PAYLOAD_ZERO_LOW);
+            }
+        }
+    }
+    symbols[count++] = make_symbol(NEC_PAYLOAD_ZERO_HIGH, IR_ENDING_GAP);
+    return count;
+}
+
+static size_t encode_nec_repeat(ir_symbol_t *symbols, size_t max_symbols)
+{
+    if (max_symbols < 2) {
+        return 0;
+    }
+    symbols[0] = make_symbol(NEC_REPEAT_CODE_HIGH, NEC_REPEAT_CODE_LOW);
+    symbols[1] = make_symbol(NEC_PAYLOAD_ZERO_HIGH, IR_ENDING_GAP);
+    return 2;
+}
+
+static size_t encode_rc5(uint16_t address, uint8_t command, bool toggle,
+                         ir_symbol_t *symbols, size_t max_symbols)
+{
+    if (address > 0x1F || command > 0x7F) {
+        return 0;
+    }
+
+    // S1, S2 (inverted command bit 6), toggle, 5 address bits, 6 command bits
+    uint16_t frame = (1 << 13) |
+                     ((command & 0x40) ? 0 : (1 << 12)) |
+                     (toggle ? (1 << 11) : 0) |
+                     ((address & 0x1F) << 6) |
+                     (command & 0x3F);
+
+    // Manchester: 1 = space then mark, 0 = mark then space
+    uint8_t halves[RC5_FRAME_BITS * 2];
+    for (int i = 0; i < RC5_FRAME_BITS; i++) {
+        bool one = frame & (1 << (RC5_FRAME_BITS - 1 - i));
+        halves[i * 2] = one ? 0 : 1;
+        halves[i * 2 + 1] = one ? 1 : 0;
+    }
+
+    // Merge equal halves into mark/space runs; S1 is a 1 so the leading space is idle time
+    size_t count = 0;
+    uint16_t mark = 0;
+    uint16_t space = 0;
+    for (int i = 1; i < RC5_FRAME_BITS * 2; i++) {
+        if (halves[i]) {
+            if (space) {
+                // Space finished a mark/space pair
+                if (count >= max_symbols) {
+                    return 0;
+                }
+                symbols[count++] = make_symbol(mark, space);
+                mark = 0;
+                space = 0;
+            }
+            mark += RC5_HALF_BIT;
+        } else {
+            space += RC5_HALF_BIT;
+        }
+    }
+
+    if (count >= max_symbols) {
+        return 0;
+    }
+    symbols[count++] = make_symbol(mark, IR_ENDING_GAP);
+    return count;
+}
+
+size_t ir_encode_frame(ir_protocol_t protocol, uint16_t address, uint8_t command, bool toggle,
+                       ir_symbol_t *symbols, size_t max_symbols)
+{
+    if (!symbols) {
+        return 0;
+    }
+
+    switch (protocol) {
+        case IR_PROTOCOL_NEC:
+            return encode_pulse_distance(NEC_LEADING_CODE_HIGH, NEC_LEADING_CODE_LOW,
+                                         address, command, symbols, max_symbols);
+        case IR_PROTOCOL_NEC_REPEAT:
+            return encode_nec_repeat(symbols, max_symbols);
+        case IR_PROTOCOL_SAMSUNG:
+            return encode_pulse_distance(SAMSUNG_LEADING_CODE_HIGH, SAMSUNG_LEADING_CODE_LOW,
+                                         address, command, symbols, max_symbols);
+        case IR_PROTOCOL_RC5:
+            return encode_rc5(address, command, toggle, symbols, max_symbols);
+    }
+    return 0;
+}
+
+const char* ir_protocol_name(ir_protocol_t protocol)
+{
+    switch (protocol) {
+        case IR_PROTOCOL_NEC:           return "NEC";
+        case IR_PROTOCOL_NEC_REPEAT:    return "NEC_REPEAT";
+        case IR_PROTOCOL_SAMSUNG:       return "SAMSUNG";
+        case IR_PROTOCOL_RC5:           return "RC5";
+        default:                        return "UNKNOWN";
+    }
+}
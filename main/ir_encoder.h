@@ -0,0 +1,88 @@
+/**
+ * IR Frame Encoder
+ * Turns protocol frames into complete RMT symbol sequences (1us ticks)
+ *
+ * Pure C with no ESP-IDF dependencies so the generated timings can be
+ * checked on a host. ir_symbol_t has the same layout as rmt_symbol_word_t,
+ * so an encoded buffer is handed to the RMT copy encoder as-is.
+ *
+ * Supported protocols:
+ *  - NEC:         9ms/4.5ms leader, 32 bits LSB first, 560us stop bit
+ *  - NEC repeat:  9ms/2.25ms leader + 560us stop bit (button held)
+ *  - Samsung:     4.5ms/4.5ms leader, otherwise NEC framing
+ *  - RC5:         14 bit Manchester code, 889us half-bit, MSB first
+ */
+
+#ifndef IR_ENCODER_H
+#define IR_ENCODER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// NEC Protocol Timing (in microseconds)
+#define NEC_LEADING_CODE_HIGH   9000
+#define NEC_LEADING_CODE_LOW    4500
+#define NEC_PAYLOAD_ONE_HIGH    560
+#define NEC_PAYLOAD_ONE_LOW     1690
+#define NEC_PAYLOAD_ZERO_HIGH   560
+#define NEC_PAYLOAD_ZERO_LOW    560
+#define NEC_REPEAT_CODE_HIGH    9000
+#define NEC_REPEAT_CODE_LOW     2250
+
+// Samsung Protocol Timing (in microseconds) - bits use NEC timing
+#define SAMSUNG_LEADING_CODE_HIGH   4500
+#define SAMSUNG_LEADING_CODE_LOW    4500
+
+// RC5 Protocol Timing (in microseconds)
+#define RC5_HALF_BIT            889
+#define RC5_FRAME_BITS          14
+
+// Trailing space after the last mark (max 15-bit duration)
+#define IR_ENDING_GAP           0x7FFF
+
+// Longest encoded frame (NEC/Samsung: leader + 32 bits + stop)
+#define IR_ENCODER_MAX_SYMBOLS  34
+
+/**
+ * One RMT symbol: two level/duration pairs (matches rmt_symbol_word_t)
+ */
+typedef union {
+    struct {
+        uint16_t duration0 : 15;
+        uint16_t level0 : 1;
+        uint16_t duration1 : 15;
+        uint16_t level1 : 1;
+    };
+    uint32_t val;
+} ir_symbol_t;
+
+/**
+ * IR protocols
+ */
+typedef enum {
+    IR_PROTOCOL_NEC = 0,
+    IR_PROTOCOL_NEC_REPEAT,
+    IR_PROTOCOL_SAMSUNG,
+    IR_PROTOCOL_RC5,
+} ir_protocol_t;
+
+/**
+ * Encode one frame into RMT symbols
+ * @param protocol Protocol to use
+ * @param address NEC/Samsung: 16-bit address (low byte sent first), RC5: 5-bit address
+ * @param command NEC/Samsung: 8-bit command, RC5: 7-bit command (bit 6 clears the field bit)
+ * @param toggle RC5 toggle bit (flip on each new key press), ignored otherwise
+ * @param symbols Output buffer
+ * @param max_symbols Size of output buffer (IR_ENCODER_MAX_SYMBOLS is always enough)
+ * @return Number of symbols written, 0 on invalid arguments or short buffer
+ */
+size_t ir_encode_frame(ir_protocol_t protocol, uint16_t address, uint8_t command, bool toggle,
+                       ir_symbol_t *symbols, size_t max_symbols);
+
+/**
+ * Get protocol name
+ */
+const char* ir_protocol_name(ir_protocol_t protocol);
+
+#endif // IR_ENCODER_H
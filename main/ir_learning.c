@@ -0,0 +1,344 @@
+/**
+ * IR Learning Module Implementation
+ */
+
+#include "ir_learning.h"
+#include "esp_log.h"
+#include "esp_attr.h"
+#include "nvs.h"
+#include "driver/rmt_rx.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include <stddef.h>
+#include <string.h>
+
+static const char *TAG = "IR_LEARN";
+
+// IR receiver GPIO (ESP32-S3-BOX-3)
+#define IR_RX_GPIO              GPIO_NUM_38
+
+// RX capture: one frame must fit in the channel memory
+#define IR_RX_MEM_SYMBOLS       96
+#define IR_RX_MIN_PULSE_NS      1250        // Shorter pulses are glitches
+#define IR_RX_MAX_PULSE_NS      12000000    // Longer idle ends the frame
+
+#define IR_CODES_NAMESPACE      "ir_codes"
+#define IR_CODE_FORMAT          1           // Leading byte of stored blobs
+
+static rmt_channel_handle_t rx_channel = NULL;
+static QueueHandle_t rx_queue = NULL;
+static SemaphoreHandle_t codes_mutex = NULL;
+static ir_symbol_t rx_symbols[IR_RX_MEM_SYMBOLS];
+
+// Learned codes cached in RAM (guarded by codes_mutex)
+static ir_code_t codes[IR_SLOT_COUNT];
+static bool code_valid[IR_SLOT_COUNT];
+
+static volatile ir_learn_state_t learn_state = IR_LEARN_IDLE;
+static volatile ir_slot_t learn_slot = IR_SLOT_ON;
+
+static const char *slot_names[IR_SLOT_COUNT] = {
+    [IR_SLOT_ON] = "on",
+    [IR_SLOT_NORMAL] = "normal",
+    [IR_SLOT_WARNING] = "warning",
+    [IR_SLOT_HYPO] = "hypo",
+    [IR_SLOT_NO_DATA] = "no_data",
+};
+
+_Static_assert(sizeof(ir_symbol_t) == sizeof(rmt_symbol_word_t), "ir_symbol_t must match rmt_symbol_word_t");
+
+static size_t code_blob_size(const ir_code_t *code)
+{
+    return offsetof(ir_code_t, raw_symbols) + code->raw_count * sizeof(ir_symbol_t);
+}
+
+static esp_err_t save_code(ir_slot_t slot, const ir_code_t *code)
+{
+    uint8_t blob[1 + sizeof(ir_code_t)];
+    size_t len = code_blob_size(code);
+    blob[0] = IR_CODE_FORMAT;
+    memcpy(&blob[1], code, len);
+
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(IR_CODES_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = nvs_set_blob(handle, slot_names[slot], blob, len + 1);
+    if (err == ESP_OK) {
+        err = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    return err;
+}
+
+static void load_codes(void)
+{
+    nvs_handle_t handle;
+    if (nvs_open(IR_CODES_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        ESP_LOGI(TAG, "No learned IR codes");
+        return;
+    }
+
+    for (int slot = 0; slot < IR_SLOT_COUNT; slot++) {
+        uint8_t blob[1 + sizeof(ir_code_t)];
+        size_t len = sizeof(blob);
+        if (nvs_get_blob(handle, slot_names[slot], blob, &len) != ESP_OK) {
+            continue;
+        }
+
+        ir_code_t code = {0};
+        size_t header = 1 + offsetof(ir_code_t, raw_symbols);
+        if (len < header || blob[0] != IR_CODE_FORMAT) {
+            ESP_LOGW(TAG, "Ignoring stored code for '%s' (unknown format)", slot_names[slot]);
+            continue;
+        }
+        memcpy(&code, &blob[1], len - 1);
+        if (code.raw_count > IR_RAW_MAX_SYMBOLS || len - 1 != code_blob_size(&code)) {
+            ESP_LOGW(TAG, "Ignoring stored code for '%s' (bad size)", slot_names[slot]);
+            continue;
+        }
+
+        codes[slot] = code;
+        code_valid[slot] = true;
+        if (code.raw) {
+            ESP_LOGI(TAG, "Learned '%s': raw, %d symbols", slot_names[slot], code.raw_count);
+        } else {
+            ESP_LOGI(TAG, "Learned '%s': %s 0x%04X/0x%02X", slot_names[slot],
+                     ir_protocol_name(code.protocol), code.address, code.command);
+        }
+    }
+
+    nvs_close(handle);
+}
+
+// Runs in ISR context - only hand the capture to the learning task
+static bool IRAM_ATTR rx_done_callback(rmt_channel_handle_t channel, const rmt_rx_done_event_data_t *edata, void *user_data)
+{
+    BaseType_t high_task_wakeup = pdFALSE;
+    QueueHandle_t queue = (QueueHandle_t)user_data;
+    xQueueSendFromISR(queue, edata, &high_task_wakeup);
+    return high_task_wakeup == pdTRUE;
+}
+
+static void learn_task(void *pvParameters)
+{
+    ir_slot_t slot = learn_slot;
+    ir_learn_state_t result = IR_LEARN_TIMEOUT;
+    rmt_receive_config_t receive_config = {
+        .signal_range_min_ns = IR_RX_MIN_PULSE_NS,
+        .signal_range_max_ns = IR_RX_MAX_PULSE_NS,
+    };
+
+    xQueueReset(rx_queue);
+    esp_err_t err = rmt_enable(rx_channel);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to enable RMT RX channel: %s", esp_err_to_name(err));
+        learn_state = IR_LEARN_FAILED;
+        vTaskDelete(NULL);
+        return;
+    }
+
+    ESP_LOGI(TAG, "Listening for '%s' button press...", slot_names[slot]);
+    TickType_t deadline = xTaskGetTickCount() + pdMS_TO_TICKS(IR_LEARN_TIMEOUT_MS);
+
+    while (1) {
+        TickType_t now = xTaskGetTickCount();
+        if ((int32_t)(deadline - now) <= 0) {
+            break;
+        }
+
+        err = rmt_receive(rx_channel, rx_symbols, sizeof(rx_symbols), &receive_config);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to arm RMT receive: %s", esp_err_to_name(err));
+            result = IR_LEARN_FAILED;
+            break;
+        }
+
+        rmt_rx_done_event_data_t rx_data;
+        if (xQueueReceive(rx_queue, &rx_data, deadline - now) != pdTRUE) {
+            break;
+        }
+
+        // Decode outside the ISR; static so the task stack stays small
+        static ir_code_t code;
+        ir_decode_result_t decoded = ir_decode((const ir_symbol_t *)rx_data.received_symbols,
+                                               rx_data.num_symbols, &code);
+        if (decoded == IR_DECODE_REPEAT || decoded == IR_DECODE_INVALID) {
+            ESP_LOGD(TAG, "Ignoring capture (%d symbols)", (int)rx_data.num_symbols);
+            continue;
+        }
+
+        if (decoded == IR_DECODE_OK) {
+            ESP_LOGI(TAG, "Captured %s code 0x%04X/0x%02X", ir_protocol_name(code.protocol),
+                     code.address, code.command);
+        } else {
+            ESP_LOGI(TAG, "Captured unknown protocol, keeping %d raw symbols", code.raw_count);
+        }
+
+        err = save_code(slot, &code);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to store learned code: %s", esp_err_to_name(err));
+            result = IR_LEARN_FAILED;
+            break;
+        }
+
+        xSemaphoreTake(codes_mutex, portMAX_DELAY);
+        codes[slot] = code;
+        code_valid[slot] = true;
+        xSemaphoreGive(codes_mutex);
+
+        result = IR_LEARN_DONE;
+        break;
+    }
+
+    // Disabling also cancels a pending receive
+    rmt_disable(rx_channel);
+
+    if (result == IR_LEARN_TIMEOUT) {
+        ESP_LOGW(TAG, "No button press received for '%s'", slot_names[slot]);
+    }
+    learn_state = result;
+    vTaskDelete(NULL);
+}
+
+esp_err_t ir_learning_init(void)
+{
+    if (rx_channel) {
+        return ESP_OK;
+    }
+
+    codes_mutex = xSemaphoreCreateMutex();
+    rx_queue = xQueueCreate(1, sizeof(rmt_rx_done_event_data_t));
+    if (!codes_mutex || !rx_queue) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    load_codes();
+
+    rmt_rx_channel_config_t rx_channel_config = {
+        .gpio_num = IR_RX_GPIO,
+        .clk_src = RMT_CLK_SRC_DEFAULT,
+        .resolution_hz = 1000000,  // 1MHz resolution = 1us per tick
+        .mem_block_symbols = IR_RX_MEM_SYMBOLS,
+    };
+    esp_err_t ret = rmt_new_rx_channel(&rx_channel_config, &rx_channel);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create RMT RX channel: %s", esp_err_to_name(ret));
+        rx_channel = NULL;
+        return ret;
+    }
+
+    rmt_rx_event_callbacks_t callbacks = {
+        .on_recv_done = rx_done_callback,
+    };
+    ret = rmt_rx_register_event_callbacks(rx_channel, &callbacks, rx_queue);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to register RX callback: %s", esp_err_to_name(ret));
+        return ret;
+    }
+
+    ESP_LOGI(TAG, "IR learning ready on GPIO%d", IR_RX_GPIO);
+    return ESP_OK;
+}
+
+esp_err_t ir_learning_start(ir_slot_t slot)
+{
+    if (slot >= IR_SLOT_COUNT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!rx_channel || learn_state == IR_LEARN_LISTENING) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    learn_slot = slot;
+    learn_state = IR_LEARN_LISTENING;
+    if (xTaskCreate(learn_task, "ir_learn", 4096, NULL, 4, NULL) != pdPASS) {
+        learn_state = IR_LEARN_FAILED;
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+ir_learn_state_t ir_learning_get_state(ir_slot_t *slot)
+{
+    if (slot) {
+        *slot = learn_slot;
+    }
+    return learn_state;
+}
+
+bool ir_learning_get_code(ir_slot_t slot, ir_code_t *code)
+{
+    if (!codes_mutex || slot >= IR_SLOT_COUNT || !code) {
+        return false;
+    }
+
+    xSemaphoreTake(codes_mutex, portMAX_DELAY);
+    bool valid = code_valid[slot];
+    if (valid) {
+        *code = codes[slot];
+    }
+    xSemaphoreGive(codes_mutex);
+    return valid;
+}
+
+esp_err_t ir_learning_clear(ir_slot_t slot)
+{
+    if (!codes_mutex || slot >= IR_SLOT_COUNT) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xSemaphoreTake(codes_mutex, portMAX_DELAY);
+    code_valid[slot] = false;
+    xSemaphoreGive(codes_mutex);
+
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(IR_CODES_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = nvs_erase_key(handle, slot_names[slot]);
+    if (err == ESP_OK) {
+        err = nvs_commit(handle);
+    } else if (err == ESP_ERR_NVS_NOT_FOUND) {
+        err = ESP_OK;
+    }
+    nvs_close(handle);
+
+    ESP_LOGI(TAG, "Forgot learned code for '%s'", slot_names[slot]);
+    return err;
+}
+
+const char* ir_slot_name(ir_slot_t slot)
+{
+    return slot < IR_SLOT_COUNT ? slot_names[slot] : "unknown";
+}
+
+bool ir_slot_from_name(const char *name, ir_slot_t *slot)
+{
+    if (!name) {
+        return false;
+    }
+    for (int i = 0; i < IR_SLOT_COUNT; i++) {
+        if (strcmp(name, slot_names[i]) == 0) {
+            *slot = (ir_slot_t)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* ir_learn_state_name(ir_learn_state_t state)
+{
+    switch (state) {
+        case IR_LEARN_IDLE:         return "idle";
+        case IR_LEARN_LISTENING:    return "listening";
+        case IR_LEARN_DONE:         return "done";
+        case IR_LEARN_TIMEOUT:      return "timeout";
+        case IR_LEARN_FAILED:       return "failed";
+        default:                    return "unknown";
+    }
+}
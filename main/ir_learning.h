@@ -0,0 +1,104 @@
+/**
+ * IR Learning Module
+ *
+ * Captures button presses from any lamp remote via the RMT RX channel
+ * (IR receiver on GPIO38), decodes them and stores them in NVS as the
+ * code to send for a glucose state. Unknown protocols are kept as raw
+ * timings and replayed verbatim.
+ */
+
+#ifndef IR_LEARNING_H
+#define IR_LEARNING_H
+
+#include "esp_err.h"
+#include "ir_decoder.h"
+#include <stdbool.h>
+
+// How long a learning session listens for a button press
+#define IR_LEARN_TIMEOUT_MS     15000
+
+/**
+ * Lamp code slots (one learned code each)
+ */
+typedef enum {
+    IR_SLOT_ON = 0,         // Power on, sent before every color
+    IR_SLOT_NORMAL,         // Glucose in range
+    IR_SLOT_WARNING,        // Glucose high / warning
+    IR_SLOT_HYPO,           // Glucose critically low
+    IR_SLOT_NO_DATA,        // Unknown glucose state
+    IR_SLOT_COUNT
+} ir_slot_t;
+
+/**
+ * Learning session state
+ */
+typedef enum {
+    IR_LEARN_IDLE = 0,
+    IR_LEARN_LISTENING,
+    IR_LEARN_DONE,
+    IR_LEARN_TIMEOUT,
+    IR_LEARN_FAILED,
+} ir_learn_state_t;
+
+/**
+ * Initialize IR learning
+ * Loads learned codes from NVS and creates the RMT RX channel
+ *
+ * @return ESP_OK on success, error code otherwise
+ */
+esp_err_t ir_learning_init(void);
+
+/**
+ * Start listening for a button press to store in a slot
+ * Returns immediately; poll ir_learning_get_state() for the result
+ *
+ * @param slot Slot to fill
+ * @return ESP_OK if started, ESP_ERR_INVALID_STATE if a session is running or not initialized
+ */
+esp_err_t ir_learning_start(ir_slot_t slot);
+
+/**
+ * Get the current (or last) learning session state
+ *
+ * @param slot Output: slot of the session (may be NULL)
+ * @return Session state
+ */
+ir_learn_state_t ir_learning_get_state(ir_slot_t *slot);
+
+/**
+ * Get the learned code for a slot
+ *
+ * @param slot Slot
+ * @param code Output code
+ * @return true if the slot holds a learned code
+ */
+bool ir_learning_get_code(ir_slot_t slot, ir_code_t *code);
+
+/**
+ * Forget the learned code for a slot (falls back to the built-in command)
+ *
+ * @param slot Slot
+ * @return ESP_OK on success
+ */
+esp_err_t ir_learning_clear(ir_slot_t slot);
+
+/**
+ * Slot name used in NVS keys and the web API ("on", "normal", ...)
+ */
+const char* ir_slot_name(ir_slot_t slot);
+
+/**
+ * Parse a slot name
+ *
+ * @param name Slot name
+ * @param slot Output slot
+ * @return true if the name is valid
+ */
+bool ir_slot_from_name(const char *name, ir_slot_t *slot);
+
+/**
+ * Get learning state name ("idle", "listening", ...)
+ */
+const char* ir_learn_state_name(ir_learn_state_t state);
+
+#endif // IR_LEARNING_H
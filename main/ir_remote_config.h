@@ -10,6 +10,9 @@
 
 #include <stdint.h>
 
+// Remote protocol (see ir_encoder.h: NEC, SAMSUNG or RC5)
+#define IR_REMOTE_PROTOCOL          IR_PROTOCOL_NEC
+
 // Remote address
 #define IR_REMOTE_ADDRESS           0xFF00
 
@@ -23,6 +26,13 @@
 #define IR_CMD_INCREASE_BRIGHTNESS  0x5D
 #define IR_CMD_DECREASE_BRIGHTNESS  0x41
 
+// Moon Lamp worker behaviour
+#define IR_LAMP_REPEAT_COUNT        2     // Times each frame is sent (IR is lossy)
+#define IR_LAMP_REPEAT_GAP_MS       40    // Gap between repeated frames
+#define IR_LAMP_COMMAND_GAP_MS      100   // Gap between ON and color commands
+#define IR_LAMP_COALESCE_MS         250   // Wait for further changes before transmitting
+#define IR_LAMP_QUEUE_LENGTH        8     // Pending lamp state requests
+
 /**
  * Get button name from command code
  * Returns a human-readable string for the command
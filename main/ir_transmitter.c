@@ -1,18 +1,22 @@
 /**
  * IR Transmitter Module
  * 
- * Sends NEC protocol IR commands to control Moon Lamp
+ * Sends IR commands (built-in or learned) to control Moon Lamp
  * Uses GPIO39 for IR LED transmission
  */
 
 #include "ir_transmitter.h"
 #include "ir_remote_config.h"
+#include "ir_encoder.h"
+#include "ir_learning.h"
 #include "global_settings.h"
 #include "esp_log.h"
 #include "driver/rmt_tx.h"
 #include "driver/gpio.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
 
 static const char *TAG = "IR_TX";
 
@@ -20,198 +24,98 @@ static const char *TAG = "IR_TX";
 #define IR_TX_GPIO              GPIO_NUM_39
 #define IR_CTRL_GPIO            GPIO_NUM_44  // Power control for IR transmitter
 
-// NEC Protocol Timing (in microseconds)
-#define NEC_LEADING_CODE_HIGH   9000
-#define NEC_LEADING_CODE_LOW    4500
-#define NEC_PAYLOAD_ONE_HIGH    560
-#define NEC_PAYLOAD_ONE_LOW     1690
-#define NEC_PAYLOAD_ZERO_HIGH   560
-#define NEC_PAYLOAD_ZERO_LOW    560
-#define NEC_REPEAT_CODE_HIGH    9000
-#define NEC_REPEAT_CODE_LOW     2250
-
 // RMT carrier configuration for 38kHz IR carrier
 #define IR_CARRIER_FREQ_HZ      38000
 #define IR_CARRIER_DUTY_CYCLE   0.33  // 33% duty cycle
 
 // RMT handles
 static rmt_channel_handle_t tx_channel = NULL;
-static rmt_encoder_handle_t nec_encoder = NULL;
+static rmt_encoder_handle_t copy_encoder = NULL;
 
-// NEC IR encoder structure
-typedef struct {
-    rmt_encoder_t base;
-    rmt_encoder_t *copy_encoder;
-    rmt_encoder_t *bytes_encoder;
-    rmt_symbol_word_t nec_leading_symbol;
-    rmt_symbol_word_t nec_ending_symbol;
-    int state;
-} rmt_nec_encoder_t;
+_Static_assert(sizeof(ir_symbol_t) == sizeof(rmt_symbol_word_t), "ir_symbol_t must match rmt_symbol_word_t");
 
-// NEC encoder states
-enum {
-    NEC_STATE_IDLE,
-    NEC_STATE_LEADING,
-    NEC_STATE_DATA,
-    NEC_STATE_ENDING
-};
-
-// NEC frame structure
+// Precomputed symbol buffers for the configured remote's commands
 typedef struct {
+    ir_protocol_t protocol;
     uint16_t address;
     uint8_t command;
-} nec_frame_t;
+    bool toggle;
+    size_t count;
+    ir_symbol_t symbols[IR_ENCODER_MAX_SYMBOLS];
+} ir_cached_frame_t;
 
-// Encode function for NEC protocol
-static size_t nec_encode(rmt_encoder_t *encoder, rmt_channel_handle_t channel,
-                         const void *primary_data, size_t data_size,
-                         rmt_encode_state_t *ret_state)
-{
-    rmt_nec_encoder_t *nec_encoder = __containerof(encoder, rmt_nec_encoder_t, base);
-    rmt_encode_state_t session_state = RMT_ENCODING_RESET;
-    size_t encoded_symbols = 0;
-    nec_frame_t *frame = (nec_frame_t *)primary_data;
+static const uint8_t cached_commands[] = {
+    IR_CMD_ON, IR_CMD_OFF, IR_CMD_RED, IR_CMD_GREEN, IR_CMD_WHITE,
+    IR_CMD_SMOOTH, IR_CMD_INCREASE_BRIGHTNESS, IR_CMD_DECREASE_BRIGHTNESS,
+};
+#define IR_SYMBOL_CACHE_SIZE    (2 * sizeof(cached_commands) + 1)  // Both RC5 toggles + NEC repeat
 
-    switch (nec_encoder->state) {
-    case NEC_STATE_IDLE:
-        nec_encoder->state = NEC_STATE_LEADING;
-        // Fall through
-    case NEC_STATE_LEADING:
-        encoded_symbols += nec_encoder->copy_encoder->encode(nec_encoder->copy_encoder, channel,
-                                                             &nec_encoder->nec_leading_symbol, sizeof(rmt_symbol_word_t),
-                                                             &session_state);
-        if (session_state & RMT_ENCODING_COMPLETE) {
-            nec_encoder->state = NEC_STATE_DATA;
-        }
-        if (session_state & RMT_ENCODING_MEM_FULL) {
-            goto out;
-        }
-        // Fall through
-    case NEC_STATE_DATA:
-        // Encode address (16 bits) and command (8 bits) + inverted command (8 bits)
-        uint8_t data_to_encode[4];
-        data_to_encode[0] = frame->address & 0xFF;         // Address low byte
-        data_to_encode[1] = (frame->address >> 8) & 0xFF;  // Address high byte
-        data_to_encode[2] = frame->command;                 // Command
-        data_to_encode[3] = ~frame->command;                // Inverted command
-        
-        encoded_symbols += nec_encoder->bytes_encoder->encode(nec_encoder->bytes_encoder, channel,
-                                                               data_to_encode, sizeof(data_to_encode),
-                                                               &session_state);
-        if (session_state & RMT_ENCODING_COMPLETE) {
-            nec_encoder->state = NEC_STATE_ENDING;
-        }
-        if (session_state & RMT_ENCODING_MEM_FULL) {
-            goto out;
-        }
-        // Fall through
-    case NEC_STATE_ENDING:
-        encoded_symbols += nec_encoder->copy_encoder->encode(nec_encoder->copy_encoder, channel,
-                                                             &nec_encoder->nec_ending_symbol, sizeof(rmt_symbol_word_t),
-                                                             &session_state);
-        if (session_state & RMT_ENCODING_COMPLETE) {
-            nec_encoder->state = NEC_STATE_IDLE;
-        }
-        if (session_state & RMT_ENCODING_MEM_FULL) {
-            goto out;
-        }
-    }
-out:
-    *ret_state = session_state;
-    return encoded_symbols;
-}
+static ir_cached_frame_t symbol_cache[IR_SYMBOL_CACHE_SIZE];
+static size_t symbol_cache_count = 0;
+static ir_symbol_t scratch_symbols[IR_ENCODER_MAX_SYMBOLS];  // Uncached frames (guarded by tx_mutex)
+static bool rc5_toggle = false;  // Guarded by tx_mutex
 
-// Reset encoder state
-static esp_err_t nec_encoder_reset(rmt_encoder_t *encoder)
-{
-    rmt_nec_encoder_t *nec_encoder = __containerof(encoder, rmt_nec_encoder_t, base);
-    rmt_encoder_reset(nec_encoder->copy_encoder);
-    rmt_encoder_reset(nec_encoder->bytes_encoder);
-    nec_encoder->state = NEC_STATE_IDLE;
-    return ESP_OK;
-}
+// Serializes access to the RMT channel (worker task and web test commands)
+static SemaphoreHandle_t tx_mutex = NULL;
 
-// Delete encoder
-static esp_err_t nec_encoder_del(rmt_encoder_t *encoder)
-{
-    rmt_nec_encoder_t *nec_encoder = __containerof(encoder, rmt_nec_encoder_t, base);
-    rmt_del_encoder(nec_encoder->copy_encoder);
-    rmt_del_encoder(nec_encoder->bytes_encoder);
-    free(nec_encoder);
-    return ESP_OK;
-}
+// Moon Lamp worker - display refresh only queues the wanted lamp slot
+#define IR_LAMP_STATE_UNKNOWN   0xFF
+static QueueHandle_t lamp_queue = NULL;
+static portMUX_TYPE lamp_state_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint8_t lamp_last_sent = IR_LAMP_STATE_UNKNOWN;  // Slot the lamp is believed to show
+static uint32_t manual_sends = 0;                        // Bumped by every manual command
+static void ir_lamp_task(void *pvParameters);
 
-// Create NEC encoder
-static esp_err_t nec_encoder_create(rmt_encoder_handle_t *ret_encoder)
+static void symbol_cache_add(ir_protocol_t protocol, uint16_t address, uint8_t command, bool toggle)
 {
-    esp_err_t ret = ESP_OK;
-    rmt_nec_encoder_t *nec_encoder = calloc(1, sizeof(rmt_nec_encoder_t));
-    if (!nec_encoder) {
-        return ESP_ERR_NO_MEM;
+    if (symbol_cache_count >= IR_SYMBOL_CACHE_SIZE) {
+        return;
     }
-    
-    nec_encoder->base.encode = nec_encode;
-    nec_encoder->base.del = nec_encoder_del;
-    nec_encoder->base.reset = nec_encoder_reset;
-    
-    // Create copy encoder for leading/ending codes
-    rmt_copy_encoder_config_t copy_encoder_config = {};
-    ret = rmt_new_copy_encoder(&copy_encoder_config, &nec_encoder->copy_encoder);
-    if (ret != ESP_OK) {
-        goto err;
+    ir_cached_frame_t *entry = &symbol_cache[symbol_cache_count];
+    entry->count = ir_encode_frame(protocol, address, command, toggle,
+                                   entry->symbols, IR_ENCODER_MAX_SYMBOLS);
+    if (entry->count == 0) {
+        ESP_LOGW(TAG, "Cannot encode %s command 0x%02X", ir_protocol_name(protocol), command);
+        return;
     }
-    
-    // Create bytes encoder for data
-    rmt_bytes_encoder_config_t bytes_encoder_config = {
-        .bit0 = {
-            .level0 = 1,
-            .duration0 = NEC_PAYLOAD_ZERO_HIGH,
-            .level1 = 0,
-            .duration1 = NEC_PAYLOAD_ZERO_LOW,
-        },
-        .bit1 = {
-            .level0 = 1,
-            .duration0 = NEC_PAYLOAD_ONE_HIGH,
-            .level1 = 0,
-            .duration1 = NEC_PAYLOAD_ONE_LOW,
-        },
-        .flags.msb_first = 0  // LSB first for NEC
-    };
-    ret = rmt_new_bytes_encoder(&bytes_encoder_config, &nec_encoder->bytes_encoder);
-    if (ret != ESP_OK) {
-        goto err;
+    entry->protocol = protocol;
+    entry->address = address;
+    entry->command = command;
+    entry->toggle = toggle;
+    symbol_cache_count++;
+}
+
+// Encode every known command of the configured remote once
+static void symbol_cache_build(void)
+{
+    symbol_cache_count = 0;
+    for (size_t i = 0; i < sizeof(cached_commands); i++) {
+        symbol_cache_add(IR_REMOTE_PROTOCOL, IR_REMOTE_ADDRESS, cached_commands[i], false);
+        if (IR_REMOTE_PROTOCOL == IR_PROTOCOL_RC5) {
+            symbol_cache_add(IR_REMOTE_PROTOCOL, IR_REMOTE_ADDRESS, cached_commands[i], true);
+        }
     }
-    
-    // Leading code: 9ms high + 4.5ms low
-    nec_encoder->nec_leading_symbol = (rmt_symbol_word_t) {
-        .level0 = 1,
-        .duration0 = NEC_LEADING_CODE_HIGH,
-        .level1 = 0,
-        .duration1 = NEC_LEADING_CODE_LOW,
-    };
-    
-    // Ending code: 560us high
-    nec_encoder->nec_ending_symbol = (rmt_symbol_word_t) {
-        .level0 = 1,
-        .duration0 = NEC_PAYLOAD_ZERO_HIGH,
-        .level1 = 0,
-        .duration1 = 0x7FFF,  // Large duration for ending
-    };
-    
-    *ret_encoder = &nec_encoder->base;
-    return ESP_OK;
+    symbol_cache_add(IR_PROTOCOL_NEC_REPEAT, 0, 0, false);
+    ESP_LOGI(TAG, "Precomputed %d IR frames (%s)", (int)symbol_cache_count, ir_protocol_name(IR_REMOTE_PROTOCOL));
+}
 
-err:
-    if (nec_encoder) {
-        if (nec_encoder->copy_encoder) {
-            rmt_del_encoder(nec_encoder->copy_encoder);
+static const ir_cached_frame_t* symbol_cache_find(ir_protocol_t protocol, uint16_t address, uint8_t command, bool toggle)
+{
+    for (size_t i = 0; i < symbol_cache_count; i++) {
+        const ir_cached_frame_t *entry = &symbol_cache[i];
+        if (entry->protocol != protocol) {
+            continue;
+        }
+        if (protocol == IR_PROTOCOL_NEC_REPEAT) {
+            return entry;
         }
-        if (nec_encoder->bytes_encoder) {
-            rmt_del_encoder(nec_encoder->bytes_encoder);
+        // Only RC5 frames carry the toggle bit; it is ignored when encoding the others
+        if (entry->address == address && entry->command == command &&
+            (protocol != IR_PROTOCOL_RC5 || entry->toggle == toggle)) {
+            return entry;
         }
-        free(nec_encoder);
     }
-    return ret;
+    return NULL;
 }
 
 esp_err_t ir_transmitter_init(void)
@@ -288,14 +192,15 @@ esp_err_t ir_transmitter_init(void)
     
     ESP_LOGI(TAG, "38kHz carrier configured");
     
-    // Create NEC encoder
-    ret = nec_encoder_create(&nec_encoder);
+    // Frames are precomputed, so transmission is a plain buffer copy
+    rmt_copy_encoder_config_t copy_encoder_config = {};
+    ret = rmt_new_copy_encoder(&copy_encoder_config, &copy_encoder);
     if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to create NEC encoder: %s", esp_err_to_name(ret));
+        ESP_LOGE(TAG, "Failed to create copy encoder: %s", esp_err_to_name(ret));
         return ret;
     }
     
-    ESP_LOGI(TAG, "NEC encoder created successfully");
+    symbol_cache_build();
     
     // Enable RMT TX channel
     ret = rmt_enable(tx_channel);
@@ -304,93 +209,242 @@ esp_err_t ir_transmitter_init(void)
         return ret;
     }
     
+    // Start Moon Lamp worker
+    tx_mutex = xSemaphoreCreateMutex();
+    lamp_queue = xQueueCreate(IR_LAMP_QUEUE_LENGTH, sizeof(uint8_t));
+    if (!tx_mutex || !lamp_queue ||
+        xTaskCreate(ir_lamp_task, "ir_lamp", 3072, NULL, 3, NULL) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to start Moon Lamp worker");
+        return ESP_ERR_NO_MEM;
+    }
+    
     ESP_LOGI(TAG, "IR transmitter initialized successfully");
     return ESP_OK;
 }
 
-esp_err_t ir_transmitter_send_command(uint16_t address, uint8_t command)
+// Hand a symbol buffer to the RMT channel and wait for it to finish (caller holds tx_mutex)
+static esp_err_t ir_transmit_locked(const ir_symbol_t *symbols, size_t count)
 {
-    if (!tx_channel || !nec_encoder) {
-        ESP_LOGE(TAG, "IR transmitter not initialized");
-        return ESP_ERR_INVALID_STATE;
-    }
-    
-    nec_frame_t frame = {
-        .address = address,
-        .command = command,
-    };
-    
     rmt_transmit_config_t transmit_config = {
         .loop_count = 0,  // No loop
     };
     
-    ESP_LOGI(TAG, "Sending IR command - Address: 0x%04X, Command: 0x%02X (%s)", 
-             address, command, ir_get_command_name(command));
-    
-    esp_err_t ret = rmt_transmit(tx_channel, nec_encoder, &frame, sizeof(frame), &transmit_config);
+    esp_err_t ret = rmt_transmit(tx_channel, copy_encoder, symbols, count * sizeof(ir_symbol_t), &transmit_config);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to transmit IR command: %s", esp_err_to_name(ret));
         return ret;
     }
     
-    // Wait for transmission to complete
+    // Wait for transmission to complete (buffers are reused)
     ret = rmt_tx_wait_all_done(tx_channel, 1000);
     if (ret != ESP_OK) {
         ESP_LOGE(TAG, "Failed to wait for transmission: %s", esp_err_to_name(ret));
-        return ret;
     }
-    
-    ESP_LOGI(TAG, "IR command sent successfully");
-    return ESP_OK;
+    return ret;
 }
 
-esp_err_t ir_transmitter_set_moon_lamp_color(int measurement_color)
+// Transmit one frame and wait for it to finish (caller must not hold tx_mutex)
+// end_of_press flips the RC5 toggle bit afterwards, so the next key press differs
+static esp_err_t ir_send_frame(ir_protocol_t protocol, uint16_t address, uint8_t command, bool end_of_press)
 {
-    if (!global_settings_is_moon_lamp_enabled()) {
-        ESP_LOGD(TAG, "Moon Lamp control is disabled");
-        return ESP_OK;
+    if (!tx_channel || !copy_encoder || !tx_mutex) {
+        ESP_LOGE(TAG, "IR transmitter not initialized");
+        return ESP_ERR_INVALID_STATE;
     }
     
-    ESP_LOGI(TAG, "Setting Moon Lamp color based on measurement_color: %d", measurement_color);
+    ESP_LOGI(TAG, "Sending IR command - %s Address: 0x%04X, Command: 0x%02X (%s)", 
+             ir_protocol_name(protocol), address, command, ir_get_command_name(command));
     
-    // Always send ON command first
-    esp_err_t ret = ir_transmitter_send_command(IR_REMOTE_ADDRESS, IR_CMD_ON);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to send ON command");
-        return ret;
+    xSemaphoreTake(tx_mutex, portMAX_DELAY);
+    
+    const ir_symbol_t *symbols = NULL;
+    size_t count = 0;
+    const ir_cached_frame_t *cached = symbol_cache_find(protocol, address, command, rc5_toggle);
+    if (cached) {
+        symbols = cached->symbols;
+        count = cached->count;
+    } else {
+        count = ir_encode_frame(protocol, address, command, rc5_toggle,
+                                scratch_symbols, IR_ENCODER_MAX_SYMBOLS);
+        symbols = scratch_symbols;
     }
     
-    // Wait a bit between commands
-    vTaskDelay(pdMS_TO_TICKS(100));
+    esp_err_t ret = ESP_ERR_INVALID_ARG;
+    if (count == 0) {
+        ESP_LOGE(TAG, "Cannot encode %s address 0x%04X command 0x%02X",
+                 ir_protocol_name(protocol), address, command);
+    } else {
+        ret = ir_transmit_locked(symbols, count);
+    }
+    if (end_of_press) {
+        rc5_toggle = !rc5_toggle;
+    }
+    xSemaphoreGive(tx_mutex);
+    
+    return ret;
+}
+
+// Replay learned raw timings
+static esp_err_t ir_send_raw(const ir_symbol_t *symbols, size_t count)
+{
+    if (!tx_channel || !copy_encoder || !tx_mutex) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    ESP_LOGI(TAG, "Sending raw IR code (%d symbols)", (int)count);
     
-    // Determine color based on measurement_color from LibreLink API
-    // 1 = Normal (green), 2 = Warning (red/amber), 3 = Hypo (red)
-    uint8_t color_cmd;
+    xSemaphoreTake(tx_mutex, portMAX_DELAY);
+    esp_err_t ret = ir_transmit_locked(symbols, count);
+    xSemaphoreGive(tx_mutex);
+    return ret;
+}
+
+// Built-in command for a slot when nothing was learned
+static uint8_t default_command_for_slot(ir_slot_t slot)
+{
+    switch (slot) {
+        case IR_SLOT_ON:        return IR_CMD_ON;
+        case IR_SLOT_NORMAL:    return IR_CMD_GREEN;
+        case IR_SLOT_WARNING:   return IR_CMD_RED;   // Closest to amber/orange
+        case IR_SLOT_HYPO:      return IR_CMD_RED;
+        default:                return IR_CMD_WHITE;
+    }
+}
+
+// Send a slot's code IR_LAMP_REPEAT_COUNT times - succeeds if any copy went out
+// The copies belong to one key press, so the RC5 toggle bit only flips after the last
+static esp_err_t ir_send_slot_repeated(ir_slot_t slot)
+{
+    // Static: only the lamp worker calls this, and ir_code_t is large for its stack
+    static ir_code_t learned;
+    bool have_learned = ir_learning_get_code(slot, &learned);
+    esp_err_t result = ESP_FAIL;
+    
+    for (int i = 0; i < IR_LAMP_REPEAT_COUNT; i++) {
+        if (i > 0) {
+            vTaskDelay(pdMS_TO_TICKS(IR_LAMP_REPEAT_GAP_MS));
+        }
+        
+        bool last = (i == IR_LAMP_REPEAT_COUNT - 1);
+        esp_err_t ret;
+        if (!have_learned) {
+            ret = ir_send_frame(IR_REMOTE_PROTOCOL, IR_REMOTE_ADDRESS, default_command_for_slot(slot), last);
+        } else if (learned.raw) {
+            ret = ir_send_raw(learned.raw_symbols, learned.raw_count);
+        } else {
+            ret = ir_send_frame(learned.protocol, learned.address, learned.command, last);
+        }
+        if (ret == ESP_OK) {
+            result = ESP_OK;
+        }
+    }
+    return result;
+}
+
+// Map LibreLink measurement_color to a lamp slot
+// 1 = Normal (green), 2 = Warning (red/amber), 3 = Hypo (red)
+static ir_slot_t lamp_slot_for_measurement(int measurement_color)
+{
     if (measurement_color == 3) {
-        // Hypo (critical low) -> RED
-        color_cmd = IR_CMD_RED;
-        ESP_LOGI(TAG, "Setting Moon Lamp to RED (hypo)");
+        return IR_SLOT_HYPO;
     } else if (measurement_color == 2) {
-        // Warning/High -> RED (closest to amber/orange)
-        color_cmd = IR_CMD_RED;
-        ESP_LOGI(TAG, "Setting Moon Lamp to RED (warning/high)");
+        return IR_SLOT_WARNING;
     } else if (measurement_color == 1) {
-        // Normal -> GREEN
-        color_cmd = IR_CMD_GREEN;
-        ESP_LOGI(TAG, "Setting Moon Lamp to GREEN (normal)");
-    } else {
-        // Unknown state -> WHITE
-        color_cmd = IR_CMD_WHITE;
-        ESP_LOGI(TAG, "Setting Moon Lamp to WHITE (unknown state)");
+        return IR_SLOT_NORMAL;
     }
+    return IR_SLOT_NO_DATA;
+}
+
+// Moon Lamp worker: coalesces queued color requests and only transmits on change
+static void ir_lamp_task(void *pvParameters)
+{
+    uint8_t wanted;
     
-    // Send color command
-    ret = ir_transmitter_send_command(IR_REMOTE_ADDRESS, color_cmd);
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to send color command");
-        return ret;
+    while (1) {
+        if (xQueueReceive(lamp_queue, &wanted, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+        
+        // Let rapid changes settle, keep only the newest request
+        vTaskDelay(pdMS_TO_TICKS(IR_LAMP_COALESCE_MS));
+        uint8_t newer;
+        while (xQueueReceive(lamp_queue, &newer, 0) == pdTRUE) {
+            wanted = newer;
+        }
+        
+        taskENTER_CRITICAL(&lamp_state_lock);
+        bool already_shown = (wanted == lamp_last_sent);
+        uint32_t manual_before = manual_sends;
+        taskEXIT_CRITICAL(&lamp_state_lock);
+        if (already_shown) {
+            ESP_LOGD(TAG, "Moon Lamp already '%s', nothing to send", ir_slot_name(wanted));
+            continue;
+        }
+        
+        ESP_LOGI(TAG, "Setting Moon Lamp to '%s'", ir_slot_name(wanted));
+        
+        // Lamp must be on before it accepts a color
+        esp_err_t ret = ir_send_slot_repeated(IR_SLOT_ON);
+        if (ret == ESP_OK) {
+            vTaskDelay(pdMS_TO_TICKS(IR_LAMP_COMMAND_GAP_MS));
+            ret = ir_send_slot_repeated(wanted);
+        }
+        
+        // Unknown lamp state after a failure or a manual command sent
+        // meanwhile - the next request transmits again
+        taskENTER_CRITICAL(&lamp_state_lock);
+        bool manual_meanwhile = (manual_sends != manual_before);
+        lamp_last_sent = (ret == ESP_OK && !manual_meanwhile) ? wanted : IR_LAMP_STATE_UNKNOWN;
+        taskEXIT_CRITICAL(&lamp_state_lock);
+        
+        if (ret == ESP_OK) {
+            ESP_LOGI(TAG, "Moon Lamp color set successfully");
+        } else {
+            ESP_LOGE(TAG, "Failed to set Moon Lamp color: %s", esp_err_to_name(ret));
+        }
+    }
+}
+
+esp_err_t ir_transmitter_send_command(uint16_t address, uint8_t command)
+{
+    return ir_transmitter_send_code(IR_REMOTE_PROTOCOL, address, command);
+}
+
+esp_err_t ir_transmitter_send_code(ir_protocol_t protocol, uint16_t address, uint8_t command)
+{
+    esp_err_t ret = ir_send_frame(protocol, address, command, true);
+    
+    // A manual command may have changed the lamp behind the worker's back
+    taskENTER_CRITICAL(&lamp_state_lock);
+    lamp_last_sent = IR_LAMP_STATE_UNKNOWN;
+    manual_sends++;
+    taskEXIT_CRITICAL(&lamp_state_lock);
+    
+    if (ret == ESP_OK) {
+        ESP_LOGI(TAG, "IR command sent successfully");
+    }
+    return ret;
+}
+
+esp_err_t ir_transmitter_set_moon_lamp_color(int measurement_color)
+{
+    if (!global_settings_is_moon_lamp_enabled()) {
+        ESP_LOGD(TAG, "Moon Lamp control is disabled");
+        return ESP_OK;
+    }
+    
+    if (!lamp_queue) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    
+    uint8_t wanted = lamp_slot_for_measurement(measurement_color);
+    
+    // Never block the caller: if the queue is full drop the oldest request
+    if (xQueueSend(lamp_queue, &wanted, 0) != pdTRUE) {
+        uint8_t dropped;
+        xQueueReceive(lamp_queue, &dropped, 0);
+        xQueueSend(lamp_queue, &wanted, 0);
     }
     
-    ESP_LOGI(TAG, "Moon Lamp color set successfully");
     return ESP_OK;
 }
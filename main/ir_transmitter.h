@@ -1,7 +1,7 @@
 /**
  * IR Transmitter Module
  * 
- * Sends NEC protocol IR commands to control Moon Lamp
+ * Sends IR commands (NEC, Samsung, RC5) to control Moon Lamp
  * Uses GPIO39 for IR LED transmission
  */
 
@@ -9,6 +9,7 @@
 #define IR_TRANSMITTER_H
 
 #include "esp_err.h"
+#include "ir_encoder.h"
 #include <stdbool.h>
 
 /**
@@ -20,22 +21,37 @@
 esp_err_t ir_transmitter_init(void);
 
 /**
- * Send an IR command using NEC protocol
+ * Send an IR command using the configured remote's protocol (IR_REMOTE_PROTOCOL)
+ * Blocks until the frame has been transmitted
  * 
- * @param address 16-bit address code (e.g., 0xFF00)
- * @param command 8-bit command code (e.g., IR_CMD_RED)
+ * @param address Device address (e.g., IR_REMOTE_ADDRESS)
+ * @param command Command code (e.g., IR_CMD_RED)
  * @return ESP_OK on success, error code otherwise
  */
 esp_err_t ir_transmitter_send_command(uint16_t address, uint8_t command);
 
 /**
- * Send Moon Lamp color based on glucose state
- * Automatically sends ON command followed by color command
+ * Send an IR command using any supported protocol
+ * Known commands of the configured remote use precomputed symbol buffers,
+ * other codes are encoded on the fly. The RC5 toggle bit flips per call.
+ * Blocks until the frame has been transmitted
  * 
- * @param is_low True if glucose is low (will send RED)
- * @param is_high True if glucose is high (will send RED)
- * @param is_normal True if glucose is normal (will send GREEN)
- * @return ESP_OK on success, error code otherwise
+ * @param protocol IR protocol (address/command are ignored for IR_PROTOCOL_NEC_REPEAT)
+ * @param address Device address (RC5: 0-31)
+ * @param command Command code (RC5: 0-127)
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if the code can't be encoded
+ */
+esp_err_t ir_transmitter_send_code(ir_protocol_t protocol, uint16_t address, uint8_t command);
+
+/**
+ * Request Moon Lamp color based on glucose state
+ * Non-blocking: the request is queued to the IR worker task, which
+ * coalesces rapid changes, skips colors the lamp already shows and
+ * sends ON followed by the color (each repeated IR_LAMP_REPEAT_COUNT times).
+ * Codes learned via ir_learning.h replace the built-in NEC commands.
+ * 
+ * @param measurement_color LibreLink color (1=normal/GREEN, 2=high/RED, 3=hypo/RED, other=WHITE)
+ * @return ESP_OK if queued (or lamp disabled), ESP_ERR_INVALID_STATE if not initialized
  */
 esp_err_t ir_transmitter_set_moon_lamp_color(int measurement_color);
 
@@ -0,0 +1,489 @@
+/**
+ * LAN Share Implementation
+ */
+
+#include "lan_share.h"
+#include "lan_share_proto.h"
+#include "config.h"
+#include "global_settings.h"
+#include "libre_credentials.h"
+#include "nvs_journal.h"
+#include "power.h"
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "mbedtls/sha256.h"
+#include "lwip/sockets.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const char *TAG = "LAN_SHARE";
+static const char *LAN_NAMESPACE = "lan_share";
+static const char *LAN_KEY_KEY = "key";
+
+#define LAN_TASK_STACK          4096
+#define LAN_TASK_PRIORITY       3
+#define LAN_RECV_TIMEOUT_MS     250
+#define LAN_DISABLED_POLL_MS    2000
+
+_Static_assert(LAN_SHARE_GRAPH_MAX_POINTS == MAX_GRAPH_POINTS, "a GRAPH packet must hold the whole graph");
+
+static TaskHandle_t lan_task = NULL;
+static lan_share_event_cb_t event_callback = NULL;
+static volatile lan_share_role_t current_role = LAN_SHARE_STANDALONE;
+
+// Guards everything below (the socket is shared by the glucose task's sends)
+static SemaphoreHandle_t lan_mutex = NULL;
+static StaticSemaphore_t lan_mutex_buf;
+
+static int sock = -1;
+static struct sockaddr_in group_addr;
+static uint64_t self_id = 0;
+static lan_election_t election;
+static lan_msg_t tx_msg;
+static uint8_t tx_buf[LAN_SHARE_PACKET_MAX];
+static uint32_t tx_seq = 0;
+
+// Shared key, loaded each time the socket opens
+static uint8_t share_key[LAN_SHARE_KEY_LEN];
+static bool share_key_set = false;
+static lan_replay_t replay;
+
+// Leader state
+static uint32_t graph_sent_newest = 0;          // Newest graph point multicast so far
+static uint32_t graph_catch_up = UINT32_MAX;    // Oldest graph time a follower reported behind
+static uint32_t catch_up_sent_ms = 0;
+
+// Follower state
+static bool reading_pending = false;
+static libre_glucose_data_t pending_reading;
+static lan_point_t follower_graph[LAN_SHARE_GRAPH_MAX_POINTS];
+static size_t follower_graph_count = 0;
+
+static uint32_t now_ms(void)
+{
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+static lan_share_role_t role_of(const lan_election_t *e)
+{
+    return e->role == LAN_ROLE_LEADER ? LAN_SHARE_LEADER : LAN_SHARE_FOLLOWER;
+}
+
+static uint32_t wall_clock_s(void)
+{
+    time_t now = time(NULL);
+    return now > 0 ? (uint32_t)now : 0;
+}
+
+static void send_locked(lan_msg_t *msg)
+{
+    msg->time = wall_clock_s();
+    msg->seq = ++tx_seq;
+    size_t len = lan_msg_encode(msg, share_key, tx_buf, sizeof(tx_buf));
+    if (len == 0 || sock < 0) {
+        return;
+    }
+    if (sendto(sock, tx_buf, len, 0, (struct sockaddr *)&group_addr, sizeof(group_addr)) < 0) {
+        ESP_LOGD(TAG, "sendto failed: errno %d", errno);
+    }
+}
+
+static void send_hello_locked(bool eligible)
+{
+    memset(&tx_msg, 0, sizeof(tx_msg));
+    tx_msg.type = LAN_MSG_HELLO;
+    tx_msg.node_id = self_id;
+    tx_msg.hello.leader = election.role == LAN_ROLE_LEADER;
+    tx_msg.hello.eligible = eligible;
+    tx_msg.hello.graph_newest = election.role == LAN_ROLE_LEADER ? graph_sent_newest :
+                                follower_graph_count ? follower_graph[follower_graph_count - 1].time : 0;
+    send_locked(&tx_msg);
+}
+
+// Multicast the cached graph points newer than since
+static void send_graph_locked(uint32_t since)
+{
+    libre_graph_data_t *graph = malloc(sizeof(*graph));
+    if (!graph) {
+        return;
+    }
+    if (librelinkup_get_graph_data(graph) == ESP_OK) {
+        memset(&tx_msg, 0, sizeof(tx_msg));
+        tx_msg.type = LAN_MSG_GRAPH;
+        tx_msg.node_id = self_id;
+        for (int i = 0; i < graph->count && tx_msg.graph.count < LAN_SHARE_GRAPH_MAX_POINTS; i++) {
+            uint32_t t = (uint32_t)graph->points[i].unix_time;
+            if (t == 0 || t <= since) {
+                continue;
+            }
+            lan_point_t *p = &tx_msg.graph.points[tx_msg.graph.count++];
+            p->time = t;
+            p->mgdl = (uint16_t)graph->points[i].value_mgdl;
+            p->color = (uint8_t)graph->points[i].measurement_color;
+            if (t > graph_sent_newest) {
+                graph_sent_newest = t;
+            }
+        }
+        if (tx_msg.graph.count > 0) {
+            send_locked(&tx_msg);
+        }
+    }
+    free(graph);
+}
+
+static void handle_reading_locked(const lan_msg_t *msg)
+{
+    const lan_reading_t *r = &msg->reading.reading;
+    libre_glucose_data_t *g = &pending_reading;
+
+    memset(g, 0, sizeof(*g));
+    g->value_mgdl = r->mgdl;
+    g->value_mmol = librelinkup_mgdl_to_mmol(r->mgdl);
+    g->trend = (libre_trend_t)r->trend;
+    g->is_high = r->is_high;
+    g->is_low = r->is_low;
+    g->unix_time = (time_t)r->time;
+    g->measurement_color = r->color;
+    g->type = r->type;
+    snprintf(g->timestamp, sizeof(g->timestamp), "%s", r->timestamp);
+    reading_pending = true;
+}
+
+static void handle_graph_locked(const lan_msg_t *msg)
+{
+    if (lan_graph_merge(follower_graph, &follower_graph_count, msg->graph.points, msg->graph.count) == 0) {
+        return;
+    }
+
+    libre_graph_data_t *graph = calloc(1, sizeof(*graph));
+    if (!graph) {
+        return;
+    }
+    for (size_t i = 0; i < follower_graph_count; i++) {
+        graph->points[i].unix_time = follower_graph[i].time;
+        graph->points[i].value_mgdl = follower_graph[i].mgdl;
+        graph->points[i].value_mmol = librelinkup_mgdl_to_mmol(follower_graph[i].mgdl);
+        graph->points[i].measurement_color = follower_graph[i].color;
+    }
+    graph->count = (int)follower_graph_count;
+    librelinkup_set_graph_data(graph);
+    free(graph);
+}
+
+static void close_socket_locked(void)
+{
+    if (sock >= 0) {
+        close(sock);
+        sock = -1;
+        power_set_wifi_multicast(false);
+    }
+}
+
+static esp_err_t open_socket_locked(void)
+{
+    sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+    if (sock < 0) {
+        ESP_LOGE(TAG, "socket failed: errno %d", errno);
+        return ESP_FAIL;
+    }
+
+    int reuse = 1;
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    struct sockaddr_in bind_addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(LAN_SHARE_PORT),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+    struct ip_mreq mreq = {
+        .imr_interface.s_addr = htonl(INADDR_ANY),
+    };
+    inet_aton(LAN_SHARE_GROUP, &mreq.imr_multiaddr);
+    uint8_t ttl = 1;        // Never leave the LAN
+    uint8_t loop = 0;       // Don't hear ourselves
+    struct timeval timeout = {
+        .tv_sec = 0,
+        .tv_usec = LAN_RECV_TIMEOUT_MS * 1000,
+    };
+
+    if (bind(sock, (struct sockaddr *)&bind_addr, sizeof(bind_addr)) < 0 ||
+        setsockopt(sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0 ||
+        setsockopt(sock, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl)) < 0 ||
+        setsockopt(sock, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop)) < 0 ||
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) < 0) {
+        ESP_LOGE(TAG, "Failed to join %s:%d: errno %d", LAN_SHARE_GROUP, LAN_SHARE_PORT, errno);
+        close_socket_locked();
+        return ESP_FAIL;
+    }
+
+    group_addr.sin_family = AF_INET;
+    group_addr.sin_port = htons(LAN_SHARE_PORT);
+    inet_aton(LAN_SHARE_GROUP, &group_addr.sin_addr);
+    power_set_wifi_multicast(true);
+    return ESP_OK;
+}
+
+// Load the shared key from NVS (false if none has been set)
+static bool load_key_locked(void)
+{
+    share_key_set = false;
+    nvs_handle_t handle;
+    if (nvs_open(LAN_NAMESPACE, NVS_READONLY, &handle) == ESP_OK) {
+        size_t len = sizeof(share_key);
+        share_key_set = nvs_get_blob(handle, LAN_KEY_KEY, share_key, &len) == ESP_OK &&
+                        len == sizeof(share_key);
+        nvs_close(handle);
+    }
+    return share_key_set;
+}
+
+static bool node_is_eligible(void)
+{
+    return DEMO_MODE_ENABLED || libre_credentials_exist();
+}
+
+// Update the public role; returns true if it changed
+static bool set_role(lan_share_role_t role)
+{
+    if (current_role == role) {
+        return false;
+    }
+    ESP_LOGI(TAG, "Role: %s", role == LAN_SHARE_LEADER ? "leader" :
+                              role == LAN_SHARE_FOLLOWER ? "follower" : "standalone");
+    current_role = role;
+    if (role == LAN_SHARE_LEADER) {
+        graph_sent_newest = 0;  // The first publish sends the whole graph
+    }
+    return true;
+}
+
+static void lan_share_task(void *pvParameters)
+{
+    static lan_msg_t rx_msg;
+    uint8_t rx_buf[LAN_SHARE_PACKET_MAX];
+    bool eligible = false;
+    uint32_t eligible_checked_ms = 0;
+    bool warned_no_key = false;
+
+    while (1) {
+        bool notify = false;
+
+        if (!global_settings_is_lan_share_enabled()) {
+            xSemaphoreTake(lan_mutex, portMAX_DELAY);
+            close_socket_locked();
+            notify = set_role(LAN_SHARE_STANDALONE);
+            xSemaphoreGive(lan_mutex);
+            if (notify && event_callback) {
+                event_callback();
+            }
+            vTaskDelay(pdMS_TO_TICKS(LAN_DISABLED_POLL_MS));
+            continue;
+        }
+
+        if (sock < 0) {
+            xSemaphoreTake(lan_mutex, portMAX_DELAY);
+            esp_err_t err = ESP_ERR_INVALID_STATE;
+            if (!load_key_locked()) {
+                // Without the household key we can't trust (or be trusted by) anyone
+                if (!warned_no_key) {
+                    ESP_LOGW(TAG, "Sharing is on but no key is set; polling on our own");
+                    warned_no_key = true;
+                }
+                notify = set_role(LAN_SHARE_STANDALONE);
+            } else if ((err = open_socket_locked()) == ESP_OK) {
+                // Listen for a leader before polling ourselves
+                lan_election_init(&election, self_id, now_ms());
+                lan_replay_init(&replay);
+                notify = set_role(LAN_SHARE_FOLLOWER);
+                warned_no_key = false;
+                ESP_LOGI(TAG, "Joined %s:%d", LAN_SHARE_GROUP, LAN_SHARE_PORT);
+            }
+            xSemaphoreGive(lan_mutex);
+            if (notify && event_callback) {
+                event_callback();
+            }
+            if (err != ESP_OK) {
+                vTaskDelay(pdMS_TO_TICKS(share_key_set ? LAN_SHARE_HELLO_MS : LAN_DISABLED_POLL_MS));
+            }
+            continue;
+        }
+
+        // Credentials live in NVS; don't read them on every packet
+        uint32_t now = now_ms();
+        if (eligible_checked_ms == 0 || now - eligible_checked_ms >= LAN_SHARE_HELLO_MS) {
+            eligible = node_is_eligible();
+            eligible_checked_ms = now;
+        }
+
+        int len = recv(sock, rx_buf, sizeof(rx_buf), 0);
+        now = now_ms();
+
+        xSemaphoreTake(lan_mutex, portMAX_DELAY);
+        if (len > 0 && sock >= 0 && lan_msg_decode(rx_buf, (size_t)len, share_key, &rx_msg) &&
+            rx_msg.node_id != self_id && lan_replay_accept(&replay, &rx_msg, wall_clock_s(), now)) {
+            switch (rx_msg.type) {
+                case LAN_MSG_HELLO:
+                    lan_election_on_hello(&election, rx_msg.node_id, rx_msg.hello.leader, now);
+                    if (election.role == LAN_ROLE_LEADER && !rx_msg.hello.leader &&
+                        rx_msg.hello.graph_newest < graph_sent_newest &&
+                        rx_msg.hello.graph_newest < graph_catch_up) {
+                        graph_catch_up = rx_msg.hello.graph_newest;
+                    }
+                    break;
+
+                case LAN_MSG_READING:
+                    if (lan_election_accepts(&election, rx_msg.node_id)) {
+                        handle_reading_locked(&rx_msg);
+                        notify = true;
+                    }
+                    break;
+
+                case LAN_MSG_GRAPH:
+                    if (lan_election_accepts(&election, rx_msg.node_id)) {
+                        handle_graph_locked(&rx_msg);
+                    }
+                    break;
+            }
+        }
+
+        if (lan_election_tick(&election, eligible, now)) {
+            send_hello_locked(eligible);
+        }
+        notify |= set_role(role_of(&election));
+
+        // Bring a follower that joined late (or missed a packet) up to date
+        if (election.role == LAN_ROLE_LEADER && graph_catch_up != UINT32_MAX &&
+            now - catch_up_sent_ms >= LAN_SHARE_HELLO_MS) {
+            uint32_t newest = graph_sent_newest;
+            send_graph_locked(graph_catch_up);
+            graph_sent_newest = newest > graph_sent_newest ? newest : graph_sent_newest;
+            graph_catch_up = UINT32_MAX;
+            catch_up_sent_ms = now;
+        }
+        xSemaphoreGive(lan_mutex);
+
+        if (notify && event_callback) {
+            event_callback();
+        }
+    }
+}
+
+esp_err_t lan_share_start(lan_share_event_cb_t event_cb)
+{
+    if (lan_task) {
+        return ESP_OK;
+    }
+
+    lan_mutex = xSemaphoreCreateMutexStatic(&lan_mutex_buf);
+    event_callback = event_cb;
+
+    uint8_t mac[6] = {0};
+    esp_read_mac(mac, ESP_MAC_WIFI_STA);
+    for (size_t i = 0; i < sizeof(mac); i++) {
+        self_id = (self_id << 8) | mac[i];
+    }
+
+    if (xTaskCreate(lan_share_task, "lan_share", LAN_TASK_STACK, NULL, LAN_TASK_PRIORITY, &lan_task) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create LAN share task");
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+esp_err_t lan_share_set_key(const char *passphrase)
+{
+    size_t len = passphrase ? strlen(passphrase) : 0;
+    if (len < LAN_SHARE_PASSPHRASE_MIN_LEN || len > LAN_SHARE_PASSPHRASE_MAX_LEN) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    uint8_t key[LAN_SHARE_KEY_LEN];
+    mbedtls_sha256((const unsigned char *)passphrase, len, key, 0);
+    esp_err_t err = nvs_journal_set_blob(LAN_NAMESPACE, LAN_KEY_KEY, key, sizeof(key));
+    if (err == ESP_OK) {
+        err = nvs_journal_flush();
+    }
+    memset(key, 0, sizeof(key));
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to save key: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    // Rejoin with the new key (the task reloads it)
+    if (lan_mutex) {
+        xSemaphoreTake(lan_mutex, portMAX_DELAY);
+        close_socket_locked();
+        xSemaphoreGive(lan_mutex);
+    }
+    ESP_LOGI(TAG, "Key updated");
+    return ESP_OK;
+}
+
+bool lan_share_has_key(void)
+{
+    nvs_handle_t handle;
+    if (nvs_open(LAN_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        return false;
+    }
+    size_t len = 0;
+    bool has_key = nvs_get_blob(handle, LAN_KEY_KEY, NULL, &len) == ESP_OK && len == LAN_SHARE_KEY_LEN;
+    nvs_close(handle);
+    return has_key;
+}
+
+lan_share_role_t lan_share_get_role(void)
+{
+    return current_role;
+}
+
+void lan_share_publish(const libre_glucose_data_t *glucose)
+{
+    if (!lan_mutex || !glucose) {
+        return;
+    }
+
+    xSemaphoreTake(lan_mutex, portMAX_DELAY);
+    if (current_role == LAN_SHARE_LEADER && sock >= 0) {
+        memset(&tx_msg, 0, sizeof(tx_msg));
+        tx_msg.type = LAN_MSG_READING;
+        tx_msg.node_id = self_id;
+        lan_reading_t *r = &tx_msg.reading.reading;
+        r->time = glucose->unix_time > 0 ? (uint32_t)glucose->unix_time : 0;
+        r->mgdl = (uint16_t)glucose->value_mgdl;
+        r->trend = (uint8_t)glucose->trend;
+        r->color = (uint8_t)glucose->measurement_color;
+        r->is_high = glucose->is_high;
+        r->is_low = glucose->is_low;
+        r->type = (uint8_t)glucose->type;
+        snprintf(r->timestamp, sizeof(r->timestamp), "%s", glucose->timestamp);
+        send_locked(&tx_msg);
+
+        // Graph first reaches followers before the display redraws
+        send_graph_locked(graph_sent_newest);
+    }
+    xSemaphoreGive(lan_mutex);
+}
+
+bool lan_share_take_reading(libre_glucose_data_t *glucose)
+{
+    if (!lan_mutex) {
+        return false;
+    }
+
+    xSemaphoreTake(lan_mutex, portMAX_DELAY);
+    bool taken = reading_pending;
+    if (taken) {
+        *glucose = pending_reading;
+        reading_pending = false;
+    }
+    xSemaphoreGive(lan_mutex);
+    return taken;
+}
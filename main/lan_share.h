@@ -0,0 +1,87 @@
+/**
+ * LAN Share
+ * Lets several monitors in one household share a single LibreLinkUp poll
+ *
+ * With the "lan_share" setting on, monitors elect a leader over UDP
+ * multicast (LAN_SHARE_GROUP:LAN_SHARE_PORT, see lan_share_proto.h).
+ * The leader runs the normal glucose poll and multicasts each reading
+ * and the new graph points; followers show what the leader sends and
+ * never log in to LibreLinkUp. If the leader goes quiet an eligible
+ * follower (one with credentials) takes over within about 15 seconds.
+ *
+ * Packets are signed with a key derived from a passphrase entered on
+ * every monitor (lan_share_set_key), and recorded packets can't be
+ * replayed, so only the household's own monitors are believed. Sharing
+ * stays off (the monitor polls on its own) until a key is set.
+ */
+
+#ifndef LAN_SHARE_H
+#define LAN_SHARE_H
+
+#include "esp_err.h"
+#include "librelinkup.h"
+#include <stdbool.h>
+
+#define LAN_SHARE_GROUP     "239.255.71.77"
+#define LAN_SHARE_PORT      47321
+
+// Passphrase length accepted by lan_share_set_key()
+#define LAN_SHARE_PASSPHRASE_MIN_LEN    8
+#define LAN_SHARE_PASSPHRASE_MAX_LEN    63
+
+typedef enum {
+    LAN_SHARE_STANDALONE = 0,   // Sharing off (or not started): poll as usual
+    LAN_SHARE_LEADER,           // Poll and share
+    LAN_SHARE_FOLLOWER,         // Don't poll; take readings from the leader
+} lan_share_role_t;
+
+/**
+ * Event callback
+ * Called from the LAN share task when the role changes or a reading
+ * arrives from the leader. Must not block.
+ */
+typedef void (*lan_share_event_cb_t)(void);
+
+/**
+ * Start the LAN share task
+ * Call once the network is up; later calls do nothing. The task follows
+ * the "lan_share" setting, so sharing can be switched at runtime.
+ * @param event_cb Role change / new reading callback (may be NULL)
+ * @return ESP_OK on success
+ */
+esp_err_t lan_share_start(lan_share_event_cb_t event_cb);
+
+/**
+ * Set the household key
+ * Stores the SHA-256 of the passphrase; monitors share readings only
+ * with monitors that have the same passphrase.
+ * @param passphrase LAN_SHARE_PASSPHRASE_MIN_LEN..MAX_LEN characters
+ * @return ESP_OK on success, ESP_ERR_INVALID_ARG if the length is wrong
+ */
+esp_err_t lan_share_set_key(const char *passphrase);
+
+/**
+ * Whether a key has been set
+ */
+bool lan_share_has_key(void);
+
+/**
+ * Get this monitor's role
+ */
+lan_share_role_t lan_share_get_role(void);
+
+/**
+ * Share a reading the leader just fetched, with the graph points that
+ * are new since the last one. Does nothing unless this monitor leads.
+ * @param glucose Reading
+ */
+void lan_share_publish(const libre_glucose_data_t *glucose);
+
+/**
+ * Take the newest reading received from the leader
+ * @param glucose Output reading
+ * @return true if a reading arrived since the last call
+ */
+bool lan_share_take_reading(libre_glucose_data_t *glucose);
+
+#endif // LAN_SHARE_H
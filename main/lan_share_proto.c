@@ -0,0 +1,331 @@
+/**
+ * LAN Share Protocol Implementation
+ */
+
+#include "lan_share_proto.h"
+#include "mbedtls/md.h"
+#include <string.h>
+
+#define LAN_MAGIC           "GMLS"
+#define LAN_VERSION         2
+#define LAN_HEADER_SIZE     20
+#define LAN_READING_SIZE    (4 + 2 + 1 + 1 + 1 + 1 + LAN_SHARE_TIMESTAMP_LEN)
+#define LAN_POINT_SIZE      7
+#define LAN_GRAPH_SPAN_S    (12 * 60 * 60)
+
+static void put_le(uint8_t *p, uint64_t value, size_t bytes)
+{
+    for (size_t i = 0; i < bytes; i++) {
+        p[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+static uint64_t get_le(const uint8_t *p, size_t bytes)
+{
+    uint64_t value = 0;
+    for (size_t i = 0; i < bytes; i++) {
+        value |= (uint64_t)p[i] << (8 * i);
+    }
+    return value;
+}
+
+static void compute_mac(const uint8_t key[LAN_SHARE_KEY_LEN], const uint8_t *buf, size_t len,
+                        uint8_t mac[LAN_SHARE_MAC_LEN])
+{
+    uint8_t full[32];
+    mbedtls_md_hmac(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), key, LAN_SHARE_KEY_LEN, buf, len, full);
+    memcpy(mac, full, LAN_SHARE_MAC_LEN);
+}
+
+size_t lan_msg_encode(const lan_msg_t *msg, const uint8_t key[LAN_SHARE_KEY_LEN], uint8_t *buf, size_t size)
+{
+    size_t len = LAN_HEADER_SIZE;
+    switch (msg->type) {
+        case LAN_MSG_HELLO:   len += 5; break;
+        case LAN_MSG_READING: len += LAN_READING_SIZE; break;
+        case LAN_MSG_GRAPH:
+            if (msg->graph.count > LAN_SHARE_GRAPH_MAX_POINTS) {
+                return 0;
+            }
+            len += 1 + msg->graph.count * LAN_POINT_SIZE;
+            break;
+        default:
+            return 0;
+    }
+    if (size < len + LAN_SHARE_MAC_LEN) {
+        return 0;
+    }
+
+    memcpy(buf, LAN_MAGIC, 4);
+    buf[4] = LAN_VERSION;
+    buf[5] = (uint8_t)msg->type;
+    put_le(buf + 6, msg->node_id, 6);
+    put_le(buf + 12, msg->time, 4);
+    put_le(buf + 16, msg->seq, 4);
+    uint8_t *p = buf + LAN_HEADER_SIZE;
+
+    switch (msg->type) {
+        case LAN_MSG_HELLO:
+            p[0] = (msg->hello.leader ? 0x01 : 0) | (msg->hello.eligible ? 0x02 : 0);
+            put_le(p + 1, msg->hello.graph_newest, 4);
+            break;
+
+        case LAN_MSG_READING: {
+            const lan_reading_t *r = &msg->reading.reading;
+            put_le(p, r->time, 4);
+            put_le(p + 4, r->mgdl, 2);
+            p[6] = r->trend;
+            p[7] = r->color;
+            p[8] = (r->is_high ? 0x01 : 0) | (r->is_low ? 0x02 : 0);
+            p[9] = r->type;
+            memset(p + 10, 0, LAN_SHARE_TIMESTAMP_LEN);
+            strncpy((char *)p + 10, r->timestamp, LAN_SHARE_TIMESTAMP_LEN - 1);
+            break;
+        }
+
+        case LAN_MSG_GRAPH:
+            p[0] = msg->graph.count;
+            p++;
+            for (size_t i = 0; i < msg->graph.count; i++) {
+                put_le(p, msg->graph.points[i].time, 4);
+                put_le(p + 4, msg->graph.points[i].mgdl, 2);
+                p[6] = msg->graph.points[i].color;
+                p += LAN_POINT_SIZE;
+            }
+            break;
+    }
+    compute_mac(key, buf, len, buf + len);
+    return len + LAN_SHARE_MAC_LEN;
+}
+
+bool lan_msg_decode(const uint8_t *buf, size_t len, const uint8_t key[LAN_SHARE_KEY_LEN], lan_msg_t *msg)
+{
+    if (len < LAN_HEADER_SIZE + LAN_SHARE_MAC_LEN || memcmp(buf, LAN_MAGIC, 4) != 0 || buf[4] != LAN_VERSION) {
+        return false;
+    }
+
+    // Check the tag before looking at anything else (constant time)
+    len -= LAN_SHARE_MAC_LEN;
+    uint8_t mac[LAN_SHARE_MAC_LEN];
+    compute_mac(key, buf, len, mac);
+    uint8_t diff = 0;
+    for (size_t i = 0; i < LAN_SHARE_MAC_LEN; i++) {
+        diff |= mac[i] ^ buf[len + i];
+    }
+    if (diff != 0) {
+        return false;
+    }
+
+    memset(msg, 0, sizeof(*msg));
+    msg->type = (lan_msg_type_t)buf[5];
+    msg->node_id = get_le(buf + 6, 6);
+    msg->time = (uint32_t)get_le(buf + 12, 4);
+    msg->seq = (uint32_t)get_le(buf + 16, 4);
+    const uint8_t *p = buf + LAN_HEADER_SIZE;
+    size_t body = len - LAN_HEADER_SIZE;
+
+    switch (msg->type) {
+        case LAN_MSG_HELLO:
+            if (body != 5) {
+                return false;
+            }
+            msg->hello.leader = p[0] & 0x01;
+            msg->hello.eligible = p[0] & 0x02;
+            msg->hello.graph_newest = (uint32_t)get_le(p + 1, 4);
+            return true;
+
+        case LAN_MSG_READING: {
+            if (body != LAN_READING_SIZE) {
+                return false;
+            }
+            lan_reading_t *r = &msg->reading.reading;
+            r->time = (uint32_t)get_le(p, 4);
+            r->mgdl = (uint16_t)get_le(p + 4, 2);
+            r->trend = p[6];
+            r->color = p[7];
+            r->is_high = p[8] & 0x01;
+            r->is_low = p[8] & 0x02;
+            r->type = p[9];
+            memcpy(r->timestamp, p + 10, LAN_SHARE_TIMESTAMP_LEN);
+            r->timestamp[LAN_SHARE_TIMESTAMP_LEN - 1] = '\0';
+            return true;
+        }
+
+        case LAN_MSG_GRAPH:
+            if (body < 1 || p[0] > LAN_SHARE_GRAPH_MAX_POINTS || body != (size_t)(1 + p[0] * LAN_POINT_SIZE)) {
+                return false;
+            }
+            msg->graph.count = p[0];
+            p++;
+            for (size_t i = 0; i < msg->graph.count; i++) {
+                msg->graph.points[i].time = (uint32_t)get_le(p, 4);
+                msg->graph.points[i].mgdl = (uint16_t)get_le(p + 4, 2);
+                msg->graph.points[i].color = p[6];
+                p += LAN_POINT_SIZE;
+            }
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+void lan_replay_init(lan_replay_t *replay)
+{
+    memset(replay, 0, sizeof(*replay));
+}
+
+bool lan_replay_accept(lan_replay_t *replay, const lan_msg_t *msg, uint32_t now_s, uint32_t now_ms)
+{
+    if (msg->node_id == 0) {
+        return false;
+    }
+    if (now_s >= LAN_SHARE_CLOCK_VALID &&
+        (msg->time + LAN_SHARE_MAX_SKEW_S < now_s || msg->time > now_s + LAN_SHARE_MAX_SKEW_S)) {
+        return false;
+    }
+
+    int slot = -1;
+    int victim = 0;
+    for (int i = 0; i < LAN_SHARE_MAX_PEERS; i++) {
+        if (replay->peers[i].node_id == msg->node_id) {
+            slot = i;
+            break;
+        }
+        // A free slot, otherwise the peer heard from longest ago
+        if (replay->peers[victim].node_id != 0 &&
+            (replay->peers[i].node_id == 0 ||
+             now_ms - replay->peers[i].seen_ms > now_ms - replay->peers[victim].seen_ms)) {
+            victim = i;
+        }
+    }
+
+    if (slot >= 0) {
+        if (msg->time < replay->peers[slot].time ||
+            (msg->time == replay->peers[slot].time && msg->seq <= replay->peers[slot].seq)) {
+            return false;
+        }
+    } else {
+        slot = victim;
+        replay->peers[slot].node_id = msg->node_id;
+    }
+    replay->peers[slot].time = msg->time;
+    replay->peers[slot].seq = msg->seq;
+    replay->peers[slot].seen_ms = now_ms;
+    return true;
+}
+
+size_t lan_graph_merge(lan_point_t *graph, size_t *count, const lan_point_t *points, size_t n)
+{
+    size_t added = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        const lan_point_t *point = &points[i];
+        if (point->time == 0) {
+            continue;
+        }
+
+        size_t pos = *count;
+        while (pos > 0 && graph[pos - 1].time > point->time) {
+            pos--;
+        }
+        if (pos > 0 && graph[pos - 1].time == point->time) {
+            continue;
+        }
+        if (*count == LAN_SHARE_GRAPH_MAX_POINTS) {
+            if (pos == 0) {
+                continue;  // Older than everything in a full graph
+            }
+            memmove(&graph[0], &graph[1], (pos - 1) * sizeof(graph[0]));
+            pos--;
+        } else {
+            memmove(&graph[pos + 1], &graph[pos], (*count - pos) * sizeof(graph[0]));
+            (*count)++;
+        }
+        graph[pos] = *point;
+        added++;
+    }
+
+    // Keep the same 12 hour window the cloud graph has
+    if (*count > 0) {
+        uint32_t newest = graph[*count - 1].time;
+        size_t drop = 0;
+        while (drop < *count && newest - graph[drop].time > LAN_GRAPH_SPAN_S) {
+            drop++;
+        }
+        memmove(&graph[0], &graph[drop], (*count - drop) * sizeof(graph[0]));
+        *count -= drop;
+    }
+    return added;
+}
+
+void lan_election_init(lan_election_t *election, uint64_t self_id, uint32_t now_ms)
+{
+    memset(election, 0, sizeof(*election));
+    election->self_id = self_id;
+    election->role = LAN_ROLE_FOLLOWER;
+    election->started_ms = now_ms;
+    election->hello_pending = true;     // Announce ourselves at once
+}
+
+bool lan_election_tick(lan_election_t *election, bool eligible, uint32_t now_ms)
+{
+    if (election->role == LAN_ROLE_LEADER) {
+        if (!eligible) {
+            // Lost the credentials; let someone else take over
+            election->role = LAN_ROLE_FOLLOWER;
+            election->leader_id = 0;
+            election->started_ms = now_ms;
+            election->hello_pending = true;
+        }
+    } else {
+        if (election->leader_id && now_ms - election->leader_seen_ms >= LAN_SHARE_LEADER_TIMEOUT_MS) {
+            election->leader_id = 0;
+            election->started_ms = election->leader_seen_ms;
+        }
+        // Stagger takeovers so nodes that lost the leader together rarely collide
+        uint32_t wait_ms = LAN_SHARE_LEADER_TIMEOUT_MS + (uint32_t)(election->self_id & 7) * LAN_SHARE_STAGGER_MS;
+        if (!election->leader_id && eligible && now_ms - election->started_ms >= wait_ms) {
+            election->role = LAN_ROLE_LEADER;
+            election->leader_id = election->self_id;
+            election->hello_pending = true;
+        }
+    }
+
+    if (election->hello_pending || now_ms - election->hello_sent_ms >= LAN_SHARE_HELLO_MS) {
+        election->hello_pending = false;
+        election->hello_sent_ms = now_ms;
+        return true;
+    }
+    return false;
+}
+
+void lan_election_on_hello(lan_election_t *election, uint64_t from_id, bool from_leader, uint32_t now_ms)
+{
+    if (from_id == election->self_id || !from_leader) {
+        return;
+    }
+
+    if (election->role == LAN_ROLE_LEADER) {
+        if (from_id > election->self_id) {
+            election->role = LAN_ROLE_FOLLOWER;
+            election->leader_id = from_id;
+            election->leader_seen_ms = now_ms;
+        } else {
+            election->hello_pending = true;  // Make the other leader step down quickly
+        }
+        return;
+    }
+
+    // While two leaders sort themselves out, follow the one that will win
+    if (election->leader_id == 0 || from_id == election->leader_id || from_id > election->leader_id) {
+        election->leader_id = from_id;
+        election->leader_seen_ms = now_ms;
+    }
+}
+
+bool lan_election_accepts(const lan_election_t *election, uint64_t from_id)
+{
+    return election->role == LAN_ROLE_FOLLOWER && election->leader_id != 0 &&
+           election->leader_id == from_id;
+}
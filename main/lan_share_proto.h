@@ -0,0 +1,207 @@
+/**
+ * LAN Share Protocol
+ * Wire format and leader election for sharing readings between monitors
+ *
+ * Every monitor with sharing enabled joins a UDP multicast group and
+ * sends a HELLO every LAN_SHARE_HELLO_MS. One of them is the leader: it
+ * polls LibreLinkUp and multicasts each READING plus the new GRAPH
+ * points; the others are followers and never touch the cloud.
+ *
+ * Election: a node that hasn't heard a leader for LAN_SHARE_LEADER_TIMEOUT_MS
+ * (plus a small per-node stagger) takes over if it is eligible (has
+ * LibreLinkUp credentials). If two leaders hear each other, the one
+ * with the lower node id steps down. A leader never yields to a new
+ * node, so a monitor rebooting doesn't move the role around.
+ *
+ * Every packet ends with an HMAC-SHA256 tag (first LAN_SHARE_MAC_LEN
+ * bytes) under a key the household's monitors share, so only monitors
+ * with the key can send readings or take part in the election. The
+ * header carries the sender's clock and a packet counter;
+ * lan_replay_accept() uses them to drop recorded packets played back
+ * later, so monitors need the time from SNTP before they trust a peer.
+ *
+ * Plain C with no ESP-IDF dependencies (the HMAC comes from mbedtls) so
+ * several nodes can be simulated in one Linux process.
+ *
+ * Packets (little-endian): "GMLS", version, type, node id (6 bytes),
+ * sender time (u32), packet counter (u32), then
+ *   HELLO    flags (bit 0 leader, bit 1 eligible), newest graph time (u32)
+ *   READING  time (u32), mg/dL (u16), trend, color, flags (bit 0 high,
+ *            bit 1 low), type, timestamp (32 bytes)
+ *   GRAPH    count (u8), then per point time (u32), mg/dL (u16), color
+ * and finally the tag over everything before it.
+ */
+
+#ifndef LAN_SHARE_PROTO_H
+#define LAN_SHARE_PROTO_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define LAN_SHARE_HELLO_MS              5000
+#define LAN_SHARE_LEADER_TIMEOUT_MS     15000
+#define LAN_SHARE_STAGGER_MS            250     // Per step of (node id & 7)
+
+// Graph points per GRAPH packet (the whole 12 hour graph)
+#define LAN_SHARE_GRAPH_MAX_POINTS      144
+
+#define LAN_SHARE_TIMESTAMP_LEN         32
+
+// Shared key (SHA-256 of the passphrase) and the tag length sent
+#define LAN_SHARE_KEY_LEN               32
+#define LAN_SHARE_MAC_LEN               16
+
+// Largest encoded packet
+#define LAN_SHARE_PACKET_MAX            (20 + 1 + LAN_SHARE_GRAPH_MAX_POINTS * 7 + LAN_SHARE_MAC_LEN)
+
+// Replay protection: peers remembered, and how far a sender's clock may
+// be from ours once ours is set (clocks before LAN_SHARE_CLOCK_VALID
+// aren't set yet)
+#define LAN_SHARE_MAX_PEERS             8
+#define LAN_SHARE_MAX_SKEW_S            120
+#define LAN_SHARE_CLOCK_VALID           1577836800  // 2020-01-01
+
+typedef enum {
+    LAN_MSG_HELLO = 1,
+    LAN_MSG_READING = 2,
+    LAN_MSG_GRAPH = 3,
+} lan_msg_type_t;
+
+typedef struct {
+    uint32_t time;          // Seconds since the epoch
+    uint16_t mgdl;
+    uint8_t color;
+} lan_point_t;
+
+typedef struct {
+    uint32_t time;
+    uint16_t mgdl;
+    uint8_t trend;
+    uint8_t color;
+    bool is_high;
+    bool is_low;
+    uint8_t type;
+    char timestamp[LAN_SHARE_TIMESTAMP_LEN];    // Display string, NUL terminated
+} lan_reading_t;
+
+typedef struct {
+    lan_msg_type_t type;
+    uint64_t node_id;       // 48-bit station MAC
+    uint32_t time;          // Sender's clock (seconds since the epoch)
+    uint32_t seq;           // Sender's packet counter, restarts at boot
+    union {
+        struct {
+            bool leader;
+            bool eligible;
+            uint32_t graph_newest;  // Newest graph point the sender has
+        } hello;
+        struct {
+            lan_reading_t reading;
+        } reading;
+        struct {
+            uint8_t count;
+            lan_point_t points[LAN_SHARE_GRAPH_MAX_POINTS];
+        } graph;
+    };
+} lan_msg_t;
+
+/**
+ * Encode and sign a message
+ * @param key Shared key
+ * @return Packet length, 0 if buf is too small
+ */
+size_t lan_msg_encode(const lan_msg_t *msg, const uint8_t key[LAN_SHARE_KEY_LEN], uint8_t *buf, size_t size);
+
+/**
+ * Check the tag and decode a packet
+ * @param key Shared key
+ * @return true if the packet is a valid message of this protocol version
+ *         signed with key
+ */
+bool lan_msg_decode(const uint8_t *buf, size_t len, const uint8_t key[LAN_SHARE_KEY_LEN], lan_msg_t *msg);
+
+/**
+ * Last packet seen from each peer
+ */
+typedef struct {
+    struct {
+        uint64_t node_id;   // 0 if the slot is free
+        uint32_t time;
+        uint32_t seq;
+        uint32_t seen_ms;
+    } peers[LAN_SHARE_MAX_PEERS];
+} lan_replay_t;
+
+/**
+ * Forget all peers
+ */
+void lan_replay_init(lan_replay_t *replay);
+
+/**
+ * Decide whether a decoded (authentic) packet is new
+ * A packet is accepted if it is later than the last one accepted from
+ * its sender (by sender time, then counter, so a reboot that restarts
+ * the counter is fine) and, when our clock is set, its time is within
+ * LAN_SHARE_MAX_SKEW_S of ours. The least recently heard peer is
+ * forgotten when the table is full.
+ *
+ * @param now_s Our clock (seconds since the epoch)
+ * @param now_ms Monotonic milliseconds
+ * @return true if the packet should be processed
+ */
+bool lan_replay_accept(lan_replay_t *replay, const lan_msg_t *msg, uint32_t now_s, uint32_t now_ms);
+
+/**
+ * Merge points into a time-ordered graph
+ * Points already present (same time) are skipped, points older than
+ * 12 hours before the newest are dropped, and the oldest go first when
+ * the graph is full.
+ *
+ * @param graph Graph points, oldest first
+ * @param count In: points in graph, out: points after the merge
+ * @return Number of points added
+ */
+size_t lan_graph_merge(lan_point_t *graph, size_t *count, const lan_point_t *points, size_t n);
+
+typedef enum {
+    LAN_ROLE_FOLLOWER = 0,
+    LAN_ROLE_LEADER,
+} lan_role_t;
+
+/**
+ * Election state of one node
+ */
+typedef struct {
+    uint64_t self_id;
+    lan_role_t role;
+    uint64_t leader_id;         // Current leader, 0 if none known
+    uint32_t leader_seen_ms;    // Last HELLO from the leader
+    uint32_t started_ms;        // Listening since (boot or leader loss)
+    uint32_t hello_sent_ms;
+    bool hello_pending;         // HELLO due at the next tick
+} lan_election_t;
+
+/**
+ * Start as a follower listening for a leader
+ */
+void lan_election_init(lan_election_t *election, uint64_t self_id, uint32_t now_ms);
+
+/**
+ * Advance timers
+ * @param eligible This node can poll LibreLinkUp
+ * @return true if a HELLO should be sent now
+ */
+bool lan_election_tick(lan_election_t *election, bool eligible, uint32_t now_ms);
+
+/**
+ * Process a HELLO from another node
+ */
+void lan_election_on_hello(lan_election_t *election, uint64_t from_id, bool from_leader, uint32_t now_ms);
+
+/**
+ * Whether a reading or graph from a node should be used
+ */
+bool lan_election_accepts(const lan_election_t *election, uint64_t from_id);
+
+#endif // LAN_SHARE_PROTO_H
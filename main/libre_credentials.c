@@ -3,6 +3,7 @@
  */
 
 #include "libre_credentials.h"
+#include "nvs_journal.h"
 #include "esp_log.h"
 #include "nvs_flash.h"
 #include "nvs.h"
@@ -22,30 +23,48 @@ esp_err_t libre_credentials_save(const char *email, const char *password,
         return ESP_ERR_INVALID_ARG;
     }
     
-    nvs_handle_t nvs_handle;
-    esp_err_t err = nvs_open(LIBRE_NAMESPACE, NVS_READWRITE, &nvs_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Error opening NVS: %s", esp_err_to_name(err));
-        return err;
+    // Stage all fields; the journal skips values NVS already holds and commits once
+    esp_err_t err = nvs_journal_set_str(LIBRE_NAMESPACE, LIBRE_EMAIL_KEY, email);
+    if (err == ESP_OK) {
+        err = nvs_journal_set_str(LIBRE_NAMESPACE, LIBRE_PASS_KEY, password);
+    }
+    if (err == ESP_OK && patient_id) {
+        err = nvs_journal_set_str(LIBRE_NAMESPACE, LIBRE_PATIENT_KEY, patient_id);
+    }
+    if (err == ESP_OK) {
+        err = nvs_journal_set_u8(LIBRE_NAMESPACE, LIBRE_SERVER_KEY, use_eu_server ? 1 : 0);
     }
     
-    // Save credentials
-    nvs_set_str(nvs_handle, LIBRE_EMAIL_KEY, email);
-    nvs_set_str(nvs_handle, LIBRE_PASS_KEY, password);
+    // Flush even after a staging error, so nothing half-staged lingers
+    esp_err_t flush_err = nvs_journal_flush();
+    if (err == ESP_OK) {
+        err = flush_err;
+    }
     
-    if (patient_id) {
-        nvs_set_str(nvs_handle, LIBRE_PATIENT_KEY, patient_id);
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "LibreLink credentials saved");
+    } else {
+        ESP_LOGE(TAG, "Error saving credentials: %s", esp_err_to_name(err));
     }
     
-    nvs_set_u8(nvs_handle, LIBRE_SERVER_KEY, use_eu_server ? 1 : 0);
+    return err;
+}
+
+esp_err_t libre_credentials_save_patient_id(const char *patient_id)
+{
+    if (!patient_id) {
+        return ESP_ERR_INVALID_ARG;
+    }
     
-    err = nvs_commit(nvs_handle);
-    nvs_close(nvs_handle);
+    esp_err_t err = nvs_journal_set_str(LIBRE_NAMESPACE, LIBRE_PATIENT_KEY, patient_id);
+    if (err == ESP_OK) {
+        err = nvs_journal_flush();
+    }
     
     if (err == ESP_OK) {
-        ESP_LOGI(TAG, "LibreLink credentials saved");
+        ESP_LOGI(TAG, "Patient ID saved");
     } else {
-        ESP_LOGE(TAG, "Error saving credentials: %s", esp_err_to_name(err));
+        ESP_LOGE(TAG, "Error saving patient ID: %s", esp_err_to_name(err));
     }
     
     return err;
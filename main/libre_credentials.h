@@ -20,6 +20,13 @@
 esp_err_t libre_credentials_save(const char *email, const char *password, 
                                   const char *patient_id, bool use_eu_server);
 
+/**
+ * Save only the patient ID (email/password are left untouched)
+ * @param patient_id Patient ID
+ * @return ESP_OK on success
+ */
+esp_err_t libre_credentials_save_patient_id(const char *patient_id);
+
 /**
  * Load LibreLink credentials from NVS
  * @param email Output buffer for email (min 128 bytes)
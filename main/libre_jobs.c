@@ -0,0 +1,285 @@
+/**
+ * LibreLinkUp Web Jobs Implementation
+ */
+
+#include "libre_jobs.h"
+#include "librelinkup.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "LIBRE_JOBS";
+
+// TLS handshakes need a large stack
+#define LIBRE_JOB_TASK_STACK    8192
+#define LIBRE_JOB_TASK_PRIORITY 4
+
+typedef struct {
+    uint32_t id;                // 0: slot free
+    libre_job_type_t type;
+    libre_job_state_t state;
+    int64_t finished_us;
+    bool use_eu_server;
+    char email[128];
+    char password[128];
+    char *result;               // JSON, owned by the slot once finished
+} libre_job_t;
+
+static libre_job_t jobs[LIBRE_JOB_SLOTS];
+static uint32_t next_job_id = 1;
+static SemaphoreHandle_t jobs_mutex = NULL;
+static QueueHandle_t job_queue = NULL;
+static TaskHandle_t job_task_handle = NULL;
+
+static libre_job_t* find_job(uint32_t job_id)
+{
+    for (size_t i = 0; i < LIBRE_JOB_SLOTS; i++) {
+        if (jobs[i].id != 0 && jobs[i].id == job_id) {
+            return &jobs[i];
+        }
+    }
+    return NULL;
+}
+
+static void free_slot(libre_job_t *job)
+{
+    free(job->result);
+    memset(job, 0, sizeof(*job));
+}
+
+static bool job_finished(const libre_job_t *job)
+{
+    return job->state == LIBRE_JOB_DONE || job->state == LIBRE_JOB_FAILED;
+}
+
+// Free slot, else the oldest finished job. Caller holds jobs_mutex.
+static libre_job_t* claim_slot(void)
+{
+    int64_t now = esp_timer_get_time();
+    libre_job_t *oldest = NULL;
+
+    for (size_t i = 0; i < LIBRE_JOB_SLOTS; i++) {
+        libre_job_t *job = &jobs[i];
+        if (job->id != 0 && job_finished(job) &&
+            now - job->finished_us > (int64_t)LIBRE_JOB_RESULT_TTL_MS * 1000) {
+            free_slot(job);
+        }
+        if (job->id == 0) {
+            return job;
+        }
+        if (job_finished(job) && (!oldest || job->finished_us < oldest->finished_us)) {
+            oldest = job;
+        }
+    }
+
+    if (oldest) {
+        free_slot(oldest);
+    }
+    return oldest;
+}
+
+// Run the request sequence for a job. Returns false with an error message in result.
+static bool run_job(libre_job_type_t type, const char *email, const char *password,
+                    bool use_eu_server, char *result, size_t result_size)
+{
+    bool ok = false;
+
+    // Own session: testing other credentials never touches the device's login
+    librelinkup_client_t *client = librelinkup_client_create(use_eu_server, false);
+    if (!client) {
+        snprintf(result, result_size, "{\"success\":false,\"error\":\"Out of memory\"}");
+        return false;
+    }
+    esp_err_t err = librelinkup_login(client, email, password);
+
+    if (type == LIBRE_JOB_PATIENTS) {
+        if (err == ESP_OK) {
+            err = librelinkup_get_connections_json(client, result, result_size);
+        }
+        ok = (err == ESP_OK);
+        if (!ok) {
+            snprintf(result, result_size, "{\"success\":false,\"error\":\"Login failed or no patients found\"}");
+        }
+    } else {
+        char patient_id[64];
+        if (err == ESP_OK) {
+            err = librelinkup_get_patient_id(client, patient_id, sizeof(patient_id));
+        }
+        ok = (err == ESP_OK);
+        if (ok) {
+            snprintf(result, result_size,
+                     "{\"success\":true,\"patients\":[{\"id\":\"%s\",\"name\":\"Patient 1\"}]}",
+                     patient_id);
+        } else {
+            snprintf(result, result_size, "{\"success\":false,\"error\":\"Login failed\"}");
+        }
+    }
+    librelinkup_client_destroy(client);
+
+    return ok;
+}
+
+static void libre_job_task(void *pvParameters)
+{
+    uint32_t job_id;
+
+    while (1) {
+        if (xQueueReceive(job_queue, &job_id, portMAX_DELAY) != pdTRUE) {
+            continue;
+        }
+
+        // Take the credentials out of the slot so they are only kept while needed
+        char email[128];
+        char password[128];
+        libre_job_type_t type;
+        bool use_eu_server;
+
+        xSemaphoreTake(jobs_mutex, portMAX_DELAY);
+        libre_job_t *job = find_job(job_id);
+        if (!job) {
+            xSemaphoreGive(jobs_mutex);
+            continue;
+        }
+        job->state = LIBRE_JOB_RUNNING;
+        type = job->type;
+        use_eu_server = job->use_eu_server;
+        memcpy(email, job->email, sizeof(email));
+        memcpy(password, job->password, sizeof(password));
+        memset(job->email, 0, sizeof(job->email));
+        memset(job->password, 0, sizeof(job->password));
+        xSemaphoreGive(jobs_mutex);
+
+        ESP_LOGI(TAG, "Running job %lu (%s)", (unsigned long)job_id,
+                 type == LIBRE_JOB_PATIENTS ? "patients" : "test");
+
+        char *result = malloc(LIBRE_JOB_RESULT_SIZE);
+        bool ok = false;
+        if (result) {
+            ok = run_job(type, email, password, use_eu_server, result, LIBRE_JOB_RESULT_SIZE);
+        } else {
+            ESP_LOGE(TAG, "No memory for job result");
+        }
+        memset(email, 0, sizeof(email));
+        memset(password, 0, sizeof(password));
+
+        xSemaphoreTake(jobs_mutex, portMAX_DELAY);
+        job = find_job(job_id);
+        if (job) {
+            job->result = result;
+            job->state = ok ? LIBRE_JOB_DONE : LIBRE_JOB_FAILED;
+            job->finished_us = esp_timer_get_time();
+            result = NULL;
+        }
+        xSemaphoreGive(jobs_mutex);
+        free(result);
+
+        ESP_LOGI(TAG, "Job %lu %s", (unsigned long)job_id, ok ? "done" : "failed");
+    }
+}
+
+esp_err_t libre_jobs_init(void)
+{
+    if (jobs_mutex) {
+        return ESP_OK;
+    }
+
+    jobs_mutex = xSemaphoreCreateMutex();
+    job_queue = xQueueCreate(LIBRE_JOB_SLOTS, sizeof(uint32_t));
+    if (!jobs_mutex || !job_queue) {
+        ESP_LOGE(TAG, "Failed to create job queue");
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+esp_err_t libre_jobs_submit(libre_job_type_t type, const char *email, const char *password,
+                            bool use_eu_server, uint32_t *job_id)
+{
+    if (!email || !password || !job_id) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (!jobs_mutex || !job_queue) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(jobs_mutex, portMAX_DELAY);
+
+    // The worker (and its TLS-sized stack) only exists once the portal has used it
+    if (!job_task_handle &&
+        xTaskCreate(libre_job_task, "libre_job", LIBRE_JOB_TASK_STACK, NULL,
+                    LIBRE_JOB_TASK_PRIORITY, &job_task_handle) != pdPASS) {
+        job_task_handle = NULL;
+        xSemaphoreGive(jobs_mutex);
+        ESP_LOGE(TAG, "Failed to create job task");
+        return ESP_ERR_NO_MEM;
+    }
+
+    libre_job_t *job = claim_slot();
+    if (!job) {
+        xSemaphoreGive(jobs_mutex);
+        ESP_LOGW(TAG, "All job slots busy");
+        return ESP_ERR_NO_MEM;
+    }
+
+    job->id = next_job_id++;
+    if (next_job_id == 0) {
+        next_job_id = 1;  // 0 marks a free slot
+    }
+    job->type = type;
+    job->state = LIBRE_JOB_QUEUED;
+    job->use_eu_server = use_eu_server;
+    strncpy(job->email, email, sizeof(job->email) - 1);
+    strncpy(job->password, password, sizeof(job->password) - 1);
+    *job_id = job->id;
+
+    // Queue depth equals the slot count, so this cannot block
+    xQueueSend(job_queue, job_id, 0);
+    xSemaphoreGive(jobs_mutex);
+
+    ESP_LOGI(TAG, "Queued job %lu", (unsigned long)*job_id);
+    return ESP_OK;
+}
+
+libre_job_state_t libre_jobs_get(uint32_t job_id, char *result, size_t result_size)
+{
+    if (!jobs_mutex || job_id == 0) {
+        return LIBRE_JOB_UNKNOWN;
+    }
+
+    xSemaphoreTake(jobs_mutex, portMAX_DELAY);
+    libre_job_t *job = find_job(job_id);
+    libre_job_state_t state = job ? job->state : LIBRE_JOB_UNKNOWN;
+
+    if (result && result_size > 0) {
+        result[0] = '\0';
+        if (job && job_finished(job)) {
+            if (job->result) {
+                strncpy(result, job->result, result_size - 1);
+                result[result_size - 1] = '\0';
+            } else {
+                snprintf(result, result_size, "{\"success\":false,\"error\":\"Out of memory\"}");
+            }
+        }
+    }
+    xSemaphoreGive(jobs_mutex);
+
+    return state;
+}
+
+const char* libre_job_state_name(libre_job_state_t state)
+{
+    switch (state) {
+        case LIBRE_JOB_QUEUED:  return "queued";
+        case LIBRE_JOB_RUNNING: return "running";
+        case LIBRE_JOB_DONE:    return "done";
+        case LIBRE_JOB_FAILED:  return "failed";
+        default:                return "unknown";
+    }
+}
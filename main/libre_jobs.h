@@ -0,0 +1,87 @@
+/**
+ * LibreLinkUp Web Jobs
+ * Runs the web portal's LibreLinkUp requests on a worker task
+ *
+ * A login plus connections request is a full TLS handshake and takes
+ * seconds. The httpd handler only submits a job and returns its id; the
+ * page polls for the result, so the web server stays responsive. Each job
+ * runs on its own temporary LibreLinkUp client, so it never disturbs the
+ * glucose fetch task's session.
+ */
+
+#ifndef LIBRE_JOBS_H
+#define LIBRE_JOBS_H
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Jobs tracked at once (queued, running or holding a result)
+#define LIBRE_JOB_SLOTS             4
+
+// Maximum size of a job's JSON result
+#define LIBRE_JOB_RESULT_SIZE       2048
+
+// Finished jobs are dropped after this long
+#define LIBRE_JOB_RESULT_TTL_MS     60000
+
+/**
+ * Job types
+ */
+typedef enum {
+    LIBRE_JOB_PATIENTS = 0,     // Login and list connections (patients)
+    LIBRE_JOB_TEST,             // Login and get the first patient ID
+} libre_job_type_t;
+
+/**
+ * Job states
+ */
+typedef enum {
+    LIBRE_JOB_UNKNOWN = 0,      // No such job (never submitted or expired)
+    LIBRE_JOB_QUEUED,
+    LIBRE_JOB_RUNNING,
+    LIBRE_JOB_DONE,             // Result holds the success JSON
+    LIBRE_JOB_FAILED,           // Result holds {"success":false,"error":...}
+} libre_job_state_t;
+
+/**
+ * Initialize the job queue
+ * Safe to call more than once
+ *
+ * @return ESP_OK on success
+ */
+esp_err_t libre_jobs_init(void);
+
+/**
+ * Submit a job
+ * Starts the worker task on first use. Credentials are copied and wiped
+ * once the job has run.
+ *
+ * @param type Job type
+ * @param email LibreLinkUp email
+ * @param password LibreLinkUp password
+ * @param use_eu_server Use the EU server
+ * @param job_id Output job id
+ * @return ESP_OK, ESP_ERR_NO_MEM if all slots hold unfinished jobs,
+ *         ESP_ERR_INVALID_STATE if not initialized
+ */
+esp_err_t libre_jobs_submit(libre_job_type_t type, const char *email, const char *password,
+                            bool use_eu_server, uint32_t *job_id);
+
+/**
+ * Get a job's state and, once finished, its result
+ *
+ * @param job_id Job id from libre_jobs_submit()
+ * @param result Output buffer for the JSON result (may be NULL)
+ * @param result_size Size of the output buffer
+ * @return Job state
+ */
+libre_job_state_t libre_jobs_get(uint32_t job_id, char *result, size_t result_size);
+
+/**
+ * Get job state name ("queued", "running", ...)
+ */
+const char* libre_job_state_name(libre_job_state_t state);
+
+#endif // LIBRE_JOBS_H
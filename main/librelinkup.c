@@ -3,6 +3,8 @@
  */
 
 #include "librelinkup.h"
+#include "nvs_journal.h"
+#include "power.h"
 #include "esp_log.h"
 #include "esp_http_client.h"
 #include "esp_tls.h"
@@ -11,38 +13,166 @@
 #include "mbedtls/sha256.h"
 #include "nvs_flash.h"
 #include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 static const char *TAG = "LIBRELINKUP";
 
-// Configuration
-static char api_url[64] = LIBRELINKUP_API_URL_GLOBAL;
-static char auth_token[512] = {0};
-static char account_id[65] = {0};  // SHA256 hash in hex (64 chars + null terminator)
-static bool logged_in = false;
-static bool api_url_set_by_redirect = false;  // Track if URL was set by regional redirect
+// NVS namespace for session state (token, account id, regional URL)
+#define LIBRE_NVS_NAMESPACE "storage"
 
-// HTTP response buffer (increased to handle large glucose graph responses)
-#define HTTP_BUFFER_SIZE 16384
-static char http_response[HTTP_BUFFER_SIZE];
-static int http_response_len = 0;
+// Response bodies start small and grow up to the largest expected response
+// (the glucose graph is ~11 KB)
+#define LIBRE_RESPONSE_INITIAL_SIZE 2048
+#define LIBRE_RESPONSE_MAX_SIZE     16384
 
-// Store graph data from last fetch
+// Identical GET requests in flight at the same time share one round trip
+#define LIBRE_INFLIGHT_SLOTS        4
+#define LIBRE_INFLIGHT_MAX_WAITERS  8
+
+/**
+ * Client session (one per handle)
+ */
+struct librelinkup_client {
+    SemaphoreHandle_t mutex;        // Guards the session fields; held across login only
+    bool persist;                   // Session restored from and saved to NVS
+    bool logged_in;
+    bool api_url_set_by_redirect;   // Track if URL was set by regional redirect
+    char api_url[64];
+    char auth_token[512];
+    char account_id[65];            // SHA256 hash in hex (64 chars + null terminator)
+};
+
+/**
+ * Per-request response sink
+ */
+typedef struct {
+    char *data;                     // NUL terminated body
+    size_t len;
+    size_t cap;
+    bool overflow;
+} libre_response_t;
+
+/**
+ * Request description for the dispatcher
+ */
+typedef struct {
+    esp_http_client_method_t method;
+    const char *url;
+    const char *post_data;          // JSON body for POST, NULL for GET
+    const char *auth_header;        // "Bearer <token>", NULL for unauthenticated requests
+    const char *account_id;
+} libre_request_t;
+
+/**
+ * Copy of a session taken for one authenticated request
+ * The client is not locked during the round trip, so concurrent callers
+ * can share a request in flight.
+ */
+typedef struct {
+    char api_url[64];
+    char account_id[65];
+    char *auth_header;              // Heap: "Bearer <token>"
+} libre_session_t;
+
+/**
+ * Request in flight that identical requests can join
+ */
+typedef struct {
+    bool active;                    // Owner still performing the request
+    int refs;                       // Owner + waiters that have not collected the result
+    int waiters;
+    uint32_t token_hash;            // Session the request was made with
+    char url[192];
+    SemaphoreHandle_t done;         // Given once per waiter when the owner finishes
+    esp_err_t err;
+    int status_code;
+    libre_response_t response;      // Copy of the body for waiters
+} libre_inflight_t;
+
+// Dispatcher state and the network lock (one TLS session at a time)
+static SemaphoreHandle_t dispatch_mutex = NULL;
+static StaticSemaphore_t dispatch_mutex_buffer;
+static SemaphoreHandle_t net_mutex = NULL;
+static StaticSemaphore_t net_mutex_buffer;
+static portMUX_TYPE dispatch_init_lock = portMUX_INITIALIZER_UNLOCKED;
+static libre_inflight_t inflight[LIBRE_INFLIGHT_SLOTS];
+
+// Store graph data from last fetch (read by the display task)
 static libre_graph_data_t cached_graph_data = {0};
+static SemaphoreHandle_t graph_mutex = NULL;
+static StaticSemaphore_t graph_mutex_buffer;
+
+static void dispatcher_init(void)
+{
+    if (dispatch_mutex) {
+        return;
+    }
+    // Static storage: creation cannot fail, so no error path
+    taskENTER_CRITICAL(&dispatch_init_lock);
+    if (!dispatch_mutex) {
+        net_mutex = xSemaphoreCreateMutexStatic(&net_mutex_buffer);
+        graph_mutex = xSemaphoreCreateMutexStatic(&graph_mutex_buffer);
+        dispatch_mutex = xSemaphoreCreateMutexStatic(&dispatch_mutex_buffer);
+    }
+    taskEXIT_CRITICAL(&dispatch_init_lock);
+}
+
+static uint32_t hash_string(const char *s)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    while (*s) {
+        hash ^= (uint8_t)*s++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static void response_free(libre_response_t *response)
+{
+    free(response->data);
+    memset(response, 0, sizeof(*response));
+}
+
+static bool response_append(libre_response_t *response, const char *data, size_t len)
+{
+    if (response->len + len + 1 > response->cap) {
+        size_t cap = response->cap ? response->cap : LIBRE_RESPONSE_INITIAL_SIZE;
+        while (cap < response->len + len + 1) {
+            cap *= 2;
+        }
+        if (cap > LIBRE_RESPONSE_MAX_SIZE) {
+            return false;
+        }
+        char *grown = realloc(response->data, cap);
+        if (!grown) {
+            return false;
+        }
+        response->data = grown;
+        response->cap = cap;
+    }
+    memcpy(response->data + response->len, data, len);
+    response->len += len;
+    response->data[response->len] = '\0';
+    return true;
+}
 
 /**
  * HTTP event handler
+ * Appends the body to the request's own sink (user_data)
  */
 static esp_err_t http_event_handler(esp_http_client_event_t *evt)
 {
+    libre_response_t *response = (libre_response_t *)evt->user_data;
+
     switch (evt->event_id) {
         case HTTP_EVENT_ON_DATA:
-            // Ensure we have room for data + null terminator
-            if (http_response_len + evt->data_len < HTTP_BUFFER_SIZE - 1) {
-                memcpy(http_response + http_response_len, evt->data, evt->data_len);
-                http_response_len += evt->data_len;
-                http_response[http_response_len] = '\0';
-            } else {
+            if (!response->overflow && !response_append(response, evt->data, evt->data_len)) {
+                response->overflow = true;
                 ESP_LOGW(TAG, "Response buffer overflow");
             }
             break;
@@ -56,29 +186,40 @@ static esp_err_t http_event_handler(esp_http_client_event_t *evt)
  * Retry HTTP requests with exponential backoff for DNS/network failures
  * This helps recover from transient DNS issues after OTA reboots
  */
-static esp_err_t http_client_perform_with_retry(esp_http_client_handle_t client, int max_retries)
+static esp_err_t http_client_perform_with_retry(esp_http_client_handle_t client, libre_response_t *response,
+                                                int max_retries)
 {
     esp_err_t err = ESP_FAIL;
     int retry_delay_ms = 1000;  // Start with 1 second
-    
+
     for (int retry = 0; retry < max_retries; retry++) {
+        // Drop any partial body from a failed attempt
+        response->len = 0;
+        response->overflow = false;
+        if (response->data) {
+            response->data[0] = '\0';
+        }
+
+        // Full clock for the transfer, not for the backoff
+        power_lock_acquire(POWER_LOCK_NETWORK);
         err = esp_http_client_perform(client);
-        
+        power_lock_release(POWER_LOCK_NETWORK);
+
         if (err == ESP_OK) {
             return ESP_OK;
         }
-        
+
         // Only retry on connection/DNS failures, not on HTTP errors
-        if (err == ESP_ERR_HTTP_CONNECT || 
+        if (err == ESP_ERR_HTTP_CONNECT ||
             err == ESP_FAIL ||  // DNS lookup failures return ESP_FAIL
             err == ESP_ERR_TIMEOUT) {
-            
+
             if (retry < max_retries - 1) {
-                ESP_LOGW(TAG, "HTTP request failed (%s), retrying in %d ms (%d/%d)", 
+                ESP_LOGW(TAG, "HTTP request failed (%s), retrying in %d ms (%d/%d)",
                          esp_err_to_name(err), retry_delay_ms, retry + 1, max_retries);
                 vTaskDelay(pdMS_TO_TICKS(retry_delay_ms));
                 retry_delay_ms *= 2;  // Exponential backoff
-                
+
                 if (retry_delay_ms > 5000) {
                     retry_delay_ms = 5000;  // Cap at 5 seconds
                 }
@@ -90,126 +231,273 @@ static esp_err_t http_client_perform_with_retry(esp_http_client_handle_t client,
             return err;
         }
     }
-    
+
     return err;
 }
 
-esp_err_t librelinkup_init(bool use_eu_server)
+/**
+ * Perform one request on the network
+ * Holds net_mutex so only one TLS session (and its buffers) exists at a time
+ */
+static esp_err_t perform_request(const libre_request_t *request, int *status_code, libre_response_t *response)
 {
-    // Try to load saved auth token and account_id from NVS first
-    nvs_handle_t nvs_handle;
-    esp_err_t err = nvs_open("storage", NVS_READONLY, &nvs_handle);
+    ESP_LOGI(TAG, "Calling API: %s", request->url);
+
+    esp_http_client_config_t config = {
+        .url = request->url,
+        .method = request->method,
+        .event_handler = http_event_handler,
+        .user_data = response,
+        .timeout_ms = 10000,
+        .crt_bundle_attach = esp_crt_bundle_attach,
+        .buffer_size_tx = 2048,
+    };
+
+    *status_code = 0;
+    xSemaphoreTake(net_mutex, portMAX_DELAY);
+
+    esp_http_client_handle_t http = esp_http_client_init(&config);
+    if (!http) {
+        xSemaphoreGive(net_mutex);
+        return ESP_ERR_NO_MEM;
+    }
+
+    // Set headers
+    if (request->auth_header) {
+        esp_http_client_set_header(http, "Authorization", request->auth_header);
+        esp_http_client_set_header(http, "Account-Id", request->account_id);
+    }
+    esp_http_client_set_header(http, "Content-Type", "application/json");
+    esp_http_client_set_header(http, "product", "llu.android");
+    esp_http_client_set_header(http, "version", "4.16.0");
+    esp_http_client_set_header(http, "Cache-Control", "no-cache");
+    if (request->post_data) {
+        esp_http_client_set_header(http, "Connection", "Keep-Alive");
+        esp_http_client_set_post_field(http, request->post_data, strlen(request->post_data));
+    }
+
+    // Perform request with retry logic for DNS failures
+    esp_err_t err = http_client_perform_with_retry(http, response, 3);
     if (err == ESP_OK) {
-        // Try to load auth token
-        size_t token_size = sizeof(auth_token);
-        err = nvs_get_str(nvs_handle, "auth_token", auth_token, &token_size);
-        if (err == ESP_OK && strlen(auth_token) > 0) {
-            // Try to load account_id
-            size_t account_size = sizeof(account_id);
-            err = nvs_get_str(nvs_handle, "account_id", account_id, &account_size);
-            if (err == ESP_OK && strlen(account_id) > 0) {
-                logged_in = true;
-                ESP_LOGI(TAG, "Restored auth token from NVS (valid for ~6 months)");
-                ESP_LOGI(TAG, "Token length: %d, Account-Id length: %d", strlen(auth_token), strlen(account_id));
-            }
-        }
-        nvs_close(nvs_handle);
+        *status_code = esp_http_client_get_status_code(http);
+    }
+
+    esp_http_client_cleanup(http);
+    xSemaphoreGive(net_mutex);
+
+    if (err == ESP_OK && response->overflow) {
+        err = ESP_ERR_NO_MEM;
+    }
+    if (err == ESP_OK && !response->data && !response_append(response, "", 0)) {
+        // Callers always get a string, even for an empty body
+        err = ESP_ERR_NO_MEM;
     }
-    
-    // Try to load saved regional URL from NVS
-    err = nvs_open("storage", NVS_READONLY, &nvs_handle);
     if (err == ESP_OK) {
-        size_t required_size = sizeof(api_url);
-        err = nvs_get_str(nvs_handle, "api_url", api_url, &required_size);
-        if (err == ESP_OK) {
-            ESP_LOGI(TAG, "Loaded regional API URL from NVS: %s", api_url);
-            api_url_set_by_redirect = true;
-            nvs_close(nvs_handle);
-            return ESP_OK;
+        ESP_LOGI(TAG, "HTTP Status: %d, Response length: %d", *status_code, response->len);
+    }
+    return err;
+}
+
+/**
+ * Request dispatcher
+ * Every request goes through here. A GET matching one already in flight
+ * (same URL and session) waits for that request and receives a copy of
+ * its response instead of making its own round trip.
+ *
+ * @param response Output body; caller releases it with response_free()
+ */
+static esp_err_t libre_dispatch(const libre_request_t *request, int *status_code, libre_response_t *response)
+{
+    dispatcher_init();
+    memset(response, 0, sizeof(*response));
+
+    if (request->method != HTTP_METHOD_GET || strlen(request->url) >= sizeof(inflight[0].url)) {
+        return perform_request(request, status_code, response);
+    }
+
+    uint32_t token_hash = request->auth_header ? hash_string(request->auth_header) : 0;
+    libre_inflight_t *entry = NULL;
+    libre_inflight_t *free_entry = NULL;
+
+    xSemaphoreTake(dispatch_mutex, portMAX_DELAY);
+    for (size_t i = 0; i < LIBRE_INFLIGHT_SLOTS; i++) {
+        libre_inflight_t *slot = &inflight[i];
+        if (slot->active && slot->token_hash == token_hash && strcmp(slot->url, request->url) == 0 &&
+            slot->waiters < LIBRE_INFLIGHT_MAX_WAITERS) {
+            entry = slot;
+            break;
+        }
+        if (!free_entry && !slot->active && slot->refs == 0) {
+            free_entry = slot;
         }
-        nvs_close(nvs_handle);
     }
-    
-    // No saved regional URL, use base URL if we haven't received a redirect
-    if (!api_url_set_by_redirect) {
-        if (use_eu_server) {
-            strncpy(api_url, LIBRELINKUP_API_URL_EU, sizeof(api_url) - 1);
-        } else {
-            strncpy(api_url, LIBRELINKUP_API_URL_GLOBAL, sizeof(api_url) - 1);
+
+    if (entry) {
+        // Join the request in flight
+        entry->waiters++;
+        entry->refs++;
+        xSemaphoreGive(dispatch_mutex);
+
+        ESP_LOGI(TAG, "Joining request in flight: %s", request->url);
+        xSemaphoreTake(entry->done, portMAX_DELAY);
+
+        xSemaphoreTake(dispatch_mutex, portMAX_DELAY);
+        esp_err_t err = entry->err;
+        *status_code = entry->status_code;
+        if (err == ESP_OK && !response_append(response, entry->response.data, entry->response.len)) {
+            err = ESP_ERR_NO_MEM;
         }
-        ESP_LOGI(TAG, "Initialized with API URL: %s", api_url);
-    } else {
-        ESP_LOGI(TAG, "Using regional API URL from redirect: %s", api_url);
+        if (--entry->refs == 0) {
+            response_free(&entry->response);
+        }
+        xSemaphoreGive(dispatch_mutex);
+        return err;
     }
-    
-    return ESP_OK;
+
+    // Without a free slot the request simply runs uncoalesced
+    if (free_entry && !free_entry->done) {
+        free_entry->done = xSemaphoreCreateCounting(LIBRE_INFLIGHT_MAX_WAITERS, 0);
+    }
+    if (free_entry && free_entry->done) {
+        entry = free_entry;
+        entry->active = true;
+        entry->refs = 1;
+        entry->waiters = 0;
+        entry->token_hash = token_hash;
+        strcpy(entry->url, request->url);
+    }
+    xSemaphoreGive(dispatch_mutex);
+
+    esp_err_t err = perform_request(request, status_code, response);
+
+    if (entry) {
+        xSemaphoreTake(dispatch_mutex, portMAX_DELAY);
+        entry->active = false;  // Later callers start a fresh request
+        entry->err = err;
+        entry->status_code = *status_code;
+        if (err == ESP_OK && entry->waiters > 0 &&
+            !response_append(&entry->response, response->data, response->len)) {
+            entry->err = ESP_ERR_NO_MEM;
+        }
+        for (int i = 0; i < entry->waiters; i++) {
+            xSemaphoreGive(entry->done);
+        }
+        if (--entry->refs == 0) {
+            response_free(&entry->response);
+        }
+        xSemaphoreGive(dispatch_mutex);
+    }
+
+    return err;
 }
 
-esp_err_t librelinkup_login(const char *email, const char *password)
+// Restore a saved session (token, account id, regional URL) from NVS
+static void load_session(librelinkup_client_t *client)
+{
+    nvs_handle_t nvs_handle;
+    if (nvs_open(LIBRE_NVS_NAMESPACE, NVS_READONLY, &nvs_handle) != ESP_OK) {
+        return;
+    }
+
+    // Try to load auth token
+    size_t token_size = sizeof(client->auth_token);
+    esp_err_t err = nvs_get_str(nvs_handle, "auth_token", client->auth_token, &token_size);
+    if (err == ESP_OK && strlen(client->auth_token) > 0) {
+        // Try to load account_id
+        size_t account_size = sizeof(client->account_id);
+        err = nvs_get_str(nvs_handle, "account_id", client->account_id, &account_size);
+        if (err == ESP_OK && strlen(client->account_id) > 0) {
+            client->logged_in = true;
+            ESP_LOGI(TAG, "Restored auth token from NVS (valid for ~6 months)");
+            ESP_LOGI(TAG, "Token length: %d, Account-Id length: %d",
+                     strlen(client->auth_token), strlen(client->account_id));
+        }
+    }
+
+    // Try to load saved regional URL
+    char saved_url[sizeof(client->api_url)];
+    size_t required_size = sizeof(saved_url);
+    if (nvs_get_str(nvs_handle, "api_url", saved_url, &required_size) == ESP_OK) {
+        strcpy(client->api_url, saved_url);
+        client->api_url_set_by_redirect = true;
+        ESP_LOGI(TAG, "Loaded regional API URL from NVS: %s", client->api_url);
+    }
+    nvs_close(nvs_handle);
+}
+
+librelinkup_client_t* librelinkup_client_create(bool use_eu_server, bool persist_session)
+{
+    librelinkup_client_t *client = calloc(1, sizeof(librelinkup_client_t));
+    if (!client) {
+        ESP_LOGE(TAG, "No memory for client");
+        return NULL;
+    }
+    client->mutex = xSemaphoreCreateMutex();
+    if (!client->mutex) {
+        free(client);
+        ESP_LOGE(TAG, "Failed to create client mutex");
+        return NULL;
+    }
+    client->persist = persist_session;
+    strcpy(client->api_url, use_eu_server ? LIBRELINKUP_API_URL_EU : LIBRELINKUP_API_URL_GLOBAL);
+
+    if (persist_session) {
+        load_session(client);
+    }
+    ESP_LOGI(TAG, "Initialized with API URL: %s", client->api_url);
+    return client;
+}
+
+void librelinkup_client_destroy(librelinkup_client_t *client)
+{
+    if (!client) {
+        return;
+    }
+    vSemaphoreDelete(client->mutex);
+    // Don't leave the token behind in freed heap
+    memset(client, 0, sizeof(*client));
+    free(client);
+}
+
+// Login with the client mutex held. Follows at most one regional redirect.
+static esp_err_t login_locked(librelinkup_client_t *client, const char *email, const char *password, int redirects)
 {
-#if DEMO_MODE_ENABLED
-    ESP_LOGI(TAG, "[DEMO MODE] Skipping API login - using dummy data");
-    strcpy(auth_token, "demo_auth_token_12345");
-    logged_in = true;
-    return ESP_OK;
-#else
     esp_err_t ret = ESP_FAIL;
-    
+    bool redirected = false;
+
     ESP_LOGI(TAG, "Logging in to LibreLinkUp...");
-    
+
     // Create JSON request body
     cJSON *root = cJSON_CreateObject();
     cJSON_AddStringToObject(root, "email", email);
     cJSON_AddStringToObject(root, "password", password);
     char *post_data = cJSON_PrintUnformatted(root);
     cJSON_Delete(root);
-    
+
     if (!post_data) {
         ESP_LOGE(TAG, "Failed to create JSON request");
         return ESP_ERR_NO_MEM;
     }
-    
-    // Reset response buffer
-    http_response_len = 0;
-    memset(http_response, 0, sizeof(http_response));
-    
-    // Configure HTTP client
+
     char url[128];
-    snprintf(url, sizeof(url), "%s/llu/auth/login", api_url);
-    
-    ESP_LOGI(TAG, "Calling API: %s", url);
-    
-    esp_http_client_config_t config = {
-        .url = url,
+    snprintf(url, sizeof(url), "%s/llu/auth/login", client->api_url);
+    libre_request_t request = {
         .method = HTTP_METHOD_POST,
-        .event_handler = http_event_handler,
-        .timeout_ms = 10000,
-        .crt_bundle_attach = esp_crt_bundle_attach,
-        .buffer_size_tx = 2048,
+        .url = url,
+        .post_data = post_data,
     };
-    
-    esp_http_client_handle_t client = esp_http_client_init(&config);
-    
-    // Set headers
-    esp_http_client_set_header(client, "Content-Type", "application/json");
-    esp_http_client_set_header(client, "product", "llu.android");
-    esp_http_client_set_header(client, "version", "4.16.0");
-    esp_http_client_set_header(client, "Cache-Control", "no-cache");
-    esp_http_client_set_header(client, "Connection", "Keep-Alive");
-    
-    esp_http_client_set_post_field(client, post_data, strlen(post_data));
-    
-    // Perform request with retry logic for DNS failures
-    esp_err_t err = http_client_perform_with_retry(client, 3);
-    
+
+    int status_code = 0;
+    libre_response_t response;
+    esp_err_t err = libre_dispatch(&request, &status_code, &response);
+    free(post_data);
+
     if (err == ESP_OK) {
-        int status_code = esp_http_client_get_status_code(client);
-        ESP_LOGI(TAG, "HTTP Status: %d, Response length: %d", status_code, http_response_len);
-        ESP_LOGI(TAG, "Response: %s", http_response);
-        
+        ESP_LOGI(TAG, "Response: %s", response.data);
+
         if (status_code == 200) {
             // Parse JSON response
-            cJSON *json = cJSON_Parse(http_response);
+            cJSON *json = cJSON_Parse(response.data);
             if (json) {
                 cJSON *status = cJSON_GetObjectItem(json, "status");
                 if (status && status->valueint == 0) {
@@ -220,43 +508,30 @@ esp_err_t librelinkup_login(const char *email, const char *password)
                         cJSON *redirect = cJSON_GetObjectItem(data, "redirect");
                         if (redirect && cJSON_IsTrue(redirect)) {
                             cJSON *region = cJSON_GetObjectItem(data, "region");
-                            if (region && region->valuestring) {
+                            if (region && region->valuestring && redirects == 0) {
                                 ESP_LOGI(TAG, "Redirecting to region: %s", region->valuestring);
                                 // Update API URL with region and mark it as set by redirect
-                                snprintf(api_url, sizeof(api_url), "https://api-%s.libreview.io", region->valuestring);
-                                api_url_set_by_redirect = true;
-                                
-                                // Save regional URL to NVS for persistence across reboots
-                                nvs_handle_t nvs_handle;
-                                esp_err_t nvs_err = nvs_open("storage", NVS_READWRITE, &nvs_handle);
-                                if (nvs_err == ESP_OK) {
-                                    nvs_err = nvs_set_str(nvs_handle, "api_url", api_url);
-                                    if (nvs_err == ESP_OK) {
-                                        nvs_commit(nvs_handle);
-                                        ESP_LOGI(TAG, "Saved regional URL to NVS: %s", api_url);
-                                    } else {
-                                        ESP_LOGW(TAG, "Failed to save regional URL to NVS: %s", esp_err_to_name(nvs_err));
+                                snprintf(client->api_url, sizeof(client->api_url), "https://api-%s.libreview.io", region->valuestring);
+                                client->api_url_set_by_redirect = true;
+                                redirected = true;
+
+                                // Stage regional URL for persistence; committed together with the token
+                                if (client->persist) {
+                                    esp_err_t nvs_err = nvs_journal_set_str(LIBRE_NVS_NAMESPACE, "api_url", client->api_url);
+                                    if (nvs_err != ESP_OK) {
+                                        ESP_LOGW(TAG, "Failed to stage regional URL: %s", esp_err_to_name(nvs_err));
                                     }
-                                    nvs_close(nvs_handle);
-                                } else {
-                                    ESP_LOGW(TAG, "Failed to open NVS for saving regional URL: %s", esp_err_to_name(nvs_err));
                                 }
-                                
-                                cJSON_Delete(json);
-                                esp_http_client_cleanup(client);
-                                free(post_data);
-                                // Retry login with new URL
-                                return librelinkup_login(email, password);
                             }
                         }
-                        
+
                         // Extract auth token
-                        cJSON *auth_ticket = cJSON_GetObjectItem(data, "authTicket");
+                        cJSON *auth_ticket = redirected ? NULL : cJSON_GetObjectItem(data, "authTicket");
                         if (auth_ticket) {
                             cJSON *token = cJSON_GetObjectItem(auth_ticket, "token");
                             if (token && token->valuestring) {
-                                strncpy(auth_token, token->valuestring, sizeof(auth_token) - 1);
-                                
+                                strncpy(client->auth_token, token->valuestring, sizeof(client->auth_token) - 1);
+
                                 // Extract user ID and compute Account-Id (SHA256 hash)
                                 cJSON *user = cJSON_GetObjectItem(data, "user");
                                 if (user) {
@@ -264,40 +539,26 @@ esp_err_t librelinkup_login(const char *email, const char *password)
                                     if (user_id && user_id->valuestring) {
                                         // Compute SHA256 hash of user ID
                                         unsigned char hash[32];
-                                        mbedtls_sha256((unsigned char *)user_id->valuestring, 
+                                        mbedtls_sha256((unsigned char *)user_id->valuestring,
                                                       strlen(user_id->valuestring), hash, 0);
-                                        
+
                                         // Convert hash to hex string
                                         for (int i = 0; i < 32; i++) {
-                                            sprintf(&account_id[i * 2], "%02x", hash[i]);
+                                            sprintf(&client->account_id[i * 2], "%02x", hash[i]);
                                         }
-                                        account_id[64] = '\0';
+                                        client->account_id[64] = '\0';
                                         ESP_LOGI(TAG, "Account-Id computed");
                                     }
                                 }
-                                
-                                logged_in = true;
+
+                                client->logged_in = true;
                                 ret = ESP_OK;
                                 ESP_LOGI(TAG, "Login successful");
-                                
-                                // Save auth token and account_id to NVS for persistence
-                                nvs_handle_t nvs_handle;
-                                esp_err_t nvs_err = nvs_open("storage", NVS_READWRITE, &nvs_handle);
-                                if (nvs_err == ESP_OK) {
-                                    nvs_err = nvs_set_str(nvs_handle, "auth_token", auth_token);
-                                    if (nvs_err == ESP_OK) {
-                                        nvs_err = nvs_set_str(nvs_handle, "account_id", account_id);
-                                        if (nvs_err == ESP_OK) {
-                                            nvs_commit(nvs_handle);
-                                            ESP_LOGI(TAG, "Saved auth token to NVS (valid for ~6 months)");
-                                        }
-                                    }
-                                    if (nvs_err != ESP_OK) {
-                                        ESP_LOGW(TAG, "Failed to save auth token to NVS: %s", esp_err_to_name(nvs_err));
-                                    }
-                                    nvs_close(nvs_handle);
-                                } else {
-                                    ESP_LOGW(TAG, "Failed to open NVS for saving auth token: %s", esp_err_to_name(nvs_err));
+
+                                // Stage auth token and account_id; flushed in one commit below
+                                if (client->persist) {
+                                    nvs_journal_set_str(LIBRE_NVS_NAMESPACE, "auth_token", client->auth_token);
+                                    nvs_journal_set_str(LIBRE_NVS_NAMESPACE, "account_id", client->account_id);
                                 }
                             }
                         }
@@ -314,7 +575,7 @@ esp_err_t librelinkup_login(const char *email, const char *password)
                                 int lockout_seconds = lockout ? lockout->valueint : 0;
                                 int failure_count = failures ? failures->valueint : 0;
                                 ESP_LOGE(TAG, "Account locked due to too many login attempts!");
-                                ESP_LOGE(TAG, "Failed attempts: %d, Lockout time: %d seconds (%d minutes)", 
+                                ESP_LOGE(TAG, "Failed attempts: %d, Lockout time: %d seconds (%d minutes)",
                                         failure_count, lockout_seconds, lockout_seconds / 60);
                                 ESP_LOGE(TAG, "Please wait before trying again.");
                             } else {
@@ -335,226 +596,529 @@ esp_err_t librelinkup_login(const char *email, const char *password)
     } else {
         ESP_LOGE(TAG, "HTTP request failed: %s", esp_err_to_name(err));
     }
-    
-    esp_http_client_cleanup(client);
-    free(post_data);
-    
+
+    response_free(&response);
+
+    if (redirected) {
+        // Retry login with new URL
+        return login_locked(client, email, password, redirects + 1);
+    }
+
+    // Commit URL, token and account id together (unchanged values are skipped)
+    if (client->persist && nvs_journal_flush() == ESP_OK && ret == ESP_OK) {
+        ESP_LOGI(TAG, "Saved auth token to NVS (valid for ~6 months)");
+    }
+
     return ret;
-#endif
 }
 
-esp_err_t librelinkup_get_patient_id(char *patient_id, size_t patient_id_len)
+esp_err_t librelinkup_login(librelinkup_client_t *client, const char *email, const char *password)
 {
+    if (!client || !email || !password) {
+        return ESP_ERR_INVALID_ARG;
+    }
 #if DEMO_MODE_ENABLED
-    ESP_LOGI(TAG, "[DEMO MODE] Returning dummy patient ID");
-    strncpy(patient_id, "demo-patient-12345", patient_id_len - 1);
-    patient_id[patient_id_len - 1] = '\0';
+    ESP_LOGI(TAG, "[DEMO MODE] Skipping API login - using dummy data");
+    strcpy(client->auth_token, "demo_auth_token_12345");
+    client->logged_in = true;
     return ESP_OK;
 #else
-    if (!logged_in) {
+    xSemaphoreTake(client->mutex, portMAX_DELAY);
+    esp_err_t ret = login_locked(client, email, password, 0);
+    xSemaphoreGive(client->mutex);
+    return ret;
+#endif
+}
+
+// Copy the session for an authenticated request (client locked only while copying)
+static esp_err_t session_snapshot(librelinkup_client_t *client, libre_session_t *session)
+{
+    memset(session, 0, sizeof(*session));
+
+    xSemaphoreTake(client->mutex, portMAX_DELAY);
+    if (!client->logged_in) {
+        xSemaphoreGive(client->mutex);
         ESP_LOGE(TAG, "Not logged in");
         return ESP_ERR_INVALID_STATE;
     }
-    
-    esp_err_t ret = ESP_FAIL;
-    
-    ESP_LOGI(TAG, "Getting patient connections...");
-    
-    // Reset response buffer
-    http_response_len = 0;
-    memset(http_response, 0, sizeof(http_response));
-    
-    // Configure HTTP client
+    size_t header_size = strlen("Bearer ") + strlen(client->auth_token) + 1;
+    session->auth_header = malloc(header_size);
+    if (session->auth_header) {
+        snprintf(session->auth_header, header_size, "Bearer %s", client->auth_token);
+        strcpy(session->api_url, client->api_url);
+        strcpy(session->account_id, client->account_id);
+    }
+    xSemaphoreGive(client->mutex);
+
+    return session->auth_header ? ESP_OK : ESP_ERR_NO_MEM;
+}
+
+// Server answered 401: log out, unless the client has logged in again meanwhile
+static void session_rejected(librelinkup_client_t *client, const libre_session_t *session)
+{
+    ESP_LOGE(TAG, "Authentication failed (401) - token may be expired");
+    xSemaphoreTake(client->mutex, portMAX_DELAY);
+    if (strcmp(session->auth_header + strlen("Bearer "), client->auth_token) == 0) {
+        // Next caller logs in again instead of reusing the rejected token
+        client->logged_in = false;
+    }
+    xSemaphoreGive(client->mutex);
+}
+
+static void session_release(libre_session_t *session)
+{
+    free(session->auth_header);
+    memset(session, 0, sizeof(*session));
+}
+
+/**
+ * GET /llu/connections
+ * @param json_out Parsed response; caller deletes it
+ * @param data_out The response's "data" array (owned by json_out)
+ */
+static esp_err_t get_connections(librelinkup_client_t *client, cJSON **json_out, cJSON **data_out)
+{
+    *json_out = NULL;
+    *data_out = NULL;
+
+    libre_session_t session;
+    esp_err_t ret = session_snapshot(client, &session);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
     char url[128];
-    snprintf(url, sizeof(url), "%s/llu/connections", api_url);
-    
-    ESP_LOGI(TAG, "Calling API: %s", url);
-    
-    esp_http_client_config_t config = {
-        .url = url,
+    snprintf(url, sizeof(url), "%s/llu/connections", session.api_url);
+    libre_request_t request = {
         .method = HTTP_METHOD_GET,
-        .event_handler = http_event_handler,
-        .timeout_ms = 10000,
-        .crt_bundle_attach = esp_crt_bundle_attach,
-        .buffer_size_tx = 2048,
+        .url = url,
+        .auth_header = session.auth_header,
+        .account_id = session.account_id,
     };
-    
-    esp_http_client_handle_t client = esp_http_client_init(&config);
-    
-    // Set headers
-    char auth_header[600];
-    snprintf(auth_header, sizeof(auth_header), "Bearer %s", auth_token);
-    esp_http_client_set_header(client, "Authorization", auth_header);
-    esp_http_client_set_header(client, "Account-Id", account_id);
-    esp_http_client_set_header(client, "Content-Type", "application/json");
-    esp_http_client_set_header(client, "product", "llu.android");
-    esp_http_client_set_header(client, "version", "4.16.0");
-    esp_http_client_set_header(client, "Cache-Control", "no-cache");
-    
-    // Perform request with retry logic for DNS failures
-    esp_err_t err = http_client_perform_with_retry(client, 3);
-    
-    if (err == ESP_OK) {
-        int status_code = esp_http_client_get_status_code(client);
-        ESP_LOGI(TAG, "HTTP Status: %d, Response length: %d", status_code, http_response_len);
-        
-        if (status_code == 200) {
-            // Parse JSON response
-            cJSON *json = cJSON_Parse(http_response);
-            if (json) {
-                cJSON *status = cJSON_GetObjectItem(json, "status");
-                if (status && status->valueint == 0) {
-                    cJSON *data = cJSON_GetObjectItem(json, "data");
-                    if (data && cJSON_IsArray(data)) {
-                        cJSON *first_connection = cJSON_GetArrayItem(data, 0);
-                        if (first_connection) {
-                            cJSON *patient_id_obj = cJSON_GetObjectItem(first_connection, "patientId");
-                            if (patient_id_obj && patient_id_obj->valuestring) {
-                                strncpy(patient_id, patient_id_obj->valuestring, patient_id_len - 1);
-                                patient_id[patient_id_len - 1] = '\0';
-                                ret = ESP_OK;
-                                ESP_LOGI(TAG, "Found patient ID: %s", patient_id);
-                            }
-                        }
-                    }
-                }
+
+    int status_code = 0;
+    libre_response_t response;
+    esp_err_t err = libre_dispatch(&request, &status_code, &response);
+    ret = ESP_FAIL;
+
+    if (err == ESP_OK && status_code == 401) {
+        session_rejected(client, &session);
+        ret = ESP_ERR_LIBRE_AUTH_FAILED;
+    }
+    session_release(&session);
+
+    if (err == ESP_OK && status_code == 200) {
+        // Parse JSON response
+        cJSON *json = cJSON_Parse(response.data);
+        if (json) {
+            cJSON *status = cJSON_GetObjectItem(json, "status");
+            cJSON *data = cJSON_GetObjectItem(json, "data");
+            if (status && status->valueint == 0 && data && cJSON_IsArray(data)) {
+                *json_out = json;
+                *data_out = data;
+                ret = ESP_OK;
+            } else {
                 cJSON_Delete(json);
             }
         }
     }
-    
-    esp_http_client_cleanup(client);
+
+    response_free(&response);
+    return ret;
+}
+
+esp_err_t librelinkup_get_patient_id(librelinkup_client_t *client, char *patient_id, size_t patient_id_len)
+{
+    if (!client || !patient_id || patient_id_len == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+#if DEMO_MODE_ENABLED
+    ESP_LOGI(TAG, "[DEMO MODE] Returning dummy patient ID");
+    strncpy(patient_id, "demo-patient-12345", patient_id_len - 1);
+    patient_id[patient_id_len - 1] = '\0';
+    return ESP_OK;
+#else
+    ESP_LOGI(TAG, "Getting patient connections...");
+
+    cJSON *json;
+    cJSON *data;
+    esp_err_t ret = get_connections(client, &json, &data);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    ret = ESP_FAIL;
+    cJSON *first_connection = cJSON_GetArrayItem(data, 0);
+    if (first_connection) {
+        cJSON *patient_id_obj = cJSON_GetObjectItem(first_connection, "patientId");
+        if (patient_id_obj && patient_id_obj->valuestring) {
+            strncpy(patient_id, patient_id_obj->valuestring, patient_id_len - 1);
+            patient_id[patient_id_len - 1] = '\0';
+            ret = ESP_OK;
+            ESP_LOGI(TAG, "Found patient ID: %s", patient_id);
+        }
+    }
+    cJSON_Delete(json);
     return ret;
 #endif
 }
 
-esp_err_t librelinkup_get_connections_json(char *json_buffer, size_t buffer_size)
+esp_err_t librelinkup_get_connections_json(librelinkup_client_t *client, char *json_buffer, size_t buffer_size)
 {
+    if (!client || !json_buffer || buffer_size == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
 #if DEMO_MODE_ENABLED
     ESP_LOGI(TAG, "[DEMO MODE] Returning dummy connections list");
-    snprintf(json_buffer, buffer_size, 
+    snprintf(json_buffer, buffer_size,
              "{\"success\":true,\"patients\":[{\"id\":\"demo-patient-12345\",\"name\":\"Demo Patient\"}]}");
     return ESP_OK;
 #else
-    if (!logged_in) {
-        ESP_LOGE(TAG, "Not logged in");
+    ESP_LOGI(TAG, "Getting patient connections for JSON...");
+
+    cJSON *json;
+    cJSON *data;
+    esp_err_t ret = get_connections(client, &json, &data);
+    if (ret == ESP_ERR_INVALID_STATE) {
         snprintf(json_buffer, buffer_size, "{\"success\":false,\"error\":\"Not logged in\"}");
-        return ESP_ERR_INVALID_STATE;
+        return ret;
     }
-    
-    esp_err_t ret = ESP_FAIL;
-    
-    ESP_LOGI(TAG, "Getting patient connections for JSON...");
-    
-    // Reset response buffer
-    http_response_len = 0;
-    memset(http_response, 0, sizeof(http_response));
-    
-    // Configure HTTP client
-    char url[128];
-    snprintf(url, sizeof(url), "%s/llu/connections", api_url);
-    
-    ESP_LOGI(TAG, "Calling API: %s", url);
-    
-    esp_http_client_config_t config = {
-        .url = url,
-        .method = HTTP_METHOD_GET,
-        .event_handler = http_event_handler,
-        .timeout_ms = 10000,
-        .crt_bundle_attach = esp_crt_bundle_attach,
-        .buffer_size_tx = 2048,
-    };
-    
-    esp_http_client_handle_t client = esp_http_client_init(&config);
-    
-    // Set headers
-    char auth_header[600];
-    snprintf(auth_header, sizeof(auth_header), "Bearer %s", auth_token);
-    esp_http_client_set_header(client, "Authorization", auth_header);
-    esp_http_client_set_header(client, "Account-Id", account_id);
-    esp_http_client_set_header(client, "Content-Type", "application/json");
-    esp_http_client_set_header(client, "product", "llu.android");
-    esp_http_client_set_header(client, "version", "4.16.0");
-    esp_http_client_set_header(client, "Cache-Control", "no-cache");
-    
-    // Perform request
-    esp_err_t err = esp_http_client_perform(client);
-    
-    if (err == ESP_OK) {
-        int status_code = esp_http_client_get_status_code(client);
-        ESP_LOGI(TAG, "HTTP Status: %d, Response length: %d", status_code, http_response_len);
-        ESP_LOGI(TAG, "Response: %s", http_response);
-        
-        if (status_code == 200) {
-            // Parse JSON response
-            cJSON *json = cJSON_Parse(http_response);
-            if (json) {
-                cJSON *status = cJSON_GetObjectItem(json, "status");
-                if (status && status->valueint == 0) {
-                    cJSON *data = cJSON_GetObjectItem(json, "data");
-                    if (data && cJSON_IsArray(data)) {
-                        // Build JSON response with patient list
-                        cJSON *response = cJSON_CreateObject();
-                        cJSON_AddTrueToObject(response, "success");
-                        cJSON *patients_array = cJSON_CreateArray();
-                        
-                        int num_connections = cJSON_GetArraySize(data);
-                        for (int i = 0; i < num_connections; i++) {
-                            cJSON *connection = cJSON_GetArrayItem(data, i);
-                            cJSON *patient_id = cJSON_GetObjectItem(connection, "patientId");
-                            cJSON *first_name = cJSON_GetObjectItem(connection, "firstName");
-                            cJSON *last_name = cJSON_GetObjectItem(connection, "lastName");
-                            
-                            if (patient_id && patient_id->valuestring) {
-                                cJSON *patient = cJSON_CreateObject();
-                                cJSON_AddStringToObject(patient, "id", patient_id->valuestring);
-                                
-                                // Build full name
-                                char name[128] = {0};
-                                if (first_name && first_name->valuestring) {
-                                    strncpy(name, first_name->valuestring, sizeof(name) - 1);
-                                }
-                                if (last_name && last_name->valuestring) {
-                                    if (name[0]) strncat(name, " ", sizeof(name) - strlen(name) - 1);
-                                    strncat(name, last_name->valuestring, sizeof(name) - strlen(name) - 1);
-                                }
-                                if (name[0] == '\0') {
-                                    snprintf(name, sizeof(name), "Patient %d", i + 1);
-                                }
-                                cJSON_AddStringToObject(patient, "name", name);
-                                
-                                cJSON_AddItemToArray(patients_array, patient);
-                            }
-                        }
-                        
-                        cJSON_AddItemToObject(response, "patients", patients_array);
-                        
-                        char *json_str = cJSON_PrintUnformatted(response);
-                        if (json_str) {
-                            strncpy(json_buffer, json_str, buffer_size - 1);
-                            json_buffer[buffer_size - 1] = '\0';
-                            free(json_str);
-                            ret = ESP_OK;
-                        }
-                        cJSON_Delete(response);
-                    }
+
+    if (ret == ESP_OK) {
+        ret = ESP_FAIL;
+
+        // Build JSON response with patient list
+        cJSON *response = cJSON_CreateObject();
+        cJSON_AddTrueToObject(response, "success");
+        cJSON *patients_array = cJSON_CreateArray();
+
+        int num_connections = cJSON_GetArraySize(data);
+        for (int i = 0; i < num_connections; i++) {
+            cJSON *connection = cJSON_GetArrayItem(data, i);
+            cJSON *patient_id = cJSON_GetObjectItem(connection, "patientId");
+            cJSON *first_name = cJSON_GetObjectItem(connection, "firstName");
+            cJSON *last_name = cJSON_GetObjectItem(connection, "lastName");
+
+            if (patient_id && patient_id->valuestring) {
+                cJSON *patient = cJSON_CreateObject();
+                cJSON_AddStringToObject(patient, "id", patient_id->valuestring);
+
+                // Build full name
+                char name[128] = {0};
+                if (first_name && first_name->valuestring) {
+                    strncpy(name, first_name->valuestring, sizeof(name) - 1);
                 }
-                cJSON_Delete(json);
+                if (last_name && last_name->valuestring) {
+                    if (name[0]) strncat(name, " ", sizeof(name) - strlen(name) - 1);
+                    strncat(name, last_name->valuestring, sizeof(name) - strlen(name) - 1);
+                }
+                if (name[0] == '\0') {
+                    snprintf(name, sizeof(name), "Patient %d", i + 1);
+                }
+                cJSON_AddStringToObject(patient, "name", name);
+
+                cJSON_AddItemToArray(patients_array, patient);
             }
         }
+
+        cJSON_AddItemToObject(response, "patients", patients_array);
+
+        char *json_str = cJSON_PrintUnformatted(response);
+        if (json_str) {
+            strncpy(json_buffer, json_str, buffer_size - 1);
+            json_buffer[buffer_size - 1] = '\0';
+            free(json_str);
+            ret = ESP_OK;
+        }
+        cJSON_Delete(response);
+        cJSON_Delete(json);
     }
-    
+
     if (ret != ESP_OK) {
         snprintf(json_buffer, buffer_size, "{\"success\":false,\"error\":\"Failed to get connections\"}");
     }
-    
-    esp_http_client_cleanup(client);
     return ret;
 #endif
 }
 
-esp_err_t librelinkup_get_glucose(const char *patient_id, libre_glucose_data_t *glucose_data)
+/**
+ * Seconds since the epoch for a broken-down UTC time
+ * (mktime would read it in the configured time zone)
+ */
+static time_t utc_to_epoch(const struct tm *tm)
+{
+    // Days since 1970-01-01 from the civil date, with years starting in March
+    int year = tm->tm_year + 1900 - (tm->tm_mon < 2);
+    int era = (year >= 0 ? year : year - 399) / 400;
+    int year_of_era = year - era * 400;
+    int day_of_year = (153 * ((tm->tm_mon + 10) % 12) + 2) / 5 + tm->tm_mday - 1;
+    int day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+    int64_t days = (int64_t)era * 146097 + day_of_era - 719468;
+    return (time_t)(days * 86400 + tm->tm_hour * 3600 + tm->tm_min * 60 + tm->tm_sec);
+}
+
+/**
+ * Parse a LibreLinkUp timestamp ("5/21/2022 3:38:50 PM")
+ * @param utc The timestamp is UTC rather than local time (TZ)
+ * @param tm Output broken-down time (24-hour clock)
+ * @return Seconds since the epoch, 0 if unparseable
+ */
+static time_t parse_libre_time(const char *timestamp, bool utc, struct tm *tm)
+{
+    memset(tm, 0, sizeof(*tm));
+    if (!timestamp) {
+        return 0;
+    }
+
+    int year, month, day, hour, minute, second;
+    char ampm[3];
+    if (sscanf(timestamp, "%d/%d/%d %d:%d:%d %2s", &month, &day, &year, &hour, &minute, &second, ampm) != 7) {
+        return 0;
+    }
+    // Convert 12-hour to 24-hour format
+    if (strcmp(ampm, "PM") == 0 && hour != 12) {
+        hour += 12;
+    } else if (strcmp(ampm, "AM") == 0 && hour == 12) {
+        hour = 0;
+    }
+
+    tm->tm_mday = day;
+    tm->tm_mon = month - 1;  // months are 0-11
+    tm->tm_year = year - 1900;  // years since 1900
+    tm->tm_hour = hour;
+    tm->tm_min = minute;
+    tm->tm_sec = second;
+    tm->tm_isdst = -1;  // Let mktime determine DST
+
+    if (utc) {
+        return utc_to_epoch(tm);
+    }
+    struct tm scratch = *tm;  // mktime normalizes its argument
+    time_t t = mktime(&scratch);
+    return t == (time_t)-1 ? 0 : t;
+}
+
+/**
+ * Get the time of a measurement object
+ * "Timestamp" is the sensor's local time and "FactoryTimestamp" the same
+ * moment in UTC, so the epoch time comes from the latter when present.
+ * @param tm Output local time for display (may be NULL; tm_year is 0 if unknown)
+ * @return Seconds since the epoch, 0 if unknown
+ */
+static time_t parse_measurement_time(const cJSON *measurement, struct tm *tm)
+{
+    const cJSON *local = cJSON_GetObjectItem(measurement, "Timestamp");
+    const cJSON *utc = cJSON_GetObjectItem(measurement, "FactoryTimestamp");
+    struct tm scratch;
+
+    time_t local_time = parse_libre_time(cJSON_GetStringValue(local), false, tm ? tm : &scratch);
+    time_t utc_time = parse_libre_time(cJSON_GetStringValue(utc), true, &scratch);
+    return utc_time ? utc_time : local_time;
+}
+
+/**
+ * Parse the graphData array of a /graph response into the display cache
+ */
+static void parse_graph_data(const char *body)
+{
+    const char *graph_key = "\"graphData\":";
+    const char *graph_start = strstr(body, graph_key);
+    if (!graph_start) {
+        return;
+    }
+    graph_start += strlen(graph_key);
+    // Skip whitespace and opening bracket
+    while (*graph_start && (*graph_start == ' ' || *graph_start == '\n' || *graph_start == '\t')) graph_start++;
+    if (*graph_start != '[') {
+        return;
+    }
+    graph_start++;
+
+    // Parse into a scratch copy so the display never sees a half-filled graph
+    libre_graph_data_t *graph = calloc(1, sizeof(libre_graph_data_t));
+    if (!graph) {
+        return;
+    }
+
+    // Parse array items one by one
+    const char *item_start = graph_start;
+    while (graph->count < MAX_GRAPH_POINTS && *item_start) {
+        // Skip to next object
+        while (*item_start && *item_start != '{') item_start++;
+        if (*item_start != '{') break;
+
+        // Find end of object
+        int braces = 0;
+        const char *item_end = item_start;
+        bool in_str = false;
+        while (*item_end) {
+            if (*item_end == '"' && (item_end == item_start || *(item_end-1) != '\\')) in_str = !in_str;
+            if (!in_str) {
+                if (*item_end == '{') braces++;
+                else if (*item_end == '}') {
+                    braces--;
+                    if (braces == 0) break;
+                }
+            }
+            item_end++;
+        }
+
+        if (braces == 0 && *item_end == '}') {
+            item_end++;
+            size_t item_len = item_end - item_start;
+            char item_json[256];
+            if (item_len < sizeof(item_json)) {
+                memcpy(item_json, item_start, item_len);
+                item_json[item_len] = '\0';
+
+                cJSON *item = cJSON_Parse(item_json);
+                if (item) {
+                    cJSON *val = cJSON_GetObjectItem(item, "ValueInMgPerDl");
+                    cJSON *color = cJSON_GetObjectItem(item, "MeasurementColor");
+                    if (val && val->type == cJSON_Number) {
+                        graph->points[graph->count].value_mmol = val->valueint / 18.0f;
+                        graph->points[graph->count].value_mgdl = val->valueint;
+                        graph->points[graph->count].measurement_color =
+                            (color && color->type == cJSON_Number) ? color->valueint : 1;
+                        graph->points[graph->count].unix_time = parse_measurement_time(item, NULL);
+                        graph->count++;
+                    }
+                    cJSON_Delete(item);
+                }
+            }
+            item_start = item_end;
+        } else {
+            break;
+        }
+    }
+    ESP_LOGI(TAG, "Parsed %d graph data points", graph->count);
+
+    xSemaphoreTake(graph_mutex, portMAX_DELAY);
+    memcpy(&cached_graph_data, graph, sizeof(cached_graph_data));
+    xSemaphoreGive(graph_mutex);
+    free(graph);
+}
+
+/**
+ * Parse the glucoseMeasurement object of a /graph response
+ */
+static esp_err_t parse_glucose_measurement(const char *body, libre_glucose_data_t *glucose_data)
 {
+    esp_err_t ret = ESP_FAIL;
+
+    // The /graph endpoint returns a lot of data (~11KB) which can cause cJSON to run out of memory
+    // We only need the glucoseMeasurement field, so let's extract just that portion
+    const char *glucose_key = "\"glucoseMeasurement\":";
+    const char *glucose_start = strstr(body, glucose_key);
+    if (!glucose_start) {
+        ESP_LOGE(TAG, "glucoseMeasurement not found in response");
+        return ESP_FAIL;
+    }
+
+    glucose_start += strlen(glucose_key);
+    // Find the end of the glucoseMeasurement object (look for the matching closing brace)
+    int brace_count = 0;
+    const char *glucose_end = glucose_start;
+    bool in_string = false;
+    bool escape_next = false;
+
+    while (*glucose_end) {
+        if (escape_next) {
+            escape_next = false;
+        } else if (*glucose_end == '\\') {
+            escape_next = true;
+        } else if (*glucose_end == '"') {
+            in_string = !in_string;
+        } else if (!in_string) {
+            if (*glucose_end == '{') brace_count++;
+            else if (*glucose_end == '}') {
+                if (brace_count == 0) break;
+                brace_count--;
+            }
+        }
+        glucose_end++;
+    }
+
+    if (*glucose_end != '}') {
+        ESP_LOGE(TAG, "Could not find end of glucoseMeasurement object");
+        return ESP_FAIL;
+    }
+
+    glucose_end++; // Include the closing brace
+    size_t glucose_len = glucose_end - glucose_start;
+    char glucose_json[2048];
+
+    if (glucose_len >= sizeof(glucose_json)) {
+        ESP_LOGE(TAG, "glucoseMeasurement too large (%d bytes)", glucose_len);
+        return ESP_FAIL;
+    }
+
+    memcpy(glucose_json, glucose_start, glucose_len);
+    glucose_json[glucose_len] = '\0';
+
+    ESP_LOGI(TAG, "Extracted glucoseMeasurement JSON (%d bytes)", glucose_len);
+
+    // Parse just the glucoseMeasurement object
+    cJSON *glucose_measurement = cJSON_Parse(glucose_json);
+    if (!glucose_measurement) {
+        ESP_LOGE(TAG, "Failed to parse glucoseMeasurement JSON");
+        return ESP_FAIL;
+    }
+
+    // Extract glucose data
+    cJSON *value = cJSON_GetObjectItem(glucose_measurement, "ValueInMgPerDl");
+    cJSON *trend = cJSON_GetObjectItem(glucose_measurement, "TrendArrow");
+    cJSON *is_high = cJSON_GetObjectItem(glucose_measurement, "isHigh");
+    cJSON *is_low = cJSON_GetObjectItem(glucose_measurement, "isLow");
+    cJSON *timestamp = cJSON_GetObjectItem(glucose_measurement, "Timestamp");
+    cJSON *measurement_color = cJSON_GetObjectItem(glucose_measurement, "MeasurementColor");
+    cJSON *type = cJSON_GetObjectItem(glucose_measurement, "type");
+
+    // Log all values in one line
+    ESP_LOGI(TAG, "Glucose Data: Value=%d, Trend=%d, isHigh=%s, isLow=%s, Color=%d, Type=%d, Time=%s",
+        value && value->type == cJSON_Number ? value->valueint : -1,
+        trend && trend->type == cJSON_Number ? trend->valueint : -1,
+        is_high ? (cJSON_IsTrue(is_high) ? "true" : "false") : "NULL",
+        is_low ? (cJSON_IsTrue(is_low) ? "true" : "false") : "NULL",
+        measurement_color && measurement_color->type == cJSON_Number ? measurement_color->valueint : -1,
+        type && type->type == cJSON_Number ? type->valueint : -1,
+        timestamp && timestamp->valuestring ? timestamp->valuestring : "NULL");
+
+    if (value && trend) {
+        glucose_data->value_mgdl = value->valueint;
+        glucose_data->value_mmol = value->valueint / 18.0;
+        glucose_data->trend = (libre_trend_t)trend->valueint;
+        glucose_data->is_high = is_high ? cJSON_IsTrue(is_high) : false;
+        glucose_data->is_low = is_low ? cJSON_IsTrue(is_low) : false;
+        glucose_data->measurement_color = measurement_color ? measurement_color->valueint : 0;
+        glucose_data->type = type ? type->valueint : 0;
+
+        struct tm tm;
+        glucose_data->unix_time = parse_measurement_time(glucose_measurement, &tm);
+        if (tm.tm_year) {
+            // Format as dd/mm/yyyy HH:MM:SS
+            snprintf(glucose_data->timestamp, sizeof(glucose_data->timestamp), "%02d/%02d/%d %02d:%02d:%02d",
+                     tm.tm_mday, tm.tm_mon + 1, tm.tm_year + 1900, tm.tm_hour, tm.tm_min, tm.tm_sec);
+        } else {
+            strncpy(glucose_data->timestamp, "Unknown", sizeof(glucose_data->timestamp) - 1);
+        }
+
+        ret = ESP_OK;
+        ESP_LOGI(TAG, "Glucose: %d mg/dL, Trend: %d, High: %d, Low: %d",
+                 glucose_data->value_mgdl, glucose_data->trend,
+                 glucose_data->is_high, glucose_data->is_low);
+    } else {
+        ESP_LOGE(TAG, "Missing required glucose fields (value or trend)");
+    }
+    cJSON_Delete(glucose_measurement);
+    return ret;
+}
+
+esp_err_t librelinkup_get_glucose(librelinkup_client_t *client, const char *patient_id, libre_glucose_data_t *glucose_data)
+{
+    if (!patient_id || !glucose_data) {
+        return ESP_ERR_INVALID_ARG;
+    }
 #if DEMO_MODE_ENABLED
     ESP_LOGI(TAG, "[DEMO MODE] Returning dummy glucose data");
     // Dummy data from https://gist.github.com/khskekec/6c13ba01b10d3018d816706a32ae8ab2
@@ -566,264 +1130,84 @@ esp_err_t librelinkup_get_glucose(const char *patient_id, libre_glucose_data_t *
     strncpy(glucose_data->timestamp, "2023-03-01T12:34:56.000Z", sizeof(glucose_data->timestamp) - 1);
     return ESP_OK;
 #else
-    if (!logged_in) {
-        ESP_LOGE(TAG, "Not logged in");
-        return ESP_ERR_INVALID_STATE;
-    }
-    
-    if (!patient_id || !glucose_data) {
+    if (!client) {
         return ESP_ERR_INVALID_ARG;
     }
-    
-    esp_err_t ret = ESP_FAIL;
-    
+
+    libre_session_t session;
+    esp_err_t ret = session_snapshot(client, &session);
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
     ESP_LOGI(TAG, "Getting glucose data for patient: %s", patient_id);
-    
-    // Reset response buffer
-    http_response_len = 0;
-    memset(http_response, 0, sizeof(http_response));
-    
-    // Configure HTTP client
+
     char url[192];
-    snprintf(url, sizeof(url), "%s/llu/connections/%s/graph", api_url, patient_id);
-    
-    ESP_LOGI(TAG, "Calling API: %s", url);
-    
-    esp_http_client_config_t config = {
-        .url = url,
+    snprintf(url, sizeof(url), "%s/llu/connections/%s/graph", session.api_url, patient_id);
+    libre_request_t request = {
         .method = HTTP_METHOD_GET,
-        .event_handler = http_event_handler,
-        .timeout_ms = 10000,
-        .crt_bundle_attach = esp_crt_bundle_attach,
-        .buffer_size_tx = 2048,
+        .url = url,
+        .auth_header = session.auth_header,
+        .account_id = session.account_id,
     };
-    
-    esp_http_client_handle_t client = esp_http_client_init(&config);
-    
-    // Set headers
-    char auth_header[600];
-    snprintf(auth_header, sizeof(auth_header), "Bearer %s", auth_token);
-    esp_http_client_set_header(client, "Authorization", auth_header);
-    esp_http_client_set_header(client, "Account-Id", account_id);
-    esp_http_client_set_header(client, "Content-Type", "application/json");
-    esp_http_client_set_header(client, "product", "llu.android");
-    esp_http_client_set_header(client, "version", "4.16.0");
-    esp_http_client_set_header(client, "Cache-Control", "no-cache");
-    
-    // Perform request with retry logic for DNS failures
-    esp_err_t err = http_client_perform_with_retry(client, 3);
-    
-    if (err == ESP_OK) {
-        int status_code = esp_http_client_get_status_code(client);
-        ESP_LOGI(TAG, "HTTP Status: %d, Response length: %d", status_code, http_response_len);
-        
-        if (status_code == 200) {
-            // The /graph endpoint returns a lot of data (~11KB) which can cause cJSON to run out of memory
-            // We only need the glucoseMeasurement field, so let's extract just that portion
-            const char *glucose_key = "\"glucoseMeasurement\":";
-            char *glucose_start = strstr(http_response, glucose_key);
-            
-            if (glucose_start) {
-                glucose_start += strlen(glucose_key);
-                // Find the end of the glucoseMeasurement object (look for the matching closing brace)
-                int brace_count = 0;
-                char *glucose_end = glucose_start;
-                bool in_string = false;
-                bool escape_next = false;
-                
-                while (*glucose_end) {
-                    if (escape_next) {
-                        escape_next = false;
-                    } else if (*glucose_end == '\\') {
-                        escape_next = true;
-                    } else if (*glucose_end == '"') {
-                        in_string = !in_string;
-                    } else if (!in_string) {
-                        if (*glucose_end == '{') brace_count++;
-                        else if (*glucose_end == '}') {
-                            if (brace_count == 0) break;
-                            brace_count--;
-                        }
-                    }
-                    glucose_end++;
-                }
-                
-                if (*glucose_end == '}') {
-                    glucose_end++; // Include the closing brace
-                    size_t glucose_len = glucose_end - glucose_start;
-                    char glucose_json[2048];
-                    
-                    if (glucose_len < sizeof(glucose_json)) {
-                        memcpy(glucose_json, glucose_start, glucose_len);
-                        glucose_json[glucose_len] = '\0';
-                        
-                        ESP_LOGI(TAG, "Extracted glucoseMeasurement JSON (%d bytes)", glucose_len);
-                        
-                        // Parse just the glucoseMeasurement object
-                        cJSON *glucose_measurement = cJSON_Parse(glucose_json);
-                        if (glucose_measurement) {
-                            // Extract glucose data
-                            cJSON *value = cJSON_GetObjectItem(glucose_measurement, "ValueInMgPerDl");
-                            cJSON *trend = cJSON_GetObjectItem(glucose_measurement, "TrendArrow");
-                            cJSON *is_high = cJSON_GetObjectItem(glucose_measurement, "isHigh");
-                            cJSON *is_low = cJSON_GetObjectItem(glucose_measurement, "isLow");
-                            cJSON *timestamp = cJSON_GetObjectItem(glucose_measurement, "Timestamp");
-                            cJSON *measurement_color = cJSON_GetObjectItem(glucose_measurement, "MeasurementColor");
-                            cJSON *type = cJSON_GetObjectItem(glucose_measurement, "type");
-                            
-                            // Log all values in one line
-                            ESP_LOGI(TAG, "Glucose Data: Value=%d, Trend=%d, isHigh=%s, isLow=%s, Color=%d, Type=%d, Time=%s",
-                                value && value->type == cJSON_Number ? value->valueint : -1,
-                                trend && trend->type == cJSON_Number ? trend->valueint : -1,
-                                is_high ? (cJSON_IsTrue(is_high) ? "true" : "false") : "NULL",
-                                is_low ? (cJSON_IsTrue(is_low) ? "true" : "false") : "NULL",
-                                measurement_color && measurement_color->type == cJSON_Number ? measurement_color->valueint : -1,
-                                type && type->type == cJSON_Number ? type->valueint : -1,
-                                timestamp && timestamp->valuestring ? timestamp->valuestring : "NULL");
-                            
-                            if (value && trend) {
-                                glucose_data->value_mgdl = value->valueint;
-                                glucose_data->value_mmol = value->valueint / 18.0;
-                                glucose_data->trend = (libre_trend_t)trend->valueint;
-                                glucose_data->is_high = is_high ? cJSON_IsTrue(is_high) : false;
-                                glucose_data->is_low = is_low ? cJSON_IsTrue(is_low) : false;
-                                glucose_data->measurement_color = measurement_color ? measurement_color->valueint : 0;
-                                glucose_data->type = type ? type->valueint : 0;
-                                
-                                if (timestamp && timestamp->valuestring) {
-                                    // Parse timestamp format: "5/21/2022 3:38:50 PM" and convert to dd/mm/yyyy HH:MM:SS
-                                    int year, month, day, hour, minute, second;
-                                    char ampm[3];
-                                    if (sscanf(timestamp->valuestring, "%d/%d/%d %d:%d:%d %2s", &month, &day, &year, &hour, &minute, &second, ampm) == 7) {
-                                        // Convert 12-hour to 24-hour format
-                                        if (strcmp(ampm, "PM") == 0 && hour != 12) {
-                                            hour += 12;
-                                        } else if (strcmp(ampm, "AM") == 0 && hour == 12) {
-                                            hour = 0;
-                                        }
-                                        // Format as dd/mm/yyyy HH:MM:SS
-                                        snprintf(glucose_data->timestamp, sizeof(glucose_data->timestamp), "%02d/%02d/%d %02d:%02d:%02d", day, month, year, hour, minute, second);
-                                    } else {
-                                        strncpy(glucose_data->timestamp, "Unknown", sizeof(glucose_data->timestamp) - 1);
-                                    }
-                                } else {
-                                    strncpy(glucose_data->timestamp, "Unknown", sizeof(glucose_data->timestamp) - 1);
-                                }
-                                
-                                ret = ESP_OK;
-                                ESP_LOGI(TAG, "Glucose: %d mg/dL, Trend: %d, High: %d, Low: %d",
-                                         glucose_data->value_mgdl, glucose_data->trend,
-                                         glucose_data->is_high, glucose_data->is_low);
-                                
-                                // Parse graphData array for historical values
-                                const char *graph_key = "\"graphData\":";
-                                char *graph_start = strstr(http_response, graph_key);
-                                if (graph_start) {
-                                    graph_start += strlen(graph_key);
-                                    // Skip whitespace and opening bracket
-                                    while (*graph_start && (*graph_start == ' ' || *graph_start == '\n' || *graph_start == '\t')) graph_start++;
-                                    if (*graph_start == '[') {
-                                        graph_start++;
-                                        cached_graph_data.count = 0;
-                                        
-                                        // Parse array items one by one
-                                        char *item_start = graph_start;
-                                        while (cached_graph_data.count < MAX_GRAPH_POINTS && *item_start) {
-                                            // Skip to next object
-                                            while (*item_start && *item_start != '{') item_start++;
-                                            if (*item_start != '{') break;
-                                            
-                                            // Find end of object
-                                            int braces = 0;
-                                            char *item_end = item_start;
-                                            bool in_str = false;
-                                            while (*item_end) {
-                                                if (*item_end == '"' && (item_end == item_start || *(item_end-1) != '\\')) in_str = !in_str;
-                                                if (!in_str) {
-                                                    if (*item_end == '{') braces++;
-                                                    else if (*item_end == '}') {
-                                                        braces--;
-                                                        if (braces == 0) break;
-                                                    }
-                                                }
-                                                item_end++;
-                                            }
-                                            
-                                            if (braces == 0 && *item_end == '}') {
-                                                item_end++;
-                                                size_t item_len = item_end - item_start;
-                                                char item_json[256];
-                                                if (item_len < sizeof(item_json)) {
-                                                    memcpy(item_json, item_start, item_len);
-                                                    item_json[item_len] = '\0';
-                                                    
-                                                    cJSON *item = cJSON_Parse(item_json);
-                                                    if (item) {
-                                                        cJSON *val = cJSON_GetObjectItem(item, "ValueInMgPerDl");
-                                                        cJSON *color = cJSON_GetObjectItem(item, "MeasurementColor");
-                                                        if (val && val->type == cJSON_Number) {
-                                                            cached_graph_data.points[cached_graph_data.count].value_mmol = val->valueint / 18.0f;
-                                                            cached_graph_data.points[cached_graph_data.count].measurement_color = 
-                                                                (color && color->type == cJSON_Number) ? color->valueint : 1;
-                                                            cached_graph_data.count++;
-                                                        }
-                                                        cJSON_Delete(item);
-                                                    }
-                                                }
-                                                item_start = item_end;
-                                            } else {
-                                                break;
-                                            }
-                                        }
-                                        ESP_LOGI(TAG, "Parsed %d graph data points", cached_graph_data.count);
-                                    }
-                                }
-                            } else {
-                                ESP_LOGE(TAG, "Missing required glucose fields (value or trend)");
-                            }
-                            cJSON_Delete(glucose_measurement);
-                        } else {
-                            ESP_LOGE(TAG, "Failed to parse glucoseMeasurement JSON");
-                        }
-                    } else {
-                        ESP_LOGE(TAG, "glucoseMeasurement too large (%d bytes)", glucose_len);
-                    }
-                } else {
-                    ESP_LOGE(TAG, "Could not find end of glucoseMeasurement object");
-                }
-            } else {
-                ESP_LOGE(TAG, "glucoseMeasurement not found in response");
-            }
-        } else if (status_code == 401) {
-            ESP_LOGE(TAG, "Authentication failed (401) - token may be expired");
-            ret = ESP_ERR_LIBRE_AUTH_FAILED;
+
+    int status_code = 0;
+    libre_response_t response;
+    esp_err_t err = libre_dispatch(&request, &status_code, &response);
+    ret = ESP_FAIL;
+
+    if (err == ESP_OK && status_code == 401) {
+        session_rejected(client, &session);
+        ret = ESP_ERR_LIBRE_AUTH_FAILED;
+    }
+    session_release(&session);
+
+    if (err == ESP_OK && status_code == 200) {
+        ret = parse_glucose_measurement(response.data, glucose_data);
+        if (ret == ESP_OK) {
+            // Parse graphData array for historical values
+            parse_graph_data(response.data);
         }
     }
-    
-    esp_http_client_cleanup(client);
+
+    response_free(&response);
     return ret;
 #endif
 }
 
-bool librelinkup_is_logged_in(void)
+bool librelinkup_is_logged_in(librelinkup_client_t *client)
 {
+    if (!client) {
+        return false;
+    }
+    xSemaphoreTake(client->mutex, portMAX_DELAY);
+    bool logged_in = client->logged_in;
+    xSemaphoreGive(client->mutex);
     return logged_in;
 }
 
-void librelinkup_logout(void)
+void librelinkup_logout(librelinkup_client_t *client)
 {
-    memset(auth_token, 0, sizeof(auth_token));
-    memset(account_id, 0, sizeof(account_id));
-    logged_in = false;
-    
+    if (!client) {
+        return;
+    }
+
+    xSemaphoreTake(client->mutex, portMAX_DELAY);
+    memset(client->auth_token, 0, sizeof(client->auth_token));
+    memset(client->account_id, 0, sizeof(client->account_id));
+    client->logged_in = false;
+    bool persist = client->persist;
+    xSemaphoreGive(client->mutex);
+
+    if (!persist) {
+        ESP_LOGI(TAG, "Logged out");
+        return;
+    }
+
     // Clear auth token from NVS
-    nvs_handle_t nvs_handle;
-    esp_err_t err = nvs_open("storage", NVS_READWRITE, &nvs_handle);
-    if (err == ESP_OK) {
-        nvs_erase_key(nvs_handle, "auth_token");
-        nvs_erase_key(nvs_handle, "account_id");
-        nvs_commit(nvs_handle);
-        nvs_close(nvs_handle);
+    nvs_journal_erase(LIBRE_NVS_NAMESPACE, "auth_token");
+    nvs_journal_erase(LIBRE_NVS_NAMESPACE, "account_id");
+    if (nvs_journal_flush() == ESP_OK) {
         ESP_LOGI(TAG, "Logged out and cleared saved auth token");
     } else {
         ESP_LOGI(TAG, "Logged out");
@@ -859,11 +1243,38 @@ esp_err_t librelinkup_get_graph_data(libre_graph_data_t *graph_data)
     if (!graph_data) {
         return ESP_ERR_INVALID_ARG;
     }
-    
-    if (cached_graph_data.count == 0) {
-        return ESP_ERR_NOT_FOUND;
+
+    dispatcher_init();
+    xSemaphoreTake(graph_mutex, portMAX_DELAY);
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+    if (cached_graph_data.count > 0) {
+        memcpy(graph_data, &cached_graph_data, sizeof(libre_graph_data_t));
+        ret = ESP_OK;
     }
-    
-    memcpy(graph_data, &cached_graph_data, sizeof(libre_graph_data_t));
-    return ESP_OK;
+    xSemaphoreGive(graph_mutex);
+    return ret;
+}
+
+void librelinkup_set_graph_data(const libre_graph_data_t *graph_data)
+{
+    if (!graph_data) {
+        return;
+    }
+
+    dispatcher_init();
+    xSemaphoreTake(graph_mutex, portMAX_DELAY);
+    memcpy(&cached_graph_data, graph_data, sizeof(cached_graph_data));
+    xSemaphoreGive(graph_mutex);
+}
+
+const libre_graph_data_t* librelinkup_lock_graph_data(void)
+{
+    dispatcher_init();
+    xSemaphoreTake(graph_mutex, portMAX_DELAY);
+    return &cached_graph_data;
+}
+
+void librelinkup_unlock_graph_data(void)
+{
+    xSemaphoreGive(graph_mutex);
 }
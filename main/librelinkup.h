@@ -9,6 +9,8 @@
 
 #include "esp_err.h"
 #include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
 
 // Custom error codes (using custom base 0x6000 for application-specific errors)
 #define ESP_ERR_LIBRE_RATE_LIMITED    0x6001  // Rate limited (429)
@@ -36,6 +38,7 @@ typedef struct {
     bool is_high;            // High glucose flag
     bool is_low;             // Low glucose flag
     char timestamp[32];      // Timestamp string
+    time_t unix_time;        // Timestamp as seconds since the epoch, 0 if unknown
     int measurement_color;   // Measurement color (1=normal, 2=high, 0=low)
     int type;                // Measurement type
 } libre_glucose_data_t;
@@ -43,7 +46,9 @@ typedef struct {
 // Single graph data point
 typedef struct {
     float value_mmol;        // Glucose value in mmol/L
+    int value_mgdl;          // Glucose value in mg/dL
     int measurement_color;   // Color indicator
+    time_t unix_time;        // Measurement time, 0 if unknown
 } libre_graph_point_t;
 
 // Graph data (last 12 hours, ~144 points at 5min intervals)
@@ -54,18 +59,40 @@ typedef struct {
 } libre_graph_data_t;
 
 /**
- * Initialize LibreLinkUp client
+ * Client handle
+ * Each handle holds its own session (server, token, account id), so
+ * independent users (the glucose task, web portal jobs) never share or
+ * overwrite each other's login. All functions may be called from any
+ * task. Network round trips are serialized internally so only one TLS
+ * session exists at a time, and identical GET requests in flight (same
+ * URL and session) are answered by one round trip.
+ */
+typedef struct librelinkup_client librelinkup_client_t;
+
+/**
+ * Create a client
  * @param use_eu_server Set true to use EU server, false for global
+ * @param persist_session Restore the saved session (token, regional URL)
+ *        from NVS and save it again after login. Only the device's own
+ *        client should persist; temporary clients leave NVS untouched.
+ * @return Client handle, NULL if out of memory
  */
-esp_err_t librelinkup_init(bool use_eu_server);
+librelinkup_client_t* librelinkup_client_create(bool use_eu_server, bool persist_session);
+
+/**
+ * Destroy a client and wipe its session from memory
+ * Does not log out or touch NVS. The client must not be in use.
+ */
+void librelinkup_client_destroy(librelinkup_client_t *client);
 
 /**
  * Login to LibreLinkUp and obtain authentication token
+ * @param client Client handle
  * @param email User email address
  * @param password User password
  * @return ESP_OK on success
  */
-esp_err_t librelinkup_login(const char *email, const char *password);
+esp_err_t librelinkup_login(librelinkup_client_t *client, const char *email, const char *password);
 
 /**
  * Get graph data from last glucose fetch
@@ -74,41 +101,68 @@ esp_err_t librelinkup_login(const char *email, const char *password);
  */
 esp_err_t librelinkup_get_graph_data(libre_graph_data_t *graph_data);
 
+/**
+ * Replace the cached graph data
+ * For monitors that receive the graph from another monitor (lan_share.h)
+ * instead of fetching it.
+ * @param graph_data New graph data
+ */
+void librelinkup_set_graph_data(const libre_graph_data_t *graph_data);
+
+/**
+ * Lock the graph cache for reading it in place
+ * Every graph update waits until librelinkup_unlock_graph_data().
+ * @return Cached graph data (count 0 if none yet)
+ */
+const libre_graph_data_t* librelinkup_lock_graph_data(void);
+
+/**
+ * Release the lock taken by librelinkup_lock_graph_data()
+ */
+void librelinkup_unlock_graph_data(void);
+
 /**
  * Get the first patient ID from connections
  * This is typically used when following one person's glucose data
+ * @param client Client handle
  * @param patient_id Output buffer for patient ID (min 64 bytes)
  * @return ESP_OK on success
  */
-esp_err_t librelinkup_get_patient_id(char *patient_id, size_t patient_id_len);
+esp_err_t librelinkup_get_patient_id(librelinkup_client_t *client, char *patient_id, size_t patient_id_len);
 
 /**
  * Get connections list as JSON for web interface
  * Returns: {"success":true,"patients":[{"id":"abc","name":"John Doe"},...]}
+ * @param client Client handle
  * @param json_buffer Output buffer for JSON string
  * @param buffer_size Size of output buffer
  * @return ESP_OK on success
  */
-esp_err_t librelinkup_get_connections_json(char *json_buffer, size_t buffer_size);
+esp_err_t librelinkup_get_connections_json(librelinkup_client_t *client, char *json_buffer, size_t buffer_size);
 
 /**
  * Get latest glucose reading for a patient
+ * A 401 response marks the client as logged out.
+ * @param client Client handle
  * @param patient_id Patient ID from librelinkup_get_patient_id()
  * @param glucose_data Output structure for glucose data
- * @return ESP_OK on success
+ * @return ESP_OK on success, ESP_ERR_LIBRE_AUTH_FAILED if the token was rejected
  */
-esp_err_t librelinkup_get_glucose(const char *patient_id, libre_glucose_data_t *glucose_data);
+esp_err_t librelinkup_get_glucose(librelinkup_client_t *client, const char *patient_id, libre_glucose_data_t *glucose_data);
 
 /**
  * Check if currently logged in
+ * @param client Client handle
  * @return true if logged in with valid token
  */
-bool librelinkup_is_logged_in(void);
+bool librelinkup_is_logged_in(librelinkup_client_t *client);
 
 /**
  * Logout and clear authentication token
+ * A persistent client also clears the saved token from NVS.
+ * @param client Client handle
  */
-void librelinkup_logout(void);
+void librelinkup_logout(librelinkup_client_t *client);
 
 /**
  * Get trend arrow as string for display
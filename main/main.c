@@ -6,8 +6,10 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <math.h>
 #include <sys/time.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
@@ -17,12 +19,22 @@
 #include "nvs_flash.h"
 #include "config.h"
 #include "display.h"
+#include "display_power.h"
 #include "wifi_manager.h"
 #include "librelinkup.h"
 #include "libre_credentials.h"
 #include "global_settings.h"
 #include "ir_transmitter.h"
+#include "ir_learning.h"
 #include "ota_update.h"
+#include "nvs_journal.h"
+#include "glucose_events.h"
+#include "glucose_api.h"
+#include "nightscout.h"
+#include "mqtt_publisher.h"
+#include "lan_share.h"
+#include "power.h"
+#include "assets.h"
 #include "bsp/esp-bsp.h"
 #include "iot_button.h"
 #include "esp_codec_dev.h"
@@ -33,22 +45,25 @@ static const char *TAG = "GLUCOSE_MONITOR";
 static bool wifi_ready = false;
 static bool setup_in_progress = false;
 static bool settings_shown = false;
-static volatile bool ota_check_complete = false;
 static volatile bool ota_in_progress = false;  // Prevents glucose updates during OTA
+static volatile bool first_reading_done = false;  // The boot OTA check waits for it
 
 // LibreLink/Glucose tracking
 static bool libre_logged_in = false;
 static char libre_patient_id[64] = {0};
 static libre_glucose_data_t current_glucose = {0};
+static TaskHandle_t glucose_task_handle = NULL;  // Notified to fetch early
 
 // Alarm state tracking (non-static so display.c can access alarm_active)
 volatile bool alarm_active = false;
 static volatile bool alarm_snoozed = false;
 static volatile int64_t alarm_snooze_until = 0;  // Timestamp in microseconds
 
-// Embedded alarm audio
-extern const uint8_t ahs_hypo_wav_start[] asm("_binary_ahs_hypo_wav_start");
-extern const uint8_t ahs_hypo_wav_end[] asm("_binary_ahs_hypo_wav_end");
+// Alarm beep used when the assets pack (and its alarm WAV) is missing
+#define ALARM_TONE_RATE     16000
+#define ALARM_TONE_HZ       1000
+#define ALARM_TONE_ON_MS    400
+#define ALARM_TONE_OFF_MS   200
 extern esp_codec_dev_handle_t display_get_audio_codec(void);  // From display.c
 
 // Forward declarations
@@ -62,6 +77,7 @@ static void on_about_back_button(void);
 static void on_configure_button(void);
 static void red_button_handler(void *arg, void *data);
 static void mute_button_handler(void *arg, void *data);
+static void button_wake_handler(void *arg, void *data);
 static void alarm_task(void *pvParameters);
 static void on_ota_proceed(void);
 static void on_ota_cancel(void);
@@ -69,12 +85,9 @@ static void ota_progress_callback(int progress_percent, const char *message);
 static void check_for_ota_update(void);
 static bool is_glucose_data_stale(const char *timestamp);
 
-// Mute button handler - snooze alarm
-static void mute_button_handler(void *arg, void *data) {
-    ESP_LOGI(TAG, "MUTE BUTTON PRESSED");
-    
+// Snooze the alarm if it is sounding (mute button or MQTT command)
+static void snooze_alarm(void) {
     if (alarm_active && !alarm_snoozed) {
-        // Snooze the alarm
         global_settings_t settings;
         global_settings_load(&settings);
         
@@ -83,7 +96,93 @@ static void mute_button_handler(void *arg, void *data) {
         alarm_snoozed = true;
         
         ESP_LOGI(TAG, "Alarm snoozed for %lu minutes", settings.alarm_snooze_minutes);
+        glucose_events_publish_alarm(true, true);
+        mqtt_publisher_publish_alarm(true, true);
+    }
+}
+
+// Set when a red button press only woke the screen; its click is dropped
+static volatile bool red_press_woke = false;
+
+// Any button press (on press down, before the click is recognised) wakes the screen
+// data: flag to note whether the press only woke it, or NULL
+static void button_wake_handler(void *arg, void *data) {
+    bool was_off = display_power_wake();
+    volatile bool *woke = data;
+    if (woke) {
+        *woke = was_off;
+    }
+}
+
+// Mute button handler - snooze alarm (also when the press woke the screen)
+static void mute_button_handler(void *arg, void *data) {
+    ESP_LOGI(TAG, "MUTE BUTTON PRESSED");
+    snooze_alarm();
+}
+
+// Commands from the MQTT broker (runs on the MQTT task)
+static void on_mqtt_command(mqtt_command_t command, int arg) {
+    switch (command) {
+        case MQTT_CMD_SNOOZE:
+            snooze_alarm();
+            break;
+        case MQTT_CMD_REFRESH:
+            if (glucose_task_handle) {
+                xTaskNotifyGive(glucose_task_handle);
+            }
+            break;
+        case MQTT_CMD_LAMP_COLOR:
+            // Holds until the next reading sets the lamp again
+            if (global_settings_is_moon_lamp_enabled()) {
+                ir_transmitter_set_moon_lamp_color(arg);
+            }
+            break;
+    }
+}
+
+/**
+ * Get the alarm sound as 16-bit PCM
+ * Uses ahs_hypo.wav from the assets partition, or a synthesized beep so
+ * the alarm is never silent (also while a media update rewrites the
+ * partition).
+ * @param[out] from_assets The sound is an asset: assets_release() after playing it
+ */
+static bool get_alarm_sound(const uint8_t **pcm, size_t *pcm_size, uint32_t *sample_rate, uint16_t *channels,
+                            bool *from_assets) {
+    static int16_t *tone = NULL;
+    const uint8_t *wav = NULL;
+    size_t wav_size = 0;
+    
+    *from_assets = false;
+    if (assets_get("ahs_hypo.wav", &wav, &wav_size)) {
+        if (wav_size > 44) {
+            *channels = *((uint16_t*)(wav + 22));
+            *sample_rate = *((uint32_t*)(wav + 24));
+            *pcm = wav + 44;
+            *pcm_size = wav_size - 44;
+            *from_assets = true;
+            return true;
+        }
+        assets_release();
     }
+    
+    size_t on = ALARM_TONE_RATE * ALARM_TONE_ON_MS / 1000;
+    size_t total = on + ALARM_TONE_RATE * ALARM_TONE_OFF_MS / 1000;
+    if (tone == NULL) {
+        tone = calloc(total, sizeof(int16_t));
+        if (tone == NULL) {
+            return false;
+        }
+        for (size_t i = 0; i < on; i++) {
+            tone[i] = (int16_t)(12000.0f * sinf(2.0f * (float)M_PI * ALARM_TONE_HZ * i / ALARM_TONE_RATE));
+        }
+        ESP_LOGW(TAG, "Alarm sound missing from assets, using a beep");
+    }
+    *channels = 1;
+    *sample_rate = ALARM_TONE_RATE;
+    *pcm = (const uint8_t *)tone;
+    *pcm_size = total * sizeof(int16_t);
+    return true;
 }
 
 // Alarm audio playback task
@@ -92,6 +191,8 @@ static void alarm_task(void *pvParameters) {
     
     esp_codec_dev_handle_t codec = NULL;
     bool codec_opened = false;
+    uint32_t opened_rate = 0;
+    uint16_t opened_channels = 0;
     
     while (1) {
         // Check if alarm should be active
@@ -104,6 +205,8 @@ static void alarm_task(void *pvParameters) {
                 if (now >= alarm_snooze_until) {
                     ESP_LOGI(TAG, "Snooze expired, alarm reactivating");
                     alarm_snoozed = false;
+                    glucose_events_publish_alarm(true, false);
+                    mqtt_publisher_publish_alarm(true, false);
                     should_alarm = true;
                 }
             } else {
@@ -117,32 +220,39 @@ static void alarm_task(void *pvParameters) {
                 codec = display_get_audio_codec();
             }
             
+            const uint8_t *pcm_data = NULL;
+            size_t pcm_size = 0;
+            uint32_t sample_rate = 0;
+            uint16_t channels = 0;
+            bool from_assets = false;
+            
             if (codec != NULL) {
-                size_t wav_size = ahs_hypo_wav_end - ahs_hypo_wav_start;
-                
-                if (wav_size > 44) {
-                    // Open codec only once when alarm starts
+                if (get_alarm_sound(&pcm_data, &pcm_size, &sample_rate, &channels, &from_assets)) {
+                    // Open codec only once when alarm starts (again if the
+                    // sound changed to or from the beep)
+                    if (codec_opened && (sample_rate != opened_rate || channels != opened_channels)) {
+                        esp_codec_dev_close(codec);
+                        codec_opened = false;
+                        power_lock_release(POWER_LOCK_AUDIO);
+                    }
                     if (!codec_opened) {
-                        uint16_t channels = *((uint16_t*)(ahs_hypo_wav_start + 22));
-                        uint32_t sample_rate = *((uint32_t*)(ahs_hypo_wav_start + 24));
-                        
                         esp_codec_dev_sample_info_t fs = {
                             .sample_rate = sample_rate,
                             .channel = channels,
                             .bits_per_sample = 16,
                         };
                         
+                        power_lock_acquire(POWER_LOCK_AUDIO);  // Held while the codec is open
                         esp_codec_dev_close(codec);  // Close any previous state
                         vTaskDelay(pdMS_TO_TICKS(100));  // Let codec settle
                         esp_codec_dev_open(codec, &fs);
                         esp_codec_dev_set_out_vol(codec, 70);  // Lower volume to 70 to reduce distortion
                         codec_opened = true;
+                        opened_rate = sample_rate;
+                        opened_channels = channels;
                         ESP_LOGI(TAG, "Alarm codec opened (sample_rate=%lu, channels=%d)", sample_rate, channels);
                     }
                     
-                    const uint8_t *pcm_data = ahs_hypo_wav_start + 44;
-                    size_t pcm_size = wav_size - 44;
-                    
                     // Write audio in chunks with small yields to prevent blocking
                     const size_t CHUNK_SIZE = 4096;  // 4KB chunks for better responsiveness
                     size_t total_written = 0;
@@ -162,6 +272,9 @@ static void alarm_task(void *pvParameters) {
                             vTaskDelay(pdMS_TO_TICKS(1));
                         }
                     }
+                    if (from_assets) {
+                        assets_release();  // A media update waits for this between loops
+                    }
                     
                     // Loop immediately without pause for continuous playback
                 } else {
@@ -175,6 +288,7 @@ static void alarm_task(void *pvParameters) {
             if (codec_opened) {
                 esp_codec_dev_close(codec);
                 codec_opened = false;
+                power_lock_release(POWER_LOCK_AUDIO);
                 ESP_LOGI(TAG, "Alarm codec closed");
             }
             // Not alarming, wait longer
@@ -227,6 +341,13 @@ static bool is_glucose_data_stale(const char *timestamp) {
     return true;
 }
 
+// Role change or a reading from the LAN leader: re-run the glucose loop now
+static void on_lan_share_event(void) {
+    if (glucose_task_handle) {
+        xTaskNotifyGive(glucose_task_handle);
+    }
+}
+
 // Callbacks for WiFi events
 static void on_wifi_connected(void) {
     wifi_ready = true;
@@ -234,10 +355,11 @@ static void on_wifi_connected(void) {
     const char *ip = wifi_manager_get_ip();
     ESP_LOGI(TAG, "WiFi Connected - SSID: %s, IP: %s", ssid, ip);
     
-    // Wait for DNS to be fully operational (especially important after OTA reboots)
-    // This prevents "getaddrinfo() returns 202" errors
-    ESP_LOGI(TAG, "Waiting for network stack to stabilize...");
-    vTaskDelay(pdMS_TO_TICKS(2000));
+    // No settling delay: DNS arrives with the lease, and the LibreLinkUp
+    // client retries "getaddrinfo() returns 202" with backoff if it is early
+    if (glucose_task_handle) {
+        xTaskNotifyGive(glucose_task_handle);
+    }
     
     // Initialize SNTP for time synchronization
     ESP_LOGI(TAG, "Initializing SNTP");
@@ -245,9 +367,11 @@ static void on_wifi_connected(void) {
     esp_sntp_setservername(0, "pool.ntp.org");
     esp_sntp_init();
     
-    // Set timezone to UTC (or adjust based on your needs)
-    setenv("TZ", "UTC0", 1);
-    tzset();
+    // Connect to the MQTT broker if one is configured (no-op after the first time)
+    mqtt_publisher_start();
+    
+    // Share one LibreLinkUp poll with other monitors on the LAN (no-op after the first time)
+    lan_share_start(on_lan_share_event);
     
     if (setup_in_progress) {
         // User is on setup screen - show Next button
@@ -344,6 +468,12 @@ static void on_setup_next_button(void) {
 
 // Red button handler - toggles settings
 static void red_button_handler(void *arg, void *data) {
+    if (red_press_woke) {
+        red_press_woke = false;
+        ESP_LOGI(TAG, "Red button woke the screen");
+        return;
+    }
+    
     ESP_LOGI(TAG, "========================================");
     ESP_LOGI(TAG, "RED BUTTON PRESSED - TOGGLE SETTINGS");
     ESP_LOGI(TAG, "========================================");
@@ -430,7 +560,6 @@ static void on_ota_proceed(void) {
         
         // Clear OTA flags and return to normal operation
         ota_in_progress = false;
-        ota_check_complete = true;
         
         // Return to glucose screen
         if (current_glucose.value_mmol > 0) {
@@ -452,7 +581,6 @@ static void on_ota_proceed(void) {
 static void on_ota_cancel(void) {
     ESP_LOGI(TAG, "User cancelled OTA update");
     ota_in_progress = false;  // Allow glucose updates again
-    ota_check_complete = true;  // Signal glucose fetch can proceed
     // Return to glucose display or appropriate screen
     if (DEMO_MODE_ENABLED) {
         display_show_glucose(current_glucose.value_mmol > 0 ? current_glucose.value_mmol : 6.7, 
@@ -485,7 +613,10 @@ static void ota_progress_callback(int progress_percent, const char *message) {
 }
 
 static void ota_check_task(void *pvParameters) {
-    vTaskDelay(pdMS_TO_TICKS(5000));  // Wait 5s after boot
+    // The first glucose reading goes first; no TLS session competes with it
+    for (int i = 0; i < 100 && !first_reading_done; i++) {
+        vTaskDelay(pdMS_TO_TICKS(100));
+    }
     check_for_ota_update();
     vTaskDelete(NULL);
 }
@@ -502,17 +633,83 @@ static void check_for_ota_update(void) {
     if (ret == ESP_OK) {
         ESP_LOGI(TAG, "OTA update available: %s -> %s", ota_get_current_version(), new_ota_version);
         // Show warning dialog to user
-        ota_in_progress = true;  // Block glucose updates
-        ota_check_complete = true;  // Check is complete, but wait for user decision
+        ota_in_progress = true;  // Block glucose updates until the user decides
         display_show_ota_warning(on_ota_proceed, on_ota_cancel);
     } else if (ret == ESP_ERR_NOT_FOUND) {
         ESP_LOGI(TAG, "Already running latest firmware version");
-        // Signal that OTA check is complete so glucose fetch can proceed
-        ota_check_complete = true;
     } else {
         ESP_LOGW(TAG, "Failed to check for OTA update: %s", esp_err_to_name(ret));
-        // Signal that OTA check is complete so glucose fetch can proceed
-        ota_check_complete = true;
+    }
+}
+
+// Alarm, LAN clients and display for a new reading in current_glucose
+static void process_glucose_reading(void) {
+    if (!first_reading_done) {
+        uint32_t boot_ms = (uint32_t)(esp_timer_get_time() / 1000);
+        ESP_LOGI(TAG, "First glucose reading %lu ms after boot (WiFi connected in %lu ms)",
+                 boot_ms, wifi_manager_get_connect_time_ms());
+        mqtt_publisher_set_first_reading_ms(boot_ms);
+        wifi_manager_set_first_reading_ms(boot_ms);
+        first_reading_done = true;
+    }
+    
+    // Check for threshold violations and manage alarm
+    global_settings_t settings;
+    global_settings_load(&settings);
+    
+    // Calculate thresholds locally (don't trust API's isLow/isHigh flags)
+    bool is_low_calculated = current_glucose.value_mmol < settings.glucose_low_threshold;
+    bool is_high_calculated = current_glucose.value_mmol > settings.glucose_high_threshold;
+    
+    // Check if alarm should be triggered based on individual low/high settings
+    bool should_alarm = settings.alarm_enabled && 
+                       ((is_low_calculated && settings.alarm_low_enabled) || 
+                        (is_high_calculated && settings.alarm_high_enabled));
+    
+    if (should_alarm) {
+        // Only activate alarm if not already active (don't reset snooze state on glucose refresh)
+        if (!alarm_active) {
+            // Start alarm
+            ESP_LOGW(TAG, "THRESHOLD VIOLATED - Starting alarm! (Low: %d, High: %d, Value: %.1f mmol/L)",
+                     is_low_calculated, is_high_calculated, current_glucose.value_mmol);
+            alarm_active = true;
+            alarm_snoozed = false;
+            display_power_set_alarm(true);
+        } else {
+            ESP_LOGD(TAG, "Threshold still violated, alarm continues (active: %d, snoozed: %d)", 
+                     alarm_active, alarm_snoozed);
+        }
+    } else {
+        // Glucose back in range or alarm disabled - stop alarm
+        if (alarm_active) {
+            ESP_LOGI(TAG, "Glucose back in range - Stopping alarm");
+            alarm_active = false;
+            alarm_snoozed = false;
+            display_power_set_alarm(false);
+        }
+    }
+    
+    // Check if data is stale (older than 5 minutes)
+    bool stale = is_glucose_data_stale(current_glucose.timestamp);
+    
+    // Push to LAN clients (/events, /api/v1/current, MQTT)
+    glucose_events_publish_reading(&current_glucose, is_low_calculated, is_high_calculated, stale);
+    glucose_api_set_current(&current_glucose, is_low_calculated, is_high_calculated);
+    glucose_events_publish_alarm(alarm_active, alarm_snoozed);
+    mqtt_publisher_publish_reading(&current_glucose, stale);
+    mqtt_publisher_publish_alarm(alarm_active, alarm_snoozed);
+    
+    // Update display if not in settings
+    if (!settings_shown && !setup_in_progress) {
+        if (stale) {
+            ESP_LOGW(TAG, "Glucose data is stale (older than 5 minutes): %s", current_glucose.timestamp);
+            display_show_no_recent_data();
+        } else {
+            display_show_glucose(current_glucose.value_mmol, 
+                               librelinkup_get_trend_string(current_glucose.trend),
+                               current_glucose.is_low, current_glucose.is_high,
+                               current_glucose.timestamp, current_glucose.measurement_color);
+        }
     }
 }
 
@@ -523,22 +720,24 @@ static void glucose_fetch_task(void *pvParameters) {
     char password[128] = {0};
     bool use_eu_server = false;
 #endif
+    librelinkup_client_t *libre_client = NULL;  // Stays NULL in demo mode
     
     bool first_fetch = true;
     
     while (1) {
-        // On first iteration, wait for OTA check to complete, then fetch immediately
+        // On first iteration, fetch as soon as WiFi is up (the OTA check
+        // waits for this reading)
         if (first_fetch) {
-            // Wait for OTA check to complete AND OTA to not be in progress
-            while (!ota_check_complete || ota_in_progress) {
-                vTaskDelay(pdMS_TO_TICKS(1000));
+            while (!wifi_ready || ota_in_progress) {
+                ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(1000));  // on_wifi_connected notifies
             }
-            ESP_LOGI(TAG, "OTA check complete, proceeding with glucose fetch");
+            ESP_LOGI(TAG, "WiFi ready, fetching first glucose reading");
         } else {
             // Subsequent iterations wait for the configured interval
             uint32_t interval_ms = global_settings_get_interval_ms();
             ESP_LOGI(TAG, "Next glucose update in %lu minutes", interval_ms / 60000);
-            vTaskDelay(pdMS_TO_TICKS(interval_ms));
+            // An MQTT refresh command or a reading from the LAN leader ends the wait early
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(interval_ms));
         }
         first_fetch = false;
         
@@ -548,6 +747,18 @@ static void glucose_fetch_task(void *pvParameters) {
             continue;
         }
         
+        // A LAN share follower shows the leader's readings instead of polling
+        if (lan_share_get_role() == LAN_SHARE_FOLLOWER) {
+            if (lan_share_take_reading(&current_glucose)) {
+                ESP_LOGI(TAG, "Glucose from LAN leader: %d mg/dL, Trend: %s",
+                        current_glucose.value_mgdl,
+                        librelinkup_get_trend_string(current_glucose.trend));
+                process_glucose_reading();
+            }
+            mqtt_publisher_publish_health();
+            continue;
+        }
+        
         // Only fetch if WiFi is connected and (credentials exist OR demo mode)
         if (!wifi_ready || (!libre_credentials_exist() && !DEMO_MODE_ENABLED)) {
             continue;
@@ -563,20 +774,27 @@ static void glucose_fetch_task(void *pvParameters) {
 #else
             if (libre_credentials_load(email, password, libre_patient_id, &use_eu_server) == ESP_OK) {
                 ESP_LOGI(TAG, "Loading LibreLink credentials...");
-                librelinkup_init(use_eu_server);
+                // Created once: it keeps the session (and restores it from NVS)
+                if (!libre_client) {
+                    libre_client = librelinkup_client_create(use_eu_server, true);
+                    if (!libre_client) {
+                        ESP_LOGE(TAG, "Failed to create LibreLink client");
+                        continue;
+                    }
+                }
                 
                 // Only login if we don't already have a valid token from NVS
-                if (!librelinkup_is_logged_in()) {
-                    if (librelinkup_login(email, password) == ESP_OK) {
+                if (!librelinkup_is_logged_in(libre_client)) {
+                    if (librelinkup_login(libre_client, email, password) == ESP_OK) {
                         ESP_LOGI(TAG, "LibreLink login successful");
                         libre_logged_in = true;
                         
                         // If no patient ID stored, get it now
                         if (libre_patient_id[0] == '\0') {
-                            if (librelinkup_get_patient_id(libre_patient_id, sizeof(libre_patient_id)) == ESP_OK) {
+                            if (librelinkup_get_patient_id(libre_client, libre_patient_id, sizeof(libre_patient_id)) == ESP_OK) {
                                 ESP_LOGI(TAG, "Got patient ID: %s", libre_patient_id);
                                 // Save it for next time
-                                libre_credentials_save(email, password, libre_patient_id, use_eu_server);
+                                libre_credentials_save_patient_id(libre_patient_id);
                             }
                         }
                     } else {
@@ -589,10 +807,10 @@ static void glucose_fetch_task(void *pvParameters) {
                     
                     // If no patient ID stored, get it now
                     if (libre_patient_id[0] == '\0') {
-                        if (librelinkup_get_patient_id(libre_patient_id, sizeof(libre_patient_id)) == ESP_OK) {
+                        if (librelinkup_get_patient_id(libre_client, libre_patient_id, sizeof(libre_patient_id)) == ESP_OK) {
                             ESP_LOGI(TAG, "Got patient ID: %s", libre_patient_id);
                             // Save it for next time
-                            libre_credentials_save(email, password, libre_patient_id, use_eu_server);
+                            libre_credentials_save_patient_id(libre_patient_id);
                         }
                     }
                 }
@@ -603,59 +821,16 @@ static void glucose_fetch_task(void *pvParameters) {
         // Fetch glucose data
         if (libre_logged_in && libre_patient_id[0] != '\0') {
             ESP_LOGI(TAG, "Fetching glucose data...");
-            esp_err_t err = librelinkup_get_glucose(libre_patient_id, &current_glucose);
+            esp_err_t err = librelinkup_get_glucose(libre_client, libre_patient_id, &current_glucose);
             if (err == ESP_OK) {
                 ESP_LOGI(TAG, "Glucose: %d mg/dL, Trend: %s", 
                         current_glucose.value_mgdl, 
                         librelinkup_get_trend_string(current_glucose.trend));
                 
-                // Check for threshold violations and manage alarm
-                global_settings_t settings;
-                global_settings_load(&settings);
-                
-                // Calculate thresholds locally (don't trust API's isLow/isHigh flags)
-                bool is_low_calculated = current_glucose.value_mmol < settings.glucose_low_threshold;
-                bool is_high_calculated = current_glucose.value_mmol > settings.glucose_high_threshold;
-                
-                // Check if alarm should be triggered based on individual low/high settings
-                bool should_alarm = settings.alarm_enabled && 
-                                   ((is_low_calculated && settings.alarm_low_enabled) || 
-                                    (is_high_calculated && settings.alarm_high_enabled));
-                
-                if (should_alarm) {
-                    // Only activate alarm if not already active (don't reset snooze state on glucose refresh)
-                    if (!alarm_active) {
-                        // Start alarm
-                        ESP_LOGW(TAG, "THRESHOLD VIOLATED - Starting alarm! (Low: %d, High: %d, Value: %.1f mmol/L)",
-                                 is_low_calculated, is_high_calculated, current_glucose.value_mmol);
-                        alarm_active = true;
-                        alarm_snoozed = false;
-                    } else {
-                        ESP_LOGD(TAG, "Threshold still violated, alarm continues (active: %d, snoozed: %d)", 
-                                 alarm_active, alarm_snoozed);
-                    }
-                } else {
-                    // Glucose back in range or alarm disabled - stop alarm
-                    if (alarm_active) {
-                        ESP_LOGI(TAG, "Glucose back in range - Stopping alarm");
-                        alarm_active = false;
-                        alarm_snoozed = false;
-                    }
-                }
-                
-                // Update display if not in settings
-                if (!settings_shown && !setup_in_progress) {
-                    // Check if data is stale (older than 5 minutes)
-                    if (is_glucose_data_stale(current_glucose.timestamp)) {
-                        ESP_LOGW(TAG, "Glucose data is stale (older than 5 minutes): %s", current_glucose.timestamp);
-                        display_show_no_recent_data();
-                    } else {
-                        display_show_glucose(current_glucose.value_mmol, 
-                                           librelinkup_get_trend_string(current_glucose.trend),
-                                           current_glucose.is_low, current_glucose.is_high,
-                                           current_glucose.timestamp, current_glucose.measurement_color);
-                    }
-                }
+                process_glucose_reading();
+                nightscout_submit(&current_glucose);
+                // Followers on the LAN get this reading instead of polling
+                lan_share_publish(&current_glucose);
             } else if (err == ESP_ERR_LIBRE_AUTH_FAILED) {
                 // Only force re-login on actual authentication failures (401)
                 ESP_LOGE(TAG, "Authentication failed - forcing re-login");
@@ -679,6 +854,11 @@ static void glucose_fetch_task(void *pvParameters) {
                 }
             }
         }
+        
+        // Upload queued readings while the radio is up for this poll
+        nightscout_flush();
+        power_log_stats();
+        mqtt_publisher_publish_health();
     }
 }
 
@@ -695,20 +875,48 @@ void app_main(void) {
         ret = nvs_flash_init();
     }
     ESP_ERROR_CHECK(ret);
+    ESP_ERROR_CHECK(nvs_journal_init());
+    
+    // Local time for the night hours and the clock (SNTP sets UTC)
+    global_settings_apply_timezone();
+    
+    // DFS and modem sleep (before anything takes a PM lock)
+    if (power_init() != ESP_OK) {
+        ESP_LOGW(TAG, "Power saving unavailable");
+    }
+    
+    // Sounds and quotes (optional; the alarm falls back to a beep)
+    assets_init();
+    
+    // Optional Nightscout upload (restores readings queued before a reboot)
+    if (nightscout_init() != ESP_OK) {
+        ESP_LOGW(TAG, "Nightscout uploader unavailable");
+    }
+    
+    // Optional MQTT / Home Assistant publishing (connects once WiFi is up)
+    if (mqtt_publisher_init(on_mqtt_command) != ESP_OK) {
+        ESP_LOGW(TAG, "MQTT publisher unavailable");
+    }
     
     // Initialize display first
     ESP_LOGI(TAG, "Initializing display...");
     ESP_ERROR_CHECK(display_init());
     
-    // Create LVGL task with larger stack
-    xTaskCreate(display_task, "display_task", 8192, NULL, 5, NULL);
+    // Show splash screen (it stays up while WiFi connects)
+    display_show_splash();
     
-    // Give LVGL task time to start
-    vTaskDelay(pdMS_TO_TICKS(100));
+    // Start connecting now: the rest of init overlaps the association, and
+    // nothing waits a fixed time before the first glucose fetch
+    ESP_LOGI(TAG, "Initializing WiFi...");
+    wifi_manager_register_connected_cb(on_wifi_connected);
+    wifi_manager_register_disconnected_cb(on_wifi_disconnected);
+    wifi_manager_register_failed_cb(on_wifi_failed);
+    ESP_ERROR_CHECK(wifi_manager_init());
     
-    // Show splash screen
-    display_show_splash();
-    vTaskDelay(pdMS_TO_TICKS(2000));
+    // Without WiFi credentials the About screen follows, so keep the splash up a moment
+    if (!wifi_manager_is_provisioned()) {
+        vTaskDelay(pdMS_TO_TICKS(2000));
+    }
     
     // Initialize buttons (red button on LCD panel) - MUST be after display init
     ESP_LOGI(TAG, "========================================");
@@ -735,6 +943,7 @@ void app_main(void) {
             
             esp_err_t cb_err = iot_button_register_cb(btns[BSP_BUTTON_MAIN], BUTTON_SINGLE_CLICK, red_button_handler, NULL);
             ESP_LOGI(TAG, "SINGLE_CLICK registration: %s", esp_err_to_name(cb_err));
+            iot_button_register_cb(btns[BSP_BUTTON_MAIN], BUTTON_PRESS_DOWN, button_wake_handler, (void *)&red_press_woke);
         } else {
             ESP_LOGE(TAG, "Red button not available! btn_cnt=%d, BSP_BUTTON_MAIN=%d, handle=%p", 
                      btn_cnt, BSP_BUTTON_MAIN, btn_cnt > BSP_BUTTON_MAIN ? btns[BSP_BUTTON_MAIN] : NULL);
@@ -747,19 +956,13 @@ void app_main(void) {
             
             esp_err_t mute_err = iot_button_register_cb(btns[BSP_BUTTON_MUTE], BUTTON_SINGLE_CLICK, mute_button_handler, NULL);
             ESP_LOGI(TAG, "MUTE button registration: %s", esp_err_to_name(mute_err));
+            iot_button_register_cb(btns[BSP_BUTTON_MUTE], BUTTON_PRESS_DOWN, button_wake_handler, NULL);
         } else {
             ESP_LOGW(TAG, "Mute button not available! btn_cnt=%d, BSP_BUTTON_MUTE=%d", btn_cnt, BSP_BUTTON_MUTE);
         }
     }
     ESP_LOGI(TAG, "========================================");
     
-    // Initialize WiFi manager
-    ESP_LOGI(TAG, "Initializing WiFi...");
-    wifi_manager_register_connected_cb(on_wifi_connected);
-    wifi_manager_register_disconnected_cb(on_wifi_disconnected);
-    wifi_manager_register_failed_cb(on_wifi_failed);
-    ESP_ERROR_CHECK(wifi_manager_init());
-    
     // Initialize OTA update system
     ESP_LOGI(TAG, "Initializing OTA update system...");
     ota_update_init();
@@ -773,12 +976,18 @@ void app_main(void) {
         } else {
             ESP_LOGI(TAG, "IR transmitter initialized successfully");
         }
+        
+        // Learned remote codes override the built-in lamp commands
+        esp_err_t learn_ret = ir_learning_init();
+        if (learn_ret != ESP_OK) {
+            ESP_LOGW(TAG, "IR learning unavailable: %s", esp_err_to_name(learn_ret));
+        }
     } else {
         ESP_LOGI(TAG, "Moon Lamp disabled in settings - skipping IR transmitter init");
     }
     
     // Start glucose fetch task
-    xTaskCreate(glucose_fetch_task, "glucose_fetch", 8192, NULL, 4, NULL);
+    xTaskCreate(glucose_fetch_task, "glucose_fetch", 8192, NULL, 4, &glucose_task_handle);
     
     // Start alarm audio task (higher priority for smooth audio)
     xTaskCreate(alarm_task, "alarm_task", 4096, NULL, 6, NULL);
@@ -790,34 +999,23 @@ void app_main(void) {
         // Keep splash screen visible while connecting
         
         // Wait up to 20 seconds for connection (IP address takes time)
-        for (int i = 0; i < 40; i++) {
-            vTaskDelay(pdMS_TO_TICKS(500));
-            if (wifi_manager_is_connected()) {
-                ESP_LOGI(TAG, "Connected to WiFi successfully");
-                // Check for OTA updates on boot (non-blocking)
-                xTaskCreate(ota_check_task, "ota_check", 4096, NULL, 3, NULL);
-                
-                // Callback will handle display (show glucose directly)
-                return;
-            }
-            // Log every 2 seconds to show we're waiting
-            if (i % 4 == 0) {
-                ESP_LOGI(TAG, "Waiting for WiFi connection... (%d/20s)", i/2);
-            }
+        if (wifi_manager_wait_connected(20000)) {
+            ESP_LOGI(TAG, "Connected to WiFi successfully");
+            // Check for OTA updates on boot (non-blocking)
+            xTaskCreate(ota_check_task, "ota_check", 4096, NULL, 3, NULL);
+            
+            // Callback will handle display (show glucose directly)
+            return;
         }
         
         // Connection failed - show connection failed screen
         ESP_LOGE(TAG, "WiFi connection timeout - no IP address received");
         display_show_connection_failed(on_retry_button, on_restart_setup_button);
-        // Signal OTA check complete (won't run without WiFi)
-        ota_check_complete = true;
         // Don't return - let the task continue running
     } else {
         // No credentials - AP mode already started, show About screen
         ESP_LOGI(TAG, "No WiFi credentials, AP mode active, showing About screen");
         display_show_about(on_about_next_button);
-        // Signal OTA check complete (won't run without WiFi)
-        ota_check_complete = true;
     }
     
     ESP_LOGI(TAG, "Initialization complete");
@@ -0,0 +1,580 @@
+/**
+ * MQTT Publisher Implementation
+ */
+
+#include "mqtt_publisher.h"
+#include "config.h"
+#include "nvs_journal.h"
+#include "power.h"
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "esp_crt_bundle.h"
+#include "mqtt_client.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "MQTT_PUB";
+static const char *MQTT_NAMESPACE = "mqtt";
+static const char *MQTT_URI_KEY = "uri";
+static const char *MQTT_USER_KEY = "user";
+static const char *MQTT_PASS_KEY = "pass";
+
+#define TOPIC_ROOT          "glucose_monitor"
+#define DISCOVERY_PREFIX    "homeassistant"
+#define HA_STATUS_TOPIC     DISCOVERY_PREFIX "/status"
+
+#define STATE_VALUE_SIZE    128
+#define READING_JSON_SIZE   160
+#define DISCOVERY_BUF_SIZE  768
+
+// Retained state topics, republished on every connect
+typedef enum {
+    STATE_GLUCOSE,
+    STATE_GLUCOSE_MGDL,
+    STATE_TREND,
+    STATE_STALE,
+    STATE_ALARM,
+    STATE_FIRST_READING,
+    STATE_COUNT
+} state_topic_t;
+
+static const char *const state_names[STATE_COUNT] = {
+    [STATE_GLUCOSE] = "glucose",
+    [STATE_GLUCOSE_MGDL] = "glucose_mgdl",
+    [STATE_TREND] = "trend",
+    [STATE_STALE] = "stale",
+    [STATE_ALARM] = "alarm",
+    [STATE_FIRST_READING] = "first_reading",
+};
+
+// Home Assistant entity
+typedef struct {
+    const char *component;  // Home Assistant platform
+    const char *object;     // Object id (unique per device)
+    const char *name;
+    const char *state;      // State topic suffix, NULL for none
+    const char *command;    // Command topic suffix, NULL for none
+    const char *fields;     // Extra config members
+} ha_entity_t;
+
+static const ha_entity_t ha_entities[] = {
+    { "sensor", "glucose", "Glucose", "glucose", NULL,
+      "\"unit_of_measurement\":\"mmol/L\",\"state_class\":\"measurement\",\"icon\":\"mdi:diabetes\","
+      "\"suggested_display_precision\":1" },
+    { "sensor", "glucose_mgdl", "Glucose (mg/dL)", "glucose_mgdl", NULL,
+      "\"unit_of_measurement\":\"mg/dL\",\"state_class\":\"measurement\",\"icon\":\"mdi:diabetes\"" },
+    { "sensor", "trend", "Trend", "trend", NULL,
+      "\"icon\":\"mdi:trending-up\"" },
+    { "binary_sensor", "stale", "Data stale", "stale", NULL,
+      "\"device_class\":\"problem\"" },
+    { "sensor", "alarm", "Alarm", "alarm", NULL,
+      "\"device_class\":\"enum\",\"options\":[\"off\",\"active\",\"snoozed\"],\"icon\":\"mdi:alarm-light\"" },
+    { "sensor", "rssi", "Wi-Fi signal", "health", NULL,
+      "\"value_template\":\"{{ value_json.rssi }}\",\"unit_of_measurement\":\"dBm\","
+      "\"device_class\":\"signal_strength\",\"entity_category\":\"diagnostic\"" },
+    { "sensor", "free_heap", "Free heap", "health", NULL,
+      "\"value_template\":\"{{ value_json.free_heap }}\",\"unit_of_measurement\":\"B\","
+      "\"entity_category\":\"diagnostic\",\"icon\":\"mdi:memory\"" },
+    { "sensor", "uptime", "Uptime", "health", NULL,
+      "\"value_template\":\"{{ value_json.uptime }}\",\"unit_of_measurement\":\"s\","
+      "\"device_class\":\"duration\",\"entity_category\":\"diagnostic\"" },
+    { "sensor", "first_reading", "Boot to first reading", "first_reading", NULL,
+      "\"unit_of_measurement\":\"ms\","
+      "\"device_class\":\"duration\",\"entity_category\":\"diagnostic\"" },
+    { "sensor", "current", "Estimated current", "health", NULL,
+      "\"value_template\":\"{{ value_json.current_ma }}\",\"unit_of_measurement\":\"mA\","
+      "\"device_class\":\"current\",\"state_class\":\"measurement\",\"entity_category\":\"diagnostic\"" },
+    { "button", "snooze", "Snooze alarm", NULL, "cmd/snooze",
+      "\"icon\":\"mdi:alarm-snooze\"" },
+    { "button", "refresh", "Refresh glucose", NULL, "cmd/refresh",
+      "\"icon\":\"mdi:refresh\"" },
+    { "select", "lamp", "Moon Lamp color", NULL, "cmd/lamp",
+      "\"options\":[\"green\",\"red\",\"white\"],\"optimistic\":true,\"icon\":\"mdi:lamp\"" },
+};
+
+// Moon Lamp colors accepted on cmd/lamp, as LibreLink measurement colors
+static const struct {
+    const char *name;
+    int color;
+} lamp_colors[] = {
+    { "green", 1 },
+    { "red", 2 },
+    { "white", 0 },
+};
+
+// Guards everything below; esp-mqtt calls are non-blocking while it is held
+static SemaphoreHandle_t mqtt_mutex = NULL;
+static StaticSemaphore_t mqtt_mutex_buf;
+
+static mqtt_command_cb_t command_callback = NULL;
+static esp_mqtt_client_handle_t client = NULL;
+static bool connected = false;
+
+static char node_id[16];                      // "gm_a1b2c3"
+static char base_topic[48];                   // "glucose_monitor/gm_a1b2c3"
+static char broker_uri[MQTT_PUBLISHER_URI_MAX_LEN + 1];
+static char broker_user[MQTT_PUBLISHER_USER_MAX_LEN + 1];
+static char broker_pass[MQTT_PUBLISHER_PASS_MAX_LEN + 1];
+
+static char state_values[STATE_COUNT][STATE_VALUE_SIZE];   // "" = not known yet
+
+// Readings waiting for the broker, oldest at offline_head
+static char offline_readings[MQTT_PUBLISHER_OFFLINE_READINGS][READING_JSON_SIZE];
+static size_t offline_head = 0;
+static size_t offline_count = 0;
+
+static char discovery_buf[DISCOVERY_BUF_SIZE];
+
+static void publish_locked(const char *suffix, const char *payload, int qos, bool retain)
+{
+    char topic[128];
+    snprintf(topic, sizeof(topic), "%s/%s", base_topic, suffix);
+    if (esp_mqtt_client_enqueue(client, topic, payload, 0, qos, retain, true) < 0) {
+        ESP_LOGW(TAG, "Outbox full, dropped %s", topic);
+    }
+}
+
+static void set_state(state_topic_t state, const char *value)
+{
+    if (!mqtt_mutex) {
+        return;
+    }
+
+    xSemaphoreTake(mqtt_mutex, portMAX_DELAY);
+    if (strcmp(state_values[state], value) != 0) {
+        snprintf(state_values[state], sizeof(state_values[state]), "%s", value);
+        if (connected) {
+            publish_locked(state_names[state], value, 1, true);
+        }
+    }
+    xSemaphoreGive(mqtt_mutex);
+}
+
+static void publish_discovery_locked(void)
+{
+    char device[256];
+    snprintf(device, sizeof(device),
+             "{\"identifiers\":[\"%s\"],\"name\":\"%s\",\"manufacturer\":\"%s\","
+             "\"model\":\"ESP32-S3-BOX-3\",\"sw_version\":\"%s\"}",
+             node_id, DEVICE_NAME, DEVICE_MANUFACTURER, DEVICE_VERSION);
+
+    for (size_t i = 0; i < sizeof(ha_entities) / sizeof(ha_entities[0]); i++) {
+        const ha_entity_t *e = &ha_entities[i];
+        char state_field[96] = "";
+        char command_field[96] = "";
+        if (e->state) {
+            snprintf(state_field, sizeof(state_field), "\"state_topic\":\"%s/%s\",", base_topic, e->state);
+        }
+        if (e->command) {
+            snprintf(command_field, sizeof(command_field), "\"command_topic\":\"%s/%s\",", base_topic, e->command);
+        }
+
+        int len = snprintf(discovery_buf, sizeof(discovery_buf),
+                           "{\"name\":\"%s\",\"unique_id\":\"%s_%s\",\"object_id\":\"%s_%s\",%s%s"
+                           "\"availability_topic\":\"%s/status\",%s,\"device\":%s}",
+                           e->name, node_id, e->object, node_id, e->object, state_field, command_field,
+                           base_topic, e->fields, device);
+        if (len < 0 || len >= (int)sizeof(discovery_buf)) {
+            ESP_LOGE(TAG, "Discovery config for %s too large", e->object);
+            continue;
+        }
+
+        char topic[128];
+        snprintf(topic, sizeof(topic), DISCOVERY_PREFIX "/%s/%s/%s/config", e->component, node_id, e->object);
+        esp_mqtt_client_enqueue(client, topic, discovery_buf, len, 1, true, true);
+    }
+}
+
+static void on_connected_locked(void)
+{
+    connected = true;
+    publish_locked("status", "online", 1, true);
+    publish_discovery_locked();
+
+    for (size_t i = 0; i < STATE_COUNT; i++) {
+        if (state_values[i][0]) {
+            publish_locked(state_names[i], state_values[i], 1, true);
+        }
+    }
+
+    if (offline_count > 0) {
+        ESP_LOGI(TAG, "Sending %u buffered readings", (unsigned)offline_count);
+    }
+    while (offline_count > 0) {
+        publish_locked("reading", offline_readings[offline_head], 1, false);
+        offline_head = (offline_head + 1) % MQTT_PUBLISHER_OFFLINE_READINGS;
+        offline_count--;
+    }
+
+    char topic[64];
+    snprintf(topic, sizeof(topic), "%s/cmd/#", base_topic);
+    esp_mqtt_client_subscribe(client, topic, 1);
+    esp_mqtt_client_subscribe(client, HA_STATUS_TOPIC, 1);
+}
+
+static bool topic_is(const esp_mqtt_event_handle_t event, const char *topic)
+{
+    size_t len = strlen(topic);
+    return event->topic_len == (int)len && memcmp(event->topic, topic, len) == 0;
+}
+
+static bool payload_is(const esp_mqtt_event_handle_t event, const char *value)
+{
+    size_t len = strlen(value);
+    return event->data_len == (int)len && strncasecmp(event->data, value, len) == 0;
+}
+
+static void handle_message(esp_mqtt_event_handle_t event)
+{
+    // Commands are short; ignore anything split across several events
+    if (event->current_data_offset != 0 || event->data_len != event->total_data_len) {
+        return;
+    }
+
+    if (topic_is(event, HA_STATUS_TOPIC)) {
+        if (payload_is(event, "online")) {
+            // Home Assistant restarted and lost the discovery configs it didn't retain
+            xSemaphoreTake(mqtt_mutex, portMAX_DELAY);
+            if (connected) {
+                publish_discovery_locked();
+            }
+            xSemaphoreGive(mqtt_mutex);
+        }
+        return;
+    }
+
+    char topic[64];
+    snprintf(topic, sizeof(topic), "%s/cmd/snooze", base_topic);
+    if (topic_is(event, topic)) {
+        ESP_LOGI(TAG, "Snooze command");
+        if (command_callback) {
+            command_callback(MQTT_CMD_SNOOZE, 0);
+        }
+        return;
+    }
+
+    snprintf(topic, sizeof(topic), "%s/cmd/refresh", base_topic);
+    if (topic_is(event, topic)) {
+        ESP_LOGI(TAG, "Refresh command");
+        if (command_callback) {
+            command_callback(MQTT_CMD_REFRESH, 0);
+        }
+        return;
+    }
+
+    snprintf(topic, sizeof(topic), "%s/cmd/lamp", base_topic);
+    if (topic_is(event, topic)) {
+        for (size_t i = 0; i < sizeof(lamp_colors) / sizeof(lamp_colors[0]); i++) {
+            if (payload_is(event, lamp_colors[i].name)) {
+                ESP_LOGI(TAG, "Lamp command: %s", lamp_colors[i].name);
+                if (command_callback) {
+                    command_callback(MQTT_CMD_LAMP_COLOR, lamp_colors[i].color);
+                }
+                return;
+            }
+        }
+        ESP_LOGW(TAG, "Unknown lamp color: %.*s", event->data_len, event->data);
+    }
+}
+
+static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data)
+{
+    esp_mqtt_event_handle_t event = event_data;
+
+    switch ((esp_mqtt_event_id_t)event_id) {
+        case MQTT_EVENT_CONNECTED:
+            xSemaphoreTake(mqtt_mutex, portMAX_DELAY);
+            // Ignore a client that is being replaced after a config change
+            if (event->client == client) {
+                ESP_LOGI(TAG, "Connected to %s", broker_uri);
+                on_connected_locked();
+            }
+            xSemaphoreGive(mqtt_mutex);
+            break;
+
+        case MQTT_EVENT_DISCONNECTED:
+            xSemaphoreTake(mqtt_mutex, portMAX_DELAY);
+            if (event->client == client) {
+                ESP_LOGW(TAG, "Disconnected from broker");
+                connected = false;
+            }
+            xSemaphoreGive(mqtt_mutex);
+            break;
+
+        case MQTT_EVENT_DATA:
+            handle_message(event);
+            break;
+
+        case MQTT_EVENT_ERROR:
+            if (event->error_handle && event->error_handle->error_type == MQTT_ERROR_TYPE_CONNECTION_REFUSED) {
+                ESP_LOGE(TAG, "Broker refused connection (code %d)", event->error_handle->connect_return_code);
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+static void load_str(nvs_handle_t handle, const char *key, char *buf, size_t size)
+{
+    size_t len = size;
+    if (nvs_get_str(handle, key, buf, &len) != ESP_OK) {
+        buf[0] = '\0';
+    }
+}
+
+esp_err_t mqtt_publisher_init(mqtt_command_cb_t command_cb)
+{
+    if (!mqtt_mutex) {
+        mqtt_mutex = xSemaphoreCreateMutexStatic(&mqtt_mutex_buf);
+    }
+    command_callback = command_cb;
+
+    uint8_t mac[6] = {0};
+    esp_read_mac(mac, ESP_MAC_WIFI_STA);
+    snprintf(node_id, sizeof(node_id), "gm_%02x%02x%02x", mac[3], mac[4], mac[5]);
+    snprintf(base_topic, sizeof(base_topic), TOPIC_ROOT "/%s", node_id);
+
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(MQTT_NAMESPACE, NVS_READONLY, &handle);
+    if (err == ESP_ERR_NVS_NOT_FOUND) {
+        return ESP_OK;  // Never configured
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+    xSemaphoreTake(mqtt_mutex, portMAX_DELAY);
+    load_str(handle, MQTT_URI_KEY, broker_uri, sizeof(broker_uri));
+    load_str(handle, MQTT_USER_KEY, broker_user, sizeof(broker_user));
+    load_str(handle, MQTT_PASS_KEY, broker_pass, sizeof(broker_pass));
+    xSemaphoreGive(mqtt_mutex);
+    nvs_close(handle);
+
+    if (broker_uri[0]) {
+        ESP_LOGI(TAG, "Broker %s, topics under %s", broker_uri, base_topic);
+    }
+    return ESP_OK;
+}
+
+esp_err_t mqtt_publisher_start(void)
+{
+    if (!mqtt_mutex) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(mqtt_mutex, portMAX_DELAY);
+    if (client || broker_uri[0] == '\0') {
+        xSemaphoreGive(mqtt_mutex);
+        return ESP_OK;
+    }
+
+    char will_topic[64];
+    snprintf(will_topic, sizeof(will_topic), "%s/status", base_topic);
+
+    // esp-mqtt copies every string here
+    esp_mqtt_client_config_t config = {
+        .broker.address.uri = broker_uri,
+        .broker.verification.crt_bundle_attach = esp_crt_bundle_attach,
+        .credentials.client_id = node_id,
+        .credentials.username = broker_user[0] ? broker_user : NULL,
+        .credentials.authentication.password = broker_pass[0] ? broker_pass : NULL,
+        .session.last_will = {
+            .topic = will_topic,
+            .msg = "offline",
+            .qos = 1,
+            .retain = 1,
+        },
+        .session.keepalive = 60,
+    };
+
+    esp_err_t err = ESP_OK;
+    client = esp_mqtt_client_init(&config);
+    if (!client) {
+        err = ESP_ERR_NO_MEM;
+    } else {
+        esp_mqtt_client_register_event(client, ESP_EVENT_ANY_ID, mqtt_event_handler, NULL);
+        err = esp_mqtt_client_start(client);
+        if (err != ESP_OK) {
+            esp_mqtt_client_destroy(client);
+            client = NULL;
+        }
+    }
+    xSemaphoreGive(mqtt_mutex);
+
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start MQTT client: %s", esp_err_to_name(err));
+    }
+    return err;
+}
+
+esp_err_t mqtt_publisher_config_save(const char *uri, const char *username, const char *password)
+{
+    if (!uri || !username || strlen(uri) > MQTT_PUBLISHER_URI_MAX_LEN ||
+        strlen(username) > MQTT_PUBLISHER_USER_MAX_LEN ||
+        (password && strlen(password) > MQTT_PUBLISHER_PASS_MAX_LEN)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!mqtt_mutex) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (uri[0] != '\0' && strncmp(uri, "mqtt://", 7) != 0 && strncmp(uri, "mqtts://", 8) != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // Reported back through /settings/load as JSON
+    for (const char *p = uri; *p; p++) {
+        if ((unsigned char)*p <= ' ' || *p == '"' || *p == '\\') {
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+    for (const char *p = username; *p; p++) {
+        if ((unsigned char)*p < ' ' || *p == '"' || *p == '\\') {
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+
+    if (uri[0] == '\0') {
+        nvs_journal_erase(MQTT_NAMESPACE, MQTT_URI_KEY);
+        nvs_journal_erase(MQTT_NAMESPACE, MQTT_USER_KEY);
+        nvs_journal_erase(MQTT_NAMESPACE, MQTT_PASS_KEY);
+    } else {
+        nvs_journal_set_str(MQTT_NAMESPACE, MQTT_URI_KEY, uri);
+        nvs_journal_set_str(MQTT_NAMESPACE, MQTT_USER_KEY, username);
+        if (password && password[0] != '\0') {
+            nvs_journal_set_str(MQTT_NAMESPACE, MQTT_PASS_KEY, password);
+        }
+    }
+    esp_err_t err = nvs_journal_flush();
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Error saving configuration: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    // Take the running client out first; destroying it waits for the MQTT
+    // task, whose event handler needs the mutex
+    xSemaphoreTake(mqtt_mutex, portMAX_DELAY);
+    esp_mqtt_client_handle_t old_client = client;
+    client = NULL;
+    connected = false;
+    snprintf(broker_uri, sizeof(broker_uri), "%s", uri);
+    snprintf(broker_user, sizeof(broker_user), "%s", uri[0] ? username : "");
+    if (uri[0] == '\0') {
+        broker_pass[0] = '\0';
+    } else if (password && password[0] != '\0') {
+        snprintf(broker_pass, sizeof(broker_pass), "%s", password);
+    }
+    xSemaphoreGive(mqtt_mutex);
+
+    if (old_client) {
+        esp_mqtt_client_destroy(old_client);
+    }
+    ESP_LOGI(TAG, "MQTT %s", uri[0] ? "configured" : "disabled");
+    return mqtt_publisher_start();
+}
+
+bool mqtt_publisher_get_config(char *uri, size_t uri_size, char *username, size_t username_size)
+{
+    if (!mqtt_mutex) {
+        uri[0] = '\0';
+        username[0] = '\0';
+        return false;
+    }
+    xSemaphoreTake(mqtt_mutex, portMAX_DELAY);
+    snprintf(uri, uri_size, "%s", broker_uri);
+    snprintf(username, username_size, "%s", broker_user);
+    bool enabled = broker_uri[0] != '\0';
+    xSemaphoreGive(mqtt_mutex);
+    return enabled;
+}
+
+static const char* trend_name(libre_trend_t trend)
+{
+    switch (trend) {
+        case LIBRE_TREND_FALLING_QUICKLY: return "falling_quickly";
+        case LIBRE_TREND_FALLING:         return "falling";
+        case LIBRE_TREND_STABLE:          return "stable";
+        case LIBRE_TREND_RISING:          return "rising";
+        case LIBRE_TREND_RISING_QUICKLY:  return "rising_quickly";
+        default:                          return "unknown";
+    }
+}
+
+void mqtt_publisher_publish_reading(const libre_glucose_data_t *glucose, bool stale)
+{
+    if (!mqtt_mutex || !glucose) {
+        return;
+    }
+
+    char value[STATE_VALUE_SIZE];
+    snprintf(value, sizeof(value), "%.1f", glucose->value_mmol);
+    set_state(STATE_GLUCOSE, value);
+    snprintf(value, sizeof(value), "%d", glucose->value_mgdl);
+    set_state(STATE_GLUCOSE_MGDL, value);
+    set_state(STATE_TREND, trend_name(glucose->trend));
+    set_state(STATE_STALE, stale ? "ON" : "OFF");
+
+    char reading[READING_JSON_SIZE];
+    snprintf(reading, sizeof(reading),
+             "{\"mgdl\":%d,\"mmol\":%.1f,\"trend\":\"%s\",\"time\":%lld,\"stale\":%s}",
+             glucose->value_mgdl, glucose->value_mmol, trend_name(glucose->trend),
+             (long long)glucose->unix_time, stale ? "true" : "false");
+
+    xSemaphoreTake(mqtt_mutex, portMAX_DELAY);
+    if (connected) {
+        publish_locked("reading", reading, 1, false);
+    } else if (broker_uri[0]) {
+        // Keep the newest readings for the next connect
+        size_t slot = (offline_head + offline_count) % MQTT_PUBLISHER_OFFLINE_READINGS;
+        if (offline_count == MQTT_PUBLISHER_OFFLINE_READINGS) {
+            offline_head = (offline_head + 1) % MQTT_PUBLISHER_OFFLINE_READINGS;
+        } else {
+            offline_count++;
+        }
+        snprintf(offline_readings[slot], sizeof(offline_readings[slot]), "%s", reading);
+    }
+    xSemaphoreGive(mqtt_mutex);
+}
+
+void mqtt_publisher_publish_alarm(bool active, bool snoozed)
+{
+    set_state(STATE_ALARM, !active ? "off" : snoozed ? "snoozed" : "active");
+}
+
+void mqtt_publisher_publish_health(void)
+{
+    wifi_ap_record_t ap;
+    int rssi = esp_wifi_sta_get_ap_info(&ap) == ESP_OK ? ap.rssi : 0;
+
+    power_stats_t power;
+    power_get_stats(&power);
+
+    char health[STATE_VALUE_SIZE];
+    snprintf(health, sizeof(health),
+             "{\"rssi\":%d,\"free_heap\":%lu,\"uptime\":%lld,\"current_ma\":%lu}",
+             rssi, (unsigned long)esp_get_free_heap_size(), (long long)(esp_timer_get_time() / 1000000),
+             (unsigned long)power.avg_current_ma);
+
+    if (!mqtt_mutex) {
+        return;
+    }
+    // Uptime and heap change every poll, so retaining (and republishing on
+    // change) would just rewrite the broker's copy each time
+    xSemaphoreTake(mqtt_mutex, portMAX_DELAY);
+    if (connected) {
+        publish_locked("health", health, 0, false);
+    }
+    xSemaphoreGive(mqtt_mutex);
+}
+
+void mqtt_publisher_set_first_reading_ms(uint32_t ms)
+{
+    char value[16];
+    snprintf(value, sizeof(value), "%lu", (unsigned long)ms);
+    set_state(STATE_FIRST_READING, value);
+}
@@ -0,0 +1,125 @@
+/**
+ * MQTT Publisher
+ * Publishes glucose state to an MQTT broker with Home Assistant discovery
+ *
+ * Topics live under glucose_monitor/<node>, where <node> is "gm_" plus
+ * the last three bytes of the station MAC:
+ *
+ *   status          "online" / "offline" (retained, offline is the last will)
+ *   glucose         mmol/L                         (retained)
+ *   glucose_mgdl    mg/dL                          (retained)
+ *   trend           Trend name, e.g. "rising"      (retained)
+ *   stale           "ON" / "OFF"                   (retained)
+ *   alarm           "off" / "active" / "snoozed"   (retained)
+ *   first_reading   Boot to first reading in ms    (retained)
+ *   health          {"rssi":..,"free_heap":..,"uptime":..,"current_ma":..}
+ *                   Every poll (QoS 0, not retained: it changes every time)
+ *   reading         One JSON message per reading (QoS 1, not retained)
+ *   cmd/snooze      Any payload snoozes an active alarm
+ *   cmd/refresh     Any payload fetches glucose now
+ *   cmd/lamp        "green" / "red" / "white" sets the Moon Lamp
+ *
+ * Retained topics are only published when their value changes, and all
+ * of them are republished on every (re)connect. Readings that arrive
+ * while the broker is unreachable are buffered (the newest
+ * MQTT_PUBLISHER_OFFLINE_READINGS) and sent in order on reconnect.
+ * Discovery configs go to homeassistant/<component>/<node>/<object>/config
+ * on connect and whenever Home Assistant announces itself on
+ * homeassistant/status.
+ *
+ * All functions are non-blocking; messages are handed to the esp-mqtt
+ * task's outbox.
+ */
+
+#ifndef MQTT_PUBLISHER_H
+#define MQTT_PUBLISHER_H
+
+#include "esp_err.h"
+#include "librelinkup.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Longest broker URI (e.g. "mqtt://homeassistant.local:1883")
+#define MQTT_PUBLISHER_URI_MAX_LEN      127
+#define MQTT_PUBLISHER_USER_MAX_LEN     63
+#define MQTT_PUBLISHER_PASS_MAX_LEN     63
+
+// Readings kept while the broker is unreachable
+#define MQTT_PUBLISHER_OFFLINE_READINGS 12
+
+/**
+ * Commands received from the broker
+ */
+typedef enum {
+    MQTT_CMD_SNOOZE,        // Snooze the alarm
+    MQTT_CMD_REFRESH,       // Fetch glucose now
+    MQTT_CMD_LAMP_COLOR,    // Set the Moon Lamp; arg is a LibreLink measurement color
+} mqtt_command_t;
+
+/**
+ * Command callback
+ * Runs on the MQTT task; must not block.
+ */
+typedef void (*mqtt_command_cb_t)(mqtt_command_t command, int arg);
+
+/**
+ * Load the broker configuration
+ * @param command_cb Called for commands received from the broker (may be NULL)
+ * @return ESP_OK on success
+ */
+esp_err_t mqtt_publisher_init(mqtt_command_cb_t command_cb);
+
+/**
+ * Connect to the configured broker
+ * Call once the network is up. Does nothing when no broker is configured
+ * or the client is already running; esp-mqtt reconnects on its own.
+ * @return ESP_OK on success
+ */
+esp_err_t mqtt_publisher_start(void);
+
+/**
+ * Save the broker configuration and restart the client
+ * @param uri Broker URI (mqtt:// or mqtts://); empty disables MQTT
+ * @param username Username (may be empty)
+ * @param password Password; NULL or empty keeps the stored one
+ * @return ESP_OK on success
+ */
+esp_err_t mqtt_publisher_config_save(const char *uri, const char *username, const char *password);
+
+/**
+ * Get the configured broker
+ * @param uri Output buffer for the URI (empty when disabled)
+ * @param uri_size Size of uri
+ * @param username Output buffer for the username
+ * @param username_size Size of username
+ * @return true if MQTT is enabled
+ */
+bool mqtt_publisher_get_config(char *uri, size_t uri_size, char *username, size_t username_size);
+
+/**
+ * Publish a new reading
+ * @param glucose Reading
+ * @param stale Reading is older than the staleness limit
+ */
+void mqtt_publisher_publish_reading(const libre_glucose_data_t *glucose, bool stale);
+
+/**
+ * Publish the alarm state
+ * @param active Alarm triggered
+ * @param snoozed Alarm snoozed
+ */
+void mqtt_publisher_publish_alarm(bool active, bool snoozed);
+
+/**
+ * Publish device health (Wi-Fi RSSI, free heap, uptime, estimated current)
+ * Not retained and not buffered: sent only while connected.
+ */
+void mqtt_publisher_publish_health(void);
+
+/**
+ * Publish how long after boot the first glucose reading arrived
+ */
+void mqtt_publisher_set_first_reading_ms(uint32_t ms);
+
+#endif // MQTT_PUBLISHER_H
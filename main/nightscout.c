@@ -0,0 +1,341 @@
+/**
+ * Nightscout Uploader Implementation
+ */
+
+#include "nightscout.h"
+#include "config.h"
+#include "nvs_journal.h"
+#include "power.h"
+#include "esp_log.h"
+#include "esp_http_client.h"
+#include "esp_crt_bundle.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "mbedtls/sha1.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "NIGHTSCOUT";
+static const char *NS_NAMESPACE = "nightscout";
+static const char *NS_URL_KEY = "url";
+static const char *NS_SECRET_KEY = "secret_sha1";
+static const char *NS_QUEUE_KEY = "queue";
+
+#define NS_ENTRIES_PATH     "/api/v1/entries"
+#define NS_SECRET_HASH_LEN  40      // SHA-1 as hex
+#define NS_BATCH_BUF_SIZE   2304    // NIGHTSCOUT_BATCH_MAX entries of ~170 bytes
+
+// Guards everything below; never held across a network round trip
+static SemaphoreHandle_t ns_mutex = NULL;
+static StaticSemaphore_t ns_mutex_buf;
+
+static char ns_url[NIGHTSCOUT_URL_MAX_LEN + 1];
+static char ns_secret_hash[NS_SECRET_HASH_LEN + 1];
+static uint32_t config_generation = 0;     // Bumped when the site changes
+
+static nightscout_queue_t queue;
+static bool queue_dirty = false;           // Changed since last saved
+static bool queue_saved_nonempty = false;  // NVS holds undelivered readings
+
+static uint32_t failures = 0;
+static int64_t next_attempt_us = 0;
+
+static bool enabled_locked(void)
+{
+    return ns_url[0] != '\0' && ns_secret_hash[0] != '\0';
+}
+
+static void hash_secret(const char *secret, char *hex)
+{
+    unsigned char digest[20];
+    mbedtls_sha1((const unsigned char *)secret, strlen(secret), digest);
+    for (size_t i = 0; i < sizeof(digest); i++) {
+        sprintf(hex + i * 2, "%02x", digest[i]);
+    }
+}
+
+static void load_str(nvs_handle_t handle, const char *key, char *buf, size_t size)
+{
+    size_t len = size;
+    if (nvs_get_str(handle, key, buf, &len) != ESP_OK) {
+        buf[0] = '\0';
+    }
+}
+
+/**
+ * Save the queue if it changed and NVS needs to know
+ * Nothing is written while readings are delivered as they arrive; the
+ * blob is only written while readings are waiting, and erased once the
+ * backlog has been delivered. Goes through the journal
+ * like the site configuration, so the two are never written out of order.
+ */
+static void save_queue_locked(void)
+{
+    if (!queue_dirty || (queue.count == 0 && !queue_saved_nonempty)) {
+        return;
+    }
+
+    esp_err_t err;
+    if (queue.count > 0) {
+        uint8_t blob[NIGHTSCOUT_QUEUE_BLOB_MAX];
+        size_t len = nightscout_queue_serialize(&queue, blob, sizeof(blob));
+        err = nvs_journal_set_blob(NS_NAMESPACE, NS_QUEUE_KEY, blob, len);
+    } else {
+        err = nvs_journal_erase(NS_NAMESPACE, NS_QUEUE_KEY);
+    }
+    if (err == ESP_OK) {
+        err = nvs_journal_flush();
+    }
+
+    if (err == ESP_OK) {
+        queue_dirty = false;
+        queue_saved_nonempty = queue.count > 0;
+        ESP_LOGD(TAG, "Saved %u queued readings", (unsigned)queue.count);
+    } else {
+        ESP_LOGE(TAG, "Failed to save queue: %s", esp_err_to_name(err));
+    }
+}
+
+esp_err_t nightscout_init(void)
+{
+    if (!ns_mutex) {
+        ns_mutex = xSemaphoreCreateMutexStatic(&ns_mutex_buf);
+    }
+
+    xSemaphoreTake(ns_mutex, portMAX_DELAY);
+    nightscout_queue_init(&queue);
+    ns_url[0] = '\0';
+    ns_secret_hash[0] = '\0';
+    failures = 0;
+    next_attempt_us = 0;
+
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(NS_NAMESPACE, NVS_READONLY, &handle);
+    if (err == ESP_OK) {
+        load_str(handle, NS_URL_KEY, ns_url, sizeof(ns_url));
+        load_str(handle, NS_SECRET_KEY, ns_secret_hash, sizeof(ns_secret_hash));
+
+        uint8_t blob[NIGHTSCOUT_QUEUE_BLOB_MAX];
+        size_t len = sizeof(blob);
+        if (nvs_get_blob(handle, NS_QUEUE_KEY, blob, &len) == ESP_OK) {
+            if (!nightscout_queue_deserialize(&queue, blob, len)) {
+                ESP_LOGW(TAG, "Discarding unreadable upload queue");
+            }
+        }
+        nvs_close(handle);
+        err = ESP_OK;
+    } else if (err == ESP_ERR_NVS_NOT_FOUND) {
+        err = ESP_OK;  // Never configured
+    }
+
+    queue_saved_nonempty = queue.count > 0;
+    if (enabled_locked()) {
+        ESP_LOGI(TAG, "Uploading to %s (%u readings pending)", ns_url, (unsigned)queue.count);
+    }
+    xSemaphoreGive(ns_mutex);
+    return err;
+}
+
+esp_err_t nightscout_config_save(const char *url, const char *api_secret)
+{
+    if (!url || strlen(url) > NIGHTSCOUT_URL_MAX_LEN ||
+        (api_secret && strlen(api_secret) > NIGHTSCOUT_SECRET_MAX_LEN)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!ns_mutex) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (url[0] != '\0' && strncmp(url, "http://", 7) != 0 && strncmp(url, "https://", 8) != 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // The URL is echoed into JSON and HTTP headers unescaped
+    for (const char *p = url; *p; p++) {
+        if ((unsigned char)*p <= ' ' || *p == '"' || *p == '\\') {
+            return ESP_ERR_INVALID_ARG;
+        }
+    }
+
+    char new_url[NIGHTSCOUT_URL_MAX_LEN + 1];
+    snprintf(new_url, sizeof(new_url), "%s", url);
+    // "https://site/" and "https://site" are the same site
+    size_t len = strlen(new_url);
+    while (len > 0 && new_url[len - 1] == '/') {
+        new_url[--len] = '\0';
+    }
+
+    xSemaphoreTake(ns_mutex, portMAX_DELAY);
+    char new_hash[NS_SECRET_HASH_LEN + 1];
+    if (api_secret && api_secret[0] != '\0') {
+        hash_secret(api_secret, new_hash);
+    } else {
+        snprintf(new_hash, sizeof(new_hash), "%s", ns_secret_hash);
+    }
+
+    // Readings queued for a different site (or none) aren't ours to send.
+    // The queue is staged first so it is gone before the new site is stored.
+    bool site_changed = strcmp(new_url, ns_url) != 0;
+    if (site_changed && (queue.count > 0 || queue_saved_nonempty)) {
+        nvs_journal_erase(NS_NAMESPACE, NS_QUEUE_KEY);
+    }
+    if (new_url[0] == '\0') {
+        nvs_journal_erase(NS_NAMESPACE, NS_URL_KEY);
+        nvs_journal_erase(NS_NAMESPACE, NS_SECRET_KEY);
+        new_hash[0] = '\0';
+    } else {
+        nvs_journal_set_str(NS_NAMESPACE, NS_URL_KEY, new_url);
+        nvs_journal_set_str(NS_NAMESPACE, NS_SECRET_KEY, new_hash);
+    }
+    esp_err_t err = nvs_journal_flush();
+
+    if (err == ESP_OK) {
+        snprintf(ns_url, sizeof(ns_url), "%s", new_url);
+        snprintf(ns_secret_hash, sizeof(ns_secret_hash), "%s", new_hash);
+        config_generation++;
+        failures = 0;
+        next_attempt_us = 0;
+
+        if (site_changed) {
+            nightscout_queue_init(&queue);
+            queue_dirty = false;
+            queue_saved_nonempty = false;
+        }
+        ESP_LOGI(TAG, "Nightscout %s", ns_url[0] ? "configured" : "disabled");
+    } else {
+        ESP_LOGE(TAG, "Error saving configuration: %s", esp_err_to_name(err));
+    }
+    xSemaphoreGive(ns_mutex);
+    return err;
+}
+
+bool nightscout_get_config(char *url, size_t size)
+{
+    if (!ns_mutex) {
+        url[0] = '\0';
+        return false;
+    }
+    xSemaphoreTake(ns_mutex, portMAX_DELAY);
+    snprintf(url, size, "%s", ns_url);
+    bool enabled = enabled_locked();
+    xSemaphoreGive(ns_mutex);
+    return enabled;
+}
+
+void nightscout_submit(const libre_glucose_data_t *glucose)
+{
+    if (!ns_mutex || !glucose || glucose->unix_time <= 0 || glucose->value_mgdl <= 0) {
+        return;
+    }
+
+    nightscout_entry_t entry = {
+        .date_ms = (int64_t)glucose->unix_time * 1000,
+        .sgv = (uint16_t)glucose->value_mgdl,
+        .trend = (uint8_t)glucose->trend,
+    };
+
+    xSemaphoreTake(ns_mutex, portMAX_DELAY);
+    if (enabled_locked() && nightscout_queue_push(&queue, &entry)) {
+        queue_dirty = true;
+    }
+    xSemaphoreGive(ns_mutex);
+}
+
+static esp_err_t post_entries(const char *url, const char *secret_hash, const char *body)
+{
+    esp_http_client_config_t config = {
+        .url = url,
+        .method = HTTP_METHOD_POST,
+        .timeout_ms = 10000,
+        .user_agent = "ESP32-Glucose-Monitor/1.0",
+        .crt_bundle_attach = esp_crt_bundle_attach,
+    };
+
+    esp_http_client_handle_t client = esp_http_client_init(&config);
+    if (!client) {
+        return ESP_ERR_NO_MEM;
+    }
+    esp_http_client_set_header(client, "Content-Type", "application/json");
+    esp_http_client_set_header(client, "Accept", "application/json");
+    esp_http_client_set_header(client, "api-secret", secret_hash);
+    esp_http_client_set_post_field(client, body, strlen(body));
+
+    power_lock_acquire(POWER_LOCK_NETWORK);
+    esp_err_t err = esp_http_client_perform(client);
+    power_lock_release(POWER_LOCK_NETWORK);
+    if (err == ESP_OK) {
+        int status = esp_http_client_get_status_code(client);
+        if (status < 200 || status >= 300) {
+            ESP_LOGW(TAG, "Upload rejected: HTTP %d%s", status,
+                     status == 401 ? " (check the API secret)" : "");
+            err = ESP_FAIL;
+        }
+    } else {
+        ESP_LOGW(TAG, "Upload failed: %s", esp_err_to_name(err));
+    }
+    esp_http_client_cleanup(client);
+    return err;
+}
+
+esp_err_t nightscout_flush(void)
+{
+    if (!ns_mutex) {
+        return ESP_OK;
+    }
+
+    char url[NIGHTSCOUT_URL_MAX_LEN + sizeof(NS_ENTRIES_PATH)];
+    char secret_hash[NS_SECRET_HASH_LEN + 1];
+    char *body = NULL;
+    esp_err_t result = ESP_OK;
+
+    xSemaphoreTake(ns_mutex, portMAX_DELAY);
+    while (enabled_locked() && queue.count > 0) {
+        if (esp_timer_get_time() < next_attempt_us) {
+            result = ESP_ERR_INVALID_STATE;
+            break;
+        }
+        if (!body && !(body = malloc(NS_BATCH_BUF_SIZE))) {
+            result = ESP_ERR_NO_MEM;
+            break;
+        }
+
+        size_t batch = nightscout_queue_format_batch(&queue, NIGHTSCOUT_BATCH_MAX, DEVICE_NAME_SHORT,
+                                                     body, NS_BATCH_BUF_SIZE);
+        if (batch == 0) {
+            result = ESP_ERR_INVALID_SIZE;
+            break;
+        }
+        snprintf(url, sizeof(url), "%s%s", ns_url, NS_ENTRIES_PATH);
+        snprintf(secret_hash, sizeof(secret_hash), "%s", ns_secret_hash);
+        uint32_t generation = config_generation;
+        xSemaphoreGive(ns_mutex);
+
+        esp_err_t err = post_entries(url, secret_hash, body);
+
+        xSemaphoreTake(ns_mutex, portMAX_DELAY);
+        if (generation != config_generation) {
+            continue;  // Site changed mid-upload; start over with the new one
+        }
+        if (err != ESP_OK) {
+            failures++;
+            uint32_t delay_s = nightscout_backoff_seconds(failures);
+            next_attempt_us = esp_timer_get_time() + (int64_t)delay_s * 1000000;
+            ESP_LOGW(TAG, "%u readings pending, retrying in %lu s",
+                     (unsigned)queue.count, (unsigned long)delay_s);
+            result = ESP_FAIL;
+            break;
+        }
+
+        ESP_LOGI(TAG, "Uploaded %u readings", (unsigned)batch);
+        nightscout_queue_ack(&queue, batch);
+        queue_dirty = true;
+        failures = 0;
+        next_attempt_us = 0;
+    }
+
+    save_queue_locked();
+    xSemaphoreGive(ns_mutex);
+    free(body);
+    return result;
+}
@@ -0,0 +1,77 @@
+/**
+ * Nightscout Uploader
+ * Optional upload of each new reading to a Nightscout site
+ *
+ * Readings are queued by nightscout_submit() and sent in batches to
+ * <url>/api/v1/entries by nightscout_flush(). The glucose task calls both
+ * right after each poll, so uploads ride on the poll's radio-on window
+ * instead of waking Wi-Fi on their own schedule.
+ *
+ * Readings are deduplicated by timestamp. If the site can't be reached
+ * the queue (NIGHTSCOUT_QUEUE_CAPACITY readings) is saved to NVS so an
+ * outage or reboot doesn't lose data, and further attempts back off
+ * exponentially; a flush before the backoff has expired does nothing.
+ * In normal operation the queue drains on every poll and NVS isn't
+ * written at all.
+ */
+
+#ifndef NIGHTSCOUT_H
+#define NIGHTSCOUT_H
+
+#include "esp_err.h"
+#include "librelinkup.h"
+#include "nightscout_queue.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+// Longest site URL (e.g. "https://example.herokuapp.com")
+#define NIGHTSCOUT_URL_MAX_LEN      127
+
+// Longest API secret (Nightscout requires at least 12 characters)
+#define NIGHTSCOUT_SECRET_MAX_LEN   63
+
+/**
+ * Load the configuration and any readings saved during an outage
+ * @return ESP_OK on success
+ */
+esp_err_t nightscout_init(void);
+
+/**
+ * Save the site configuration
+ * Only the SHA-1 of the API secret is stored, which is what Nightscout
+ * expects in the api-secret header.
+ *
+ * @param url Site URL; empty disables uploads and drops queued readings
+ * @param api_secret API secret; NULL or empty keeps the stored one
+ * @return ESP_OK on success
+ */
+esp_err_t nightscout_config_save(const char *url, const char *api_secret);
+
+/**
+ * Get the configured site URL
+ * @param url Output buffer (empty string when disabled)
+ * @param size Size of url
+ * @return true if uploads are enabled (URL and secret are both set)
+ */
+bool nightscout_get_config(char *url, size_t size);
+
+/**
+ * Queue a reading for upload
+ * Does nothing when uploads are disabled or the reading has no timestamp.
+ *
+ * @param glucose Reading
+ */
+void nightscout_submit(const libre_glucose_data_t *glucose);
+
+/**
+ * Upload queued readings
+ * Call while the network is up. Sends batches until the queue is empty
+ * or a request fails.
+ *
+ * @return ESP_OK if the queue is empty afterwards (or uploads are
+ *         disabled), ESP_ERR_INVALID_STATE while backing off, ESP_FAIL
+ *         if an upload failed
+ */
+esp_err_t nightscout_flush(void);
+
+#endif // NIGHTSCOUT_H
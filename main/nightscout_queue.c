@@ -0,0 +1,177 @@
+/**
+ * Nightscout Upload Queue Implementation
+ */
+
+#include "nightscout_queue.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define QUEUE_BLOB_VERSION  1
+
+void nightscout_queue_init(nightscout_queue_t *queue)
+{
+    memset(queue, 0, sizeof(*queue));
+}
+
+bool nightscout_queue_push(nightscout_queue_t *queue, const nightscout_entry_t *entry)
+{
+    if (entry->date_ms <= 0 || entry->date_ms <= queue->last_sent_ms) {
+        return false;
+    }
+    for (size_t i = 0; i < queue->count; i++) {
+        if (queue->entries[i].date_ms == entry->date_ms) {
+            return false;
+        }
+    }
+
+    if (queue->count == NIGHTSCOUT_QUEUE_CAPACITY) {
+        memmove(&queue->entries[0], &queue->entries[1],
+                (NIGHTSCOUT_QUEUE_CAPACITY - 1) * sizeof(queue->entries[0]));
+        queue->count--;
+    }
+
+    // Keep time order; out-of-order readings are rare, so insertion from the end is cheap
+    size_t pos = queue->count;
+    while (pos > 0 && queue->entries[pos - 1].date_ms > entry->date_ms) {
+        pos--;
+    }
+    memmove(&queue->entries[pos + 1], &queue->entries[pos],
+            (queue->count - pos) * sizeof(queue->entries[0]));
+    queue->entries[pos] = *entry;
+    queue->count++;
+    return true;
+}
+
+size_t nightscout_queue_format_batch(const nightscout_queue_t *queue, size_t max_entries,
+                                     const char *device, char *buf, size_t size)
+{
+    if (size < 3) {
+        return 0;
+    }
+
+    size_t len = 1;
+    size_t n = 0;
+    buf[0] = '[';
+
+    while (n < queue->count && n < max_entries) {
+        const nightscout_entry_t *e = &queue->entries[n];
+        time_t secs = (time_t)(e->date_ms / 1000);
+        struct tm tm;
+        char date_string[32];
+        gmtime_r(&secs, &tm);
+        strftime(date_string, sizeof(date_string), "%Y-%m-%dT%H:%M:%S.000Z", &tm);
+
+        int written = snprintf(buf + len, size - len,
+                               "%s{\"type\":\"sgv\",\"sgv\":%u,\"date\":%lld,\"dateString\":\"%s\","
+                               "\"direction\":\"%s\",\"device\":\"%s\"}",
+                               n ? "," : "", (unsigned)e->sgv, (long long)e->date_ms, date_string,
+                               nightscout_direction(e->trend), device);
+        // Leave room for the closing bracket
+        if (written < 0 || (size_t)written + 1 >= size - len) {
+            break;
+        }
+        len += written;
+        n++;
+    }
+
+    buf[len++] = ']';
+    buf[len] = '\0';
+    return n;
+}
+
+void nightscout_queue_ack(nightscout_queue_t *queue, size_t count)
+{
+    if (count > queue->count) {
+        count = queue->count;
+    }
+    if (count == 0) {
+        return;
+    }
+    queue->last_sent_ms = queue->entries[count - 1].date_ms;
+    memmove(&queue->entries[0], &queue->entries[count],
+            (queue->count - count) * sizeof(queue->entries[0]));
+    queue->count -= count;
+}
+
+uint32_t nightscout_backoff_seconds(uint32_t failures)
+{
+    uint32_t delay = NIGHTSCOUT_BACKOFF_MIN_S;
+    while (failures > 1 && delay < NIGHTSCOUT_BACKOFF_MAX_S) {
+        delay *= 2;
+        failures--;
+    }
+    return delay < NIGHTSCOUT_BACKOFF_MAX_S ? delay : NIGHTSCOUT_BACKOFF_MAX_S;
+}
+
+static void put_le(uint8_t *p, uint64_t value, size_t bytes)
+{
+    for (size_t i = 0; i < bytes; i++) {
+        p[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+static uint64_t get_le(const uint8_t *p, size_t bytes)
+{
+    uint64_t value = 0;
+    for (size_t i = 0; i < bytes; i++) {
+        value |= (uint64_t)p[i] << (8 * i);
+    }
+    return value;
+}
+
+// Blob: version (1), count (1), last_sent_ms (8), then per entry date_ms (8), sgv (2), trend (1)
+size_t nightscout_queue_serialize(const nightscout_queue_t *queue, uint8_t *blob, size_t size)
+{
+    size_t needed = NIGHTSCOUT_QUEUE_BLOB_HEADER + queue->count * NIGHTSCOUT_QUEUE_BLOB_ENTRY;
+    if (size < needed) {
+        return 0;
+    }
+
+    blob[0] = QUEUE_BLOB_VERSION;
+    blob[1] = (uint8_t)queue->count;
+    put_le(blob + 2, (uint64_t)queue->last_sent_ms, 8);
+
+    uint8_t *p = blob + NIGHTSCOUT_QUEUE_BLOB_HEADER;
+    for (size_t i = 0; i < queue->count; i++) {
+        put_le(p, (uint64_t)queue->entries[i].date_ms, 8);
+        put_le(p + 8, queue->entries[i].sgv, 2);
+        p[10] = queue->entries[i].trend;
+        p += NIGHTSCOUT_QUEUE_BLOB_ENTRY;
+    }
+    return needed;
+}
+
+bool nightscout_queue_deserialize(nightscout_queue_t *queue, const uint8_t *blob, size_t size)
+{
+    nightscout_queue_init(queue);
+    if (size < NIGHTSCOUT_QUEUE_BLOB_HEADER || blob[0] != QUEUE_BLOB_VERSION) {
+        return false;
+    }
+
+    size_t count = blob[1];
+    if (count > NIGHTSCOUT_QUEUE_CAPACITY ||
+        size != NIGHTSCOUT_QUEUE_BLOB_HEADER + count * NIGHTSCOUT_QUEUE_BLOB_ENTRY) {
+        return false;
+    }
+
+    queue->last_sent_ms = (int64_t)get_le(blob + 2, 8);
+    const uint8_t *p = blob + NIGHTSCOUT_QUEUE_BLOB_HEADER;
+    for (size_t i = 0; i < count; i++) {
+        queue->entries[i].date_ms = (int64_t)get_le(p, 8);
+        queue->entries[i].sgv = (uint16_t)get_le(p + 8, 2);
+        queue->entries[i].trend = p[10];
+        p += NIGHTSCOUT_QUEUE_BLOB_ENTRY;
+    }
+    queue->count = count;
+    return true;
+}
+
+const char* nightscout_direction(uint8_t trend)
+{
+    // Indexed by libre_trend_t
+    static const char *const directions[] = {
+        "NOT COMPUTABLE", "SingleDown", "FortyFiveDown", "Flat", "FortyFiveUp", "SingleUp"
+    };
+    return trend < sizeof(directions) / sizeof(directions[0]) ? directions[trend] : "NONE";
+}
@@ -0,0 +1,106 @@
+/**
+ * Nightscout Upload Queue
+ * Pending readings for the Nightscout uploader, oldest first
+ *
+ * Plain C with no ESP-IDF dependencies so the batching, dedup, retry
+ * and persistence logic can be built and tested on a Linux host. The
+ * uploader (nightscout.c) owns the queue and does all I/O.
+ */
+
+#ifndef NIGHTSCOUT_QUEUE_H
+#define NIGHTSCOUT_QUEUE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Pending readings kept across outages (4 hours at the default 5 minute interval)
+#define NIGHTSCOUT_QUEUE_CAPACITY       48
+
+// Readings per POST
+#define NIGHTSCOUT_BATCH_MAX            12
+
+// Retry delay after the first failure, doubled per failure up to the max
+#define NIGHTSCOUT_BACKOFF_MIN_S        60
+#define NIGHTSCOUT_BACKOFF_MAX_S        3600
+
+// Serialized size of a full queue
+#define NIGHTSCOUT_QUEUE_BLOB_HEADER    10
+#define NIGHTSCOUT_QUEUE_BLOB_ENTRY     11
+#define NIGHTSCOUT_QUEUE_BLOB_MAX       (NIGHTSCOUT_QUEUE_BLOB_HEADER + \
+                                         NIGHTSCOUT_QUEUE_CAPACITY * NIGHTSCOUT_QUEUE_BLOB_ENTRY)
+
+// One reading
+typedef struct {
+    int64_t date_ms;        // Measurement time, milliseconds since the epoch (UTC)
+    uint16_t sgv;           // Glucose in mg/dL
+    uint8_t trend;          // libre_trend_t
+} nightscout_entry_t;
+
+typedef struct {
+    nightscout_entry_t entries[NIGHTSCOUT_QUEUE_CAPACITY];
+    size_t count;
+    int64_t last_sent_ms;   // Newest reading accepted by the server
+} nightscout_queue_t;
+
+/**
+ * Empty the queue and forget the last sent reading
+ */
+void nightscout_queue_init(nightscout_queue_t *queue);
+
+/**
+ * Add a reading
+ * Readings already queued or not newer than the last sent one are
+ * ignored (the poll often returns the same reading twice). A full
+ * queue drops its oldest reading.
+ *
+ * @return true if the reading was added
+ */
+bool nightscout_queue_push(nightscout_queue_t *queue, const nightscout_entry_t *entry);
+
+/**
+ * Format the oldest readings as a Nightscout entries JSON array
+ *
+ * @param device "device" field of each entry
+ * @param buf Output buffer
+ * @param size Size of buf
+ * @return Number of readings in the batch (at most max_entries, 0 if the
+ *         queue is empty or not even one fits in buf)
+ */
+size_t nightscout_queue_format_batch(const nightscout_queue_t *queue, size_t max_entries,
+                                     const char *device, char *buf, size_t size);
+
+/**
+ * Remove the oldest readings after the server accepted them
+ */
+void nightscout_queue_ack(nightscout_queue_t *queue, size_t count);
+
+/**
+ * Delay before the next attempt after consecutive failures
+ *
+ * @param failures Consecutive failed attempts (at least 1)
+ * @return Delay in seconds
+ */
+uint32_t nightscout_backoff_seconds(uint32_t failures);
+
+/**
+ * Serialize for storage (little-endian, versioned)
+ *
+ * @param blob Output buffer, NIGHTSCOUT_QUEUE_BLOB_MAX bytes is always enough
+ * @return Bytes written, 0 if blob is too small
+ */
+size_t nightscout_queue_serialize(const nightscout_queue_t *queue, uint8_t *blob, size_t size);
+
+/**
+ * Restore a serialized queue
+ *
+ * @return true on success; on a malformed blob the queue is left empty
+ */
+bool nightscout_queue_deserialize(nightscout_queue_t *queue, const uint8_t *blob, size_t size);
+
+/**
+ * Nightscout direction name for a libre_trend_t value
+ */
+const char* nightscout_direction(uint8_t trend);
+
+#endif // NIGHTSCOUT_QUEUE_H
@@ -0,0 +1,421 @@
+/**
+ * NVS Write Journal Implementation
+ */
+
+#include "nvs_journal.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "NVS_JOURNAL";
+
+#define NVS_NAME_MAX 16  // 15 chars + null terminator (NVS limit)
+#define FLUSH_TASK_STACK    3072
+#define FLUSH_TASK_PRIORITY 2
+
+typedef enum {
+    JOURNAL_OP_STR,
+    JOURNAL_OP_U8,
+    JOURNAL_OP_BLOB,
+    JOURNAL_OP_ERASE,
+} journal_op_t;
+
+typedef struct {
+    bool used;
+    bool written;       // Set, waiting for the namespace's commit
+    char ns[NVS_NAME_MAX];
+    char key[NVS_NAME_MAX];
+    journal_op_t op;
+    char *str_value;    // Heap copy for JOURNAL_OP_STR
+    uint8_t *blob_value;  // Heap copy for JOURNAL_OP_BLOB
+    size_t blob_len;
+    uint8_t u8_value;
+} journal_entry_t;
+
+static journal_entry_t entries[NVS_JOURNAL_MAX_ENTRIES];
+static nvs_journal_stats_t stats = {0};
+static SemaphoreHandle_t journal_mutex = NULL;
+static esp_timer_handle_t flush_timer = NULL;
+static TaskHandle_t flush_task_handle = NULL;
+
+/**
+ * Deferred flush (runs in the esp_timer task, which must not wait for flash)
+ */
+static void flush_timer_callback(void *arg)
+{
+    xTaskNotifyGive(flush_task_handle);
+}
+
+static void flush_task(void *arg)
+{
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        nvs_journal_flush();
+    }
+}
+
+static void entry_clear(journal_entry_t *entry)
+{
+    free(entry->str_value);
+    free(entry->blob_value);
+    memset(entry, 0, sizeof(*entry));
+}
+
+/**
+ * Check whether NVS already holds the staged value
+ */
+static bool entry_matches_nvs(nvs_handle_t handle, const journal_entry_t *entry)
+{
+    switch (entry->op) {
+        case JOURNAL_OP_STR: {
+            size_t len = 0;
+            if (nvs_get_str(handle, entry->key, NULL, &len) != ESP_OK || len != strlen(entry->str_value) + 1) {
+                return false;
+            }
+            char *stored = malloc(len);
+            if (!stored) {
+                return false;
+            }
+            bool same = (nvs_get_str(handle, entry->key, stored, &len) == ESP_OK &&
+                         strcmp(stored, entry->str_value) == 0);
+            free(stored);
+            return same;
+        }
+        case JOURNAL_OP_U8: {
+            uint8_t stored = 0;
+            return nvs_get_u8(handle, entry->key, &stored) == ESP_OK && stored == entry->u8_value;
+        }
+        case JOURNAL_OP_BLOB: {
+            size_t len = 0;
+            if (nvs_get_blob(handle, entry->key, NULL, &len) != ESP_OK || len != entry->blob_len) {
+                return false;
+            }
+            uint8_t *stored = malloc(len ? len : 1);
+            if (!stored) {
+                return false;
+            }
+            bool same = (nvs_get_blob(handle, entry->key, stored, &len) == ESP_OK &&
+                         memcmp(stored, entry->blob_value, len) == 0);
+            free(stored);
+            return same;
+        }
+        case JOURNAL_OP_ERASE:
+            // nvs_erase_key reports NOT_FOUND without touching flash
+            return false;
+    }
+    return false;
+}
+
+/**
+ * Flush one namespace (caller holds the mutex)
+ */
+static esp_err_t flush_namespace(const char *ns)
+{
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(ns, NVS_READWRITE, &handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to open namespace %s: %s", ns, esp_err_to_name(err));
+        return err;
+    }
+
+    int written = 0;
+    for (int i = 0; i < NVS_JOURNAL_MAX_ENTRIES; i++) {
+        journal_entry_t *entry = &entries[i];
+        if (!entry->used || strcmp(entry->ns, ns) != 0) {
+            continue;
+        }
+
+        if (entry_matches_nvs(handle, entry)) {
+            stats.unchanged++;
+            entry_clear(entry);
+            continue;
+        }
+
+        esp_err_t set_err = ESP_OK;
+        switch (entry->op) {
+            case JOURNAL_OP_STR:
+                set_err = nvs_set_str(handle, entry->key, entry->str_value);
+                break;
+            case JOURNAL_OP_U8:
+                set_err = nvs_set_u8(handle, entry->key, entry->u8_value);
+                break;
+            case JOURNAL_OP_BLOB:
+                set_err = nvs_set_blob(handle, entry->key, entry->blob_value, entry->blob_len);
+                break;
+            case JOURNAL_OP_ERASE:
+                set_err = nvs_erase_key(handle, entry->key);
+                if (set_err == ESP_ERR_NVS_NOT_FOUND) {
+                    stats.unchanged++;
+                    entry_clear(entry);
+                    continue;
+                }
+                break;
+        }
+
+        if (set_err != ESP_OK) {
+            // Stop here so no key is stored without the ones staged before it;
+            // this entry and the rest stay staged for the next flush
+            ESP_LOGW(TAG, "Failed to write %s/%s: %s", ns, entry->key, esp_err_to_name(set_err));
+            err = set_err;
+            break;
+        }
+        stats.writes++;
+        written++;
+        entry->written = true;
+    }
+
+    if (written > 0) {
+        esp_err_t commit_err = nvs_commit(handle);
+        stats.commits++;
+        if (commit_err != ESP_OK) {
+            ESP_LOGE(TAG, "Commit failed for %s: %s", ns, esp_err_to_name(commit_err));
+            if (err == ESP_OK) {
+                err = commit_err;
+            }
+        }
+        // Written entries are done once committed, and written again otherwise
+        for (int i = 0; i < NVS_JOURNAL_MAX_ENTRIES; i++) {
+            if (entries[i].written) {
+                if (commit_err == ESP_OK) {
+                    entry_clear(&entries[i]);
+                } else {
+                    entries[i].written = false;
+                }
+            }
+        }
+    }
+
+    nvs_close(handle);
+    return err;
+}
+
+/**
+ * Flush every namespace once (caller holds the mutex)
+ * A namespace that fails keeps its unwritten entries staged for a retry.
+ */
+static esp_err_t flush_locked(void)
+{
+    esp_err_t err = ESP_OK;
+    bool had_entries = false;
+    char tried[NVS_JOURNAL_MAX_ENTRIES][NVS_NAME_MAX];
+    int tried_count = 0;
+
+    for (int i = 0; i < NVS_JOURNAL_MAX_ENTRIES; i++) {
+        if (!entries[i].used) {
+            continue;
+        }
+        bool seen = false;
+        for (int t = 0; t < tried_count && !seen; t++) {
+            seen = strcmp(tried[t], entries[i].ns) == 0;
+        }
+        if (seen) {
+            continue;
+        }
+        had_entries = true;
+        strncpy(tried[tried_count], entries[i].ns, NVS_NAME_MAX);
+        esp_err_t ns_err = flush_namespace(tried[tried_count++]);
+        if (ns_err != ESP_OK && err == ESP_OK) {
+            err = ns_err;
+        }
+    }
+
+    if (had_entries) {
+        stats.flushes++;
+        ESP_LOGI(TAG, "Flushed: %lu writes, %lu commits, %lu unchanged, %lu coalesced since boot",
+                 stats.writes, stats.commits, stats.unchanged, stats.coalesced);
+    }
+    return err;
+}
+
+/**
+ * Find or allocate the entry for ns/key (caller holds the mutex)
+ * @return NULL if the journal is full and flushing it failed
+ */
+static journal_entry_t* entry_for_key(const char *ns, const char *key)
+{
+    journal_entry_t *free_entry = NULL;
+
+    for (int i = 0; i < NVS_JOURNAL_MAX_ENTRIES; i++) {
+        if (entries[i].used) {
+            if (strcmp(entries[i].ns, ns) == 0 && strcmp(entries[i].key, key) == 0) {
+                stats.coalesced++;
+                free(entries[i].str_value);
+                entries[i].str_value = NULL;
+                free(entries[i].blob_value);
+                entries[i].blob_value = NULL;
+                return &entries[i];
+            }
+        } else if (!free_entry) {
+            free_entry = &entries[i];
+        }
+    }
+
+    if (!free_entry) {
+        // Journal full - make room by flushing what we have
+        ESP_LOGW(TAG, "Journal full, flushing early");
+        flush_locked();
+        for (int i = 0; i < NVS_JOURNAL_MAX_ENTRIES && !free_entry; i++) {
+            if (!entries[i].used) {
+                free_entry = &entries[i];
+            }
+        }
+        if (!free_entry) {
+            return NULL;
+        }
+    }
+
+    free_entry->used = true;
+    strncpy(free_entry->ns, ns, sizeof(free_entry->ns) - 1);
+    strncpy(free_entry->key, key, sizeof(free_entry->key) - 1);
+    return free_entry;
+}
+
+static esp_err_t stage(const char *ns, const char *key, journal_op_t op, const char *str_value,
+                       const void *blob_value, size_t blob_len, uint8_t u8_value)
+{
+    if (!ns || !key || strlen(ns) >= NVS_NAME_MAX || strlen(key) >= NVS_NAME_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (!journal_mutex) {
+        ESP_LOGE(TAG, "Journal not initialized");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    char *copy = NULL;
+    if (op == JOURNAL_OP_STR) {
+        copy = strdup(str_value);
+        if (!copy) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    uint8_t *blob_copy = NULL;
+    if (op == JOURNAL_OP_BLOB) {
+        blob_copy = malloc(blob_len ? blob_len : 1);
+        if (!blob_copy) {
+            return ESP_ERR_NO_MEM;
+        }
+        memcpy(blob_copy, blob_value, blob_len);
+    }
+
+    xSemaphoreTake(journal_mutex, portMAX_DELAY);
+    journal_entry_t *entry = entry_for_key(ns, key);
+    if (!entry) {
+        xSemaphoreGive(journal_mutex);
+        free(copy);
+        free(blob_copy);
+        ESP_LOGE(TAG, "Journal full and flash writes failing, %s/%s not staged", ns, key);
+        return ESP_FAIL;
+    }
+    entry->written = false;
+    entry->op = op;
+    entry->str_value = copy;
+    entry->blob_value = blob_copy;
+    entry->blob_len = blob_len;
+    entry->u8_value = u8_value;
+    stats.staged++;
+    xSemaphoreGive(journal_mutex);
+
+    // Arm the deferred flush (no-op if already armed)
+    if (flush_timer) {
+        esp_timer_start_once(flush_timer, (uint64_t)NVS_JOURNAL_FLUSH_DELAY_MS * 1000);
+    }
+    return ESP_OK;
+}
+
+esp_err_t nvs_journal_init(void)
+{
+    if (journal_mutex) {
+        return ESP_OK;
+    }
+
+    journal_mutex = xSemaphoreCreateMutex();
+    if (!journal_mutex) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_err_t err = ESP_ERR_NO_MEM;
+    if (xTaskCreate(flush_task, "nvs_journal", FLUSH_TASK_STACK, NULL, FLUSH_TASK_PRIORITY,
+                    &flush_task_handle) == pdPASS) {
+        esp_timer_create_args_t timer_args = {
+            .callback = flush_timer_callback,
+            .name = "nvs_journal"
+        };
+        err = esp_timer_create(&timer_args, &flush_timer);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Deferred flush unavailable: %s", esp_err_to_name(err));
+    }
+
+    ESP_LOGI(TAG, "NVS write journal initialized (%d entries)", NVS_JOURNAL_MAX_ENTRIES);
+    return ESP_OK;
+}
+
+esp_err_t nvs_journal_set_str(const char *ns, const char *key, const char *value)
+{
+    if (!value) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return stage(ns, key, JOURNAL_OP_STR, value, NULL, 0, 0);
+}
+
+esp_err_t nvs_journal_set_u8(const char *ns, const char *key, uint8_t value)
+{
+    return stage(ns, key, JOURNAL_OP_U8, NULL, NULL, 0, value);
+}
+
+esp_err_t nvs_journal_set_blob(const char *ns, const char *key, const void *value, size_t len)
+{
+    if (!value && len > 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return stage(ns, key, JOURNAL_OP_BLOB, NULL, value, len, 0);
+}
+
+esp_err_t nvs_journal_erase(const char *ns, const char *key)
+{
+    return stage(ns, key, JOURNAL_OP_ERASE, NULL, NULL, 0, 0);
+}
+
+esp_err_t nvs_journal_flush(void)
+{
+    if (!journal_mutex) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (flush_timer) {
+        esp_timer_stop(flush_timer);
+    }
+
+    xSemaphoreTake(journal_mutex, portMAX_DELAY);
+    esp_err_t err = flush_locked();
+    bool pending = false;
+    for (int i = 0; i < NVS_JOURNAL_MAX_ENTRIES && !pending; i++) {
+        pending = entries[i].used;
+    }
+    xSemaphoreGive(journal_mutex);
+
+    // Whatever failed is tried again later
+    if (pending && flush_timer) {
+        esp_timer_start_once(flush_timer, (uint64_t)NVS_JOURNAL_RETRY_DELAY_MS * 1000);
+    }
+    return err;
+}
+
+void nvs_journal_get_stats(nvs_journal_stats_t *out)
+{
+    if (!out) {
+        return;
+    }
+    if (journal_mutex) {
+        xSemaphoreTake(journal_mutex, portMAX_DELAY);
+    }
+    *out = stats;
+    if (journal_mutex) {
+        xSemaphoreGive(journal_mutex);
+    }
+}
@@ -0,0 +1,106 @@
+/**
+ * NVS Write Journal
+ * Batches NVS writes, drops unchanged values and commits once per namespace
+ *
+ * Flush policy:
+ *  - Callers flush explicitly at the end of a logical transaction
+ *    (e.g. after a login has stored its token, URL and account id)
+ *  - Staged writes are flushed automatically NVS_JOURNAL_FLUSH_DELAY_MS
+ *    after the first one if nobody flushed them (from the journal's own
+ *    task, not the esp_timer task)
+ *  - A full journal flushes before accepting a new key
+ *  - Entries a flush could not write stay staged and are retried
+ *    NVS_JOURNAL_RETRY_DELAY_MS later, or by the next flush
+ *
+ * Within a namespace, keys are written in the order they were first
+ * staged since the last flush, and a failed write ends that namespace's
+ * flush. A key is therefore never stored without the keys staged before
+ * it, so a caller can order dependent values (e.g. clear data that
+ * belongs to an old setting before storing the new setting).
+ */
+
+#ifndef NVS_JOURNAL_H
+#define NVS_JOURNAL_H
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Maximum number of distinct keys staged between flushes
+#define NVS_JOURNAL_MAX_ENTRIES 8
+
+// Deferred flush delay for staged writes nobody flushed explicitly
+#define NVS_JOURNAL_FLUSH_DELAY_MS 2000
+
+// Delay before retrying entries a flush could not write
+#define NVS_JOURNAL_RETRY_DELAY_MS 30000
+
+/**
+ * Journal statistics (since boot)
+ */
+typedef struct {
+    uint32_t staged;          // Values handed to the journal
+    uint32_t coalesced;       // Staged values replaced before reaching flash
+    uint32_t unchanged;       // Values skipped because NVS already held them
+    uint32_t writes;          // nvs_set_* / nvs_erase_key calls that hit flash
+    uint32_t commits;         // nvs_commit calls
+    uint32_t flushes;         // Journal flushes that had pending entries
+} nvs_journal_stats_t;
+
+/**
+ * Initialize the journal
+ * Call once after nvs_flash_init()
+ * @return ESP_OK on success
+ */
+esp_err_t nvs_journal_init(void);
+
+/**
+ * Stage a string value
+ * @param ns NVS namespace (max 15 chars)
+ * @param key NVS key (max 15 chars)
+ * @param value String value
+ * @return ESP_OK on success, ESP_FAIL if the journal is full and cannot be flushed
+ */
+esp_err_t nvs_journal_set_str(const char *ns, const char *key, const char *value);
+
+/**
+ * Stage a uint8 value
+ * @param ns NVS namespace (max 15 chars)
+ * @param key NVS key (max 15 chars)
+ * @param value Value
+ * @return ESP_OK on success, ESP_FAIL if the journal is full and cannot be flushed
+ */
+esp_err_t nvs_journal_set_u8(const char *ns, const char *key, uint8_t value);
+
+/**
+ * Stage a blob value (copied)
+ * @param ns NVS namespace (max 15 chars)
+ * @param key NVS key (max 15 chars)
+ * @param value Blob data
+ * @param len Blob length in bytes
+ * @return ESP_OK on success, ESP_FAIL if the journal is full and cannot be flushed
+ */
+esp_err_t nvs_journal_set_blob(const char *ns, const char *key, const void *value, size_t len);
+
+/**
+ * Stage erasing a key
+ * @param ns NVS namespace (max 15 chars)
+ * @param key NVS key (max 15 chars)
+ * @return ESP_OK on success, ESP_FAIL if the journal is full and cannot be flushed
+ */
+esp_err_t nvs_journal_erase(const char *ns, const char *key);
+
+/**
+ * Write all staged values and commit once per namespace
+ * @return ESP_OK on success, first error otherwise
+ */
+esp_err_t nvs_journal_flush(void);
+
+/**
+ * Get journal statistics
+ * @param stats Output buffer
+ */
+void nvs_journal_get_stats(nvs_journal_stats_t *stats);
+
+#endif // NVS_JOURNAL_H
@@ -7,40 +7,94 @@
 #include "wifi_manager.h"
 #include "esp_log.h"
 #include "esp_http_client.h"
-#include "esp_https_ota.h"
 #include "esp_ota_ops.h"
 #include "esp_system.h"
 #include "esp_crt_bundle.h"
-#include "cJSON.h"
+#include "delta_patch.h"
+#include "ota_writer.h"
+#include "assets.h"
+#include "miniz.h"
+#include "esp_image_format.h"
+#include "esp_partition.h"
+#include "mbedtls/sha256.h"
+#include "nvs.h"
+#include "esp_timer.h"
+#include "release_scanner.h"
+#include "power.h"
+#include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 
 static const char *TAG = "OTA_UPDATE";
 
-// Buffer for GitHub API response
-#define MAX_HTTP_RECV_BUFFER 8192
-static char http_recv_buffer[MAX_HTTP_RECV_BUFFER];
-static int http_recv_len = 0;
-
 // OTA progress tracking
 static ota_progress_callback_t global_progress_cb = NULL;
+static const char *progress_item = "firmware";  // What is being downloaded
+static int progress_last = -1;                  // Last percentage reported in this phase
 
-/**
- * HTTP event handler for GitHub API requests
- */
-static esp_err_t http_event_handler(esp_http_client_event_t *evt) {
-    switch (evt->event_id) {
-        case HTTP_EVENT_ON_DATA:
-            if (evt->data_len > 0 && (http_recv_len + evt->data_len) < MAX_HTTP_RECV_BUFFER) {
-                memcpy(http_recv_buffer + http_recv_len, evt->data, evt->data_len);
-                http_recv_len += evt->data_len;
-                http_recv_buffer[http_recv_len] = '\0';
-            }
-            break;
-        default:
-            break;
-    }
-    return ESP_OK;
-}
+// Resumable download: the image is written in flash-sector blocks (by the
+// ota_writer task), each read back before it counts, and the written offset
+// is checkpointed to NVS so a dropped connection (or a reboot) continues
+// with a Range request
+#define OTA_BLOCK_SIZE          4096                // One flash sector
+#define OTA_CHECKPOINT_BYTES    (64 * 1024)         // NVS write every 16 blocks
+#if CONFIG_SPIRAM
+#define OTA_HTTP_RX_BUFFER      (16 * 1024)         // One TLS record per read
+#else
+#define OTA_HTTP_RX_BUFFER      4096                // Keep moderate size to avoid OOM
+#endif
+#define OTA_MAX_RESUMES         10
+#define OTA_RESUME_BACKOFF_MAX_S 30
+#define OTA_MAX_REDIRECTS       5
+#define OTA_PATCH_READ_SIZE     1024
+#define OTA_RESUME_NAMESPACE    "ota_resume"
+#define OTA_RESUME_KEY          "state"
+#define OTA_RESUME_VERSION      1
+#define ASSETS_UPDATE_WAIT_MS   10000               // Longest asset playback to wait out
+
+// Release metadata: the assets picked from releases/latest are kept in NVS
+// with the response's ETag, so a check where nothing changed is a 304
+// without a body
+#define OTA_RELEASE_NAMESPACE   "ota_release"
+#define OTA_RELEASE_KEY         "latest"
+#define OTA_RELEASE_VERSION     1
+#define OTA_RELEASE_READ_SIZE   1024
+#define OTA_RELEASE_MAX_AGE_US  (10LL * 60 * 1000000)  // An install reuses a check this recent
+
+typedef struct {
+    uint32_t version;
+    uint32_t url_hash;          // Release asset the bytes came from
+    uint32_t partition_addr;    // Slot being written
+    uint32_t image_size;        // 0 until the first response
+    uint32_t written;           // Bytes written and verified, a multiple of OTA_BLOCK_SIZE until complete
+} ota_checkpoint_t;
+
+typedef struct {
+    uint32_t version;
+    char device_version[16];                // Firmware the assets were picked for
+    char etag[80];
+    char tag[RELEASE_SCAN_TAG_LEN];         // tag_name without the 'v'
+    char firmware_url[RELEASE_SCAN_URL_LEN];
+    char patch_url[RELEASE_SCAN_URL_LEN];   // Delta from this firmware, if published
+    char pack_url[RELEASE_SCAN_URL_LEN];    // Newest media pack, if any
+    uint32_t pack_version;
+    uint8_t firmware_sha256[32];
+    uint8_t pack_sha256[32];
+    bool have_firmware_sha256;
+    bool have_pack_sha256;
+} ota_release_t;
+
+typedef struct {
+    ota_release_t cached;
+    ota_release_t fresh;
+    release_scanner_t scanner;
+    char firmware_name[RELEASE_SCAN_NAME_LEN];  // Image picked so far, checked against the tag at the end
+    char buf[OTA_RELEASE_READ_SIZE];
+} release_fetch_t;
+
+// Latest release as of the last check, shared by check and install
+static ota_release_t release;
+static int64_t release_fetched_us = 0;      // 0 until a check succeeds
 
 /**
  * Compare semantic versions (e.g., "1.0.1" vs "1.0.0")
@@ -58,6 +112,26 @@ static int compare_versions(const char *v1, const char *v2) {
     return patch1 - patch2;
 }
 
+/**
+ * Version of a media pack release asset ("glucose-assets-v<N>.pack")
+ * @return N, or 0 if the file is not a media pack
+ */
+static uint32_t assets_pack_version(const char *filename) {
+    unsigned long version = 0;
+    int end = 0;
+    if (sscanf(filename, "glucose-assets-v%lu%n", &version, &end) != 1 || strcmp(filename + end, ".pack") != 0) {
+        return 0;
+    }
+    return (uint32_t)version;
+}
+
+/**
+ * The assets partition, or NULL on devices still on the old partition table
+ */
+static const esp_partition_t *find_assets_partition(void) {
+    return esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, ASSETS_PARTITION_LABEL);
+}
+
 esp_err_t ota_update_init(void) {
     ESP_LOGI(TAG, "OTA Update system initialized");
     ESP_LOGI(TAG, "Current firmware version: %s", DEVICE_VERSION);
@@ -76,254 +150,998 @@ esp_err_t ota_update_init(void) {
     return ESP_OK;
 }
 
-esp_err_t ota_check_for_update(char *new_version, size_t new_version_size) {
-    if (!wifi_manager_is_connected()) {
-        ESP_LOGW(TAG, "Cannot check for updates - WiFi not connected");
-        return ESP_FAIL;
+/**
+ * Start a new progress phase (a download or a patch), so its first
+ * percentage is always reported
+ */
+static void ota_progress_begin(void) {
+    progress_last = -1;
+}
+
+/**
+ * OTA progress handler - called during download/install
+ * Only reports when the percentage changes, as each report redraws the
+ * screen. With writer stats the message shows the transfer rate and how
+ * often the network waited for flash and flash for the network.
+ * @param phase What is happening to progress_item ("Downloading", "Installing")
+ */
+static void ota_progress_handler(const char *phase, size_t total_size, size_t current_size,
+                                 const ota_writer_stats_t *stats) {
+    if (total_size > 0 && global_progress_cb) {
+        int progress = (current_size * 100) / total_size;
+        if (progress == progress_last) {
+            return;
+        }
+        progress_last = progress;
+        
+        char message[96];
+        int len = snprintf(message, sizeof(message), "%s %s...", phase, progress_item);
+        if (stats && stats->elapsed_ms > 0) {
+            snprintf(message + len, sizeof(message) - len, "\n%lu KB/s, waits: flash %lu / net %lu",
+                     (unsigned long)((uint64_t)stats->bytes * 1000 / 1024 / stats->elapsed_ms),
+                     stats->reader_stalls, stats->writer_stalls);
+        }
+        global_progress_cb(progress, message);
+    }
+}
+
+/**
+ * FNV-1a hash identifying the release asset a checkpoint belongs to
+ */
+static uint32_t url_hash(const char *url) {
+    uint32_t hash = 2166136261u;
+    for (const char *p = url; *p; p++) {
+        hash = (hash ^ (uint8_t)*p) * 16777619u;
+    }
+    return hash;
+}
+
+static bool checkpoint_load(ota_checkpoint_t *checkpoint) {
+    nvs_handle_t handle;
+    if (nvs_open(OTA_RESUME_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        return false;
+    }
+    size_t len = sizeof(*checkpoint);
+    esp_err_t err = nvs_get_blob(handle, OTA_RESUME_KEY, checkpoint, &len);
+    nvs_close(handle);
+    return err == ESP_OK && len == sizeof(*checkpoint) && checkpoint->version == OTA_RESUME_VERSION &&
+           checkpoint->written <= checkpoint->image_size;
+}
+
+static void checkpoint_save(const ota_checkpoint_t *checkpoint) {
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(OTA_RESUME_NAMESPACE, NVS_READWRITE, &handle);
+    if (err == ESP_OK) {
+        err = nvs_set_blob(handle, OTA_RESUME_KEY, checkpoint, sizeof(*checkpoint));
+        if (err == ESP_OK) {
+            err = nvs_commit(handle);
+        }
+        nvs_close(handle);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to save OTA checkpoint: %s", esp_err_to_name(err));
+    }
+}
+
+static void checkpoint_clear(void) {
+    nvs_handle_t handle;
+    if (nvs_open(OTA_RESUME_NAMESPACE, NVS_READWRITE, &handle) == ESP_OK) {
+        nvs_erase_key(handle, OTA_RESUME_KEY);
+        nvs_commit(handle);
+        nvs_close(handle);
+    }
+}
+
+/**
+ * Parse a GitHub asset digest ("sha256:<64 hex>")
+ */
+static bool parse_sha256_digest(const char *digest, uint8_t sha256[32]) {
+    if (strncmp(digest, "sha256:", 7) != 0 || strlen(digest + 7) != 64) {
+        return false;
+    }
+    for (int i = 0; i < 32; i++) {
+        unsigned int byte;
+        if (sscanf(digest + 7 + i * 2, "%2x", &byte) != 1) {
+            return false;
+        }
+        sha256[i] = (uint8_t)byte;
+    }
+    return true;
+}
+
+/**
+ * Erase, write and read back one block
+ */
+static esp_err_t write_block(const esp_partition_t *partition, uint32_t offset, const uint8_t *data, size_t len) {
+    esp_err_t err = esp_partition_erase_range(partition, offset, OTA_BLOCK_SIZE);
+    if (err == ESP_OK) {
+        err = esp_partition_write(partition, offset, data, len);
     }
     
-    ESP_LOGI(TAG, "Checking for firmware updates from GitHub...");
-    ESP_LOGI(TAG, "API URL: %s", GITHUB_API_URL);
-    
-    // Reset buffer
-    http_recv_len = 0;
-    memset(http_recv_buffer, 0, sizeof(http_recv_buffer));
-    
-    // Configure HTTP client for GitHub API
+    uint8_t verify[256];
+    for (size_t done = 0; err == ESP_OK && done < len; done += sizeof(verify)) {
+        size_t n = len - done < sizeof(verify) ? len - done : sizeof(verify);
+        err = esp_partition_read(partition, offset + done, verify, n);
+        if (err == ESP_OK && memcmp(verify, data + done, n) != 0) {
+            err = ESP_ERR_INVALID_CRC;
+        }
+    }
+    return err;
+}
+
+/**
+ * Whether the first block of a download looks like what the partition
+ * holds: an app image, or an assets pack for the assets partition
+ */
+static bool image_header_valid(const esp_partition_t *partition, const uint8_t *block, size_t len) {
+    if (partition->type == ESP_PARTITION_TYPE_APP) {
+        return block[0] == ESP_IMAGE_HEADER_MAGIC;
+    }
+    uint32_t total_size = 0;
+    return assets_parse_header(block, len, NULL, &total_size) && total_size <= partition->size;
+}
+
+/**
+ * Open a GET request, following redirects (release assets redirect to a
+ * CDN; request headers such as Range are sent again)
+ */
+static esp_err_t open_following_redirects(esp_http_client_handle_t client, int64_t *content_length, int *status_code) {
+    for (int redirects = 0; ; redirects++) {
+        esp_err_t err = esp_http_client_open(client, 0);
+        if (err != ESP_OK) {
+            return err;
+        }
+        *content_length = esp_http_client_fetch_headers(client);
+        *status_code = esp_http_client_get_status_code(client);
+        bool redirect = *status_code == 301 || *status_code == 302 || *status_code == 303 ||
+                        *status_code == 307 || *status_code == 308;  // Not 304 Not Modified
+        if (!redirect || redirects >= OTA_MAX_REDIRECTS) {
+            return ESP_OK;
+        }
+        esp_http_client_flush_response(client, NULL);
+        esp_http_client_set_redirection(client);
+        esp_http_client_close(client);
+    }
+}
+
+/**
+ * Keep where a 206 response's Content-Range starts ("bytes 4096-8191/8192"),
+ * -1 if the response has none
+ */
+static esp_err_t download_event_handler(esp_http_client_event_t *evt) {
+    int64_t *range_start = evt->user_data;
+    if (evt->event_id == HTTP_EVENT_HEADERS_SENT) {
+        *range_start = -1;  // Each request, redirects included, starts afresh
+    } else if (evt->event_id == HTTP_EVENT_ON_HEADER && strcasecmp(evt->header_key, "Content-Range") == 0) {
+        long long start;
+        if (sscanf(evt->header_value, "bytes %lld-", &start) == 1 && start >= 0) {
+            *range_start = start;
+        }
+    }
+    return ESP_OK;
+}
+
+/**
+ * Download the rest of the image into the partition
+ * Starts at checkpoint->written (with a Range request). The connection
+ * is read into writer buffers while the writer task flashes earlier
+ * ones; checkpoint->written follows what the writer has verified.
+ * @param[out] fatal Set when retrying cannot help (bad image, flash error)
+ */
+static esp_err_t download_image(const char *url, const esp_partition_t *partition,
+                                ota_checkpoint_t *checkpoint, bool *fatal) {
+    int64_t range_start = -1;
     esp_http_client_config_t config = {
-        .url = GITHUB_API_URL,
-        .event_handler = http_event_handler,
-        .timeout_ms = 10000,
-        .user_agent = "ESP32-Glucose-Monitor/1.0",
+        .url = url,
+        .timeout_ms = 15000,  // A stalled link is cheap to drop now that we resume
+        .keep_alive_enable = true,
         .crt_bundle_attach = esp_crt_bundle_attach,
+        .buffer_size = OTA_HTTP_RX_BUFFER,
+        .buffer_size_tx = 2048,
+        .event_handler = download_event_handler,
+        .user_data = &range_start,
     };
     
     esp_http_client_handle_t client = esp_http_client_init(&config);
     if (!client) {
-        ESP_LOGE(TAG, "Failed to initialize HTTP client");
-        return ESP_FAIL;
+        return ESP_ERR_NO_MEM;
     }
+    power_lock_acquire(POWER_LOCK_NETWORK);
     
-    // Perform GET request
-    esp_err_t err = esp_http_client_perform(client);
-    int status_code = esp_http_client_get_status_code(client);
+    char range[32];
+    if (checkpoint->written > 0) {
+        snprintf(range, sizeof(range), "bytes=%lu-", checkpoint->written);
+        esp_http_client_set_header(client, "Range", range);
+    }
     
-    esp_http_client_cleanup(client);
+    int64_t content_length = 0;
+    int status_code = 0;
+    esp_err_t err = open_following_redirects(client, &content_length, &status_code);
     
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "HTTP GET request failed: %s", esp_err_to_name(err));
-        return err;
+    if (err == ESP_OK && status_code == 206 && range_start != (int64_t)checkpoint->written) {
+        // The bytes would land at the wrong offset; ask for the whole image
+        ESP_LOGW(TAG, "Server resumed at %lld instead of %lu, restarting download",
+                 (long long)range_start, checkpoint->written);
+        esp_http_client_close(client);
+        esp_http_client_delete_header(client, "Range");
+        checkpoint->written = 0;
+        err = open_following_redirects(client, &content_length, &status_code);
     }
     
-    if (status_code != 200) {
-        ESP_LOGE(TAG, "GitHub API returned status code: %d", status_code);
-        return ESP_FAIL;
+    if (err == ESP_OK) {
+        if (status_code == 200 && checkpoint->written > 0) {
+            // Server ignored the Range header; take the image from the start
+            ESP_LOGW(TAG, "Server does not support resume, restarting download");
+            checkpoint->written = 0;
+        } else if (status_code == 206 && range_start != (int64_t)checkpoint->written) {
+            ESP_LOGE(TAG, "Unexpected partial response from offset %lld", (long long)range_start);
+            err = ESP_ERR_INVALID_RESPONSE;
+        } else if (status_code != 200 && status_code != 206) {
+            ESP_LOGE(TAG, "Download returned status code: %d", status_code);
+            err = ESP_FAIL;
+        }
     }
     
-    // Parse JSON response
-    cJSON *json = cJSON_Parse(http_recv_buffer);
-    if (!json) {
-        ESP_LOGE(TAG, "Failed to parse GitHub API response");
-        return ESP_FAIL;
+    if (err == ESP_OK) {
+        uint64_t total = checkpoint->written + (content_length > 0 ? (uint64_t)content_length : 0);
+        if (content_length <= 0 || total > partition->size ||
+            (checkpoint->image_size && total != checkpoint->image_size)) {
+            ESP_LOGE(TAG, "Unexpected %s size: %lld bytes from offset %lu", progress_item, content_length, checkpoint->written);
+            checkpoint->written = 0;
+            checkpoint->image_size = 0;
+            err = ESP_ERR_INVALID_SIZE;
+            *fatal = true;
+        } else if (!checkpoint->image_size) {
+            checkpoint->image_size = (uint32_t)total;
+            ESP_LOGI(TAG, "Image size: %lu bytes", checkpoint->image_size);
+        }
     }
     
-    // Get tag name (version)
-    cJSON *tag_name = cJSON_GetObjectItem(json, "tag_name");
-    if (!tag_name || !cJSON_IsString(tag_name)) {
-        ESP_LOGE(TAG, "No tag_name found in GitHub response");
-        cJSON_Delete(json);
-        return ESP_FAIL;
+    ota_writer_t *writer = NULL;
+    if (err == ESP_OK) {
+        err = ota_writer_start(partition, checkpoint->written, checkpoint->image_size, &writer);
     }
     
-    // Remove 'v' prefix if present (e.g., "v1.0.1" -> "1.0.1")
-    const char *version_str = tag_name->valuestring;
-    if (version_str[0] == 'v' || version_str[0] == 'V') {
-        version_str++;
+    uint32_t received = checkpoint->written;    // Handed to the writer
+    uint32_t saved = checkpoint->written;
+    while (err == ESP_OK && received < checkpoint->image_size) {
+        uint8_t *buf = ota_writer_get_buffer(writer);
+        size_t want = checkpoint->image_size - received;
+        want = want < OTA_WRITER_BUFFER_SIZE ? want : OTA_WRITER_BUFFER_SIZE;
+        size_t fill = 0;
+        while (fill < want) {
+            int n = esp_http_client_read(client, (char *)buf + fill, want - fill);
+            if (n <= 0) {
+                err = n < 0 ? ESP_FAIL : ESP_ERR_TIMEOUT;  // Connection dropped mid-image
+                break;
+            }
+            fill += n;
+        }
+        if (err != ESP_OK) {
+            fill -= fill % OTA_BLOCK_SIZE;  // Keep the whole sectors; resume after them
+        }
+        
+        if (received == 0 && fill > 0 && !image_header_valid(partition, buf, fill)) {
+            ESP_LOGE(TAG, "Downloaded file is not a %s image", progress_item);
+            ota_writer_submit(writer, buf, 0);
+            err = ESP_ERR_IMAGE_INVALID;
+            *fatal = true;
+            break;
+        }
+        esp_err_t write_err = ota_writer_submit(writer, buf, fill);
+        received += fill;
+        if (write_err != ESP_OK) {
+            err = write_err;
+            *fatal = true;
+            break;
+        }
+        
+        ota_writer_stats_t stats;
+        ota_writer_get_stats(writer, &stats);
+        uint32_t written = ota_writer_get_offset(writer);
+        if (written / OTA_CHECKPOINT_BYTES != saved / OTA_CHECKPOINT_BYTES) {
+            checkpoint->written = written;
+            checkpoint_save(checkpoint);
+            saved = written;
+        }
+        ota_progress_handler("Downloading", checkpoint->image_size, written, &stats);
     }
     
-    ESP_LOGI(TAG, "Latest GitHub release: %s", version_str);
-    ESP_LOGI(TAG, "Current version: %s", DEVICE_VERSION);
+    if (writer) {
+        ota_writer_stats_t stats;
+        esp_err_t write_err = ota_writer_finish(writer, &stats, &checkpoint->written);
+        if (write_err != ESP_OK && !*fatal) {
+            err = write_err;
+            *fatal = true;
+        }
+        ESP_LOGI(TAG, "Wrote %lu bytes in %lu ms (flash waits %lu, network waits %lu)",
+                 stats.bytes, stats.elapsed_ms, stats.reader_stalls, stats.writer_stalls);
+    }
     
-    // Compare versions
-    if (compare_versions(version_str, DEVICE_VERSION) > 0) {
-        ESP_LOGI(TAG, "Update available! %s -> %s", DEVICE_VERSION, version_str);
-        if (new_version && new_version_size > 0) {
-            strncpy(new_version, version_str, new_version_size - 1);
-            new_version[new_version_size - 1] = '\0';
+    esp_http_client_close(client);
+    esp_http_client_cleanup(client);
+    power_lock_release(POWER_LOCK_NETWORK);
+    return err;
+}
+
+/**
+ * SHA-256 of the first size bytes of a partition
+ */
+static esp_err_t partition_sha256(const esp_partition_t *partition, uint32_t size, uint8_t sha256[32]) {
+    uint8_t buf[256];
+    esp_err_t err = ESP_OK;
+    
+    mbedtls_sha256_context ctx;
+    mbedtls_sha256_init(&ctx);
+    mbedtls_sha256_starts(&ctx, 0);
+    for (uint32_t offset = 0; err == ESP_OK && offset < size; offset += sizeof(buf)) {
+        size_t n = size - offset < sizeof(buf) ? size - offset : sizeof(buf);
+        err = esp_partition_read(partition, offset, buf, n);
+        if (err == ESP_OK) {
+            mbedtls_sha256_update(&ctx, buf, n);
         }
-        cJSON_Delete(json);
-        return ESP_OK;
-    } else {
-        ESP_LOGI(TAG, "Already running latest version");
-        cJSON_Delete(json);
-        return ESP_ERR_NOT_FOUND;
     }
+    mbedtls_sha256_finish(&ctx, sha256);
+    mbedtls_sha256_free(&ctx);
+    return err;
 }
 
 /**
- * OTA progress handler - called during download/install
+ * Hash the written image and compare it with the expected digest
  */
-static void ota_progress_handler(size_t total_size, size_t current_size) {
-    if (total_size > 0 && global_progress_cb) {
-        int progress = (current_size * 100) / total_size;
+static esp_err_t verify_partition_sha256(const esp_partition_t *partition, uint32_t size, const uint8_t expected[32]) {
+    uint8_t actual[32];
+    esp_err_t err = partition_sha256(partition, size, actual);
+    if (err == ESP_OK && memcmp(actual, expected, sizeof(actual)) != 0) {
+        ESP_LOGE(TAG, "SHA-256 of the written %s does not match the expected digest", progress_item);
+        err = ESP_ERR_INVALID_CRC;
+    }
+    return err;
+}
+
+// Target side of a delta update: patch output is gathered into flash blocks
+typedef struct {
+    const esp_partition_t *source;
+    const esp_partition_t *target;
+    uint8_t *block;
+    size_t fill;
+    uint32_t offset;
+    uint32_t total;
+} delta_ctx_t;
+
+static bool delta_read_source(void *ctx, uint32_t offset, uint8_t *buf, size_t len) {
+    return esp_partition_read(((delta_ctx_t *)ctx)->source, offset, buf, len) == ESP_OK;
+}
+
+static bool delta_flush_block(delta_ctx_t *delta) {
+    if (delta->offset == 0 && delta->block[0] != ESP_IMAGE_HEADER_MAGIC) {
+        ESP_LOGE(TAG, "Patched image is not a firmware image");
+        return false;
+    }
+    if (write_block(delta->target, delta->offset, delta->block, delta->fill) != ESP_OK) {
+        return false;
+    }
+    delta->offset += delta->fill;
+    delta->fill = 0;
+    ota_progress_handler("Installing", delta->total, delta->offset, NULL);
+    return true;
+}
+
+static bool delta_write_target(void *ctx, const uint8_t *data, size_t len) {
+    delta_ctx_t *delta = ctx;
+    while (len > 0) {
+        size_t n = OTA_BLOCK_SIZE - delta->fill;
+        n = n < len ? n : len;
+        memcpy(delta->block + delta->fill, data, n);
+        delta->fill += n;
+        data += n;
+        len -= n;
+        if (delta->fill == OTA_BLOCK_SIZE && !delta_flush_block(delta)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Rebuild the new image in the update partition from the running image
+ * and a delta patch (delta_patch.h), inflating the patch as it streams in
+ * @return ESP_OK once the rebuilt image matches the patch's target hash;
+ *         ESP_ERR_INVALID_VERSION if the patch is for a different image
+ */
+static esp_err_t apply_delta_patch(const char *url, const esp_partition_t *partition, uint8_t *block) {
+    const esp_partition_t *running = esp_ota_get_running_partition();
+    tinfl_decompressor *inflator = malloc(sizeof(tinfl_decompressor));
+    uint8_t *dict = malloc(TINFL_LZ_DICT_SIZE);
+    uint8_t *in = malloc(OTA_PATCH_READ_SIZE);
+    
+    esp_http_client_config_t config = {
+        .url = url,
+        .timeout_ms = 15000,
+        .keep_alive_enable = true,
+        .crt_bundle_attach = esp_crt_bundle_attach,
+        .buffer_size = 4096,
+        .buffer_size_tx = 2048,
+    };
+    esp_http_client_handle_t client = esp_http_client_init(&config);
+    power_lock_acquire(POWER_LOCK_NETWORK);
+    
+    esp_err_t err = ESP_OK;
+    int64_t content_length = 0;
+    int status_code = 0;
+    if (!running || !inflator || !dict || !in || !client) {
+        err = ESP_ERR_NO_MEM;
+    } else {
+        err = open_following_redirects(client, &content_length, &status_code);
+        if (err == ESP_OK && status_code != 200) {
+            ESP_LOGE(TAG, "Patch download returned status code: %d", status_code);
+            err = ESP_FAIL;
+        }
+    }
+    
+    // Header, then check the patch was made against exactly this image
+    delta_patch_header_t header = {0};
+    size_t in_len = 0;
+    while (err == ESP_OK && in_len < DELTA_PATCH_HEADER_SIZE) {
+        int n = esp_http_client_read(client, (char *)in + in_len, DELTA_PATCH_HEADER_SIZE - in_len);
+        if (n <= 0) {
+            err = ESP_FAIL;
+        }
+        in_len += n > 0 ? n : 0;
+    }
+    if (err == ESP_OK) {
+        uint8_t running_sha256[32];
+        if (!delta_patch_parse_header(in, in_len, &header) ||
+            header.source_size > running->size || header.target_size > partition->size) {
+            ESP_LOGE(TAG, "Invalid delta patch");
+            err = ESP_ERR_INVALID_RESPONSE;
+        } else if ((err = partition_sha256(running, header.source_size, running_sha256)) == ESP_OK &&
+                   memcmp(running_sha256, header.source_sha256, sizeof(running_sha256)) != 0) {
+            ESP_LOGW(TAG, "Delta patch was made for a different build of v%s", DEVICE_VERSION);
+            err = ESP_ERR_INVALID_VERSION;
+        }
+    }
+    
+    delta_ctx_t delta = {
+        .source = running,
+        .target = partition,
+        .block = block,
+        .total = header.target_size,
+    };
+    delta_patch_t patch;
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Applying delta patch: %lld bytes for a %lu byte image", content_length, header.target_size);
+        delta_patch_init(&patch, &header, delta_read_source, delta_write_target, &delta);
+        tinfl_init(inflator);
+        ota_progress_begin();
+    }
+    
+    size_t in_ofs = 0;
+    size_t dict_ofs = 0;
+    bool end_of_input = false;
+    in_len = 0;
+    tinfl_status status = TINFL_STATUS_NEEDS_MORE_INPUT;
+    while (err == ESP_OK && status != TINFL_STATUS_DONE) {
+        if (in_ofs == in_len && !end_of_input) {
+            int n = esp_http_client_read(client, (char *)in, OTA_PATCH_READ_SIZE);
+            if (n < 0) {
+                err = ESP_FAIL;
+                break;
+            }
+            end_of_input = (n == 0);
+            in_ofs = 0;
+            in_len = n;
+        }
         
-        if (progress <= 50) {
-            global_progress_cb(progress, "Downloading firmware...");
-        } else {
-            global_progress_cb(progress, "Installing firmware...");
+        size_t in_bytes = in_len - in_ofs;
+        size_t out_bytes = TINFL_LZ_DICT_SIZE - dict_ofs;
+        status = tinfl_decompress(inflator, in + in_ofs, &in_bytes, dict, dict + dict_ofs, &out_bytes,
+                                  TINFL_FLAG_PARSE_ZLIB_HEADER | (end_of_input ? 0 : TINFL_FLAG_HAS_MORE_INPUT));
+        in_ofs += in_bytes;
+        if (out_bytes > 0 && !delta_patch_feed(&patch, dict + dict_ofs, out_bytes)) {
+            err = ESP_ERR_INVALID_RESPONSE;
+        }
+        dict_ofs = (dict_ofs + out_bytes) & (TINFL_LZ_DICT_SIZE - 1);
+        if (status < 0 || (end_of_input && status == TINFL_STATUS_NEEDS_MORE_INPUT)) {
+            ESP_LOGE(TAG, "Delta patch is corrupt or truncated");
+            err = ESP_ERR_INVALID_RESPONSE;
         }
     }
+    
+    if (err == ESP_OK && !delta_patch_complete(&patch)) {
+        err = ESP_ERR_INVALID_SIZE;
+    }
+    if (err == ESP_OK && delta.fill > 0 && !delta_flush_block(&delta)) {
+        err = ESP_FAIL;
+    }
+    if (err == ESP_OK) {
+        err = verify_partition_sha256(partition, header.target_size, header.target_sha256);
+    }
+    
+    if (client) {
+        esp_http_client_close(client);
+        esp_http_client_cleanup(client);
+    }
+    power_lock_release(POWER_LOCK_NETWORK);
+    free(in);
+    free(dict);
+    free(inflator);
+    return err;
 }
 
-esp_err_t ota_perform_update(ota_progress_callback_t progress_cb) {
-    if (!ota_is_safe_to_update()) {
-        ESP_LOGE(TAG, "Not safe to update - WiFi or power issue");
-        if (progress_cb) {
-            progress_cb(0, "Update failed: Not safe");
+/**
+ * Load the checkpoint for a download, or start a new one
+ * @return true if an earlier download of the same file can be resumed
+ */
+static bool checkpoint_begin(const char *url, const esp_partition_t *partition, ota_checkpoint_t *checkpoint) {
+    uint32_t hash = url_hash(url);
+    if (checkpoint_load(checkpoint) && checkpoint->url_hash == hash &&
+        checkpoint->partition_addr == partition->address) {
+        ESP_LOGI(TAG, "Resuming download at %lu of %lu bytes", checkpoint->written, checkpoint->image_size);
+        return true;
+    }
+    memset(checkpoint, 0, sizeof(*checkpoint));
+    checkpoint->version = OTA_RESUME_VERSION;
+    checkpoint->url_hash = hash;
+    checkpoint->partition_addr = partition->address;
+    return false;
+}
+
+/**
+ * Download an image into a partition, reconnecting with backoff when the
+ * connection drops. The checkpoint is kept for the next update if the
+ * download can't be finished now, and cleared once it is.
+ */
+static esp_err_t download_with_resume(const char *url, const esp_partition_t *partition,
+                                      ota_checkpoint_t *checkpoint) {
+    esp_err_t err;
+    bool fatal = false;
+    ota_progress_begin();
+    for (int attempt = 0; ; attempt++) {
+        err = download_image(url, partition, checkpoint, &fatal);
+        if (err == ESP_OK || fatal || attempt >= OTA_MAX_RESUMES) {
+            break;
+        }
+        checkpoint_save(checkpoint);
+        
+        int backoff_s = 1 << (attempt < 5 ? attempt : 5);
+        if (backoff_s > OTA_RESUME_BACKOFF_MAX_S) {
+            backoff_s = OTA_RESUME_BACKOFF_MAX_S;
+        }
+        ESP_LOGW(TAG, "Download interrupted at %lu bytes (%s), resuming in %d s",
+                 checkpoint->written, esp_err_to_name(err), backoff_s);
+        if (global_progress_cb) {
+            global_progress_cb(checkpoint->image_size ? (int)((uint64_t)checkpoint->written * 100 / checkpoint->image_size) : 5,
+                               "Connection lost, resuming...");
+        }
+        vTaskDelay(pdMS_TO_TICKS(backoff_s * 1000));
+        
+        // Give WiFi a minute to come back before spending a retry
+        for (int i = 0; i < 60 && !wifi_manager_is_connected(); i++) {
+            vTaskDelay(pdMS_TO_TICKS(1000));
         }
-        return ESP_FAIL;
     }
     
-    global_progress_cb = progress_cb;
+    if (err == ESP_OK || fatal) {
+        checkpoint_clear();
+    } else {
+        checkpoint_save(checkpoint);  // The next update continues from here
+    }
+    return err;
+}
+
+/**
+ * Download a media pack into the assets partition
+ * The partition is mapped and read in place, so asset readers are stopped
+ * first (the alarm plays its synthesized beep meanwhile). Afterwards every
+ * asset is checked against the old table of contents again; the new pack
+ * is used after the reboot.
+ * @param sha256 Expected digest (may be NULL)
+ */
+static esp_err_t install_assets_pack(const char *url, const uint8_t *sha256) {
+    const esp_partition_t *partition = find_assets_partition();
+    if (!partition) {
+        ESP_LOGW(TAG, "No assets partition - flash the current partition table over USB to get media updates");
+        return ESP_ERR_NOT_FOUND;
+    }
     
-    ESP_LOGI(TAG, "Starting OTA update from GitHub...");
+    esp_err_t err = assets_begin_update(ASSETS_UPDATE_WAIT_MS);
+    if (err != ESP_OK) {
+        return err;
+    }
     
-    if (progress_cb) {
-        progress_cb(0, "Checking for updates...");
+    ESP_LOGI(TAG, "Downloading media pack from: %s", url);
+    progress_item = "media";
+    ota_checkpoint_t checkpoint;
+    checkpoint_begin(url, partition, &checkpoint);
+    err = download_with_resume(url, partition, &checkpoint);
+    if (err == ESP_OK && sha256) {
+        err = verify_partition_sha256(partition, checkpoint.image_size, sha256);
+    }
+    progress_item = "firmware";
+    assets_end_update();
+    return err;
+}
+
+/**
+ * Version in a release tag ("v1.2.3" -> "1.2.3")
+ */
+static const char *tag_version(const char *tag_name) {
+    return (tag_name[0] == 'v' || tag_name[0] == 'V') ? tag_name + 1 : tag_name;
+}
+
+/**
+ * Pick the assets this device needs as the scanner passes them: the full
+ * image "glucose-monitor-v<new>.bin", a delta patch from this version
+ * "glucose-monitor-v<new>-from-v<this>.patch" and the newest media pack
+ * "glucose-assets-v<N>.pack"
+ * Only the image named for the release's tag is taken (checked again by
+ * release_check_firmware in case the tag came after the assets).
+ */
+static void release_asset_cb(void *ctx, const release_scan_asset_t *asset) {
+    release_fetch_t *fetch = ctx;
+    ota_release_t *rel = &fetch->fresh;
+    if (!asset->name[0] || !asset->url[0]) {
+        return;  // Missing, or too long to keep
     }
     
-    // Get latest release information
-    http_recv_len = 0;
-    memset(http_recv_buffer, 0, sizeof(http_recv_buffer));
+    char patch_suffix[48];
+    snprintf(patch_suffix, sizeof(patch_suffix), "-from-v%s.patch", DEVICE_VERSION);
+    const char *filename = asset->name;
+    size_t name_len = strlen(filename);
+    size_t suffix_len = strlen(patch_suffix);
+    
+    // GitHub publishes "sha256:<hex>" for each asset
+    uint32_t pack_version = assets_pack_version(filename);
+    if (pack_version) {
+        if (pack_version > rel->pack_version) {
+            snprintf(rel->pack_url, sizeof(rel->pack_url), "%s", asset->url);
+            rel->pack_version = pack_version;
+            rel->have_pack_sha256 = parse_sha256_digest(asset->digest, rel->pack_sha256);
+        }
+    } else if (!rel->patch_url[0] && name_len > suffix_len && strcmp(filename + name_len - suffix_len, patch_suffix) == 0) {
+        snprintf(rel->patch_url, sizeof(rel->patch_url), "%s", asset->url);
+        ESP_LOGI(TAG, "Found delta patch: %s", filename);
+    } else if (strncmp(filename, "glucose-monitor-v", 17) == 0 && name_len > 4 &&
+               strcmp(filename + name_len - 4, ".bin") == 0) {
+        // The image for the tag; before the tag has been seen, the first one
+        const char *tag = tag_version(fetch->scanner.tag_name);
+        char expected[RELEASE_SCAN_NAME_LEN];
+        snprintf(expected, sizeof(expected), "glucose-monitor-v%s.bin", tag);
+        if (tag[0] ? strcmp(filename, expected) == 0 : !rel->firmware_url[0]) {
+            snprintf(fetch->firmware_name, sizeof(fetch->firmware_name), "%s", filename);
+            snprintf(rel->firmware_url, sizeof(rel->firmware_url), "%s", asset->url);
+            rel->have_firmware_sha256 = parse_sha256_digest(asset->digest, rel->firmware_sha256);
+        }
+    }
+}
+
+/**
+ * Drop the image picked by release_asset_cb unless it is
+ * "glucose-monitor-v<tag>.bin" for the scanned tag
+ */
+static void release_check_firmware(release_fetch_t *fetch) {
+    ota_release_t *rel = &fetch->fresh;
+    if (!rel->firmware_url[0]) {
+        return;
+    }
+    char expected[RELEASE_SCAN_NAME_LEN];
+    snprintf(expected, sizeof(expected), "glucose-monitor-v%s.bin", rel->tag);
+    if (strcmp(fetch->firmware_name, expected) == 0) {
+        ESP_LOGI(TAG, "Found firmware: %s", fetch->firmware_name);
+        return;
+    }
+    ESP_LOGW(TAG, "Ignoring %s: release %s needs %s", fetch->firmware_name, rel->tag, expected);
+    rel->firmware_url[0] = '\0';
+    rel->have_firmware_sha256 = false;
+}
+
+/**
+ * Keep the ETag of a releases/latest response
+ */
+static esp_err_t release_event_handler(esp_http_client_event_t *evt) {
+    if (evt->event_id == HTTP_EVENT_ON_HEADER && evt->user_data && strcasecmp(evt->header_key, "ETag") == 0) {
+        ota_release_t *rel = evt->user_data;
+        if (strlen(evt->header_value) < sizeof(rel->etag)) {
+            snprintf(rel->etag, sizeof(rel->etag), "%s", evt->header_value);
+        }
+    }
+    return ESP_OK;
+}
+
+/**
+ * Load the stored release, if its assets were picked for this firmware
+ */
+static bool release_load(ota_release_t *rel) {
+    nvs_handle_t handle;
+    if (nvs_open(OTA_RELEASE_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        return false;
+    }
+    size_t len = sizeof(*rel);
+    esp_err_t err = nvs_get_blob(handle, OTA_RELEASE_KEY, rel, &len);
+    nvs_close(handle);
+    return err == ESP_OK && len == sizeof(*rel) && rel->version == OTA_RELEASE_VERSION &&
+           strcmp(rel->device_version, DEVICE_VERSION) == 0 && rel->etag[0];
+}
+
+static void release_save(const ota_release_t *rel) {
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(OTA_RELEASE_NAMESPACE, NVS_READWRITE, &handle);
+    if (err == ESP_OK) {
+        err = nvs_set_blob(handle, OTA_RELEASE_KEY, rel, sizeof(*rel));
+        if (err == ESP_OK) {
+            err = nvs_commit(handle);
+        }
+        nvs_close(handle);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to save release info: %s", esp_err_to_name(err));
+    }
+}
+
+/**
+ * Fetch releases/latest into `release`
+ * Sends the stored ETag as If-None-Match; on 304 the stored release is
+ * used as is. A 200 body is scanned as it arrives rather than buffered
+ * and parsed, so the size of the release notes doesn't matter.
+ */
+static esp_err_t fetch_release(void) {
+    release_fetch_t *fetch = calloc(1, sizeof(*fetch));
+    if (!fetch) {
+        return ESP_ERR_NO_MEM;
+    }
+    bool have_cached = release_load(&fetch->cached);
+    fetch->fresh.version = OTA_RELEASE_VERSION;
+    snprintf(fetch->fresh.device_version, sizeof(fetch->fresh.device_version), "%s", DEVICE_VERSION);
     
-    esp_http_client_config_t api_config = {
+    esp_http_client_config_t config = {
         .url = GITHUB_API_URL,
-        .event_handler = http_event_handler,
+        .event_handler = release_event_handler,
+        .user_data = &fetch->fresh,
         .timeout_ms = 10000,
         .user_agent = "ESP32-Glucose-Monitor/1.0",
         .crt_bundle_attach = esp_crt_bundle_attach,
     };
     
-    esp_http_client_handle_t api_client = esp_http_client_init(&api_config);
-    if (!api_client) {
-        ESP_LOGE(TAG, "Failed to initialize API client");
+    esp_http_client_handle_t client = esp_http_client_init(&config);
+    if (!client) {
+        ESP_LOGE(TAG, "Failed to initialize HTTP client");
+        free(fetch);
         return ESP_FAIL;
     }
+    if (have_cached) {
+        esp_http_client_set_header(client, "If-None-Match", fetch->cached.etag);
+    }
+    power_lock_acquire(POWER_LOCK_NETWORK);
     
-    esp_err_t err = esp_http_client_perform(api_client);
-    int status_code = esp_http_client_get_status_code(api_client);
-    esp_http_client_cleanup(api_client);
+    int64_t content_length = 0;
+    int status_code = 0;
+    esp_err_t err = open_following_redirects(client, &content_length, &status_code);
     
-    if (err != ESP_OK || status_code != 200) {
-        ESP_LOGE(TAG, "Failed to fetch release info");
-        return ESP_FAIL;
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "HTTP GET request failed: %s", esp_err_to_name(err));
+    } else if (status_code == 304 && have_cached) {
+        ESP_LOGI(TAG, "Release unchanged since last check (%s)", fetch->cached.tag);
+        release = fetch->cached;
+    } else if (status_code != 200) {
+        ESP_LOGE(TAG, "GitHub API returned status code: %d", status_code);
+        err = ESP_FAIL;
+    } else {
+        release_scanner_init(&fetch->scanner, release_asset_cb, fetch);
+        size_t total = 0;
+        int n;
+        while ((n = esp_http_client_read(client, fetch->buf, sizeof(fetch->buf))) > 0) {
+            total += n;
+            if (!release_scanner_feed(&fetch->scanner, fetch->buf, n)) {
+                break;
+            }
+        }
+        
+        const char *version_str = tag_version(fetch->scanner.tag_name);
+        if (n < 0 || !release_scanner_complete(&fetch->scanner)) {
+            ESP_LOGE(TAG, "Failed to read GitHub API response (%u bytes)", (unsigned)total);
+            err = ESP_FAIL;
+        } else if (!version_str[0]) {
+            ESP_LOGE(TAG, "No tag_name found in GitHub response");
+            err = ESP_FAIL;
+        } else {
+            snprintf(fetch->fresh.tag, sizeof(fetch->fresh.tag), "%s", version_str);
+            release_check_firmware(fetch);
+            ESP_LOGI(TAG, "Scanned %u byte release info", (unsigned)total);
+            release = fetch->fresh;
+            if (release.etag[0]) {
+                release_save(&release);
+            }
+        }
     }
     
-    // Parse JSON to get download URL
-    cJSON *json = cJSON_Parse(http_recv_buffer);
-    if (!json) {
-        ESP_LOGE(TAG, "Failed to parse release info");
+    esp_http_client_cleanup(client);
+    power_lock_release(POWER_LOCK_NETWORK);
+    free(fetch);
+    if (err == ESP_OK) {
+        release_fetched_us = esp_timer_get_time();
+    }
+    return err;
+}
+
+esp_err_t ota_check_for_update(char *new_version, size_t new_version_size) {
+    if (!wifi_manager_is_connected()) {
+        ESP_LOGW(TAG, "Cannot check for updates - WiFi not connected");
         return ESP_FAIL;
     }
     
-    // Find .bin file in assets
-    cJSON *assets = cJSON_GetObjectItem(json, "assets");
-    if (!assets || !cJSON_IsArray(assets)) {
-        ESP_LOGE(TAG, "No assets found in release");
-        cJSON_Delete(json);
-        return ESP_FAIL;
+    ESP_LOGI(TAG, "Checking for firmware updates from GitHub...");
+    ESP_LOGI(TAG, "API URL: %s", GITHUB_API_URL);
+    
+    esp_err_t err = fetch_release();
+    if (err != ESP_OK) {
+        return err;
     }
     
-    char *download_url = NULL;
-    cJSON *asset = NULL;
-    cJSON_ArrayForEach(asset, assets) {
-        cJSON *name = cJSON_GetObjectItem(asset, "name");
-        if (name && cJSON_IsString(name)) {
-            const char *filename = name->valuestring;
-            // Look for .bin file
-            if (strstr(filename, ".bin") != NULL) {
-                cJSON *browser_download_url = cJSON_GetObjectItem(asset, "browser_download_url");
-                if (browser_download_url && cJSON_IsString(browser_download_url)) {
-                    download_url = strdup(browser_download_url->valuestring);
-                    ESP_LOGI(TAG, "Found firmware: %s", filename);
-                    break;
-                }
-            }
+    ESP_LOGI(TAG, "Latest GitHub release: %s", release.tag);
+    ESP_LOGI(TAG, "Current version: %s", DEVICE_VERSION);
+    
+    // Compare versions
+    if (compare_versions(release.tag, DEVICE_VERSION) > 0) {
+        ESP_LOGI(TAG, "Update available! %s -> %s", DEVICE_VERSION, release.tag);
+        if (new_version && new_version_size > 0) {
+            strncpy(new_version, release.tag, new_version_size - 1);
+            new_version[new_version_size - 1] = '\0';
         }
+        return ESP_OK;
     }
     
-    cJSON_Delete(json);
+    // Same firmware, but the release may carry a newer media pack
+    if (find_assets_partition() && release.pack_version > assets_get_version()) {
+        ESP_LOGI(TAG, "Media update available: v%lu -> v%lu", assets_get_version(), release.pack_version);
+        if (new_version && new_version_size > 0) {
+            snprintf(new_version, new_version_size, "%s (media v%lu)", DEVICE_VERSION, release.pack_version);
+        }
+        return ESP_OK;
+    }
     
-    if (!download_url) {
-        ESP_LOGE(TAG, "No .bin file found in release assets");
+    ESP_LOGI(TAG, "Already running latest version");
+    return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t ota_perform_update(ota_progress_callback_t progress_cb) {
+    if (!ota_is_safe_to_update()) {
+        ESP_LOGE(TAG, "Not safe to update - WiFi or power issue");
+        if (progress_cb) {
+            progress_cb(0, "Update failed: Not safe");
+        }
         return ESP_FAIL;
     }
     
-    ESP_LOGI(TAG, "Downloading firmware from: %s", download_url);
+    global_progress_cb = progress_cb;
+    
+    ESP_LOGI(TAG, "Starting OTA update from GitHub...");
     
     if (progress_cb) {
-        progress_cb(5, "Starting download...");
+        progress_cb(0, "Checking for updates...");
     }
     
-    // Temporarily suspend glucose fetch task to free up resources during OTA
-    // This prevents concurrent HTTPS connections that could cause crypto contention
-    
-    // Configure OTA with optimized buffer sizes (not too large to avoid OOM)
-    esp_http_client_config_t ota_config = {
-        .url = download_url,
-        .timeout_ms = 60000,  // Increased timeout for large downloads
-        .keep_alive_enable = true,
-        .crt_bundle_attach = esp_crt_bundle_attach,
-        .buffer_size = 4096,  // Keep moderate size to avoid OOM
-        .buffer_size_tx = 2048,
-    };
-    
-    esp_https_ota_config_t ota_https_config = {
-        .http_config = &ota_config,
-        .bulk_flash_erase = true,  // Faster erase
-    };
+    // The check that offered this update normally fetched the release
+    // moments ago; otherwise ask again (a 304 if nothing changed)
+    esp_err_t err = ESP_OK;
+    if (release_fetched_us && esp_timer_get_time() - release_fetched_us < OTA_RELEASE_MAX_AGE_US) {
+        ESP_LOGI(TAG, "Using release info from the last check (%s)", release.tag);
+    } else {
+        err = fetch_release();
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to fetch release info");
+        return ESP_FAIL;
+    }
     
-    esp_https_ota_handle_t ota_handle = NULL;
-    err = esp_https_ota_begin(&ota_https_config, &ota_handle);
+    // Firmware is only installed from a newer release; otherwise this is a
+    // media-only update
+    bool firmware_newer = compare_versions(release.tag, DEVICE_VERSION) > 0;
+    const char *download_url = release.firmware_url[0] ? release.firmware_url : NULL;
+    const char *patch_url = release.patch_url[0] ? release.patch_url : NULL;
+    const char *pack_url = NULL;
+    if (release.pack_url[0] && release.pack_version > assets_get_version()) {
+        if (find_assets_partition()) {
+            pack_url = release.pack_url;
+            ESP_LOGI(TAG, "Found media pack v%lu (installed: v%lu)", release.pack_version, assets_get_version());
+        } else {
+            // Nowhere to put it: don't spend the download only to fail
+            ESP_LOGW(TAG, "Skipping media pack v%lu: no assets partition - flash the current partition table over USB",
+                     release.pack_version);
+            if (progress_cb) {
+                progress_cb(0, "Media update skipped:\nflash over USB to enable");
+            }
+        }
+    }
     
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "OTA begin failed: %s", esp_err_to_name(err));
-        free(download_url);
-        return err;
+    if (!firmware_newer) {
+        download_url = NULL;
+        patch_url = NULL;
+        if (!pack_url) {
+            ESP_LOGI(TAG, "Nothing to install");
+            return ESP_ERR_NOT_FOUND;
+        }
+    } else if (!download_url) {
+        ESP_LOGE(TAG, "No glucose-monitor-v%s.bin in the release assets", release.tag);
+        return ESP_FAIL;
     }
     
-    // Download and install with progress
-    size_t total_size = esp_https_ota_get_image_size(ota_handle);
-    ESP_LOGI(TAG, "Firmware size: %d bytes", total_size);
+    const esp_partition_t *update_partition = esp_ota_get_next_update_partition(NULL);
+    uint8_t *block = malloc(OTA_BLOCK_SIZE);
+    if (!update_partition || !block) {
+        ESP_LOGE(TAG, "No update partition or out of memory");
+        free(block);
+        return ESP_FAIL;
+    }
     
-    while (1) {
-        err = esp_https_ota_perform(ota_handle);
-        if (err != ESP_ERR_HTTPS_OTA_IN_PROGRESS) {
-            break;
+    if (download_url) {
+        // Pick up where an interrupted download of the same image stopped
+        ota_checkpoint_t checkpoint;
+        bool resuming = checkpoint_begin(download_url, update_partition, &checkpoint);
+        
+        // A delta patch is a fraction of the download, but it overwrites the
+        // slot, so it isn't tried over a full download that can be resumed
+        bool installed = false;
+        if (patch_url && !resuming) {
+            if (progress_cb) {
+                progress_cb(5, "Downloading update patch...");
+            }
+            err = apply_delta_patch(patch_url, update_partition, block);
+            if (err == ESP_OK) {
+                installed = true;
+            } else {
+                ESP_LOGW(TAG, "Delta update failed (%s), downloading the full image", esp_err_to_name(err));
+            }
         }
         
-        // Update progress
-        size_t current_size = esp_https_ota_get_image_len_read(ota_handle);
-        ota_progress_handler(total_size, current_size);
+        if (!installed) {
+            ESP_LOGI(TAG, "Downloading firmware from: %s", download_url);
+            if (progress_cb) {
+                progress_cb(5, "Starting download...");
+            }
+            err = download_with_resume(download_url, update_partition, &checkpoint);
+            
+            // Hash the whole image as written (a patched image was checked
+            // against the hash in the patch already)
+            if (err == ESP_OK && release.have_firmware_sha256) {
+                ESP_LOGI(TAG, "OTA download complete, verifying...");
+                if (progress_cb) {
+                    progress_cb(95, "Verifying firmware...");
+                }
+                err = verify_partition_sha256(update_partition, checkpoint.image_size, release.firmware_sha256);
+            }
+        }
         
-        vTaskDelay(pdMS_TO_TICKS(100));
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "OTA download failed: %s", esp_err_to_name(err));
+            free(block);
+            if (progress_cb) {
+                progress_cb(0, "Update failed!");
+            }
+            return err;
+        }
     }
     
-    if (err == ESP_OK) {
-        ESP_LOGI(TAG, "OTA download complete, verifying...");
+    // Media is optional: new firmware still boots if the pack fails, and the
+    // next update check offers the pack again
+    if (pack_url) {
         if (progress_cb) {
-            progress_cb(95, "Verifying firmware...");
+            progress_cb(5, "Downloading media...");
+        }
+        esp_err_t pack_err = install_assets_pack(pack_url, release.have_pack_sha256 ? release.pack_sha256 : NULL);
+        if (pack_err != ESP_OK) {
+            ESP_LOGW(TAG, "Media pack update failed: %s", esp_err_to_name(pack_err));
+            if (!firmware_newer) {
+                err = pack_err;
+            }
         }
-    } else {
-        ESP_LOGE(TAG, "OTA download failed: %s", esp_err_to_name(err));
-        esp_https_ota_abort(ota_handle);
-        free(download_url);
-        return err;
     }
+    free(block);
     
-    // Finish OTA update
-    err = esp_https_ota_finish(ota_handle);
-    free(download_url);
+    // The bootloader checks (header, segments, appended SHA-256) run here
+    if (err == ESP_OK && firmware_newer) {
+        err = esp_ota_set_boot_partition(update_partition);
+    }
     
     if (err == ESP_OK) {
         ESP_LOGI(TAG, "OTA update successful! Rebooting...");
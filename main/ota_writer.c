@@ -0,0 +1,118 @@
+/**
+ * OTA Flash Writer Implementation
+ * ESP-IDF port of the writer core: partition flash, FreeRTOS queues and task
+ */
+
+#include "ota_writer.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include <stdbool.h>
+#include <stdlib.h>
+
+#define WRITER_TASK_STACK       3072
+
+typedef struct {
+    void (*run)(void *arg);
+    void *arg;
+} writer_task_args_t;
+
+static esp_err_t flash_erase(void *flash, uint32_t offset, uint32_t len)
+{
+    return esp_partition_erase_range(flash, offset, len);
+}
+
+static esp_err_t flash_write(void *flash, uint32_t offset, const void *data, size_t len)
+{
+    return esp_partition_write(flash, offset, data, len);
+}
+
+static esp_err_t flash_read(void *flash, uint32_t offset, void *data, size_t len)
+{
+    return esp_partition_read(flash, offset, data, len);
+}
+
+static ota_writer_queue_t *queue_create(size_t length, size_t item_size)
+{
+    return (ota_writer_queue_t *)xQueueCreate(length, item_size);
+}
+
+static void queue_delete(ota_writer_queue_t *queue)
+{
+    vQueueDelete((QueueHandle_t)queue);
+}
+
+static void queue_send(ota_writer_queue_t *queue, const void *item)
+{
+    xQueueSend((QueueHandle_t)queue, item, portMAX_DELAY);
+}
+
+static bool queue_receive(ota_writer_queue_t *queue, void *item, bool wait)
+{
+    return xQueueReceive((QueueHandle_t)queue, item, wait ? portMAX_DELAY : 0) == pdTRUE;
+}
+
+static uint8_t *buffer_alloc(void)
+{
+#if CONFIG_SPIRAM
+    uint8_t *buf = heap_caps_malloc(OTA_WRITER_BUFFER_SIZE, MALLOC_CAP_SPIRAM);
+    if (buf) {
+        return buf;
+    }
+#endif
+    return malloc(OTA_WRITER_BUFFER_SIZE);
+}
+
+static void buffer_free(uint8_t *buf)
+{
+    free(buf);
+}
+
+static void writer_task(void *arg)
+{
+    writer_task_args_t args = *(writer_task_args_t *)arg;
+    free(arg);
+    args.run(args.arg);
+    vTaskDelete(NULL);
+}
+
+static bool task_start(void (*run)(void *arg), void *arg)
+{
+    writer_task_args_t *args = malloc(sizeof(*args));
+    if (!args) {
+        return false;
+    }
+    args->run = run;
+    args->arg = arg;
+    // Same priority as the download, so neither side starves the other
+    if (xTaskCreate(writer_task, "ota_writer", WRITER_TASK_STACK, args, uxTaskPriorityGet(NULL), NULL) != pdPASS) {
+        free(args);
+        return false;
+    }
+    return true;
+}
+
+esp_err_t ota_writer_start(const esp_partition_t *partition, uint32_t offset, uint32_t image_size,
+                           ota_writer_t **writer)
+{
+    const ota_writer_port_t port = {
+        .flash = (void *)partition,
+        .flash_size = partition->size,
+        .erase = flash_erase,
+        .write = flash_write,
+        .read = flash_read,
+        .queue_create = queue_create,
+        .queue_delete = queue_delete,
+        .queue_send = queue_send,
+        .queue_receive = queue_receive,
+        .buffer_count = OTA_WRITER_BUFFERS,
+        .buffer_alloc = buffer_alloc,
+        .buffer_free = buffer_free,
+        .task_start = task_start,
+        .now_us = esp_timer_get_time,
+    };
+
+    return ota_writer_core_start(&port, offset, image_size, writer);
+}
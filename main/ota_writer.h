@@ -0,0 +1,39 @@
+/**
+ * OTA Flash Writer
+ * Writes a download to flash on its own task while the network keeps reading
+ *
+ * The pipeline itself is in ota_writer_core.h; this is its ESP-IDF port:
+ * the target is a flash partition, the queues and the task are FreeRTOS
+ * ones, and buffers are OTA_WRITER_BUFFER_SIZE bytes, a multiple of the
+ * flash sector, from PSRAM when it is enabled.
+ */
+
+#ifndef OTA_WRITER_H
+#define OTA_WRITER_H
+
+#include "ota_writer_core.h"
+#include "esp_err.h"
+#include "esp_partition.h"
+#include "sdkconfig.h"
+#include <stdint.h>
+
+#if CONFIG_SPIRAM
+#define OTA_WRITER_BUFFERS          8
+#define OTA_WRITER_BUFFER_SIZE      (32 * 1024)
+#else
+#define OTA_WRITER_BUFFERS          3
+#define OTA_WRITER_BUFFER_SIZE      (16 * 1024)
+#endif
+
+/**
+ * Start a writer
+ * @param partition Target partition
+ * @param offset Where the first submitted byte goes (sector aligned)
+ * @param image_size Full image size; nothing past it is erased
+ * @param[out] writer New writer
+ * @return ESP_OK, or ESP_ERR_NO_MEM if the buffers or task can't be created
+ */
+esp_err_t ota_writer_start(const esp_partition_t *partition, uint32_t offset, uint32_t image_size,
+                           ota_writer_t **writer);
+
+#endif // OTA_WRITER_H
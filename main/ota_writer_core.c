@@ -0,0 +1,220 @@
+/**
+ * OTA Flash Writer Core Implementation
+ */
+
+#include "ota_writer_core.h"
+#include "esp_log.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "OTA_WRITER";
+
+#define WRITER_VERIFY_SIZE      1024
+
+typedef struct {
+    uint8_t *data;              // NULL tells the task to stop
+    size_t len;
+} writer_item_t;
+
+struct ota_writer {
+    ota_writer_port_t port;
+    uint32_t start;
+    volatile uint32_t offset;   // Written and verified up to here
+    uint32_t erased_to;
+    uint32_t erase_limit;
+    ota_writer_queue_t *free_queue;     // Empty buffers
+    ota_writer_queue_t *full_queue;     // Buffers waiting for flash
+    ota_writer_queue_t *done_queue;     // Final result from the task
+    uint8_t *buffers[OTA_WRITER_MAX_BUFFERS];
+    int buffer_count;
+    uint8_t *verify;
+    volatile esp_err_t err;
+    int64_t start_us;
+    volatile uint32_t reader_stalls;
+    volatile uint32_t writer_stalls;
+};
+
+/**
+ * Erase ahead, write and read back one buffer
+ */
+static esp_err_t write_buffer(ota_writer_t *writer, const uint8_t *data, size_t len)
+{
+    const ota_writer_port_t *port = &writer->port;
+    uint32_t end = writer->offset + len;
+    if (end > writer->erase_limit) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    esp_err_t err = ESP_OK;
+    if (end > writer->erased_to) {
+        // Whole 64 KB blocks erase far faster than 16 sectors one by one
+        uint32_t erase_end = (end + OTA_WRITER_ERASE_AHEAD - 1) / OTA_WRITER_ERASE_AHEAD * OTA_WRITER_ERASE_AHEAD;
+        if (erase_end > writer->erase_limit) {
+            erase_end = writer->erase_limit;
+        }
+        err = port->erase(port->flash, writer->erased_to, erase_end - writer->erased_to);
+        if (err == ESP_OK) {
+            writer->erased_to = erase_end;
+        }
+    }
+    if (err == ESP_OK) {
+        err = port->write(port->flash, writer->offset, data, len);
+    }
+
+    for (size_t done = 0; err == ESP_OK && done < len; done += WRITER_VERIFY_SIZE) {
+        size_t n = len - done < WRITER_VERIFY_SIZE ? len - done : WRITER_VERIFY_SIZE;
+        err = port->read(port->flash, writer->offset + done, writer->verify, n);
+        if (err == ESP_OK && memcmp(writer->verify, data + done, n) != 0) {
+            err = ESP_ERR_INVALID_CRC;
+        }
+    }
+    if (err == ESP_OK) {
+        writer->offset = end;
+    } else {
+        ESP_LOGE(TAG, "Flash write failed at %lu: %s", writer->offset, esp_err_to_name(err));
+    }
+    return err;
+}
+
+static void writer_task(void *arg)
+{
+    ota_writer_t *writer = arg;
+    const ota_writer_port_t *port = &writer->port;
+    writer_item_t item;
+
+    while (1) {
+        if (!port->queue_receive(writer->full_queue, &item, false)) {
+            if (writer->offset > writer->start) {
+                writer->writer_stalls++;
+            }
+            port->queue_receive(writer->full_queue, &item, true);
+        }
+        if (item.data == NULL) {
+            break;
+        }
+        // After an error buffers are only recycled, so the reader never blocks
+        if (writer->err == ESP_OK && item.len > 0) {
+            writer->err = write_buffer(writer, item.data, item.len);
+        }
+        port->queue_send(writer->free_queue, &item.data);
+    }
+
+    esp_err_t err = writer->err;
+    port->queue_send(writer->done_queue, &err);
+}
+
+static void writer_free(ota_writer_t *writer)
+{
+    const ota_writer_port_t *port = &writer->port;
+    for (int i = 0; i < writer->buffer_count; i++) {
+        port->buffer_free(writer->buffers[i]);
+    }
+    if (writer->free_queue) {
+        port->queue_delete(writer->free_queue);
+    }
+    if (writer->full_queue) {
+        port->queue_delete(writer->full_queue);
+    }
+    if (writer->done_queue) {
+        port->queue_delete(writer->done_queue);
+    }
+    free(writer->verify);
+    free(writer);
+}
+
+esp_err_t ota_writer_core_start(const ota_writer_port_t *port, uint32_t offset, uint32_t image_size,
+                                ota_writer_t **writer_out)
+{
+    ota_writer_t *writer = calloc(1, sizeof(*writer));
+    if (!writer) {
+        return ESP_ERR_NO_MEM;
+    }
+    writer->port = *port;
+    writer->start = offset;
+    writer->offset = offset;
+    writer->erased_to = offset;
+    writer->erase_limit = (image_size + OTA_WRITER_SECTOR - 1) / OTA_WRITER_SECTOR * OTA_WRITER_SECTOR;
+    if (writer->erase_limit > port->flash_size) {
+        writer->erase_limit = port->flash_size;
+    }
+    writer->start_us = port->now_us();
+
+    // Take what fits; two buffers are enough to overlap network and flash
+    int wanted = port->buffer_count < OTA_WRITER_MAX_BUFFERS ? port->buffer_count : OTA_WRITER_MAX_BUFFERS;
+    for (int i = 0; i < wanted; i++) {
+        writer->buffers[i] = port->buffer_alloc();
+        if (!writer->buffers[i]) {
+            break;
+        }
+        writer->buffer_count++;
+    }
+    writer->verify = malloc(WRITER_VERIFY_SIZE);
+    writer->free_queue = port->queue_create(OTA_WRITER_MAX_BUFFERS, sizeof(uint8_t *));
+    writer->full_queue = port->queue_create(OTA_WRITER_MAX_BUFFERS + 1, sizeof(writer_item_t));
+    writer->done_queue = port->queue_create(1, sizeof(esp_err_t));
+    if (writer->buffer_count < 2 || !writer->verify || !writer->free_queue || !writer->full_queue ||
+        !writer->done_queue) {
+        ESP_LOGE(TAG, "Out of memory for OTA buffers (%d allocated)", writer->buffer_count);
+        writer_free(writer);
+        return ESP_ERR_NO_MEM;
+    }
+    for (int i = 0; i < writer->buffer_count; i++) {
+        port->queue_send(writer->free_queue, &writer->buffers[i]);
+    }
+
+    if (!port->task_start(writer_task, writer)) {
+        writer_free(writer);
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "Writing from offset %lu with %d buffers", offset, writer->buffer_count);
+    *writer_out = writer;
+    return ESP_OK;
+}
+
+uint8_t *ota_writer_get_buffer(ota_writer_t *writer)
+{
+    uint8_t *buf = NULL;
+    if (!writer->port.queue_receive(writer->free_queue, &buf, false)) {
+        writer->reader_stalls++;
+        writer->port.queue_receive(writer->free_queue, &buf, true);
+    }
+    return buf;
+}
+
+esp_err_t ota_writer_submit(ota_writer_t *writer, uint8_t *buf, size_t len)
+{
+    writer_item_t item = { .data = buf, .len = len };
+    writer->port.queue_send(writer->full_queue, &item);
+    return writer->err;
+}
+
+uint32_t ota_writer_get_offset(const ota_writer_t *writer)
+{
+    return writer->offset;
+}
+
+void ota_writer_get_stats(const ota_writer_t *writer, ota_writer_stats_t *stats)
+{
+    stats->bytes = writer->offset - writer->start;
+    stats->elapsed_ms = (uint32_t)((writer->port.now_us() - writer->start_us) / 1000);
+    stats->reader_stalls = writer->reader_stalls;
+    stats->writer_stalls = writer->writer_stalls;
+}
+
+esp_err_t ota_writer_finish(ota_writer_t *writer, ota_writer_stats_t *stats, uint32_t *offset)
+{
+    writer_item_t stop = { .data = NULL, .len = 0 };
+    esp_err_t err = ESP_FAIL;
+    writer->port.queue_send(writer->full_queue, &stop);
+    writer->port.queue_receive(writer->done_queue, &err, true);
+
+    if (stats) {
+        ota_writer_get_stats(writer, stats);
+    }
+    if (offset) {
+        *offset = writer->offset;
+    }
+    writer_free(writer);
+    return err;
+}
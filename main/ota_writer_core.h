@@ -0,0 +1,112 @@
+/**
+ * OTA Flash Writer Core
+ * The buffer pipeline behind ota_writer.h
+ *
+ * The download task takes an empty buffer, fills it from the connection
+ * and submits it; the writer task erases ahead of itself in large
+ * blocks, writes the buffer, reads it back and returns it to the pool.
+ * While the pool has a free buffer, the download never waits on flash.
+ *
+ * Every submitted buffer except the last of the image must be a whole
+ * number of sectors so the verified offset stays sector aligned for
+ * resuming.
+ *
+ * Flash, queues, buffers, the task and the clock come from an
+ * ota_writer_port_t (ota_writer.c on the device), so the pipeline is
+ * plain C that can run against a simulated flash on a host.
+ */
+
+#ifndef OTA_WRITER_CORE_H
+#define OTA_WRITER_CORE_H
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define OTA_WRITER_SECTOR           4096
+#define OTA_WRITER_ERASE_AHEAD      (64 * 1024)     // One flash block erase
+#define OTA_WRITER_MAX_BUFFERS      8
+
+typedef struct ota_writer ota_writer_t;
+typedef struct ota_writer_queue ota_writer_queue_t;
+
+/**
+ * What the writer needs from the platform
+ */
+typedef struct {
+    // Target flash; offsets are from the start of the partition
+    void *flash;
+    uint32_t flash_size;
+    esp_err_t (*erase)(void *flash, uint32_t offset, uint32_t len);
+    esp_err_t (*write)(void *flash, uint32_t offset, const void *data, size_t len);
+    esp_err_t (*read)(void *flash, uint32_t offset, void *data, size_t len);
+
+    // FIFO queues of fixed-size items, safe between two tasks
+    ota_writer_queue_t *(*queue_create)(size_t length, size_t item_size);
+    void (*queue_delete)(ota_writer_queue_t *queue);
+    void (*queue_send)(ota_writer_queue_t *queue, const void *item);            // Waits for room
+    bool (*queue_receive)(ota_writer_queue_t *queue, void *item, bool wait);    // false if empty and not waiting
+
+    // Buffers (buffer_count wanted, at most OTA_WRITER_MAX_BUFFERS), the
+    // writer task (it ends when run returns) and a microsecond clock
+    int buffer_count;
+    uint8_t *(*buffer_alloc)(void);
+    void (*buffer_free)(uint8_t *buf);
+    bool (*task_start)(void (*run)(void *arg), void *arg);
+    int64_t (*now_us)(void);
+} ota_writer_port_t;
+
+/**
+ * Pipeline counters, for the progress screen and the log
+ */
+typedef struct {
+    uint32_t bytes;             // Written and verified by this writer
+    uint32_t elapsed_ms;
+    uint32_t reader_stalls;     // Network waited for a free buffer (flash is the bottleneck)
+    uint32_t writer_stalls;     // Flash waited for data (network is the bottleneck)
+} ota_writer_stats_t;
+
+/**
+ * Start a writer on a port
+ * @param port Platform operations (copied)
+ * @param offset Where the first submitted byte goes (sector aligned)
+ * @param image_size Full image size; nothing past it is erased
+ * @param[out] writer New writer
+ * @return ESP_OK, or ESP_ERR_NO_MEM if fewer than two buffers, the
+ *         queues or the task can't be created
+ */
+esp_err_t ota_writer_core_start(const ota_writer_port_t *port, uint32_t offset, uint32_t image_size,
+                                ota_writer_t **writer);
+
+/**
+ * Take an empty buffer, waiting for one if the writer is behind
+ */
+uint8_t *ota_writer_get_buffer(ota_writer_t *writer);
+
+/**
+ * Queue a filled buffer for writing; the writer takes it back into the pool
+ * @param len Bytes to write from the buffer (0 just returns it)
+ * @return The writer's first error so far (the buffer is still taken)
+ */
+esp_err_t ota_writer_submit(ota_writer_t *writer, uint8_t *buf, size_t len);
+
+/**
+ * Offset up to which the partition is written and verified
+ */
+uint32_t ota_writer_get_offset(const ota_writer_t *writer);
+
+/**
+ * Counters so far
+ */
+void ota_writer_get_stats(const ota_writer_t *writer, ota_writer_stats_t *stats);
+
+/**
+ * Write what is queued, stop the task and free the writer
+ * @param[out] stats Final counters (may be NULL)
+ * @param[out] offset Final verified offset (may be NULL)
+ * @return ESP_OK if every submitted buffer was written and verified
+ */
+esp_err_t ota_writer_finish(ota_writer_t *writer, ota_writer_stats_t *stats, uint32_t *offset);
+
+#endif // OTA_WRITER_CORE_H
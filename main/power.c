@@ -0,0 +1,195 @@
+/**
+ * Power Management Implementation
+ */
+
+#include "power.h"
+#include "config.h"
+#include "esp_log.h"
+#include "esp_pm.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "freertos/FreeRTOS.h"
+#include "sdkconfig.h"
+#include <stdio.h>
+
+static const char *TAG = "POWER";
+
+// Current estimates for the ESP32-S3 module alone (datasheet figures,
+// rounded up); the LCD and its backlight come on top
+#define POWER_EST_BUSY_MA           100     // Full clock, radio active
+#define POWER_EST_IDLE_MA           25      // DFS minimum, modem sleep (averaged over beacon wake-ups)
+#define POWER_EST_IDLE_NO_PM_MA     65      // Full clock idling, radio awake for every beacon
+
+static const char *const lock_names[POWER_LOCK_COUNT] = {
+    [POWER_LOCK_DISPLAY] = "display",
+    [POWER_LOCK_AUDIO] = "audio",
+    [POWER_LOCK_NETWORK] = "network",
+};
+
+#if CONFIG_PM_ENABLE && POWER_SAVE_ENABLED
+static const esp_pm_lock_type_t lock_types[POWER_LOCK_COUNT] = {
+    [POWER_LOCK_DISPLAY] = ESP_PM_CPU_FREQ_MAX,
+    [POWER_LOCK_AUDIO] = ESP_PM_APB_FREQ_MAX,
+    [POWER_LOCK_NETWORK] = ESP_PM_CPU_FREQ_MAX,
+};
+
+static esp_pm_lock_handle_t locks[POWER_LOCK_COUNT];
+#endif
+
+static bool pm_enabled = false;
+static volatile bool wifi_multicast = false;    // Wake for every DTIM (power_set_wifi_multicast)
+
+// Lock accounting (also kept with power saving off, for the estimate)
+static portMUX_TYPE stats_mux = portMUX_INITIALIZER_UNLOCKED;
+static uint16_t held_count[POWER_LOCK_COUNT];
+static int64_t held_since_us[POWER_LOCK_COUNT];
+static int64_t held_us[POWER_LOCK_COUNT];
+static uint16_t busy_count = 0;
+static int64_t busy_since_us = 0;
+static int64_t busy_us = 0;
+
+esp_err_t power_init(void)
+{
+#if CONFIG_PM_ENABLE && POWER_SAVE_ENABLED
+    esp_pm_config_t pm_config = {
+        .max_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+        .min_freq_mhz = POWER_MIN_FREQ_MHZ,
+        .light_sleep_enable = false,
+    };
+    esp_err_t err = esp_pm_configure(&pm_config);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "DFS not available: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    for (int i = 0; i < POWER_LOCK_COUNT; i++) {
+        err = esp_pm_lock_create(lock_types[i], 0, lock_names[i], &locks[i]);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to create %s lock: %s", lock_names[i], esp_err_to_name(err));
+            return err;
+        }
+    }
+
+    pm_enabled = true;
+    ESP_LOGI(TAG, "DFS %d-%d MHz, modem sleep every %d beacons", POWER_MIN_FREQ_MHZ,
+             CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ, POWER_WIFI_LISTEN_INTERVAL);
+#else
+    ESP_LOGI(TAG, "Power saving off (POWER_SAVE_ENABLED / CONFIG_PM_ENABLE)");
+#endif
+    return ESP_OK;
+}
+
+void power_apply_wifi(void)
+{
+    if (!pm_enabled) {
+        return;     // Keep the driver default (wake for every DTIM)
+    }
+    // MAX_MODEM sleeps through DTIM beacons, and the multicast sent after them is lost
+    bool multicast = wifi_multicast;
+    esp_err_t err = esp_wifi_set_ps(multicast ? WIFI_PS_MIN_MODEM : WIFI_PS_MAX_MODEM);
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Modem sleep: %s", multicast ? "every DTIM (multicast)" : "listen interval");
+    } else if (err != ESP_ERR_WIFI_NOT_INIT) {
+        ESP_LOGW(TAG, "Modem sleep not set: %s", esp_err_to_name(err));
+    }
+}
+
+void power_set_wifi_multicast(bool needed)
+{
+    if (wifi_multicast == needed) {
+        return;
+    }
+    wifi_multicast = needed;
+    power_apply_wifi();     // Before WiFi is up this only records it for the next call
+}
+
+void power_lock_acquire(power_lock_t lock)
+{
+    if (lock >= POWER_LOCK_COUNT) {
+        return;
+    }
+#if CONFIG_PM_ENABLE && POWER_SAVE_ENABLED
+    if (locks[lock]) {
+        esp_pm_lock_acquire(locks[lock]);
+    }
+#endif
+
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&stats_mux);
+    if (held_count[lock]++ == 0) {
+        held_since_us[lock] = now;
+    }
+    if (busy_count++ == 0) {
+        busy_since_us = now;
+    }
+    portEXIT_CRITICAL(&stats_mux);
+}
+
+void power_lock_release(power_lock_t lock)
+{
+    if (lock >= POWER_LOCK_COUNT) {
+        return;
+    }
+
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&stats_mux);
+    if (held_count[lock] > 0) {
+        if (--held_count[lock] == 0) {
+            held_us[lock] += now - held_since_us[lock];
+        }
+        if (--busy_count == 0) {
+            busy_us += now - busy_since_us;
+        }
+    }
+    portEXIT_CRITICAL(&stats_mux);
+
+#if CONFIG_PM_ENABLE && POWER_SAVE_ENABLED
+    if (locks[lock]) {
+        esp_pm_lock_release(locks[lock]);
+    }
+#endif
+}
+
+void power_get_stats(power_stats_t *stats)
+{
+    int64_t now = esp_timer_get_time();
+    int64_t held[POWER_LOCK_COUNT];
+    int64_t busy;
+
+    portENTER_CRITICAL(&stats_mux);
+    for (int i = 0; i < POWER_LOCK_COUNT; i++) {
+        held[i] = held_us[i] + (held_count[i] ? now - held_since_us[i] : 0);
+    }
+    busy = busy_us + (busy_count ? now - busy_since_us : 0);
+    portEXIT_CRITICAL(&stats_mux);
+
+    stats->enabled = pm_enabled;
+    stats->uptime_s = (uint32_t)(now / 1000000);
+    for (int i = 0; i < POWER_LOCK_COUNT; i++) {
+        stats->held_ms[i] = (uint32_t)(held[i] / 1000);
+    }
+    stats->busy_ms = (uint32_t)(busy / 1000);
+
+    // Time-weighted: busy at full power, the rest at the idle draw
+    int64_t idle_ma = pm_enabled ? POWER_EST_IDLE_MA : POWER_EST_IDLE_NO_PM_MA;
+    if (now > 0) {
+        stats->avg_current_ma = (uint32_t)((busy * POWER_EST_BUSY_MA + (now - busy) * idle_ma) / now);
+    } else {
+        stats->avg_current_ma = (uint32_t)idle_ma;
+    }
+}
+
+void power_log_stats(void)
+{
+    power_stats_t stats;
+    power_get_stats(&stats);
+
+    uint32_t busy_permille = stats.uptime_s ? stats.busy_ms / stats.uptime_s : 0;
+    ESP_LOGI(TAG, "Est. %lu mA average, busy %lu.%lu%% of %lu s (display %lu s, audio %lu s, network %lu s)",
+             stats.avg_current_ma, busy_permille / 10, busy_permille % 10, stats.uptime_s,
+             stats.held_ms[POWER_LOCK_DISPLAY] / 1000, stats.held_ms[POWER_LOCK_AUDIO] / 1000,
+             stats.held_ms[POWER_LOCK_NETWORK] / 1000);
+#if CONFIG_PM_PROFILING
+    esp_pm_dump_locks(stdout);
+#endif
+}
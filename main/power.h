@@ -0,0 +1,112 @@
+/**
+ * Power Management
+ * Dynamic frequency scaling, WiFi modem sleep and PM locks for busy work
+ *
+ * With POWER_SAVE_ENABLED (config.h) and CONFIG_PM_ENABLE, the CPU drops
+ * to POWER_MIN_FREQ_MHZ whenever nothing holds a lock, and the station
+ * sleeps between beacons, waking every POWER_WIFI_LISTEN_INTERVAL of
+ * them. The device only does real work around each glucose poll, so it
+ * spends nearly all its time at the low clock.
+ *
+ * Work that needs the clock takes a lock for its duration:
+ *   POWER_LOCK_DISPLAY   LVGL rendering and flushing a frame
+ *   POWER_LOCK_AUDIO     Codec playback (I2S needs a steady APB clock)
+ *   POWER_LOCK_NETWORK   An HTTPS transfer (the TLS handshake is CPU bound)
+ * Drivers (WiFi, SPI, I2C, I2S) hold their own locks while they are busy.
+ *
+ * Automatic light sleep stays off: the LVGL tick and button timers fire
+ * every few milliseconds and the backlight PWM runs from the APB clock,
+ * so the chip would seldom sleep and the backlight would go dark when it
+ * did.
+ *
+ * The alarm is unaffected: it is raised by the poll itself and its
+ * playback holds the audio lock. Inbound unicast (MQTT commands) is
+ * buffered by the access point and waits for the next wake-up, about
+ * one listen interval (~300 ms). Multicast is only sent after DTIM
+ * beacons and is not buffered for a station that sleeps through them,
+ * so while LAN share has its socket open the station wakes for every
+ * DTIM instead (WIFI_PS_MIN_MODEM, see power_set_wifi_multicast).
+ *
+ * The time each lock is held is counted, and the average current is
+ * estimated from it (see power_get_stats).
+ */
+
+#ifndef POWER_H
+#define POWER_H
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Lowest CPU clock under DFS (the crystal; the lowest WiFi runs on)
+#define POWER_MIN_FREQ_MHZ          40
+
+// Beacons between station wake-ups in modem sleep (102.4 ms each)
+#define POWER_WIFI_LISTEN_INTERVAL  3
+
+/**
+ * Work that keeps the clock up
+ */
+typedef enum {
+    POWER_LOCK_DISPLAY = 0,
+    POWER_LOCK_AUDIO,
+    POWER_LOCK_NETWORK,
+    POWER_LOCK_COUNT
+} power_lock_t;
+
+/**
+ * Power statistics (since boot)
+ */
+typedef struct {
+    bool enabled;                           // DFS and modem sleep in effect
+    uint32_t uptime_s;
+    uint32_t held_ms[POWER_LOCK_COUNT];     // Time each lock was held
+    uint32_t busy_ms;                       // Time any lock was held
+    uint32_t avg_current_ma;                // Estimated average for the ESP32-S3 module (no LCD)
+} power_stats_t;
+
+/**
+ * Configure DFS and create the locks
+ * Call once early in app_main, before the display and WiFi start.
+ * Does nothing (and succeeds) when power saving is off.
+ *
+ * @return ESP_OK on success
+ */
+esp_err_t power_init(void);
+
+/**
+ * Put the station into modem sleep with POWER_WIFI_LISTEN_INTERVAL
+ * Call after esp_wifi_start() in station mode; set the same interval in
+ * wifi_config_t.sta.listen_interval. While multicast is needed the
+ * station wakes for every DTIM beacon instead.
+ */
+void power_apply_wifi(void);
+
+/**
+ * Note whether multicast must be received (LAN share socket open)
+ * Switches the modem sleep mode at once if it changes.
+ */
+void power_set_wifi_multicast(bool needed);
+
+/**
+ * Hold the clock up for some work
+ * Locks nest; every acquire needs a matching release.
+ */
+void power_lock_acquire(power_lock_t lock);
+
+/**
+ * Release a lock taken with power_lock_acquire
+ */
+void power_lock_release(power_lock_t lock);
+
+/**
+ * Get the statistics (held times include locks held right now)
+ */
+void power_get_stats(power_stats_t *stats);
+
+/**
+ * Log the statistics (and the esp_pm mode times with CONFIG_PM_PROFILING)
+ */
+void power_log_stats(void);
+
+#endif // POWER_H
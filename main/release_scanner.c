@@ -0,0 +1,247 @@
+/**
+ * Release Scanner Implementation
+ */
+
+#include "release_scanner.h"
+#include <string.h>
+
+typedef enum {
+    SCAN_VALUE = 0,             // Between tokens
+    SCAN_STRING,
+    SCAN_ESCAPE,
+    SCAN_UNICODE,
+    SCAN_LITERAL,               // Number, true, false or null
+} scan_state_t;
+
+// Level the asset objects sit at: { "assets": [ { ... } ] }
+#define ASSET_DEPTH     3
+
+static bool level_is_object(const release_scanner_t *scanner, uint8_t depth)
+{
+    return depth > 0 && (scanner->objects & (1u << (depth - 1)));
+}
+
+static bool key_is(const release_scanner_t *scanner, const char *key)
+{
+    return !scanner->key_overflow && strcmp(scanner->key, key) == 0;
+}
+
+void release_scanner_init(release_scanner_t *scanner, release_scan_asset_cb_t asset_cb, void *ctx)
+{
+    memset(scanner, 0, sizeof(*scanner));
+    scanner->asset_cb = asset_cb;
+    scanner->ctx = ctx;
+}
+
+/**
+ * Start a string: a key, a value worth keeping, or one to skip
+ */
+static void begin_string(release_scanner_t *scanner)
+{
+    scanner->state = SCAN_STRING;
+    scanner->capture = NULL;
+    if (scanner->expect_key) {
+        scanner->key_len = 0;
+        scanner->key_overflow = false;
+        scanner->key[0] = '\0';
+        return;
+    }
+
+    if (scanner->depth == 1 && key_is(scanner, "tag_name")) {
+        scanner->capture = scanner->tag_name;
+        scanner->capture_size = sizeof(scanner->tag_name);
+    } else if (scanner->depth == ASSET_DEPTH && scanner->in_assets && level_is_object(scanner, ASSET_DEPTH)) {
+        if (key_is(scanner, "name")) {
+            scanner->capture = scanner->asset.name;
+            scanner->capture_size = sizeof(scanner->asset.name);
+        } else if (key_is(scanner, "browser_download_url")) {
+            scanner->capture = scanner->asset.url;
+            scanner->capture_size = sizeof(scanner->asset.url);
+        } else if (key_is(scanner, "digest")) {
+            scanner->capture = scanner->asset.digest;
+            scanner->capture_size = sizeof(scanner->asset.digest);
+        }
+    }
+    scanner->capture_len = 0;
+}
+
+static void string_char(release_scanner_t *scanner, char c)
+{
+    if (scanner->expect_key) {
+        if (scanner->key_len < sizeof(scanner->key) - 1) {
+            scanner->key[scanner->key_len++] = c;
+            scanner->key[scanner->key_len] = '\0';
+        } else {
+            scanner->key_overflow = true;
+        }
+    } else if (scanner->capture) {
+        // capture_len == capture_size marks an over-long value
+        if (scanner->capture_len < scanner->capture_size - 1) {
+            scanner->capture[scanner->capture_len++] = c;
+        } else {
+            scanner->capture_len = scanner->capture_size;
+        }
+    }
+}
+
+static void end_string(release_scanner_t *scanner)
+{
+    scanner->state = SCAN_VALUE;
+    if (scanner->capture) {
+        if (scanner->capture_len >= scanner->capture_size) {
+            scanner->capture_len = 0;   // Dropped, not truncated
+        }
+        scanner->capture[scanner->capture_len] = '\0';
+        scanner->capture = NULL;
+    }
+}
+
+static bool open_container(release_scanner_t *scanner, bool object)
+{
+    if (scanner->depth >= RELEASE_SCAN_MAX_DEPTH || (scanner->depth > 0 && scanner->expect_key) ||
+        (scanner->depth == 0 && !object)) {
+        return false;
+    }
+    if (!object && scanner->depth == 1 && key_is(scanner, "assets")) {
+        scanner->in_assets = true;
+    }
+    scanner->depth++;
+    if (object) {
+        scanner->objects |= 1u << (scanner->depth - 1);
+    } else {
+        scanner->objects &= ~(1u << (scanner->depth - 1));
+    }
+    scanner->expect_key = object;
+    if (object && scanner->depth == ASSET_DEPTH && scanner->in_assets) {
+        memset(&scanner->asset, 0, sizeof(scanner->asset));
+    }
+    return true;
+}
+
+static bool close_container(release_scanner_t *scanner, bool object)
+{
+    if (scanner->depth == 0 || level_is_object(scanner, scanner->depth) != object) {
+        return false;
+    }
+    if (object && scanner->depth == ASSET_DEPTH && scanner->in_assets && scanner->asset_cb) {
+        scanner->asset_cb(scanner->ctx, &scanner->asset);
+    }
+    if (!object && scanner->depth == 2) {
+        scanner->in_assets = false;
+    }
+    scanner->depth--;
+    scanner->expect_key = false;
+    if (scanner->depth == 0) {
+        scanner->done = true;
+    }
+    return true;
+}
+
+static bool value_char(release_scanner_t *scanner, char c)
+{
+    switch (c) {
+        case ' ': case '\t': case '\r': case '\n':
+            return true;
+        case '{':
+            return !scanner->done && open_container(scanner, true);
+        case '[':
+            return !scanner->done && open_container(scanner, false);
+        case '}':
+            return close_container(scanner, true);
+        case ']':
+            return close_container(scanner, false);
+        case ',':
+            if (scanner->depth == 0) {
+                return false;
+            }
+            scanner->expect_key = level_is_object(scanner, scanner->depth);
+            return true;
+        case ':':
+            if (!level_is_object(scanner, scanner->depth)) {
+                return false;
+            }
+            scanner->expect_key = false;
+            return true;
+        case '"':
+            if (scanner->depth == 0) {
+                return false;
+            }
+            begin_string(scanner);
+            return true;
+        default:
+            if (scanner->depth == 0 || scanner->expect_key) {
+                return false;
+            }
+            scanner->state = SCAN_LITERAL;
+            return true;
+    }
+}
+
+static bool is_hex(char c)
+{
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+bool release_scanner_feed(release_scanner_t *scanner, const char *data, size_t len)
+{
+    for (size_t i = 0; i < len && !scanner->failed; i++) {
+        char c = data[i];
+        switch (scanner->state) {
+            case SCAN_VALUE:
+                scanner->failed = !value_char(scanner, c);
+                break;
+
+            case SCAN_STRING:
+                if (c == '"') {
+                    end_string(scanner);
+                } else if (c == '\\') {
+                    scanner->state = SCAN_ESCAPE;
+                } else {
+                    string_char(scanner, c);
+                }
+                break;
+
+            case SCAN_ESCAPE:
+                scanner->state = SCAN_STRING;
+                switch (c) {
+                    case 'n': string_char(scanner, '\n'); break;
+                    case 't': string_char(scanner, '\t'); break;
+                    case 'r': string_char(scanner, '\r'); break;
+                    case 'b': string_char(scanner, '\b'); break;
+                    case 'f': string_char(scanner, '\f'); break;
+                    case '"': case '\\': case '/': string_char(scanner, c); break;
+                    case 'u':
+                        // Kept strings are ASCII (tags, file names, URLs)
+                        string_char(scanner, '?');
+                        scanner->unicode_left = 4;
+                        scanner->state = SCAN_UNICODE;
+                        break;
+                    default:
+                        scanner->failed = true;
+                        break;
+                }
+                break;
+
+            case SCAN_UNICODE:
+                if (!is_hex(c)) {
+                    scanner->failed = true;
+                } else if (--scanner->unicode_left == 0) {
+                    scanner->state = SCAN_STRING;
+                }
+                break;
+
+            case SCAN_LITERAL:
+                if (c == ',' || c == '}' || c == ']' || c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+                    scanner->state = SCAN_VALUE;
+                    scanner->failed = !value_char(scanner, c);
+                }
+                break;
+        }
+    }
+    return !scanner->failed;
+}
+
+bool release_scanner_complete(const release_scanner_t *scanner)
+{
+    return scanner->done && !scanner->failed && scanner->state == SCAN_VALUE;
+}
@@ -0,0 +1,85 @@
+/**
+ * Release Scanner
+ * Incremental scanner for GitHub's releases/latest JSON
+ *
+ * The response is fed in whatever chunks the HTTP client returns and
+ * walked once without building a DOM. Only the top-level "tag_name" and,
+ * for each object in the top-level "assets" array, its "name",
+ * "browser_download_url" and "digest" are kept; everything else
+ * (release notes, uploader objects, ...) is skipped as it streams past.
+ *
+ * A kept string longer than its buffer is dropped (left empty), never
+ * truncated, so a cut-off URL is never used.
+ *
+ * Pure C with no ESP-IDF dependencies so it can be fuzzed on a host.
+ */
+
+#ifndef RELEASE_SCANNER_H
+#define RELEASE_SCANNER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define RELEASE_SCAN_TAG_LEN        32
+#define RELEASE_SCAN_NAME_LEN       96
+#define RELEASE_SCAN_URL_LEN        192
+#define RELEASE_SCAN_DIGEST_LEN     80
+#define RELEASE_SCAN_KEY_LEN        24
+#define RELEASE_SCAN_MAX_DEPTH      32
+
+/**
+ * One release asset
+ */
+typedef struct {
+    char name[RELEASE_SCAN_NAME_LEN];
+    char url[RELEASE_SCAN_URL_LEN];         // browser_download_url
+    char digest[RELEASE_SCAN_DIGEST_LEN];   // "sha256:<hex>" (may be empty)
+} release_scan_asset_t;
+
+/**
+ * Called once per asset object, when it closes
+ */
+typedef void (*release_scan_asset_cb_t)(void *ctx, const release_scan_asset_t *asset);
+
+typedef struct {
+    release_scan_asset_cb_t asset_cb;
+    void *ctx;
+    char tag_name[RELEASE_SCAN_TAG_LEN];
+    release_scan_asset_t asset;             // Asset being scanned
+
+    // Parser state
+    uint8_t state;
+    uint8_t depth;
+    uint32_t objects;                       // Bit n set: level n is an object
+    bool expect_key;
+    bool in_assets;                         // Level 2 is the "assets" array
+    bool failed;
+    bool done;
+    uint8_t unicode_left;                   // Hex digits left in a \uXXXX escape
+    char key[RELEASE_SCAN_KEY_LEN];
+    size_t key_len;
+    bool key_overflow;
+    char *capture;                          // String value being kept, or NULL
+    size_t capture_size;
+    size_t capture_len;
+} release_scanner_t;
+
+/**
+ * Start scanning a response
+ * @param asset_cb Asset callback (may be NULL)
+ */
+void release_scanner_init(release_scanner_t *scanner, release_scan_asset_cb_t asset_cb, void *ctx);
+
+/**
+ * Scan the next chunk of the response
+ * @return false if the JSON is malformed (or nested too deeply)
+ */
+bool release_scanner_feed(release_scanner_t *scanner, const char *data, size_t len);
+
+/**
+ * Whether the whole top-level object has been scanned
+ */
+bool release_scanner_complete(const release_scanner_t *scanner);
+
+#endif // RELEASE_SCANNER_H
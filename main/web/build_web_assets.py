@@ -0,0 +1,162 @@
+#!/usr/bin/env python3
+"""
+Build step for the provisioning web pages.
+
+Minifies and gzips every asset in this directory and writes a C source file
+with the compressed bytes, a strong ETag per asset and a lookup table
+(see main/web_assets.h). Run automatically by main/CMakeLists.txt.
+
+Minification is deliberately conservative: leading indentation, blank lines
+and HTML comments are removed. Line breaks are kept, so inline scripts keep
+automatic semicolon insertion. Trailing spaces are kept. JavaScript line
+comments are not stripped; the build fails if a <script> block contains one
+(use /* */ instead), because they break as soon as lines are joined.
+
+{{MACRO}} placeholders are replaced with string #defines from config.h
+(e.g. {{DEVICE_NAME}}, {{DEVICE_VERSION}}).
+
+Usage: build_web_assets.py --config main/config.h --output web_assets_data.c asset...
+"""
+
+import argparse
+import gzip
+import hashlib
+import os
+import re
+import sys
+
+CONTENT_TYPES = {
+    '.html': 'text/html',
+    '.css': 'text/css',
+    '.js': 'application/javascript',
+    '.json': 'application/json',
+    '.svg': 'image/svg+xml',
+}
+
+
+def load_defines(config_path):
+    defines = {}
+    with open(config_path, encoding='utf-8') as f:
+        for line in f:
+            m = re.match(r'\s*#define\s+(\w+)\s+"((?:[^"\\]|\\.)*)"', line)
+            if m:
+                defines[m.group(1)] = m.group(2)
+    return defines
+
+
+def minify(text):
+    text = re.sub(r'<!--.*?-->', '', text, flags=re.S)
+    return '\n'.join(line.lstrip() for line in text.splitlines() if line.strip())
+
+
+def find_line_comment(script):
+    """Return the offset of a // comment outside string literals, or -1."""
+    i = 0
+    quote = None
+    while i < len(script):
+        c = script[i]
+        if quote:
+            if c == '\\':
+                i += 1
+            elif c == quote:
+                quote = None
+        elif c in '\'"`':
+            quote = c
+        elif script.startswith('/*', i):
+            end = script.find('*/', i + 2)
+            if end < 0:
+                return -1
+            i = end + 1
+        elif script.startswith('//', i):
+            return i
+        i += 1
+    return -1
+
+
+def check_scripts(text, path):
+    for m in re.finditer(r'<script[^>]*>(.*?)</script>', text, flags=re.S | re.I):
+        offset = find_line_comment(m.group(1))
+        if offset >= 0:
+            line = text.count('\n', 0, m.start(1) + offset) + 1
+            sys.exit(f'{path}: // comment in <script> (minified line {line}); use /* */')
+
+
+def substitute(text, defines, path):
+    def repl(m):
+        name = m.group(1)
+        if name not in defines:
+            sys.exit(f'{path}: unknown placeholder {{{{{name}}}}}')
+        return defines[name]
+    return re.sub(r'\{\{(\w+)\}\}', repl, text)
+
+
+def c_bytes(data):
+    lines = []
+    for i in range(0, len(data), 16):
+        lines.append('    ' + ', '.join(f'0x{b:02x}' for b in data[i:i + 16]) + ',')
+    return '\n'.join(lines)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('--config', required=True, help='config.h with string #defines for placeholders')
+    parser.add_argument('--output', required=True, help='generated C file')
+    parser.add_argument('assets', nargs='+')
+    args = parser.parse_args()
+
+    defines = load_defines(args.config)
+    out = [
+        '// Generated by main/web/build_web_assets.py - do not edit',
+        '',
+        '#include "web_assets.h"',
+        '',
+    ]
+    entries = []
+    total_raw = 0
+    total_gz = 0
+
+    for index, path in enumerate(sorted(args.assets)):
+        name = os.path.basename(path)
+        ext = os.path.splitext(name)[1]
+        if ext not in CONTENT_TYPES:
+            sys.exit(f'{path}: unsupported asset type')
+
+        with open(path, encoding='utf-8') as f:
+            text = substitute(minify(f.read()), defines, path)
+        if ext == '.html':
+            check_scripts(text, path)
+        raw = text.encode('utf-8')
+        # mtime=0 keeps the output (and ETag) reproducible
+        compressed = gzip.compress(raw, compresslevel=9, mtime=0)
+        etag = '"' + hashlib.sha256(compressed).hexdigest()[:16] + '"'
+        total_raw += len(raw)
+        total_gz += len(compressed)
+
+        out.append(f'// {name}: {len(raw)} bytes minified, {len(compressed)} bytes gzipped')
+        out.append(f'static const uint8_t asset_{index}[] = {{')
+        out.append(c_bytes(compressed))
+        out.append('};')
+        out.append('')
+        etag_c = etag.replace('"', '\\"')
+        entries.append(f'    {{"{name}", "{CONTENT_TYPES[ext]}", asset_{index}, sizeof(asset_{index}), "{etag_c}"}},')
+
+    out.append('const web_asset_t web_assets[] = {')
+    out.extend(entries)
+    out.append('};')
+    out.append('')
+    out.append(f'const size_t web_assets_count = {len(entries)};')
+    out.append('')
+
+    content = '\n'.join(out)
+    # Only touch the output when it changes to avoid needless recompiles
+    if os.path.exists(args.output):
+        with open(args.output, encoding='utf-8') as f:
+            if f.read() == content:
+                return
+    with open(args.output, 'w', encoding='utf-8') as f:
+        f.write(content)
+    print(f'web assets: {len(entries)} files, {total_raw} -> {total_gz} bytes')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,62 @@
+/**
+ * Web Assets Implementation
+ */
+
+#include "web_assets.h"
+#include "esp_log.h"
+#include <string.h>
+
+static const char *TAG = "WEB_ASSETS";
+
+const web_asset_t* web_assets_find(const char *name)
+{
+    for (size_t i = 0; i < web_assets_count; i++) {
+        if (strcmp(web_assets[i].name, name) == 0) {
+            return &web_assets[i];
+        }
+    }
+    return NULL;
+}
+
+// Check If-None-Match against the asset's ETag (also accepts a list or *)
+static bool etag_matches(httpd_req_t *req, const web_asset_t *asset)
+{
+    char header[128];
+    size_t len = httpd_req_get_hdr_value_len(req, "If-None-Match");
+    if (len == 0 || len >= sizeof(header)) {
+        return false;
+    }
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", header, sizeof(header)) != ESP_OK) {
+        return false;
+    }
+    return strcmp(header, "*") == 0 || strstr(header, asset->etag) != NULL;
+}
+
+esp_err_t web_assets_send(httpd_req_t *req, const char *name, bool cacheable)
+{
+    const web_asset_t *asset = web_assets_find(name);
+    if (!asset) {
+        ESP_LOGE(TAG, "Asset not found: %s", name);
+        return httpd_resp_send_404(req);
+    }
+
+    if (!cacheable) {
+        // Captive portal probes must never be answered from cache
+        httpd_resp_set_hdr(req, "Cache-Control", "no-cache, no-store, must-revalidate");
+        httpd_resp_set_hdr(req, "Pragma", "no-cache");
+        httpd_resp_set_hdr(req, "Expires", "0");
+    } else {
+        // Always revalidate; an unchanged page costs a 304 with no body
+        httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+        httpd_resp_set_hdr(req, "ETag", asset->etag);
+        if (etag_matches(req, asset)) {
+            httpd_resp_set_status(req, "304 Not Modified");
+            return httpd_resp_send(req, NULL, 0);
+        }
+    }
+
+    httpd_resp_set_type(req, asset->content_type);
+    httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+    httpd_resp_set_hdr(req, "Vary", "Accept-Encoding");
+    return httpd_resp_send(req, (const char *)asset->data, asset->length);
+}
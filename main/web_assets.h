@@ -0,0 +1,52 @@
+/**
+ * Web Assets
+ * Gzip-precompressed provisioning pages (sources in main/web/)
+ *
+ * The asset table is generated at build time by main/web/build_web_assets.py.
+ * Pages are served with Content-Encoding: gzip and a strong ETag so repeat
+ * visits are answered with 304 Not Modified.
+ */
+
+#ifndef WEB_ASSETS_H
+#define WEB_ASSETS_H
+
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * One embedded asset
+ */
+typedef struct {
+    const char *name;           // File name in main/web/ (e.g. "settings.html")
+    const char *content_type;
+    const uint8_t *data;        // Gzip-compressed content
+    size_t length;
+    const char *etag;           // Quoted strong ETag
+} web_asset_t;
+
+// Generated table
+extern const web_asset_t web_assets[];
+extern const size_t web_assets_count;
+
+/**
+ * Find an asset by file name
+ * @param name File name (e.g. "main.html")
+ * @return Asset or NULL if not found
+ */
+const web_asset_t* web_assets_find(const char *name);
+
+/**
+ * Send an asset
+ * Answers 304 Not Modified when the request's If-None-Match matches.
+ *
+ * @param req HTTP request
+ * @param name File name of the asset
+ * @param cacheable false for captive portal probes (no ETag, no-store)
+ * @return ESP_OK on success
+ */
+esp_err_t web_assets_send(httpd_req_t *req, const char *name, bool cacheable);
+
+#endif // WEB_ASSETS_H
@@ -6,32 +6,56 @@
 #include "config.h"
 #include "libre_credentials.h"
 #include "librelinkup.h"
+#include "libre_jobs.h"
 #include "global_settings.h"
 #include "ota_update.h"
 #include "ir_transmitter.h"
 #include "ir_remote_config.h"
+#include "ir_learning.h"
+#include "web_assets.h"
+#include "form_parser.h"
+#include "wifi_scan.h"
+#include "wifi_networks.h"
+#include "captive_dns.h"
+#include "glucose_events.h"
+#include "glucose_api.h"
+#include "nightscout.h"
+#include "mqtt_publisher.h"
+#include "lan_share.h"
+#include "power.h"
 #include "esp_wifi.h"
 #include "esp_event.h"
 #include "esp_log.h"
+#include "esp_mac.h"
 #include "esp_timer.h"
 #include "nvs_flash.h"
 #include "esp_netif.h"
 #include "esp_http_server.h"
+#include "freertos/event_groups.h"
 #include <string.h>
 #include <stdlib.h>
 
 static const char *TAG = "WIFI_MANAGER";
 
-// WiFi credentials storage key
+// Fast-connect info storage key (saved networks are in wifi_networks)
 #define WIFI_NAMESPACE "wifi_config"
-#define WIFI_SSID_KEY "ssid"
-#define WIFI_PASS_KEY "password"
+#define WIFI_FAST_KEY "fast_conn"
+#define WIFI_FAST_VERSION 1
+
+// Longest wait for the scan that ranks saved networks
+#define WIFI_SELECT_TIMEOUT_MS 8000
+
+// Pause before scanning again once every saved network has failed
+#define WIFI_RESELECT_MS 30000
 
 // AP mode configuration
 #define AP_SSID WIFI_AP_SSID
 #define AP_PASS WIFI_AP_PASSWORD
 #define AP_MAX_CONN 4
 
+// Largest accepted form POST body
+#define FORM_MAX_BODY_LEN 2048
+
 static bool wifi_connected = false;
 static bool wifi_initialized = false;
 static esp_netif_t *sta_netif = NULL;
@@ -42,273 +66,51 @@ static wifi_connected_cb_t connected_callback = NULL;
 static wifi_disconnected_cb_t disconnected_callback = NULL;
 static wifi_failed_cb_t failed_callback = NULL;
 static httpd_handle_t server = NULL;
-static int retry_count = 0;
-static const int max_retry_attempts = 5;
 
-// HTML for the main menu page
-static const char* html_main = 
-"<!DOCTYPE html><html><head><meta name='viewport' content='width=device-width, initial-scale=1'>"
-"<style>"
-"body{font-family:Arial;text-align:center;margin:20px;background:#1a1a1a;color:#fff;}"
-"h1{color:#4CAF50;}"
-"button{padding:15px 30px;margin:15px;font-size:18px;width:80%;max-width:300px;border-radius:8px;border:none;background:#4CAF50;color:white;cursor:pointer;display:block;margin-left:auto;margin-right:auto;}"
-"button:hover{background:#45a049;}"
-".info{margin:20px;color:#888;}"
-"</style>"
-"</head><body><h1>" DEVICE_NAME "</h1>"
-"<button onclick=\"location.href='/wifi'\">Configure WiFi</button>"
-"<button onclick=\"location.href='/librelink'\">Configure LibreLink</button>"
-"<button onclick=\"location.href='/settings'\">Global Settings</button>"
-"<div class='info'>Firmware v" DEVICE_VERSION "</div></body></html>";
-
-// HTML for WiFi setup page
-static const char* html_wifi = 
-"<!DOCTYPE html><html><head><meta name='viewport' content='width=device-width, initial-scale=1'>"
-"<style>"
-"body{font-family:Arial;text-align:center;margin:20px;background:#1a1a1a;color:#fff;}"
-"h1{color:#4CAF50;}"
-"input,button,select{padding:12px;margin:8px;font-size:16px;width:80%;max-width:300px;border-radius:5px;border:none;display:block;margin-left:auto;margin-right:auto;box-sizing:border-box;}"
-"button{background:#4CAF50;color:white;cursor:pointer;}button:hover{background:#45a049;}"
-"select{background:#333;color:#fff;}"
-".loading{margin:10px auto;}"
-".back{background:#666;margin-top:30px;}"
-"</style>"
-"<script>"
-"function scanNetworks(){document.getElementById('scan-btn').style.display='none';document.getElementById('loading').innerHTML='Scanning...';fetch('/scan').then(r=>r.json()).then(d=>{let s=document.getElementById('ssid-select');s.innerHTML='<option value=\"\">Select Network...</option>';d.forEach(n=>s.innerHTML+='<option value=\"'+n+'\">'+n+'</option>');s.style.display='block';document.getElementById('loading').innerHTML='';}).catch(e=>{alert('Scan failed: '+e);document.getElementById('scan-btn').style.display='block';document.getElementById('loading').innerHTML='';});}"
-"function selectSSID(){document.getElementById('ssid').value=document.getElementById('ssid-select').value;}"
-"</script>"
-"</head><body><h1>WiFi Setup</h1>"
-"<p>Connect your device to WiFi</p>"
-"<button id='scan-btn' onclick='scanNetworks()'>Scan for Networks</button>"
-"<div id='loading' class='loading'></div>"
-"<select id='ssid-select' onchange='selectSSID()' style='display:none'></select>"
-"<form action='/save' method='post'>"
-"<input id='ssid' name='ssid' placeholder='WiFi SSID (or scan above)' required><br>"
-"<input name='pass' type='password' placeholder='Password' required><br>"
-"<button type='submit'>Connect</button></form>"
-"<button class='back' onclick=\"location.href='/'\">Back to Menu</button></body></html>";
-
-// HTML for LibreLink setup page
-static const char* html_librelink = 
-"<!DOCTYPE html><html><head><meta name='viewport' content='width=device-width, initial-scale=1'>"
-"<style>"
-"body{font-family:Arial;text-align:center;margin:20px;background:#1a1a1a;color:#fff;}"
-"h1{color:#4CAF50;}"
-"input,button,select{padding:12px;margin:8px;font-size:16px;width:80%;max-width:300px;border-radius:5px;border:none;display:block;margin-left:auto;margin-right:auto;box-sizing:border-box;}"
-"button{background:#4CAF50;color:white;cursor:pointer;}button:hover{background:#45a049;}"
-"select{background:#333;color:#fff;}"
-".back{background:#666;margin-top:30px;}"
-".loading{color:#888;margin:10px;}"
-".error{color:#ff4444;margin:10px;}"
-".load-btn{background:#2196F3;margin-top:5px;}"
-".load-btn:hover{background:#0b7dda;}"
-"#patient-group{display:none;}"
-"</style>"
-"<script>"
-"function loadPatients(){"
-"  const email=document.getElementById('email').value;"
-"  const password=document.getElementById('password').value;"
-"  const server=document.getElementById('server').value;"
-"  if(!email||!password){alert('Please enter email and password first');return;}"
-"  document.getElementById('load-btn').style.display='none';"
-"  document.getElementById('loading').style.display='block';"
-"  document.getElementById('error').style.display='none';"
-"  fetch('/libre/patients?email='+encodeURIComponent(email)+'&pass='+encodeURIComponent(password)+'&server='+server)"
-"  .then(r=>r.json()).then(d=>{"
-"    document.getElementById('loading').style.display='none';"
-"    if(d.success){"
-"      let sel=document.getElementById('patient-select');"
-"      sel.innerHTML='<option value=\"\">Select Patient...</option>';"
-"      d.patients.forEach(p=>sel.innerHTML+='<option value=\"'+p.id+'\">'+p.name+'</option>');"
-"      document.getElementById('patient-group').style.display='block';"
-"      document.getElementById('load-btn').style.display='block';"
-"    }else{"
-"      document.getElementById('error').textContent='Login failed: '+(d.error||'Unknown error');"
-"      document.getElementById('error').style.display='block';"
-"      document.getElementById('load-btn').style.display='block';"
-"    }"
-"  }).catch(e=>{"
-"    document.getElementById('loading').style.display='none';"
-"    document.getElementById('error').textContent='Error: '+e;"
-"    document.getElementById('error').style.display='block';"
-"    document.getElementById('load-btn').style.display='block';"
-"  });"
-"}"
-"function selectPatient(){"
-"  const patientId=document.getElementById('patient-select').value;"
-"  document.getElementById('patient_id').value=patientId;"
-"  validateForm();"
-"}"
-"function validateForm(){"
-"  const email=document.getElementById('email').value;"
-"  const password=document.getElementById('password').value;"
-"  const patientId=document.getElementById('patient_id').value;"
-"  document.getElementById('save-btn').disabled=!(email&&password&&patientId);"
-"}"
-"window.onload=function(){document.getElementById('save-btn').disabled=true;}"
-"</script>"
-"</head><body><h1>LibreLink Setup</h1>"
-"<p>Configure your LibreLinkUp credentials</p>"
-"<form action='/libre/save' method='post'>"
-"<input id='email' name='email' type='email' placeholder='LibreLink Email' required oninput='validateForm()'><br>"
-"<input id='password' name='password' type='password' placeholder='LibreLink Password' required oninput='validateForm()'><br>"
-"<select id='server' name='server'><option value='0'>Global Server</option><option value='1'>EU Server</option></select>"
-"<button type='button' id='load-btn' class='load-btn' onclick='loadPatients()'>Load Patient(s)</button>"
-"<div id='loading' class='loading' style='display:none'>Loading patients...</div>"
-"<div id='error' class='error' style='display:none'></div>"
-"<div id='patient-group'>"
-"<select id='patient-select' onchange='selectPatient()'></select>"
-"</div>"
-"<input id='patient_id' name='patient_id' type='hidden'><br>"
-"<button id='save-btn' type='submit'>Save Credentials</button></form>"
-"<button class='back' onclick=\"location.href='/'\">Back to Menu</button></body></html>";
-
-// HTML for Global Settings page
-static const char* html_settings = 
-"<!DOCTYPE html><html><head><meta name='viewport' content='width=device-width, initial-scale=1'>"
-"<style>"
-"body{font-family:Arial;text-align:center;margin:20px;background:#1a1a1a;color:#fff;}"
-"h1{color:#4CAF50;}"
-"h2{color:#888;font-size:18px;margin-top:30px;margin-bottom:10px;text-align:left;max-width:300px;margin-left:auto;margin-right:auto;}"
-"input,button,select{padding:12px;margin:8px;font-size:16px;width:80%;max-width:300px;border-radius:5px;border:none;display:block;margin-left:auto;margin-right:auto;box-sizing:border-box;}"
-"button{background:#4CAF50;color:white;cursor:pointer;}button:hover{background:#45a049;}"
-".back{background:#666;margin-top:30px;}"
-".update-btn{background:#ff9800;}"
-".form-row{max-width:300px;margin:15px auto;text-align:left;}"
-".form-row label{display:block;margin-bottom:5px;color:#bbb;}"
-".toggle-container{display:flex;align-items:center;justify-content:space-between;max-width:300px;margin:15px auto;padding:12px;background:#2a2a2a;border-radius:5px;}"
-".toggle-container label{color:#bbb;margin:0;}"
-".switch{position:relative;display:inline-block;width:50px;height:24px;}"
-".switch input{opacity:0;width:0;height:0;}"
-".slider{position:absolute;cursor:pointer;top:0;left:0;right:0;bottom:0;background-color:#666;transition:.4s;border-radius:24px;}"
-".slider:before{position:absolute;content:\"\";height:16px;width:16px;left:4px;bottom:4px;background-color:white;transition:.4s;border-radius:50%;}"
-"input:checked + .slider{background-color:#4CAF50;}"
-"input:checked + .slider:before{transform:translateX(26px);}"
-".info{color:#888;font-size:12px;margin:5px auto;max-width:300px;text-align:left;}"
-"#updateMsg{margin:10px;color:#ff9800;min-height:20px;}"
-"</style>"
-"<script>"
-"function loadSettings(){"
-"  fetch('/settings/load').then(r=>r.json()).then(d=>{"
-"    if(d.success){"
-"      document.getElementById('interval').value=d.interval;"
-"      document.getElementById('moon_lamp').checked=d.moon_lamp;"
-"      document.getElementById('glucose_low').value=d.glucose_low;"
-"      document.getElementById('glucose_high').value=d.glucose_high;"
-"      document.getElementById('alarm_enabled').checked=d.alarm_enabled;"
-"      document.getElementById('alarm_snooze').value=d.alarm_snooze;"
-"      document.getElementById('alarm_low_enabled').checked=d.alarm_low_enabled;"
-"      document.getElementById('alarm_high_enabled').checked=d.alarm_high_enabled;"
-"    }"
-"  }).catch(e=>console.error('Failed to load settings:',e));"
-"}"
-"function checkUpdate(){"
-"  const btn=document.getElementById('updateBtn');"
-"  const msg=document.getElementById('updateMsg');"
-"  btn.disabled=true;"
-"  btn.innerText='Checking...';"
-"  msg.innerText='Checking for updates...';"
-"  fetch('/ota/check').then(r=>r.json()).then(d=>{"
-"    if(d.updateAvailable){"
-"      msg.innerText='Update available: '+d.currentVersion+' → '+d.newVersion;"
-"      if(confirm('Update available! Current: '+d.currentVersion+', New: '+d.newVersion+'\\n\\nWARNING: Do NOT disconnect power during update!\\n\\nProceed?')){"
-"        msg.innerText='Starting update...';"
-"        fetch('/ota/update',{method:'POST'}).then(()=>{"
-"          msg.innerText='Update in progress... Device will reboot when complete.';"
-"        });"
-"      }else{"
-"        btn.disabled=false;btn.innerText='Check for Updates';"
-"      }"
-"    }else if(d.error){"
-"      msg.innerText='Error: '+d.error;"
-"      btn.disabled=false;btn.innerText='Check for Updates';"
-"    }else{"
-"      msg.innerText='Already running latest version: '+d.currentVersion;"
-"      btn.disabled=false;btn.innerText='Check for Updates';"
-"    }"
-"  }).catch(e=>{msg.innerText='Failed to check for updates';btn.disabled=false;btn.innerText='Check for Updates';});"
-"}"
-"function testIRCommand(){"
-"  const addr=prompt('Enter IR Address (hex, e.g., FF00):','FF00');"
-"  if(!addr) return;"
-"  const cmd=prompt('Enter Command (hex, e.g., 40 for ON, 5C for OFF, 58 for RED):','40');"
-"  if(!cmd) return;"
-"  const msg=document.getElementById('irMsg');"
-"  msg.innerText='Sending IR command...';"
-"  fetch('/ir/send',{method:'POST',headers:{'Content-Type':'application/x-www-form-urlencoded'},body:'address='+addr+'&command='+cmd})"
-"    .then(r=>r.json()).then(d=>{"
-"      if(d.success)msg.innerText='Command sent successfully!';"
-"      else msg.innerText='Failed: '+(d.error||'Unknown error');"
-"      setTimeout(()=>msg.innerText='',3000);"
-"    }).catch(e=>{msg.innerText='Error sending command';setTimeout(()=>msg.innerText='',3000);});"
-"}"
-"window.onload=loadSettings;"
-"</script>"
-"</head><body><h1>Global Settings</h1>"
-"<form action='/settings/save' method='post'>"
-"<h2>LibreLink Configuration</h2>"
-"<div class='form-row'>"
-"<label for='interval'>Update Interval (minutes)</label>"
-"<input id='interval' name='interval' type='number' min='1' value='5' required>"
-"<div class='info'>How often to fetch glucose data (minimum 1 minute)</div>"
-"</div>"
-"<h2>Moon Lamp Control</h2>"
-"<div class='toggle-container'>"
-"<label for='moon_lamp'>Enable Moon Lamp</label>"
-"<label class='switch'>"
-"<input id='moon_lamp' name='moon_lamp' type='checkbox' value='1'>"
-"<span class='slider'></span>"
-"</label>"
-"</div>"
-"<div class='info' style='text-align:center;margin-top:5px;'>Control Moon Lamp via IR based on glucose levels</div>"
-"<button type='button' class='update-btn' style='margin-top:10px;' onclick='testIRCommand()'>Test IR Command</button>"
-"<div id='irMsg' style='color:#ff9800;min-height:20px;margin-top:5px;'></div>"
-"<h2>Glucose Thresholds</h2>"
-"<div class='form-row'>"
-"<label for='glucose_low'>Low Threshold (mmol/L)</label>"
-"<input id='glucose_low' name='glucose_low' type='number' step='0.1' min='1.0' max='20.0' value='3.9' required>"
-"<div class='info'>Glucose level below this is considered HYPO</div>"
-"</div>"
-"<div class='form-row'>"
-"<label for='glucose_high'>High Threshold (mmol/L)</label>"
-"<input id='glucose_high' name='glucose_high' type='number' step='0.1' min='5.0' max='30.0' value='13.3' required>"
-"<div class='info'>Glucose level above this is considered HIGH</div>"
-"</div>"
-"<h2>Alarm Settings</h2>"
-"<div class='toggle-container'>"
-"<label for='alarm_enabled'>Enable Glucose Alarms</label>"
-"<label class='switch'>"
-"<input id='alarm_enabled' name='alarm_enabled' type='checkbox' value='1' checked>"
-"<span class='slider'></span>"
-"</label>"
-"</div>"
-"<div class='info' style='text-align:center;margin-top:5px;'>Play audio alarm when glucose thresholds are violated</div>"
-"<div class='toggle-container'>"
-"<label for='alarm_low_enabled'>Enable Low Glucose Alarm</label>"
-"<label class='switch'>"
-"<input id='alarm_low_enabled' name='alarm_low_enabled' type='checkbox' value='1' checked>"
-"<span class='slider'></span>"
-"</label>"
-"</div>"
-"<div class='info' style='text-align:center;margin-top:5px;'>Play alarm sound for HYPO (low glucose)</div>"
-"<div class='toggle-container'>"
-"<label for='alarm_high_enabled'>Enable High Glucose Alarm</label>"
-"<label class='switch'>"
-"<input id='alarm_high_enabled' name='alarm_high_enabled' type='checkbox' value='1'>"
-"<span class='slider'></span>"
-"</label>"
-"</div>"
-"<div class='info' style='text-align:center;margin-top:5px;'>Play alarm sound for high glucose</div>"
-"<div class='form-row'>"
-"<label for='alarm_snooze'>Snooze Duration (minutes)</label>"
-"<input id='alarm_snooze' name='alarm_snooze' type='number' min='1' max='60' value='5' required>"
-"<div class='info'>How long to snooze alarm when mute button is pressed</div>"
-"</div>"
-"<button type='submit' style='margin-top:30px;'>Save Settings</button></form>"
-"<h2 style='text-align:center;'>Firmware Update</h2>"
-"<button id='updateBtn' class='update-btn' onclick='checkUpdate()'>Check for Updates</button>"
-"<div id='updateMsg'></div>"
-"<button class='back' onclick=\"location.href='/'\">Back to Menu</button></body></html>";
+// Saved networks, and the order they are tried in this round
+static wifi_network_t networks[WIFI_NETWORKS_MAX];
+static size_t network_count = 0;
+static wifi_candidate_t candidates[WIFI_NETWORKS_MAX];
+static size_t candidate_count = 0;
+static size_t candidate_pos = 0;
+static int network_attempts = 0;
+static bool round_scanned = false;          // Candidates were ranked from a scan
+static bool selecting = false;              // Waiting for a scan to rank networks
+static bool failure_reported = false;
+static esp_timer_handle_t reselect_timer = NULL;
+
+// Timer callbacks run in the esp_timer task; they post these to the default
+// event loop, so the candidate list and selection state are only ever
+// touched from the event loop task
+ESP_EVENT_DEFINE_BASE(WIFI_MANAGER_EVENT);
+enum {
+    WIFI_MANAGER_EVENT_RESELECT,        // Reselect timer fired
+    WIFI_MANAGER_EVENT_IP_POLL,         // Time to check for a missed IP event
+};
+
+#define WIFI_CONNECTED_BIT BIT0
+static EventGroupHandle_t wifi_events = NULL;
+
+// Last good association and lease, for a targeted connect on the next boot:
+// joining a known BSSID on a known channel skips the all-channel scan
+typedef struct {
+    uint32_t version;
+    char ssid[33];
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint32_t ip;                // Network byte order, as in esp_netif_ip_info_t
+    uint32_t netmask;
+    uint32_t gw;
+    uint32_t dns;
+} wifi_fast_cache_t;
+
+static wifi_fast_cache_t fast_cache;
+static bool fast_connect = false;           // Current attempt targets the cached AP
+static bool static_lease = false;           // Cached lease applied instead of DHCP
+static bool sta_connected_once = false;
+static int64_t connect_start_us = 0;
+static uint32_t connect_time_ms = 0;
+static uint32_t first_reading_ms = 0;       // Boot to first glucose reading, 0 until then
 
 static const char* success_page = 
 "<!DOCTYPE html><html><head><meta name='viewport' content='width=device-width, initial-scale=1'>"
@@ -344,80 +146,85 @@ static void url_decode(char *dst, const char *src, size_t dst_size) {
     dst[j] = '\0';
 }
 
+/**
+ * Stream a form POST body through the parser
+ * The body is received in small chunks, so no handler needs a buffer the
+ * size of the whole form. Sends a 400 response on failure.
+ */
+static esp_err_t parse_form_body(httpd_req_t *req, form_parser_t *parser) {
+    char chunk[128];
+    size_t remaining = req->content_len;
+
+    if (remaining > FORM_MAX_BODY_LEN) {
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Request too large");
+        return ESP_FAIL;
+    }
+
+    while (remaining > 0) {
+        int ret = httpd_req_recv(req, chunk, remaining < sizeof(chunk) ? remaining : sizeof(chunk));
+        if (ret == HTTPD_SOCK_ERR_TIMEOUT) {
+            continue;
+        }
+        if (ret <= 0) {
+            return ESP_FAIL;
+        }
+        remaining -= ret;
+        form_parser_feed(parser, chunk, ret);
+    }
+
+    form_status_t status = form_parser_finish(parser);
+    if (status != FORM_OK) {
+        ESP_LOGW(TAG, "Rejected form on %s: %s", req->uri, form_status_name(status));
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, form_status_name(status));
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
 // HTTP GET handler for root - main menu
 static esp_err_t root_get_handler(httpd_req_t *req) {
-    httpd_resp_send(req, html_main, strlen(html_main));
-    return ESP_OK;
+    return web_assets_send(req, "main.html", true);
 }
 
 // HTTP GET handler for WiFi setup page
 static esp_err_t wifi_get_handler(httpd_req_t *req) {
-    httpd_resp_send(req, html_wifi, strlen(html_wifi));
-    return ESP_OK;
+    return web_assets_send(req, "wifi.html", true);
 }
 
 // HTTP GET handler for LibreLink setup page
 static esp_err_t librelink_get_handler(httpd_req_t *req) {
-    httpd_resp_send(req, html_librelink, strlen(html_librelink));
-    return ESP_OK;
+    return web_assets_send(req, "librelink.html", true);
 }
 
 // HTTP POST handler for saving credentials
 static esp_err_t save_post_handler(httpd_req_t *req) {
-    char buf[200];
     char ssid[33] = {0};
     char pass[65] = {0};
-    int ret, remaining = req->content_len;
+    form_field_t fields[] = {
+        { .key = "ssid", .type = FORM_FIELD_STRING, .target = ssid, .size = sizeof(ssid) },
+        { .key = "pass", .type = FORM_FIELD_STRING, .target = pass, .size = sizeof(pass) },
+    };
+    form_parser_t parser;
+    form_parser_init(&parser, fields, sizeof(fields) / sizeof(fields[0]), NULL, NULL);
     
-    // Read POST data
-    if (remaining < sizeof(buf)) {
-        ret = httpd_req_recv(req, buf, remaining);
-        if (ret <= 0) {
-            return ESP_FAIL;
-        }
-        buf[ret] = '\0';
-        
-        // Parse form data
-        char *ssid_start = strstr(buf, "ssid=");
-        char *pass_start = strstr(buf, "pass=");
-        
-        if (ssid_start && pass_start) {
-            ssid_start += 5;
-            char *ssid_end = strchr(ssid_start, '&');
-            if (ssid_end) {
-                int ssid_len = ssid_end - ssid_start;
-                if (ssid_len < sizeof(ssid)) {
-                    strncpy(ssid, ssid_start, ssid_len);
-                    ssid[ssid_len] = '\0';
-                }
-            }
+    if (parse_form_body(req, &parser) != ESP_OK) {
+        return ESP_OK;
+    }
+    
+    if (fields[0].seen && ssid[0] != '\0') {
+        // Added to the saved networks (or its password updated) and tried first
+        esp_err_t err = wifi_networks_add(ssid, pass);
+        memset(pass, 0, sizeof(pass));
+        if (err == ESP_OK) {
+            ESP_LOGI(TAG, "WiFi credentials saved: %s", ssid);
             
-            pass_start += 5;
-            char *pass_end = strchr(pass_start, '&');
-            int pass_len = pass_end ? (pass_end - pass_start) : strlen(pass_start);
-            if (pass_len < sizeof(pass)) {
-                strncpy(pass, pass_start, pass_len);
-                pass[pass_len] = '\0';
-            }
+            httpd_resp_send(req, success_page, strlen(success_page));
             
-            // Save to NVS
-            nvs_handle_t nvs_handle;
-            if (nvs_open(WIFI_NAMESPACE, NVS_READWRITE, &nvs_handle) == ESP_OK) {
-                nvs_set_str(nvs_handle, WIFI_SSID_KEY, ssid);
-                nvs_set_str(nvs_handle, WIFI_PASS_KEY, pass);
-                nvs_commit(nvs_handle);
-                nvs_close(nvs_handle);
-                
-                ESP_LOGI(TAG, "WiFi credentials saved: %s", ssid);
-                
-                httpd_resp_send(req, success_page, strlen(success_page));
-                
-                // Restart after a short delay
-                vTaskDelay(pdMS_TO_TICKS(2000));
-                esp_restart();
-                
-                return ESP_OK;
-            }
+            // Restart after a short delay
+            vTaskDelay(pdMS_TO_TICKS(2000));
+            esp_restart();
+            
+            return ESP_OK;
         }
     }
     
@@ -427,92 +234,48 @@ static esp_err_t save_post_handler(httpd_req_t *req) {
 
 // HTTP POST handler for saving LibreLink credentials
 static esp_err_t libre_save_post_handler(httpd_req_t *req) {
-    char buf[512];
     char email[128] = {0};
     char password[128] = {0};
     char patient_id[64] = {0};
     bool use_eu_server = false;
-    int ret, remaining = req->content_len;
+    form_field_t fields[] = {
+        { .key = "email", .type = FORM_FIELD_STRING, .target = email, .size = sizeof(email) },
+        { .key = "password", .type = FORM_FIELD_STRING, .target = password, .size = sizeof(password) },
+        { .key = "patient_id", .type = FORM_FIELD_STRING, .target = patient_id, .size = sizeof(patient_id) },
+        { .key = "server", .type = FORM_FIELD_BOOL, .target = &use_eu_server },
+    };
+    form_parser_t parser;
+    form_parser_init(&parser, fields, sizeof(fields) / sizeof(fields[0]), NULL, NULL);
     
-    if (remaining < sizeof(buf)) {
-        ret = httpd_req_recv(req, buf, remaining);
-        if (ret <= 0) {
-            return ESP_FAIL;
+    if (parse_form_body(req, &parser) != ESP_OK) {
+        return ESP_OK;
+    }
+    
+    if (fields[0].seen && fields[1].seen) {
+        // Validate patient ID is provided
+        if (strlen(patient_id) == 0) {
+            const char* error_page = "<html><body><h1>Error</h1><p>Please select a patient before saving.</p><button onclick='history.back()'>Go Back</button></body></html>";
+            httpd_resp_send(req, error_page, strlen(error_page));
+            return ESP_OK;
         }
-        buf[ret] = '\0';
         
-        // Parse form data
-        char *email_start = strstr(buf, "email=");
-        char *pass_start = strstr(buf, "password=");
-        char *patient_start = strstr(buf, "patient_id=");
-        char *server_start = strstr(buf, "server=");
+        // Save credentials
+        esp_err_t err = libre_credentials_save(email, password, patient_id, use_eu_server);
         
-        if (email_start && pass_start) {
-            // Parse email
-            email_start += 6;
-            char *email_end = strchr(email_start, '&');
-            if (email_end) {
-                int len = email_end - email_start;
-                if (len < sizeof(email)) {
-                    strncpy(email, email_start, len);
-                    email[len] = '\0';
-                }
-            }
-            
-            // Parse password
-            pass_start += 9;
-            char *pass_end = strchr(pass_start, '&');
-            if (pass_end) {
-                int len = pass_end - pass_start;
-                if (len < sizeof(password)) {
-                    strncpy(password, pass_start, len);
-                    password[len] = '\0';
-                }
-            } else {
-                strncpy(password, pass_start, sizeof(password) - 1);
-            }
-            
-            // Parse patient ID (optional)
-            if (patient_start) {
-                patient_start += 11;
-                char *patient_end = strchr(patient_start, '&');
-                int len = patient_end ? (patient_end - patient_start) : strlen(patient_start);
-                if (len > 0 && len < sizeof(patient_id)) {
-                    strncpy(patient_id, patient_start, len);
-                    patient_id[len] = '\0';
-                }
-            }
-            
-            // Parse server selection
-            if (server_start) {
-                use_eu_server = (*(server_start + 7) == '1');
-            }
-            
-            // Validate patient ID is provided
-            if (strlen(patient_id) == 0) {
-                const char* error_page = "<html><body><h1>Error</h1><p>Please select a patient before saving.</p><button onclick='history.back()'>Go Back</button></body></html>";
-                httpd_resp_send(req, error_page, strlen(error_page));
-                return ESP_OK;
-            }
+        if (err == ESP_OK) {
+            ESP_LOGI(TAG, "LibreLink credentials saved");
+            const char* success_page = 
+                "<!DOCTYPE html><html><head><meta name='viewport' content='width=device-width, initial-scale=1'>"
+                "<style>body{font-family:Arial;text-align:center;margin:50px;background:#1a1a1a;color:#fff;}h1{color:#4CAF50;}</style>"
+                "</head><body><h1>Success!</h1><p>LibreLink credentials saved successfully.</p>"
+                "<p>Device will restart and begin monitoring glucose levels.</p></body></html>";
+            httpd_resp_send(req, success_page, strlen(success_page));
             
-            // Save credentials
-            esp_err_t err = libre_credentials_save(email, password, patient_id, use_eu_server);
+            // Restart device after a short delay
+            vTaskDelay(pdMS_TO_TICKS(2000));
+            esp_restart();
             
-            if (err == ESP_OK) {
-                ESP_LOGI(TAG, "LibreLink credentials saved");
-                const char* success_page = 
-                    "<!DOCTYPE html><html><head><meta name='viewport' content='width=device-width, initial-scale=1'>"
-                    "<style>body{font-family:Arial;text-align:center;margin:50px;background:#1a1a1a;color:#fff;}h1{color:#4CAF50;}</style>"
-                    "</head><body><h1>Success!</h1><p>LibreLink credentials saved successfully.</p>"
-                    "<p>Device will restart and begin monitoring glucose levels.</p></body></html>";
-                httpd_resp_send(req, success_page, strlen(success_page));
-                
-                // Restart device after a short delay
-                vTaskDelay(pdMS_TO_TICKS(2000));
-                esp_restart();
-                
-                return ESP_OK;
-            }
+            return ESP_OK;
         }
     }
     
@@ -521,8 +284,11 @@ static esp_err_t libre_save_post_handler(httpd_req_t *req) {
     return ESP_OK;
 }
 
-// HTTP GET handler for loading LibreLink patients
-static esp_err_t libre_patients_get_handler(httpd_req_t *req) {
+/**
+ * Queue a LibreLinkUp job from ?email=&pass=&server= and answer with its id
+ * The login runs on the job worker; the page polls /libre/job?id=N.
+ */
+static esp_err_t libre_submit_job(httpd_req_t *req, libre_job_type_t type) {
     char buf[512];
     char email[128] = {0};
     char password[128] = {0};
@@ -551,183 +317,197 @@ static esp_err_t libre_patients_get_handler(httpd_req_t *req) {
         }
     }
     
+    httpd_resp_set_type(req, "application/json");
+    
     // Validate credentials
     if (strlen(email) == 0 || strlen(password) == 0) {
         ESP_LOGW(TAG, "Empty credentials received");
         const char* error_response = "{\"success\":false,\"error\":\"Email and password are required\"}";
-        httpd_resp_set_type(req, "application/json");
         httpd_resp_send(req, error_response, strlen(error_response));
         return ESP_OK;
     }
     
-    ESP_LOGI(TAG, "Attempting LibreLink login (email length: %d)", strlen(email));
-    
-    // Test connection and get connections list
-    librelinkup_init(use_eu_server);
-    esp_err_t err = librelinkup_login(email, password);
-    
-    if (err == ESP_OK) {
-        // Get connections list with patient info
-        char response[2048];
-        err = librelinkup_get_connections_json(response, sizeof(response));
-        
-        if (err == ESP_OK) {
-            httpd_resp_set_type(req, "application/json");
-            httpd_resp_send(req, response, strlen(response));
-            // Don't logout - main task uses the same session
-            return ESP_OK;
-        }
+    uint32_t job_id;
+    esp_err_t err = libre_jobs_submit(type, email, password, use_eu_server, &job_id);
+    memset(password, 0, sizeof(password));
+    if (err != ESP_OK) {
+        const char* error_response = "{\"success\":false,\"error\":\"Busy, try again in a moment\"}";
+        httpd_resp_set_status(req, "503 Service Unavailable");
+        httpd_resp_send(req, error_response, strlen(error_response));
+        return ESP_OK;
     }
     
-    // Return error
-    const char* error_response = "{\"success\":false,\"error\":\"Login failed or no patients found\"}";
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_send(req, error_response, strlen(error_response));
-    // Don't logout on error either - may interfere with main task
+    char response[64];
+    snprintf(response, sizeof(response), "{\"job\":%lu,\"state\":\"queued\"}", (unsigned long)job_id);
+    httpd_resp_set_status(req, "202 Accepted");
+    httpd_resp_send(req, response, strlen(response));
     return ESP_OK;
 }
 
+// HTTP GET handler for loading LibreLink patients (async, returns a job id)
+static esp_err_t libre_patients_get_handler(httpd_req_t *req) {
+    return libre_submit_job(req, LIBRE_JOB_PATIENTS);
+}
+
 // HTTP GET handler for testing LibreLink connection (deprecated - use /libre/patients)
 static esp_err_t libre_test_get_handler(httpd_req_t *req) {
-    char buf[512];
-    char email[128] = {0};
-    char password[128] = {0};
-    bool use_eu_server = false;
+    return libre_submit_job(req, LIBRE_JOB_TEST);
+}
+
+// HTTP GET handler for LibreLink job status (?id=N)
+// Returns {"job":N,"state":"running"} until finished, then adds "result"
+static esp_err_t libre_job_get_handler(httpd_req_t *req) {
+    char query[32];
+    char param[16];
+    uint32_t job_id = 0;
+    
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+        httpd_query_key_value(query, "id", param, sizeof(param)) == ESP_OK) {
+        job_id = strtoul(param, NULL, 10);
+    }
     
-    // Parse query string
-    size_t buf_len = httpd_req_get_url_query_len(req) + 1;
-    if (buf_len > 1 && buf_len < sizeof(buf)) {
-        if (httpd_req_get_url_query_str(req, buf, buf_len) == ESP_OK) {
-            char param[128];
-            
-            // Get email
-            if (httpd_query_key_value(buf, "email", param, sizeof(param)) == ESP_OK) {
-                strncpy(email, param, sizeof(email) - 1);
-            }
-            
-            // Get password
-            if (httpd_query_key_value(buf, "pass", param, sizeof(param)) == ESP_OK) {
-                strncpy(password, param, sizeof(password) - 1);
-            }
-            
-            // Get server
-            if (httpd_query_key_value(buf, "server", param, sizeof(param)) == ESP_OK) {
-                use_eu_server = (param[0] == '1');
-            }
-        }
+    char *result = malloc(LIBRE_JOB_RESULT_SIZE);
+    if (!result) {
+        httpd_resp_send_500(req);
+        return ESP_FAIL;
     }
+    libre_job_state_t state = libre_jobs_get(job_id, result, LIBRE_JOB_RESULT_SIZE);
     
-    // Test connection
-    librelinkup_init(use_eu_server);
-    esp_err_t err = librelinkup_login(email, password);
+    char head[64];
+    snprintf(head, sizeof(head), "{\"job\":%lu,\"state\":\"%s\"", (unsigned long)job_id, libre_job_state_name(state));
     
-    if (err == ESP_OK) {
-        // Get patient ID
-        char patient_id[64];
-        err = librelinkup_get_patient_id(patient_id, sizeof(patient_id));
-        
-        if (err == ESP_OK) {
-            // Return success with patient ID
-            char response[512];
-            snprintf(response, sizeof(response), 
-                     "{\"success\":true,\"patients\":[{\"id\":\"%s\",\"name\":\"Patient 1\"}]}",
-                     patient_id);
-            httpd_resp_set_type(req, "application/json");
-            httpd_resp_send(req, response, strlen(response));
-            // Don't logout - main task uses the same session
-            return ESP_OK;
-        }
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    if (state == LIBRE_JOB_UNKNOWN) {
+        httpd_resp_set_status(req, HTTPD_404);
     }
+    httpd_resp_send_chunk(req, head, HTTPD_RESP_USE_STRLEN);
+    if (state == LIBRE_JOB_DONE || state == LIBRE_JOB_FAILED) {
+        httpd_resp_send_chunk(req, ",\"result\":", HTTPD_RESP_USE_STRLEN);
+        httpd_resp_send_chunk(req, result, HTTPD_RESP_USE_STRLEN);
+    }
+    httpd_resp_send_chunk(req, "}", 1);
+    httpd_resp_send_chunk(req, NULL, 0);
     
-    // Return error
-    const char* error_response = "{\"success\":false,\"error\":\"Login failed\"}";
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_send(req, error_response, strlen(error_response));
-    // Don't logout on error either
+    free(result);
     return ESP_OK;
 }
 
-// HTTP GET handler for WiFi scan
+/**
+ * Escape a string for use inside a JSON string literal
+ * Non-ASCII bytes are passed through; SSIDs are arbitrary bytes so
+ * control characters are written as \u00XX.
+ * @return Length written (always NUL terminated), output is cut short if dst is too small
+ */
+static size_t json_escape(char *dst, size_t dst_size, const char *src) {
+    size_t j = 0;
+    if (dst_size == 0) return 0;
+    
+    for (const unsigned char *p = (const unsigned char *)src; *p; p++) {
+        char esc[7];
+        size_t len;
+        if (*p == '"' || *p == '\\') {
+            esc[0] = '\\';
+            esc[1] = (char)*p;
+            len = 2;
+        } else if (*p < 0x20) {
+            len = snprintf(esc, sizeof(esc), "\\u%04x", *p);
+        } else {
+            esc[0] = (char)*p;
+            len = 1;
+        }
+        if (j + len >= dst_size) break;
+        memcpy(dst + j, esc, len);
+        j += len;
+    }
+    dst[j] = '\0';
+    return j;
+}
+
+// HTTP GET handler for WiFi scan - answered from the background scan cache,
+// with the saved networks so the page can mark and forget them
 static esp_err_t scan_get_handler(httpd_req_t *req) {
-    ESP_LOGI(TAG, "WiFi scan requested");
+    wifi_scan_ap_t aps[WIFI_SCAN_MAX_RESULTS];
+    int64_t age_ms;
+    bool scanning;
+    
+    // Refreshes the cache in the background if it is stale
+    wifi_scan_touch();
+    size_t count = wifi_scan_get_results(aps, WIFI_SCAN_MAX_RESULTS, &age_ms, &scanning);
+    
+    wifi_network_t saved[WIFI_NETWORKS_MAX];
+    size_t saved_count = wifi_networks_load(saved);
+    for (size_t i = 0; i < saved_count; i++) {
+        memset(saved[i].password, 0, sizeof(saved[i].password));
+    }
     
-    // Ensure WiFi is in correct mode for scanning
-    wifi_mode_t mode;
-    esp_wifi_get_mode(&mode);
-    if (mode != WIFI_MODE_APSTA && mode != WIFI_MODE_STA) {
-        ESP_LOGE(TAG, "WiFi not in scanning mode: %d", mode);
-        httpd_resp_set_type(req, "application/json");
-        httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
-        httpd_resp_send(req, "[]", 2);
-        return ESP_OK;
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    
+    // One chunk per network keeps the buffer small (worst case SSID is 32 * 6 escaped bytes)
+    char chunk[256];
+    snprintf(chunk, sizeof(chunk), "{\"scanning\":%s,\"age\":%lld,\"networks\":[",
+             scanning ? "true" : "false", age_ms < 0 ? -1LL : (long long)(age_ms / 1000));
+    httpd_resp_send_chunk(req, chunk, HTTPD_RESP_USE_STRLEN);
+    
+    for (size_t i = 0; i < count; i++) {
+        char ssid[200];
+        json_escape(ssid, sizeof(ssid), aps[i].ssid);
+        snprintf(chunk, sizeof(chunk), "%s{\"ssid\":\"%s\",\"rssi\":%d,\"secure\":%s,\"saved\":%s}",
+                 i > 0 ? "," : "", ssid, aps[i].rssi,
+                 aps[i].authmode != WIFI_AUTH_OPEN ? "true" : "false",
+                 wifi_networks_find(saved, saved_count, aps[i].ssid) >= 0 ? "true" : "false");
+        httpd_resp_send_chunk(req, chunk, HTTPD_RESP_USE_STRLEN);
     }
     
-    // Start scan
-    wifi_scan_config_t scan_config = {
-        .show_hidden = false,
-        .scan_type = WIFI_SCAN_TYPE_ACTIVE,
-        .scan_time.active.min = 100,
-        .scan_time.active.max = 300
-    };
+    httpd_resp_send_chunk(req, "],\"saved\":[", HTTPD_RESP_USE_STRLEN);
+    for (size_t i = 0; i < saved_count; i++) {
+        char ssid[200];
+        json_escape(ssid, sizeof(ssid), saved[i].ssid);
+        snprintf(chunk, sizeof(chunk), "%s{\"ssid\":\"%s\",\"current\":%s}", i > 0 ? "," : "", ssid,
+                 wifi_connected && strcmp(saved[i].ssid, current_ssid) == 0 ? "true" : "false");
+        httpd_resp_send_chunk(req, chunk, HTTPD_RESP_USE_STRLEN);
+    }
     
-    esp_err_t err = esp_wifi_scan_start(&scan_config, true);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "WiFi scan failed: %s (0x%x)", esp_err_to_name(err), err);
-        httpd_resp_send(req, "[]", 2);
+    httpd_resp_send_chunk(req, "]}", 2);
+    httpd_resp_send_chunk(req, NULL, 0);
+    
+    ESP_LOGD(TAG, "Sent %d cached networks (age %lld ms)", count, age_ms);
+    return ESP_OK;
+}
+
+// HTTP POST handler for forgetting a saved network (ssid=<name>)
+static esp_err_t forget_post_handler(httpd_req_t *req) {
+    char ssid[33] = {0};
+    form_field_t fields[] = {
+        { .key = "ssid", .type = FORM_FIELD_STRING, .target = ssid, .size = sizeof(ssid) },
+    };
+    form_parser_t parser;
+    form_parser_init(&parser, fields, sizeof(fields) / sizeof(fields[0]), NULL, NULL);
+    if (parse_form_body(req, &parser) != ESP_OK) {
         return ESP_OK;
     }
     
-    uint16_t ap_count = 0;
-    esp_wifi_scan_get_ap_num(&ap_count);
-    ESP_LOGI(TAG, "Found %d access points", ap_count);
+    // The connection in use is kept; the network just isn't tried again
+    esp_err_t err = fields[0].seen ? wifi_networks_forget(ssid) : ESP_ERR_INVALID_ARG;
     
-    if (ap_count > 0) {
-        wifi_ap_record_t *ap_list = (wifi_ap_record_t *)malloc(sizeof(wifi_ap_record_t) * ap_count);
-        if (ap_list == NULL) {
-            httpd_resp_send(req, "[]", 2);
-            return ESP_OK;
-        }
-        
-        esp_wifi_scan_get_ap_records(&ap_count, ap_list);
-        
-        // Build JSON response
-        char *json = (char *)malloc(4096);
-        if (json == NULL) {
-            free(ap_list);
-            httpd_resp_send(req, "[]", 2);
-            return ESP_OK;
-        }
-        
-        int offset = 0;
-        offset += snprintf(json + offset, 4096 - offset, "[");
-        
-        for (int i = 0; i < ap_count && i < 30 && offset < 3900; i++) {
-            if (i > 0) offset += snprintf(json + offset, 4096 - offset, ",");
-            // Escape quotes in SSID
-            offset += snprintf(json + offset, 4096 - offset, "\"%s\"", (char*)ap_list[i].ssid);
-        }
-        offset += snprintf(json + offset, 4096 - offset, "]");
-        
-        httpd_resp_set_type(req, "application/json");
-        httpd_resp_set_hdr(req, "Access-Control-Allow-Origin", "*");
-        httpd_resp_send(req, json, strlen(json));
-        
-        ESP_LOGI(TAG, "Sent scan results: %d networks", ap_count);
-        
-        free(json);
-        free(ap_list);
+    httpd_resp_set_type(req, "application/json");
+    if (err == ESP_OK) {
+        const char *success_response = "{\"success\":true}";
+        httpd_resp_send(req, success_response, strlen(success_response));
     } else {
-        httpd_resp_set_type(req, "application/json");
-        httpd_resp_send(req, "[]", 2);
+        char error_response[96];
+        snprintf(error_response, sizeof(error_response), "{\"success\":false,\"error\":\"%s\"}",
+                 err == ESP_ERR_NOT_FOUND ? "Network not saved" : esp_err_to_name(err));
+        httpd_resp_send(req, error_response, strlen(error_response));
     }
-    
     return ESP_OK;
 }
 
 // HTTP GET handler for settings page
 static esp_err_t settings_get_handler(httpd_req_t *req) {
-    httpd_resp_send(req, html_settings, strlen(html_settings));
-    return ESP_OK;
+    return web_assets_send(req, "settings.html", true);
 }
 
 // HTTP GET handler for loading settings
@@ -735,18 +515,29 @@ static esp_err_t settings_load_get_handler(httpd_req_t *req) {
     global_settings_t settings;
     esp_err_t err = global_settings_load(&settings);
     
-    char response[512];
-    if (err == ESP_OK) {
-        snprintf(response, sizeof(response), 
-                 "{\"success\":true,\"interval\":%lu,\"moon_lamp\":%s,\"glucose_low\":%.1f,\"glucose_high\":%.1f,\"alarm_enabled\":%s,\"alarm_snooze\":%lu,\"alarm_low_enabled\":%s,\"alarm_high_enabled\":%s}",
-                 settings.librelink_interval_minutes,
-                 settings.moon_lamp_enabled ? "true" : "false",
-                 settings.glucose_low_threshold,
-                 settings.glucose_high_threshold,
-                 settings.alarm_enabled ? "true" : "false",
-                 settings.alarm_snooze_minutes,
-                 settings.alarm_low_enabled ? "true" : "false",
-                 settings.alarm_high_enabled ? "true" : "false");
+    char ns_url[NIGHTSCOUT_URL_MAX_LEN + 1];
+    bool ns_enabled = nightscout_get_config(ns_url, sizeof(ns_url));
+    char mqtt_uri[MQTT_PUBLISHER_URI_MAX_LEN + 1];
+    char mqtt_user[MQTT_PUBLISHER_USER_MAX_LEN + 1];
+    mqtt_publisher_get_config(mqtt_uri, sizeof(mqtt_uri), mqtt_user, sizeof(mqtt_user));
+    
+    // Escaped for the JSON string (quotes and backslashes double in size)
+    char ns_url_json[2 * NIGHTSCOUT_URL_MAX_LEN + 1];
+    char mqtt_uri_json[2 * MQTT_PUBLISHER_URI_MAX_LEN + 1];
+    char mqtt_user_json[2 * MQTT_PUBLISHER_USER_MAX_LEN + 1];
+    json_escape(ns_url_json, sizeof(ns_url_json), ns_url);
+    json_escape(mqtt_uri_json, sizeof(mqtt_uri_json), mqtt_uri);
+    json_escape(mqtt_user_json, sizeof(mqtt_user_json), mqtt_user);
+    
+    char response[1280];
+    char fields[448];
+    if (err == ESP_OK && global_settings_to_json(&settings, fields, sizeof(fields)) >= 0) {
+        // Secrets are write-only; only whether one is set is reported
+        snprintf(response, sizeof(response),
+                 "{\"success\":true,%s,\"ns_url\":\"%s\",\"ns_enabled\":%s,\"mqtt_uri\":\"%s\",\"mqtt_user\":\"%s\","
+                 "\"lan_key_set\":%s,\"first_reading_ms\":%lu,\"wifi_connect_ms\":%lu}",
+                 fields, ns_url_json, ns_enabled ? "true" : "false", mqtt_uri_json, mqtt_user_json,
+                 lan_share_has_key() ? "true" : "false", first_reading_ms, connect_time_ms);
     } else {
         snprintf(response, sizeof(response), 
                  "{\"success\":false,\"error\":\"Failed to load settings\"}");
@@ -757,141 +548,57 @@ static esp_err_t settings_load_get_handler(httpd_req_t *req) {
     return ESP_OK;
 }
 
+// Form callback for /settings/save (field names come from the settings schema)
+static form_status_t settings_form_value(void *ctx, const char *key, const char *value) {
+    global_settings_form_field((global_settings_t *)ctx, key, value);
+    return FORM_OK;  // Unknown keys are ignored
+}
+
 // HTTP POST handler for saving settings
 static esp_err_t settings_save_post_handler(httpd_req_t *req) {
-    char buf[256];
-    int ret, remaining = req->content_len;
-    
-    if (remaining >= sizeof(buf)) {
-        const char* error_page = "<html><body><h1>Request too large</h1></body></html>";
-        httpd_resp_send(req, error_page, strlen(error_page));
-        return ESP_OK;
-    }
-    
-    ret = httpd_req_recv(req, buf, remaining);
-    if (ret <= 0) {
-        return ESP_FAIL;
-    }
-    buf[ret] = '\0';
-    
     global_settings_t settings;
-    settings.librelink_interval_minutes = DEFAULT_LIBRELINK_INTERVAL_MINUTES;
-    settings.moon_lamp_enabled = false;  // Default to off unless checked
-    settings.glucose_low_threshold = DEFAULT_GLUCOSE_LOW_THRESHOLD;
-    settings.glucose_high_threshold = DEFAULT_GLUCOSE_HIGH_THRESHOLD;
-    settings.alarm_enabled = false;  // Default to off unless checked
-    settings.alarm_snooze_minutes = DEFAULT_ALARM_SNOOZE_MINUTES;
-    settings.alarm_low_enabled = false;  // Default to off unless checked
-    settings.alarm_high_enabled = false;  // Default to off unless checked
-    
-    // Parse interval
-    char *interval_start = strstr(buf, "interval=");
-    if (interval_start) {
-        interval_start += 9;
-        char *interval_end = strchr(interval_start, '&');
-        if (!interval_end) {
-            interval_end = interval_start + strlen(interval_start);
-        }
-        
-        char interval_str[16] = {0};
-        int len = interval_end - interval_start;
-        if (len < sizeof(interval_str)) {
-            strncpy(interval_str, interval_start, len);
-            settings.librelink_interval_minutes = atoi(interval_str);
-            if (settings.librelink_interval_minutes < 1) {
-                settings.librelink_interval_minutes = 1;
-            }
-        }
-    }
-    
-    // Parse moon lamp checkbox (only present if checked)
-    if (strstr(buf, "moon_lamp=1")) {
-        settings.moon_lamp_enabled = true;
-    }
-    
-    // Parse alarm enabled checkbox (only present if checked)
-    if (strstr(buf, "alarm_enabled=1")) {
-        settings.alarm_enabled = true;
-    }
-    
-    // Parse alarm low enabled checkbox (only present if checked)
-    if (strstr(buf, "alarm_low_enabled=1")) {
-        settings.alarm_low_enabled = true;
+    global_settings_form_begin(&settings);
+    
+    // Nightscout, MQTT and LAN key fields are stored separately; everything else is the settings schema
+    char ns_url[NIGHTSCOUT_URL_MAX_LEN + 1] = {0};
+    char ns_secret[NIGHTSCOUT_SECRET_MAX_LEN + 1] = {0};
+    char mqtt_uri[MQTT_PUBLISHER_URI_MAX_LEN + 1] = {0};
+    char mqtt_user[MQTT_PUBLISHER_USER_MAX_LEN + 1] = {0};
+    char mqtt_pass[MQTT_PUBLISHER_PASS_MAX_LEN + 1] = {0};
+    char lan_key[LAN_SHARE_PASSPHRASE_MAX_LEN + 1] = {0};
+    form_field_t fields[] = {
+        { .key = "ns_url", .type = FORM_FIELD_STRING, .target = ns_url, .size = sizeof(ns_url) },
+        { .key = "ns_secret", .type = FORM_FIELD_STRING, .target = ns_secret, .size = sizeof(ns_secret) },
+        { .key = "mqtt_uri", .type = FORM_FIELD_STRING, .target = mqtt_uri, .size = sizeof(mqtt_uri) },
+        { .key = "mqtt_user", .type = FORM_FIELD_STRING, .target = mqtt_user, .size = sizeof(mqtt_user) },
+        { .key = "mqtt_pass", .type = FORM_FIELD_STRING, .target = mqtt_pass, .size = sizeof(mqtt_pass) },
+        { .key = "lan_key", .type = FORM_FIELD_STRING, .target = lan_key, .size = sizeof(lan_key) },
+    };
+    form_parser_t parser;
+    form_parser_init(&parser, fields, sizeof(fields) / sizeof(fields[0]), settings_form_value, &settings);
+    if (parse_form_body(req, &parser) != ESP_OK) {
+        return ESP_OK;
     }
     
-    // Parse alarm high enabled checkbox (only present if checked)
-    if (strstr(buf, "alarm_high_enabled=1")) {
-        settings.alarm_high_enabled = true;
+    // Save settings
+    esp_err_t err = global_settings_save(&settings);
+    if (err == ESP_OK) {
+        global_settings_apply_timezone();
     }
-    
-    // Parse glucose_low threshold
-    char *low_start = strstr(buf, "glucose_low=");
-    if (low_start) {
-        low_start += 12;
-        char *low_end = strchr(low_start, '&');
-        if (!low_end) {
-            low_end = low_start + strlen(low_start);
-        }
-        char low_str[16] = {0};
-        int len = low_end - low_start;
-        if (len < sizeof(low_str)) {
-            strncpy(low_str, low_start, len);
-            settings.glucose_low_threshold = atof(low_str);
-            if (settings.glucose_low_threshold < 1.0f) {
-                settings.glucose_low_threshold = DEFAULT_GLUCOSE_LOW_THRESHOLD;
-            }
-        }
+    if (err == ESP_OK && fields[0].seen) {
+        err = nightscout_config_save(ns_url, ns_secret);
     }
-    
-    // Parse glucose_high threshold
-    char *high_start = strstr(buf, "glucose_high=");
-    if (high_start) {
-        high_start += 13;
-        char *high_end = strchr(high_start, '&');
-        if (!high_end) {
-            high_end = high_start + strlen(high_start);
-        }
-        char high_str[16] = {0};
-        int len = high_end - high_start;
-        if (len < sizeof(high_str)) {
-            strncpy(high_str, high_start, len);
-            settings.glucose_high_threshold = atof(high_str);
-            if (settings.glucose_high_threshold < 5.0f) {
-                settings.glucose_high_threshold = DEFAULT_GLUCOSE_HIGH_THRESHOLD;
-            }
-        }
+    if (err == ESP_OK && fields[2].seen) {
+        err = mqtt_publisher_config_save(mqtt_uri, mqtt_user, mqtt_pass);
     }
-    
-    // Parse alarm_snooze duration
-    char *snooze_start = strstr(buf, "alarm_snooze=");
-    if (snooze_start) {
-        snooze_start += 13;
-        char *snooze_end = strchr(snooze_start, '&');
-        if (!snooze_end) {
-            snooze_end = snooze_start + strlen(snooze_start);
-        }
-        char snooze_str[16] = {0};
-        int len = snooze_end - snooze_start;
-        if (len < sizeof(snooze_str)) {
-            strncpy(snooze_str, snooze_start, len);
-            settings.alarm_snooze_minutes = atoi(snooze_str);
-            if (settings.alarm_snooze_minutes < 1 || settings.alarm_snooze_minutes > 60) {
-                settings.alarm_snooze_minutes = DEFAULT_ALARM_SNOOZE_MINUTES;
-            }
-        }
+    if (err == ESP_OK && lan_key[0] != '\0') {
+        err = lan_share_set_key(lan_key);  // Empty keeps the current key
     }
-    
-    // Save settings
-    esp_err_t err = global_settings_save(&settings);
+    memset(ns_secret, 0, sizeof(ns_secret));
+    memset(mqtt_pass, 0, sizeof(mqtt_pass));
+    memset(lan_key, 0, sizeof(lan_key));
     
     if (err == ESP_OK) {
-        ESP_LOGI(TAG, "Global settings saved: interval=%lu min, moon_lamp=%s, low=%.1f, high=%.1f, alarm=%s, snooze=%lu min", 
-                 settings.librelink_interval_minutes,
-                 settings.moon_lamp_enabled ? "enabled" : "disabled",
-                 settings.glucose_low_threshold,
-                 settings.glucose_high_threshold,
-                 settings.alarm_enabled ? "enabled" : "disabled",
-                 settings.alarm_snooze_minutes);
         const char* settings_success_page = 
             "<!DOCTYPE html><html><head><meta name='viewport' content='width=device-width, initial-scale=1'>"
             "<style>body{font-family:Arial;text-align:center;margin:50px;background:#1a1a1a;color:#fff;}h1{color:#4CAF50;}</style>"
@@ -908,50 +615,22 @@ static esp_err_t settings_save_post_handler(httpd_req_t *req) {
 
 // IR send command handler
 static esp_err_t ir_send_post_handler(httpd_req_t *req) {
-    char buf[128];
-    int ret = httpd_req_recv(req, buf, sizeof(buf) - 1);
-    
-    if (ret <= 0) {
-        const char* error_response = "{\"success\":false,\"error\":\"Failed to receive data\"}";
-        httpd_resp_set_type(req, "application/json");
-        httpd_resp_send(req, error_response, strlen(error_response));
+    // Hex values (format: address=FF00&command=40)
+    char addr_hex[5] = {0};
+    char cmd_hex[3] = {0};
+    form_field_t fields[] = {
+        { .key = "address", .type = FORM_FIELD_STRING, .target = addr_hex, .size = sizeof(addr_hex) },
+        { .key = "command", .type = FORM_FIELD_STRING, .target = cmd_hex, .size = sizeof(cmd_hex) },
+    };
+    form_parser_t parser;
+    form_parser_init(&parser, fields, sizeof(fields) / sizeof(fields[0]), NULL, NULL);
+    if (parse_form_body(req, &parser) != ESP_OK) {
         return ESP_OK;
     }
     
-    buf[ret] = '\0';
-    ESP_LOGI(TAG, "IR command request: %s", buf);
-    
-    // Parse address and command from POST data
-    uint16_t address = IR_REMOTE_ADDRESS;  // Default
-    uint8_t command = 0;
-    bool got_command = false;
-    
-    // Parse address (format: address=FF00)
-    char *addr_str = strstr(buf, "address=");
-    if (addr_str) {
-        addr_str += 8;  // Skip "address="
-        char addr_hex[5] = {0};
-        int i = 0;
-        while (addr_str[i] && addr_str[i] != '&' && i < 4) {
-            addr_hex[i] = addr_str[i];
-            i++;
-        }
-        address = (uint16_t)strtol(addr_hex, NULL, 16);
-    }
-    
-    // Parse command (format: command=40)
-    char *cmd_str = strstr(buf, "command=");
-    if (cmd_str) {
-        cmd_str += 8;  // Skip "command="
-        char cmd_hex[3] = {0};
-        int i = 0;
-        while (cmd_str[i] && cmd_str[i] != '&' && i < 2) {
-            cmd_hex[i] = cmd_str[i];
-            i++;
-        }
-        command = (uint8_t)strtol(cmd_hex, NULL, 16);
-        got_command = true;
-    }
+    uint16_t address = fields[0].seen ? (uint16_t)strtol(addr_hex, NULL, 16) : IR_REMOTE_ADDRESS;
+    uint8_t command = (uint8_t)strtol(cmd_hex, NULL, 16);
+    bool got_command = fields[1].seen && cmd_hex[0] != '\0';
     
     if (!got_command) {
         const char* error_response = "{\"success\":false,\"error\":\"Missing command parameter\"}";
@@ -982,6 +661,82 @@ static esp_err_t ir_send_post_handler(httpd_req_t *req) {
     return ESP_OK;
 }
 
+// IR learning control handler (slot=<name>&action=learn|forget)
+static esp_err_t ir_learn_post_handler(httpd_req_t *req) {
+    char slot_name[16] = {0};
+    char action[16] = {0};
+    form_field_t fields[] = {
+        { .key = "slot", .type = FORM_FIELD_STRING, .target = slot_name, .size = sizeof(slot_name) },
+        { .key = "action", .type = FORM_FIELD_STRING, .target = action, .size = sizeof(action) },
+    };
+    form_parser_t parser;
+    form_parser_init(&parser, fields, sizeof(fields) / sizeof(fields[0]), NULL, NULL);
+    if (parse_form_body(req, &parser) != ESP_OK) {
+        return ESP_OK;
+    }
+    httpd_resp_set_type(req, "application/json");
+    
+    ir_slot_t slot;
+    if (!fields[0].seen || !fields[1].seen || !ir_slot_from_name(slot_name, &slot)) {
+        const char* error_response = "{\"success\":false,\"error\":\"Invalid slot or action\"}";
+        httpd_resp_send(req, error_response, strlen(error_response));
+        return ESP_OK;
+    }
+    
+    esp_err_t err;
+    if (strcmp(action, "learn") == 0) {
+        err = ir_learning_start(slot);
+    } else if (strcmp(action, "forget") == 0) {
+        err = ir_learning_clear(slot);
+    } else {
+        err = ESP_ERR_INVALID_ARG;
+    }
+    
+    if (err == ESP_OK) {
+        const char* success_response = "{\"success\":true}";
+        httpd_resp_send(req, success_response, strlen(success_response));
+    } else {
+        char error_response[128];
+        snprintf(error_response, sizeof(error_response),
+                 "{\"success\":false,\"error\":\"%s\"}",
+                 err == ESP_ERR_INVALID_STATE ? "IR learning not available (enable Moon Lamp and restart)" : esp_err_to_name(err));
+        httpd_resp_send(req, error_response, strlen(error_response));
+    }
+    return ESP_OK;
+}
+
+// IR learning status handler
+static esp_err_t ir_learn_get_handler(httpd_req_t *req) {
+    ir_slot_t slot;
+    ir_learn_state_t state = ir_learning_get_state(&slot);
+    
+    char response[512];
+    int len = snprintf(response, sizeof(response), "{\"state\":\"%s\",\"slot\":\"%s\",\"codes\":{",
+                       ir_learn_state_name(state), ir_slot_name(slot));
+    
+    for (int i = 0; i < IR_SLOT_COUNT && len < (int)sizeof(response); i++) {
+        ir_code_t code;
+        const char *sep = i ? "," : "";
+        if (!ir_learning_get_code((ir_slot_t)i, &code)) {
+            len += snprintf(response + len, sizeof(response) - len, "%s\"%s\":null", sep, ir_slot_name(i));
+        } else if (code.raw) {
+            len += snprintf(response + len, sizeof(response) - len, "%s\"%s\":{\"raw\":true,\"symbols\":%d}",
+                            sep, ir_slot_name(i), code.raw_count);
+        } else {
+            len += snprintf(response + len, sizeof(response) - len,
+                            "%s\"%s\":{\"protocol\":\"%s\",\"address\":%u,\"command\":%u}",
+                            sep, ir_slot_name(i), ir_protocol_name(code.protocol), code.address, code.command);
+        }
+    }
+    if (len < (int)sizeof(response)) {
+        snprintf(response + len, sizeof(response) - len, "}}");
+    }
+    
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_send(req, response, strlen(response));
+    return ESP_OK;
+}
+
 // OTA check handler
 static esp_err_t ota_check_handler(httpd_req_t *req) {
     char new_version[32] = {0};
@@ -1045,22 +800,20 @@ static void ota_update_task(void *pvParameters) {
 // Captive portal redirect handler - serve portal page directly
 static esp_err_t redirect_handler(httpd_req_t *req) {
     // Apple devices need specific headers to trigger captive portal
-    httpd_resp_set_type(req, "text/html");
     httpd_resp_set_status(req, "200 OK");
-    httpd_resp_set_hdr(req, "Cache-Control", "no-cache, no-store, must-revalidate");
-    httpd_resp_set_hdr(req, "Pragma", "no-cache");
-    httpd_resp_set_hdr(req, "Expires", "0");
-    httpd_resp_send(req, html_main, strlen(html_main));
-    return ESP_OK;
+    return web_assets_send(req, "main.html", false);
 }
 
 // Start HTTP server for provisioning
 static void start_webserver(void) {
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
     config.server_port = 80;
-    config.max_uri_handlers = 28;  // Increased for comprehensive captive portal coverage + new pages
+    config.max_uri_handlers = 40;  // Increased for comprehensive captive portal coverage + new pages
     config.stack_size = 8192;  // Increase stack size for HTTP handlers that make outbound requests
     
+    // LibreLinkUp logins from the portal run as jobs off the httpd task
+    libre_jobs_init();
+    
     if (httpd_start(&server, &config) == ESP_OK) {
         // Main portal page
         httpd_uri_t root = {
@@ -1119,6 +872,13 @@ static void start_webserver(void) {
         };
         httpd_register_uri_handler(server, &scan);
         
+        httpd_uri_t forget = {
+            .uri = "/wifi/forget",
+            .method = HTTP_POST,
+            .handler = forget_post_handler
+        };
+        httpd_register_uri_handler(server, &forget);
+        
         // LibreLink endpoints
         httpd_uri_t libre_save = {
             .uri = "/libre/save",
@@ -1141,6 +901,13 @@ static void start_webserver(void) {
         };
         httpd_register_uri_handler(server, &libre_test);
         
+        httpd_uri_t libre_job = {
+            .uri = "/libre/job",
+            .method = HTTP_GET,
+            .handler = libre_job_get_handler
+        };
+        httpd_register_uri_handler(server, &libre_job);
+        
         // Global Settings endpoints
         httpd_uri_t settings_page = {
             .uri = "/settings",
@@ -1170,6 +937,20 @@ static void start_webserver(void) {
         };
         httpd_register_uri_handler(server, &ir_send);
         
+        httpd_uri_t ir_learn = {
+            .uri = "/ir/learn",
+            .method = HTTP_POST,
+            .handler = ir_learn_post_handler
+        };
+        httpd_register_uri_handler(server, &ir_learn);
+        
+        httpd_uri_t ir_learn_status = {
+            .uri = "/ir/learn",
+            .method = HTTP_GET,
+            .handler = ir_learn_get_handler
+        };
+        httpd_register_uri_handler(server, &ir_learn_status);
+        
         // Captive portal detection URLs - serve portal page directly
         // Android
         httpd_uri_t generate_204 = {.uri = "/generate_204", .method = HTTP_GET, .handler = redirect_handler};
@@ -1216,6 +997,10 @@ static void start_webserver(void) {
         httpd_register_uri_handler(server, &cloudflare2);
         httpd_register_uri_handler(server, &cloudflare3);
         
+        // Live readings and REST API for LAN clients
+        glucose_events_register(server);
+        glucose_api_register(server);
+        
         ESP_LOGI(TAG, "Web server started with captive portal on port 80");
     }
 }
@@ -1223,32 +1008,276 @@ static void start_webserver(void) {
 // Polling timer for IP check (workaround for missing IP event)
 static esp_timer_handle_t ip_poll_timer = NULL;
 
+/**
+ * Load the fast-connect info saved for this SSID
+ */
+static bool fast_cache_load(const char *ssid) {
+    nvs_handle_t nvs_handle;
+    if (nvs_open(WIFI_NAMESPACE, NVS_READONLY, &nvs_handle) != ESP_OK) {
+        return false;
+    }
+    size_t len = sizeof(fast_cache);
+    esp_err_t err = nvs_get_blob(nvs_handle, WIFI_FAST_KEY, &fast_cache, &len);
+    nvs_close(nvs_handle);
+    
+    bool valid = err == ESP_OK && len == sizeof(fast_cache) && fast_cache.version == WIFI_FAST_VERSION &&
+                 strcmp(fast_cache.ssid, ssid) == 0 && fast_cache.channel > 0;
+    if (!valid) {
+        memset(&fast_cache, 0, sizeof(fast_cache));
+    }
+    return valid;
+}
+
+/**
+ * Remember the AP and lease just connected with (NVS is only written when
+ * something changed)
+ */
+static void fast_cache_update(const esp_netif_ip_info_t *ip_info) {
+    wifi_ap_record_t ap;
+    if (esp_wifi_sta_get_ap_info(&ap) != ESP_OK) {
+        return;
+    }
+    
+    wifi_fast_cache_t cache;
+    memset(&cache, 0, sizeof(cache));
+    cache.version = WIFI_FAST_VERSION;
+    snprintf(cache.ssid, sizeof(cache.ssid), "%s", current_ssid);
+    memcpy(cache.bssid, ap.bssid, sizeof(cache.bssid));
+    cache.channel = ap.primary;
+    cache.ip = ip_info->ip.addr;
+    cache.netmask = ip_info->netmask.addr;
+    cache.gw = ip_info->gw.addr;
+    esp_netif_dns_info_t dns_info;
+    if (esp_netif_get_dns_info(sta_netif, ESP_NETIF_DNS_MAIN, &dns_info) == ESP_OK) {
+        cache.dns = dns_info.ip.u_addr.ip4.addr;
+    }
+    if (memcmp(&cache, &fast_cache, sizeof(cache)) == 0) {
+        return;
+    }
+    
+    nvs_handle_t nvs_handle;
+    if (nvs_open(WIFI_NAMESPACE, NVS_READWRITE, &nvs_handle) == ESP_OK) {
+        if (nvs_set_blob(nvs_handle, WIFI_FAST_KEY, &cache, sizeof(cache)) == ESP_OK) {
+            nvs_commit(nvs_handle);
+            fast_cache = cache;
+            ESP_LOGI(TAG, "Saved fast-connect info: channel %d, BSSID " MACSTR, cache.channel, MAC2STR(cache.bssid));
+        }
+        nvs_close(nvs_handle);
+    }
+}
+
+/**
+ * Use the cached lease as a static address, so no DHCP exchange is needed
+ * (WIFI_FAST_CONNECT_STATIC_IP; only safe when the router reserves the address)
+ */
+static void apply_static_lease(void) {
+    if (!fast_cache.ip || !fast_cache.netmask) {
+        return;
+    }
+    esp_err_t err = esp_netif_dhcpc_stop(sta_netif);
+    if (err != ESP_OK && err != ESP_ERR_ESP_NETIF_DHCP_ALREADY_STOPPED) {
+        return;
+    }
+    
+    esp_netif_ip_info_t ip_info = {0};
+    ip_info.ip.addr = fast_cache.ip;
+    ip_info.netmask.addr = fast_cache.netmask;
+    ip_info.gw.addr = fast_cache.gw;
+    if (esp_netif_set_ip_info(sta_netif, &ip_info) != ESP_OK) {
+        esp_netif_dhcpc_start(sta_netif);
+        return;
+    }
+    if (fast_cache.dns) {
+        esp_netif_dns_info_t dns_info = {0};
+        dns_info.ip.u_addr.ip4.addr = fast_cache.dns;
+        dns_info.ip.type = ESP_IPADDR_TYPE_V4;
+        esp_netif_set_dns_info(sta_netif, ESP_NETIF_DNS_MAIN, &dns_info);
+    }
+    static_lease = true;
+    ESP_LOGI(TAG, "Using cached lease " IPSTR " as a static address", IP2STR(&ip_info.ip));
+}
+
+/**
+ * Stop targeting the cached AP: the next connect scans for the SSID and
+ * gets its address from DHCP
+ */
+static void fast_connect_fallback(void) {
+    fast_connect = false;
+    wifi_config_t sta_config;
+    if (esp_wifi_get_config(WIFI_IF_STA, &sta_config) == ESP_OK) {
+        sta_config.sta.bssid_set = false;
+        sta_config.sta.channel = 0;
+        esp_wifi_set_config(WIFI_IF_STA, &sta_config);
+    }
+    if (static_lease) {
+        static_lease = false;
+        esp_netif_dhcpc_start(sta_netif);
+    }
+}
+
+/**
+ * Point the station at the current candidate and connect
+ */
+static void connect_candidate(void) {
+    const wifi_candidate_t *candidate = &candidates[candidate_pos];
+    const wifi_network_t *network = &networks[candidate->index];
+    
+    wifi_config_t sta_config = {0};
+    strncpy((char*)sta_config.sta.ssid, network->ssid, sizeof(sta_config.sta.ssid));
+    strncpy((char*)sta_config.sta.password, network->password, sizeof(sta_config.sta.password));
+    sta_config.sta.threshold.authmode = WIFI_AUTH_WPA2_PSK; // Accept WPA2 or better (including WPA3)
+    // Where the scan saw it: the driver probes that channel first
+    sta_config.sta.channel = candidate->seen ? candidate->channel : 0;
+    sta_config.sta.listen_interval = POWER_WIFI_LISTEN_INTERVAL;
+    snprintf(current_ssid, sizeof(current_ssid), "%s", network->ssid);
+    network_attempts = 0;
+    
+    if (candidate->seen) {
+        ESP_LOGI(TAG, "Connecting to %s (%d dBm, channel %d), network %d of %d", network->ssid,
+                 candidate->rssi, candidate->channel, candidate_pos + 1, candidate_count);
+    } else {
+        ESP_LOGI(TAG, "Connecting to %s (not in scan), network %d of %d", network->ssid,
+                 candidate_pos + 1, candidate_count);
+    }
+    esp_wifi_set_config(WIFI_IF_STA, &sta_config);
+    esp_wifi_connect();
+}
+
+/**
+ * Rank the saved networks against the scan cache and try the best one
+ */
+static void select_from_scan(void) {
+    // Static: the event loop task has a small stack
+    static wifi_scan_ap_t aps[WIFI_SCAN_MAX_RESULTS];
+    
+    selecting = false;
+    if (reselect_timer) {
+        esp_timer_stop(reselect_timer);
+    }
+    size_t ap_count = wifi_scan_get_results(aps, WIFI_SCAN_MAX_RESULTS, NULL, NULL);
+    candidate_count = wifi_networks_rank(networks, network_count, aps, ap_count, candidates);
+    candidate_pos = 0;
+    round_scanned = true;
+    connect_candidate();
+}
+
+/**
+ * Start a round over the saved networks: scan, rank, connect to the best
+ */
+static void start_selection(void) {
+    // Reloaded so networks saved or forgotten from the portal count
+    network_count = wifi_networks_load(networks);
+    if (network_count == 0) {
+        ESP_LOGE(TAG, "No saved networks left");
+        if (!failure_reported && failed_callback) {
+            failure_reported = true;
+            failed_callback();
+        }
+        return;
+    }
+    
+    if (network_count == 1) {
+        // Nothing to choose between, and connecting scans for it anyway
+        candidates[0] = (wifi_candidate_t){ .index = 0 };
+        candidate_count = 1;
+        candidate_pos = 0;
+        round_scanned = true;
+        connect_candidate();
+        return;
+    }
+    
+    // The portal's scan cache is shared: a fresh scan finishing (ours or
+    // the portal's) calls on_scan_done
+    selecting = true;
+    esp_err_t err = wifi_scan_start();
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Scan not started (%s), using the last results", esp_err_to_name(err));
+        select_from_scan();
+        return;
+    }
+    ESP_LOGI(TAG, "Scanning to choose between %d saved networks", network_count);
+    if (reselect_timer) {
+        esp_timer_stop(reselect_timer);
+        esp_timer_start_once(reselect_timer, (uint64_t)WIFI_SELECT_TIMEOUT_MS * 1000);
+    }
+}
+
+static void on_scan_done(void) {
+    if (selecting) {
+        select_from_scan();
+    }
+}
+
+static void reselect_timer_callback(void* arg) {
+    if (esp_event_post(WIFI_MANAGER_EVENT, WIFI_MANAGER_EVENT_RESELECT, NULL, 0, 0) != ESP_OK) {
+        // Event queue full: try again shortly rather than lose the round
+        esp_timer_start_once(reselect_timer, 100 * 1000);
+    }
+}
+
+// Scan timeout while selecting, or the pause after a failed round
+static void on_reselect(void) {
+    if (selecting) {
+        ESP_LOGW(TAG, "Scan didn't finish, using the last results");
+        select_from_scan();
+    } else if (!wifi_connected) {
+        start_selection();
+    }
+}
+
+/**
+ * The STA has an address, however it was noticed (IP event, already
+ * assigned on association, or the polling fallback)
+ */
+static void sta_got_ip(const esp_netif_ip_info_t *ip_info) {
+    snprintf(current_ip, sizeof(current_ip), IPSTR, IP2STR(&ip_info->ip));
+    if (wifi_connected) {
+        return;  // Renewed or changed lease; nothing else to do
+    }
+    wifi_connected = true;
+    network_attempts = 0;  // Reset retry counter on successful connection
+    failure_reported = false;
+    // If this connection drops, retry this network before ranking again
+    candidates[0] = candidates[candidate_pos];
+    candidate_count = 1;
+    candidate_pos = 0;
+    round_scanned = false;
+    if (ip_poll_timer) {
+        esp_timer_stop(ip_poll_timer);
+    }
+    
+    connect_time_ms = (uint32_t)((esp_timer_get_time() - connect_start_us) / 1000);
+    ESP_LOGI(TAG, "Connected! IP: %s in %lu ms (%s)", current_ip, connect_time_ms,
+             fast_connect ? "cached AP" : "scanned");
+    sta_connected_once = true;
+    fast_cache_update(ip_info);
+    wifi_networks_mark_used(current_ssid);
+    xEventGroupSetBits(wifi_events, WIFI_CONNECTED_BIT);
+    
+    // Start web server if not already running
+    if (server == NULL) {
+        ESP_LOGI(TAG, "Starting web server on STA IP: %s", current_ip);
+        start_webserver();
+    }
+    
+    if (connected_callback) {
+        connected_callback();
+    }
+}
+
 static void ip_poll_timer_callback(void* arg) {
+    // Periodic, so a post dropped on a full queue is retried by the next tick
+    esp_event_post(WIFI_MANAGER_EVENT, WIFI_MANAGER_EVENT_IP_POLL, NULL, 0, 0);
+}
+
+static void on_ip_poll(void) {
     if (!wifi_connected && sta_netif) {
         esp_netif_ip_info_t ip_info;
         esp_err_t err = esp_netif_get_ip_info(sta_netif, &ip_info);
         
         if (err == ESP_OK && ip_info.ip.addr != 0) {
             ESP_LOGI(TAG, "IP detected via polling: " IPSTR, IP2STR(&ip_info.ip));
-            
-            // Stop the polling timer
-            if (ip_poll_timer) {
-                esp_timer_stop(ip_poll_timer);
-            }
-            
-            // Manually trigger connection logic
-            snprintf(current_ip, sizeof(current_ip), IPSTR, IP2STR(&ip_info.ip));
-            wifi_connected = true;
-            retry_count = 0;
-            
-            if (server == NULL) {
-                ESP_LOGI(TAG, "Starting web server on STA IP: %s", current_ip);
-                start_webserver();
-            }
-            
-            if (connected_callback) {
-                connected_callback();
-            }
+            sta_got_ip(&ip_info);
         }
     }
 }
@@ -1256,34 +1285,23 @@ static void ip_poll_timer_callback(void* arg) {
 // WiFi event handler
 static void wifi_event_handler(void* arg, esp_event_base_t event_base, int32_t event_id, void* event_data) {
     if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
-        esp_wifi_connect();
+        if (fast_connect) {
+            esp_wifi_connect();
+        } else {
+            start_selection();
+        }
     } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED) {
-        ESP_LOGI(TAG, "WiFi connected, waiting for IP address from DHCP...");
+        ESP_LOGI(TAG, "WiFi connected, waiting for IP address%s...", static_lease ? "" : " from DHCP");
         
-        // Diagnose netif state
-        if (sta_netif) {
-            // Check if netif is up
-            if (!esp_netif_is_netif_up(sta_netif)) {
-                ESP_LOGW(TAG, "WARNING: sta_netif is NOT up! This may prevent DHCP from working.");
-            }
-            
-            // Check DHCP status
+        // DHCP starts with the association; only start it if it is stopped
+        // (restarting a running client throws away the request in flight)
+        if (sta_netif && !static_lease) {
             esp_netif_dhcp_status_t status;
-            esp_err_t dhcp_err = esp_netif_dhcpc_get_status(sta_netif, &status);
-            ESP_LOGI(TAG, "DHCP status query: err=%s, status=%d", esp_err_to_name(dhcp_err), status);
-            
-            // Force DHCP to restart - stop and start it
-            if (dhcp_err == ESP_OK) {
-                if (status != ESP_NETIF_DHCP_STOPPED) {
-                    ESP_LOGI(TAG, "Stopping DHCP client to restart it...");
-                    esp_netif_dhcpc_stop(sta_netif);
-                    vTaskDelay(pdMS_TO_TICKS(100)); // Small delay
-                }
-                ESP_LOGI(TAG, "Starting DHCP client...");
+            if (esp_netif_dhcpc_get_status(sta_netif, &status) == ESP_OK && status == ESP_NETIF_DHCP_STOPPED) {
                 esp_err_t start_err = esp_netif_dhcpc_start(sta_netif);
                 ESP_LOGI(TAG, "DHCP start result: %s", esp_err_to_name(start_err));
             }
-        } else {
+        } else if (!sta_netif) {
             ESP_LOGE(TAG, "ERROR: sta_netif is NULL!");
         }
         
@@ -1293,15 +1311,7 @@ static void wifi_event_handler(void* arg, esp_event_base_t event_base, int32_t e
             if (ip_info.ip.addr != 0) {
                 ESP_LOGI(TAG, "IP already assigned: " IPSTR, IP2STR(&ip_info.ip));
                 // Manually trigger the got_ip logic since event didn't fire
-                snprintf(current_ip, sizeof(current_ip), IPSTR, IP2STR(&ip_info.ip));
-                wifi_connected = true;
-                retry_count = 0;
-                if (server == NULL) {
-                    start_webserver();
-                }
-                if (connected_callback) {
-                    connected_callback();
-                }
+                sta_got_ip(&ip_info);
             } else {
                 ESP_LOGI(TAG, "Waiting for DHCP to assign IP...");
                 
@@ -1332,45 +1342,72 @@ static void wifi_event_handler(void* arg, esp_event_base_t event_base, int32_t e
         wifi_event_sta_disconnected_t* disconnected = (wifi_event_sta_disconnected_t*) event_data;
         wifi_connected = false;
         strcpy(current_ip, "");
+        xEventGroupClearBits(wifi_events, WIFI_CONNECTED_BIT);
+        connect_start_us = esp_timer_get_time();
         
         // Stop polling timer if it's running
         if (ip_poll_timer != NULL) {
             esp_timer_stop(ip_poll_timer);
         }
         
-        retry_count++;
-        ESP_LOGW(TAG, "Disconnected from WiFi (reason: %d), retry %d/%d", disconnected->reason, retry_count, max_retry_attempts);
-        
-        if (retry_count >= max_retry_attempts) {
-            // Max retries reached, notify failure
-            ESP_LOGE(TAG, "WiFi connection failed after %d attempts", max_retry_attempts);
-            retry_count = 0;
-            if (failed_callback) {
-                failed_callback();
+        // The cached AP is gone or moved channel: scan instead, without
+        // spending a retry on it
+        if (fast_connect) {
+            bool never_connected = !sta_connected_once;
+            fast_connect_fallback();
+            if (never_connected) {
+                ESP_LOGW(TAG, "Cached AP not reachable (reason: %d), scanning", disconnected->reason);
+                start_selection();
+                return;
             }
-        } else {
-            // Still have retries left
+        }
+        if (selecting) {
+            return;  // Already choosing the next network
+        }
+        
+        network_attempts++;
+        ESP_LOGW(TAG, "Disconnected from %s (reason: %d), retry %d/%d", current_ssid, disconnected->reason,
+                 network_attempts, WIFI_NETWORK_ATTEMPTS);
+        
+        if (network_attempts < WIFI_NETWORK_ATTEMPTS) {
+            // Still have retries left on this network
             if (disconnected_callback) {
                 disconnected_callback();
             }
             esp_wifi_connect();
+        } else if (candidate_pos + 1 < candidate_count) {
+            // Fail over to the next saved network, no restart needed
+            candidate_pos++;
+            if (disconnected_callback) {
+                disconnected_callback();
+            }
+            connect_candidate();
+        } else if (!round_scanned) {
+            // Only the last good network was tried: rank them all again
+            if (disconnected_callback) {
+                disconnected_callback();
+            }
+            start_selection();
+        } else {
+            // Every saved network failed: notify once, keep trying in the background
+            ESP_LOGE(TAG, "WiFi connection failed on %d saved network(s), scanning again in %d s",
+                     candidate_count, WIFI_RESELECT_MS / 1000);
+            if (!failure_reported && failed_callback) {
+                failure_reported = true;
+                failed_callback();
+            }
+            if (reselect_timer) {
+                esp_timer_stop(reselect_timer);
+                esp_timer_start_once(reselect_timer, (uint64_t)WIFI_RESELECT_MS * 1000);
+            }
         }
     } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
         ip_event_got_ip_t* event = (ip_event_got_ip_t*) event_data;
-        snprintf(current_ip, sizeof(current_ip), IPSTR, IP2STR(&event->ip_info.ip));
-        wifi_connected = true;
-        retry_count = 0;  // Reset retry counter on successful connection
-        ESP_LOGI(TAG, "Connected! IP: %s", current_ip);
-        
-        // Start web server if not already running
-        if (server == NULL) {
-            ESP_LOGI(TAG, "Starting web server on STA IP: %s", current_ip);
-            start_webserver();
-        }
-        
-        if (connected_callback) {
-            connected_callback();
-        }
+        sta_got_ip(&event->ip_info);
+    } else if (event_base == WIFI_MANAGER_EVENT && event_id == WIFI_MANAGER_EVENT_RESELECT) {
+        on_reselect();
+    } else if (event_base == WIFI_MANAGER_EVENT && event_id == WIFI_MANAGER_EVENT_IP_POLL) {
+        on_ip_poll();
     }
 }
 
@@ -1435,6 +1472,9 @@ static esp_err_t start_ap_mode(void) {
     
     start_webserver();
     
+    // Have networks ready by the time the setup page asks
+    wifi_scan_touch();
+    
     ESP_LOGI(TAG, "AP mode started. Connect to '%s' and go to http://192.168.4.1", AP_SSID);
     return ESP_OK;
 }
@@ -1451,26 +1491,17 @@ esp_err_t wifi_manager_init(void) {
     // Initialize TCP/IP stack
     ESP_ERROR_CHECK(esp_netif_init());
     ESP_ERROR_CHECK(esp_event_loop_create_default());
+    ESP_ERROR_CHECK(wifi_scan_init());
+    // Answers DNS whenever the provisioning AP is up
+    ESP_ERROR_CHECK(captive_dns_init());
+    wifi_events = xEventGroupCreate();
     
-    // Try to load saved credentials
-    nvs_handle_t nvs_handle;
-    char ssid[33] = {0};
-    char password[65] = {0};
-    size_t ssid_len = sizeof(ssid);
-    size_t pass_len = sizeof(password);
-    
-    bool credentials_found = false;
-    if (nvs_open(WIFI_NAMESPACE, NVS_READONLY, &nvs_handle) == ESP_OK) {
-        if (nvs_get_str(nvs_handle, WIFI_SSID_KEY, ssid, &ssid_len) == ESP_OK &&
-            nvs_get_str(nvs_handle, WIFI_PASS_KEY, password, &pass_len) == ESP_OK) {
-            credentials_found = true;
-        }
-        nvs_close(nvs_handle);
-    }
+    // Try to load saved networks
+    network_count = wifi_networks_load(networks);
     
-    if (credentials_found && strlen(ssid) > 0) {
+    if (network_count > 0) {
         // Try STA mode first
-        ESP_LOGI(TAG, "WiFi credentials found, attempting connection to: %s", ssid);
+        ESP_LOGI(TAG, "%d saved WiFi network(s) found", network_count);
         
         // Create STA netif FIRST (standard order)
         sta_netif = esp_netif_create_default_wifi_sta();
@@ -1486,18 +1517,52 @@ esp_err_t wifi_manager_init(void) {
         ESP_ERROR_CHECK(esp_event_handler_register(WIFI_EVENT, ESP_EVENT_ANY_ID, &wifi_event_handler, NULL));
         ESP_ERROR_CHECK(esp_event_handler_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &wifi_event_handler, NULL));
         ESP_ERROR_CHECK(esp_event_handler_register(IP_EVENT, IP_EVENT_STA_LOST_IP, &wifi_event_handler, NULL));
+        ESP_ERROR_CHECK(esp_event_handler_register(WIFI_MANAGER_EVENT, ESP_EVENT_ANY_ID, &wifi_event_handler, NULL));
         ESP_LOGI(TAG, "Event handlers registered");
         
-        // Configure STA
-        wifi_config_t sta_config = {0};
-        strncpy((char*)sta_config.sta.ssid, ssid, sizeof(sta_config.sta.ssid));
-        strncpy((char*)sta_config.sta.password, password, sizeof(sta_config.sta.password));
-        sta_config.sta.threshold.authmode = WIFI_AUTH_WPA2_PSK; // Accept WPA2 or better (including WPA3)
-        strncpy(current_ssid, ssid, sizeof(current_ssid) - 1);
+        // Scan results pick the network when there is a choice
+        wifi_scan_register_done_cb(on_scan_done);
+        esp_timer_create_args_t timer_args = {
+            .callback = reselect_timer_callback,
+            .name = "wifi_reselect"
+        };
+        if (esp_timer_create(&timer_args, &reselect_timer) != ESP_OK) {
+            ESP_LOGW(TAG, "Reselect timer unavailable");
+        }
         
+        // Straight to the AP that worked last time, on its channel, while
+        // that network is still the most recently used; if it doesn't
+        // answer, the disconnect handler falls back to a scan. Otherwise
+        // STA_START starts a scan and picks the best saved network.
         ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
-        ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &sta_config));
+        int recent = wifi_networks_most_recent(networks, network_count);
+        if (recent >= 0 && fast_cache_load(networks[recent].ssid)) {
+            candidates[0] = (wifi_candidate_t){ .index = (uint8_t)recent };
+            candidate_count = 1;
+            candidate_pos = 0;
+            round_scanned = false;
+            
+            wifi_config_t sta_config = {0};
+            strncpy((char*)sta_config.sta.ssid, networks[recent].ssid, sizeof(sta_config.sta.ssid));
+            strncpy((char*)sta_config.sta.password, networks[recent].password, sizeof(sta_config.sta.password));
+            sta_config.sta.threshold.authmode = WIFI_AUTH_WPA2_PSK; // Accept WPA2 or better (including WPA3)
+            snprintf(current_ssid, sizeof(current_ssid), "%s", networks[recent].ssid);
+            memcpy(sta_config.sta.bssid, fast_cache.bssid, sizeof(sta_config.sta.bssid));
+            sta_config.sta.bssid_set = true;
+            sta_config.sta.channel = fast_cache.channel;
+            sta_config.sta.listen_interval = POWER_WIFI_LISTEN_INTERVAL;
+            fast_connect = true;
+            ESP_LOGI(TAG, "Fast connect to %s: channel %d, BSSID " MACSTR, current_ssid, fast_cache.channel,
+                     MAC2STR(fast_cache.bssid));
+#if WIFI_FAST_CONNECT_STATIC_IP
+            apply_static_lease();
+#endif
+            ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &sta_config));
+        }
+        
+        connect_start_us = esp_timer_get_time();
         ESP_ERROR_CHECK(esp_wifi_start());
+        power_apply_wifi();
         
         return ESP_OK;
     } else {
@@ -1545,6 +1610,9 @@ esp_err_t wifi_manager_init(void) {
         // Start web server
         start_webserver();
         
+        // Have networks ready by the time the setup page asks
+        wifi_scan_touch();
+        
         ESP_LOGI(TAG, "AP mode started. Connect to '%s' at http://192.168.4.1", AP_SSID);
         
         return ESP_OK;
@@ -1563,6 +1631,22 @@ const char* wifi_manager_get_ip(void) {
     return current_ip;
 }
 
+bool wifi_manager_wait_connected(uint32_t timeout_ms) {
+    if (!wifi_events) {
+        return false;
+    }
+    EventBits_t bits = xEventGroupWaitBits(wifi_events, WIFI_CONNECTED_BIT, pdFALSE, pdTRUE, pdMS_TO_TICKS(timeout_ms));
+    return (bits & WIFI_CONNECTED_BIT) != 0;
+}
+
+uint32_t wifi_manager_get_connect_time_ms(void) {
+    return connect_time_ms;
+}
+
+void wifi_manager_set_first_reading_ms(uint32_t ms) {
+    first_reading_ms = ms;
+}
+
 void wifi_manager_register_connected_cb(wifi_connected_cb_t cb) {
     connected_callback = cb;
 }
@@ -1582,27 +1666,21 @@ esp_err_t wifi_manager_clear_credentials(void) {
         return err;
     }
     
-    nvs_erase_key(nvs_handle, WIFI_SSID_KEY);
-    nvs_erase_key(nvs_handle, WIFI_PASS_KEY);
+    nvs_erase_key(nvs_handle, WIFI_FAST_KEY);
     nvs_commit(nvs_handle);
     nvs_close(nvs_handle);
     
+    err = wifi_networks_clear();
+    if (err != ESP_OK) {
+        return err;
+    }
+    
     ESP_LOGI(TAG, "WiFi credentials cleared");
     return ESP_OK;
 }
 
 bool wifi_manager_is_provisioned(void) {
-    nvs_handle_t nvs;
-    esp_err_t err = nvs_open(WIFI_NAMESPACE, NVS_READONLY, &nvs);
-    if (err != ESP_OK) {
-        return false;
-    }
-    
-    size_t ssid_len = 0;
-    err = nvs_get_str(nvs, WIFI_SSID_KEY, NULL, &ssid_len);
-    nvs_close(nvs);
-    
-    return (err == ESP_OK && ssid_len > 0);
+    return wifi_networks_exist();
 }
 
 esp_err_t wifi_manager_start_ap_mode(void) {
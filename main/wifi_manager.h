@@ -8,6 +8,7 @@
 
 #include "esp_err.h"
 #include <stdbool.h>
+#include <stdint.h>
 
 // Callback function types
 typedef void (*wifi_connected_cb_t)(void);
@@ -35,6 +36,24 @@ const char* wifi_manager_get_ssid(void);
  */
 const char* wifi_manager_get_ip(void);
 
+/**
+ * Wait until the STA has an IP address
+ * @return true if connected within timeout_ms
+ */
+bool wifi_manager_wait_connected(uint32_t timeout_ms);
+
+/**
+ * Time from starting the connection to getting an IP address, in ms
+ * (0 until the first connection)
+ */
+uint32_t wifi_manager_get_connect_time_ms(void);
+
+/**
+ * Record the time from boot to the first glucose reading, in ms, for the
+ * settings page
+ */
+void wifi_manager_set_first_reading_ms(uint32_t ms);
+
 /**
  * Register callback for WiFi connected event
  */
@@ -0,0 +1,278 @@
+/**
+ * WiFi Network Store Implementation
+ */
+
+#include "wifi_networks.h"
+#include "esp_log.h"
+#include "nvs_flash.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char *TAG = "WIFI_NETWORKS";
+
+// Shared with wifi_manager (fast-connect info lives there too)
+#define NETWORKS_NAMESPACE      "wifi_config"
+#define NETWORKS_KEY            "networks"
+#define NETWORKS_VERSION        1
+
+// Single network saved by older firmware
+#define LEGACY_SSID_KEY         "ssid"
+#define LEGACY_PASS_KEY         "password"
+
+typedef struct {
+    uint32_t version;
+    uint32_t seq;               // Highest last_used handed out
+    uint32_t count;
+    wifi_network_t networks[WIFI_NETWORKS_MAX];
+} networks_blob_t;
+
+static esp_err_t blob_save(const networks_blob_t *blob)
+{
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(NETWORKS_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = nvs_set_blob(nvs_handle, NETWORKS_KEY, blob, sizeof(*blob));
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs_handle);
+    }
+    nvs_close(nvs_handle);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to save networks: %s", esp_err_to_name(err));
+    }
+    return err;
+}
+
+/**
+ * Move the single network saved by older firmware into a new list
+ */
+static bool blob_migrate(networks_blob_t *blob)
+{
+    nvs_handle_t nvs_handle;
+    if (nvs_open(NETWORKS_NAMESPACE, NVS_READWRITE, &nvs_handle) != ESP_OK) {
+        return false;
+    }
+    wifi_network_t *network = &blob->networks[0];
+    size_t ssid_len = sizeof(network->ssid);
+    size_t pass_len = sizeof(network->password);
+    bool found = nvs_get_str(nvs_handle, LEGACY_SSID_KEY, network->ssid, &ssid_len) == ESP_OK &&
+                 nvs_get_str(nvs_handle, LEGACY_PASS_KEY, network->password, &pass_len) == ESP_OK &&
+                 network->ssid[0] != '\0';
+    if (found) {
+        network->last_used = 1;
+        blob->seq = 1;
+        blob->count = 1;
+        if (blob_save(blob) == ESP_OK) {
+            nvs_erase_key(nvs_handle, LEGACY_SSID_KEY);
+            nvs_erase_key(nvs_handle, LEGACY_PASS_KEY);
+            nvs_commit(nvs_handle);
+            ESP_LOGI(TAG, "Moved saved network %s into the network list", network->ssid);
+        }
+    }
+    nvs_close(nvs_handle);
+    return found;
+}
+
+static void blob_load(networks_blob_t *blob)
+{
+    memset(blob, 0, sizeof(*blob));
+    blob->version = NETWORKS_VERSION;
+
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(NETWORKS_NAMESPACE, NVS_READONLY, &nvs_handle);
+    if (err == ESP_OK) {
+        size_t len = sizeof(*blob);
+        err = nvs_get_blob(nvs_handle, NETWORKS_KEY, blob, &len);
+        nvs_close(nvs_handle);
+        if (err == ESP_OK && (len != sizeof(*blob) || blob->version != NETWORKS_VERSION ||
+                              blob->count > WIFI_NETWORKS_MAX)) {
+            ESP_LOGW(TAG, "Ignoring saved networks in an unknown format");
+            err = ESP_ERR_INVALID_VERSION;
+        }
+    }
+    if (err != ESP_OK) {
+        memset(blob, 0, sizeof(*blob));
+        blob->version = NETWORKS_VERSION;
+        if (err == ESP_ERR_NVS_NOT_FOUND) {
+            blob_migrate(blob);
+        }
+    }
+}
+
+size_t wifi_networks_load(wifi_network_t *networks)
+{
+    networks_blob_t blob;
+    blob_load(&blob);
+    size_t count = blob.count;
+    memcpy(networks, blob.networks, sizeof(blob.networks[0]) * count);
+    memset(&blob, 0, sizeof(blob));
+    return count;
+}
+
+bool wifi_networks_exist(void)
+{
+    networks_blob_t blob;
+    blob_load(&blob);
+    size_t count = blob.count;
+    memset(&blob, 0, sizeof(blob));
+    return count > 0;
+}
+
+int wifi_networks_find(const wifi_network_t *networks, size_t count, const char *ssid)
+{
+    for (size_t i = 0; i < count; i++) {
+        if (strcmp(networks[i].ssid, ssid) == 0) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+int wifi_networks_most_recent(const wifi_network_t *networks, size_t count)
+{
+    int best = -1;
+    for (size_t i = 0; i < count; i++) {
+        if (networks[i].last_used > 0 && (best < 0 || networks[i].last_used > networks[best].last_used)) {
+            best = (int)i;
+        }
+    }
+    return best;
+}
+
+esp_err_t wifi_networks_add(const char *ssid, const char *password)
+{
+    if (!ssid || ssid[0] == '\0' || strlen(ssid) >= sizeof(((wifi_network_t *)0)->ssid) ||
+        strlen(password) >= sizeof(((wifi_network_t *)0)->password)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    networks_blob_t blob;
+    blob_load(&blob);
+    int index = wifi_networks_find(blob.networks, blob.count, ssid);
+    if (index < 0 && blob.count < WIFI_NETWORKS_MAX) {
+        index = (int)blob.count++;
+    } else if (index < 0) {
+        // Full: replace the least recently used
+        index = 0;
+        for (size_t i = 1; i < blob.count; i++) {
+            if (blob.networks[i].last_used < blob.networks[index].last_used) {
+                index = (int)i;
+            }
+        }
+        ESP_LOGI(TAG, "Forgetting %s to make room", blob.networks[index].ssid);
+    }
+
+    wifi_network_t *network = &blob.networks[index];
+    memset(network, 0, sizeof(*network));
+    snprintf(network->ssid, sizeof(network->ssid), "%s", ssid);
+    snprintf(network->password, sizeof(network->password), "%s", password);
+    network->last_used = ++blob.seq;
+
+    esp_err_t err = blob_save(&blob);
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Saved network %s (%lu of %d)", ssid, blob.count, WIFI_NETWORKS_MAX);
+    }
+    memset(&blob, 0, sizeof(blob));
+    return err;
+}
+
+esp_err_t wifi_networks_forget(const char *ssid)
+{
+    networks_blob_t blob;
+    blob_load(&blob);
+    int index = wifi_networks_find(blob.networks, blob.count, ssid);
+    if (index < 0) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    memmove(&blob.networks[index], &blob.networks[index + 1],
+            sizeof(blob.networks[0]) * (blob.count - index - 1));
+    blob.count--;
+    memset(&blob.networks[blob.count], 0, sizeof(blob.networks[0]));
+
+    esp_err_t err = blob_save(&blob);
+    if (err == ESP_OK) {
+        ESP_LOGI(TAG, "Forgot network %s", ssid);
+    }
+    memset(&blob, 0, sizeof(blob));
+    return err;
+}
+
+esp_err_t wifi_networks_mark_used(const char *ssid)
+{
+    networks_blob_t blob;
+    blob_load(&blob);
+    int index = wifi_networks_find(blob.networks, blob.count, ssid);
+    esp_err_t err = ESP_OK;
+    if (index < 0) {
+        err = ESP_ERR_NOT_FOUND;
+    } else if (wifi_networks_most_recent(blob.networks, blob.count) != index) {
+        blob.networks[index].last_used = ++blob.seq;
+        err = blob_save(&blob);
+    }
+    memset(&blob, 0, sizeof(blob));
+    return err;
+}
+
+esp_err_t wifi_networks_clear(void)
+{
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(NETWORKS_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    nvs_erase_key(nvs_handle, NETWORKS_KEY);
+    nvs_erase_key(nvs_handle, LEGACY_SSID_KEY);
+    nvs_erase_key(nvs_handle, LEGACY_PASS_KEY);
+    err = nvs_commit(nvs_handle);
+    nvs_close(nvs_handle);
+    return err;
+}
+
+/**
+ * Whether candidate a should be tried before b
+ */
+static bool ranks_before(const wifi_network_t *networks, int recent,
+                         const wifi_candidate_t *a, const wifi_candidate_t *b)
+{
+    if (a->seen != b->seen) {
+        return a->seen;
+    }
+    if (a->seen) {
+        int score_a = a->rssi + (a->index == recent ? WIFI_NETWORKS_RECENT_BONUS_DB : 0);
+        int score_b = b->rssi + (b->index == recent ? WIFI_NETWORKS_RECENT_BONUS_DB : 0);
+        if (score_a != score_b) {
+            return score_a > score_b;
+        }
+    }
+    return networks[a->index].last_used > networks[b->index].last_used;
+}
+
+size_t wifi_networks_rank(const wifi_network_t *networks, size_t count,
+                          const wifi_scan_ap_t *aps, size_t ap_count,
+                          wifi_candidate_t *candidates)
+{
+    int recent = wifi_networks_most_recent(networks, count);
+
+    // Insertion sort: a handful of entries, and equal ones keep their saved order
+    for (size_t i = 0; i < count; i++) {
+        wifi_candidate_t candidate = { .index = (uint8_t)i };
+        for (size_t j = 0; j < ap_count; j++) {
+            if (strcmp(aps[j].ssid, networks[i].ssid) == 0) {
+                candidate.seen = true;
+                candidate.rssi = aps[j].rssi;
+                candidate.channel = aps[j].channel;
+                break;
+            }
+        }
+
+        size_t pos = i;
+        while (pos > 0 && ranks_before(networks, recent, &candidate, &candidates[pos - 1])) {
+            candidates[pos] = candidates[pos - 1];
+            pos--;
+        }
+        candidates[pos] = candidate;
+    }
+    return count;
+}
@@ -0,0 +1,120 @@
+/**
+ * WiFi Network Store
+ * Saved networks and the order to try them in
+ *
+ * Up to WIFI_NETWORKS_MAX SSID/password pairs are kept in NVS (one blob
+ * in the wifi_config namespace). Each carries a "last used" sequence
+ * number, bumped when the device connects with it or when it is saved
+ * from the portal, so the network used most recently is known without a
+ * wall clock.
+ *
+ * Ranking takes the latest scan: networks that were seen come first,
+ * strongest first, with WIFI_NETWORKS_RECENT_BONUS_DB added to the most
+ * recently used one so the device doesn't hop between two networks of
+ * similar strength. Networks that weren't seen (hidden, or missed by the
+ * scan) are still tried afterwards, most recently used first.
+ */
+
+#ifndef WIFI_NETWORKS_H
+#define WIFI_NETWORKS_H
+
+#include "esp_err.h"
+#include "wifi_scan.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Saved networks; saving one more forgets the least recently used
+#define WIFI_NETWORKS_MAX               5
+
+// Connection attempts on one network before moving to the next
+#define WIFI_NETWORK_ATTEMPTS           3
+
+// RSSI credit for the most recently used network when ranking
+#define WIFI_NETWORKS_RECENT_BONUS_DB   10
+
+/**
+ * Saved network
+ */
+typedef struct {
+    char ssid[33];
+    char password[65];
+    uint32_t last_used;         // Sequence number, 0: never used
+} wifi_network_t;
+
+/**
+ * Network to try, in ranked order
+ */
+typedef struct {
+    uint8_t index;              // Into the saved list
+    bool seen;                  // In the scan results
+    int8_t rssi;                // Strongest BSS (valid if seen)
+    uint8_t channel;            // Its channel (valid if seen)
+} wifi_candidate_t;
+
+/**
+ * Load the saved networks
+ * Credentials saved by older firmware (single ssid/password keys) are
+ * moved into the list the first time.
+ *
+ * @param networks Output array of WIFI_NETWORKS_MAX entries
+ * @return Number of networks loaded
+ */
+size_t wifi_networks_load(wifi_network_t *networks);
+
+/**
+ * Check if any network is saved
+ */
+bool wifi_networks_exist(void);
+
+/**
+ * Save a network, or update its password, and make it the most recently used
+ * @return ESP_OK on success
+ */
+esp_err_t wifi_networks_add(const char *ssid, const char *password);
+
+/**
+ * Forget a saved network
+ * @return ESP_OK, or ESP_ERR_NOT_FOUND if it isn't saved
+ */
+esp_err_t wifi_networks_forget(const char *ssid);
+
+/**
+ * Note a successful connection (NVS is only written if another network
+ * was the most recently used)
+ * @return ESP_OK on success
+ */
+esp_err_t wifi_networks_mark_used(const char *ssid);
+
+/**
+ * Forget all saved networks
+ * @return ESP_OK on success
+ */
+esp_err_t wifi_networks_clear(void);
+
+/**
+ * Find a saved network by SSID
+ * @return Index, or -1 if it isn't saved
+ */
+int wifi_networks_find(const wifi_network_t *networks, size_t count, const char *ssid);
+
+/**
+ * Index of the most recently used network, or -1 if none was ever used
+ */
+int wifi_networks_most_recent(const wifi_network_t *networks, size_t count);
+
+/**
+ * Rank saved networks against scan results
+ *
+ * @param networks Saved networks
+ * @param count Number of saved networks
+ * @param aps Scan results (one entry per SSID, as from wifi_scan_get_results)
+ * @param ap_count Number of scan results
+ * @param candidates Output array of at least count entries
+ * @return Number of candidates (always count)
+ */
+size_t wifi_networks_rank(const wifi_network_t *networks, size_t count,
+                          const wifi_scan_ap_t *aps, size_t ap_count,
+                          wifi_candidate_t *candidates);
+
+#endif // WIFI_NETWORKS_H
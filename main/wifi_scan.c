@@ -0,0 +1,252 @@
+/**
+ * WiFi Scan Service Implementation
+ */
+
+#include "wifi_scan.h"
+#include "esp_event.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const char *TAG = "WIFI_SCAN";
+
+// Records fetched from the driver per scan (before deduplication)
+#define WIFI_SCAN_MAX_RECORDS   32
+
+// A scan that never reported SCAN_DONE (e.g. WiFi restarted) is given up after this
+#define WIFI_SCAN_STUCK_MS      10000
+
+static SemaphoreHandle_t scan_mutex = NULL;
+static esp_timer_handle_t refresh_timer = NULL;
+
+static wifi_scan_ap_t cache[WIFI_SCAN_MAX_RESULTS];
+static size_t cache_count = 0;
+static int64_t cache_time_us = 0;       // 0: no scan completed yet
+static bool scanning = false;
+static int64_t scan_started_us = 0;
+static int64_t last_request_us = 0;
+static wifi_scan_done_cb_t done_callback = NULL;
+
+static int compare_rssi(const void *a, const void *b)
+{
+    const wifi_scan_ap_t *ap_a = a;
+    const wifi_scan_ap_t *ap_b = b;
+    return (int)ap_b->rssi - (int)ap_a->rssi;
+}
+
+// Start a scan unless one is running. Caller holds scan_mutex.
+static esp_err_t start_scan_locked(void)
+{
+    int64_t now = esp_timer_get_time();
+    if (scanning && now - scan_started_us < (int64_t)WIFI_SCAN_STUCK_MS * 1000) {
+        return ESP_OK;
+    }
+
+    wifi_mode_t mode;
+    if (esp_wifi_get_mode(&mode) != ESP_OK || (mode != WIFI_MODE_APSTA && mode != WIFI_MODE_STA)) {
+        ESP_LOGD(TAG, "WiFi not in a scanning mode");
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    wifi_scan_config_t scan_config = {
+        .show_hidden = false,
+        .scan_type = WIFI_SCAN_TYPE_ACTIVE,
+        .scan_time.active.min = 100,
+        .scan_time.active.max = 300
+    };
+
+    esp_err_t err = esp_wifi_scan_start(&scan_config, false);
+    if (err != ESP_OK) {
+        // Typically ESP_ERR_WIFI_STATE while the station is connecting
+        ESP_LOGD(TAG, "Scan not started: %s", esp_err_to_name(err));
+        scanning = false;
+        return err;
+    }
+    scanning = true;
+    scan_started_us = now;
+    return ESP_OK;
+}
+
+// Fetch the driver's records and rebuild the cache (runs in the event loop task)
+static void collect_results(void)
+{
+    uint16_t ap_count = 0;
+    esp_wifi_scan_get_ap_num(&ap_count);
+    if (ap_count > WIFI_SCAN_MAX_RECORDS) {
+        ap_count = WIFI_SCAN_MAX_RECORDS;
+    }
+
+    wifi_ap_record_t *records = NULL;
+    if (ap_count > 0) {
+        records = malloc(sizeof(wifi_ap_record_t) * ap_count);
+        if (!records) {
+            ESP_LOGE(TAG, "No memory for %d scan records", ap_count);
+            esp_wifi_clear_ap_list();
+            ap_count = 0;
+        }
+    }
+    if (records) {
+        // Also releases the driver's copy of all records
+        esp_wifi_scan_get_ap_records(&ap_count, records);
+    }
+
+    // Static: the default event loop task has a small stack
+    static wifi_scan_ap_t unique[WIFI_SCAN_MAX_RECORDS];
+    size_t unique_count = 0;
+
+    for (uint16_t i = 0; i < ap_count; i++) {
+        const char *ssid = (const char *)records[i].ssid;
+        if (ssid[0] == '\0') {
+            continue;  // Hidden network
+        }
+
+        size_t j;
+        for (j = 0; j < unique_count; j++) {
+            if (strcmp(unique[j].ssid, ssid) == 0) {
+                break;
+            }
+        }
+        if (j < unique_count && unique[j].rssi >= records[i].rssi) {
+            continue;  // Already have a stronger BSS for this SSID
+        }
+        if (j == unique_count) {
+            unique_count++;
+        }
+
+        wifi_scan_ap_t *ap = &unique[j];
+        strncpy(ap->ssid, ssid, sizeof(ap->ssid) - 1);
+        ap->ssid[sizeof(ap->ssid) - 1] = '\0';
+        memcpy(ap->bssid, records[i].bssid, sizeof(ap->bssid));
+        ap->channel = records[i].primary;
+        ap->rssi = records[i].rssi;
+        ap->authmode = records[i].authmode;
+    }
+    free(records);
+
+    qsort(unique, unique_count, sizeof(unique[0]), compare_rssi);
+    if (unique_count > WIFI_SCAN_MAX_RESULTS) {
+        unique_count = WIFI_SCAN_MAX_RESULTS;
+    }
+
+    xSemaphoreTake(scan_mutex, portMAX_DELAY);
+    memcpy(cache, unique, sizeof(unique[0]) * unique_count);
+    cache_count = unique_count;
+    cache_time_us = esp_timer_get_time();
+    scanning = false;
+    xSemaphoreGive(scan_mutex);
+
+    ESP_LOGI(TAG, "Scan done: %d records, %d networks", ap_count, unique_count);
+
+    if (done_callback) {
+        done_callback();
+    }
+}
+
+static void scan_event_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data)
+{
+    if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_SCAN_DONE) {
+        collect_results();
+    }
+}
+
+static void refresh_timer_callback(void *arg)
+{
+    xSemaphoreTake(scan_mutex, portMAX_DELAY);
+    if (esp_timer_get_time() - last_request_us > (int64_t)WIFI_SCAN_IDLE_MS * 1000) {
+        esp_timer_stop(refresh_timer);
+        ESP_LOGI(TAG, "Portal idle, background scanning stopped");
+    } else {
+        start_scan_locked();
+    }
+    xSemaphoreGive(scan_mutex);
+}
+
+esp_err_t wifi_scan_init(void)
+{
+    if (scan_mutex) {
+        return ESP_OK;
+    }
+
+    scan_mutex = xSemaphoreCreateMutex();
+    if (!scan_mutex) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_timer_create_args_t timer_args = {
+        .callback = refresh_timer_callback,
+        .name = "wifi_scan"
+    };
+    esp_err_t err = esp_timer_create(&timer_args, &refresh_timer);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Background refresh unavailable: %s", esp_err_to_name(err));
+    }
+
+    return esp_event_handler_register(WIFI_EVENT, WIFI_EVENT_SCAN_DONE, &scan_event_handler, NULL);
+}
+
+void wifi_scan_touch(void)
+{
+    if (!scan_mutex) {
+        return;
+    }
+
+    xSemaphoreTake(scan_mutex, portMAX_DELAY);
+    int64_t now = esp_timer_get_time();
+    last_request_us = now;
+
+    if (cache_time_us == 0 || now - cache_time_us > (int64_t)WIFI_SCAN_MAX_AGE_MS * 1000) {
+        start_scan_locked();
+    }
+    if (refresh_timer && !esp_timer_is_active(refresh_timer)) {
+        esp_timer_start_periodic(refresh_timer, (uint64_t)WIFI_SCAN_REFRESH_MS * 1000);
+    }
+    xSemaphoreGive(scan_mutex);
+}
+
+esp_err_t wifi_scan_start(void)
+{
+    if (!scan_mutex) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    xSemaphoreTake(scan_mutex, portMAX_DELAY);
+    esp_err_t err = start_scan_locked();
+    xSemaphoreGive(scan_mutex);
+    return err;
+}
+
+void wifi_scan_register_done_cb(wifi_scan_done_cb_t cb)
+{
+    done_callback = cb;
+}
+
+size_t wifi_scan_get_results(wifi_scan_ap_t *results, size_t max_results, int64_t *age_ms, bool *is_scanning)
+{
+    if (!scan_mutex) {
+        if (age_ms) {
+            *age_ms = -1;
+        }
+        if (is_scanning) {
+            *is_scanning = false;
+        }
+        return 0;
+    }
+
+    xSemaphoreTake(scan_mutex, portMAX_DELAY);
+    size_t count = cache_count < max_results ? cache_count : max_results;
+    if (results && count > 0) {
+        memcpy(results, cache, sizeof(cache[0]) * count);
+    }
+    if (age_ms) {
+        *age_ms = cache_time_us ? (esp_timer_get_time() - cache_time_us) / 1000 : -1;
+    }
+    if (is_scanning) {
+        *is_scanning = scanning;
+    }
+    xSemaphoreGive(scan_mutex);
+
+    return count;
+}
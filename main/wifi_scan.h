@@ -0,0 +1,93 @@
+/**
+ * WiFi Scan Service
+ * Background access point scanning with a cached result list
+ *
+ * Scans are started without blocking (esp_wifi_scan_start(..., false))
+ * and collected on WIFI_EVENT_SCAN_DONE. Results are deduplicated by SSID
+ * (strongest BSS wins), sorted by RSSI and cached with a timestamp, so
+ * the web portal is answered straight from RAM. While the portal keeps
+ * asking, the list is refreshed in the background every
+ * WIFI_SCAN_REFRESH_MS; refreshing stops WIFI_SCAN_IDLE_MS after the
+ * last request.
+ *
+ * The station uses the same cache to pick among saved networks, so a
+ * scan started for either one serves both.
+ */
+
+#ifndef WIFI_SCAN_H
+#define WIFI_SCAN_H
+
+#include "esp_err.h"
+#include "esp_wifi.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Maximum number of networks kept in the cache
+#define WIFI_SCAN_MAX_RESULTS   20
+
+// Background refresh period while the portal is in use
+#define WIFI_SCAN_REFRESH_MS    30000
+
+// Results older than this trigger a new scan on the next request
+#define WIFI_SCAN_MAX_AGE_MS    15000
+
+// Stop refreshing this long after the last request
+#define WIFI_SCAN_IDLE_MS       120000
+
+/**
+ * Cached network
+ */
+typedef struct {
+    char ssid[33];
+    uint8_t bssid[6];           // Strongest BSS for this SSID
+    uint8_t channel;
+    int8_t rssi;
+    wifi_auth_mode_t authmode;
+} wifi_scan_ap_t;
+
+/**
+ * Called from the event loop task after each scan has been cached
+ */
+typedef void (*wifi_scan_done_cb_t)(void);
+
+/**
+ * Initialize the scan service
+ * Call once after the default event loop has been created
+ *
+ * @return ESP_OK on success
+ */
+esp_err_t wifi_scan_init(void);
+
+/**
+ * Note that the portal wants scan results
+ * Starts a scan if the cache is empty or older than WIFI_SCAN_MAX_AGE_MS
+ * and keeps the background refresh running. Never blocks.
+ */
+void wifi_scan_touch(void);
+
+/**
+ * Start a scan now, whatever the age of the cache
+ * Used by the station to pick a network; the station must not be
+ * connecting while it runs. Never blocks.
+ *
+ * @return ESP_OK if a scan was started or is already running
+ */
+esp_err_t wifi_scan_start(void);
+
+/**
+ * Register the callback for completed scans
+ */
+void wifi_scan_register_done_cb(wifi_scan_done_cb_t cb);
+
+/**
+ * Copy the cached networks (strongest first)
+ *
+ * @param results Output array
+ * @param max_results Size of the output array
+ * @param age_ms Output: age of the results in ms, -1 if no scan has completed (may be NULL)
+ * @param is_scanning Output: true while a scan is in progress (may be NULL)
+ * @return Number of networks copied
+ */
+size_t wifi_scan_get_results(wifi_scan_ap_t *results, size_t max_results, int64_t *age_ms, bool *is_scanning);
+
+#endif // WIFI_SCAN_H
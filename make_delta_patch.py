@@ -0,0 +1,163 @@
+#!/usr/bin/env python3
+"""
+Create a delta OTA patch between two firmware images
+
+Devices running OLD download the patch instead of the full NEW image and
+rebuild NEW from their running partition (main/delta_patch.h has the
+format). Publish it next to the full image as
+glucose-monitor-v<new>-from-v<old>.patch.
+
+Usage: make_delta_patch.py OLD.bin NEW.bin -o OUT.patch
+"""
+
+import argparse
+import hashlib
+import struct
+import sys
+import zlib
+
+MAGIC = b'GMDP'
+VERSION = 1
+
+KEY_LEN = 16        # Bytes hashed per source index entry
+INDEX_STEP = 8      # Source positions indexed (any match of 23+ bytes is found)
+LOOKAHEAD = 256     # Give up extending a diff after this many bytes without gain
+
+
+def common_prefix(a, ai, b, bi, limit):
+    """Length of the common prefix of a[ai:] and b[bi:], at most limit"""
+    n = 0
+    step = 256
+    while n + step <= limit and a[ai + n:ai + n + step] == b[bi + n:bi + n + step]:
+        n += step
+    while n < limit and a[ai + n] == b[bi + n]:
+        n += 1
+    return n
+
+
+def extend(src, tgt, s, t):
+    """Length of the diff region starting at src[s]/tgt[t]
+
+    Like bsdiff, keep going through mismatches while at least half the
+    bytes still match, so code that only had pointers change stays in
+    one record (its diff bytes are mostly zero and compress well).
+    """
+    limit = min(len(src) - s, len(tgt) - t)
+    i = matched = best = best_score = 0
+    while i < limit and i - best <= LOOKAHEAD:
+        run = common_prefix(src, s + i, tgt, t + i, limit - i)
+        if run:
+            i += run
+            matched += run
+            if 2 * matched - i > best_score:
+                best_score, best = 2 * matched - i, i
+        else:
+            i += 1
+    return best
+
+
+def find_matches(src, tgt):
+    """Diff regions (target pos, source pos, length), in target order"""
+    index = {}
+    for s in range(0, len(src) - KEY_LEN + 1, INDEX_STEP):
+        index.setdefault(src[s:s + KEY_LEN], s)
+
+    matches = []
+    prev_end = 0
+    delta = 0           # source pos - target pos of the last match
+    t = 0
+    while t + KEY_LEN <= len(tgt):
+        window = tgt[t:t + KEY_LEN]
+        s = t + delta
+        if not (0 <= s <= len(src) - KEY_LEN and src[s:s + KEY_LEN] == window):
+            s = index.get(window)
+            if s is None:
+                t += 1
+                continue
+
+        # Back up over bytes that also match, then extend forwards
+        found_at = t
+        while t > prev_end and s > 0 and tgt[t - 1] == src[s - 1]:
+            t -= 1
+            s -= 1
+        length = extend(src, tgt, s, t)
+        if length < KEY_LEN:
+            t = found_at + 1
+            continue
+
+        matches.append((t, s, length))
+        prev_end = t + length
+        delta = s - t
+        t = prev_end
+    return matches
+
+
+def make_patch(src, tgt):
+    body = bytearray()
+
+    def record(t, s, diff_len, extra_end, next_s):
+        diff = bytes((tgt[t + i] - src[s + i]) & 0xFF for i in range(diff_len))
+        extra = tgt[t + diff_len:extra_end]
+        body.extend(struct.pack('<IIi', diff_len, len(extra), next_s - (s + diff_len)))
+        body.extend(diff)
+        body.extend(extra)
+
+    pending = (0, 0, 0)
+    for t, s, length in find_matches(src, tgt):
+        record(pending[0], pending[1], pending[2], t, s)
+        pending = (t, s, length)
+    record(pending[0], pending[1], pending[2], len(tgt), pending[1] + pending[2])
+
+    header = MAGIC + struct.pack('<B3xII', VERSION, len(src), len(tgt))
+    header += hashlib.sha256(src).digest() + hashlib.sha256(tgt).digest()
+    return header + zlib.compress(bytes(body), 9)
+
+
+def apply_patch(src, patch):
+    """Reference applier, used to check every patch before it is written"""
+    if patch[:4] != MAGIC or patch[4] != VERSION:
+        raise ValueError('not a patch')
+    src_len, tgt_len = struct.unpack_from('<II', patch, 8)
+    if src_len != len(src) or hashlib.sha256(src).digest() != patch[16:48]:
+        raise ValueError('patch is for a different source image')
+
+    body = zlib.decompress(patch[80:])
+    out = bytearray()
+    pos = 0
+    s = 0
+    while pos < len(body):
+        diff_len, extra_len, seek = struct.unpack_from('<IIi', body, pos)
+        pos += 12
+        out.extend((src[s + i] + body[pos + i]) & 0xFF for i in range(diff_len))
+        pos += diff_len
+        s += diff_len
+        out.extend(body[pos:pos + extra_len])
+        pos += extra_len
+        s += seek
+    if len(out) != tgt_len or hashlib.sha256(out).digest() != patch[48:80]:
+        raise ValueError('patch does not reproduce the target image')
+    return bytes(out)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Create a delta OTA patch between two firmware images')
+    parser.add_argument('old', help='Image devices are running (previous release .bin)')
+    parser.add_argument('new', help='Image to update them to (new release .bin)')
+    parser.add_argument('-o', '--output', required=True, help='Patch file to write')
+    args = parser.parse_args()
+
+    with open(args.old, 'rb') as f:
+        src = f.read()
+    with open(args.new, 'rb') as f:
+        tgt = f.read()
+
+    patch = make_patch(src, tgt)
+    apply_patch(src, patch)
+
+    with open(args.output, 'wb') as f:
+        f.write(patch)
+    print(f'delta patch: {len(tgt)} -> {len(patch)} bytes ({len(tgt) / len(patch):.1f}x smaller)')
+
+
+if __name__ == '__main__':
+    sys.exit(main())
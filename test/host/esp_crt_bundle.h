@@ -0,0 +1,12 @@
+/**
+ * Host stand-in for esp_crt_bundle.h
+ */
+
+#ifndef HOST_ESP_CRT_BUNDLE_H
+#define HOST_ESP_CRT_BUNDLE_H
+
+#include "esp_err.h"
+
+esp_err_t esp_crt_bundle_attach(void *conf);
+
+#endif // HOST_ESP_CRT_BUNDLE_H
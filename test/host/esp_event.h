@@ -0,0 +1,16 @@
+/**
+ * Host stand-in for esp_event.h (handler types only)
+ */
+
+#ifndef HOST_ESP_EVENT_H
+#define HOST_ESP_EVENT_H
+
+#include "esp_err.h"
+#include <stdint.h>
+
+typedef const char *esp_event_base_t;
+typedef void (*esp_event_handler_t)(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data);
+
+#define ESP_EVENT_ANY_ID    -1
+
+#endif // HOST_ESP_EVENT_H
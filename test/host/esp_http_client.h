@@ -0,0 +1,37 @@
+/**
+ * Host stand-in for esp_http_client.h
+ * Plain HTTP/1.1 over a blocking socket: enough for the modules that
+ * POST a body with esp_http_client_perform() and check the status.
+ */
+
+#ifndef HOST_ESP_HTTP_CLIENT_H
+#define HOST_ESP_HTTP_CLIENT_H
+
+#include "esp_err.h"
+
+typedef struct esp_http_client *esp_http_client_handle_t;
+
+typedef enum {
+    HTTP_METHOD_GET = 0,
+    HTTP_METHOD_POST,
+} esp_http_client_method_t;
+
+typedef struct {
+    const char *url;
+    esp_http_client_method_t method;
+    int timeout_ms;
+    const char *user_agent;
+    esp_err_t (*crt_bundle_attach)(void *conf);
+    int buffer_size;
+    int buffer_size_tx;
+    bool keep_alive_enable;
+} esp_http_client_config_t;
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *config);
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t client, const char *key, const char *value);
+esp_err_t esp_http_client_set_post_field(esp_http_client_handle_t client, const char *data, int len);
+esp_err_t esp_http_client_perform(esp_http_client_handle_t client);
+int esp_http_client_get_status_code(esp_http_client_handle_t client);
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client);
+
+#endif // HOST_ESP_HTTP_CLIENT_H
@@ -0,0 +1,19 @@
+/**
+ * Host stand-in for esp_log.h
+ * Logs go to stderr when HOST_TEST_VERBOSE is set in the environment.
+ */
+
+#ifndef HOST_ESP_LOG_H
+#define HOST_ESP_LOG_H
+
+#include <stdio.h>
+
+void host_log(char level, const char *tag, const char *format, ...) __attribute__((format(printf, 3, 4)));
+
+#define ESP_LOGE(tag, format, ...) host_log('E', tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) host_log('W', tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) host_log('I', tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) host_log('D', tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...) host_log('V', tag, format, ##__VA_ARGS__)
+
+#endif // HOST_ESP_LOG_H
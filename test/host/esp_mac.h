@@ -0,0 +1,18 @@
+/**
+ * Host stand-in for esp_mac.h (a fixed MAC, see HOST_MAC in host_idf.h)
+ */
+
+#ifndef HOST_ESP_MAC_H
+#define HOST_ESP_MAC_H
+
+#include "esp_err.h"
+#include <stdint.h>
+
+typedef enum {
+    ESP_MAC_WIFI_STA,
+    ESP_MAC_WIFI_SOFTAP,
+} esp_mac_type_t;
+
+esp_err_t esp_read_mac(uint8_t *mac, esp_mac_type_t type);
+
+#endif // HOST_ESP_MAC_H
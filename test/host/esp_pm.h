@@ -0,0 +1,35 @@
+/**
+ * Host stand-in for esp_pm.h
+ * Locks only count acquires and releases (see host_pm_locks_held in
+ * host_idf.h); the clock never changes.
+ */
+
+#ifndef HOST_ESP_PM_H
+#define HOST_ESP_PM_H
+
+#include "esp_err.h"
+#include <stdbool.h>
+#include <stdio.h>
+
+typedef enum {
+    ESP_PM_CPU_FREQ_MAX,
+    ESP_PM_APB_FREQ_MAX,
+    ESP_PM_NO_LIGHT_SLEEP,
+} esp_pm_lock_type_t;
+
+typedef struct {
+    int max_freq_mhz;
+    int min_freq_mhz;
+    bool light_sleep_enable;
+} esp_pm_config_t;
+
+typedef struct esp_pm_lock *esp_pm_lock_handle_t;
+
+esp_err_t esp_pm_configure(const void *config);
+esp_err_t esp_pm_lock_create(esp_pm_lock_type_t lock_type, int arg, const char *name, esp_pm_lock_handle_t *out_handle);
+esp_err_t esp_pm_lock_acquire(esp_pm_lock_handle_t handle);
+// ESP_ERR_INVALID_STATE if the lock isn't held, as in ESP-IDF
+esp_err_t esp_pm_lock_release(esp_pm_lock_handle_t handle);
+esp_err_t esp_pm_dump_locks(FILE *stream);
+
+#endif // HOST_ESP_PM_H
@@ -0,0 +1,13 @@
+/**
+ * Host stand-in for esp_rom_crc.h
+ */
+
+#ifndef HOST_ESP_ROM_CRC_H
+#define HOST_ESP_ROM_CRC_H
+
+#include <stdint.h>
+
+// CRC-32 (IEEE 802.3, as zlib.crc32), continuing from crc
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len);
+
+#endif // HOST_ESP_ROM_CRC_H
@@ -0,0 +1,12 @@
+/**
+ * Host stand-in for esp_system.h
+ */
+
+#ifndef HOST_ESP_SYSTEM_H
+#define HOST_ESP_SYSTEM_H
+
+#include <stdint.h>
+
+uint32_t esp_get_free_heap_size(void);
+
+#endif // HOST_ESP_SYSTEM_H
@@ -0,0 +1,46 @@
+/**
+ * Host stand-in for esp_wifi.h (scan result types, the station's AP info
+ * and its power save mode)
+ */
+
+#ifndef HOST_ESP_WIFI_H
+#define HOST_ESP_WIFI_H
+
+#include "esp_err.h"
+#include <stdint.h>
+
+#define ESP_ERR_WIFI_BASE       0x3000
+#define ESP_ERR_WIFI_NOT_INIT   (ESP_ERR_WIFI_BASE + 1)
+
+typedef enum {
+    WIFI_AUTH_OPEN = 0,
+    WIFI_AUTH_WEP,
+    WIFI_AUTH_WPA_PSK,
+    WIFI_AUTH_WPA2_PSK,
+    WIFI_AUTH_WPA_WPA2_PSK,
+    WIFI_AUTH_WPA2_ENTERPRISE,
+    WIFI_AUTH_WPA3_PSK,
+    WIFI_AUTH_WPA2_WPA3_PSK,
+} wifi_auth_mode_t;
+
+typedef struct {
+    uint8_t bssid[6];
+    uint8_t ssid[33];
+    uint8_t primary;
+    int8_t rssi;
+    wifi_auth_mode_t authmode;
+} wifi_ap_record_t;
+
+// Reports HOST_WIFI_RSSI (host_idf.h)
+esp_err_t esp_wifi_sta_get_ap_info(wifi_ap_record_t *ap_info);
+
+typedef enum {
+    WIFI_PS_NONE,
+    WIFI_PS_MIN_MODEM,
+    WIFI_PS_MAX_MODEM,
+} wifi_ps_type_t;
+
+// Recorded for host_wifi_ps (host_idf.h)
+esp_err_t esp_wifi_set_ps(wifi_ps_type_t type);
+
+#endif // HOST_ESP_WIFI_H
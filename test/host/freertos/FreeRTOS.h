@@ -0,0 +1,39 @@
+/**
+ * Host stand-in for FreeRTOS.h
+ * Ticks are milliseconds; critical sections take one process-wide lock.
+ */
+
+#ifndef HOST_FREERTOS_H
+#define HOST_FREERTOS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define pdTRUE                  1
+#define pdFALSE                 0
+#define pdPASS                  pdTRUE
+#define pdFAIL                  pdFALSE
+#define portMAX_DELAY           0xFFFFFFFFu
+#define portTICK_PERIOD_MS      1
+#define pdMS_TO_TICKS(ms)       ((TickType_t)(ms))
+
+typedef struct {
+    int unused;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED    { 0 }
+
+void host_critical_enter(void);
+void host_critical_exit(void);
+
+#define taskENTER_CRITICAL(mux)     do { (void)(mux); host_critical_enter(); } while (0)
+#define taskEXIT_CRITICAL(mux)      do { (void)(mux); host_critical_exit(); } while (0)
+#define portENTER_CRITICAL(mux)     taskENTER_CRITICAL(mux)
+#define portEXIT_CRITICAL(mux)      taskEXIT_CRITICAL(mux)
+
+#endif // HOST_FREERTOS_H
@@ -0,0 +1,24 @@
+/**
+ * Host stand-in for semphr.h (mutexes and counting semaphores on pthreads)
+ */
+
+#ifndef HOST_SEMPHR_H
+#define HOST_SEMPHR_H
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct host_semaphore *SemaphoreHandle_t;
+
+typedef struct {
+    uint64_t opaque[24];    // Holds a struct host_semaphore
+} StaticSemaphore_t;
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t *buffer);
+SemaphoreHandle_t xSemaphoreCreateBinary(void);
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max_count, UBaseType_t initial_count);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticks_to_wait);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore);
+void vSemaphoreDelete(SemaphoreHandle_t semaphore);
+
+#endif // HOST_SEMPHR_H
@@ -0,0 +1,1397 @@
+/**
+ * Host stand-ins for the ESP-IDF APIs used by the tested modules
+ */
+
+#define _GNU_SOURCE     // Recursive mutex initializer
+#include "host_idf.h"
+#include "esp_crt_bundle.h"
+#include "esp_err.h"
+#include "esp_http_client.h"
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_partition.h"
+#include "esp_pm.h"
+#include "esp_rom_crc.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "mbedtls/md.h"
+#include "mbedtls/sha1.h"
+#include "mbedtls/sha256.h"
+#include "mqtt_client.h"
+#include "nvs.h"
+#include <errno.h>
+#include <netdb.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+/* esp_err / esp_log */
+
+const char* esp_err_to_name(esp_err_t code)
+{
+    static __thread char name[24];
+    snprintf(name, sizeof(name), code == ESP_OK ? "ESP_OK" : "ESP_ERR_0x%x", code);
+    return name;
+}
+
+void host_log(char level, const char *tag, const char *format, ...)
+{
+    static int verbose = -1;
+    if (verbose < 0) {
+        verbose = getenv("HOST_TEST_VERBOSE") != NULL;
+    }
+    if (!verbose) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    fprintf(stderr, "%c (%s) ", level, tag);
+    vfprintf(stderr, format, args);
+    fputc('\n', stderr);
+    va_end(args);
+}
+
+/* Critical sections */
+
+static pthread_mutex_t critical_lock = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+
+void host_critical_enter(void)
+{
+    pthread_mutex_lock(&critical_lock);
+}
+
+void host_critical_exit(void)
+{
+    pthread_mutex_unlock(&critical_lock);
+}
+
+/* NVS: one flat table of namespace/key pairs */
+
+#define HOST_NVS_MAX_KEYS   64
+#define HOST_NVS_MAX_NS     8
+
+typedef struct {
+    bool used;
+    char ns[16];
+    char key[16];
+    uint8_t *value;
+    size_t len;
+} nvs_item_t;
+
+static nvs_item_t nvs_items[HOST_NVS_MAX_KEYS];
+static char nvs_namespaces[HOST_NVS_MAX_NS][16];
+static uint32_t nvs_writes = 0;
+static int nvs_writes_left = -1;
+static pthread_mutex_t nvs_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void host_nvs_reset(void)
+{
+    pthread_mutex_lock(&nvs_lock);
+    for (int i = 0; i < HOST_NVS_MAX_KEYS; i++) {
+        free(nvs_items[i].value);
+    }
+    memset(nvs_items, 0, sizeof(nvs_items));
+    memset(nvs_namespaces, 0, sizeof(nvs_namespaces));
+    nvs_writes = 0;
+    nvs_writes_left = -1;
+    pthread_mutex_unlock(&nvs_lock);
+}
+
+uint32_t host_nvs_write_count(void)
+{
+    return nvs_writes;
+}
+
+void host_nvs_fail_after(int writes)
+{
+    nvs_writes_left = writes;
+}
+
+static nvs_item_t* nvs_find(const char *ns, const char *key)
+{
+    for (int i = 0; i < HOST_NVS_MAX_KEYS; i++) {
+        if (nvs_items[i].used && strcmp(nvs_items[i].ns, ns) == 0 && strcmp(nvs_items[i].key, key) == 0) {
+            return &nvs_items[i];
+        }
+    }
+    return NULL;
+}
+
+bool host_nvs_has_key(const char *ns, const char *key)
+{
+    pthread_mutex_lock(&nvs_lock);
+    bool found = nvs_find(ns, key) != NULL;
+    pthread_mutex_unlock(&nvs_lock);
+    return found;
+}
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    if (!name || strlen(name) > 15) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&nvs_lock);
+    int slot = -1;
+    for (int i = 0; i < HOST_NVS_MAX_NS; i++) {
+        if (strcmp(nvs_namespaces[i], name) == 0) {
+            slot = i;
+            break;
+        }
+        if (slot < 0 && nvs_namespaces[i][0] == '\0' && open_mode == NVS_READWRITE) {
+            slot = i;
+        }
+    }
+    esp_err_t err = ESP_ERR_NVS_NOT_FOUND;
+    if (slot >= 0) {
+        strcpy(nvs_namespaces[slot], name);
+        *out_handle = slot + 1;
+        err = ESP_OK;
+    }
+    pthread_mutex_unlock(&nvs_lock);
+    return err;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    return ESP_OK;
+}
+
+static esp_err_t nvs_store(nvs_handle_t handle, const char *key, const void *value, size_t len)
+{
+    if (handle == 0 || handle > HOST_NVS_MAX_NS || !key || strlen(key) > 15) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&nvs_lock);
+    if (nvs_writes_left == 0) {
+        pthread_mutex_unlock(&nvs_lock);
+        return ESP_FAIL;
+    }
+    const char *ns = nvs_namespaces[handle - 1];
+    nvs_item_t *item = nvs_find(ns, key);
+    for (int i = 0; !item && i < HOST_NVS_MAX_KEYS; i++) {
+        if (!nvs_items[i].used) {
+            item = &nvs_items[i];
+            item->used = true;
+            strcpy(item->ns, ns);
+            strcpy(item->key, key);
+        }
+    }
+    esp_err_t err = ESP_ERR_NO_MEM;
+    if (item) {
+        free(item->value);
+        item->value = malloc(len ? len : 1);
+        memcpy(item->value, value, len);
+        item->len = len;
+        nvs_writes++;
+        if (nvs_writes_left > 0) {
+            nvs_writes_left--;
+        }
+        err = ESP_OK;
+    }
+    pthread_mutex_unlock(&nvs_lock);
+    return err;
+}
+
+static esp_err_t nvs_load(nvs_handle_t handle, const char *key, void *out_value, size_t *length)
+{
+    if (handle == 0 || handle > HOST_NVS_MAX_NS || !key || !length) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&nvs_lock);
+    nvs_item_t *item = nvs_find(nvs_namespaces[handle - 1], key);
+    esp_err_t err = ESP_ERR_NVS_NOT_FOUND;
+    if (item) {
+        err = ESP_OK;
+        if (out_value) {
+            if (*length < item->len) {
+                err = ESP_ERR_NVS_INVALID_LENGTH;
+            } else {
+                memcpy(out_value, item->value, item->len);
+            }
+        }
+        *length = item->len;
+    }
+    pthread_mutex_unlock(&nvs_lock);
+    return err;
+}
+
+esp_err_t nvs_set_str(nvs_handle_t handle, const char *key, const char *value)
+{
+    return nvs_store(handle, key, value, strlen(value) + 1);
+}
+
+esp_err_t nvs_get_str(nvs_handle_t handle, const char *key, char *out_value, size_t *length)
+{
+    return nvs_load(handle, key, out_value, length);
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length)
+{
+    return nvs_store(handle, key, value, length);
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length)
+{
+    return nvs_load(handle, key, out_value, length);
+}
+
+esp_err_t nvs_set_u8(nvs_handle_t handle, const char *key, uint8_t value)
+{
+    return nvs_store(handle, key, &value, sizeof(value));
+}
+
+esp_err_t nvs_get_u8(nvs_handle_t handle, const char *key, uint8_t *out_value)
+{
+    size_t len = sizeof(*out_value);
+    return nvs_load(handle, key, out_value, &len);
+}
+
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char *key, uint32_t value)
+{
+    return nvs_store(handle, key, &value, sizeof(value));
+}
+
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char *key, uint32_t *out_value)
+{
+    size_t len = sizeof(*out_value);
+    return nvs_load(handle, key, out_value, &len);
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key)
+{
+    if (handle == 0 || handle > HOST_NVS_MAX_NS || !key) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&nvs_lock);
+    esp_err_t err = ESP_ERR_NVS_NOT_FOUND;
+    nvs_item_t *item = nvs_find(nvs_namespaces[handle - 1], key);
+    if (item && nvs_writes_left == 0) {
+        err = ESP_FAIL;
+    } else if (item) {
+        free(item->value);
+        memset(item, 0, sizeof(*item));
+        nvs_writes++;
+        if (nvs_writes_left > 0) {
+            nvs_writes_left--;
+        }
+        err = ESP_OK;
+    }
+    pthread_mutex_unlock(&nvs_lock);
+    return err;
+}
+
+/* Semaphores */
+
+struct host_semaphore {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    UBaseType_t count;
+    UBaseType_t max_count;
+    bool is_static;
+};
+
+_Static_assert(sizeof(StaticSemaphore_t) >= sizeof(struct host_semaphore), "StaticSemaphore_t too small");
+
+static SemaphoreHandle_t semaphore_init(struct host_semaphore *sem, UBaseType_t max_count, UBaseType_t initial)
+{
+    pthread_mutex_init(&sem->lock, NULL);
+    pthread_cond_init(&sem->cond, NULL);
+    sem->count = initial;
+    sem->max_count = max_count;
+    return sem;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    return semaphore_init(calloc(1, sizeof(struct host_semaphore)), 1, 1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t *buffer)
+{
+    struct host_semaphore *sem = (struct host_semaphore *)buffer;
+    sem->is_static = true;
+    return semaphore_init(sem, 1, 1);
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+    return semaphore_init(calloc(1, sizeof(struct host_semaphore)), 1, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max_count, UBaseType_t initial_count)
+{
+    return semaphore_init(calloc(1, sizeof(struct host_semaphore)), max_count, initial_count);
+}
+
+/**
+ * Real-clock deadline ticks (milliseconds) from now
+ */
+static struct timespec deadline_after(TickType_t ticks)
+{
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    if (ticks != portMAX_DELAY) {
+        deadline.tv_sec += ticks / 1000;
+        deadline.tv_nsec += (long)(ticks % 1000) * 1000000;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+    }
+    return deadline;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks_to_wait)
+{
+    struct timespec deadline = deadline_after(ticks_to_wait);
+
+    pthread_mutex_lock(&sem->lock);
+    while (sem->count == 0) {
+        if (ticks_to_wait == portMAX_DELAY) {
+            pthread_cond_wait(&sem->cond, &sem->lock);
+        } else if (pthread_cond_timedwait(&sem->cond, &sem->lock, &deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+    BaseType_t taken = pdFALSE;
+    if (sem->count > 0) {
+        sem->count--;
+        taken = pdTRUE;
+    }
+    pthread_mutex_unlock(&sem->lock);
+    return taken;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    pthread_mutex_lock(&sem->lock);
+    BaseType_t given = pdFALSE;
+    if (sem->count < sem->max_count) {
+        sem->count++;
+        given = pdTRUE;
+        pthread_cond_signal(&sem->cond);
+    }
+    pthread_mutex_unlock(&sem->lock);
+    return given;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t sem)
+{
+    pthread_mutex_destroy(&sem->lock);
+    pthread_cond_destroy(&sem->cond);
+    if (!sem->is_static) {
+        free(sem);
+    }
+}
+
+/* Tasks: detached pthreads with a notification count each */
+
+struct host_task {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t notify_count;
+    TaskFunction_t function;
+    void *arg;
+    struct host_task *next;
+};
+
+static struct host_task *tasks = NULL;        // Never freed, so LSan sees them as reachable
+static __thread struct host_task *current_task = NULL;
+
+static struct host_task* task_alloc(void)
+{
+    struct host_task *task = calloc(1, sizeof(*task));
+    pthread_mutex_init(&task->lock, NULL);
+    pthread_cond_init(&task->cond, NULL);
+    host_critical_enter();
+    task->next = tasks;
+    tasks = task;
+    host_critical_exit();
+    return task;
+}
+
+static void* task_main(void *arg)
+{
+    current_task = arg;
+    current_task->function(current_task->arg);
+    return NULL;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t function, const char *name, uint32_t stack_depth, void *arg,
+                       UBaseType_t priority, TaskHandle_t *out_handle)
+{
+    struct host_task *task = task_alloc();
+    task->function = function;
+    task->arg = arg;
+    if (out_handle) {
+        *out_handle = task;
+    }
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, task_main, task) != 0) {
+        return pdFAIL;
+    }
+    pthread_detach(thread);
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    // Only a task deleting itself is supported
+    if (task == NULL || task == current_task) {
+        pthread_exit(NULL);
+    }
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    usleep((useconds_t)ticks * 1000);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    if (!current_task) {
+        current_task = task_alloc();      // A test thread waiting for notifications
+    }
+    return current_task;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    pthread_mutex_lock(&task->lock);
+    task->notify_count++;
+    pthread_cond_signal(&task->cond);
+    pthread_mutex_unlock(&task->lock);
+    return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks_to_wait)
+{
+    struct host_task *task = xTaskGetCurrentTaskHandle();
+    struct timespec deadline = deadline_after(ticks_to_wait);
+
+    pthread_mutex_lock(&task->lock);
+    while (task->notify_count == 0) {
+        if (ticks_to_wait == portMAX_DELAY) {
+            pthread_cond_wait(&task->cond, &task->lock);
+        } else if (pthread_cond_timedwait(&task->cond, &task->lock, &deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+    uint32_t count = task->notify_count;
+    if (count > 0) {
+        task->notify_count = clear_on_exit ? 0 : count - 1;
+    }
+    pthread_mutex_unlock(&task->lock);
+    return count;
+}
+
+/* esp_timer on simulated time */
+
+struct esp_timer {
+    esp_timer_create_args_t args;
+    bool active;
+    int64_t due_us;
+    uint64_t period_us;
+    struct esp_timer *next;
+};
+
+static int64_t now_us = 1000000;
+static struct esp_timer *timers = NULL;
+
+int64_t esp_timer_get_time(void)
+{
+    return __atomic_load_n(&now_us, __ATOMIC_SEQ_CST);
+}
+
+int64_t host_time_us(void)
+{
+    return esp_timer_get_time();
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *create_args, esp_timer_handle_t *out_handle)
+{
+    struct esp_timer *timer = calloc(1, sizeof(*timer));
+    if (!timer) {
+        return ESP_ERR_NO_MEM;
+    }
+    timer->args = *create_args;
+    host_critical_enter();
+    timer->next = timers;
+    timers = timer;
+    host_critical_exit();
+    *out_handle = timer;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    host_critical_enter();
+    esp_err_t err = timer->active ? ESP_ERR_INVALID_STATE : ESP_OK;
+    if (err == ESP_OK) {
+        timer->active = true;
+        timer->due_us = esp_timer_get_time() + (int64_t)timeout_us;
+        timer->period_us = 0;
+    }
+    host_critical_exit();
+    return err;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us)
+{
+    host_critical_enter();
+    esp_err_t err = timer->active ? ESP_ERR_INVALID_STATE : ESP_OK;
+    if (err == ESP_OK) {
+        timer->active = true;
+        timer->due_us = esp_timer_get_time() + (int64_t)period_us;
+        timer->period_us = period_us;
+    }
+    host_critical_exit();
+    return err;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    host_critical_enter();
+    esp_err_t err = timer->active ? ESP_OK : ESP_ERR_INVALID_STATE;
+    timer->active = false;
+    host_critical_exit();
+    return err;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+    host_critical_enter();
+    for (struct esp_timer **p = &timers; *p; p = &(*p)->next) {
+        if (*p == timer) {
+            *p = timer->next;
+            break;
+        }
+    }
+    host_critical_exit();
+    free(timer);
+    return ESP_OK;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t timer)
+{
+    return timer->active;
+}
+
+void host_time_advance_us(int64_t us)
+{
+    int64_t target = esp_timer_get_time() + us;
+    for (;;) {
+        // Earliest due timer up to the target
+        host_critical_enter();
+        struct esp_timer *due = NULL;
+        for (struct esp_timer *t = timers; t; t = t->next) {
+            if (t->active && t->due_us <= target && (!due || t->due_us < due->due_us)) {
+                due = t;
+            }
+        }
+        if (due) {
+            __atomic_store_n(&now_us, due->due_us, __ATOMIC_SEQ_CST);
+            if (due->period_us) {
+                due->due_us += (int64_t)due->period_us;
+            } else {
+                due->active = false;
+            }
+        }
+        host_critical_exit();
+        if (!due) {
+            break;
+        }
+        due->args.callback(due->args.arg);
+    }
+    __atomic_store_n(&now_us, target, __ATOMIC_SEQ_CST);
+}
+
+/* esp_http_client: plain HTTP, one request per connection */
+
+struct esp_http_client {
+    char host[64];
+    char port[8];
+    char path[256];
+    esp_http_client_method_t method;
+    char headers[1024];
+    const char *body;
+    int body_len;
+    int status;
+};
+
+esp_http_client_handle_t esp_http_client_init(const esp_http_client_config_t *config)
+{
+    struct esp_http_client *client = calloc(1, sizeof(*client));
+    if (!client) {
+        return NULL;
+    }
+    int port = 80;
+    if (sscanf(config->url, "http://%63[^:/]:%d%255s", client->host, &port, client->path) != 3 &&
+        sscanf(config->url, "http://%63[^:/]%255s", client->host, client->path) != 2) {
+        free(client);
+        return NULL;
+    }
+    snprintf(client->port, sizeof(client->port), "%d", port);
+    client->method = config->method;
+    if (config->user_agent) {
+        esp_http_client_set_header(client, "User-Agent", config->user_agent);
+    }
+    return client;
+}
+
+esp_err_t esp_http_client_set_header(esp_http_client_handle_t client, const char *key, const char *value)
+{
+    size_t used = strlen(client->headers);
+    int written = snprintf(client->headers + used, sizeof(client->headers) - used, "%s: %s\r\n", key, value);
+    return (written < 0 || (size_t)written >= sizeof(client->headers) - used) ? ESP_ERR_NO_MEM : ESP_OK;
+}
+
+esp_err_t esp_http_client_set_post_field(esp_http_client_handle_t client, const char *data, int len)
+{
+    client->body = data;
+    client->body_len = len;
+    return ESP_OK;
+}
+
+static bool send_all(int fd, const char *data, size_t len)
+{
+    while (len > 0) {
+        ssize_t sent = send(fd, data, len, MSG_NOSIGNAL);
+        if (sent <= 0) {
+            return false;
+        }
+        data += sent;
+        len -= sent;
+    }
+    return true;
+}
+
+esp_err_t esp_http_client_perform(esp_http_client_handle_t client)
+{
+    struct addrinfo hints = { .ai_socktype = SOCK_STREAM };
+    struct addrinfo *addr = NULL;
+    if (getaddrinfo(client->host, client->port, &hints, &addr) != 0) {
+        return ESP_ERR_HTTP_CONNECT;
+    }
+    int fd = socket(addr->ai_family, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, addr->ai_addr, addr->ai_addrlen) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        freeaddrinfo(addr);
+        return ESP_ERR_HTTP_CONNECT;
+    }
+    freeaddrinfo(addr);
+
+    struct timeval timeout = { .tv_sec = 5 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    char request[1536];
+    int len = snprintf(request, sizeof(request),
+                       "%s %s HTTP/1.1\r\nHost: %s\r\n%sContent-Length: %d\r\nConnection: close\r\n\r\n",
+                       client->method == HTTP_METHOD_POST ? "POST" : "GET", client->path, client->host,
+                       client->headers, client->body ? client->body_len : 0);
+    bool ok = len > 0 && (size_t)len < sizeof(request) && send_all(fd, request, len) &&
+              (!client->body || send_all(fd, client->body, client->body_len));
+
+    // Only the status line matters; drain the rest until the server closes
+    char response[512];
+    size_t received = 0;
+    ssize_t n;
+    while (ok && (n = recv(fd, response + received, sizeof(response) - 1 - received, 0)) > 0) {
+        received += n;
+        if (received == sizeof(response) - 1) {
+            break;
+        }
+    }
+    response[received] = '\0';
+    char discard[512];
+    while (ok && recv(fd, discard, sizeof(discard), 0) > 0) {
+    }
+    close(fd);
+
+    if (!ok || sscanf(response, "HTTP/1.%*d %d", &client->status) != 1) {
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+int esp_http_client_get_status_code(esp_http_client_handle_t client)
+{
+    return client->status;
+}
+
+esp_err_t esp_http_client_cleanup(esp_http_client_handle_t client)
+{
+    free(client);
+    return ESP_OK;
+}
+
+esp_err_t esp_crt_bundle_attach(void *conf)
+{
+    return ESP_OK;
+}
+
+/* Flash partitions: RAM buffers, written like NOR flash */
+
+#define HOST_PARTITIONS     4
+#define FLASH_SECTOR_SIZE   4096
+
+static struct {
+    esp_partition_t partition;
+    uint8_t *data;
+} partitions[HOST_PARTITIONS];
+
+void host_partition_set(const char *label, uint8_t *data, uint32_t size)
+{
+    int free_slot = -1;
+    for (int i = 0; i < HOST_PARTITIONS; i++) {
+        if (partitions[i].data && strcmp(partitions[i].partition.label, label) == 0) {
+            partitions[i].data = NULL;
+        }
+        if (!partitions[i].data && free_slot < 0) {
+            free_slot = i;
+        }
+    }
+    if (!data || free_slot < 0) {
+        return;
+    }
+    esp_partition_t *p = &partitions[free_slot].partition;
+    memset(p, 0, sizeof(*p));
+    p->type = ESP_PARTITION_TYPE_DATA;
+    p->subtype = ESP_PARTITION_SUBTYPE_ANY;
+    p->address = 0x400000 + free_slot * 0x200000;
+    p->size = size;
+    p->erase_size = FLASH_SECTOR_SIZE;
+    snprintf(p->label, sizeof(p->label), "%s", label);
+    partitions[free_slot].data = data;
+}
+
+static uint8_t* partition_data(const esp_partition_t *partition, size_t offset, size_t size)
+{
+    for (int i = 0; i < HOST_PARTITIONS; i++) {
+        if (partitions[i].data && &partitions[i].partition == partition) {
+            return offset <= partition->size && size <= partition->size - offset ? partitions[i].data + offset : NULL;
+        }
+    }
+    return NULL;
+}
+
+const esp_partition_t* esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype,
+                                                const char *label)
+{
+    for (int i = 0; i < HOST_PARTITIONS; i++) {
+        if (partitions[i].data && (!label || strcmp(partitions[i].partition.label, label) == 0)) {
+            return &partitions[i].partition;
+        }
+    }
+    return NULL;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size)
+{
+    uint8_t *data = partition_data(partition, src_offset, size);
+    if (!data) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(dst, data, size);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t dst_offset, const void *src, size_t size)
+{
+    uint8_t *data = partition_data(partition, dst_offset, size);
+    if (!data) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    const uint8_t *bytes = src;
+    for (size_t i = 0; i < size; i++) {
+        data[i] &= bytes[i];    // Programming only clears bits
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size)
+{
+    uint8_t *data = partition_data(partition, offset, size);
+    if (!data) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (offset % FLASH_SECTOR_SIZE || size % FLASH_SECTOR_SIZE) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    memset(data, 0xff, size);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_mmap(const esp_partition_t *partition, size_t offset, size_t size,
+                             esp_partition_mmap_memory_t memory, const void **out_ptr,
+                             esp_partition_mmap_handle_t *out_handle)
+{
+    uint8_t *data = partition_data(partition, offset, size);
+    if (!data) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    *out_ptr = data;
+    *out_handle = 1;
+    return ESP_OK;
+}
+
+void esp_partition_munmap(esp_partition_mmap_handle_t handle)
+{
+}
+
+uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t *buf, uint32_t len)
+{
+    crc = ~crc;
+    for (uint32_t i = 0; i < len; i++) {
+        crc ^= buf[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320u & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+/* Device: MAC, heap, Wi-Fi station and its power save mode */
+
+esp_err_t esp_read_mac(uint8_t *mac, esp_mac_type_t type)
+{
+    static const uint8_t host_mac[6] = HOST_MAC;
+    memcpy(mac, host_mac, sizeof(host_mac));
+    return ESP_OK;
+}
+
+uint32_t esp_get_free_heap_size(void)
+{
+    return HOST_FREE_HEAP;
+}
+
+esp_err_t esp_wifi_sta_get_ap_info(wifi_ap_record_t *ap_info)
+{
+    memset(ap_info, 0, sizeof(*ap_info));
+    ap_info->rssi = HOST_WIFI_RSSI;
+    return ESP_OK;
+}
+
+static int wifi_ps = WIFI_PS_MIN_MODEM;
+
+esp_err_t esp_wifi_set_ps(wifi_ps_type_t type)
+{
+    wifi_ps = type;
+    return ESP_OK;
+}
+
+int host_wifi_ps(void)
+{
+    return wifi_ps;
+}
+
+/* Power management: locks are counters, the clock never changes */
+
+#define PM_MAX_LOCKS    8
+
+struct esp_pm_lock {
+    int count;
+};
+
+static struct esp_pm_lock pm_locks[PM_MAX_LOCKS];
+static int pm_lock_count = 0;
+
+esp_err_t esp_pm_configure(const void *config)
+{
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_create(esp_pm_lock_type_t lock_type, int arg, const char *name, esp_pm_lock_handle_t *out_handle)
+{
+    if (pm_lock_count == PM_MAX_LOCKS) {
+        return ESP_ERR_NO_MEM;
+    }
+    *out_handle = &pm_locks[pm_lock_count++];
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_acquire(esp_pm_lock_handle_t handle)
+{
+    host_critical_enter();
+    handle->count++;
+    host_critical_exit();
+    return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_release(esp_pm_lock_handle_t handle)
+{
+    host_critical_enter();
+    esp_err_t err = ESP_ERR_INVALID_STATE;
+    if (handle->count > 0) {
+        handle->count--;
+        err = ESP_OK;
+    }
+    host_critical_exit();
+    return err;
+}
+
+esp_err_t esp_pm_dump_locks(FILE *stream)
+{
+    return ESP_OK;
+}
+
+int host_pm_lock_count(void)
+{
+    return pm_lock_count;
+}
+
+int host_pm_locks_held(void)
+{
+    int total = 0;
+    host_critical_enter();
+    for (int i = 0; i < pm_lock_count; i++) {
+        total += pm_locks[i].count;
+    }
+    host_critical_exit();
+    return total;
+}
+
+/* esp-mqtt: records what the client is given, events come from the test */
+
+#define MQTT_MAX_MESSAGES       256
+#define MQTT_MAX_SUBSCRIPTIONS  8
+
+struct esp_mqtt_client {
+    host_mqtt_session_t session;
+    esp_event_handler_t handler;
+    void *handler_arg;
+    bool started;
+    char subscriptions[MQTT_MAX_SUBSCRIPTIONS][128];
+    int subscription_count;
+    int next_msg_id;
+};
+
+static struct esp_mqtt_client *mqtt_running = NULL;
+static int mqtt_created = 0;
+static host_mqtt_message_t mqtt_messages[MQTT_MAX_MESSAGES];
+static int mqtt_message_count = 0;
+
+static void copy_str(char *dest, size_t size, const char *src)
+{
+    snprintf(dest, size, "%s", src ? src : "");
+}
+
+esp_mqtt_client_handle_t esp_mqtt_client_init(const esp_mqtt_client_config_t *config)
+{
+    struct esp_mqtt_client *client = calloc(1, sizeof(*client));
+    if (!client) {
+        return NULL;
+    }
+    host_mqtt_session_t *s = &client->session;
+    copy_str(s->uri, sizeof(s->uri), config->broker.address.uri);
+    copy_str(s->client_id, sizeof(s->client_id), config->credentials.client_id);
+    copy_str(s->username, sizeof(s->username), config->credentials.username);
+    copy_str(s->password, sizeof(s->password), config->credentials.authentication.password);
+    copy_str(s->will_topic, sizeof(s->will_topic), config->session.last_will.topic);
+    copy_str(s->will_msg, sizeof(s->will_msg), config->session.last_will.msg);
+    s->will_qos = config->session.last_will.qos;
+    s->will_retain = config->session.last_will.retain != 0;
+    s->keepalive = config->session.keepalive;
+    client->next_msg_id = 1;
+    mqtt_created++;
+    return client;
+}
+
+esp_err_t esp_mqtt_client_register_event(esp_mqtt_client_handle_t client, esp_mqtt_event_id_t event,
+                                         esp_event_handler_t event_handler, void *event_handler_arg)
+{
+    client->handler = event_handler;
+    client->handler_arg = event_handler_arg;
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t client)
+{
+    if (client->started) {
+        return ESP_FAIL;
+    }
+    client->started = true;
+    mqtt_running = client;
+    return ESP_OK;
+}
+
+esp_err_t esp_mqtt_client_destroy(esp_mqtt_client_handle_t client)
+{
+    if (mqtt_running == client) {
+        mqtt_running = NULL;
+    }
+    free(client);
+    return ESP_OK;
+}
+
+int esp_mqtt_client_subscribe(esp_mqtt_client_handle_t client, const char *topic, int qos)
+{
+    if (client->subscription_count == MQTT_MAX_SUBSCRIPTIONS) {
+        return -1;
+    }
+    copy_str(client->subscriptions[client->subscription_count++], sizeof(client->subscriptions[0]), topic);
+    return client->next_msg_id++;
+}
+
+int esp_mqtt_client_enqueue(esp_mqtt_client_handle_t client, const char *topic, const char *data, int len,
+                            int qos, int retain, bool store)
+{
+    if (!client || mqtt_message_count == MQTT_MAX_MESSAGES) {
+        return -1;
+    }
+    host_mqtt_message_t *m = &mqtt_messages[mqtt_message_count++];
+    copy_str(m->topic, sizeof(m->topic), topic);
+    if (len <= 0) {
+        len = strlen(data);
+    }
+    snprintf(m->payload, sizeof(m->payload), "%.*s", len, data);
+    m->qos = qos;
+    m->retain = retain != 0;
+    return client->next_msg_id++;
+}
+
+const host_mqtt_session_t* host_mqtt_session(void)
+{
+    return mqtt_running ? &mqtt_running->session : NULL;
+}
+
+int host_mqtt_clients_created(void)
+{
+    return mqtt_created;
+}
+
+static void mqtt_dispatch(esp_mqtt_event_t *event)
+{
+    if (mqtt_running && mqtt_running->handler) {
+        event->client = mqtt_running;
+        mqtt_running->handler(mqtt_running->handler_arg, "MQTT_EVENTS", event->event_id, event);
+    }
+}
+
+void host_mqtt_connect(void)
+{
+    esp_mqtt_event_t event = { .event_id = MQTT_EVENT_CONNECTED };
+    if (mqtt_running) {
+        mqtt_running->subscription_count = 0;   // Clean session
+    }
+    mqtt_dispatch(&event);
+}
+
+void host_mqtt_disconnect(void)
+{
+    esp_mqtt_event_t event = { .event_id = MQTT_EVENT_DISCONNECTED };
+    mqtt_dispatch(&event);
+}
+
+void host_mqtt_deliver(const char *topic, const char *payload)
+{
+    esp_mqtt_event_t event = {
+        .event_id = MQTT_EVENT_DATA,
+        .topic = (char *)topic,
+        .topic_len = strlen(topic),
+        .data = (char *)payload,
+        .data_len = strlen(payload),
+        .total_data_len = strlen(payload),
+    };
+    mqtt_dispatch(&event);
+}
+
+int host_mqtt_message_count(void)
+{
+    return mqtt_message_count;
+}
+
+const host_mqtt_message_t* host_mqtt_message(int index)
+{
+    return index >= 0 && index < mqtt_message_count ? &mqtt_messages[index] : NULL;
+}
+
+void host_mqtt_clear(void)
+{
+    mqtt_message_count = 0;
+}
+
+const host_mqtt_message_t* host_mqtt_last(const char *topic)
+{
+    for (int i = mqtt_message_count - 1; i >= 0; i--) {
+        if (strcmp(mqtt_messages[i].topic, topic) == 0) {
+            return &mqtt_messages[i];
+        }
+    }
+    return NULL;
+}
+
+int host_mqtt_count(const char *topic)
+{
+    int count = 0;
+    for (int i = 0; i < mqtt_message_count; i++) {
+        count += strcmp(mqtt_messages[i].topic, topic) == 0;
+    }
+    return count;
+}
+
+bool host_mqtt_subscribed(const char *topic)
+{
+    for (int i = 0; mqtt_running && i < mqtt_running->subscription_count; i++) {
+        if (strcmp(mqtt_running->subscriptions[i], topic) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* SHA-1 (FIPS 180-4) */
+
+static uint32_t rol32(uint32_t value, int bits)
+{
+    return (value << bits) | (value >> (32 - bits));
+}
+
+static void sha1_block(uint32_t state[5], const uint8_t block[64])
+{
+    uint32_t w[80];
+    for (int i = 0; i < 16; i++) {
+        w[i] = (uint32_t)block[i * 4] << 24 | (uint32_t)block[i * 4 + 1] << 16 |
+               (uint32_t)block[i * 4 + 2] << 8 | block[i * 4 + 3];
+    }
+    for (int i = 16; i < 80; i++) {
+        w[i] = rol32(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+    for (int i = 0; i < 80; i++) {
+        uint32_t f, k;
+        if (i < 20) {
+            f = (b & c) | (~b & d);
+            k = 0x5A827999;
+        } else if (i < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ED9EBA1;
+        } else if (i < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8F1BBCDC;
+        } else {
+            f = b ^ c ^ d;
+            k = 0xCA62C1D6;
+        }
+        uint32_t temp = rol32(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = rol32(b, 30);
+        b = a;
+        a = temp;
+    }
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+}
+
+int mbedtls_sha1(const unsigned char *input, size_t ilen, unsigned char output[20])
+{
+    uint32_t state[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+    uint8_t block[64];
+    size_t done = 0;
+
+    for (; ilen - done >= 64; done += 64) {
+        sha1_block(state, input + done);
+    }
+    size_t rest = ilen - done;
+    memset(block, 0, sizeof(block));
+    memcpy(block, input + done, rest);
+    block[rest] = 0x80;
+    if (rest >= 56) {
+        sha1_block(state, block);
+        memset(block, 0, sizeof(block));
+    }
+    uint64_t bits = (uint64_t)ilen * 8;
+    for (int i = 0; i < 8; i++) {
+        block[63 - i] = (uint8_t)(bits >> (i * 8));
+    }
+    sha1_block(state, block);
+
+    for (int i = 0; i < 5; i++) {
+        output[i * 4] = state[i] >> 24;
+        output[i * 4 + 1] = state[i] >> 16;
+        output[i * 4 + 2] = state[i] >> 8;
+        output[i * 4 + 3] = state[i];
+    }
+    return 0;
+}
+
+/* SHA-256 (FIPS 180-4) and HMAC (RFC 2104) */
+
+static const uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static uint32_t ror32(uint32_t value, int bits)
+{
+    return (value >> bits) | (value << (32 - bits));
+}
+
+typedef struct {
+    uint32_t state[8];
+    uint8_t block[64];
+    size_t used;
+    uint64_t total;
+} sha256_ctx_t;
+
+static void sha256_block(uint32_t state[8], const uint8_t block[64])
+{
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++) {
+        w[i] = (uint32_t)block[i * 4] << 24 | (uint32_t)block[i * 4 + 1] << 16 |
+               (uint32_t)block[i * 4 + 2] << 8 | block[i * 4 + 3];
+    }
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = ror32(w[i - 15], 7) ^ ror32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = ror32(w[i - 2], 17) ^ ror32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t v[8];
+    memcpy(v, state, sizeof(v));
+    for (int i = 0; i < 64; i++) {
+        uint32_t s1 = ror32(v[4], 6) ^ ror32(v[4], 11) ^ ror32(v[4], 25);
+        uint32_t ch = (v[4] & v[5]) ^ (~v[4] & v[6]);
+        uint32_t t1 = v[7] + s1 + ch + sha256_k[i] + w[i];
+        uint32_t s0 = ror32(v[0], 2) ^ ror32(v[0], 13) ^ ror32(v[0], 22);
+        uint32_t maj = (v[0] & v[1]) ^ (v[0] & v[2]) ^ (v[1] & v[2]);
+        memmove(v + 1, v, 7 * sizeof(v[0]));
+        v[4] += t1;
+        v[0] = t1 + s0 + maj;
+    }
+    for (int i = 0; i < 8; i++) {
+        state[i] += v[i];
+    }
+}
+
+static void sha256_init(sha256_ctx_t *ctx)
+{
+    static const uint32_t initial[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+    };
+    memcpy(ctx->state, initial, sizeof(initial));
+    ctx->used = 0;
+    ctx->total = 0;
+}
+
+static void sha256_update(sha256_ctx_t *ctx, const uint8_t *data, size_t len)
+{
+    ctx->total += len;
+    while (len > 0) {
+        size_t take = 64 - ctx->used < len ? 64 - ctx->used : len;
+        memcpy(ctx->block + ctx->used, data, take);
+        ctx->used += take;
+        data += take;
+        len -= take;
+        if (ctx->used == 64) {
+            sha256_block(ctx->state, ctx->block);
+            ctx->used = 0;
+        }
+    }
+}
+
+static void sha256_finish(sha256_ctx_t *ctx, uint8_t output[32])
+{
+    uint64_t bits = ctx->total * 8;
+    uint8_t pad = 0x80;
+    sha256_update(ctx, &pad, 1);
+    pad = 0;
+    while (ctx->used != 56) {
+        sha256_update(ctx, &pad, 1);
+    }
+    uint8_t length[8];
+    for (int i = 0; i < 8; i++) {
+        length[i] = (uint8_t)(bits >> (56 - i * 8));
+    }
+    sha256_update(ctx, length, 8);
+    for (int i = 0; i < 8; i++) {
+        output[i * 4] = ctx->state[i] >> 24;
+        output[i * 4 + 1] = ctx->state[i] >> 16;
+        output[i * 4 + 2] = ctx->state[i] >> 8;
+        output[i * 4 + 3] = ctx->state[i];
+    }
+}
+
+int mbedtls_sha256(const unsigned char *input, size_t ilen, unsigned char *output, int is224)
+{
+    if (is224) {
+        return -1;
+    }
+    sha256_ctx_t ctx;
+    sha256_init(&ctx);
+    sha256_update(&ctx, input, ilen);
+    sha256_finish(&ctx, output);
+    return 0;
+}
+
+struct mbedtls_md_info_t {
+    mbedtls_md_type_t type;
+};
+
+static const mbedtls_md_info_t sha256_info = { MBEDTLS_MD_SHA256 };
+
+const mbedtls_md_info_t* mbedtls_md_info_from_type(mbedtls_md_type_t md_type)
+{
+    return md_type == MBEDTLS_MD_SHA256 ? &sha256_info : NULL;
+}
+
+int mbedtls_md_hmac(const mbedtls_md_info_t *md_info, const unsigned char *key, size_t keylen,
+                    const unsigned char *input, size_t ilen, unsigned char *output)
+{
+    if (md_info != &sha256_info) {
+        return -1;
+    }
+    uint8_t block_key[64] = {0};
+    if (keylen > sizeof(block_key)) {
+        mbedtls_sha256(key, keylen, block_key, 0);
+    } else {
+        memcpy(block_key, key, keylen);
+    }
+
+    uint8_t pad[64];
+    uint8_t inner[32];
+    sha256_ctx_t ctx;
+    for (int i = 0; i < 64; i++) {
+        pad[i] = block_key[i] ^ 0x36;
+    }
+    sha256_init(&ctx);
+    sha256_update(&ctx, pad, sizeof(pad));
+    sha256_update(&ctx, input, ilen);
+    sha256_finish(&ctx, inner);
+
+    for (int i = 0; i < 64; i++) {
+        pad[i] = block_key[i] ^ 0x5c;
+    }
+    sha256_init(&ctx);
+    sha256_update(&ctx, pad, sizeof(pad));
+    sha256_update(&ctx, inner, sizeof(inner));
+    sha256_finish(&ctx, output);
+    return 0;
+}
@@ -0,0 +1,140 @@
+/**
+ * Controls for the host ESP-IDF stand-ins (test side only)
+ */
+
+#ifndef HOST_IDF_H
+#define HOST_IDF_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Forget every stored NVS value and reset the counters
+ */
+void host_nvs_reset(void);
+
+/**
+ * Number of nvs_set_* / nvs_erase_key calls that changed the store
+ */
+uint32_t host_nvs_write_count(void);
+
+/**
+ * Simulate power loss: after this many more successful writes every
+ * write fails (negative: never)
+ */
+void host_nvs_fail_after(int writes);
+
+/**
+ * Check whether a key is stored
+ */
+bool host_nvs_has_key(const char *ns, const char *key);
+
+/**
+ * Current simulated time (esp_timer_get_time)
+ */
+int64_t host_time_us(void);
+
+/**
+ * Move simulated time forward, firing due esp_timer callbacks in order
+ */
+void host_time_advance_us(int64_t us);
+
+/**
+ * Power locks currently held (host_power.c)
+ */
+int host_power_locks_held(void);
+
+/**
+ * esp_pm locks created, and acquires not yet released over all of them
+ */
+int host_pm_lock_count(void);
+int host_pm_locks_held(void);
+
+/**
+ * Last mode given to esp_wifi_set_ps (a wifi_ps_type_t; starts at
+ * WIFI_PS_MIN_MODEM, the driver default)
+ */
+int host_wifi_ps(void);
+
+/**
+ * Back the flash partition with this label by a RAM buffer, used in
+ * place (data NULL removes the partition)
+ */
+void host_partition_set(const char *label, uint8_t *data, uint32_t size);
+
+// Fixed device values reported by the stand-ins
+#define HOST_MAC            { 0x24, 0x0a, 0xc4, 0xa1, 0xb2, 0xc3 }
+#define HOST_WIFI_RSSI      -61
+#define HOST_FREE_HEAP      123456
+#define HOST_CURRENT_MA     42
+
+/**
+ * A message handed to the esp-mqtt stand-in
+ */
+typedef struct {
+    char topic[128];
+    char payload[1024];
+    int qos;
+    bool retain;
+} host_mqtt_message_t;
+
+/**
+ * Configuration of the running MQTT client (copied at init)
+ */
+typedef struct {
+    char uri[128];
+    char client_id[32];
+    char username[64];          // "" when not set
+    char password[64];          // "" when not set
+    char will_topic[128];
+    char will_msg[32];
+    int will_qos;
+    bool will_retain;
+    int keepalive;
+} host_mqtt_session_t;
+
+/**
+ * Session of the running client, NULL if none (started and not destroyed)
+ */
+const host_mqtt_session_t* host_mqtt_session(void);
+
+/**
+ * Number of clients created so far
+ */
+int host_mqtt_clients_created(void);
+
+/**
+ * Deliver a CONNECTED / DISCONNECTED event to the running client
+ */
+void host_mqtt_connect(void);
+void host_mqtt_disconnect(void);
+
+/**
+ * Deliver a message on a topic to the running client
+ */
+void host_mqtt_deliver(const char *topic, const char *payload);
+
+/**
+ * Messages enqueued since the last host_mqtt_clear, oldest first
+ */
+int host_mqtt_message_count(void);
+const host_mqtt_message_t* host_mqtt_message(int index);
+void host_mqtt_clear(void);
+
+/**
+ * Newest message enqueued on topic since the last host_mqtt_clear, or NULL
+ */
+const host_mqtt_message_t* host_mqtt_last(const char *topic);
+
+/**
+ * Messages enqueued on topic since the last host_mqtt_clear
+ */
+int host_mqtt_count(const char *topic);
+
+/**
+ * Check whether the running client subscribed to a topic filter
+ */
+bool host_mqtt_subscribed(const char *topic);
+
+#endif // HOST_IDF_H
@@ -0,0 +1,38 @@
+/**
+ * Host stand-in for power.c: locks are counted, the statistics are fixed
+ */
+
+#include "power.h"
+#include "host_idf.h"
+#include <string.h>
+
+static int held[POWER_LOCK_COUNT];
+
+void power_lock_acquire(power_lock_t lock)
+{
+    if (lock < POWER_LOCK_COUNT) {
+        __atomic_add_fetch(&held[lock], 1, __ATOMIC_SEQ_CST);
+    }
+}
+
+void power_lock_release(power_lock_t lock)
+{
+    if (lock < POWER_LOCK_COUNT) {
+        __atomic_sub_fetch(&held[lock], 1, __ATOMIC_SEQ_CST);
+    }
+}
+
+int host_power_locks_held(void)
+{
+    int total = 0;
+    for (int i = 0; i < POWER_LOCK_COUNT; i++) {
+        total += __atomic_load_n(&held[i], __ATOMIC_SEQ_CST);
+    }
+    return total;
+}
+
+void power_get_stats(power_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+    stats->avg_current_ma = HOST_CURRENT_MA;
+}
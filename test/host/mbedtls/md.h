@@ -0,0 +1,22 @@
+/**
+ * Host stand-in for mbedtls/md.h (one-shot HMAC-SHA256 only)
+ */
+
+#ifndef HOST_MBEDTLS_MD_H
+#define HOST_MBEDTLS_MD_H
+
+#include <stddef.h>
+
+typedef enum {
+    MBEDTLS_MD_NONE = 0,
+    MBEDTLS_MD_SHA256 = 9,
+} mbedtls_md_type_t;
+
+typedef struct mbedtls_md_info_t mbedtls_md_info_t;
+
+const mbedtls_md_info_t* mbedtls_md_info_from_type(mbedtls_md_type_t md_type);
+
+int mbedtls_md_hmac(const mbedtls_md_info_t *md_info, const unsigned char *key, size_t keylen,
+                    const unsigned char *input, size_t ilen, unsigned char *output);
+
+#endif // HOST_MBEDTLS_MD_H
@@ -0,0 +1,12 @@
+/**
+ * Host stand-in for mbedtls/sha256.h (one-shot digest only)
+ */
+
+#ifndef HOST_MBEDTLS_SHA256_H
+#define HOST_MBEDTLS_SHA256_H
+
+#include <stddef.h>
+
+int mbedtls_sha256(const unsigned char *input, size_t ilen, unsigned char *output, int is224);
+
+#endif // HOST_MBEDTLS_SHA256_H
@@ -0,0 +1,96 @@
+/**
+ * Host stand-in for esp-mqtt's mqtt_client.h
+ * The client records its configuration, subscriptions and every message
+ * handed to it; events are raised from the test (host_mqtt_* in
+ * host_idf.h) and delivered on the calling thread.
+ */
+
+#ifndef HOST_MQTT_CLIENT_H
+#define HOST_MQTT_CLIENT_H
+
+#include "esp_err.h"
+#include "esp_event.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct esp_mqtt_client *esp_mqtt_client_handle_t;
+
+typedef enum {
+    MQTT_EVENT_ANY = -1,
+    MQTT_EVENT_ERROR = 0,
+    MQTT_EVENT_CONNECTED,
+    MQTT_EVENT_DISCONNECTED,
+    MQTT_EVENT_SUBSCRIBED,
+    MQTT_EVENT_UNSUBSCRIBED,
+    MQTT_EVENT_PUBLISHED,
+    MQTT_EVENT_DATA,
+} esp_mqtt_event_id_t;
+
+typedef enum {
+    MQTT_ERROR_TYPE_NONE = 0,
+    MQTT_ERROR_TYPE_TCP_TRANSPORT,
+    MQTT_ERROR_TYPE_CONNECTION_REFUSED,
+} esp_mqtt_error_type_t;
+
+typedef struct {
+    esp_mqtt_error_type_t error_type;
+    int connect_return_code;
+} esp_mqtt_error_codes_t;
+
+typedef struct esp_mqtt_event_t {
+    esp_mqtt_event_id_t event_id;
+    esp_mqtt_client_handle_t client;
+    char *data;
+    int data_len;
+    int total_data_len;
+    int current_data_offset;
+    char *topic;
+    int topic_len;
+    int msg_id;
+    esp_mqtt_error_codes_t *error_handle;
+    bool retain;
+    int qos;
+} esp_mqtt_event_t;
+
+typedef esp_mqtt_event_t *esp_mqtt_event_handle_t;
+
+typedef struct {
+    const char *topic;
+    const char *msg;
+    int msg_len;
+    int qos;
+    int retain;
+} esp_mqtt_last_will_t;
+
+typedef struct {
+    struct {
+        struct {
+            const char *uri;
+        } address;
+        struct {
+            esp_err_t (*crt_bundle_attach)(void *conf);
+        } verification;
+    } broker;
+    struct {
+        const char *username;
+        const char *client_id;
+        struct {
+            const char *password;
+        } authentication;
+    } credentials;
+    struct {
+        esp_mqtt_last_will_t last_will;
+        int keepalive;
+    } session;
+} esp_mqtt_client_config_t;
+
+esp_mqtt_client_handle_t esp_mqtt_client_init(const esp_mqtt_client_config_t *config);
+esp_err_t esp_mqtt_client_register_event(esp_mqtt_client_handle_t client, esp_mqtt_event_id_t event,
+                                         esp_event_handler_t event_handler, void *event_handler_arg);
+esp_err_t esp_mqtt_client_start(esp_mqtt_client_handle_t client);
+esp_err_t esp_mqtt_client_destroy(esp_mqtt_client_handle_t client);
+int esp_mqtt_client_subscribe(esp_mqtt_client_handle_t client, const char *topic, int qos);
+int esp_mqtt_client_enqueue(esp_mqtt_client_handle_t client, const char *topic, const char *data, int len,
+                            int qos, int retain, bool store);
+
+#endif // HOST_MQTT_CLIENT_H
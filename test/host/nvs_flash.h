@@ -0,0 +1,10 @@
+/**
+ * Host stand-in for nvs_flash.h
+ */
+
+#ifndef HOST_NVS_FLASH_H
+#define HOST_NVS_FLASH_H
+
+#include "nvs.h"
+
+#endif // HOST_NVS_FLASH_H
@@ -0,0 +1,12 @@
+/**
+ * Host stand-in for sdkconfig.h (the options host-built modules read, as
+ * in the project's sdkconfig)
+ */
+
+#ifndef HOST_SDKCONFIG_H
+#define HOST_SDKCONFIG_H
+
+#define CONFIG_PM_ENABLE                    1
+#define CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ     160
+
+#endif // HOST_SDKCONFIG_H
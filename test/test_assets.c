@@ -0,0 +1,302 @@
+/**
+ * Media assets tests
+ * Header parsing, then packs laid out like main/build_assets.py makes
+ * them in a RAM-backed "assets" partition: a valid pack, a truncated or
+ * corrupt table of contents, entries outside the pack or overlapping,
+ * and blobs whose CRC does not match.
+ */
+
+#include "assets.h"
+#include "host_idf.h"
+#include "esp_rom_crc.h"
+#include "test_common.h"
+#include <string.h>
+
+#define PARTITION_SIZE  (16 * 1024)
+
+typedef struct {
+    const char *name;
+    const char *data;
+} test_asset_t;
+
+static const test_asset_t sample[] = {
+    { "ahs_hypo.wav", "RIFF....WAVEfmt hypo" },
+    { "quotes.txt", "Keep calm and check your glucose\n" },
+    { "moon.png", "\x89PNG\r\n\x1a\n" },
+};
+#define SAMPLE_COUNT    ((int)(sizeof(sample) / sizeof(sample[0])))
+
+static uint8_t flash[PARTITION_SIZE];
+
+static void put_le16(uint8_t *p, uint16_t value)
+{
+    p[0] = value & 0xff;
+    p[1] = value >> 8;
+}
+
+static void put_le32(uint8_t *p, uint32_t value)
+{
+    for (int i = 0; i < 4; i++) {
+        p[i] = (value >> (8 * i)) & 0xff;
+    }
+}
+
+static uint32_t get_le32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint8_t* entry(int index)
+{
+    return flash + ASSETS_HEADER_SIZE + index * ASSETS_ENTRY_SIZE;
+}
+
+/**
+ * Recompute the header CRC over the header's first 16 bytes and the TOC
+ */
+static void reseal(int count)
+{
+    uint32_t crc = esp_rom_crc32_le(0, flash, 16);
+    crc = esp_rom_crc32_le(crc, flash + ASSETS_HEADER_SIZE, (uint32_t)count * ASSETS_ENTRY_SIZE);
+    put_le32(flash + 16, crc);
+}
+
+/**
+ * Lay out a pack in flash
+ * @return Pack size in bytes
+ */
+static uint32_t build_pack(const test_asset_t *assets, int count, uint32_t version)
+{
+    memset(flash, 0xff, sizeof(flash));
+    memset(flash, 0, ASSETS_HEADER_SIZE + count * ASSETS_ENTRY_SIZE);
+    uint32_t offset = ASSETS_HEADER_SIZE + count * ASSETS_ENTRY_SIZE;
+    for (int i = 0; i < count; i++) {
+        offset = (offset + ASSETS_ALIGN - 1) / ASSETS_ALIGN * ASSETS_ALIGN;
+        uint32_t size = strlen(assets[i].data);
+        memcpy(flash + offset, assets[i].data, size);
+        strncpy((char *)entry(i), assets[i].name, ASSETS_NAME_LEN);
+        put_le32(entry(i) + ASSETS_NAME_LEN, offset);
+        put_le32(entry(i) + ASSETS_NAME_LEN + 4, size);
+        put_le32(entry(i) + ASSETS_NAME_LEN + 8, esp_rom_crc32_le(0, (const uint8_t *)assets[i].data, size));
+        offset += size;
+    }
+    memcpy(flash, ASSETS_MAGIC, 4);
+    put_le16(flash + 4, ASSETS_FORMAT);
+    put_le16(flash + 6, count);
+    put_le32(flash + 8, version);
+    put_le32(flash + 12, offset);
+    reseal(count);
+    host_partition_set(ASSETS_PARTITION_LABEL, flash, sizeof(flash));
+    return offset;
+}
+
+static bool get_matches(const test_asset_t *asset)
+{
+    const uint8_t *data = NULL;
+    size_t size = 0;
+    if (!assets_get(asset->name, &data, &size)) {
+        return false;
+    }
+    bool same = size == strlen(asset->data) && memcmp(data, asset->data, size) == 0;
+    assets_release();
+    return same;
+}
+
+static void test_parse_header(void)
+{
+    uint32_t total = build_pack(sample, SAMPLE_COUNT, 7);
+    uint32_t version = 0;
+    uint32_t size = 0;
+    CHECK(assets_parse_header(flash, ASSETS_HEADER_SIZE, &version, &size));
+    CHECK_EQ(version, 7);
+    CHECK_EQ(size, total);
+    CHECK(assets_parse_header(flash, ASSETS_HEADER_SIZE, NULL, NULL));
+
+    // Too short to hold a header
+    CHECK(!assets_parse_header(flash, ASSETS_HEADER_SIZE - 1, NULL, NULL));
+
+    uint8_t header[ASSETS_HEADER_SIZE];
+    memcpy(header, flash, sizeof(header));
+    header[0] = 'X';
+    CHECK(!assets_parse_header(header, sizeof(header), NULL, NULL));
+
+    memcpy(header, flash, sizeof(header));
+    put_le16(header + 4, ASSETS_FORMAT + 1);
+    CHECK(!assets_parse_header(header, sizeof(header), NULL, NULL));
+
+    memcpy(header, flash, sizeof(header));
+    put_le16(header + 6, ASSETS_MAX_ENTRIES + 1);
+    CHECK(!assets_parse_header(header, sizeof(header), NULL, NULL));
+
+    // Pack size too small for its own table of contents
+    memcpy(header, flash, sizeof(header));
+    put_le32(header + 12, ASSETS_HEADER_SIZE + SAMPLE_COUNT * ASSETS_ENTRY_SIZE - 1);
+    CHECK(!assets_parse_header(header, sizeof(header), NULL, NULL));
+
+    // An empty pack is just a header
+    memcpy(header, flash, sizeof(header));
+    put_le16(header + 6, 0);
+    put_le32(header + 12, ASSETS_HEADER_SIZE);
+    CHECK(assets_parse_header(header, sizeof(header), NULL, &size));
+    CHECK_EQ(size, ASSETS_HEADER_SIZE);
+}
+
+static void test_no_partition(void)
+{
+    host_partition_set(ASSETS_PARTITION_LABEL, NULL, 0);
+    CHECK_EQ(assets_init(), ESP_ERR_NOT_FOUND);
+    CHECK_EQ(assets_get_version(), 0);
+
+    const uint8_t *data;
+    size_t size;
+    CHECK(!assets_get("quotes.txt", &data, &size));
+}
+
+static void test_valid_pack(void)
+{
+    build_pack(sample, SAMPLE_COUNT, 3);
+    CHECK_EQ(assets_init(), ESP_OK);
+    CHECK_EQ(assets_get_version(), 3);
+    for (int i = 0; i < SAMPLE_COUNT; i++) {
+        CHECK(get_matches(&sample[i]));
+    }
+
+    const uint8_t *data;
+    size_t size;
+    CHECK(!assets_get("missing.wav", &data, &size));
+
+    // Nothing is handed out while an update writes the partition
+    CHECK_EQ(assets_begin_update(0), ESP_OK);
+    CHECK(!get_matches(&sample[0]));
+    assets_end_update();
+    CHECK(get_matches(&sample[0]));
+
+    // A reader still holding an asset keeps the update out
+    CHECK(assets_get(sample[1].name, &data, &size));
+    CHECK_EQ(assets_begin_update(0), ESP_ERR_TIMEOUT);
+    assets_release();
+    CHECK(get_matches(&sample[1]));
+}
+
+static void test_truncated_toc(void)
+{
+    // Pack size ends inside the table of contents
+    build_pack(sample, SAMPLE_COUNT, 4);
+    put_le32(flash + 12, ASSETS_HEADER_SIZE + ASSETS_ENTRY_SIZE);
+    reseal(SAMPLE_COUNT);
+    CHECK_EQ(assets_init(), ESP_ERR_INVALID_STATE);
+
+    // Pack larger than the partition
+    build_pack(sample, SAMPLE_COUNT, 4);
+    put_le32(flash + 12, PARTITION_SIZE + 1);
+    reseal(SAMPLE_COUNT);
+    CHECK_EQ(assets_init(), ESP_ERR_INVALID_STATE);
+
+    // Erased flash
+    memset(flash, 0xff, sizeof(flash));
+    CHECK_EQ(assets_init(), ESP_ERR_INVALID_STATE);
+}
+
+static void test_toc_crc_mismatch(void)
+{
+    build_pack(sample, SAMPLE_COUNT, 5);
+    entry(1)[0] ^= 0x20;    // Renamed without resealing
+    CHECK_EQ(assets_init(), ESP_ERR_INVALID_CRC);
+
+    build_pack(sample, SAMPLE_COUNT, 5);
+    put_le32(flash + 8, 6);  // Version is covered too
+    CHECK_EQ(assets_init(), ESP_ERR_INVALID_CRC);
+
+    build_pack(sample, SAMPLE_COUNT, 5);
+    flash[16] ^= 1;
+    CHECK_EQ(assets_init(), ESP_ERR_INVALID_CRC);
+}
+
+static void test_entries_out_of_range(void)
+{
+    // Blob runs past the end of the pack
+    uint32_t total = build_pack(sample, SAMPLE_COUNT, 6);
+    put_le32(entry(2) + ASSETS_NAME_LEN + 4, total);
+    reseal(SAMPLE_COUNT);
+    CHECK_EQ(assets_init(), ESP_ERR_INVALID_SIZE);
+
+    // Offset past the end, and a size that wraps around
+    build_pack(sample, SAMPLE_COUNT, 6);
+    put_le32(entry(0) + ASSETS_NAME_LEN, total + ASSETS_ALIGN);
+    put_le32(entry(0) + ASSETS_NAME_LEN + 4, 0);
+    reseal(SAMPLE_COUNT);
+    CHECK_EQ(assets_init(), ESP_ERR_INVALID_SIZE);
+
+    build_pack(sample, SAMPLE_COUNT, 6);
+    put_le32(entry(0) + ASSETS_NAME_LEN + 4, 0xfffffff0u);
+    reseal(SAMPLE_COUNT);
+    CHECK_EQ(assets_init(), ESP_ERR_INVALID_SIZE);
+
+    // Blob inside the header and table of contents
+    build_pack(sample, SAMPLE_COUNT, 6);
+    put_le32(entry(0) + ASSETS_NAME_LEN, ASSETS_HEADER_SIZE);
+    reseal(SAMPLE_COUNT);
+    CHECK_EQ(assets_init(), ESP_ERR_INVALID_SIZE);
+}
+
+static void test_overlapping_entries(void)
+{
+    // Second blob starts inside the first
+    build_pack(sample, SAMPLE_COUNT, 8);
+    uint32_t first = ASSETS_HEADER_SIZE + SAMPLE_COUNT * ASSETS_ENTRY_SIZE;
+    first = (first + ASSETS_ALIGN - 1) / ASSETS_ALIGN * ASSETS_ALIGN;
+    put_le32(entry(1) + ASSETS_NAME_LEN, first + 4);
+    reseal(SAMPLE_COUNT);
+    CHECK_EQ(assets_init(), ESP_ERR_INVALID_SIZE);
+
+    // Two entries for the same blob
+    build_pack(sample, SAMPLE_COUNT, 8);
+    memcpy(entry(2) + ASSETS_NAME_LEN, entry(0) + ASSETS_NAME_LEN, 12);
+    reseal(SAMPLE_COUNT);
+    CHECK_EQ(assets_init(), ESP_ERR_INVALID_SIZE);
+
+    // Touching is fine: an empty blob right after another
+    test_asset_t touching[] = { { "a.bin", "0123456789abcdef" }, { "b.bin", "" } };
+    build_pack(touching, 2, 8);
+    CHECK_EQ(assets_init(), ESP_OK);
+    CHECK(get_matches(&touching[0]));
+    CHECK(get_matches(&touching[1]));
+}
+
+static void test_blob_crc_mismatch(void)
+{
+    build_pack(sample, SAMPLE_COUNT, 9);
+    CHECK_EQ(assets_init(), ESP_OK);
+
+    // Blobs are checked on first use: the corrupt one is refused for good,
+    // the others are still served
+    uint8_t *blob = flash + get_le32(entry(1) + ASSETS_NAME_LEN);
+    blob[0] ^= 0x01;
+    CHECK(!get_matches(&sample[1]));
+    CHECK(get_matches(&sample[0]));
+    blob[0] ^= 0x01;
+    CHECK(!get_matches(&sample[1]));
+
+    // A blob checked before is checked again after an update
+    uint8_t *first = flash + get_le32(entry(0) + ASSETS_NAME_LEN);
+    CHECK_EQ(assets_begin_update(0), ESP_OK);
+    first[0] ^= 0x01;
+    assets_end_update();
+    const uint8_t *data;
+    size_t size;
+    CHECK(!assets_get(sample[0].name, &data, &size));
+    CHECK(get_matches(&sample[2]));
+}
+
+int main(void)
+{
+    RUN_TEST(test_parse_header);
+    RUN_TEST(test_no_partition);
+    RUN_TEST(test_valid_pack);
+    RUN_TEST(test_truncated_toc);
+    RUN_TEST(test_toc_crc_mismatch);
+    RUN_TEST(test_entries_out_of_range);
+    RUN_TEST(test_overlapping_entries);
+    RUN_TEST(test_blob_crc_mismatch);
+    return TEST_EXIT_CODE();
+}
@@ -0,0 +1,159 @@
+/**
+ * Backlight policy tests
+ * Day and night schedules at fixed points, then every combination of
+ * timeouts, hour and idle time against the invariants display_power.c
+ * relies on: the level only gets darker with idle time, and next_s is
+ * exactly where it next changes.
+ */
+
+#include "backlight_policy.h"
+#include "test_common.h"
+
+static backlight_policy_t policy(uint32_t dim_after_s, uint32_t off_after_s, bool night,
+                                 uint8_t start, uint8_t end)
+{
+    backlight_policy_t policy = {
+        .dim_after_s = dim_after_s,
+        .off_after_s = off_after_s,
+        .night_enabled = night,
+        .night_start_hour = start,
+        .night_end_hour = end,
+    };
+    return policy;
+}
+
+static void test_night_hours(void)
+{
+    backlight_policy_t p = policy(300, 600, true, 22, 7);
+    CHECK(backlight_policy_is_night(&p, 22));
+    CHECK(backlight_policy_is_night(&p, 0));
+    CHECK(backlight_policy_is_night(&p, 6));
+    CHECK(!backlight_policy_is_night(&p, 7));
+    CHECK(!backlight_policy_is_night(&p, 12));
+    CHECK(!backlight_policy_is_night(&p, 21));
+    CHECK(!backlight_policy_is_night(&p, -1));      // Clock not set
+
+    // Night within one day
+    p = policy(300, 600, true, 1, 5);
+    CHECK(!backlight_policy_is_night(&p, 0));
+    CHECK(backlight_policy_is_night(&p, 1));
+    CHECK(backlight_policy_is_night(&p, 4));
+    CHECK(!backlight_policy_is_night(&p, 5));
+
+    // Equal start and end, or disabled: no night
+    p = policy(300, 600, true, 1, 1);
+    CHECK(!backlight_policy_is_night(&p, 1));
+    p = policy(300, 600, false, 22, 7);
+    CHECK(!backlight_policy_is_night(&p, 23));
+}
+
+static void test_day_schedule(void)
+{
+    backlight_policy_t p = policy(300, 600, true, 22, 7);
+    uint32_t next;
+    CHECK_EQ(backlight_policy_level(&p, 0, 12, false, &next), BACKLIGHT_FULL);
+    CHECK_EQ(next, 300);
+    CHECK_EQ(backlight_policy_level(&p, 299, 12, false, &next), BACKLIGHT_FULL);
+    CHECK_EQ(backlight_policy_level(&p, 300, 12, false, &next), BACKLIGHT_DIM);
+    CHECK_EQ(next, 600);
+    CHECK_EQ(backlight_policy_level(&p, 600, 12, false, &next), BACKLIGHT_OFF);
+    CHECK_EQ(next, 0);
+    CHECK_EQ(backlight_policy_level(&p, 300, -1, false, &next), BACKLIGHT_DIM);
+
+    // The alarm overrides everything, and nothing changes while it sounds
+    CHECK_EQ(backlight_policy_level(&p, 9999, 12, true, &next), BACKLIGHT_FULL);
+    CHECK_EQ(next, 0);
+    CHECK_EQ(backlight_policy_level(&p, 9999, 23, true, &next), BACKLIGHT_FULL);
+
+    // Off before dim: dimming is skipped
+    p = policy(600, 120, false, 0, 0);
+    CHECK_EQ(backlight_policy_level(&p, 0, 12, false, &next), BACKLIGHT_FULL);
+    CHECK_EQ(next, 120);
+    CHECK_EQ(backlight_policy_level(&p, 120, 12, false, &next), BACKLIGHT_OFF);
+
+    // Never off
+    p = policy(60, 0, false, 0, 0);
+    CHECK_EQ(backlight_policy_level(&p, 60, 12, false, &next), BACKLIGHT_DIM);
+    CHECK_EQ(next, 0);
+
+    // Never dim or off
+    p = policy(0, 0, false, 0, 0);
+    CHECK_EQ(backlight_policy_level(&p, 1u << 30, 5, false, &next), BACKLIGHT_FULL);
+    CHECK_EQ(next, 0);
+    CHECK_EQ(backlight_policy_level(&p, 0, 5, false, NULL), BACKLIGHT_FULL);
+}
+
+static void test_night_schedule(void)
+{
+    backlight_policy_t p = policy(300, 600, true, 22, 7);
+    uint32_t next;
+
+    // Woken dim, off at the first timeout
+    CHECK_EQ(backlight_policy_level(&p, 0, 23, false, &next), BACKLIGHT_DIM);
+    CHECK_EQ(next, 300);
+    CHECK_EQ(backlight_policy_level(&p, 300, 23, false, &next), BACKLIGHT_OFF);
+    CHECK_EQ(next, 0);
+
+    p = policy(0, 600, true, 22, 7);
+    CHECK_EQ(backlight_policy_level(&p, 100, 12, false, &next), BACKLIGHT_FULL);
+    CHECK_EQ(next, 600);
+    CHECK_EQ(backlight_policy_level(&p, 100, 23, false, &next), BACKLIGHT_DIM);
+    CHECK_EQ(next, 600);
+
+    // No timeouts: dim all night
+    p = policy(0, 0, true, 22, 7);
+    CHECK_EQ(backlight_policy_level(&p, 99999, 12, false, &next), BACKLIGHT_FULL);
+    CHECK_EQ(backlight_policy_level(&p, 99999, 23, false, &next), BACKLIGHT_DIM);
+    CHECK_EQ(next, 0);
+}
+
+static void test_invariants(void)
+{
+    static const uint32_t timeouts[] = { 0, 1, 60, 300, 600, 3600 };
+    static const int hours[] = { -1, 0, 6, 7, 12, 21, 22, 23 };
+    static const uint32_t idles[] = { 0, 1, 59, 60, 61, 299, 300, 599, 600, 601, 3599, 3600, 86400 };
+    const int timeout_count = sizeof(timeouts) / sizeof(timeouts[0]);
+
+    for (int d = 0; d < timeout_count; d++) {
+        for (int o = 0; o < timeout_count; o++) {
+            for (int n = 0; n < 2; n++) {
+                backlight_policy_t p = policy(timeouts[d], timeouts[o], n, 22, 7);
+                for (size_t h = 0; h < sizeof(hours) / sizeof(hours[0]); h++) {
+                    backlight_level_t previous = BACKLIGHT_FULL;
+                    for (size_t i = 0; i < sizeof(idles) / sizeof(idles[0]); i++) {
+                        uint32_t next;
+                        backlight_level_t level = backlight_policy_level(&p, idles[i], hours[h], false, &next);
+                        bool ok = level >= previous;
+                        if (next > 0) {
+                            // Same level until next, a different one from next on
+                            uint32_t before;
+                            ok = ok && next > idles[i] &&
+                                 backlight_policy_level(&p, next - 1, hours[h], false, &before) == level &&
+                                 before == next &&
+                                 backlight_policy_level(&p, next, hours[h], false, NULL) != level;
+                        } else {
+                            ok = ok && backlight_policy_level(&p, UINT32_MAX, hours[h], false, NULL) == level;
+                        }
+                        if (!ok) {
+                            printf("  dim %u off %u night %d hour %d idle %u: level %d next %u\n",
+                                   (unsigned)timeouts[d], (unsigned)timeouts[o], n, hours[h],
+                                   (unsigned)idles[i], level, (unsigned)next);
+                            CHECK(0);
+                            return;
+                        }
+                        previous = level;
+                    }
+                }
+            }
+        }
+    }
+}
+
+int main(void)
+{
+    RUN_TEST(test_night_hours);
+    RUN_TEST(test_day_schedule);
+    RUN_TEST(test_night_schedule);
+    RUN_TEST(test_invariants);
+    return TEST_EXIT_CODE();
+}
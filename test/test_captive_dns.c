@@ -0,0 +1,226 @@
+/**
+ * Captive DNS tests
+ * Builds queries the way phones send them (EDNS OPT record, RD set) and
+ * checks the reply byte by byte, then everything the responder must
+ * drop, then random packets into short reply buffers.
+ */
+
+#include "captive_dns_proto.h"
+#include "test_common.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TYPE_A          1
+#define TYPE_AAAA       28
+#define CLASS_IN        1
+#define CLASS_CH        3
+#define FLAG_QR         0x8000
+#define FLAG_AA         0x0400
+#define FLAG_TC         0x0200
+#define FLAG_RD         0x0100
+#define OPCODE_STATUS   0x1000
+
+#define HEADER_LEN      12
+#define OPT_LEN         11
+#define ANSWER_LEN      16
+
+// 192.168.4.1 in network byte order, as esp_ip4_addr_t holds it
+static const uint8_t portal_ip[4] = { 192, 168, 4, 1 };
+
+static uint32_t portal_addr(void)
+{
+    uint32_t ip;
+    memcpy(&ip, portal_ip, sizeof(ip));
+    return ip;
+}
+
+static size_t put_u16(uint8_t *p, uint16_t value)
+{
+    p[0] = (uint8_t)(value >> 8);
+    p[1] = (uint8_t)value;
+    return 2;
+}
+
+/**
+ * Build a query for name (dotted, "" for the root)
+ * @param edns Append an OPT record in the additional section
+ */
+static size_t make_query(uint8_t *buf, uint16_t id, uint16_t flags, const char *name,
+                         uint16_t type, uint16_t cls, bool edns)
+{
+    size_t pos = 0;
+    pos += put_u16(buf + pos, id);
+    pos += put_u16(buf + pos, flags);
+    pos += put_u16(buf + pos, 1);           // QDCOUNT
+    pos += put_u16(buf + pos, 0);           // ANCOUNT
+    pos += put_u16(buf + pos, 0);           // NSCOUNT
+    pos += put_u16(buf + pos, edns ? 1 : 0);
+
+    for (const char *label = name; *label; ) {
+        const char *dot = strchr(label, '.');
+        size_t len = dot ? (size_t)(dot - label) : strlen(label);
+        buf[pos++] = (uint8_t)len;
+        memcpy(buf + pos, label, len);
+        pos += len;
+        label += len + (dot ? 1 : 0);
+    }
+    buf[pos++] = 0;
+    pos += put_u16(buf + pos, type);
+    pos += put_u16(buf + pos, cls);
+
+    if (edns) {
+        static const uint8_t opt[OPT_LEN] = { 0, 0, 41, 0x10, 0x00, 0, 0, 0, 0, 0, 0 };
+        memcpy(buf + pos, opt, sizeof(opt));
+        pos += sizeof(opt);
+    }
+    return pos;
+}
+
+static uint16_t get_u16(const uint8_t *p)
+{
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static size_t reply_to(const uint8_t *query, size_t len, uint8_t *reply, size_t reply_size)
+{
+    return captive_dns_reply(query, len, portal_addr(), reply, reply_size);
+}
+
+static void test_a_query(void)
+{
+    uint8_t query[CAPTIVE_DNS_PACKET_MAX];
+    uint8_t reply[CAPTIVE_DNS_PACKET_MAX];
+    size_t len = make_query(query, 0x1234, FLAG_RD, "connectivitycheck.gstatic.com", TYPE_A, CLASS_IN, true);
+    size_t question_end = len - OPT_LEN;
+
+    // The OPT record is not echoed; one answer follows the question
+    CHECK_EQ(reply_to(query, len, reply, sizeof(reply)), question_end + ANSWER_LEN);
+    CHECK_EQ(get_u16(reply), 0x1234);
+    CHECK_EQ(get_u16(reply + 2), FLAG_QR | FLAG_AA | FLAG_RD);     // NOERROR, RD echoed
+    CHECK_EQ(get_u16(reply + 4), 1);
+    CHECK_EQ(get_u16(reply + 6), 1);
+    CHECK_EQ(get_u16(reply + 8), 0);
+    CHECK_EQ(get_u16(reply + 10), 0);
+    CHECK(memcmp(reply + HEADER_LEN, query + HEADER_LEN, question_end - HEADER_LEN) == 0);
+
+    const uint8_t *answer = reply + question_end;
+    CHECK_EQ(get_u16(answer), 0xC000 | HEADER_LEN);     // Pointer to the question name
+    CHECK_EQ(get_u16(answer + 2), TYPE_A);
+    CHECK_EQ(get_u16(answer + 4), CLASS_IN);
+    CHECK_EQ(get_u16(answer + 6), 0);
+    CHECK_EQ(get_u16(answer + 8), CAPTIVE_DNS_TTL_S);
+    CHECK_EQ(get_u16(answer + 10), 4);
+    CHECK(memcmp(answer + 12, portal_ip, 4) == 0);
+
+    // RD clear stays clear
+    len = make_query(query, 7, 0, "a.b", TYPE_A, CLASS_IN, false);
+    CHECK_EQ(reply_to(query, len, reply, sizeof(reply)), len + ANSWER_LEN);
+    CHECK_EQ(get_u16(reply + 2), FLAG_QR | FLAG_AA);
+
+    // The root name
+    len = make_query(query, 7, FLAG_RD, "", TYPE_A, CLASS_IN, false);
+    CHECK_EQ(reply_to(query, len, reply, sizeof(reply)), len + ANSWER_LEN);
+}
+
+static void test_other_types_nodata(void)
+{
+    uint8_t query[CAPTIVE_DNS_PACKET_MAX];
+    uint8_t reply[CAPTIVE_DNS_PACKET_MAX];
+    static const uint16_t types[] = { TYPE_AAAA, 65, 16, 255 };     // AAAA, HTTPS, TXT, ANY
+
+    for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); i++) {
+        size_t len = make_query(query, 9, FLAG_RD, "captive.apple.com", types[i], CLASS_IN, false);
+        CHECK_EQ(reply_to(query, len, reply, sizeof(reply)), len);
+        CHECK_EQ(get_u16(reply + 2), FLAG_QR | FLAG_AA | FLAG_RD);
+        CHECK_EQ(get_u16(reply + 6), 0);
+        CHECK(memcmp(reply + HEADER_LEN, query + HEADER_LEN, len - HEADER_LEN) == 0);
+    }
+}
+
+static void test_dropped(void)
+{
+    uint8_t query[CAPTIVE_DNS_PACKET_MAX + 1];
+    uint8_t reply[CAPTIVE_DNS_PACKET_MAX];
+    size_t len;
+
+    len = make_query(query, 1, FLAG_QR | FLAG_RD, "a.b", TYPE_A, CLASS_IN, false);
+    CHECK_EQ(reply_to(query, len, reply, sizeof(reply)), 0);
+    len = make_query(query, 1, OPCODE_STATUS | FLAG_RD, "a.b", TYPE_A, CLASS_IN, false);
+    CHECK_EQ(reply_to(query, len, reply, sizeof(reply)), 0);
+    len = make_query(query, 1, FLAG_TC | FLAG_RD, "a.b", TYPE_A, CLASS_IN, false);
+    CHECK_EQ(reply_to(query, len, reply, sizeof(reply)), 0);
+    len = make_query(query, 1, FLAG_RD, "a.b", TYPE_A, CLASS_CH, false);
+    CHECK_EQ(reply_to(query, len, reply, sizeof(reply)), 0);
+
+    // Every truncation of a good query
+    len = make_query(query, 1, FLAG_RD, "a.b", TYPE_A, CLASS_IN, false);
+    for (size_t cut = 0; cut < len; cut++) {
+        CHECK_EQ(reply_to(query, cut, reply, sizeof(reply)), 0);
+    }
+
+    // Reply buffer one byte short
+    CHECK_EQ(reply_to(query, len, reply, len + ANSWER_LEN), len + ANSWER_LEN);
+    CHECK_EQ(reply_to(query, len, reply, len + ANSWER_LEN - 1), 0);
+
+    // Two questions, an answer in a query, a compressed name
+    query[5] = 2;
+    CHECK_EQ(reply_to(query, len, reply, sizeof(reply)), 0);
+    query[5] = 1;
+    query[7] = 1;
+    CHECK_EQ(reply_to(query, len, reply, sizeof(reply)), 0);
+    query[7] = 0;
+    query[HEADER_LEN] = 0xC0;
+    CHECK_EQ(reply_to(query, len, reply, sizeof(reply)), 0);
+
+    // Name longer than 255 bytes (labels of 60)
+    char name[300];
+    memset(name, 'x', sizeof(name) - 1);
+    name[sizeof(name) - 1] = '\0';
+    for (size_t i = 60; i < sizeof(name) - 1; i += 61) {
+        name[i] = '.';
+    }
+    len = make_query(query, 1, FLAG_RD, name, TYPE_A, CLASS_IN, false);
+    CHECK_EQ(reply_to(query, len, reply, sizeof(reply)), 0);
+
+    // Larger than a classic UDP query
+    make_query(query, 1, FLAG_RD, "a.b", TYPE_A, CLASS_IN, false);
+    CHECK_EQ(reply_to(query, sizeof(query), reply, sizeof(reply)), 0);
+}
+
+static void test_fuzz(void)
+{
+    uint8_t query[CAPTIVE_DNS_PACKET_MAX];
+    uint8_t reply[CAPTIVE_DNS_PACKET_MAX];
+
+    srand(1);
+    for (int it = 0; it < 500000; it++) {
+        size_t len = rand() % 80;
+        for (size_t i = 0; i < len; i++) {
+            query[i] = (uint8_t)rand();
+        }
+        if (len >= HEADER_LEN) {
+            // Mostly valid headers, so the question parser is what gets exercised
+            query[2] &= 0x01;
+            query[4] = 0;
+            query[5] = 1;
+            memset(query + 6, 0, 4);
+        }
+        size_t reply_size = rand() % 100;
+        size_t reply_len = reply_to(query, len, reply, reply_size);
+        if (reply_len > reply_size || (reply_len > 0 && reply_len < HEADER_LEN)) {
+            printf("  iteration %d: reply of %zu bytes into %zu\n", it, reply_len, reply_size);
+            CHECK(0);
+            return;
+        }
+    }
+}
+
+int main(void)
+{
+    RUN_TEST(test_a_query);
+    RUN_TEST(test_other_types_nodata);
+    RUN_TEST(test_dropped);
+    RUN_TEST(test_fuzz);
+    return TEST_EXIT_CODE();
+}
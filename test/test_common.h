@@ -0,0 +1,40 @@
+/**
+ * Minimal host test helpers
+ * Each test is a function run by RUN_TEST; a failed CHECK prints the
+ * location, marks the test failed and carries on.
+ */
+
+#ifndef TEST_COMMON_H
+#define TEST_COMMON_H
+
+#include <stdio.h>
+
+static int test_failures = 0;
+static int test_current_failed = 0;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            printf("  %s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            test_current_failed = 1; \
+        } \
+    } while (0)
+
+#define CHECK_EQ(actual, expected) do { \
+        long long actual_ = (long long)(actual); \
+        long long expected_ = (long long)(expected); \
+        if (actual_ != expected_) { \
+            printf("  %s:%d: %s == %lld, expected %lld\n", __FILE__, __LINE__, #actual, actual_, expected_); \
+            test_current_failed = 1; \
+        } \
+    } while (0)
+
+#define RUN_TEST(fn) do { \
+        test_current_failed = 0; \
+        fn(); \
+        printf("%s %s\n", test_current_failed ? "FAIL" : "ok  ", #fn); \
+        test_failures += test_current_failed; \
+    } while (0)
+
+#define TEST_EXIT_CODE() (test_failures ? 1 : 0)
+
+#endif // TEST_COMMON_H
@@ -0,0 +1,324 @@
+/**
+ * Delta patch tests
+ * Applies a patch made by make_delta_patch.py (body inflated here, as
+ * the firmware does before feeding it), split at every point and at
+ * random, and checks that malformed records fail instead of writing
+ * outside the target or reading outside the source.
+ */
+
+#include "delta_patch.h"
+#include "test_common.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define SOURCE_SIZE     200
+#define TARGET_SIZE     173
+#define TARGET_MAX      512
+
+// make_delta_patch.py old.bin new.bin (sources below), header as published
+static const uint8_t patch_header[] = {
+    0x47, 0x4D, 0x44, 0x50, 0x01, 0x00, 0x00, 0x00, 0xC8, 0x00, 0x00, 0x00, 0xAD, 0x00, 0x00, 0x00,
+    0x5E, 0x48, 0xD6, 0x48, 0x39, 0xA8, 0xBF, 0xF5, 0xE2, 0x47, 0x15, 0x07, 0xAF, 0x6A, 0x49, 0xF9,
+    0x99, 0x08, 0x17, 0xDF, 0x43, 0x78, 0x57, 0xF4, 0xA2, 0x00, 0x7D, 0xF4, 0x12, 0x66, 0xE1, 0xB5,
+    0x83, 0x6F, 0xA8, 0x02, 0xA6, 0xD8, 0x3A, 0x06, 0x9E, 0x39, 0x3F, 0xE5, 0xB1, 0xB7, 0x50, 0x46,
+    0xD8, 0xAD, 0x3B, 0x95, 0x35, 0x4D, 0x4F, 0x5F, 0xBA, 0xA0, 0x06, 0xC9, 0xDA, 0x9B, 0x94, 0x8B,
+};
+
+// Its zlib body, inflated
+static const uint8_t patch_body[] = {
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x28, 0x00, 0x00, 0x00,
+    0x09, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x4E, 0x45, 0x57, 0x20, 0x43, 0x4F, 0x44, 0x45, 0xD4, 0x77, 0x00, 0x00, 0x00, 0x05, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x74, 0x61, 0x69, 0x6C,
+    0x21,
+};
+
+typedef struct {
+    uint8_t source[SOURCE_SIZE];
+    uint8_t target[TARGET_MAX];
+    size_t written;
+    int fail_read_at;           // Fail the nth source read (-1: never)
+    int fail_write_at;          // Fail the nth target write (-1: never)
+    int reads;
+    int writes;
+} image_t;
+
+// old.bin: (i * 37 + 11) & 0xFF
+static void make_source(uint8_t *source)
+{
+    for (int i = 0; i < SOURCE_SIZE; i++) {
+        source[i] = (uint8_t)(i * 37 + 11);
+    }
+}
+
+// new.bin: 40 bytes kept, "NEW CODE" inserted, 120 bytes with every 50th one changed, "tail!"
+static void make_target(uint8_t *target)
+{
+    uint8_t source[SOURCE_SIZE];
+    make_source(source);
+    memcpy(target, source, 40);
+    memcpy(target + 40, "NEW CODE", 8);
+    for (int i = 0; i < 120; i++) {
+        target[48 + i] = (uint8_t)(source[40 + i] + (i % 50 == 0));
+    }
+    memcpy(target + 168, "tail!", 5);
+}
+
+static bool read_source(void *ctx, uint32_t offset, uint8_t *buf, size_t len)
+{
+    image_t *image = ctx;
+    if (image->reads++ == image->fail_read_at) {
+        return false;
+    }
+    CHECK(offset + len <= SOURCE_SIZE);
+    memcpy(buf, image->source + offset, len);
+    return true;
+}
+
+static bool write_target(void *ctx, const uint8_t *data, size_t len)
+{
+    image_t *image = ctx;
+    if (image->writes++ == image->fail_write_at) {
+        return false;
+    }
+    CHECK(image->written + len <= TARGET_MAX);
+    memcpy(image->target + image->written, data, len);
+    image->written += len;
+    return true;
+}
+
+static void image_init(image_t *image)
+{
+    memset(image, 0, sizeof(*image));
+    make_source(image->source);
+    image->fail_read_at = -1;
+    image->fail_write_at = -1;
+}
+
+static void header_for(delta_patch_header_t *header, uint32_t target_size)
+{
+    memset(header, 0, sizeof(*header));
+    header->source_size = SOURCE_SIZE;
+    header->target_size = target_size;
+}
+
+/**
+ * Feed a body in pieces ending at each of cuts[] (ascending)
+ * @return whether every feed succeeded and the target is complete
+ */
+static bool apply_chunked(const delta_patch_header_t *header, const uint8_t *body, size_t len,
+                          const size_t *cuts, int cut_count, image_t *image)
+{
+    delta_patch_t patch;
+    delta_patch_init(&patch, header, read_source, write_target, image);
+    size_t pos = 0;
+    for (int i = 0; i <= cut_count; i++) {
+        size_t end = i < cut_count ? cuts[i] : len;
+        if (!delta_patch_feed(&patch, body + pos, end - pos)) {
+            return false;
+        }
+        pos = end;
+    }
+    return delta_patch_complete(&patch);
+}
+
+static bool apply(const delta_patch_header_t *header, const uint8_t *body, size_t len, image_t *image)
+{
+    return apply_chunked(header, body, len, NULL, 0, image);
+}
+
+static void test_header(void)
+{
+    delta_patch_header_t header;
+    CHECK(delta_patch_parse_header(patch_header, sizeof(patch_header), &header));
+    CHECK_EQ(header.source_size, SOURCE_SIZE);
+    CHECK_EQ(header.target_size, TARGET_SIZE);
+    CHECK_EQ(header.source_sha256[0], 0x5E);
+    CHECK_EQ(header.target_sha256[31], 0x8B);
+
+    uint8_t buf[sizeof(patch_header)];
+    CHECK(!delta_patch_parse_header(patch_header, sizeof(patch_header) - 1, &header));
+    memcpy(buf, patch_header, sizeof(buf));
+    buf[0] = 'X';
+    CHECK(!delta_patch_parse_header(buf, sizeof(buf), &header));
+    memcpy(buf, patch_header, sizeof(buf));
+    buf[4] = 2;         // Newer format version
+    CHECK(!delta_patch_parse_header(buf, sizeof(buf), &header));
+}
+
+static void test_tool_patch(void)
+{
+    delta_patch_header_t header;
+    CHECK(delta_patch_parse_header(patch_header, sizeof(patch_header), &header));
+    uint8_t expected[TARGET_SIZE];
+    make_target(expected);
+
+    image_t image;
+    image_init(&image);
+    CHECK(apply(&header, patch_body, sizeof(patch_body), &image));
+    CHECK_EQ(image.written, TARGET_SIZE);
+    CHECK(memcmp(image.target, expected, TARGET_SIZE) == 0);
+}
+
+static void test_every_split(void)
+{
+    delta_patch_header_t header;
+    CHECK(delta_patch_parse_header(patch_header, sizeof(patch_header), &header));
+    uint8_t expected[TARGET_SIZE];
+    make_target(expected);
+
+    for (size_t cut = 0; cut <= sizeof(patch_body); cut++) {
+        image_t image;
+        image_init(&image);
+        if (!apply_chunked(&header, patch_body, sizeof(patch_body), &cut, 1, &image) ||
+            memcmp(image.target, expected, TARGET_SIZE) != 0) {
+            printf("  split at %zu\n", cut);
+            CHECK(0);
+            return;
+        }
+    }
+
+    srand(1);
+    for (int it = 0; it < 2000; it++) {
+        size_t cuts[16];
+        int cut_count = rand() % 16;
+        size_t last = 0;
+        for (int c = 0; c < cut_count; c++) {
+            last += rand() % (sizeof(patch_body) - last + 1);
+            cuts[c] = last;
+        }
+        image_t image;
+        image_init(&image);
+        if (!apply_chunked(&header, patch_body, sizeof(patch_body), cuts, cut_count, &image) ||
+            memcmp(image.target, expected, TARGET_SIZE) != 0) {
+            printf("  iteration %d\n", it);
+            CHECK(0);
+            return;
+        }
+    }
+}
+
+static size_t put_record(uint8_t *p, uint32_t diff, uint32_t extra, int32_t seek)
+{
+    const uint32_t fields[3] = { diff, extra, (uint32_t)seek };
+    for (int f = 0; f < 3; f++) {
+        for (int b = 0; b < 4; b++) {
+            p[f * 4 + b] = (uint8_t)(fields[f] >> (b * 8));
+        }
+    }
+    return 12;
+}
+
+static void test_seek_backwards(void)
+{
+    // Source bytes 100..109, then 0..9 again: seek is applied after each record
+    uint8_t body[64];
+    size_t len = put_record(body, 0, 0, 100);
+    len += put_record(body + len, 10, 0, -110);
+    memset(body + len, 0, 10);
+    len += 10;
+    len += put_record(body + len, 10, 0, 0);
+    memset(body + len, 0, 10);
+    len += 10;
+
+    delta_patch_header_t header;
+    header_for(&header, 20);
+    image_t image;
+    image_init(&image);
+    CHECK(apply(&header, body, len, &image));
+    CHECK(memcmp(image.target, image.source + 100, 10) == 0);
+    CHECK(memcmp(image.target + 10, image.source, 10) == 0);
+}
+
+static void test_malformed_records(void)
+{
+    uint8_t body[64] = {0};
+    delta_patch_header_t header;
+    image_t image;
+
+    // Record longer than the target
+    header_for(&header, 8);
+    image_init(&image);
+    put_record(body, 4, 5, 0);
+    CHECK(!apply(&header, body, 12 + 9, &image));
+    CHECK_EQ(image.written, 0);
+
+    // Lengths that wrap a 32-bit sum
+    image_init(&image);
+    put_record(body, 0xFFFFFFF8u, 16, 0);
+    CHECK(!apply(&header, body, 12, &image));
+
+    // Seek before the start of the source
+    header_for(&header, 4);
+    image_init(&image);
+    size_t len = put_record(body, 0, 0, -1);
+    len += put_record(body + len, 4, 0, 0);
+    CHECK(!apply(&header, body, len + 4, &image));
+    CHECK_EQ(image.reads, 0);
+
+    // Diff running past the end of the source
+    image_init(&image);
+    len = put_record(body, 0, 0, SOURCE_SIZE - 2);
+    len += put_record(body + len, 4, 0, 0);
+    CHECK(!apply(&header, body, len + 4, &image));
+    CHECK_EQ(image.reads, 0);
+
+    // Truncated body: accepted so far, but not complete
+    delta_patch_t patch;
+    CHECK(delta_patch_parse_header(patch_header, sizeof(patch_header), &header));
+    image_init(&image);
+    delta_patch_init(&patch, &header, read_source, write_target, &image);
+    CHECK(delta_patch_feed(&patch, patch_body, sizeof(patch_body) - 1));
+    CHECK(!delta_patch_complete(&patch));
+
+    // Half a record header at the end
+    image_init(&image);
+    uint8_t padded[sizeof(patch_body) + 5];
+    memcpy(padded, patch_body, sizeof(patch_body));
+    memset(padded + sizeof(patch_body), 0, 5);
+    CHECK(!apply(&header, padded, sizeof(padded), &image));
+}
+
+static void test_callback_failures(void)
+{
+    delta_patch_header_t header;
+    CHECK(delta_patch_parse_header(patch_header, sizeof(patch_header), &header));
+
+    image_t image;
+    image_init(&image);
+    image.fail_read_at = 0;
+    CHECK(!apply(&header, patch_body, sizeof(patch_body), &image));
+
+    image_init(&image);
+    image.fail_write_at = 1;
+    CHECK(!apply(&header, patch_body, sizeof(patch_body), &image));
+
+    // A failed patch stays failed
+    delta_patch_t patch;
+    image_init(&image);
+    image.fail_write_at = 0;
+    delta_patch_init(&patch, &header, read_source, write_target, &image);
+    CHECK(!delta_patch_feed(&patch, patch_body, sizeof(patch_body)));
+    CHECK(!delta_patch_feed(&patch, patch_body, 1));
+    CHECK(!delta_patch_complete(&patch));
+}
+
+int main(void)
+{
+    RUN_TEST(test_header);
+    RUN_TEST(test_tool_patch);
+    RUN_TEST(test_every_split);
+    RUN_TEST(test_seek_backwards);
+    RUN_TEST(test_malformed_records);
+    RUN_TEST(test_callback_failures);
+    return TEST_EXIT_CODE();
+}
@@ -0,0 +1,225 @@
+/**
+ * Form parser tests
+ * Fixed cases for the field table and errors, then a randomized fuzz
+ * that feeds each body in one piece and in random chunks and requires
+ * the same outcome. Set FORM_FUZZ_ITERATIONS for a longer run.
+ */
+
+#include "form_parser.h"
+#include "test_common.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_FUZZ_ITERATIONS 200000
+
+typedef struct {
+    char ssid[33];
+    char pass[9];
+    int32_t number;
+    bool flag;
+    bool seen[4];
+    char log[512];      // Keys and values passed to the callback
+    size_t log_len;
+} form_result_t;
+
+static form_status_t log_value(void *ctx, const char *key, const char *value)
+{
+    form_result_t *result = ctx;
+    int written = snprintf(result->log + result->log_len, sizeof(result->log) - result->log_len,
+                           "%s=%s;", key, value);
+    if (written > 0 && (size_t)written < sizeof(result->log) - result->log_len) {
+        result->log_len += written;
+    }
+    return strcmp(key, "reject") == 0 ? FORM_ERR_REJECTED : FORM_OK;
+}
+
+/**
+ * Parse a body fed in pieces ending at each of cuts[] (ascending)
+ */
+static form_status_t parse_chunked(const char *body, size_t len, const size_t *cuts, int cut_count,
+                                   form_result_t *result, bool with_callback)
+{
+    memset(result, 0x5A, sizeof(*result));
+    result->log_len = 0;
+    result->log[0] = '\0';
+
+    form_field_t fields[] = {
+        { "ssid", FORM_FIELD_STRING, result->ssid, sizeof(result->ssid), false },
+        { "pass", FORM_FIELD_STRING, result->pass, sizeof(result->pass), false },
+        { "n", FORM_FIELD_INT, &result->number, 0, false },
+        { "b", FORM_FIELD_BOOL, &result->flag, 0, false },
+    };
+    form_parser_t parser;
+    form_parser_init(&parser, fields, 4, with_callback ? log_value : NULL, result);
+
+    size_t pos = 0;
+    for (int i = 0; i < cut_count; i++) {
+        form_parser_feed(&parser, body + pos, cuts[i] - pos);
+        pos = cuts[i];
+    }
+    form_parser_feed(&parser, body + pos, len - pos);
+    form_status_t status = form_parser_finish(&parser);
+
+    for (int i = 0; i < 4; i++) {
+        result->seen[i] = fields[i].seen;
+    }
+    if (status == FORM_OK) {
+        // String targets are always terminated inside their buffer
+        if (fields[0].seen) {
+            CHECK(memchr(result->ssid, '\0', sizeof(result->ssid)) != NULL);
+        }
+        if (fields[1].seen) {
+            CHECK(memchr(result->pass, '\0', sizeof(result->pass)) != NULL);
+        }
+    }
+    return status;
+}
+
+static form_status_t parse(const char *body, form_result_t *result, bool with_callback)
+{
+    return parse_chunked(body, strlen(body), NULL, 0, result, with_callback);
+}
+
+static void test_exact_key_match(void)
+{
+    form_result_t result;
+    CHECK_EQ(parse("ssid=My+Net%21&pass=abc&password=zzzzzzzzzzzz", &result, true), FORM_OK);
+    CHECK(strcmp(result.ssid, "My Net!") == 0);
+    CHECK(strcmp(result.pass, "abc") == 0);
+    // "password" is not "pass": it goes to the callback, not the 9-byte buffer
+    CHECK(strstr(result.log, "password=zzzzzzzzzzzz;") != NULL);
+
+    CHECK_EQ(parse("password=x&ssid=net", &result, false), FORM_OK);
+    CHECK(!result.seen[1]);
+    CHECK(result.seen[0]);
+}
+
+static void test_value_limits(void)
+{
+    form_result_t result;
+    CHECK_EQ(parse("pass=12345678", &result, false), FORM_OK);
+    CHECK(strcmp(result.pass, "12345678") == 0);
+    CHECK_EQ(parse("pass=123456789", &result, false), FORM_ERR_VALUE_TOO_LONG);
+    // Escapes count once decoded
+    CHECK_EQ(parse("pass=%41%41%41%41%41%41%41%41", &result, false), FORM_OK);
+    CHECK(strcmp(result.pass, "AAAAAAAA") == 0);
+
+    char key[FORM_MAX_KEY_LEN + 8];
+    memset(key, 'k', sizeof(key) - 3);
+    strcpy(key + sizeof(key) - 3, "=1");
+    CHECK_EQ(parse(key, &result, false), FORM_ERR_KEY_TOO_LONG);
+}
+
+static void test_typed_fields(void)
+{
+    form_result_t result;
+    CHECK_EQ(parse("n=-42&b=on", &result, false), FORM_OK);
+    CHECK_EQ(result.number, -42);
+    CHECK(result.flag);
+    CHECK_EQ(parse("b=0", &result, false), FORM_OK);
+    CHECK(!result.flag);
+    CHECK_EQ(parse("n=4x", &result, false), FORM_ERR_BAD_VALUE);
+    CHECK_EQ(parse("n=", &result, false), FORM_ERR_BAD_VALUE);
+}
+
+static void test_escape_errors(void)
+{
+    form_result_t result;
+    CHECK_EQ(parse("ssid=%4", &result, false), FORM_ERR_BAD_ESCAPE);
+    CHECK_EQ(parse("ssid=%G1", &result, false), FORM_ERR_BAD_ESCAPE);
+    CHECK_EQ(parse("ssid=%00", &result, false), FORM_ERR_BAD_ESCAPE);
+    CHECK_EQ(parse("reject=1&ssid=late", &result, true), FORM_ERR_REJECTED);
+    CHECK(!result.seen[0]);     // Nothing parsed after the error
+}
+
+static void test_empty_fields(void)
+{
+    form_result_t result;
+    CHECK_EQ(parse("&&ssid&", &result, false), FORM_OK);
+    CHECK(result.seen[0]);
+    CHECK_EQ(result.ssid[0], '\0');
+    CHECK_EQ(parse("", &result, false), FORM_OK);
+    CHECK(!result.seen[0]);
+}
+
+static void test_split_escape(void)
+{
+    form_result_t result;
+    const size_t cuts[] = { 3, 6, 8 };
+    CHECK_EQ(parse_chunked("ssid=a%2Fb", 10, cuts, 3, &result, false), FORM_OK);
+    CHECK(strcmp(result.ssid, "a/b") == 0);
+}
+
+static int same_result(const form_result_t *a, const form_result_t *b)
+{
+    if (memcmp(a->seen, b->seen, sizeof(a->seen)) != 0 || strcmp(a->log, b->log) != 0) {
+        return 0;
+    }
+    if (a->seen[0] && strcmp(a->ssid, b->ssid) != 0) {
+        return 0;
+    }
+    if (a->seen[1] && strcmp(a->pass, b->pass) != 0) {
+        return 0;
+    }
+    if (a->seen[2] && a->number != b->number) {
+        return 0;
+    }
+    return !a->seen[3] || a->flag == b->flag;
+}
+
+static void test_fuzz_chunking(void)
+{
+    static const char alphabet[] = "ab=&%+0F9sidpnrejctwo\x01\xff";
+    static const char *const tokens[] = { "ssid=", "pass=", "n=", "b=", "&", "%2", "reject=" };
+    const char *env = getenv("FORM_FUZZ_ITERATIONS");
+    long iterations = env ? atol(env) : DEFAULT_FUZZ_ITERATIONS;
+    form_result_t whole;
+    form_result_t chunked;
+
+    srand(1);
+    for (long it = 0; it < iterations; it++) {
+        char body[96];
+        size_t len = rand() % sizeof(body);
+        for (size_t i = 0; i < len; i++) {
+            if (rand() % 10 < 2) {
+                const char *token = tokens[rand() % 7];
+                size_t token_len = strlen(token);
+                if (i + token_len <= len) {
+                    memcpy(body + i, token, token_len);
+                    i += token_len - 1;
+                    continue;
+                }
+            }
+            body[i] = alphabet[rand() % (sizeof(alphabet) - 1)];
+        }
+
+        size_t cuts[4];
+        int cut_count = rand() % 5;
+        size_t last = 0;
+        for (int c = 0; c < cut_count; c++) {
+            last += (len > last) ? rand() % (len - last + 1) : 0;
+            cuts[c] = last;
+        }
+
+        bool with_callback = rand() & 1;
+        form_status_t s1 = parse_chunked(body, len, NULL, 0, &whole, with_callback);
+        form_status_t s2 = parse_chunked(body, len, cuts, cut_count, &chunked, with_callback);
+        if (s1 != s2 || (s1 == FORM_OK && !same_result(&whole, &chunked))) {
+            printf("  iteration %ld: %s vs %s\n", it, form_status_name(s1), form_status_name(s2));
+            CHECK(0);
+            return;
+        }
+    }
+}
+
+int main(void)
+{
+    RUN_TEST(test_exact_key_match);
+    RUN_TEST(test_value_limits);
+    RUN_TEST(test_typed_fields);
+    RUN_TEST(test_escape_errors);
+    RUN_TEST(test_empty_fields);
+    RUN_TEST(test_split_escape);
+    RUN_TEST(test_fuzz_chunking);
+    return TEST_EXIT_CODE();
+}
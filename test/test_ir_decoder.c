@@ -0,0 +1,173 @@
+/**
+ * IR decoder tests
+ * Decodes captures shaped like TSOP receiver output (active low, marks
+ * stretched and spaces shortened by ~50us, jitter on every edge) and
+ * round-trips everything the encoder produces.
+ */
+
+#include "ir_decoder.h"
+#include "test_common.h"
+#include <string.h>
+
+// Receiver output is active low: a mark is read as level 0
+#define SYM(mark, space) { .duration0 = (mark), .level0 = 0, .duration1 = (space), .level1 = 1 }
+
+// NEC remote, address 0xFF00 command 0x45 (the capture ends when the line goes idle)
+static const ir_symbol_t capture_nec[] = {
+    SYM(9050, 4481), SYM(625, 489), SYM(603, 526), SYM(634, 524), SYM(623, 493), SYM(603, 498),
+    SYM(613, 528), SYM(605, 503), SYM(626, 526), SYM(615, 1655), SYM(635, 1633), SYM(603, 1624),
+    SYM(607, 1646), SYM(640, 1620), SYM(637, 1657), SYM(636, 1623), SYM(625, 1657), SYM(614, 1658),
+    SYM(635, 522), SYM(618, 1634), SYM(609, 496), SYM(607, 494), SYM(619, 495), SYM(643, 1649),
+    SYM(606, 493), SYM(636, 490), SYM(612, 1637), SYM(606, 495), SYM(645, 1656), SYM(636, 1657),
+    SYM(639, 1647), SYM(631, 487), SYM(634, 1633), SYM(649, 0),
+};
+
+// Samsung TV remote, address 0x0707 command 0x02
+static const ir_symbol_t capture_samsung[] = {
+    SYM(4550, 4461), SYM(637, 1631), SYM(623, 1641), SYM(615, 1610), SYM(611, 486), SYM(649, 515),
+    SYM(605, 494), SYM(619, 497), SYM(631, 509), SYM(646, 1632), SYM(618, 1622), SYM(604, 1653),
+    SYM(632, 504), SYM(610, 482), SYM(621, 521), SYM(631, 504), SYM(602, 488), SYM(604, 482),
+    SYM(635, 1624), SYM(650, 510), SYM(621, 486), SYM(622, 492), SYM(631, 493), SYM(629, 526),
+    SYM(605, 513), SYM(630, 1616), SYM(642, 526), SYM(603, 1614), SYM(644, 1641), SYM(641, 1624),
+    SYM(643, 1632), SYM(618, 1615), SYM(624, 1618), SYM(622, 0),
+};
+
+// NEC repeat burst while a button is held
+static const ir_symbol_t capture_nec_repeat[] = {
+    SYM(9040, 2210), SYM(630, 0),
+};
+
+// Sony SIRC (not supported): 2.4ms leader, 12 bits of 1.2/0.6ms marks
+static const ir_symbol_t capture_sony[] = {
+    SYM(2430, 570), SYM(1230, 560), SYM(640, 570), SYM(1220, 580), SYM(630, 560), SYM(1240, 570),
+    SYM(620, 560), SYM(640, 570), SYM(1230, 560), SYM(630, 580), SYM(640, 570), SYM(620, 560),
+    SYM(650, 0),
+};
+
+#define COUNT(a) (sizeof(a) / sizeof((a)[0]))
+
+static void test_nec_capture(void)
+{
+    ir_code_t code;
+    CHECK_EQ(ir_decode(capture_nec, COUNT(capture_nec), &code), IR_DECODE_OK);
+    CHECK(!code.raw);
+    CHECK_EQ(code.protocol, IR_PROTOCOL_NEC);
+    CHECK_EQ(code.address, 0xFF00);
+    CHECK_EQ(code.command, 0x45);
+}
+
+static void test_samsung_capture(void)
+{
+    ir_code_t code;
+    CHECK_EQ(ir_decode(capture_samsung, COUNT(capture_samsung), &code), IR_DECODE_OK);
+    CHECK_EQ(code.protocol, IR_PROTOCOL_SAMSUNG);
+    CHECK_EQ(code.address, 0x0707);
+    CHECK_EQ(code.command, 0x02);
+}
+
+static void test_nec_repeat_capture(void)
+{
+    ir_code_t code;
+    memset(&code, 0xAA, sizeof(code));
+    CHECK_EQ(ir_decode(capture_nec_repeat, COUNT(capture_nec_repeat), &code), IR_DECODE_REPEAT);
+    CHECK_EQ(code.address, 0xAAAA);     // Untouched
+}
+
+static void test_unknown_protocol_kept_raw(void)
+{
+    ir_code_t code;
+    CHECK_EQ(ir_decode(capture_sony, COUNT(capture_sony), &code), IR_DECODE_RAW);
+    CHECK(code.raw);
+    CHECK_EQ(code.raw_count, COUNT(capture_sony));
+    // Normalized for the transmitter: mark high, closing gap added
+    CHECK_EQ(code.raw_symbols[0].level0, 1);
+    CHECK_EQ(code.raw_symbols[0].level1, 0);
+    CHECK_EQ(code.raw_symbols[0].duration0, 2430);
+    CHECK_EQ(code.raw_symbols[COUNT(capture_sony) - 1].duration1, IR_ENDING_GAP);
+}
+
+static void test_corrupted_nec_not_decoded_as_nec(void)
+{
+    ir_symbol_t symbols[COUNT(capture_nec)];
+    memcpy(symbols, capture_nec, sizeof(symbols));
+    symbols[20].duration1 = 1100;       // Neither a 0 nor a 1 space
+
+    ir_code_t code;
+    ir_decode_result_t result = ir_decode(symbols, COUNT(symbols), &code);
+    CHECK(result != IR_DECODE_OK || code.protocol != IR_PROTOCOL_NEC);
+
+    // Inverted command byte doesn't match
+    memcpy(symbols, capture_nec, sizeof(symbols));
+    symbols[25].duration1 = 1640;
+    result = ir_decode(symbols, COUNT(symbols), &code);
+    CHECK(result != IR_DECODE_OK || code.protocol != IR_PROTOCOL_NEC);
+}
+
+static void test_noise_rejected(void)
+{
+    ir_code_t code;
+    static const ir_symbol_t glitch[] = { SYM(80, 0) };
+    CHECK_EQ(ir_decode(glitch, COUNT(glitch), &code), IR_DECODE_INVALID);
+    CHECK_EQ(ir_decode(capture_sony, 2, &code), IR_DECODE_INVALID);
+    CHECK_EQ(ir_decode(NULL, 0, &code), IR_DECODE_INVALID);
+}
+
+// Receiver view of an encoded frame: active low, jittered, no trailing gap
+static size_t receive(const ir_symbol_t *sent, size_t count, ir_symbol_t *captured, int mark_pct, int space_pct)
+{
+    for (size_t i = 0; i < count; i++) {
+        captured[i].level0 = 0;
+        captured[i].duration0 = sent[i].duration0 * mark_pct / 100;
+        captured[i].level1 = 1;
+        captured[i].duration1 = (i + 1 == count) ? 0 : sent[i].duration1 * space_pct / 100;
+    }
+    return count;
+}
+
+static void test_round_trip_all_protocols(void)
+{
+    ir_symbol_t sent[IR_ENCODER_MAX_SYMBOLS];
+    ir_symbol_t captured[IR_ENCODER_MAX_SYMBOLS];
+    ir_code_t code;
+
+    static const ir_protocol_t pulse_distance[] = { IR_PROTOCOL_NEC, IR_PROTOCOL_SAMSUNG };
+    for (size_t p = 0; p < COUNT(pulse_distance); p++) {
+        for (int command = 0; command <= 0xFF; command++) {
+            size_t count = ir_encode_frame(pulse_distance[p], 0xFF00, command, false, sent, IR_ENCODER_MAX_SYMBOLS);
+            receive(sent, count, captured, 110, 90);
+            if (ir_decode(captured, count, &code) != IR_DECODE_OK || code.protocol != pulse_distance[p] ||
+                code.address != 0xFF00 || code.command != command) {
+                printf("  %s command 0x%02X\n", ir_protocol_name(pulse_distance[p]), command);
+                CHECK(0);
+                return;
+            }
+        }
+    }
+
+    for (int toggle = 0; toggle < 2; toggle++) {
+        for (int address = 0; address <= 0x1F; address++) {
+            for (int command = 0; command <= 0x7F; command++) {
+                size_t count = ir_encode_frame(IR_PROTOCOL_RC5, address, command, toggle, sent, IR_ENCODER_MAX_SYMBOLS);
+                receive(sent, count, captured, 110, 90);
+                if (ir_decode(captured, count, &code) != IR_DECODE_OK || code.protocol != IR_PROTOCOL_RC5 ||
+                    code.address != address || code.command != command) {
+                    printf("  RC5 address 0x%02X command 0x%02X toggle %d\n", address, command, toggle);
+                    CHECK(0);
+                    return;
+                }
+            }
+        }
+    }
+}
+
+int main(void)
+{
+    RUN_TEST(test_nec_capture);
+    RUN_TEST(test_samsung_capture);
+    RUN_TEST(test_nec_repeat_capture);
+    RUN_TEST(test_unknown_protocol_kept_raw);
+    RUN_TEST(test_corrupted_nec_not_decoded_as_nec);
+    RUN_TEST(test_noise_rejected);
+    RUN_TEST(test_round_trip_all_protocols);
+    return TEST_EXIT_CODE();
+}
@@ -0,0 +1,249 @@
+/**
+ * IR encoder timing tests
+ * Checks the generated RMT symbols against the protocol specifications
+ * (independent figures below, not the encoder's own constants).
+ */
+
+#include "ir_encoder.h"
+#include "test_common.h"
+#include <stdlib.h>
+
+// Published timings (microseconds)
+#define SPEC_NEC_LEAD_MARK      9000
+#define SPEC_NEC_LEAD_SPACE     4500
+#define SPEC_NEC_REPEAT_SPACE   2250
+#define SPEC_NEC_BIT_MARK       562.5
+#define SPEC_NEC_ZERO_SPACE     562.5
+#define SPEC_NEC_ONE_SPACE      1687.5
+#define SPEC_NEC_FRAME          67500   // Leader to end of stop bit, complemented bytes
+#define SPEC_SAMSUNG_LEAD       4500
+#define SPEC_RC5_HALF_BIT       888.9   // 64 cycles of 36 kHz
+#define SPEC_RC5_FRAME          24889   // 14 bits
+
+// Receivers accept a few percent; the encoder must sit well inside that
+#define SPEC_TOLERANCE          0.02
+
+static int near(double actual, double spec)
+{
+    return abs((int)(actual - spec)) <= spec * SPEC_TOLERANCE;
+}
+
+// Every symbol is mark then space, as the RMT carrier expects
+static void check_mark_space(const ir_symbol_t *symbols, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        CHECK_EQ(symbols[i].level0, 1);
+        CHECK_EQ(symbols[i].level1, 0);
+        CHECK(symbols[i].duration0 > 0);
+    }
+    CHECK_EQ(symbols[count - 1].duration1, IR_ENDING_GAP);
+}
+
+// Sum of all durations up to the end of the last mark
+static unsigned frame_duration(const ir_symbol_t *symbols, size_t count)
+{
+    unsigned total = 0;
+    for (size_t i = 0; i < count; i++) {
+        total += symbols[i].duration0;
+        if (i + 1 < count) {
+            total += symbols[i].duration1;
+        }
+    }
+    return total;
+}
+
+// Decode pulse-distance bits (NEC/Samsung) back into the 4 bytes, -1 on a bad bit
+static int decode_pulse_distance(const ir_symbol_t *symbols, uint8_t bytes[4])
+{
+    for (int i = 0; i < 32; i++) {
+        const ir_symbol_t *bit = &symbols[1 + i];
+        if (!near(bit->duration0, SPEC_NEC_BIT_MARK)) {
+            return -1;
+        }
+        if (near(bit->duration1, SPEC_NEC_ONE_SPACE)) {
+            bytes[i / 8] |= 1 << (i % 8);
+        } else if (!near(bit->duration1, SPEC_NEC_ZERO_SPACE)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void test_nec_frame(void)
+{
+    ir_symbol_t symbols[IR_ENCODER_MAX_SYMBOLS];
+    size_t count = ir_encode_frame(IR_PROTOCOL_NEC, 0xBF40, 0x58, false, symbols, IR_ENCODER_MAX_SYMBOLS);
+
+    CHECK_EQ(count, 34);
+    check_mark_space(symbols, count);
+    CHECK(near(symbols[0].duration0, SPEC_NEC_LEAD_MARK));
+    CHECK(near(symbols[0].duration1, SPEC_NEC_LEAD_SPACE));
+    CHECK(near(symbols[33].duration0, SPEC_NEC_BIT_MARK));
+
+    uint8_t bytes[4] = {0};
+    CHECK_EQ(decode_pulse_distance(symbols, bytes), 0);
+    CHECK_EQ(bytes[0], 0x40);       // Address low byte first
+    CHECK_EQ(bytes[1], 0xBF);
+    CHECK_EQ(bytes[2], 0x58);
+    CHECK_EQ(bytes[3], 0xA7);       // Inverted command
+
+    // Complemented bytes give a fixed frame length
+    CHECK(near(frame_duration(symbols, count), SPEC_NEC_FRAME));
+}
+
+static void test_nec_extended_address(void)
+{
+    ir_symbol_t symbols[IR_ENCODER_MAX_SYMBOLS];
+    size_t count = ir_encode_frame(IR_PROTOCOL_NEC, 0xFF00, 0x02, false, symbols, IR_ENCODER_MAX_SYMBOLS);
+
+    CHECK_EQ(count, 34);
+    uint8_t bytes[4] = {0};
+    CHECK_EQ(decode_pulse_distance(symbols, bytes), 0);
+    CHECK_EQ(bytes[0], 0x00);
+    CHECK_EQ(bytes[1], 0xFF);
+    CHECK_EQ(bytes[2], 0x02);
+    CHECK_EQ(bytes[3], 0xFD);
+}
+
+static void test_nec_repeat(void)
+{
+    ir_symbol_t symbols[IR_ENCODER_MAX_SYMBOLS];
+    size_t count = ir_encode_frame(IR_PROTOCOL_NEC_REPEAT, 0, 0, false, symbols, IR_ENCODER_MAX_SYMBOLS);
+
+    CHECK_EQ(count, 2);
+    check_mark_space(symbols, count);
+    CHECK(near(symbols[0].duration0, SPEC_NEC_LEAD_MARK));
+    CHECK(near(symbols[0].duration1, SPEC_NEC_REPEAT_SPACE));
+    CHECK(near(symbols[1].duration0, SPEC_NEC_BIT_MARK));
+}
+
+static void test_samsung_frame(void)
+{
+    ir_symbol_t symbols[IR_ENCODER_MAX_SYMBOLS];
+    size_t count = ir_encode_frame(IR_PROTOCOL_SAMSUNG, 0x0707, 0x02, false, symbols, IR_ENCODER_MAX_SYMBOLS);
+
+    CHECK_EQ(count, 34);
+    check_mark_space(symbols, count);
+    CHECK(near(symbols[0].duration0, SPEC_SAMSUNG_LEAD));
+    CHECK(near(symbols[0].duration1, SPEC_SAMSUNG_LEAD));
+
+    uint8_t bytes[4] = {0};
+    CHECK_EQ(decode_pulse_distance(symbols, bytes), 0);
+    CHECK_EQ(bytes[0], 0x07);
+    CHECK_EQ(bytes[1], 0x07);
+    CHECK_EQ(bytes[2], 0x02);
+    CHECK_EQ(bytes[3], 0xFD);
+}
+
+/**
+ * Rebuild the RC5 half-bit levels from the symbols and decode the
+ * Manchester bits (1 = space then mark). The idle space before S1 is
+ * not transmitted, so the first half is implied.
+ * @return 14-bit frame, -1 if the waveform isn't valid Manchester code
+ */
+static int decode_rc5(const ir_symbol_t *symbols, size_t count)
+{
+    uint8_t halves[RC5_FRAME_BITS * 2 + 2];
+    size_t n = 0;
+    halves[n++] = 0;
+
+    for (size_t i = 0; i < count; i++) {
+        int mark_halves = (int)(symbols[i].duration0 / SPEC_RC5_HALF_BIT + 0.5);
+        if (mark_halves < 1 || mark_halves > 2 || !near(symbols[i].duration0, mark_halves * SPEC_RC5_HALF_BIT)) {
+            return -1;
+        }
+        for (int h = 0; h < mark_halves && n < sizeof(halves); h++) {
+            halves[n++] = 1;
+        }
+        if (i + 1 == count) {
+            break;
+        }
+        int space_halves = (int)(symbols[i].duration1 / SPEC_RC5_HALF_BIT + 0.5);
+        if (space_halves < 1 || space_halves > 2 || !near(symbols[i].duration1, space_halves * SPEC_RC5_HALF_BIT)) {
+            return -1;
+        }
+        for (int h = 0; h < space_halves && n < sizeof(halves); h++) {
+            halves[n++] = 0;
+        }
+    }
+    // A frame ending in a 0 bit ends with a space, which merges into the gap
+    if (n == RC5_FRAME_BITS * 2 - 1) {
+        halves[n++] = 0;
+    }
+    if (n != RC5_FRAME_BITS * 2) {
+        return -1;
+    }
+
+    int frame = 0;
+    for (int i = 0; i < RC5_FRAME_BITS; i++) {
+        if (halves[i * 2] == halves[i * 2 + 1]) {
+            return -1;
+        }
+        frame = (frame << 1) | halves[i * 2 + 1];
+    }
+    return frame;
+}
+
+static void test_rc5_frame(void)
+{
+    ir_symbol_t symbols[IR_ENCODER_MAX_SYMBOLS];
+
+    // Command ending in a 1 bit: the frame ends with a mark
+    size_t count = ir_encode_frame(IR_PROTOCOL_RC5, 0x05, 0x35, false, symbols, IR_ENCODER_MAX_SYMBOLS);
+    CHECK(count > 0);
+    check_mark_space(symbols, count);
+    CHECK(near(frame_duration(symbols, count), SPEC_RC5_FRAME - SPEC_RC5_HALF_BIT));
+    // S1=1, S2=1 (command bit 6 clear), toggle 0, address 00101, command 110101
+    CHECK_EQ(decode_rc5(symbols, count), 0x3000 | (0x05 << 6) | 0x35);
+
+    // Toggle set, command ending in a 0 bit, extended command (bit 6 clears S2)
+    count = ir_encode_frame(IR_PROTOCOL_RC5, 0x1F, 0x74, true, symbols, IR_ENCODER_MAX_SYMBOLS);
+    CHECK(count > 0);
+    check_mark_space(symbols, count);
+    CHECK(near(frame_duration(symbols, count), SPEC_RC5_FRAME - 2 * SPEC_RC5_HALF_BIT));
+    CHECK_EQ(decode_rc5(symbols, count), 0x2000 | 0x0800 | (0x1F << 6) | 0x34);
+}
+
+static void test_rc5_every_code(void)
+{
+    ir_symbol_t symbols[IR_ENCODER_MAX_SYMBOLS];
+
+    for (int toggle = 0; toggle < 2; toggle++) {
+        for (int address = 0; address <= 0x1F; address++) {
+            for (int command = 0; command <= 0x7F; command++) {
+                size_t count = ir_encode_frame(IR_PROTOCOL_RC5, address, command, toggle,
+                                               symbols, IR_ENCODER_MAX_SYMBOLS);
+                int expected = 0x2000 | ((command & 0x40) ? 0 : 0x1000) | (toggle << 11) |
+                               (address << 6) | (command & 0x3F);
+                if (count == 0 || decode_rc5(symbols, count) != expected) {
+                    printf("  RC5 address 0x%02X command 0x%02X toggle %d\n", address, command, toggle);
+                    CHECK(0);
+                    return;
+                }
+            }
+        }
+    }
+}
+
+static void test_invalid_arguments(void)
+{
+    ir_symbol_t symbols[IR_ENCODER_MAX_SYMBOLS];
+
+    CHECK_EQ(ir_encode_frame(IR_PROTOCOL_NEC, 0xFF00, 0x02, false, symbols, IR_ENCODER_MAX_SYMBOLS - 1), 0);
+    CHECK_EQ(ir_encode_frame(IR_PROTOCOL_NEC_REPEAT, 0, 0, false, symbols, 1), 0);
+    CHECK_EQ(ir_encode_frame(IR_PROTOCOL_RC5, 0x20, 0x01, false, symbols, IR_ENCODER_MAX_SYMBOLS), 0);
+    CHECK_EQ(ir_encode_frame(IR_PROTOCOL_RC5, 0x01, 0x80, false, symbols, IR_ENCODER_MAX_SYMBOLS), 0);
+    CHECK_EQ(ir_encode_frame(IR_PROTOCOL_NEC, 0xFF00, 0x02, false, NULL, IR_ENCODER_MAX_SYMBOLS), 0);
+}
+
+int main(void)
+{
+    RUN_TEST(test_nec_frame);
+    RUN_TEST(test_nec_extended_address);
+    RUN_TEST(test_nec_repeat);
+    RUN_TEST(test_samsung_frame);
+    RUN_TEST(test_rc5_frame);
+    RUN_TEST(test_rc5_every_code);
+    RUN_TEST(test_invalid_arguments);
+    return TEST_EXIT_CODE();
+}
@@ -0,0 +1,492 @@
+/**
+ * LAN share protocol tests
+ * Wire format, tag checks and replay protection, then a simulation of
+ * several monitors on one multicast group: every packet goes through
+ * encode, decode and the replay filter of each receiver, next to an
+ * attacker that forges packets without the key and plays back packets
+ * it recorded.
+ */
+
+#include "lan_share_proto.h"
+#include "mbedtls/md.h"
+#include "mbedtls/sha256.h"
+#include "test_common.h"
+#include <string.h>
+
+#define T0          1760000000u     // Wall clock at the start of the simulation
+#define TICK_MS     250
+#define NODES       4
+
+static void key_from(const char *passphrase, uint8_t key[LAN_SHARE_KEY_LEN])
+{
+    mbedtls_sha256((const unsigned char *)passphrase, strlen(passphrase), key, 0);
+}
+
+static void hex(const uint8_t *bytes, size_t len, char *out)
+{
+    for (size_t i = 0; i < len; i++) {
+        sprintf(out + i * 2, "%02x", bytes[i]);
+    }
+}
+
+// The MAC tests mean nothing if the host SHA-256/HMAC is wrong
+static void test_digest_vectors(void)
+{
+    uint8_t digest[32];
+    char text[65];
+
+    mbedtls_sha256((const unsigned char *)"abc", 3, digest, 0);
+    hex(digest, 32, text);
+    CHECK(strcmp(text, "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad") == 0);
+
+    // RFC 4231 test case 2
+    const char *data = "what do ya want for nothing?";
+    mbedtls_md_hmac(mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), (const unsigned char *)"Jefe", 4,
+                    (const unsigned char *)data, strlen(data), digest);
+    hex(digest, 32, text);
+    CHECK(strcmp(text, "5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843") == 0);
+}
+
+static void test_round_trip(void)
+{
+    uint8_t key[LAN_SHARE_KEY_LEN];
+    key_from("correct horse", key);
+    uint8_t buf[LAN_SHARE_PACKET_MAX];
+    lan_msg_t msg = {0};
+    lan_msg_t out;
+
+    msg.type = LAN_MSG_READING;
+    msg.node_id = 0xAABBCCDDEEFFULL;
+    msg.time = T0;
+    msg.seq = 7;
+    msg.reading.reading.time = T0 - 60;
+    msg.reading.reading.mgdl = 123;
+    msg.reading.reading.trend = 3;
+    msg.reading.reading.is_low = true;
+    strcpy(msg.reading.reading.timestamp, "10/9/2025 8:52:20 AM");
+    size_t len = lan_msg_encode(&msg, key, buf, sizeof(buf));
+    CHECK(len > 0);
+    CHECK(lan_msg_decode(buf, len, key, &out));
+    CHECK_EQ(out.type, LAN_MSG_READING);
+    CHECK_EQ(out.node_id, msg.node_id);
+    CHECK_EQ(out.time, T0);
+    CHECK_EQ(out.seq, 7);
+    CHECK_EQ(out.reading.reading.mgdl, 123);
+    CHECK(out.reading.reading.is_low && !out.reading.reading.is_high);
+    CHECK(strcmp(out.reading.reading.timestamp, msg.reading.reading.timestamp) == 0);
+    CHECK(!lan_msg_decode(buf, len - 1, key, &out));
+    CHECK_EQ(lan_msg_encode(&msg, key, buf, len - 1), 0);
+
+    // A full graph is the largest packet
+    memset(&msg, 0, sizeof(msg));
+    msg.type = LAN_MSG_GRAPH;
+    msg.node_id = 1;
+    msg.graph.count = LAN_SHARE_GRAPH_MAX_POINTS;
+    for (int i = 0; i < LAN_SHARE_GRAPH_MAX_POINTS; i++) {
+        msg.graph.points[i].time = T0 + i * 300;
+        msg.graph.points[i].mgdl = 100 + i;
+    }
+    len = lan_msg_encode(&msg, key, buf, sizeof(buf));
+    CHECK_EQ(len, LAN_SHARE_PACKET_MAX);
+    CHECK(lan_msg_decode(buf, len, key, &out));
+    CHECK_EQ(out.graph.count, LAN_SHARE_GRAPH_MAX_POINTS);
+    CHECK_EQ(out.graph.points[LAN_SHARE_GRAPH_MAX_POINTS - 1].mgdl, 100 + LAN_SHARE_GRAPH_MAX_POINTS - 1);
+}
+
+static void test_forgery_rejected(void)
+{
+    uint8_t key[LAN_SHARE_KEY_LEN];
+    uint8_t other[LAN_SHARE_KEY_LEN];
+    key_from("correct horse", key);
+    key_from("correct horsf", other);
+
+    lan_msg_t msg = { .type = LAN_MSG_READING, .node_id = 0x10, .time = T0, .seq = 1 };
+    msg.reading.reading.mgdl = 250;
+    uint8_t buf[LAN_SHARE_PACKET_MAX];
+    size_t len = lan_msg_encode(&msg, key, buf, sizeof(buf));
+    lan_msg_t out;
+    CHECK(!lan_msg_decode(buf, len, other, &out));
+
+    // Any single changed bit anywhere in the packet
+    for (size_t i = 0; i < len; i++) {
+        for (int bit = 0; bit < 8; bit++) {
+            buf[i] ^= 1 << bit;
+            if (lan_msg_decode(buf, len, key, &out)) {
+                printf("  accepted with byte %zu bit %d flipped\n", i, bit);
+                CHECK(0);
+                return;
+            }
+            buf[i] ^= 1 << bit;
+        }
+    }
+    CHECK(lan_msg_decode(buf, len, key, &out));
+}
+
+static void test_graph_merge(void)
+{
+    lan_point_t points[LAN_SHARE_GRAPH_MAX_POINTS];
+    for (int i = 0; i < LAN_SHARE_GRAPH_MAX_POINTS; i++) {
+        points[i] = (lan_point_t){ .time = T0 + i * 300, .mgdl = 100 + i };
+    }
+    lan_point_t graph[LAN_SHARE_GRAPH_MAX_POINTS];
+    size_t count = 0;
+
+    // Newest half first, then everything: only the missing points go in, in order
+    CHECK_EQ(lan_graph_merge(graph, &count, points + 100, 44), 44);
+    CHECK_EQ(lan_graph_merge(graph, &count, points, LAN_SHARE_GRAPH_MAX_POINTS), 100);
+    CHECK_EQ(count, LAN_SHARE_GRAPH_MAX_POINTS);
+    for (size_t i = 1; i < count; i++) {
+        CHECK(graph[i].time > graph[i - 1].time);
+    }
+
+    // A full graph drops its oldest point
+    lan_point_t next = { .time = T0 + LAN_SHARE_GRAPH_MAX_POINTS * 300, .mgdl = 50 };
+    CHECK_EQ(lan_graph_merge(graph, &count, &next, 1), 1);
+    CHECK_EQ(count, LAN_SHARE_GRAPH_MAX_POINTS);
+    CHECK_EQ(graph[0].time, T0 + 300);
+    CHECK_EQ(graph[count - 1].time, next.time);
+
+    // Points without a time are ignored; a jump past 12 hours keeps only the new one
+    lan_point_t none = { .time = 0, .mgdl = 80 };
+    CHECK_EQ(lan_graph_merge(graph, &count, &none, 1), 0);
+    lan_point_t far = { .time = next.time + 13 * 3600, .mgdl = 60 };
+    lan_graph_merge(graph, &count, &far, 1);
+    CHECK_EQ(count, 1);
+}
+
+static lan_msg_t header(uint64_t node_id, uint32_t time, uint32_t seq)
+{
+    lan_msg_t msg = { .type = LAN_MSG_HELLO, .node_id = node_id, .time = time, .seq = seq };
+    return msg;
+}
+
+static void test_replay_window(void)
+{
+    lan_replay_t replay;
+    lan_replay_init(&replay);
+    lan_msg_t msg;
+
+    msg = header(0x10, T0, 1);
+    CHECK(lan_replay_accept(&replay, &msg, T0, 0));
+    CHECK(!lan_replay_accept(&replay, &msg, T0, 10));              // Same packet again
+    msg = header(0x10, T0, 2);
+    CHECK(lan_replay_accept(&replay, &msg, T0, 20));
+    msg = header(0x10, T0 - 1, 3);
+    CHECK(!lan_replay_accept(&replay, &msg, T0, 30));              // Sender time went back
+
+    // Reboot: the counter restarts but the clock has moved on
+    msg = header(0x10, T0 + 20, 1);
+    CHECK(lan_replay_accept(&replay, &msg, T0 + 20, 40));
+    msg = header(0x10, T0, 5);
+    CHECK(!lan_replay_accept(&replay, &msg, T0 + 20, 50));         // Recorded before the reboot
+
+    // Stale or future packets from a peer we haven't heard yet
+    msg = header(0x20, T0 - LAN_SHARE_MAX_SKEW_S - 1, 1);
+    CHECK(!lan_replay_accept(&replay, &msg, T0, 60));
+    msg = header(0x20, T0 + LAN_SHARE_MAX_SKEW_S + 1, 1);
+    CHECK(!lan_replay_accept(&replay, &msg, T0, 60));
+    msg = header(0x20, T0 - LAN_SHARE_MAX_SKEW_S, 1);
+    CHECK(lan_replay_accept(&replay, &msg, T0, 60));
+
+    // Before SNTP our clock can't judge freshness; ordering still applies
+    lan_replay_init(&replay);
+    msg = header(0x30, 5000, 9);
+    CHECK(lan_replay_accept(&replay, &msg, 42, 0));
+    CHECK(!lan_replay_accept(&replay, &msg, 42, 0));
+}
+
+static void test_replay_table_full(void)
+{
+    lan_replay_t replay;
+    lan_replay_init(&replay);
+    lan_msg_t msg;
+
+    for (int i = 0; i < LAN_SHARE_MAX_PEERS; i++) {
+        msg = header(0x100 + i, T0, 1);
+        CHECK(lan_replay_accept(&replay, &msg, T0, 1000 + i));
+    }
+    // Peer 0x100 is heard again, so 0x101 is now the quietest
+    msg = header(0x100, T0, 2);
+    CHECK(lan_replay_accept(&replay, &msg, T0, 2000));
+    msg = header(0x200, T0, 1);
+    CHECK(lan_replay_accept(&replay, &msg, T0, 2001));
+
+    msg = header(0x100, T0, 2);
+    CHECK(!lan_replay_accept(&replay, &msg, T0, 2002));            // Still remembered
+    msg = header(0x102, T0, 1);
+    CHECK(!lan_replay_accept(&replay, &msg, T0, 2003));
+    msg = header(0x0, T0, 1);
+    CHECK(!lan_replay_accept(&replay, &msg, T0, 2004));
+}
+
+/* Simulated household */
+
+typedef struct {
+    uint64_t id;
+    uint8_t key[LAN_SHARE_KEY_LEN];
+    bool alive;
+    bool eligible;
+    lan_election_t election;
+    lan_replay_t replay;
+    uint32_t seq;
+    int readings;               // Accepted from the leader
+    uint16_t last_mgdl;
+    uint64_t last_from;
+} node_t;
+
+static node_t nodes[NODES];
+static uint32_t sim_ms;
+
+// Attacker: no key, records every packet on the wire
+static uint8_t recorded[64][LAN_SHARE_PACKET_MAX];
+static size_t recorded_len[64];
+static int recorded_count;
+
+static uint32_t wall_s(void)
+{
+    return T0 + sim_ms / 1000;
+}
+
+static void deliver(const uint8_t *buf, size_t len, int from)
+{
+    for (int j = 0; j < NODES; j++) {
+        node_t *node = &nodes[j];
+        lan_msg_t msg;
+        if (j == from || !node->alive || !lan_msg_decode(buf, len, node->key, &msg) ||
+            msg.node_id == node->id || !lan_replay_accept(&node->replay, &msg, wall_s(), sim_ms)) {
+            continue;
+        }
+        if (msg.type == LAN_MSG_HELLO) {
+            lan_election_on_hello(&node->election, msg.node_id, msg.hello.leader, sim_ms);
+        } else if (msg.type == LAN_MSG_READING && lan_election_accepts(&node->election, msg.node_id)) {
+            node->readings++;
+            node->last_mgdl = msg.reading.reading.mgdl;
+            node->last_from = msg.node_id;
+        }
+    }
+}
+
+static void broadcast(int from, lan_msg_t *msg)
+{
+    uint8_t buf[LAN_SHARE_PACKET_MAX];
+    msg->node_id = nodes[from].id;
+    msg->time = wall_s();
+    msg->seq = ++nodes[from].seq;
+    size_t len = lan_msg_encode(msg, nodes[from].key, buf, sizeof(buf));
+    CHECK(len > 0);
+    if (recorded_count < 64) {
+        memcpy(recorded[recorded_count], buf, len);
+        recorded_len[recorded_count++] = len;
+    }
+    deliver(buf, len, from);
+}
+
+static void boot(int i)
+{
+    nodes[i].alive = true;
+    nodes[i].seq = 0;
+    lan_election_init(&nodes[i].election, nodes[i].id, sim_ms);
+    lan_replay_init(&nodes[i].replay);
+}
+
+static void run_for(uint32_t ms)
+{
+    for (uint32_t end = sim_ms + ms; sim_ms < end; sim_ms += TICK_MS) {
+        for (int i = 0; i < NODES; i++) {
+            node_t *node = &nodes[i];
+            if (node->alive && lan_election_tick(&node->election, node->eligible, sim_ms)) {
+                lan_msg_t msg = { .type = LAN_MSG_HELLO };
+                msg.hello.leader = node->election.role == LAN_ROLE_LEADER;
+                msg.hello.eligible = node->eligible;
+                broadcast(i, &msg);
+            }
+        }
+    }
+}
+
+static int leader(void)
+{
+    int found = -1;
+    for (int i = 0; i < NODES; i++) {
+        if (nodes[i].alive && nodes[i].election.role == LAN_ROLE_LEADER) {
+            if (found >= 0) {
+                return -2;      // More than one
+            }
+            found = i;
+        }
+    }
+    return found;
+}
+
+static void publish(int from, uint16_t mgdl)
+{
+    lan_msg_t msg = { .type = LAN_MSG_READING };
+    msg.reading.reading.time = wall_s();
+    msg.reading.reading.mgdl = mgdl;
+    broadcast(from, &msg);
+}
+
+static void reset_counts(void)
+{
+    for (int i = 0; i < NODES; i++) {
+        nodes[i].readings = 0;
+        nodes[i].last_from = 0;
+    }
+}
+
+// Every live node except the leader got exactly one reading from it
+static void check_followers_got(int from, uint16_t mgdl)
+{
+    for (int i = 0; i < NODES; i++) {
+        if (i == from || !nodes[i].alive) {
+            continue;
+        }
+        CHECK_EQ(nodes[i].readings, 1);
+        CHECK_EQ(nodes[i].last_mgdl, mgdl);
+        CHECK_EQ(nodes[i].last_from, nodes[from].id);
+    }
+}
+
+// Packet forged by someone without the key, claiming to be a leader
+static void inject_forged_leader(uint64_t id, const uint8_t *wrong_key)
+{
+    uint8_t buf[LAN_SHARE_PACKET_MAX];
+    lan_msg_t msg = { .type = LAN_MSG_HELLO, .node_id = id, .time = wall_s(), .seq = 1 };
+    msg.hello.leader = true;
+    size_t len = lan_msg_encode(&msg, wrong_key, buf, sizeof(buf));
+    deliver(buf, len, -1);
+
+    msg.type = LAN_MSG_READING;
+    msg.seq = 2;
+    msg.reading.reading.mgdl = 39;
+    len = lan_msg_encode(&msg, wrong_key, buf, sizeof(buf));
+    deliver(buf, len, -1);
+}
+
+static void test_household_simulation(void)
+{
+    static const uint64_t ids[NODES] = { 0x10, 0x23, 0x37, 0x41 };
+    uint8_t attacker_key[LAN_SHARE_KEY_LEN];
+    key_from("guessed wrong", attacker_key);
+
+    memset(nodes, 0, sizeof(nodes));
+    sim_ms = 0;
+    recorded_count = 0;
+    for (int i = 0; i < NODES; i++) {
+        nodes[i].id = ids[i];
+        key_from("household passphrase", nodes[i].key);
+        nodes[i].eligible = i != 3;     // Node 3 has no LibreLinkUp credentials
+        boot(i);
+    }
+
+    // One eligible leader; everyone follows it
+    run_for(30000);
+    int first = leader();
+    CHECK(first >= 0 && first != 3);
+    if (first < 0) {
+        return;
+    }
+    reset_counts();
+    publish(first, 140);
+    check_followers_got(first, 140);
+
+    // A forged leader with the highest id is ignored
+    reset_counts();
+    inject_forged_leader(0xFFFFFFFFFFFFULL, attacker_key);
+    run_for(1000);
+    CHECK_EQ(leader(), first);
+    for (int i = 0; i < NODES; i++) {
+        CHECK_EQ(nodes[i].readings, 0);
+        CHECK(nodes[i].election.leader_id != 0xFFFFFFFFFFFFULL);
+    }
+
+    // Played back packets (including the old reading) change nothing
+    for (int r = 0; r < recorded_count; r++) {
+        deliver(recorded[r], recorded_len[r], -1);
+    }
+    for (int i = 0; i < NODES; i++) {
+        CHECK_EQ(nodes[i].readings, 0);
+    }
+
+    // The leader dies; an eligible follower takes over
+    nodes[first].alive = false;
+    run_for(30000);
+    int second = leader();
+    CHECK(second >= 0 && second != 3 && second != first);
+    if (second < 0) {
+        return;
+    }
+    reset_counts();
+    publish(second, 155);
+    check_followers_got(second, 155);
+
+    // The old leader reboots (counter restarts) and rejoins as a follower
+    boot(first);
+    run_for(60000);
+    CHECK_EQ(leader(), second);
+    CHECK(lan_election_accepts(&nodes[first].election, nodes[second].id));
+
+    // Packets recorded earlier stay dead, even to a node that has
+    // forgotten every peer, once they are older than the clock skew allowed
+    run_for(LAN_SHARE_MAX_SKEW_S * 1000);
+    reset_counts();
+    lan_replay_init(&nodes[3].replay);
+    for (int r = 0; r < recorded_count; r++) {
+        deliver(recorded[r], recorded_len[r], -1);
+    }
+    for (int i = 0; i < NODES; i++) {
+        CHECK_EQ(nodes[i].readings, 0);
+    }
+
+    // Split brain: every eligible node thinks it leads
+    for (int i = 0; i < NODES; i++) {
+        if (nodes[i].eligible) {
+            nodes[i].election.role = LAN_ROLE_LEADER;
+            nodes[i].election.leader_id = nodes[i].id;
+        }
+    }
+    run_for(20000);
+    int resolved = leader();
+    CHECK(resolved >= 0);
+
+    // A monitor with a different passphrase neither follows nor is followed
+    key_from("another household", nodes[3].key);
+    nodes[3].eligible = true;
+    boot(3);
+    run_for(40000);
+    CHECK_EQ(nodes[3].election.role, LAN_ROLE_LEADER);
+    CHECK(nodes[3].election.leader_id == nodes[3].id);
+    int i_leader = -1;
+    for (int i = 0; i < 3; i++) {
+        if (nodes[i].alive && nodes[i].election.role == LAN_ROLE_LEADER) {
+            CHECK(i_leader < 0);
+            i_leader = i;
+        }
+    }
+    CHECK(i_leader >= 0);
+    if (i_leader < 0) {
+        return;
+    }
+    reset_counts();
+    publish(3, 77);
+    for (int i = 0; i < 3; i++) {
+        CHECK_EQ(nodes[i].readings, 0);
+    }
+
+    // The leader loses its credentials and hands over
+    nodes[i_leader].eligible = false;
+    run_for(40000);
+    CHECK_EQ(nodes[i_leader].election.role, LAN_ROLE_FOLLOWER);
+}
+
+int main(void)
+{
+    RUN_TEST(test_digest_vectors);
+    RUN_TEST(test_round_trip);
+    RUN_TEST(test_forgery_rejected);
+    RUN_TEST(test_graph_merge);
+    RUN_TEST(test_replay_window);
+    RUN_TEST(test_replay_table_full);
+    RUN_TEST(test_household_simulation);
+    return TEST_EXIT_CODE();
+}
@@ -0,0 +1,385 @@
+/**
+ * MQTT publisher tests against the esp-mqtt stand-in
+ * Broker configuration and last will, Home Assistant discovery, retained
+ * state published on change and again on every connect, the offline
+ * reading buffer, non-retained health, and commands from the broker.
+ * The tests share the publisher's state and run in order.
+ */
+
+#include "mqtt_publisher.h"
+#include "nvs_journal.h"
+#include "host_idf.h"
+#include "esp_timer.h"
+#include "test_common.h"
+#include <stdio.h>
+#include <string.h>
+
+#define NODE        "gm_a1b2c3"
+#define BASE        "glucose_monitor/" NODE
+#define ENTITIES    13
+
+static int command_count = 0;
+static mqtt_command_t last_command;
+static int last_arg;
+
+static void on_command(mqtt_command_t command, int arg)
+{
+    command_count++;
+    last_command = command;
+    last_arg = arg;
+}
+
+/**
+ * Check that text is one JSON object (structure only: strings, nesting)
+ */
+static bool is_json_object(const char *text)
+{
+    char stack[16];
+    int depth = 0;
+    bool in_string = false;
+    if (*text != '{') {
+        return false;
+    }
+    for (const char *p = text; *p; p++) {
+        if (in_string) {
+            if (*p == '\\' && p[1]) {
+                p++;
+            } else if (*p == '"') {
+                in_string = false;
+            }
+        } else if (*p == '"') {
+            in_string = true;
+        } else if (*p == '{' || *p == '[') {
+            if (depth == (int)sizeof(stack)) {
+                return false;
+            }
+            stack[depth++] = *p == '{' ? '}' : ']';
+        } else if (*p == '}' || *p == ']') {
+            if (depth == 0 || stack[--depth] != *p) {
+                return false;
+            }
+            if (depth == 0 && p[1]) {
+                return false;
+            }
+        }
+    }
+    return depth == 0 && !in_string;
+}
+
+static int discovery_count(void)
+{
+    int count = 0;
+    for (int i = 0; i < host_mqtt_message_count(); i++) {
+        const host_mqtt_message_t *m = host_mqtt_message(i);
+        count += strncmp(m->topic, "homeassistant/", 14) == 0;
+    }
+    return count;
+}
+
+static libre_glucose_data_t reading(int mgdl, int64_t unix_time)
+{
+    libre_glucose_data_t glucose = {
+        .value_mgdl = mgdl,
+        .value_mmol = mgdl / 18.0f,
+        .trend = LIBRE_TREND_RISING,
+        .unix_time = unix_time,
+    };
+    return glucose;
+}
+
+static void test_disabled_without_broker(void)
+{
+    char uri[MQTT_PUBLISHER_URI_MAX_LEN + 1];
+    char user[MQTT_PUBLISHER_USER_MAX_LEN + 1];
+    CHECK(!mqtt_publisher_get_config(uri, sizeof(uri), user, sizeof(user)));
+    CHECK_EQ(mqtt_publisher_start(), ESP_OK);
+    CHECK(host_mqtt_session() == NULL);
+
+    libre_glucose_data_t glucose = reading(120, 1700000000);
+    mqtt_publisher_publish_reading(&glucose, false);
+    mqtt_publisher_publish_health();
+    CHECK_EQ(host_mqtt_message_count(), 0);
+}
+
+static void test_config_validation(void)
+{
+    CHECK_EQ(mqtt_publisher_config_save("http://broker", "", ""), ESP_ERR_INVALID_ARG);
+    CHECK_EQ(mqtt_publisher_config_save("mqtt://bro\"ker", "", ""), ESP_ERR_INVALID_ARG);
+    CHECK_EQ(mqtt_publisher_config_save("mqtt://bro ker", "", ""), ESP_ERR_INVALID_ARG);
+    CHECK_EQ(mqtt_publisher_config_save("mqtt://broker", "us\\er", ""), ESP_ERR_INVALID_ARG);
+
+    char long_uri[MQTT_PUBLISHER_URI_MAX_LEN + 2];
+    memset(long_uri, 'a', sizeof(long_uri) - 1);
+    memcpy(long_uri, "mqtt://", 7);
+    long_uri[sizeof(long_uri) - 1] = '\0';
+    CHECK_EQ(mqtt_publisher_config_save(long_uri, "", ""), ESP_ERR_INVALID_ARG);
+
+    CHECK_EQ(host_mqtt_clients_created(), 0);
+    CHECK(!host_nvs_has_key("mqtt", "uri"));
+}
+
+static void test_session_and_last_will(void)
+{
+    CHECK_EQ(mqtt_publisher_config_save("mqtt://broker.local:1883", "user", "secret"), ESP_OK);
+    CHECK(host_nvs_has_key("mqtt", "uri"));
+    CHECK(host_nvs_has_key("mqtt", "pass"));
+
+    const host_mqtt_session_t *session = host_mqtt_session();
+    CHECK(session != NULL);
+    if (!session) {
+        return;
+    }
+    CHECK(strcmp(session->uri, "mqtt://broker.local:1883") == 0);
+    CHECK(strcmp(session->client_id, NODE) == 0);
+    CHECK(strcmp(session->username, "user") == 0);
+    CHECK(strcmp(session->password, "secret") == 0);
+    CHECK(strcmp(session->will_topic, BASE "/status") == 0);
+    CHECK(strcmp(session->will_msg, "offline") == 0);
+    CHECK_EQ(session->will_qos, 1);
+    CHECK(session->will_retain);
+
+    char uri[MQTT_PUBLISHER_URI_MAX_LEN + 1];
+    char user[MQTT_PUBLISHER_USER_MAX_LEN + 1];
+    CHECK(mqtt_publisher_get_config(uri, sizeof(uri), user, sizeof(user)));
+    CHECK(strcmp(uri, "mqtt://broker.local:1883") == 0);
+    CHECK(strcmp(user, "user") == 0);
+}
+
+static void test_offline_buffer_and_connect(void)
+{
+    // Not connected yet: the newest readings wait, states are remembered
+    host_mqtt_clear();
+    for (int i = 0; i < MQTT_PUBLISHER_OFFLINE_READINGS + 2; i++) {
+        libre_glucose_data_t glucose = reading(100 + i, 1700000000 + i * 60);
+        mqtt_publisher_publish_reading(&glucose, false);
+    }
+    mqtt_publisher_publish_alarm(false, false);
+    CHECK_EQ(host_mqtt_message_count(), 0);
+
+    host_mqtt_connect();
+
+    const host_mqtt_message_t *first = host_mqtt_message(0);
+    CHECK(first && strcmp(first->topic, BASE "/status") == 0);
+    CHECK(first && strcmp(first->payload, "online") == 0 && first->retain && first->qos == 1);
+
+    // Retained state with the latest values
+    const host_mqtt_message_t *m = host_mqtt_last(BASE "/glucose_mgdl");
+    CHECK(m && strcmp(m->payload, "113") == 0 && m->retain);
+    m = host_mqtt_last(BASE "/glucose");
+    CHECK(m && strcmp(m->payload, "6.3") == 0 && m->retain);
+    m = host_mqtt_last(BASE "/trend");
+    CHECK(m && strcmp(m->payload, "rising") == 0 && m->retain);
+    m = host_mqtt_last(BASE "/stale");
+    CHECK(m && strcmp(m->payload, "OFF") == 0 && m->retain);
+    m = host_mqtt_last(BASE "/alarm");
+    CHECK(m && strcmp(m->payload, "off") == 0 && m->retain);
+    CHECK_EQ(host_mqtt_count(BASE "/first_reading"), 0);     // Not known yet
+
+    // Buffered readings, oldest kept first, not retained
+    CHECK_EQ(host_mqtt_count(BASE "/reading"), MQTT_PUBLISHER_OFFLINE_READINGS);
+    int expected = 102;
+    for (int i = 0; i < host_mqtt_message_count(); i++) {
+        m = host_mqtt_message(i);
+        if (strcmp(m->topic, BASE "/reading") == 0) {
+            char prefix[16];
+            snprintf(prefix, sizeof(prefix), "{\"mgdl\":%d,", expected++);
+            CHECK(strncmp(m->payload, prefix, strlen(prefix)) == 0);
+            CHECK(is_json_object(m->payload));
+            CHECK(!m->retain);
+            CHECK_EQ(m->qos, 1);
+        }
+    }
+
+    CHECK(host_mqtt_subscribed(BASE "/cmd/#"));
+    CHECK(host_mqtt_subscribed("homeassistant/status"));
+}
+
+static void test_discovery(void)
+{
+    // Published by the connect in the previous test
+    CHECK_EQ(discovery_count(), ENTITIES);
+    for (int i = 0; i < host_mqtt_message_count(); i++) {
+        const host_mqtt_message_t *m = host_mqtt_message(i);
+        if (strncmp(m->topic, "homeassistant/", 14) != 0) {
+            continue;
+        }
+        CHECK(is_json_object(m->payload));
+        CHECK(m->retain);
+        CHECK_EQ(m->qos, 1);
+        CHECK(strstr(m->payload, "\"availability_topic\":\"" BASE "/status\"") != NULL);
+        CHECK(strstr(m->payload, "\"identifiers\":[\"" NODE "\"]") != NULL);
+
+        // homeassistant/<component>/<node>/<object>/config
+        char component[32];
+        char node[32];
+        char object[32];
+        CHECK_EQ(sscanf(m->topic, "homeassistant/%31[^/]/%31[^/]/%31[^/]/config", component, node, object), 3);
+        CHECK(strcmp(node, NODE) == 0);
+        char unique_id[64];
+        snprintf(unique_id, sizeof(unique_id), "\"unique_id\":\"%s_%s\"", NODE, object);
+        CHECK(strstr(m->payload, unique_id) != NULL);
+    }
+
+    const host_mqtt_message_t *m = host_mqtt_last("homeassistant/sensor/" NODE "/glucose/config");
+    CHECK(m && strstr(m->payload, "\"state_topic\":\"" BASE "/glucose\"") != NULL);
+    m = host_mqtt_last("homeassistant/sensor/" NODE "/rssi/config");
+    CHECK(m && strstr(m->payload, "\"state_topic\":\"" BASE "/health\"") != NULL);
+    CHECK(m && strstr(m->payload, "value_json.rssi") != NULL);
+    m = host_mqtt_last("homeassistant/sensor/" NODE "/first_reading/config");
+    CHECK(m && strstr(m->payload, "\"state_topic\":\"" BASE "/first_reading\"") != NULL);
+    CHECK(m && strstr(m->payload, "value_template") == NULL);
+    m = host_mqtt_last("homeassistant/button/" NODE "/snooze/config");
+    CHECK(m && strstr(m->payload, "\"command_topic\":\"" BASE "/cmd/snooze\"") != NULL);
+    CHECK(m && strstr(m->payload, "state_topic") == NULL);
+    m = host_mqtt_last("homeassistant/select/" NODE "/lamp/config");
+    CHECK(m && strstr(m->payload, "\"command_topic\":\"" BASE "/cmd/lamp\"") != NULL);
+}
+
+static void test_state_published_on_change(void)
+{
+    host_mqtt_clear();
+    mqtt_publisher_publish_alarm(false, false);                 // Unchanged
+    CHECK_EQ(host_mqtt_message_count(), 0);
+
+    mqtt_publisher_publish_alarm(true, false);
+    mqtt_publisher_publish_alarm(true, false);
+    mqtt_publisher_publish_alarm(true, true);
+    CHECK_EQ(host_mqtt_count(BASE "/alarm"), 2);
+    const host_mqtt_message_t *m = host_mqtt_last(BASE "/alarm");
+    CHECK(m && strcmp(m->payload, "snoozed") == 0 && m->retain);
+
+    // A new reading changes some topics and always sends the reading
+    host_mqtt_clear();
+    libre_glucose_data_t glucose = reading(113, 1700001000);
+    glucose.trend = LIBRE_TREND_STABLE;
+    mqtt_publisher_publish_reading(&glucose, true);
+    CHECK_EQ(host_mqtt_count(BASE "/glucose"), 0);
+    CHECK_EQ(host_mqtt_count(BASE "/glucose_mgdl"), 0);
+    CHECK_EQ(host_mqtt_count(BASE "/trend"), 1);
+    CHECK_EQ(host_mqtt_count(BASE "/stale"), 1);
+    CHECK_EQ(host_mqtt_count(BASE "/reading"), 1);
+    m = host_mqtt_last(BASE "/reading");
+    CHECK(m && strstr(m->payload, "\"stale\":true") != NULL);
+
+    mqtt_publisher_set_first_reading_ms(4321);
+    m = host_mqtt_last(BASE "/first_reading");
+    CHECK(m && strcmp(m->payload, "4321") == 0 && m->retain);
+}
+
+static void test_health_not_retained(void)
+{
+    host_time_advance_us(90 * 1000000LL);
+    host_mqtt_clear();
+    mqtt_publisher_publish_health();
+    mqtt_publisher_publish_health();
+
+    // Sent every time, never retained
+    CHECK_EQ(host_mqtt_message_count(), 2);
+    const host_mqtt_message_t *m = host_mqtt_last(BASE "/health");
+    char expected[128];
+    snprintf(expected, sizeof(expected), "{\"rssi\":%d,\"free_heap\":%d,\"uptime\":%lld,\"current_ma\":%d}",
+             HOST_WIFI_RSSI, HOST_FREE_HEAP, (long long)(esp_timer_get_time() / 1000000), HOST_CURRENT_MA);
+    CHECK(m && strcmp(m->payload, expected) == 0);
+    CHECK(m && !m->retain && m->qos == 0);
+
+    // Not buffered while offline, not replayed on connect
+    host_mqtt_disconnect();
+    host_mqtt_clear();
+    mqtt_publisher_publish_health();
+    CHECK_EQ(host_mqtt_message_count(), 0);
+    host_mqtt_connect();
+    CHECK_EQ(host_mqtt_count(BASE "/health"), 0);
+
+    // Everything retained comes back
+    const host_mqtt_message_t *alarm = host_mqtt_last(BASE "/alarm");
+    CHECK(alarm && strcmp(alarm->payload, "snoozed") == 0);
+    const host_mqtt_message_t *first = host_mqtt_last(BASE "/first_reading");
+    CHECK(first && strcmp(first->payload, "4321") == 0);
+    CHECK_EQ(discovery_count(), ENTITIES);
+}
+
+static void test_commands(void)
+{
+    command_count = 0;
+    host_mqtt_deliver(BASE "/cmd/snooze", "PRESS");
+    CHECK_EQ(command_count, 1);
+    CHECK_EQ(last_command, MQTT_CMD_SNOOZE);
+
+    host_mqtt_deliver(BASE "/cmd/refresh", "");
+    CHECK_EQ(command_count, 2);
+    CHECK_EQ(last_command, MQTT_CMD_REFRESH);
+
+    host_mqtt_deliver(BASE "/cmd/lamp", "RED");
+    CHECK_EQ(command_count, 3);
+    CHECK_EQ(last_command, MQTT_CMD_LAMP_COLOR);
+    CHECK_EQ(last_arg, 2);
+    host_mqtt_deliver(BASE "/cmd/lamp", "green");
+    CHECK_EQ(last_arg, 1);
+    host_mqtt_deliver(BASE "/cmd/lamp", "white");
+    CHECK_EQ(last_arg, 0);
+    CHECK_EQ(command_count, 5);
+
+    // Unknown colors and topics are ignored
+    host_mqtt_deliver(BASE "/cmd/lamp", "blue");
+    host_mqtt_deliver(BASE "/cmd/lamp", "greenish");
+    host_mqtt_deliver(BASE "/cmd/reboot", "now");
+    host_mqtt_deliver("glucose_monitor/gm_000000/cmd/snooze", "PRESS");
+    CHECK_EQ(command_count, 5);
+
+    // Home Assistant coming back online gets the discovery configs again
+    host_mqtt_clear();
+    host_mqtt_deliver("homeassistant/status", "offline");
+    CHECK_EQ(host_mqtt_message_count(), 0);
+    host_mqtt_deliver("homeassistant/status", "online");
+    CHECK_EQ(discovery_count(), ENTITIES);
+    CHECK_EQ(host_mqtt_message_count(), ENTITIES);
+    CHECK_EQ(command_count, 5);
+}
+
+static void test_config_change_restarts(void)
+{
+    int created = host_mqtt_clients_created();
+
+    // New broker without a password: the stored one is kept
+    CHECK_EQ(mqtt_publisher_config_save("mqtts://other.example:8883", "", NULL), ESP_OK);
+    CHECK_EQ(host_mqtt_clients_created(), created + 1);
+    const host_mqtt_session_t *session = host_mqtt_session();
+    CHECK(session != NULL);
+    CHECK(session && strcmp(session->uri, "mqtts://other.example:8883") == 0);
+    CHECK(session && session->username[0] == '\0');
+    CHECK(session && strcmp(session->password, "secret") == 0);
+
+    // The new client is not connected yet: state waits for its connect
+    host_mqtt_clear();
+    mqtt_publisher_publish_alarm(false, false);
+    CHECK_EQ(host_mqtt_message_count(), 0);
+    host_mqtt_connect();
+    const host_mqtt_message_t *m = host_mqtt_last(BASE "/alarm");
+    CHECK(m && strcmp(m->payload, "off") == 0);
+
+    // Empty URI disables MQTT and forgets the credentials
+    CHECK_EQ(mqtt_publisher_config_save("", "", NULL), ESP_OK);
+    CHECK(host_mqtt_session() == NULL);
+    CHECK(!host_nvs_has_key("mqtt", "uri"));
+    CHECK(!host_nvs_has_key("mqtt", "pass"));
+    char uri[MQTT_PUBLISHER_URI_MAX_LEN + 1];
+    char user[MQTT_PUBLISHER_USER_MAX_LEN + 1];
+    CHECK(!mqtt_publisher_get_config(uri, sizeof(uri), user, sizeof(user)));
+}
+
+int main(void)
+{
+    host_nvs_reset();
+    CHECK_EQ(nvs_journal_init(), ESP_OK);
+    CHECK_EQ(mqtt_publisher_init(on_command), ESP_OK);
+    RUN_TEST(test_disabled_without_broker);
+    RUN_TEST(test_config_validation);
+    RUN_TEST(test_session_and_last_will);
+    RUN_TEST(test_offline_buffer_and_connect);
+    RUN_TEST(test_discovery);
+    RUN_TEST(test_state_published_on_change);
+    RUN_TEST(test_health_not_retained);
+    RUN_TEST(test_commands);
+    RUN_TEST(test_config_change_restarts);
+    return TEST_EXIT_CODE();
+}
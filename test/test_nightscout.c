@@ -0,0 +1,343 @@
+/**
+ * Nightscout uploader tests
+ * Runs nightscout.c, nvs_journal.c and the queue against the host
+ * stand-ins (in-memory NVS, simulated esp_timer) and a stand-in
+ * Nightscout server on 127.0.0.1 that can be switched into an outage.
+ */
+
+#define _GNU_SOURCE     // strcasestr
+#include "nightscout.h"
+#include "nvs_journal.h"
+#include "host_idf.h"
+#include "test_common.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define SECRET          "The quick brown fox jumps over the lazy dog"
+#define SECRET_SHA1     "2fd4e1c67a2d28fced849ee1bb76e7391b93eb12"
+#define MAX_DATES       256
+
+typedef struct {
+    int listen_fd;
+    int port;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    int status;                 // Reply to each request
+    int requests;
+    int bad_requests;           // Wrong method, path or api-secret
+    int max_batch;
+    int64_t dates[MAX_DATES];   // "date" of every reading received, in order
+    int date_count;
+} server_t;
+
+static server_t server;
+
+static void record_body(const char *body)
+{
+    int batch = 0;
+    for (const char *p = strstr(body, "\"date\":"); p; p = strstr(p + 1, "\"date\":")) {
+        if (server.date_count < MAX_DATES) {
+            server.dates[server.date_count++] = strtoll(p + 7, NULL, 10);
+        }
+        batch++;
+    }
+    if (batch > server.max_batch) {
+        server.max_batch = batch;
+    }
+}
+
+static void handle_connection(int fd)
+{
+    char request[8192];
+    size_t len = 0;
+    char *body = NULL;
+    ssize_t n;
+
+    while (len < sizeof(request) - 1 && (n = recv(fd, request + len, sizeof(request) - 1 - len, 0)) > 0) {
+        len += n;
+        request[len] = '\0';
+        char *end = strstr(request, "\r\n\r\n");
+        if (!end) {
+            continue;
+        }
+        const char *length_header = strcasestr(request, "Content-Length:");
+        size_t content_length = length_header ? strtoul(length_header + 15, NULL, 10) : 0;
+        if (len >= (size_t)(end + 4 - request) + content_length) {
+            body = end + 4;
+            break;
+        }
+    }
+
+    // Any site prefix is accepted so readings sent to the wrong site are seen
+    char *path_end = body ? strstr(request, " HTTP/1.1\r\n") : NULL;
+    bool valid = path_end && strncmp(request, "POST /", 6) == 0 &&
+                 path_end - request >= 20 && strncmp(path_end - 15, "/api/v1/entries", 15) == 0;
+    const char *secret = body ? strcasestr(request, "\r\napi-secret: ") : NULL;
+    bool authorized = secret && strncmp(secret + 14, SECRET_SHA1 "\r\n", 42) == 0;
+
+    pthread_mutex_lock(&server.lock);
+    server.requests++;
+    int status = server.status;
+    if (!valid) {
+        server.bad_requests++;
+        status = 400;
+    } else if (!authorized) {
+        server.bad_requests++;
+        status = 401;
+    } else if (status == 200) {
+        record_body(body);
+    }
+    pthread_mutex_unlock(&server.lock);
+
+    char reply[128];
+    int reply_len = snprintf(reply, sizeof(reply),
+                             "HTTP/1.1 %d X\r\nContent-Length: 0\r\nConnection: close\r\n\r\n", status);
+    send(fd, reply, reply_len, MSG_NOSIGNAL);
+    close(fd);
+}
+
+static void* server_task(void *arg)
+{
+    int fd;
+    while ((fd = accept(server.listen_fd, NULL, NULL)) >= 0) {
+        handle_connection(fd);
+    }
+    return NULL;
+}
+
+static void server_start(void)
+{
+    memset(&server, 0, sizeof(server));
+    pthread_mutex_init(&server.lock, NULL);
+    server.status = 200;
+    server.listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    socklen_t addr_len = sizeof(addr);
+    if (bind(server.listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(server.listen_fd, 8) != 0 ||
+        getsockname(server.listen_fd, (struct sockaddr *)&addr, &addr_len) != 0) {
+        perror("stand-in server");
+        exit(1);
+    }
+    server.port = ntohs(addr.sin_port);
+    pthread_create(&server.thread, NULL, server_task, NULL);
+}
+
+static void server_stop(void)
+{
+    shutdown(server.listen_fd, SHUT_RDWR);
+    close(server.listen_fd);
+    pthread_join(server.thread, NULL);
+}
+
+static void server_set_status(int status)
+{
+    pthread_mutex_lock(&server.lock);
+    server.status = status;
+    pthread_mutex_unlock(&server.lock);
+}
+
+static void server_clear(void)
+{
+    pthread_mutex_lock(&server.lock);
+    server.requests = 0;
+    server.bad_requests = 0;
+    server.max_batch = 0;
+    server.date_count = 0;
+    pthread_mutex_unlock(&server.lock);
+}
+
+static void site_url(char *buf, size_t size, const char *path)
+{
+    snprintf(buf, size, "http://127.0.0.1:%d%s", server.port, path);
+}
+
+// Fresh device: empty NVS, uploader configured for the stand-in server
+static void boot_configured(void)
+{
+    host_nvs_reset();
+    server_clear();
+    server_set_status(200);
+    CHECK_EQ(nightscout_init(), ESP_OK);
+    char url[64];
+    site_url(url, sizeof(url), "/");
+    CHECK_EQ(nightscout_config_save(url, SECRET), ESP_OK);
+}
+
+static void submit(time_t unix_time, int mgdl)
+{
+    libre_glucose_data_t glucose = { .value_mgdl = mgdl, .trend = 3, .unix_time = unix_time };
+    nightscout_submit(&glucose);
+}
+
+#define T0 1760000000
+
+static void test_delivered_without_nvs_writes(void)
+{
+    boot_configured();
+    uint32_t writes = host_nvs_write_count();
+
+    for (int i = 0; i < 5; i++) {
+        submit(T0 + i * 300, 100 + i);
+        submit(T0 + i * 300, 100 + i);     // Same reading polled twice
+        CHECK_EQ(nightscout_flush(), ESP_OK);
+    }
+
+    CHECK_EQ(server.requests, 5);
+    CHECK_EQ(server.bad_requests, 0);
+    CHECK_EQ(server.date_count, 5);
+    CHECK_EQ(server.dates[4], (int64_t)(T0 + 4 * 300) * 1000);
+    CHECK_EQ(host_nvs_write_count(), writes);
+    CHECK(!host_nvs_has_key("nightscout", "queue"));
+    CHECK_EQ(host_power_locks_held(), 0);
+}
+
+static void test_outage_backs_off_and_survives_reboot(void)
+{
+    boot_configured();
+    server_set_status(503);
+
+    submit(T0, 100);
+    CHECK_EQ(nightscout_flush(), ESP_FAIL);
+    CHECK(host_nvs_has_key("nightscout", "queue"));
+    CHECK_EQ(server.requests, 1);
+
+    // Inside the backoff nothing is sent and nothing more is written
+    uint32_t writes = host_nvs_write_count();
+    submit(T0 + 300, 101);
+    CHECK_EQ(nightscout_flush(), ESP_ERR_INVALID_STATE);
+    CHECK_EQ(server.requests, 1);
+
+    // After the first delay the next attempt fails again and doubles it
+    host_time_advance_us((int64_t)NIGHTSCOUT_BACKOFF_MIN_S * 1000000);
+    CHECK_EQ(nightscout_flush(), ESP_FAIL);
+    CHECK_EQ(server.requests, 2);
+    host_time_advance_us((int64_t)NIGHTSCOUT_BACKOFF_MIN_S * 1000000);
+    CHECK_EQ(nightscout_flush(), ESP_ERR_INVALID_STATE);
+    CHECK(host_nvs_write_count() > writes);
+
+    // A long outage: more readings than one batch, kept across a reboot
+    for (int i = 2; i < 30; i++) {
+        submit(T0 + i * 300, 100 + i);
+    }
+    host_time_advance_us((int64_t)NIGHTSCOUT_BACKOFF_MAX_S * 1000000);
+    CHECK_EQ(nightscout_flush(), ESP_FAIL);
+
+    CHECK_EQ(nightscout_init(), ESP_OK);
+    server_clear();
+    server_set_status(200);
+    CHECK_EQ(nightscout_flush(), ESP_OK);     // Backoff isn't persisted
+
+    CHECK_EQ(server.date_count, 30);
+    CHECK(server.max_batch <= NIGHTSCOUT_BATCH_MAX);
+    CHECK_EQ(server.requests, (30 + NIGHTSCOUT_BATCH_MAX - 1) / NIGHTSCOUT_BATCH_MAX);
+    for (int i = 0; i < server.date_count; i++) {
+        CHECK_EQ(server.dates[i], (int64_t)(T0 + i * 300) * 1000);
+    }
+    CHECK(!host_nvs_has_key("nightscout", "queue"));     // Cleared once delivered
+
+    CHECK_EQ(nightscout_init(), ESP_OK);
+    CHECK_EQ(nightscout_flush(), ESP_OK);
+    CHECK_EQ(server.date_count, 30);                     // Nothing delivered twice
+}
+
+static void test_wrong_secret_rejected(void)
+{
+    boot_configured();
+    char url[64];
+    site_url(url, sizeof(url), "");
+    CHECK_EQ(nightscout_config_save(url, "not the secret"), ESP_OK);
+
+    submit(T0, 100);
+    CHECK_EQ(nightscout_flush(), ESP_FAIL);
+    CHECK_EQ(server.date_count, 0);
+    CHECK(host_nvs_has_key("nightscout", "queue"));
+}
+
+static void test_site_change_drops_queue(void)
+{
+    boot_configured();
+    server_set_status(503);
+    submit(T0, 100);
+    submit(T0 + 300, 101);
+    CHECK_EQ(nightscout_flush(), ESP_FAIL);
+    CHECK(host_nvs_has_key("nightscout", "queue"));
+
+    // Same site with a trailing slash keeps the queue
+    char url[64];
+    site_url(url, sizeof(url), "//");
+    CHECK_EQ(nightscout_config_save(url, NULL), ESP_OK);
+    CHECK(host_nvs_has_key("nightscout", "queue"));
+
+    site_url(url, sizeof(url), "/other");
+    CHECK_EQ(nightscout_config_save(url, NULL), ESP_OK);
+    CHECK(!host_nvs_has_key("nightscout", "queue"));
+    CHECK_EQ(nightscout_init(), ESP_OK);
+    server_set_status(200);
+    CHECK_EQ(nightscout_flush(), ESP_OK);
+    CHECK_EQ(server.date_count, 0);
+
+    // Disabling drops the queue too
+    boot_configured();
+    server_set_status(503);
+    submit(T0, 100);
+    CHECK_EQ(nightscout_flush(), ESP_FAIL);
+    CHECK_EQ(nightscout_config_save("", NULL), ESP_OK);
+    CHECK(!host_nvs_has_key("nightscout", "queue"));
+    CHECK(!host_nvs_has_key("nightscout", "url"));
+    CHECK(!nightscout_get_config(url, sizeof(url)));
+}
+
+/**
+ * Power lost after each possible number of writes while switching
+ * sites: after the reboot the readings queued for the old site must
+ * never reach the new one.
+ */
+static void test_power_loss_during_site_change(void)
+{
+    for (int writes = 0; writes <= 3; writes++) {
+        boot_configured();
+        server_set_status(503);
+        submit(T0, 100);
+        CHECK_EQ(nightscout_flush(), ESP_FAIL);
+
+        char url[64];
+        site_url(url, sizeof(url), "/other");
+        host_nvs_fail_after(writes);
+        nightscout_config_save(url, NULL);
+        host_nvs_fail_after(-1);
+
+        CHECK_EQ(nightscout_init(), ESP_OK);
+        char stored[64];
+        nightscout_get_config(stored, sizeof(stored));
+        bool moved = strcmp(stored, url) == 0;
+
+        server_clear();
+        server_set_status(200);
+        CHECK_EQ(nightscout_flush(), ESP_OK);
+        if (moved) {
+            CHECK_EQ(server.date_count, 0);
+        } else {
+            CHECK(server.date_count <= 1);   // Old site: still queued, or erased first
+        }
+    }
+}
+
+int main(void)
+{
+    server_start();
+    CHECK_EQ(nvs_journal_init(), ESP_OK);
+    RUN_TEST(test_delivered_without_nvs_writes);
+    RUN_TEST(test_outage_backs_off_and_survives_reboot);
+    RUN_TEST(test_wrong_secret_rejected);
+    RUN_TEST(test_site_change_drops_queue);
+    RUN_TEST(test_power_loss_during_site_change);
+    server_stop();
+    return TEST_EXIT_CODE();
+}
@@ -0,0 +1,145 @@
+/**
+ * Nightscout queue tests: dedup, ordering, capacity, batching, backoff
+ * and the persisted blob
+ */
+
+#include "nightscout_queue.h"
+#include "test_common.h"
+#include <string.h>
+
+static nightscout_entry_t entry_at(int64_t date_ms, uint16_t sgv)
+{
+    nightscout_entry_t entry = { .date_ms = date_ms, .sgv = sgv, .trend = 3 };
+    return entry;
+}
+
+static void test_dedup_and_order(void)
+{
+    nightscout_queue_t queue;
+    nightscout_queue_init(&queue);
+
+    nightscout_entry_t e = entry_at(3000, 100);
+    CHECK(nightscout_queue_push(&queue, &e));
+    CHECK(!nightscout_queue_push(&queue, &e));      // Same reading polled twice
+    e = entry_at(1000, 90);
+    CHECK(nightscout_queue_push(&queue, &e));       // Late graph point goes in order
+    e = entry_at(2000, 95);
+    CHECK(nightscout_queue_push(&queue, &e));
+    CHECK_EQ(queue.count, 3);
+    CHECK_EQ(queue.entries[0].date_ms, 1000);
+    CHECK_EQ(queue.entries[1].date_ms, 2000);
+    CHECK_EQ(queue.entries[2].date_ms, 3000);
+
+    e = entry_at(0, 100);
+    CHECK(!nightscout_queue_push(&queue, &e));      // No timestamp
+}
+
+static void test_ack_forgets_sent(void)
+{
+    nightscout_queue_t queue;
+    nightscout_queue_init(&queue);
+    for (int i = 1; i <= 3; i++) {
+        nightscout_entry_t e = entry_at(i * 1000, 100);
+        nightscout_queue_push(&queue, &e);
+    }
+
+    nightscout_queue_ack(&queue, 2);
+    CHECK_EQ(queue.count, 1);
+    CHECK_EQ(queue.last_sent_ms, 2000);
+    CHECK_EQ(queue.entries[0].date_ms, 3000);
+
+    nightscout_entry_t old = entry_at(1500, 100);
+    CHECK(!nightscout_queue_push(&queue, &old));    // Already delivered
+    old = entry_at(2000, 100);
+    CHECK(!nightscout_queue_push(&queue, &old));
+}
+
+static void test_full_queue_drops_oldest(void)
+{
+    nightscout_queue_t queue;
+    nightscout_queue_init(&queue);
+    for (int i = 0; i < NIGHTSCOUT_QUEUE_CAPACITY + 12; i++) {
+        nightscout_entry_t e = entry_at(1000 + i * 1000, 100);
+        CHECK(nightscout_queue_push(&queue, &e));
+    }
+    CHECK_EQ(queue.count, NIGHTSCOUT_QUEUE_CAPACITY);
+    CHECK_EQ(queue.entries[0].date_ms, 1000 + 12 * 1000);
+    CHECK_EQ(queue.entries[NIGHTSCOUT_QUEUE_CAPACITY - 1].date_ms, 1000 + (NIGHTSCOUT_QUEUE_CAPACITY + 11) * 1000);
+}
+
+static void test_format_batch(void)
+{
+    nightscout_queue_t queue;
+    nightscout_queue_init(&queue);
+    for (int i = 0; i < 20; i++) {
+        nightscout_entry_t e = entry_at(1760000000000LL + i * 300000, 100 + i);
+        nightscout_queue_push(&queue, &e);
+    }
+
+    char buf[4096];
+    CHECK_EQ(nightscout_queue_format_batch(&queue, NIGHTSCOUT_BATCH_MAX, "dev", buf, sizeof(buf)), NIGHTSCOUT_BATCH_MAX);
+    CHECK(buf[0] == '[' && buf[strlen(buf) - 1] == ']');
+    CHECK(strstr(buf, "{\"type\":\"sgv\",\"sgv\":100,\"date\":1760000000000,\"dateString\":\"2025-10-09T08:53:20.000Z\"") != NULL);
+    CHECK(strstr(buf, "\"device\":\"dev\"") != NULL);
+    CHECK(strstr(buf, "\"direction\":\"Flat\"") != NULL);
+    CHECK(strstr(buf, "\"sgv\":112") == NULL);     // 13th reading is in the next batch
+
+    // A small buffer takes fewer readings, never a truncated one
+    char small[200];
+    size_t n = nightscout_queue_format_batch(&queue, NIGHTSCOUT_BATCH_MAX, "dev", small, sizeof(small));
+    CHECK_EQ(n, 1);
+    CHECK(small[strlen(small) - 1] == ']');
+    CHECK_EQ(nightscout_queue_format_batch(&queue, NIGHTSCOUT_BATCH_MAX, "dev", small, 20), 0);
+}
+
+static void test_backoff(void)
+{
+    CHECK_EQ(nightscout_backoff_seconds(1), NIGHTSCOUT_BACKOFF_MIN_S);
+    CHECK_EQ(nightscout_backoff_seconds(2), NIGHTSCOUT_BACKOFF_MIN_S * 2);
+    CHECK_EQ(nightscout_backoff_seconds(3), NIGHTSCOUT_BACKOFF_MIN_S * 4);
+    CHECK_EQ(nightscout_backoff_seconds(7), NIGHTSCOUT_BACKOFF_MAX_S);
+    CHECK_EQ(nightscout_backoff_seconds(1000), NIGHTSCOUT_BACKOFF_MAX_S);
+}
+
+static void test_serialize_round_trip(void)
+{
+    nightscout_queue_t queue;
+    nightscout_queue_init(&queue);
+    for (int i = 0; i < NIGHTSCOUT_QUEUE_CAPACITY; i++) {
+        nightscout_entry_t e = { .date_ms = 1760000000000LL + i * 300000, .sgv = 40 + i * 7, .trend = i % 6 };
+        nightscout_queue_push(&queue, &e);
+    }
+    nightscout_queue_ack(&queue, 5);
+
+    uint8_t blob[NIGHTSCOUT_QUEUE_BLOB_MAX];
+    size_t len = nightscout_queue_serialize(&queue, blob, sizeof(blob));
+    CHECK(len > 0);
+
+    nightscout_queue_t restored;
+    CHECK(nightscout_queue_deserialize(&restored, blob, len));
+    CHECK_EQ(restored.count, queue.count);
+    CHECK_EQ(restored.last_sent_ms, queue.last_sent_ms);
+    for (size_t i = 0; i < queue.count; i++) {
+        CHECK_EQ(restored.entries[i].date_ms, queue.entries[i].date_ms);
+        CHECK_EQ(restored.entries[i].sgv, queue.entries[i].sgv);
+        CHECK_EQ(restored.entries[i].trend, queue.entries[i].trend);
+    }
+
+    // Truncated, wrong version or too small a buffer
+    CHECK(!nightscout_queue_deserialize(&restored, blob, len - 1));
+    CHECK_EQ(restored.count, 0);
+    blob[0] ^= 0xFF;
+    CHECK(!nightscout_queue_deserialize(&restored, blob, len));
+    CHECK_EQ(nightscout_queue_serialize(&queue, blob, 8), 0);
+}
+
+int main(void)
+{
+    RUN_TEST(test_dedup_and_order);
+    RUN_TEST(test_ack_forgets_sent);
+    RUN_TEST(test_full_queue_drops_oldest);
+    RUN_TEST(test_format_batch);
+    RUN_TEST(test_backoff);
+    RUN_TEST(test_serialize_round_trip);
+    return TEST_EXIT_CODE();
+}
@@ -0,0 +1,156 @@
+/**
+ * NVS journal tests
+ * Coalescing and unchanged values, then failed writes: the failing key
+ * and everything staged after it in its namespace stay staged and reach
+ * flash on the next flush or the retry. The deferred flush runs on the
+ * journal's task, woken by the (simulated) esp_timer.
+ */
+
+#include "nvs_journal.h"
+#include "host_idf.h"
+#include "nvs.h"
+#include "test_common.h"
+#include <string.h>
+#include <unistd.h>
+
+#define NS      "journal"
+#define OTHER   "other"
+
+static uint8_t read_u8(const char *ns, const char *key)
+{
+    nvs_handle_t handle;
+    uint8_t value = 0;
+    if (nvs_open(ns, NVS_READONLY, &handle) == ESP_OK) {
+        nvs_get_u8(handle, key, &value);
+        nvs_close(handle);
+    }
+    return value;
+}
+
+/**
+ * Wait (real time) for the journal task to store key
+ */
+static bool wait_for_key(const char *ns, const char *key)
+{
+    for (int i = 0; i < 200 && !host_nvs_has_key(ns, key); i++) {
+        usleep(10000);
+    }
+    return host_nvs_has_key(ns, key);
+}
+
+static void test_coalesce_and_unchanged(void)
+{
+    host_nvs_reset();
+    nvs_journal_stats_t before;
+    nvs_journal_stats_t after;
+    nvs_journal_get_stats(&before);
+
+    CHECK_EQ(nvs_journal_set_u8(NS, "a", 1), ESP_OK);
+    CHECK_EQ(nvs_journal_set_u8(NS, "a", 2), ESP_OK);
+    CHECK_EQ(nvs_journal_set_str(NS, "s", "text"), ESP_OK);
+    CHECK_EQ(nvs_journal_flush(), ESP_OK);
+    CHECK_EQ(host_nvs_write_count(), 2);
+    CHECK_EQ(read_u8(NS, "a"), 2);
+
+    // Same values again: nothing reaches flash
+    CHECK_EQ(nvs_journal_set_u8(NS, "a", 2), ESP_OK);
+    CHECK_EQ(nvs_journal_set_str(NS, "s", "text"), ESP_OK);
+    CHECK_EQ(nvs_journal_erase(NS, "missing"), ESP_OK);
+    CHECK_EQ(nvs_journal_flush(), ESP_OK);
+    CHECK_EQ(host_nvs_write_count(), 2);
+
+    nvs_journal_get_stats(&after);
+    CHECK_EQ(after.coalesced - before.coalesced, 1);
+    CHECK_EQ(after.unchanged - before.unchanged, 3);
+    CHECK_EQ(after.writes - before.writes, 2);
+}
+
+static void test_failed_write_stays_staged(void)
+{
+    host_nvs_reset();
+    CHECK_EQ(nvs_journal_set_u8(NS, "first", 1), ESP_OK);
+    CHECK_EQ(nvs_journal_set_u8(NS, "second", 2), ESP_OK);
+    CHECK_EQ(nvs_journal_set_u8(NS, "third", 3), ESP_OK);
+    CHECK_EQ(nvs_journal_set_u8(OTHER, "key", 4), ESP_OK);
+
+    // Flash fails after one write: the rest of the namespace waits, the
+    // other namespace is not written either
+    host_nvs_fail_after(1);
+    CHECK(nvs_journal_flush() != ESP_OK);
+    CHECK(host_nvs_has_key(NS, "first"));
+    CHECK(!host_nvs_has_key(NS, "second"));
+    CHECK(!host_nvs_has_key(NS, "third"));
+    CHECK(!host_nvs_has_key(OTHER, "key"));
+
+    // Still failing: nothing lost
+    CHECK(nvs_journal_flush() != ESP_OK);
+
+    host_nvs_fail_after(-1);
+    CHECK_EQ(nvs_journal_flush(), ESP_OK);
+    CHECK_EQ(read_u8(NS, "second"), 2);
+    CHECK_EQ(read_u8(NS, "third"), 3);
+    CHECK_EQ(read_u8(OTHER, "key"), 4);
+
+    // A value staged again while waiting replaces the failed one
+    host_nvs_fail_after(0);
+    CHECK_EQ(nvs_journal_set_u8(NS, "second", 20), ESP_OK);
+    CHECK(nvs_journal_flush() != ESP_OK);
+    CHECK_EQ(nvs_journal_set_u8(NS, "second", 21), ESP_OK);
+    host_nvs_fail_after(-1);
+    CHECK_EQ(nvs_journal_flush(), ESP_OK);
+    CHECK_EQ(read_u8(NS, "second"), 21);
+}
+
+static void test_full_journal_while_failing(void)
+{
+    host_nvs_reset();
+    char key[8];
+    host_nvs_fail_after(0);
+    for (int i = 0; i < NVS_JOURNAL_MAX_ENTRIES; i++) {
+        snprintf(key, sizeof(key), "k%d", i);
+        CHECK_EQ(nvs_journal_set_u8(NS, key, (uint8_t)i + 1), ESP_OK);
+    }
+
+    // No room and the early flush fails: refused, nothing staged dropped
+    CHECK_EQ(nvs_journal_set_u8(NS, "extra", 9), ESP_FAIL);
+
+    host_nvs_fail_after(-1);
+    CHECK_EQ(nvs_journal_set_u8(NS, "extra", 9), ESP_OK);   // Early flush makes room
+    CHECK_EQ(nvs_journal_flush(), ESP_OK);
+    for (int i = 0; i < NVS_JOURNAL_MAX_ENTRIES; i++) {
+        snprintf(key, sizeof(key), "k%d", i);
+        CHECK_EQ(read_u8(NS, key), i + 1);
+    }
+    CHECK_EQ(read_u8(NS, "extra"), 9);
+}
+
+static void test_deferred_flush_and_retry(void)
+{
+    host_nvs_reset();
+    CHECK_EQ(nvs_journal_set_u8(NS, "later", 5), ESP_OK);
+    host_time_advance_us((int64_t)NVS_JOURNAL_FLUSH_DELAY_MS * 1000 - 1);
+    usleep(50000);
+    CHECK(!host_nvs_has_key(NS, "later"));
+    host_time_advance_us(1);
+    CHECK(wait_for_key(NS, "later"));
+
+    // The deferred flush fails; the retry stores the value
+    host_nvs_fail_after(0);
+    CHECK_EQ(nvs_journal_set_u8(NS, "retried", 6), ESP_OK);
+    host_time_advance_us((int64_t)NVS_JOURNAL_FLUSH_DELAY_MS * 1000);
+    usleep(100000);
+    CHECK(!host_nvs_has_key(NS, "retried"));
+    host_nvs_fail_after(-1);
+    host_time_advance_us((int64_t)NVS_JOURNAL_RETRY_DELAY_MS * 1000);
+    CHECK(wait_for_key(NS, "retried"));
+}
+
+int main(void)
+{
+    CHECK_EQ(nvs_journal_init(), ESP_OK);
+    RUN_TEST(test_coalesce_and_unchanged);
+    RUN_TEST(test_failed_write_stays_staged);
+    RUN_TEST(test_full_journal_while_failing);
+    RUN_TEST(test_deferred_flush_and_retry);
+    return TEST_EXIT_CODE();
+}
@@ -0,0 +1,398 @@
+/**
+ * OTA writer core tests
+ * The real pipeline on a host port: pthread queues and task, and a fake
+ * partition that takes (real) time to erase and write, programs like NOR
+ * flash and can have a stuck bit. Covers the image landing intact with
+ * block erases ahead of the writes, resuming from an offset, network and
+ * flash overlapping, the stall counters, verify failures and writes past
+ * the image.
+ */
+
+#include "ota_writer_core.h"
+#include "test_common.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define FLASH_SIZE      (512 * 1024)
+#define BUFFER_SIZE     (16 * 1024)
+#define OLD_BYTE        0xa5            // Whatever the slot held before
+#define MAX_ERASES      64
+
+/* Timed fake partition */
+
+static struct {
+    uint8_t data[FLASH_SIZE];
+    uint32_t erase_us;          // Per sector
+    uint32_t write_us;          // Per KB
+    uint32_t stuck_offset;      // Byte whose low bit won't program, UINT32_MAX for none
+    int unerased_writes;        // Writes over bytes that weren't erased
+    uint32_t erase_start[MAX_ERASES];
+    uint32_t erase_len[MAX_ERASES];
+    int erases;
+} flash;
+
+static void flash_reset(void)
+{
+    memset(&flash, 0, sizeof(flash));
+    memset(flash.data, OLD_BYTE, sizeof(flash.data));
+    flash.stuck_offset = UINT32_MAX;
+}
+
+static esp_err_t flash_erase(void *ctx, uint32_t offset, uint32_t len)
+{
+    if (offset % OTA_WRITER_SECTOR || len % OTA_WRITER_SECTOR || offset + len > FLASH_SIZE) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (flash.erases < MAX_ERASES) {
+        flash.erase_start[flash.erases] = offset;
+        flash.erase_len[flash.erases] = len;
+    }
+    flash.erases++;
+    usleep(flash.erase_us * (len / OTA_WRITER_SECTOR));
+    memset(flash.data + offset, 0xff, len);
+    return ESP_OK;
+}
+
+static esp_err_t flash_write(void *ctx, uint32_t offset, const void *data, size_t len)
+{
+    if (offset + len > FLASH_SIZE) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    usleep(flash.write_us * len / 1024);
+    const uint8_t *bytes = data;
+    for (size_t i = 0; i < len; i++) {
+        if (flash.data[offset + i] != 0xff) {
+            flash.unerased_writes++;
+        }
+        uint8_t value = bytes[i];
+        if (offset + i == flash.stuck_offset) {
+            value |= 1;
+        }
+        flash.data[offset + i] &= value;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t flash_read(void *ctx, uint32_t offset, void *data, size_t len)
+{
+    if (offset + len > FLASH_SIZE) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    memcpy(data, flash.data + offset, len);
+    return ESP_OK;
+}
+
+/* Queues and the writer task */
+
+struct ota_writer_queue {
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    size_t length;
+    size_t item_size;
+    size_t head;
+    size_t count;
+    uint8_t items[];
+};
+
+static pthread_t writer_thread;
+static bool writer_running = false;
+
+static ota_writer_queue_t *queue_create(size_t length, size_t item_size)
+{
+    ota_writer_queue_t *queue = calloc(1, sizeof(*queue) + length * item_size);
+    if (queue) {
+        pthread_mutex_init(&queue->lock, NULL);
+        pthread_cond_init(&queue->changed, NULL);
+        queue->length = length;
+        queue->item_size = item_size;
+    }
+    return queue;
+}
+
+static void queue_delete(ota_writer_queue_t *queue)
+{
+    // The task has sent its result by now; let it return before its queues go
+    if (writer_running) {
+        pthread_join(writer_thread, NULL);
+        writer_running = false;
+    }
+    pthread_cond_destroy(&queue->changed);
+    pthread_mutex_destroy(&queue->lock);
+    free(queue);
+}
+
+static void queue_send(ota_writer_queue_t *queue, const void *item)
+{
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == queue->length) {
+        pthread_cond_wait(&queue->changed, &queue->lock);
+    }
+    memcpy(queue->items + (queue->head + queue->count) % queue->length * queue->item_size, item, queue->item_size);
+    queue->count++;
+    pthread_cond_broadcast(&queue->changed);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+static bool queue_receive(ota_writer_queue_t *queue, void *item, bool wait)
+{
+    pthread_mutex_lock(&queue->lock);
+    while (wait && queue->count == 0) {
+        pthread_cond_wait(&queue->changed, &queue->lock);
+    }
+    bool received = queue->count > 0;
+    if (received) {
+        memcpy(item, queue->items + queue->head * queue->item_size, queue->item_size);
+        queue->head = (queue->head + 1) % queue->length;
+        queue->count--;
+        pthread_cond_broadcast(&queue->changed);
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return received;
+}
+
+static int buffers_left = 0;     // Allocations that succeed
+
+static uint8_t *buffer_alloc(void)
+{
+    if (buffers_left == 0) {
+        return NULL;
+    }
+    buffers_left--;
+    return malloc(BUFFER_SIZE);
+}
+
+static void buffer_free(uint8_t *buf)
+{
+    free(buf);
+}
+
+typedef struct {
+    void (*run)(void *arg);
+    void *arg;
+} task_args_t;
+
+static task_args_t task_args;
+
+static void *task_main(void *arg)
+{
+    task_args.run(task_args.arg);
+    return NULL;
+}
+
+static bool task_start(void (*run)(void *arg), void *arg)
+{
+    task_args.run = run;
+    task_args.arg = arg;
+    writer_running = pthread_create(&writer_thread, NULL, task_main, NULL) == 0;
+    return writer_running;
+}
+
+static int64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static const ota_writer_port_t port = {
+    .flash = &flash,
+    .flash_size = FLASH_SIZE,
+    .erase = flash_erase,
+    .write = flash_write,
+    .read = flash_read,
+    .queue_create = queue_create,
+    .queue_delete = queue_delete,
+    .queue_send = queue_send,
+    .queue_receive = queue_receive,
+    .buffer_count = 3,
+    .buffer_alloc = buffer_alloc,
+    .buffer_free = buffer_free,
+    .task_start = task_start,
+    .now_us = now_us,
+};
+
+/* Download side */
+
+static uint8_t image[FLASH_SIZE];
+
+static void make_image(void)
+{
+    uint32_t x = 12345;
+    for (size_t i = 0; i < sizeof(image); i++) {
+        x = x * 1103515245 + 12345;
+        image[i] = x >> 16;
+    }
+}
+
+/**
+ * Feed image[offset, size) to a writer, network_us per buffer
+ * @return Result of ota_writer_finish
+ */
+static esp_err_t download(uint32_t offset, uint32_t size, uint32_t network_us, ota_writer_stats_t *stats,
+                          uint32_t *written)
+{
+    buffers_left = port.buffer_count;
+    ota_writer_t *writer = NULL;
+    esp_err_t err = ota_writer_core_start(&port, offset, size, &writer);
+    if (err != ESP_OK) {
+        return err;
+    }
+    for (uint32_t received = offset; received < size; ) {
+        uint8_t *buf = ota_writer_get_buffer(writer);
+        uint32_t fill = size - received < BUFFER_SIZE ? size - received : BUFFER_SIZE;
+        usleep(network_us);
+        memcpy(buf, image + received, fill);
+        ota_writer_submit(writer, buf, fill);   // Errors show up in finish
+        received += fill;
+    }
+    return ota_writer_finish(writer, stats, written);
+}
+
+static bool all_bytes(uint32_t start, uint32_t end, uint8_t value)
+{
+    for (uint32_t i = start; i < end; i++) {
+        if (flash.data[i] != value) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void test_writes_image(void)
+{
+    flash_reset();
+    const uint32_t size = 200 * 1024 + 1000;           // Last buffer is partial
+    const uint32_t limit = 204 * 1024;                  // Rounded up to a sector
+    ota_writer_stats_t stats;
+    uint32_t written = 0;
+    CHECK_EQ(download(0, size, 0, &stats, &written), ESP_OK);
+    CHECK_EQ(written, size);
+    CHECK_EQ(stats.bytes, size);
+    CHECK(memcmp(flash.data, image, size) == 0);
+    CHECK(all_bytes(size, limit, 0xff));
+    CHECK(all_bytes(limit, FLASH_SIZE, OLD_BYTE));     // Nothing past the image erased
+    CHECK_EQ(flash.unerased_writes, 0);
+
+    // Block erases ahead of the writes, each block once
+    CHECK_EQ(flash.erases, 4);
+    for (int i = 0; i < flash.erases && i < MAX_ERASES; i++) {
+        CHECK_EQ(flash.erase_start[i], i * OTA_WRITER_ERASE_AHEAD);
+        CHECK_EQ(flash.erase_len[i], i < 3 ? OTA_WRITER_ERASE_AHEAD : limit - 3 * OTA_WRITER_ERASE_AHEAD);
+    }
+}
+
+static void test_resume_from_offset(void)
+{
+    flash_reset();
+    const uint32_t offset = 40 * 1024;     // Mid-block, sector aligned
+    const uint32_t size = 160 * 1024;
+    ota_writer_stats_t stats;
+    uint32_t written = 0;
+    CHECK_EQ(download(offset, size, 0, &stats, &written), ESP_OK);
+    CHECK_EQ(written, size);
+    CHECK_EQ(stats.bytes, size - offset);
+    CHECK(all_bytes(0, offset, OLD_BYTE));             // Written by the earlier run
+    CHECK(memcmp(flash.data + offset, image + offset, size - offset) == 0);
+    CHECK_EQ(flash.unerased_writes, 0);
+    CHECK(flash.erases > 0 && flash.erase_start[0] == offset);
+    CHECK_EQ(flash.erase_len[0], OTA_WRITER_ERASE_AHEAD - offset);   // Up to the block boundary
+}
+
+static void test_network_and_flash_overlap(void)
+{
+    // 12 buffers, each 20 ms on the network and 20 ms to flash: about
+    // 13 x 20 ms pipelined instead of 24 x 20 ms one after the other
+    flash_reset();
+    flash.write_us = 20000 / (BUFFER_SIZE / 1024);
+    const uint32_t size = 12 * BUFFER_SIZE;
+    const int64_t serial_us = 12 * 2 * 20000;
+    int64_t start = now_us();
+    CHECK_EQ(download(0, size, 20000, NULL, NULL), ESP_OK);
+    int64_t elapsed = now_us() - start;
+    CHECK(elapsed < serial_us * 3 / 4);
+    CHECK(memcmp(flash.data, image, size) == 0);
+}
+
+static void test_stall_counters(void)
+{
+    const int buffers = 12;
+    const uint32_t size = buffers * BUFFER_SIZE;
+
+    // Slow flash: the download waits for buffers, the writer never waits
+    flash_reset();
+    flash.erase_us = 100;
+    flash.write_us = 4000 / (BUFFER_SIZE / 1024);
+    ota_writer_stats_t stats;
+    CHECK_EQ(download(0, size, 0, &stats, NULL), ESP_OK);
+    CHECK(stats.reader_stalls >= (uint32_t)buffers / 2);
+    CHECK(stats.writer_stalls <= 1);           // Allow for the host scheduler
+
+    // Slow network: the writer waits, the download always has a buffer
+    flash_reset();
+    CHECK_EQ(download(0, size, 4000, &stats, NULL), ESP_OK);
+    CHECK(stats.writer_stalls >= (uint32_t)buffers / 2);
+    CHECK(stats.reader_stalls <= 1);           // Allow for the host scheduler
+    CHECK(stats.elapsed_ms >= (uint32_t)buffers * 4);
+}
+
+static void test_verify_failure(void)
+{
+    // A bit that won't program in the fifth buffer: the rest of the
+    // download still flows (buffers are recycled) and nothing after it counts
+    flash_reset();
+    flash.stuck_offset = 4 * BUFFER_SIZE + 100;
+    image[flash.stuck_offset] &= ~1;
+    uint32_t written = 0;
+    CHECK_EQ(download(0, 10 * BUFFER_SIZE, 0, NULL, &written), ESP_ERR_INVALID_CRC);
+    CHECK_EQ(written, 4 * BUFFER_SIZE);
+    CHECK(memcmp(flash.data, image, 4 * BUFFER_SIZE) == 0);
+    CHECK(all_bytes(2 * OTA_WRITER_ERASE_AHEAD, 10 * BUFFER_SIZE, OLD_BYTE));    // Not even erased
+    make_image();
+}
+
+static void test_write_past_image(void)
+{
+    // Image says 20 KB, the server sends two full buffers
+    flash_reset();
+    buffers_left = port.buffer_count;
+    ota_writer_t *writer = NULL;
+    CHECK_EQ(ota_writer_core_start(&port, 0, 20 * 1024, &writer), ESP_OK);
+    if (!writer) {
+        return;
+    }
+    for (int i = 0; i < 2; i++) {
+        uint8_t *buf = ota_writer_get_buffer(writer);
+        memcpy(buf, image + i * BUFFER_SIZE, BUFFER_SIZE);
+        ota_writer_submit(writer, buf, BUFFER_SIZE);
+    }
+    uint32_t written = 0;
+    CHECK_EQ(ota_writer_finish(writer, NULL, &written), ESP_ERR_INVALID_SIZE);
+    CHECK_EQ(written, BUFFER_SIZE);
+    CHECK(all_bytes(20 * 1024, FLASH_SIZE, OLD_BYTE));
+}
+
+static void test_out_of_buffers(void)
+{
+    // One buffer can't overlap anything; nothing is leaked
+    ota_writer_t *writer = NULL;
+    buffers_left = 1;
+    CHECK_EQ(ota_writer_core_start(&port, 0, 64 * 1024, &writer), ESP_ERR_NO_MEM);
+    CHECK(writer == NULL);
+    CHECK(!writer_running);
+}
+
+int main(void)
+{
+    make_image();
+    RUN_TEST(test_writes_image);
+    RUN_TEST(test_resume_from_offset);
+    RUN_TEST(test_network_and_flash_overlap);
+    RUN_TEST(test_stall_counters);
+    RUN_TEST(test_verify_failure);
+    RUN_TEST(test_write_past_image);
+    RUN_TEST(test_out_of_buffers);
+    return TEST_EXIT_CODE();
+}
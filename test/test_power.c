@@ -0,0 +1,182 @@
+/**
+ * Power management tests
+ * The real lock accounting on the host esp_pm and esp_timer stand-ins:
+ * nested and overlapping locks, unmatched releases, held and busy times
+ * (including locks held right now), the time-weighted current estimate
+ * and the modem sleep mode. power.c keeps totals since boot, so each
+ * test checks what changed while it ran.
+ */
+
+#include "power.h"
+#include "esp_wifi.h"
+#include "host_idf.h"
+#include "test_common.h"
+
+// power.c's estimates for busy and idle (DFS on)
+#define EST_BUSY_MA     100
+#define EST_IDLE_MA     25
+
+#define MS              1000LL
+
+static power_stats_t stats(void)
+{
+    power_stats_t stats;
+    power_get_stats(&stats);
+    return stats;
+}
+
+static void test_init(void)
+{
+    CHECK_EQ(power_init(), ESP_OK);
+    CHECK_EQ(host_pm_lock_count(), POWER_LOCK_COUNT);
+    CHECK_EQ(host_pm_locks_held(), 0);
+
+    // Nothing held yet: the idle draw
+    power_stats_t s = stats();
+    CHECK(s.enabled);
+    CHECK_EQ(s.uptime_s, host_time_us() / 1000000);
+    CHECK_EQ(s.busy_ms, 0);
+    CHECK_EQ(s.avg_current_ma, EST_IDLE_MA);
+}
+
+static void test_nested_locks(void)
+{
+    power_stats_t before = stats();
+    power_lock_acquire(POWER_LOCK_DISPLAY);
+    power_lock_acquire(POWER_LOCK_DISPLAY);
+    CHECK_EQ(host_pm_locks_held(), 2);
+    host_time_advance_us(10 * MS);
+
+    // The inner release leaves the lock held
+    power_lock_release(POWER_LOCK_DISPLAY);
+    CHECK_EQ(host_pm_locks_held(), 1);
+    host_time_advance_us(5 * MS);
+    power_lock_release(POWER_LOCK_DISPLAY);
+    CHECK_EQ(host_pm_locks_held(), 0);
+    host_time_advance_us(7 * MS);
+
+    power_stats_t after = stats();
+    CHECK_EQ(after.held_ms[POWER_LOCK_DISPLAY] - before.held_ms[POWER_LOCK_DISPLAY], 15);
+    CHECK_EQ(after.busy_ms - before.busy_ms, 15);
+    CHECK_EQ(after.held_ms[POWER_LOCK_AUDIO], before.held_ms[POWER_LOCK_AUDIO]);
+}
+
+static void test_overlap_counts_busy_once(void)
+{
+    power_stats_t before = stats();
+    power_lock_acquire(POWER_LOCK_DISPLAY);
+    host_time_advance_us(10 * MS);
+    power_lock_acquire(POWER_LOCK_NETWORK);
+    host_time_advance_us(10 * MS);
+    power_lock_release(POWER_LOCK_DISPLAY);
+    host_time_advance_us(10 * MS);
+    power_lock_release(POWER_LOCK_NETWORK);
+
+    power_stats_t after = stats();
+    CHECK_EQ(after.held_ms[POWER_LOCK_DISPLAY] - before.held_ms[POWER_LOCK_DISPLAY], 20);
+    CHECK_EQ(after.held_ms[POWER_LOCK_NETWORK] - before.held_ms[POWER_LOCK_NETWORK], 20);
+    CHECK_EQ(after.busy_ms - before.busy_ms, 30);
+}
+
+static void test_unmatched_release(void)
+{
+    power_stats_t before = stats();
+
+    // Nothing held: ignored, and the counts don't go below zero
+    power_lock_release(POWER_LOCK_AUDIO);
+    CHECK_EQ(host_pm_locks_held(), 0);
+    host_time_advance_us(10 * MS);
+    power_stats_t s = stats();
+    CHECK_EQ(s.held_ms[POWER_LOCK_AUDIO], before.held_ms[POWER_LOCK_AUDIO]);
+    CHECK_EQ(s.busy_ms, before.busy_ms);
+
+    // A release of another lock doesn't end the busy time
+    power_lock_acquire(POWER_LOCK_NETWORK);
+    power_lock_release(POWER_LOCK_AUDIO);
+    host_time_advance_us(10 * MS);
+    power_lock_release(POWER_LOCK_NETWORK);
+    CHECK_EQ(host_pm_locks_held(), 0);
+
+    // Later pairs are still counted
+    power_lock_acquire(POWER_LOCK_AUDIO);
+    host_time_advance_us(4 * MS);
+    power_lock_release(POWER_LOCK_AUDIO);
+
+    power_stats_t after = stats();
+    CHECK_EQ(after.held_ms[POWER_LOCK_NETWORK] - before.held_ms[POWER_LOCK_NETWORK], 10);
+    CHECK_EQ(after.held_ms[POWER_LOCK_AUDIO] - before.held_ms[POWER_LOCK_AUDIO], 4);
+    CHECK_EQ(after.busy_ms - before.busy_ms, 14);
+}
+
+static void test_invalid_lock(void)
+{
+    power_stats_t before = stats();
+    power_lock_acquire(POWER_LOCK_COUNT);
+    CHECK_EQ(host_pm_locks_held(), 0);
+    host_time_advance_us(10 * MS);
+    power_lock_release(POWER_LOCK_COUNT);
+    CHECK_EQ(stats().busy_ms, before.busy_ms);
+}
+
+static void test_held_now_counts(void)
+{
+    power_stats_t before = stats();
+    power_lock_acquire(POWER_LOCK_NETWORK);
+    host_time_advance_us(25 * MS);
+
+    power_stats_t during = stats();
+    CHECK_EQ(during.held_ms[POWER_LOCK_NETWORK] - before.held_ms[POWER_LOCK_NETWORK], 25);
+    CHECK_EQ(during.busy_ms - before.busy_ms, 25);
+
+    host_time_advance_us(5 * MS);
+    power_lock_release(POWER_LOCK_NETWORK);
+    CHECK_EQ(stats().busy_ms - before.busy_ms, 30);
+}
+
+static void test_weighted_estimate(void)
+{
+    // Busy for exactly half of the uptime...
+    power_stats_t s = stats();
+    int64_t hold_ms = host_time_us() / MS - 2 * (int64_t)s.busy_ms;
+    CHECK(hold_ms > 0);
+    power_lock_acquire(POWER_LOCK_DISPLAY);
+    host_time_advance_us(hold_ms * MS);
+    power_lock_release(POWER_LOCK_DISPLAY);
+    s = stats();
+    CHECK_EQ(s.busy_ms * 2 * MS, host_time_us());
+    CHECK_EQ(s.avg_current_ma, (EST_BUSY_MA + EST_IDLE_MA) / 2);
+
+    // ...then idle as long again: a quarter
+    host_time_advance_us(host_time_us());
+    s = stats();
+    CHECK_EQ(s.busy_ms * 4 * MS, host_time_us());
+    CHECK_EQ(s.avg_current_ma, (EST_BUSY_MA + 3 * EST_IDLE_MA) / 4);
+    CHECK_EQ(s.uptime_s, host_time_us() / 1000000);
+}
+
+static void test_modem_sleep(void)
+{
+    power_apply_wifi();
+    CHECK_EQ(host_wifi_ps(), WIFI_PS_MAX_MODEM);
+
+    // LAN share needs every DTIM for multicast
+    power_set_wifi_multicast(true);
+    CHECK_EQ(host_wifi_ps(), WIFI_PS_MIN_MODEM);
+    power_apply_wifi();
+    CHECK_EQ(host_wifi_ps(), WIFI_PS_MIN_MODEM);
+    power_set_wifi_multicast(false);
+    CHECK_EQ(host_wifi_ps(), WIFI_PS_MAX_MODEM);
+}
+
+int main(void)
+{
+    RUN_TEST(test_init);
+    RUN_TEST(test_nested_locks);
+    RUN_TEST(test_overlap_counts_busy_once);
+    RUN_TEST(test_unmatched_release);
+    RUN_TEST(test_invalid_lock);
+    RUN_TEST(test_held_now_counts);
+    RUN_TEST(test_weighted_estimate);
+    RUN_TEST(test_modem_sleep);
+    return TEST_EXIT_CODE();
+}
@@ -0,0 +1,265 @@
+/**
+ * Release scanner tests
+ * Scans a releases/latest response shaped like GitHub's (decoy keys in
+ * nested objects, long release notes with escapes) in one piece, byte
+ * by byte and in random chunks, then malformed JSON, then a fuzz that
+ * requires the same outcome however the input is split. Set
+ * RELEASE_FUZZ_ITERATIONS for a longer run.
+ */
+
+#include "release_scanner.h"
+#include "test_common.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_FUZZ_ITERATIONS 200000
+#define MAX_ASSETS              8
+#define NOTES_LEN               120000
+
+typedef struct {
+    int count;
+    release_scan_asset_t assets[MAX_ASSETS];
+} assets_t;
+
+static void collect_asset(void *ctx, const release_scan_asset_t *asset)
+{
+    assets_t *assets = ctx;
+    if (assets->count < MAX_ASSETS) {
+        assets->assets[assets->count] = *asset;
+    }
+    assets->count++;
+}
+
+/**
+ * Build a response whose second asset is called name
+ */
+static const char *build_release(const char *name)
+{
+    static char json[NOTES_LEN + 4096];
+    static char notes[NOTES_LEN];
+    memset(notes, 'x', sizeof(notes) - 1);
+    notes[sizeof(notes) - 1] = '\0';
+    static const char escapes[] = "He said \\\"hi\\\" \\u00e9 \\\\n { [ ] } ,:";
+    memcpy(notes, escapes, sizeof(escapes) - 1);
+
+    snprintf(json, sizeof(json),
+             "{\"url\":\"https://api.github.com/x\",\"id\":123,"
+             "\"author\":{\"login\":\"a\",\"id\":5,\"site_admin\":false,\"tag_name\":\"NOPE\"},"
+             "\"tag_name\":\"v1.2.3\",\"draft\":false,\"prerelease\":false,\"name\":\"Release\",\n"
+             "\"assets\":[{\"url\":\"u1\",\"id\":1,\"name\":\"glucose-monitor-v1.2.3.bin\",\"label\":null,"
+             "\"uploader\":{\"login\":\"b\",\"name\":\"evil\",\"browser_download_url\":\"evil\"},"
+             "\"content_type\":\"application/octet-stream\",\"size\":1234567,\"digest\":\"sha256:abcd\","
+             "\"download_count\":-1.5e3,"
+             "\"browser_download_url\":\"https://github.com/o/r/releases/download/v1.2.3/glucose-monitor-v1.2.3.bin\"},"
+             " { \"name\" : \"%s\" , \"browser_download_url\" : \"https:\\/\\/x\\/p\" , \"digest\" : null },"
+             "{\"name\":\"glucose-assets-v2.pack\",\"browser_download_url\":\"https://x/a2\","
+             "\"tags\":[\"name\",{\"name\":\"no\"}]}],"
+             "\"tarball_url\":\"t\",\"body\":\"%s\",\"reactions\":{\"assets\":[{\"name\":\"no\"}]}}\r\n",
+             name, notes);
+    return json;
+}
+
+/**
+ * Scan json in chunks of chunk bytes (0: all at once, -1: random sizes)
+ */
+static bool scan(const char *json, int chunk, release_scanner_t *scanner, assets_t *assets)
+{
+    memset(assets, 0, sizeof(*assets));
+    release_scanner_init(scanner, collect_asset, assets);
+    size_t len = strlen(json);
+    for (size_t pos = 0; pos < len; ) {
+        size_t n = chunk == 0 ? len : chunk > 0 ? (size_t)chunk : (size_t)(rand() % 1500 + 1);
+        n = n < len - pos ? n : len - pos;
+        if (!release_scanner_feed(scanner, json + pos, n)) {
+            return false;
+        }
+        pos += n;
+    }
+    return release_scanner_complete(scanner);
+}
+
+static bool scan_ok(const char *json)
+{
+    release_scanner_t scanner;
+    assets_t assets;
+    return scan(json, 0, &scanner, &assets);
+}
+
+static void check_release(const char *name, bool name_kept)
+{
+    static const int chunks[] = { 0, 1, 7, -1, -1, -1 };
+    for (size_t c = 0; c < sizeof(chunks) / sizeof(chunks[0]); c++) {
+        release_scanner_t scanner;
+        assets_t assets;
+        CHECK(scan(build_release(name), chunks[c], &scanner, &assets));
+        CHECK(strcmp(scanner.tag_name, "v1.2.3") == 0);
+        CHECK_EQ(assets.count, 3);
+
+        // Uploader's "name" and "browser_download_url" are not the asset's
+        CHECK(strcmp(assets.assets[0].name, "glucose-monitor-v1.2.3.bin") == 0);
+        CHECK(strcmp(assets.assets[0].digest, "sha256:abcd") == 0);
+        CHECK(strcmp(assets.assets[0].url,
+                     "https://github.com/o/r/releases/download/v1.2.3/glucose-monitor-v1.2.3.bin") == 0);
+
+        if (name_kept) {
+            CHECK(strcmp(assets.assets[1].name, name) == 0);
+        } else {
+            CHECK_EQ(assets.assets[1].name[0], '\0');
+        }
+        CHECK(strcmp(assets.assets[1].url, "https://x/p") == 0);
+        CHECK_EQ(assets.assets[1].digest[0], '\0');
+
+        // Strings inside an asset's nested array are not its name
+        CHECK(strcmp(assets.assets[2].name, "glucose-assets-v2.pack") == 0);
+        CHECK(strcmp(assets.assets[2].url, "https://x/a2") == 0);
+    }
+}
+
+static void test_release_response(void)
+{
+    srand(1);
+    check_release("glucose-monitor-v1.2.3-from-v1.2.2.patch", true);
+}
+
+static void test_long_strings_dropped(void)
+{
+    char name[RELEASE_SCAN_NAME_LEN + 32];
+    memset(name, 'n', sizeof(name) - 1);
+    name[sizeof(name) - 1] = '\0';
+    check_release(name, false);
+
+    // Exactly fills the buffer
+    name[RELEASE_SCAN_NAME_LEN - 1] = '\0';
+    check_release(name, true);
+
+    char json[128] = "{\"tag_name\":\"v";
+    memset(json + strlen(json), '9', RELEASE_SCAN_TAG_LEN + 8);
+    strcat(json, "\"}");
+    release_scanner_t scanner;
+    assets_t assets;
+    CHECK(scan(json, 0, &scanner, &assets));
+    CHECK_EQ(scanner.tag_name[0], '\0');
+}
+
+static void test_malformed_json(void)
+{
+    CHECK(scan_ok("{\"a\":1}"));
+    CHECK(scan_ok(" {\"a\":[true,false,null,-1.5e3,\"\\u00e9\"]} \r\n"));
+    CHECK(!scan_ok("{\"a\":1"));
+    CHECK(!scan_ok("{\"a\":1]"));
+    CHECK(!scan_ok("[1,2]"));
+    CHECK(!scan_ok("{\"a\":\"\\q\"}"));
+    CHECK(!scan_ok("{\"a\":\"\\u12g4\"}"));
+    CHECK(!scan_ok("{\"a\":1}{"));
+    CHECK(!scan_ok("{1:2}"));
+    CHECK(!scan_ok("<html>rate limited</html>"));
+    CHECK(!scan_ok(""));
+
+    char json[128] = "{\"a\":";
+    for (int i = 0; i < RELEASE_SCAN_MAX_DEPTH - 1; i++) {
+        strcat(json, "[");
+    }
+    for (int i = 0; i < RELEASE_SCAN_MAX_DEPTH - 1; i++) {
+        strcat(json, "]");
+    }
+    strcat(json, "}");
+    CHECK(scan_ok(json));
+
+    strcpy(json, "{\"a\":");
+    for (int i = 0; i < RELEASE_SCAN_MAX_DEPTH + 8; i++) {
+        strcat(json, "[");
+    }
+    CHECK(!scan_ok(json));
+}
+
+static bool same_scan(const release_scanner_t *a, const assets_t *aa, const release_scanner_t *b, const assets_t *ba)
+{
+    if (strcmp(a->tag_name, b->tag_name) != 0 || aa->count != ba->count) {
+        return false;
+    }
+    int kept = aa->count < MAX_ASSETS ? aa->count : MAX_ASSETS;
+    for (int i = 0; i < kept; i++) {
+        if (strcmp(aa->assets[i].name, ba->assets[i].name) != 0 ||
+            strcmp(aa->assets[i].url, ba->assets[i].url) != 0 ||
+            strcmp(aa->assets[i].digest, ba->assets[i].digest) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Feed json with cuts at each of cuts[] (ascending)
+ */
+static bool scan_chunked(const char *json, size_t len, const size_t *cuts, int cut_count,
+                         release_scanner_t *scanner, assets_t *assets)
+{
+    memset(assets, 0, sizeof(*assets));
+    release_scanner_init(scanner, collect_asset, assets);
+    size_t pos = 0;
+    bool ok = true;
+    for (int i = 0; i <= cut_count && ok; i++) {
+        size_t end = i < cut_count ? cuts[i] : len;
+        ok = release_scanner_feed(scanner, json + pos, end - pos);
+        pos = end;
+    }
+    return ok && release_scanner_complete(scanner);
+}
+
+static void test_fuzz_chunking(void)
+{
+    static const char *const tokens[] = {
+        "{\"tag_name\":\"", "\"assets\":[", "{\"name\":\"", "\"browser_download_url\":\"",
+        "\"digest\":\"", "\\u00", "\\\"", "null", "}", "]", "\",", "\":",
+    };
+    static const char alphabet[] = "{}[]\":,\\ u0a1tnex-.";
+    const char *env = getenv("RELEASE_FUZZ_ITERATIONS");
+    long iterations = env ? atol(env) : DEFAULT_FUZZ_ITERATIONS;
+    release_scanner_t whole;
+    release_scanner_t chunked;
+    assets_t whole_assets;
+    assets_t chunked_assets;
+
+    srand(2);
+    for (long it = 0; it < iterations; it++) {
+        char json[128];
+        size_t len = rand() % sizeof(json);
+        for (size_t i = 0; i < len; i++) {
+            if (rand() % 10 < 3) {
+                const char *token = tokens[rand() % (sizeof(tokens) / sizeof(tokens[0]))];
+                size_t token_len = strlen(token);
+                if (i + token_len <= len) {
+                    memcpy(json + i, token, token_len);
+                    i += token_len - 1;
+                    continue;
+                }
+            }
+            json[i] = alphabet[rand() % (sizeof(alphabet) - 1)];
+        }
+
+        size_t cuts[4];
+        int cut_count = rand() % 5;
+        size_t last = 0;
+        for (int c = 0; c < cut_count; c++) {
+            last += (len > last) ? rand() % (len - last + 1) : 0;
+            cuts[c] = last;
+        }
+
+        bool ok1 = scan_chunked(json, len, NULL, 0, &whole, &whole_assets);
+        bool ok2 = scan_chunked(json, len, cuts, cut_count, &chunked, &chunked_assets);
+        if (ok1 != ok2 || !same_scan(&whole, &whole_assets, &chunked, &chunked_assets)) {
+            printf("  iteration %ld: %.*s\n", it, (int)len, json);
+            CHECK(0);
+            return;
+        }
+    }
+}
+
+int main(void)
+{
+    RUN_TEST(test_release_response);
+    RUN_TEST(test_long_strings_dropped);
+    RUN_TEST(test_malformed_json);
+    RUN_TEST(test_fuzz_chunking);
+    return TEST_EXIT_CODE();
+}
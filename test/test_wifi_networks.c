@@ -0,0 +1,221 @@
+/**
+ * WiFi network store tests
+ * Ranking against scan results (seen before unseen, strongest first, the
+ * most recently used one credited WIFI_NETWORKS_RECENT_BONUS_DB), and
+ * the saved list in the host NVS stand-in: least recently used evicted
+ * when full, mark_used writes only on a change, legacy keys migrated.
+ */
+
+#include "wifi_networks.h"
+#include "host_idf.h"
+#include "nvs.h"
+#include "test_common.h"
+#include <string.h>
+
+static wifi_network_t network(const char *ssid, uint32_t last_used)
+{
+    wifi_network_t network = { .last_used = last_used };
+    snprintf(network.ssid, sizeof(network.ssid), "%s", ssid);
+    return network;
+}
+
+static wifi_scan_ap_t ap(const char *ssid, int8_t rssi, uint8_t channel)
+{
+    wifi_scan_ap_t ap = { .rssi = rssi, .channel = channel, .authmode = WIFI_AUTH_WPA2_PSK };
+    snprintf(ap.ssid, sizeof(ap.ssid), "%s", ssid);
+    return ap;
+}
+
+/**
+ * Rank and return the SSIDs in order, comma separated
+ */
+static const char *rank_order(const wifi_network_t *networks, size_t count,
+                              const wifi_scan_ap_t *aps, size_t ap_count)
+{
+    static char order[WIFI_NETWORKS_MAX * 34];
+    wifi_candidate_t candidates[WIFI_NETWORKS_MAX];
+    CHECK_EQ(wifi_networks_rank(networks, count, aps, ap_count, candidates), count);
+    order[0] = '\0';
+    for (size_t i = 0; i < count; i++) {
+        CHECK(candidates[i].index < count);
+        strcat(order, i ? "," : "");
+        strcat(order, networks[candidates[i].index].ssid);
+    }
+    return order;
+}
+
+static void test_rank_by_signal(void)
+{
+    const wifi_network_t networks[] = { network("home", 0), network("office", 0), network("phone", 0) };
+    const wifi_scan_ap_t aps[] = { ap("cafe", -30, 1), ap("office", -70, 6), ap("phone", -50, 11), ap("home", -60, 1) };
+    CHECK(strcmp(rank_order(networks, 3, aps, 4), "phone,home,office") == 0);
+
+    wifi_candidate_t candidates[3];
+    wifi_networks_rank(networks, 3, aps, 4, candidates);
+    CHECK(candidates[0].seen);
+    CHECK_EQ(candidates[0].rssi, -50);
+    CHECK_EQ(candidates[0].channel, 11);
+}
+
+static void test_rank_recent_bonus(void)
+{
+    // Most recently used gets the bonus: 5 dB weaker still wins...
+    wifi_network_t networks[] = { network("home", 2), network("mesh", 1) };
+    const wifi_scan_ap_t close[] = { ap("mesh", -55, 1), ap("home", -60, 6) };
+    CHECK(strcmp(rank_order(networks, 2, close, 2), "home,mesh") == 0);
+
+    // ...a tie on score goes to the more recent one...
+    const wifi_scan_ap_t tie[] = { ap("mesh", -50, 1), ap("home", -60, 6) };
+    CHECK(strcmp(rank_order(networks, 2, tie, 2), "home,mesh") == 0);
+
+    // ...but not more than WIFI_NETWORKS_RECENT_BONUS_DB
+    const wifi_scan_ap_t far[] = { ap("mesh", -60 + WIFI_NETWORKS_RECENT_BONUS_DB + 1, 1), ap("home", -60, 6) };
+    CHECK(strcmp(rank_order(networks, 2, far, 2), "mesh,home") == 0);
+
+    // Only the most recent one is credited
+    wifi_network_t three[] = { network("a", 1), network("b", 3), network("c", 2) };
+    const wifi_scan_ap_t aps[] = { ap("a", -52, 1), ap("b", -70, 1), ap("c", -55, 1) };
+    CHECK(strcmp(rank_order(three, 3, aps, 3), "a,c,b") == 0);
+}
+
+static void test_rank_unseen_last(void)
+{
+    // Hidden or missed networks are still tried, most recently used first
+    const wifi_network_t networks[] = {
+        network("hidden-old", 1), network("weak", 2), network("hidden-new", 4), network("never", 0),
+    };
+    const wifi_scan_ap_t aps[] = { ap("weak", -90, 1) };
+    CHECK(strcmp(rank_order(networks, 4, aps, 1), "weak,hidden-new,hidden-old,never") == 0);
+
+    // Empty scan: recency only
+    CHECK(strcmp(rank_order(networks, 4, NULL, 0), "hidden-new,weak,hidden-old,never") == 0);
+
+    // Equal entries keep their saved order
+    const wifi_network_t unused[] = { network("x", 0), network("y", 0), network("z", 0) };
+    CHECK(strcmp(rank_order(unused, 3, NULL, 0), "x,y,z") == 0);
+    CHECK_EQ(wifi_networks_rank(unused, 0, aps, 1, NULL), 0);
+}
+
+static void test_ssid_match_is_exact(void)
+{
+    const wifi_network_t networks[] = { network("home", 1), network("home-5G", 0) };
+    const wifi_scan_ap_t aps[] = { ap("Home", -40, 1), ap("home-5G", -80, 36) };
+    wifi_candidate_t candidates[2];
+    wifi_networks_rank(networks, 2, aps, 2, candidates);
+    CHECK_EQ(candidates[0].index, 1);
+    CHECK(!candidates[1].seen);
+}
+
+static void test_store_lru(void)
+{
+    host_nvs_reset();
+    CHECK(!wifi_networks_exist());
+    char ssid[8];
+    for (int i = 0; i < WIFI_NETWORKS_MAX; i++) {
+        snprintf(ssid, sizeof(ssid), "net%d", i);
+        CHECK_EQ(wifi_networks_add(ssid, "password"), ESP_OK);
+    }
+    CHECK(wifi_networks_exist());
+
+    // net0 used again: net1 is now the least recently used and goes first
+    CHECK_EQ(wifi_networks_mark_used("net0"), ESP_OK);
+    CHECK_EQ(wifi_networks_add("new", "secret12"), ESP_OK);
+
+    wifi_network_t networks[WIFI_NETWORKS_MAX];
+    size_t count = wifi_networks_load(networks);
+    CHECK_EQ(count, WIFI_NETWORKS_MAX);
+    CHECK(wifi_networks_find(networks, count, "net1") < 0);
+    CHECK(wifi_networks_find(networks, count, "net0") >= 0);
+    int index = wifi_networks_find(networks, count, "new");
+    CHECK(index >= 0);
+    CHECK_EQ(wifi_networks_most_recent(networks, count), index);
+    CHECK(strcmp(networks[index].password, "secret12") == 0);
+
+    // Saving an existing SSID updates it in place
+    CHECK_EQ(wifi_networks_add("net2", "changed1"), ESP_OK);
+    count = wifi_networks_load(networks);
+    CHECK_EQ(count, WIFI_NETWORKS_MAX);
+    index = wifi_networks_find(networks, count, "net2");
+    CHECK(strcmp(networks[index].password, "changed1") == 0);
+    CHECK_EQ(wifi_networks_most_recent(networks, count), index);
+
+    CHECK_EQ(wifi_networks_forget("net3"), ESP_OK);
+    CHECK_EQ(wifi_networks_forget("net3"), ESP_ERR_NOT_FOUND);
+    CHECK_EQ(wifi_networks_load(networks), WIFI_NETWORKS_MAX - 1);
+
+    CHECK_EQ(wifi_networks_clear(), ESP_OK);
+    CHECK(!wifi_networks_exist());
+}
+
+static void test_store_arguments(void)
+{
+    host_nvs_reset();
+    char long_ssid[34];
+    memset(long_ssid, 's', 33);
+    long_ssid[33] = '\0';
+    char long_pass[66];
+    memset(long_pass, 'p', 65);
+    long_pass[65] = '\0';
+    CHECK_EQ(wifi_networks_add("", "password"), ESP_ERR_INVALID_ARG);
+    CHECK_EQ(wifi_networks_add(long_ssid, "password"), ESP_ERR_INVALID_ARG);
+    CHECK_EQ(wifi_networks_add("net", long_pass), ESP_ERR_INVALID_ARG);
+    long_ssid[32] = '\0';
+    long_pass[64] = '\0';
+    CHECK_EQ(wifi_networks_add(long_ssid, long_pass), ESP_OK);
+    CHECK_EQ(wifi_networks_mark_used("missing"), ESP_ERR_NOT_FOUND);
+}
+
+static void test_mark_used_writes_on_change(void)
+{
+    host_nvs_reset();
+    CHECK_EQ(wifi_networks_add("a", "password"), ESP_OK);
+    CHECK_EQ(wifi_networks_add("b", "password"), ESP_OK);
+
+    // Reconnecting to the most recent network every boot costs no flash writes
+    uint32_t writes = host_nvs_write_count();
+    CHECK_EQ(wifi_networks_mark_used("b"), ESP_OK);
+    CHECK_EQ(host_nvs_write_count(), writes);
+    CHECK_EQ(wifi_networks_mark_used("a"), ESP_OK);
+    CHECK(host_nvs_write_count() > writes);
+
+    wifi_network_t networks[WIFI_NETWORKS_MAX];
+    size_t count = wifi_networks_load(networks);
+    CHECK_EQ(wifi_networks_most_recent(networks, count), wifi_networks_find(networks, count, "a"));
+}
+
+static void test_legacy_migration(void)
+{
+    host_nvs_reset();
+    nvs_handle_t handle;
+    CHECK_EQ(nvs_open("wifi_config", NVS_READWRITE, &handle), ESP_OK);
+    CHECK_EQ(nvs_set_str(handle, "ssid", "old-net"), ESP_OK);
+    CHECK_EQ(nvs_set_str(handle, "password", "old-pass"), ESP_OK);
+    nvs_close(handle);
+
+    wifi_network_t networks[WIFI_NETWORKS_MAX];
+    CHECK_EQ(wifi_networks_load(networks), 1);
+    CHECK(strcmp(networks[0].ssid, "old-net") == 0);
+    CHECK(strcmp(networks[0].password, "old-pass") == 0);
+    CHECK_EQ(wifi_networks_most_recent(networks, 1), 0);
+    CHECK(!host_nvs_has_key("wifi_config", "ssid"));
+    CHECK(host_nvs_has_key("wifi_config", "networks"));
+
+    // New networks rank above the migrated one
+    CHECK_EQ(wifi_networks_add("new-net", "password"), ESP_OK);
+    size_t count = wifi_networks_load(networks);
+    CHECK_EQ(count, 2);
+    CHECK_EQ(wifi_networks_most_recent(networks, count), wifi_networks_find(networks, count, "new-net"));
+}
+
+int main(void)
+{
+    RUN_TEST(test_rank_by_signal);
+    RUN_TEST(test_rank_recent_bonus);
+    RUN_TEST(test_rank_unseen_last);
+    RUN_TEST(test_ssid_match_is_exact);
+    RUN_TEST(test_store_lru);
+    RUN_TEST(test_store_arguments);
+    RUN_TEST(test_mark_used_writes_on_change);
+    RUN_TEST(test_legacy_migration);
+    return TEST_EXIT_CODE();
+}